@@ -0,0 +1,266 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* command line tool that measures the time that the ReadProperty and
+   ReadPropertyMultiple service handlers take for each property, reading
+   the Object_Identifier of every object in the device, and how many
+   ReadPropertyMultiple replies of 1, 10, and 100 properties the handler
+   encodes each second.  The datalink is not
+   initialized, so the replies are encoded but not sent, and the debug
+   output of the handlers is discarded. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bacnet/bacdef.h"
+#include "bacnet/config.h"
+#include "bacnet/bactext.h"
+#include "bacnet/apdu.h"
+#include "bacnet/rp.h"
+#include "bacnet/rpm.h"
+#include "bacnet/version.h"
+#include "bacnet/basic/object/device.h"
+#include "bacnet/basic/services.h"
+#include "bacnet/basic/sys/filename.h"
+#include "bacnet/basic/sys/mstimer.h"
+
+/* number of requests that are encoded and timed */
+#ifndef HANDLER_BENCH_REQUESTS
+#define HANDLER_BENCH_REQUESTS 512
+#endif
+
+/* a confirmed request that is handed to the service handler */
+typedef struct handler_bench_request {
+    uint8_t apdu[MAX_APDU];
+    uint16_t apdu_len;
+    /* number of properties that the request reads */
+    unsigned properties;
+} HANDLER_BENCH_REQUEST;
+
+static HANDLER_BENCH_REQUEST Requests[HANDLER_BENCH_REQUESTS];
+static unsigned Request_Count;
+
+/**
+ * @brief Encode a ReadProperty request of the Object_Identifier
+ *  of each object in the device.
+ */
+static void handler_bench_rp_encode(void)
+{
+    BACNET_READ_PROPERTY_DATA rpdata = { 0 };
+    BACNET_OBJECT_TYPE object_type = OBJECT_NONE;
+    uint32_t object_instance = 0;
+    unsigned count = 0;
+    unsigned i = 0;
+    int len = 0;
+
+    Request_Count = 0;
+    count = Device_Object_List_Count();
+    for (i = 1; (i <= count) && (Request_Count < HANDLER_BENCH_REQUESTS);
+         i++) {
+        if (!Device_Object_List_Identifier(
+                i, &object_type, &object_instance)) {
+            continue;
+        }
+        rpdata.object_type = object_type;
+        rpdata.object_instance = object_instance;
+        rpdata.object_property = PROP_OBJECT_IDENTIFIER;
+        rpdata.array_index = BACNET_ARRAY_ALL;
+        len = rp_encode_apdu(&Requests[Request_Count].apdu[0], 1, &rpdata);
+        if (len > 0) {
+            Requests[Request_Count].apdu_len = (uint16_t)len;
+            Requests[Request_Count].properties = 1;
+            Request_Count++;
+        }
+    }
+}
+
+/**
+ * @brief Encode ReadPropertyMultiple requests of the Object_Identifier
+ *  and Object_Type of the objects in the device, going around the
+ *  objects of the device again as needed to fill each request.
+ * @param properties - number of properties read by each request
+ */
+static void handler_bench_rpm_encode(unsigned properties)
+{
+    BACNET_OBJECT_TYPE object_type = OBJECT_NONE;
+    uint32_t object_instance = 0;
+    HANDLER_BENCH_REQUEST *request = NULL;
+    uint8_t *apdu = NULL;
+    unsigned count = 0;
+    unsigned index = 0;
+    unsigned i = 0;
+
+    Request_Count = 0;
+    count = Device_Object_List_Count();
+    if ((count == 0) || (properties == 0)) {
+        return;
+    }
+    for (i = 0; i < (count * properties); i++) {
+        if (!Device_Object_List_Identifier(
+                (index % count) + 1, &object_type, &object_instance)) {
+            index++;
+            continue;
+        }
+        index++;
+        if ((request == NULL) || (request->properties >= properties)) {
+            if (Request_Count >= HANDLER_BENCH_REQUESTS) {
+                break;
+            }
+            request = &Requests[Request_Count];
+            Request_Count++;
+            request->properties = 0;
+            request->apdu_len = rpm_encode_apdu_init(&request->apdu[0], 1);
+        }
+        apdu = &request->apdu[request->apdu_len];
+        request->apdu_len += rpm_encode_apdu_object_begin(
+            apdu, object_type, object_instance);
+        apdu = &request->apdu[request->apdu_len];
+        request->apdu_len += rpm_encode_apdu_object_property(
+            apdu, PROP_OBJECT_IDENTIFIER, BACNET_ARRAY_ALL);
+        request->properties++;
+        if (request->properties < properties) {
+            apdu = &request->apdu[request->apdu_len];
+            request->apdu_len += rpm_encode_apdu_object_property(
+                apdu, PROP_OBJECT_TYPE, BACNET_ARRAY_ALL);
+            request->properties++;
+        }
+        apdu = &request->apdu[request->apdu_len];
+        request->apdu_len += rpm_encode_apdu_object_end(apdu);
+    }
+    /* only whole requests are timed */
+    if (request && (request->properties < properties)) {
+        Request_Count--;
+    }
+}
+
+/**
+ * @brief Hand the encoded requests to a service handler until
+ *  the time has elapsed.
+ * @param handler - the confirmed service handler
+ * @param milliseconds - how long to run
+ * @return the time each property took, in nanoseconds
+ */
+static double handler_bench_run(
+    confirmed_function handler, unsigned long milliseconds)
+{
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    BACNET_ADDRESS src = { 0 };
+    unsigned long start = 0;
+    unsigned long elapsed = 0;
+    unsigned long properties = 0;
+    unsigned i = 0;
+
+    if (Request_Count == 0) {
+        return 0.0;
+    }
+    /* a BACnet/IP client of the local network */
+    src.mac_len = 6;
+    src.mac[0] = 192;
+    src.mac[1] = 0;
+    src.mac[2] = 2;
+    src.mac[3] = 1;
+    src.mac[4] = 0xBA;
+    src.mac[5] = 0xC0;
+    service_data.max_segs = 0;
+    service_data.max_resp = MAX_APDU;
+    service_data.invoke_id = 1;
+    start = mstimer_now();
+    do {
+        for (i = 0; i < Request_Count; i++) {
+            /* the service request follows the 4 octet header */
+            handler(&Requests[i].apdu[4], Requests[i].apdu_len - 4, &src,
+                &service_data);
+            properties += Requests[i].properties;
+        }
+        elapsed = mstimer_now() - start;
+    } while (elapsed < milliseconds);
+
+    return ((double)elapsed * 1000000.0) / (double)properties;
+}
+
+static void print_usage(char *filename)
+{
+    printf("Usage: %s [milliseconds]\n", filename);
+    printf("       [--version][--help]\n");
+}
+
+static void print_help(char *filename)
+{
+    printf("Measure the time the ReadProperty and ReadPropertyMultiple\n"
+           "service handlers take to read the Object_Identifier of each object\n"
+           "in the device, reported in nanoseconds per property, and the\n"
+           "ReadPropertyMultiple replies per second for requests of 1, 10,\n"
+           "and 100 properties.\n");
+    printf("\n");
+    printf("milliseconds:\n"
+           "how long to run each measurement. Default is 1000.\n");
+    printf("\n");
+    printf("Example:\n"
+           "%s 5000\n",
+        filename);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long milliseconds = 1000;
+    double rp_ns = 0.0;
+    double rpm_ns = 0.0;
+    static const unsigned RPM_Properties[] = { 1, 10, 100 };
+    unsigned i = 0;
+    int argi = 0;
+    char *filename = NULL;
+
+    filename = filename_remove_path(argv[0]);
+    for (argi = 1; argi < argc; argi++) {
+        if (strcmp(argv[argi], "--help") == 0) {
+            print_usage(filename);
+            print_help(filename);
+            return 0;
+        }
+        if (strcmp(argv[argi], "--version") == 0) {
+            printf("%s %s\n", filename, BACNET_VERSION_TEXT);
+            printf("Copyright (C) 2014 by Steve Karg and others.\n"
+                   "This is free software; see the source for copying "
+                   "conditions.\n"
+                   "There is NO warranty; not even for MERCHANTABILITY or\n"
+                   "FITNESS FOR A PARTICULAR PURPOSE.\n");
+            return 0;
+        }
+        milliseconds = strtoul(argv[argi], NULL, 0);
+        if (milliseconds == 0) {
+            print_usage(filename);
+            return 1;
+        }
+    }
+    /* the handlers report each reply that could not be sent */
+#if defined(_WIN32)
+    if (freopen("NUL", "w", stderr)) {
+#else
+    if (freopen("/dev/null", "w", stderr)) {
+#endif
+        setvbuf(stderr, NULL, _IOFBF, BUFSIZ);
+    }
+    mstimer_init();
+    Device_Init(NULL);
+    Device_Set_Object_Instance_Number(260001);
+    handler_bench_rp_encode();
+    printf("ReadProperty: %u requests of 1 property\n", Request_Count);
+    rp_ns = handler_bench_run(handler_read_property, milliseconds);
+    printf("ReadProperty handler: %.0f ns/property\n", rp_ns);
+    for (i = 0; i < (sizeof(RPM_Properties) / sizeof(RPM_Properties[0])); i++) {
+        handler_bench_rpm_encode(RPM_Properties[i]);
+        rpm_ns =
+            handler_bench_run(handler_read_property_multiple, milliseconds);
+        if (rpm_ns > 0.0) {
+            printf("ReadPropertyMultiple handler, %u-property requests: "
+                   "%.0f ns/property, %.0f replies/second\n",
+                RPM_Properties[i], rpm_ns,
+                1000000000.0 / (rpm_ns * (double)RPM_Properties[i]));
+        }
+    }
+
+    return 0;
+}
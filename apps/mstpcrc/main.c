@@ -47,6 +47,7 @@
 #include "bacnet/bytes.h"
 #include "bacnet/basic/sys/mstimer.h"
 #include "bacnet/datalink/crc.h"
+#include "bacnet/datalink/cobs.h"
 #include "bacnet/version.h"
 
 #ifndef max
@@ -63,6 +64,7 @@ static unsigned CRC_Size = 8;
 /* save to capture file for viewing in Wireshark */
 static bool MSTP_Cap = false;
 static bool MSTP_Text_File = false;
+static bool Benchmark = false;
 static char Capture_Filename[64] = "mstp_20090123091200.cap";
 static FILE *pFile = NULL; /* stream pointer */
 static FILE *pText_File = NULL; /* stream pointer */
@@ -138,6 +140,10 @@ static void Parse_Arguments(int argc, char *argv[])
                 case 'F':
                     MSTP_Text_File = true;
                     break;
+                case 'b':
+                case 'B':
+                    Benchmark = true;
+                    break;
                 default:
                     break;
             }
@@ -259,6 +265,102 @@ static void Process_Text_File(void)
     }
 }
 
+static uint32_t Benchmark_Header_Octets(
+    const uint8_t *buffer, size_t length, uint32_t crc)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        crc = CRC_Calc_Header(buffer[i], (uint8_t)crc);
+    }
+
+    return crc;
+}
+
+static uint32_t Benchmark_Header_Buffer(
+    const uint8_t *buffer, size_t length, uint32_t crc)
+{
+    return CRC_Calc_Header_Buffer(buffer, length, (uint8_t)crc);
+}
+
+static uint32_t Benchmark_Data_Octets(
+    const uint8_t *buffer, size_t length, uint32_t crc)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        crc = CRC_Calc_Data(buffer[i], (uint16_t)crc);
+    }
+
+    return crc;
+}
+
+static uint32_t Benchmark_Data_Buffer(
+    const uint8_t *buffer, size_t length, uint32_t crc)
+{
+    return CRC_Calc_Data_Buffer(buffer, length, (uint16_t)crc);
+}
+
+static uint32_t Benchmark_CRC32K_Octets(
+    const uint8_t *buffer, size_t length, uint32_t crc)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        crc = cobs_crc32k(buffer[i], crc);
+    }
+
+    return crc;
+}
+
+static uint32_t Benchmark_CRC32K_Buffer(
+    const uint8_t *buffer, size_t length, uint32_t crc)
+{
+    return cobs_crc32k_buffer(buffer, length, crc);
+}
+
+/******************************************************************
+ * DESCRIPTION:  Measures how many megabytes per second each CRC
+ *               accumulates, an octet at a time and a buffer at a time.
+ * RETURN:       nothing
+ * NOTES:        none
+ ******************************************************************/
+static void Benchmark_CRC(void)
+{
+    static const struct {
+        const char *name;
+        uint32_t (*crc)(const uint8_t *buffer, size_t length, uint32_t crc);
+    } Algorithm[] = {
+        { "Header CRC octets", Benchmark_Header_Octets },
+        { "Header CRC buffer", Benchmark_Header_Buffer },
+        { "Data CRC octets", Benchmark_Data_Octets },
+        { "Data CRC buffer", Benchmark_Data_Buffer },
+        { "CRC32K octets", Benchmark_CRC32K_Octets },
+        { "CRC32K buffer", Benchmark_CRC32K_Buffer },
+    };
+    static uint8_t buffer[1024 * 1024];
+    volatile uint32_t crc = 0;
+    unsigned long passes;
+    clock_t start, elapsed;
+    unsigned a, i;
+
+    for (i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)rand();
+    }
+    for (a = 0; a < sizeof(Algorithm) / sizeof(Algorithm[0]); a++) {
+        passes = 0;
+        start = clock();
+        do {
+            crc = Algorithm[a].crc(buffer, sizeof(buffer), crc);
+            passes++;
+            elapsed = clock() - start;
+        } while (elapsed < (CLOCKS_PER_SEC / 2));
+        printf("%-20s %10.1f MB/s\r\n", Algorithm[a].name,
+            ((double)passes * sizeof(buffer) / (1024.0 * 1024.0)) /
+                ((double)elapsed / CLOCKS_PER_SEC));
+    }
+}
+
 /* simple program to CRC the data and print the CRC */
 int main(int argc, char *argv[])
 {
@@ -280,6 +382,7 @@ int main(int argc, char *argv[])
             "[-16] calculate the MS/TP 16-bit Data CRC\r\n"
             "[-32] calculate the MS/TP 32-bit Extended Frame CRC\r\n"
             "[-f filename] read MS/TP capture data from text file\r\n"
+            "[-b] measure the MB/s of each CRC algorithm\r\n"
             "Note: MS/TP Header CRC does not include the 55 FF preamble.\r\n");
         return 0;
     }
@@ -293,7 +396,9 @@ int main(int argc, char *argv[])
         return 0;
     }
     Parse_Arguments(argc, argv);
-    if (MSTP_Text_File) {
+    if (Benchmark) {
+        Benchmark_CRC();
+    } else if (MSTP_Text_File) {
         Process_Text_File();
     } else if (CRC_Buffer_Len) {
         if (MSTP_Cap) {
@@ -29,7 +29,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <poll.h>
 #include <sys/ipc.h>
+#include <sys/uio.h>
 #include "ipmodule.h"
 #include "bacnet/bacint.h"
 
@@ -40,6 +42,24 @@ uint8_t test_packet[] = { 0x81, 0x0a, 0x00, 0x16, /* BVLC header */
     0x55 }; /* APDU */
 #endif
 
+/* wait until the socket is readable or a message is sent to the port */
+static void dl_ip_wait(ROUTER_PORT *port, IP_DATA *ip_data)
+{
+    struct pollfd fds[2];
+
+    if (!msgbox_wait_prepare(port->port_id)) {
+        return;
+    }
+    fds[0].fd = ip_data->socket;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = msgbox_fd(port->port_id);
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    poll(fds, 2, -1);
+    msgbox_wait_done(port->port_id);
+}
+
 void *dl_ip_thread(void *pArgs)
 {
     MSGBOX_ID msgboxid;
@@ -57,14 +77,8 @@ void *dl_ip_thread(void *pArgs)
         return NULL;
     }
 
-    /* allocate buffer */
-    ip_data.max_buff = MAX_BIP_MPDU;
-    ip_data.buff = (uint8_t *)malloc(ip_data.max_buff);
-
-    if (ip_data.buff == NULL) {
-        port->state = INIT_FAILED;
-        return NULL;
-    }
+    /* packets are received into the buffer of a message */
+    ip_data.rx_data = NULL;
 
     msgboxid = create_msgbox();
     if (msgboxid == INVALID_MSGBOX_ID) {
@@ -74,7 +88,8 @@ void *dl_ip_thread(void *pArgs)
     }
 
     port->port_id = msgboxid;
-    port->state = RUNNING;
+    /* publish port_id along with the state */
+    __atomic_store_n(&port->state, RUNNING, __ATOMIC_RELEASE);
 
     while (!shutdown) {
         /* check for incoming messages */
@@ -113,7 +128,7 @@ void *dl_ip_thread(void *pArgs)
                     break;
             }
         } else {
-            status = dl_ip_recv(&ip_data, &msg_data, &address, 5);
+            status = dl_ip_recv(&ip_data, &msg_data, &address, 0);
             if (status > 0) {
                 memmove(&msg_data->src.len, &address.mac_len, 1);
                 memmove(&msg_data->src.adr[0], &address.mac[0], MAX_MAC_LEN);
@@ -124,6 +139,8 @@ void *dl_ip_thread(void *pArgs)
                 if (!send_to_msgbox(port->main_id, &msg_storage)) {
                     free_data(msg_data);
                 }
+            } else {
+                dl_ip_wait(port, &ip_data);
             }
         }
     }
@@ -219,38 +236,42 @@ int dl_ip_send(
     IP_DATA *data, BACNET_ADDRESS *dest, uint8_t *pdu, unsigned pdu_len)
 {
     struct sockaddr_in bip_dest = { 0 };
-    int buff_len = 0;
+    uint8_t header[BIP_HEADER_MAX];
+    struct iovec iov[2];
+    struct msghdr msg = { 0 };
     int bytes_sent = 0;
 
     if (data->socket < 0) {
         return -1;
     }
 
-    data->buff[0] = BVLL_TYPE_BACNET_IP;
+    header[0] = BVLL_TYPE_BACNET_IP;
     bip_dest.sin_family = AF_INET;
     if (dest->net == BACNET_BROADCAST_NETWORK) {
         /* broadcast */
         bip_dest.sin_addr.s_addr = data->broadcast_addr.s_addr;
         bip_dest.sin_port = data->port;
-        data->buff[1] = BVLC_ORIGINAL_BROADCAST_NPDU;
+        header[1] = BVLC_ORIGINAL_BROADCAST_NPDU;
     } else if (dest->mac_len == 6) {
         memcpy(&bip_dest.sin_addr.s_addr, &dest->mac[0], 4);
         memcpy(&bip_dest.sin_port, &dest->mac[4], 2);
-        data->buff[1] = BVLC_ORIGINAL_UNICAST_NPDU;
+        header[1] = BVLC_ORIGINAL_UNICAST_NPDU;
     } else {
         /* invalid address */
         return -1;
     }
-
-    buff_len = 2;
-    buff_len += encode_unsigned16(
-        &data->buff[buff_len], (uint16_t)(pdu_len + 4 /*inclusive */));
-    memcpy(&data->buff[buff_len], pdu, pdu_len);
-    buff_len += pdu_len;
-
-    /* send the packet */
-    bytes_sent = sendto(data->socket, (char *)data->buff, buff_len, 0,
-        (struct sockaddr *)&bip_dest, sizeof(struct sockaddr));
+    encode_unsigned16(&header[2], (uint16_t)(pdu_len + 4 /*inclusive */));
+
+    /* send the header and the PDU from where they are */
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = pdu;
+    iov[1].iov_len = pdu_len;
+    msg.msg_name = &bip_dest;
+    msg.msg_namelen = sizeof(bip_dest);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    bytes_sent = sendmsg(data->socket, &msg, 0);
 
     PRINT(DEBUG, "send to %s\n", inet_ntoa(bip_dest.sin_addr));
 
@@ -262,8 +283,10 @@ int dl_ip_recv(
 {
     int received_bytes = 0;
     uint16_t buff_len = 0; /* return value */
-    fd_set read_fds;
-    struct timeval select_timeout;
+    uint16_t header_len = 0;
+    uint8_t *buff;
+    unsigned max_buff;
+    struct pollfd fds;
     struct sockaddr_in sin = { 0 };
     socklen_t sin_len = sizeof(sin);
 
@@ -272,122 +295,100 @@ int dl_ip_recv(
         return 0;
     }
 
-    if (timeout >= 1000) {
-        select_timeout.tv_sec = timeout / 1000;
-        select_timeout.tv_usec =
-            1000 * (timeout - select_timeout.tv_sec * 1000);
-    } else {
-        select_timeout.tv_sec = 0;
-        select_timeout.tv_usec = 1000 * timeout;
+    /* receive into the buffer of the next message, leaving room
+       in front of the PDU for the router to add to its NPDU header */
+    if (!data->rx_data) {
+        data->rx_data = alloc_data();
+        if (!data->rx_data) {
+            return 0;
+        }
     }
-
-    FD_ZERO(&read_fds);
-    FD_SET(data->socket, &read_fds);
+    buff = data_buffer(data->rx_data) + MSG_DATA_HEADROOM;
+    max_buff = MSG_DATA_BUFFER_SIZE - MSG_DATA_HEADROOM;
 
 #ifdef TEST_PACKET
     received_bytes = sizeof(test_packet);
-    memmove(data->buff, &test_packet, received_bytes);
+    memmove(buff, &test_packet, received_bytes);
     sin.sin_addr.s_addr = 0x7E1D40A;
     sin.sin_port = 0xC0BA;
 #else
-    int ret = select(data->socket + 1, &read_fds, NULL, NULL, &select_timeout);
-    /* see if there is a packet for us */
-    if (ret > 0) {
-        received_bytes = recvfrom(data->socket, (char *)&data->buff[0],
-            data->max_buff, 0, (struct sockaddr *)&sin, &sin_len);
-    } else {
-        return 0;
+    if (timeout > 0) {
+        fds.fd = data->socket;
+        fds.events = POLLIN;
+        fds.revents = 0;
+        if (poll(&fds, 1, timeout) <= 0) {
+            return 0;
+        }
     }
+    /* see if there is a packet for us */
+    received_bytes = recvfrom(data->socket, (char *)buff, max_buff,
+        MSG_DONTWAIT, (struct sockaddr *)&sin, &sin_len);
 #endif
-    PRINT(DEBUG, "received from %s\n", inet_ntoa(sin.sin_addr));
-
     /* check for errors */
     if (received_bytes <= 0) {
         return 0;
     }
 
+    PRINT(DEBUG, "received from %s\n", inet_ntoa(sin.sin_addr));
+
     /* the signature of a BACnet/IP packet */
-    if (data->buff[0] != BVLL_TYPE_BACNET_IP)
+    if (buff[0] != BVLL_TYPE_BACNET_IP)
         return 0;
 
-    switch (data->buff[1]) {
+    switch (buff[1]) {
         case BVLC_ORIGINAL_UNICAST_NPDU:
-        case BVLC_ORIGINAL_BROADCAST_NPDU: {
-            if ((sin.sin_addr.s_addr == data->local_addr.s_addr) &&
-                (sin.sin_port == data->port)) {
-                buff_len = 0;
-
-                PRINT(DEBUG, "BIP: src is me. Discarded!\n");
-            } else {
-                src->mac_len = 6;
-                memcpy(&src->mac[0], &sin.sin_addr.s_addr, 4);
-                memcpy(&src->mac[4], &sin.sin_port, 2);
-
-                (void)decode_unsigned16(&data->buff[2], &buff_len);
-                /* subtract off the BVLC header */
-                buff_len -= 4;
-                if (buff_len < data->max_buff) {
-                    /* allocate data message stucture */
-                    (*msg_data) = (MSG_DATA *)malloc(sizeof(MSG_DATA));
-                    (*msg_data)->pdu_len = buff_len;
-                    (*msg_data)->pdu = (uint8_t *)malloc((*msg_data)->pdu_len);
-                    /* fill up data message structure */
-                    memmove(&(*msg_data)->pdu[0], &data->buff[4],
-                        (*msg_data)->pdu_len);
-                    memmove(&(*msg_data)->src, src, sizeof(BACNET_ADDRESS));
-                }
-                /* ignore packets that are too large */
-                else {
-                    buff_len = 0;
-
-                    PRINT(ERROR, "BIP: PDU too large. Discarded!.\n");
-                }
-            }
-        } break;
-
-        case BVLC_FORWARDED_NPDU: {
-            memcpy(&sin.sin_addr.s_addr, &data->buff[4], 4);
-            memcpy(&sin.sin_port, &data->buff[8], 2);
-            if ((sin.sin_addr.s_addr == data->local_addr.s_addr) &&
-                (sin.sin_port == data->port)) {
-                buff_len = 0;
-            } else {
-                src->mac_len = 6;
-                memcpy(&src->mac[0], &sin.sin_addr.s_addr, 4);
-                memcpy(&src->mac[4], &sin.sin_port, 2);
-
-                (void)decode_unsigned16(&data->buff[2], &buff_len);
-                /* subtract off the BVLC header */
-                buff_len -= 10;
-                if (buff_len < data->max_buff) {
-                    /* allocate data message stucture */
-                    (*msg_data) = (MSG_DATA *)malloc(sizeof(MSG_DATA));
-                    (*msg_data)->pdu_len = buff_len;
-                    (*msg_data)->pdu = (uint8_t *)malloc((*msg_data)->pdu_len);
-                    /* fill up data message structure */
-                    memmove(&(*msg_data)->pdu[0], &data->buff[4 + 6],
-                        (*msg_data)->pdu_len);
-                    memmove(&(*msg_data)->src, src, sizeof(BACNET_ADDRESS));
-                } else {
-                    /* ignore packets that are too large */
-                    buff_len = 0;
-                }
-            }
-        } break;
+        case BVLC_ORIGINAL_BROADCAST_NPDU:
+            header_len = 4;
+            break;
+        case BVLC_FORWARDED_NPDU:
+            header_len = 4 + 6;
+            memcpy(&sin.sin_addr.s_addr, &buff[4], 4);
+            memcpy(&sin.sin_port, &buff[8], 2);
+            break;
         default:
 
             PRINT(ERROR, "BIP: BVLC discarded!\n");
 
-            break;
+            return 0;
     }
+    if ((sin.sin_addr.s_addr == data->local_addr.s_addr) &&
+        (sin.sin_port == data->port)) {
+
+        PRINT(DEBUG, "BIP: src is me. Discarded!\n");
+
+        return 0;
+    }
+    (void)decode_unsigned16(&buff[2], &buff_len);
+    /* ignore packets that are too large, or shorter than their header */
+    if ((buff_len > received_bytes) || (buff_len <= header_len)) {
+
+        PRINT(ERROR, "BIP: PDU length invalid. Discarded!\n");
+
+        return 0;
+    }
+    /* subtract off the BVLC header */
+    buff_len -= header_len;
+
+    src->mac_len = 6;
+    memcpy(&src->mac[0], &sin.sin_addr.s_addr, 4);
+    memcpy(&src->mac[4], &sin.sin_port, 2);
+
+    /* hand the buffer over with the message */
+    (*msg_data) = data->rx_data;
+    data->rx_data = NULL;
+    (*msg_data)->pdu = &buff[header_len];
+    (*msg_data)->pdu_len = buff_len;
+    memmove(&(*msg_data)->src, src, sizeof(BACNET_ADDRESS));
+
     return buff_len;
 }
 
 void dl_ip_cleanup(IP_DATA *ip_data)
 {
-    /* free buffer */
-    if (ip_data->buff) {
-        free(ip_data->buff);
+    /* free the receive buffer */
+    if (ip_data->rx_data) {
+        free_data(ip_data->rx_data);
+        ip_data->rx_data = NULL;
     }
     /* close socket */
     if (ip_data->socket > 0) {
@@ -49,8 +49,8 @@ typedef struct ip_data {
     uint16_t port;
     struct in_addr local_addr;
     struct in_addr broadcast_addr;
-    uint8_t *buff;
-    uint16_t max_buff;
+    /* message that the next packet is received into */
+    MSG_DATA *rx_data;
 } IP_DATA;
 
 
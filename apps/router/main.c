@@ -37,7 +37,6 @@
 #include <string.h>
 #include <time.h> /* for time */
 #include <errno.h>
-#include <assert.h>
 #include <fcntl.h>
 #include <libconfig.h> /* read config files */
 #include <unistd.h> /* for getopt */
@@ -73,21 +72,15 @@ void cleanup();
 
 void print_msg(BACMSG *msg);
 
-uint16_t process_msg(BACMSG *msg, MSG_DATA *data, uint8_t **buff);
-
 uint16_t get_next_free_dnet();
 
 int kbhit();
 
-inline bool is_network_msg(BACMSG *msg);
-
 int main(int argc, char *argv[])
 {
-    ROUTER_PORT *port;
     BACMSG msg_storage, *bacmsg = NULL;
     MSG_DATA *msg_data = NULL;
     uint8_t *buff = NULL;
-    int16_t buff_len = 0;
 
     atexit(cleanup);
 
@@ -117,78 +110,10 @@ int main(int argc, char *argv[])
         bacmsg = recv_from_msgbox(head->main_id, &msg_storage, 0);
         if (bacmsg) {
             switch (bacmsg->type) {
-                case DATA: {
-                    MSGBOX_ID msg_src = bacmsg->origin;
-
-                    /* allocate message structure */
-                    msg_data = malloc(sizeof(MSG_DATA));
-                    if (!msg_data) {
-                        PRINT(ERROR, "Error: Could not allocate memory\n");
-                        break;
-                    }
-
+                case DATA:
                     // print_msg(bacmsg);
-
-                    if (is_network_msg(bacmsg)) {
-                        buff_len =
-                            process_network_message(bacmsg, msg_data, &buff);
-                        if (buff_len == 0) {
-                            free_data(bacmsg->data);
-                            break;
-                        }
-                    } else {
-                        buff_len = process_msg(bacmsg, msg_data, &buff);
-                    }
-
-                    /* if buff_len */
-                    /* >0 - form new message and send */
-                    /* =-1 - try to find next router */
-                    /* other value - discard message */
-
-                    if (buff_len > 0) {
-                        /* form new message */
-                        msg_data->pdu = buff;
-                        msg_data->pdu_len = buff_len;
-                        msg_storage.origin = head->main_id;
-                        msg_storage.type = DATA;
-                        msg_storage.data = msg_data;
-
-                        // print_msg(bacmsg);
-
-                        if (is_network_msg(bacmsg)) {
-                            msg_data->ref_count = 1;
-                            send_to_msgbox(msg_src, &msg_storage);
-                        } else if (msg_data->dest.net !=
-                            BACNET_BROADCAST_NETWORK) {
-                            msg_data->ref_count = 1;
-                            port =
-                                find_dnet(msg_data->dest.net, &msg_data->dest);
-                            send_to_msgbox(port->port_id, &msg_storage);
-                        } else {
-                            port = head;
-                            msg_data->ref_count = port_count - 1;
-                            while (port != NULL) {
-                                if (port->port_id == msg_src ||
-                                    port->state == FINISHED) {
-                                    port = port->next;
-                                    continue;
-                                }
-                                send_to_msgbox(port->port_id, &msg_storage);
-                                port = port->next;
-                            }
-                        }
-                    } else if (buff_len == -1) {
-                        uint16_t net = msg_data->dest.net; /* NET to find */
-                        PRINT(INFO, "Searching NET...\n");
-                        send_network_message(
-                            NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK, msg_data,
-                            &buff, &net);
-                    } else {
-                        /* if invalid message send Reject-Message-To-Network */
-                        PRINT(ERROR, "Error: Invalid message\n");
-                        free_data(msg_data);
-                    }
-                } break;
+                    route_message(bacmsg);
+                    break;
                 case SERVICE:
                 default:
                     break;
@@ -673,6 +598,10 @@ bool init_router()
     /* add main message box id to all ports */
     while (port != NULL) {
         port->main_id = msgboxid;
+        /* and its network to the routing table */
+        if (!add_port_dnet(port)) {
+            return false;
+        }
         port = port->next;
     }
 
@@ -701,11 +630,19 @@ void cleanup()
 {
     ROUTER_PORT *port;
     BACMSG msg;
+    DNET *dnet;
+    unsigned i;
 
     if (head == NULL) {
         return;
     }
 
+    for (i = 0; i < dnet_count(); i++) {
+        dnet = dnet_by_index(i);
+        PRINT(INFO, "NET %hu: %lu NPDUs, %lu octets routed\n", dnet->net,
+            (unsigned long)dnet->packets, (unsigned long)dnet->octets);
+    }
+
     msg.origin = head->main_id;
     msg.type = SERVICE;
     msg.subtype = SHUTDOWN;
@@ -724,15 +661,13 @@ void cleanup()
     port = head;
     while (port != NULL) {
         if (port->state == FINISHED) {
-            cleanup_dnets(port->route_info.dnets);
             port = port->next;
             free(head->iface);
             free(head);
             head = port;
         }
     }
-
-    pthread_mutex_destroy(&msg_lock);
+    cleanup_dnets();
 }
 
 void print_msg(BACMSG *msg)
@@ -751,64 +686,6 @@ void print_msg(BACMSG *msg)
     }
 }
 
-uint16_t process_msg(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
-{
-    BACNET_ADDRESS addr;
-    BACNET_NPDU_DATA npdu_data;
-    ROUTER_PORT *srcport;
-    ROUTER_PORT *destport;
-    uint8_t npdu[MAX_NPDU];
-    int16_t buff_len = 0;
-    int apdu_offset;
-    int apdu_len;
-    int npdu_len;
-
-    memmove(data, msg->data, sizeof(MSG_DATA));
-
-    apdu_offset = npdu_decode(data->pdu, &data->dest, &addr, &npdu_data);
-    apdu_len = data->pdu_len - apdu_offset;
-
-    srcport = find_snet(msg->origin);
-    destport = find_dnet(data->dest.net, NULL);
-    assert(srcport);
-
-    if (srcport && destport) {
-        data->src.net = srcport->route_info.net;
-
-        /* if received from another router save real source address (not other
-         * router source address) */
-        if (addr.net > 0 && addr.net < BACNET_BROADCAST_NETWORK &&
-            data->src.net != addr.net)
-            memmove(&data->src, &addr, sizeof(BACNET_ADDRESS));
-
-        /* encode both source and destination for broadcast and router-to-router
-         * communication */
-        if (data->dest.net == BACNET_BROADCAST_NETWORK ||
-            destport->route_info.net != data->dest.net) {
-            npdu_len =
-                npdu_encode_pdu(npdu, &data->dest, &data->src, &npdu_data);
-        } else {
-            npdu_len = npdu_encode_pdu(npdu, NULL, &data->src, &npdu_data);
-        }
-
-        buff_len = npdu_len + data->pdu_len - apdu_offset;
-
-        *buff = (uint8_t *)malloc(buff_len);
-        memmove(*buff, npdu, npdu_len); /* copy newly formed NPDU */
-        memmove(*buff + npdu_len, &data->pdu[apdu_offset],
-            apdu_len); /* copy APDU */
-
-    } else {
-        /* request net search */
-        return -1;
-    }
-
-    /* delete received message */
-    free_data((MSG_DATA *)msg->data);
-
-    return buff_len;
-}
-
 int kbhit()
 {
     static const int STDIN = 0;
@@ -829,16 +706,6 @@ int kbhit()
     return bytesWaiting;
 }
 
-bool is_network_msg(BACMSG *msg)
-{
-    uint8_t control_byte; /* NPDU control byte */
-    MSG_DATA *data = (MSG_DATA *)msg->data;
-
-    control_byte = data->pdu[1];
-
-    return control_byte & 0x80; /* check 7th bit */
-}
-
 uint16_t get_next_free_dnet()
 {
     ROUTER_PORT *port = head;
@@ -31,73 +31,343 @@
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "msgqueue.h"
 
-pthread_mutex_t msg_lock = PTHREAD_MUTEX_INITIALIZER;
+/* keep the counters that different threads write in their own cache line */
+#define MSGBOX_CACHE_LINE 64
 
-MSGBOX_ID create_msgbox()
+struct msgbox_cell {
+    unsigned long sequence;
+    BACMSG msg;
+};
+
+/* A bounded queue of messages that threads send to and receive from
+   without a lock.  The sequence number of each cell tells the senders and
+   the receivers whose turn it is to use the cell: a sender claims the cell
+   at head when its sequence equals head, and a receiver takes the cell at
+   tail when its sequence equals tail + 1.  A receiver that waits for a
+   message sets waiting, and the next sender wakes it with the eventfd. */
+struct msgbox {
+    struct msgbox_cell cells[MSGBOX_SIZE];
+    char pad0[MSGBOX_CACHE_LINE];
+    unsigned long head;
+    char pad1[MSGBOX_CACHE_LINE - sizeof(unsigned long)];
+    unsigned long tail;
+    char pad2[MSGBOX_CACHE_LINE - sizeof(unsigned long)];
+    int waiting;
+    int event_fd;
+    bool used;
+};
+
+static struct msgbox *Msgbox[MSGBOX_MAX];
+/* only creating and deleting message boxes is locked */
+static pthread_mutex_t Msgbox_Lock = PTHREAD_MUTEX_INITIALIZER;
+/* message data structures that are free to use again */
+static struct msgbox Data_Pool;
+static pthread_once_t Data_Pool_Once = PTHREAD_ONCE_INIT;
+
+static void msgbox_reset(struct msgbox *box)
+{
+    unsigned long i;
+
+    for (i = 0; i < MSGBOX_SIZE; i++) {
+        box->cells[i].sequence = i;
+    }
+    box->head = 0;
+    box->tail = 0;
+    box->waiting = 0;
+}
+
+static bool msgbox_put(struct msgbox *box, BACMSG *msg)
+{
+    struct msgbox_cell *cell;
+    unsigned long pos;
+    unsigned long sequence;
+    long diff;
+
+    pos = __atomic_load_n(&box->head, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &box->cells[pos & (MSGBOX_SIZE - 1)];
+        sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        diff = (long)sequence - (long)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&box->head, &pos, pos + 1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* full */
+            return false;
+        } else {
+            pos = __atomic_load_n(&box->head, __ATOMIC_RELAXED);
+        }
+    }
+    cell->msg = *msg;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool msgbox_get(struct msgbox *box, BACMSG *msg)
+{
+    struct msgbox_cell *cell;
+    unsigned long pos;
+    unsigned long sequence;
+    long diff;
+
+    pos = __atomic_load_n(&box->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        cell = &box->cells[pos & (MSGBOX_SIZE - 1)];
+        sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        diff = (long)sequence - (long)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&box->tail, &pos, pos + 1, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* empty */
+            return false;
+        } else {
+            pos = __atomic_load_n(&box->tail, __ATOMIC_RELAXED);
+        }
+    }
+    *msg = cell->msg;
+    __atomic_store_n(
+        &cell->sequence, pos + MSGBOX_SIZE, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool msgbox_empty(struct msgbox *box)
+{
+    unsigned long pos;
+    unsigned long sequence;
+
+    pos = __atomic_load_n(&box->tail, __ATOMIC_RELAXED);
+    sequence = __atomic_load_n(
+        &box->cells[pos & (MSGBOX_SIZE - 1)].sequence, __ATOMIC_ACQUIRE);
+
+    return ((long)sequence - (long)(pos + 1)) < 0;
+}
+
+static struct msgbox *msgbox_find(MSGBOX_ID id)
 {
-    MSGBOX_ID msgboxid;
+    struct msgbox *box;
 
-    msgboxid = msgget(IPC_PRIVATE, 0666 | IPC_CREAT);
-    if (msgboxid == INVALID_MSGBOX_ID) {
-        return INVALID_MSGBOX_ID;
+    if ((id < 0) || (id >= MSGBOX_MAX)) {
+        return NULL;
+    }
+    box = __atomic_load_n(&Msgbox[id], __ATOMIC_ACQUIRE);
+    if (!box || !__atomic_load_n(&box->used, __ATOMIC_ACQUIRE)) {
+        return NULL;
     }
 
+    return box;
+}
+
+MSGBOX_ID create_msgbox(void)
+{
+    MSGBOX_ID msgboxid = INVALID_MSGBOX_ID;
+    struct msgbox *box;
+    int i;
+
+    pthread_mutex_lock(&Msgbox_Lock);
+    for (i = 0; i < MSGBOX_MAX; i++) {
+        box = Msgbox[i];
+        if (box && box->used) {
+            continue;
+        }
+        if (!box) {
+            box = calloc(1, sizeof(struct msgbox));
+            if (!box) {
+                break;
+            }
+            box->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (box->event_fd < 0) {
+                free(box);
+                break;
+            }
+            __atomic_store_n(&Msgbox[i], box, __ATOMIC_RELEASE);
+        }
+        msgbox_reset(box);
+        __atomic_store_n(&box->used, true, __ATOMIC_RELEASE);
+        msgboxid = i;
+        break;
+    }
+    pthread_mutex_unlock(&Msgbox_Lock);
+
     return msgboxid;
 }
 
 bool send_to_msgbox(MSGBOX_ID dest, BACMSG *msg)
 {
-    int err;
+    struct msgbox *box;
+    uint64_t count = 1;
 
-    err = msgsnd(dest, msg, sizeof(BACMSG) - sizeof(MSGTYPE), 0);
-    if (err) {
+    box = msgbox_find(dest);
+    if (!box) {
+        return false;
+    }
+    if (!msgbox_put(box, msg)) {
         return false;
     }
+    /* wake the receiver if it waits - pairs with msgbox_wait_prepare() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&box->waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&box->waiting, 0, __ATOMIC_ACQ_REL)) {
+        if (write(box->event_fd, &count, sizeof(count)) < 0) {
+            /* the counter is already set */
+        }
+    }
+
     return true;
 }
 
 BACMSG *recv_from_msgbox(MSGBOX_ID src, BACMSG *msg, int flags)
 {
-    int recv_bytes;
+    struct msgbox *box;
+    struct pollfd fds;
 
-    recv_bytes =
-        msgrcv(src, msg, sizeof(BACMSG) - sizeof(MSGTYPE), 0, flags);
-    if (recv_bytes > 0) {
-        return msg;
-    } else {
+    box = msgbox_find(src);
+    if (!box) {
         return NULL;
     }
+    for (;;) {
+        if (msgbox_get(box, msg)) {
+            return msg;
+        }
+        if (flags & IPC_NOWAIT) {
+            return NULL;
+        }
+        if (msgbox_wait_prepare(src)) {
+            fds.fd = box->event_fd;
+            fds.events = POLLIN;
+            fds.revents = 0;
+            poll(&fds, 1, -1);
+            msgbox_wait_done(src);
+        }
+    }
 }
 
 void del_msgbox(MSGBOX_ID msgboxid)
 {
-    if (msgboxid == INVALID_MSGBOX_ID) {
+    struct msgbox *box;
+
+    pthread_mutex_lock(&Msgbox_Lock);
+    box = msgbox_find(msgboxid);
+    if (box) {
+        /* the memory is kept, since other threads may still send to it */
+        __atomic_store_n(&box->used, false, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&Msgbox_Lock);
+}
+
+int msgbox_fd(MSGBOX_ID msgboxid)
+{
+    struct msgbox *box;
+
+    box = msgbox_find(msgboxid);
+    if (!box) {
+        return -1;
+    }
+
+    return box->event_fd;
+}
+
+bool msgbox_wait_prepare(MSGBOX_ID msgboxid)
+{
+    struct msgbox *box;
+
+    box = msgbox_find(msgboxid);
+    if (!box) {
+        return false;
+    }
+    __atomic_store_n(&box->waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!msgbox_empty(box)) {
+        __atomic_store_n(&box->waiting, 0, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    return true;
+}
+
+void msgbox_wait_done(MSGBOX_ID msgboxid)
+{
+    struct msgbox *box;
+    uint64_t count = 0;
+
+    box = msgbox_find(msgboxid);
+    if (!box) {
         return;
+    }
+    __atomic_store_n(&box->waiting, 0, __ATOMIC_RELAXED);
+    if (read(box->event_fd, &count, sizeof(count)) < 0) {
+        /* not woken up */
+    }
+}
+
+static void data_pool_init(void)
+{
+    msgbox_reset(&Data_Pool);
+}
+
+MSG_DATA *alloc_data(void)
+{
+    BACMSG msg;
+    MSG_DATA *data = NULL;
+
+    pthread_once(&Data_Pool_Once, data_pool_init);
+    if (msgbox_get(&Data_Pool, &msg)) {
+        data = (MSG_DATA *)msg.data;
     } else {
-        msgctl(msgboxid, IPC_RMID, NULL);
+        data = (MSG_DATA *)malloc(sizeof(MSG_DATA) + MSG_DATA_BUFFER_SIZE);
+        if (!data) {
+            return NULL;
+        }
     }
+    memset(data, 0, sizeof(MSG_DATA));
+    data->pooled = true;
+    data->pdu = data_buffer(data) + MSG_DATA_HEADROOM;
+
+    return data;
+}
+
+uint8_t *data_buffer(MSG_DATA *data)
+{
+    return (uint8_t *)(data + 1);
 }
 
 void free_data(MSG_DATA *data)
 {
+    BACMSG msg;
+
+    if (!data) {
+        return;
+    }
+    if (data->pooled) {
+        pthread_once(&Data_Pool_Once, data_pool_init);
+        msg.data = data;
+        if (!msgbox_put(&Data_Pool, &msg)) {
+            free(data);
+        }
+        return;
+    }
     if (data->pdu) {
         free(data->pdu);
         data->pdu = NULL;
     }
-    if (data) {
-        free(data);
-        data = NULL;
-    }
+    free(data);
 }
 
 void check_data(MSG_DATA *data)
 {
-    /* lock and decrement messages reference count */
-    pthread_mutex_lock(&msg_lock);
-    if (--data->ref_count == 0) {
+    /* decrement messages reference count */
+    if (__atomic_sub_fetch(&data->ref_count, 1, __ATOMIC_ACQ_REL) == 0) {
         free_data(data);
     }
-    pthread_mutex_unlock(&msg_lock);
 }
@@ -32,15 +32,29 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/msg.h>
+#include <sys/ipc.h> /* for IPC_NOWAIT */
 #include "bacnet/bacdef.h"
 #include "bacnet/npdu.h"
 
-extern pthread_mutex_t msg_lock;
-
 #define INVALID_MSGBOX_ID -1
 
+/* maximum number of message boxes */
+#ifndef MSGBOX_MAX
+#define MSGBOX_MAX 32
+#endif
+
+/* number of messages that a message box holds - a power of two */
+#ifndef MSGBOX_SIZE
+#define MSGBOX_SIZE 1024
+#endif
+
+/* room left in front of a received PDU of a pooled message, so that
+   the router can write a larger NPDU header without moving the APDU */
+#define MSG_DATA_HEADROOM MAX_NPDU
+/* size of the buffer of a pooled message: the headroom, a BVLC
+   Forwarded-NPDU header, and the largest NPDU and APDU */
+#define MSG_DATA_BUFFER_SIZE (MSG_DATA_HEADROOM + 10 + MAX_NPDU + 1476)
+
 typedef int MSGBOX_ID;
 
 typedef enum {
@@ -69,17 +83,19 @@ typedef struct _msg_data {
     uint8_t *pdu;
     uint16_t pdu_len;
     uint8_t ref_count;
+    /* true if allocated by alloc_data() - the PDU is in its buffer */
+    bool pooled;
 } MSG_DATA;
 
 MSGBOX_ID create_msgbox(
-    );
+    void);
 
-/* returns sent byte count */
+/* returns false if the message box is full */
 bool send_to_msgbox(
     MSGBOX_ID dest,
     BACMSG * msg);
 
-/* returns received message */
+/* returns received message, waits for one unless flags is IPC_NOWAIT */
 BACMSG *recv_from_msgbox(
     MSGBOX_ID src,
     BACMSG * msg,
@@ -88,6 +104,26 @@ BACMSG *recv_from_msgbox(
 void del_msgbox(
     MSGBOX_ID msgboxid);
 
+/* file descriptor that is readable when the message box is woken up */
+int msgbox_fd(
+    MSGBOX_ID msgboxid);
+
+/* returns true if the owner may wait on msgbox_fd() for a message */
+bool msgbox_wait_prepare(
+    MSGBOX_ID msgboxid);
+
+/* called by the owner when it has stopped waiting on msgbox_fd() */
+void msgbox_wait_done(
+    MSGBOX_ID msgboxid);
+
+/* get a message data structure with a buffer of MSG_DATA_BUFFER_SIZE */
+MSG_DATA *alloc_data(
+    void);
+
+/* buffer of a message data structure from alloc_data() */
+uint8_t *data_buffer(
+    MSG_DATA * data);
+
 /* free message data structure */
 void free_data(
     MSG_DATA * data);
@@ -143,14 +143,17 @@ void *dl_mstp_thread(void *pArgs)
         } else {
             pdu_len = dlmstp_receive(&mstp_port, NULL, NULL, 0, 5);
 
-            if (pdu_len > 0) {
-                msg_data = (MSG_DATA *)malloc(sizeof(MSG_DATA));
+            if ((pdu_len > 0) &&
+                (pdu_len <= (MSG_DATA_BUFFER_SIZE - MSG_DATA_HEADROOM))) {
+                msg_data = alloc_data();
+                if (!msg_data) {
+                    continue;
+                }
                 memmove(&(msg_data->src),
                     (const void *)&(shared_port_data.Receive_Packet.address),
                     sizeof(shared_port_data.Receive_Packet.address));
                 msg_data->src.adr[0] = msg_data->src.mac[0];
                 msg_data->src.len = 1;
-                msg_data->pdu = (uint8_t *)malloc(pdu_len);
                 memmove(msg_data->pdu,
                     (const void *)&(shared_port_data.Receive_Packet.pdu),
                     pdu_len);
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include "network_layer.h"
 #include "bacnet/bacint.h"
 
@@ -44,6 +45,8 @@ uint16_t process_network_message(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
     int apdu_len;
 
     memmove(data, msg->data, sizeof(MSG_DATA));
+    /* the reply is built in a buffer of its own */
+    data->pooled = false;
 
     apdu_offset = npdu_decode(data->pdu, &data->dest, NULL, &npdu_data);
     apdu_len = data->pdu_len - apdu_offset;
@@ -89,7 +92,7 @@ uint16_t process_network_message(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
             for (i = 0; i < net_count; i++) {
                 decode_unsigned16(&data->pdu[apdu_offset + 2 * i],
                     &net); /* decode received NET values */
-                add_dnet(&srcport->route_info, net,
+                add_dnet(srcport, net,
                     data->src); /* and update routing table */
             }
             break;
@@ -99,6 +102,11 @@ uint16_t process_network_message(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
             /* next two octets contain NET (can be decoded for additional info
              * on error) */
             error_code = data->pdu[apdu_offset];
+            if ((error_code == 1) && (apdu_len >= 3)) {
+                /* the route through the other router is gone */
+                decode_unsigned16(&data->pdu[apdu_offset + 1], &net);
+                remove_dnet(net);
+            }
             switch (error_code) {
                 case 0:
                     PRINT(ERROR, "Error!\n");
@@ -126,7 +134,7 @@ uint16_t process_network_message(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
                     int i = 1;
                     decode_unsigned16(&data->pdu[apdu_offset + i],
                         &net); /* decode received NET values */
-                    add_dnet(&srcport->route_info, net,
+                    add_dnet(srcport, net,
                         data->src); /* and update routing table */
                     if (data->pdu[apdu_offset + i + 3] >
                         0) /* find next NET value */
@@ -149,7 +157,7 @@ uint16_t process_network_message(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
                     int i = 1;
                     decode_unsigned16(&data->pdu[apdu_offset + i],
                         &net); /* decode received NET values */
-                    add_dnet(&srcport->route_info, net,
+                    add_dnet(srcport, net,
                         data->src); /* and update routing table */
                     if (data->pdu[apdu_offset + i + 3] >
                         0) /* find next NET value */
@@ -160,10 +168,32 @@ uint16_t process_network_message(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
             }
             break;
 
+        case NETWORK_MESSAGE_ROUTER_BUSY_TO_NETWORK:
+        case NETWORK_MESSAGE_ROUTER_AVAILABLE_TO_NETWORK: {
+            DNET_STATE state = DNET_REACHABLE;
+            int net_count = apdu_len / 2;
+            int i;
+
+            if (npdu_data.network_message_type ==
+                NETWORK_MESSAGE_ROUTER_BUSY_TO_NETWORK) {
+                PRINT(INFO, "Recieved Router-Busy-To-Network message\n");
+                state = DNET_BUSY;
+            } else {
+                PRINT(INFO, "Recieved Router-Available-To-Network message\n");
+            }
+            if (net_count == 0) {
+                /* every NET reached through the router */
+                set_dnet_state(srcport, BACNET_BROADCAST_NETWORK, &data->src,
+                    state);
+            }
+            for (i = 0; i < net_count; i++) {
+                decode_unsigned16(&data->pdu[apdu_offset + 2 * i], &net);
+                set_dnet_state(srcport, net, &data->src, state);
+            }
+            break;
+        }
         case NETWORK_MESSAGE_INVALID:
         case NETWORK_MESSAGE_I_COULD_BE_ROUTER_TO_NETWORK:
-        case NETWORK_MESSAGE_ROUTER_BUSY_TO_NETWORK:
-        case NETWORK_MESSAGE_ROUTER_AVAILABLE_TO_NETWORK:
         case NETWORK_MESSAGE_ESTABLISH_CONNECTION_TO_NETWORK:
         case NETWORK_MESSAGE_DISCONNECT_CONNECTION_TO_NETWORK:
             /* hell if I know what to do with these messages */
@@ -206,7 +236,8 @@ uint16_t create_network_message(
         data_expecting_reply = true;
     init_npdu(&npdu_data, network_message_type, data_expecting_reply);
 
-    *buff = (uint8_t *)malloc(128); /* resolve different length */
+    /* room for the NETs of a large routing table */
+    *buff = (uint8_t *)malloc(MAX_PDU);
 
     /* manual destination setup for Init-RT-Table-Ack message */
     data->dest.net = BACNET_BROADCAST_NETWORK;
@@ -227,28 +258,16 @@ uint16_t create_network_message(
                 uint16_t val16 = (valptr[0]) + (valptr[1] << 8);
                 buff_len += encode_unsigned16(*buff + buff_len, val16);
             } else {
-                ROUTER_PORT *port = head;
+                /* every reachable NET, except the one it is sent to */
                 DNET *dnet;
-                while (port != NULL) {
-                    if (port->route_info.net != data->src.net) {
-                        buff_len += encode_unsigned16(
-                            *buff + buff_len, port->route_info.net);
-                        dnet = port->route_info.dnets;
-                        while (dnet != NULL) {
-                            buff_len +=
-                                encode_unsigned16(*buff + buff_len, dnet->net);
-                            dnet = dnet->next;
-                        }
-                        port = port->next;
-                    } else {
-                        dnet = port->route_info.dnets;
-                        while (dnet != NULL) {
-                            buff_len +=
-                                encode_unsigned16(*buff + buff_len, dnet->net);
-                            dnet = dnet->next;
-                        }
-                        port = port->next;
-                    }
+                unsigned i;
+                for (i = 0; i < dnet_count(); i++) {
+                    dnet = dnet_by_index(i);
+                    if ((dnet->learned == 0) && (dnet->net == data->src.net))
+                        continue;
+                    if ((buff_len + 2) > MAX_PDU)
+                        break;
+                    buff_len += encode_unsigned16(*buff + buff_len, dnet->net);
                 }
             }
             break;
@@ -319,6 +338,8 @@ void send_network_message(BACNET_NETWORK_MESSAGE_TYPE network_message_type,
 
     if (!data) {
         data = (MSG_DATA *)malloc(sizeof(MSG_DATA));
+        data->pooled = false;
+        data->src.net = 0;
         data->dest.net = BACNET_BROADCAST_NETWORK;
         data->dest.len = 0;
     }
@@ -343,6 +364,202 @@ void send_network_message(BACNET_NETWORK_MESSAGE_TYPE network_message_type,
     }
 }
 
+uint16_t process_msg(BACMSG *msg, MSG_DATA *data, uint8_t **buff)
+{
+    MSG_DATA *received = (MSG_DATA *)msg->data;
+    BACNET_ADDRESS addr;
+    BACNET_NPDU_DATA npdu_data;
+    ROUTER_PORT *srcport;
+    ROUTER_PORT *destport;
+    uint8_t npdu[MAX_NPDU];
+    int16_t buff_len = 0;
+    int apdu_offset;
+    int apdu_len;
+    int npdu_len;
+
+    if (data != received) {
+        memmove(data, received, sizeof(MSG_DATA));
+    }
+
+    apdu_offset = npdu_decode(data->pdu, &data->dest, &addr, &npdu_data);
+    apdu_len = data->pdu_len - apdu_offset;
+
+    srcport = find_snet(msg->origin);
+    destport = find_dnet(data->dest.net, NULL);
+    assert(srcport);
+
+    if (destport && (data->dest.net != BACNET_BROADCAST_NETWORK) &&
+        (find_route(data->dest.net)->state == DNET_BUSY)) {
+        PRINT(INFO, "Message discarded: NET busy\n");
+        if (data != received) {
+            data->pdu = NULL;
+            free_data(received);
+        }
+        return -2;
+    }
+
+    if (srcport && destport) {
+        data->src.net = srcport->route_info.net;
+
+        /* if received from another router save real source address (not other
+         * router source address) */
+        if (addr.net > 0 && addr.net < BACNET_BROADCAST_NETWORK &&
+            data->src.net != addr.net)
+            memmove(&data->src, &addr, sizeof(BACNET_ADDRESS));
+
+        /* encode both source and destination for broadcast and router-to-router
+         * communication */
+        if (data->dest.net == BACNET_BROADCAST_NETWORK ||
+            destport->route_info.net != data->dest.net) {
+            npdu_len =
+                npdu_encode_pdu(npdu, &data->dest, &data->src, &npdu_data);
+        } else {
+            npdu_len = npdu_encode_pdu(npdu, NULL, &data->src, &npdu_data);
+        }
+
+        buff_len = npdu_len + data->pdu_len - apdu_offset;
+
+        if (data->pooled) {
+            /* the headroom in front of the received PDU leaves room for
+               the largest NPDU, so the APDU is not moved */
+            *buff = data->pdu + apdu_offset - npdu_len;
+            memmove(*buff, npdu, npdu_len); /* copy newly formed NPDU */
+            return buff_len;
+        }
+
+        *buff = (uint8_t *)malloc(buff_len);
+        memmove(*buff, npdu, npdu_len); /* copy newly formed NPDU */
+        memmove(*buff + npdu_len, &data->pdu[apdu_offset],
+            apdu_len); /* copy APDU */
+
+    } else {
+        /* request net search */
+        return -1;
+    }
+
+    /* delete received message */
+    if (data != received) {
+        free_data(received);
+    }
+
+    return buff_len;
+}
+
+bool is_network_msg(BACMSG *msg)
+{
+    uint8_t control_byte; /* NPDU control byte */
+    MSG_DATA *data = (MSG_DATA *)msg->data;
+
+    control_byte = data->pdu[1];
+
+    return control_byte & 0x80; /* check 7th bit */
+}
+
+void route_message(BACMSG *bacmsg)
+{
+    ROUTER_PORT *port;
+    BACMSG msg_storage;
+    MSGBOX_ID msg_src = bacmsg->origin;
+    MSG_DATA *received = (MSG_DATA *)bacmsg->data;
+    MSG_DATA *msg_data = NULL;
+    uint8_t *buff = NULL;
+    int16_t buff_len = 0;
+    uint16_t net;
+    DNET *route;
+
+    age_dnets(time(NULL));
+
+    if (is_network_msg(bacmsg)) {
+        msg_data = (MSG_DATA *)malloc(sizeof(MSG_DATA));
+        if (!msg_data) {
+            PRINT(ERROR, "Error: Could not allocate memory\n");
+            free_data(received);
+            return;
+        }
+        buff_len = process_network_message(bacmsg, msg_data, &buff);
+        /* the reply, if any, is in buff */
+        msg_data->pdu = NULL;
+        free_data(received);
+        received = NULL;
+        if (buff_len == 0) {
+            free_data(msg_data);
+            return;
+        }
+    } else if (received->pooled) {
+        /* route the message in the buffer it was received in */
+        msg_data = received;
+        buff_len = process_msg(bacmsg, msg_data, &buff);
+    } else {
+        msg_data = (MSG_DATA *)malloc(sizeof(MSG_DATA));
+        if (!msg_data) {
+            PRINT(ERROR, "Error: Could not allocate memory\n");
+            free_data(received);
+            return;
+        }
+        buff_len = process_msg(bacmsg, msg_data, &buff);
+    }
+
+    /* if buff_len */
+    /* >0 - form new message and send */
+    /* =-1 - try to find next router */
+    /* other value - discard message */
+
+    if (buff_len > 0) {
+        /* form new message */
+        msg_data->pdu = buff;
+        msg_data->pdu_len = buff_len;
+        msg_storage.origin = head->main_id;
+        msg_storage.type = DATA;
+        msg_storage.data = msg_data;
+
+        if (is_network_msg(&msg_storage)) {
+            msg_data->ref_count = 1;
+            if (!send_to_msgbox(msg_src, &msg_storage)) {
+                check_data(msg_data);
+            }
+        } else if (msg_data->dest.net != BACNET_BROADCAST_NETWORK) {
+            msg_data->ref_count = 1;
+            port = find_dnet(msg_data->dest.net, &msg_data->dest);
+            route = find_route(msg_data->dest.net);
+            route->packets++;
+            route->octets += msg_data->pdu_len;
+            if (!send_to_msgbox(port->port_id, &msg_storage)) {
+                check_data(msg_data);
+            }
+        } else {
+            port = head;
+            msg_data->ref_count = port_count - 1;
+            while (port != NULL) {
+                if (port->port_id == msg_src || port->state == FINISHED) {
+                    port = port->next;
+                    continue;
+                }
+                if (!send_to_msgbox(port->port_id, &msg_storage)) {
+                    check_data(msg_data);
+                }
+                port = port->next;
+            }
+        }
+    } else if (buff_len == -1) {
+        net = msg_data->dest.net; /* NET to find */
+        if (msg_data != received) {
+            msg_data->pdu = NULL;
+            free_data(msg_data);
+        }
+        free_data(received);
+        PRINT(INFO, "Searching NET...\n");
+        send_network_message(
+            NETWORK_MESSAGE_WHO_IS_ROUTER_TO_NETWORK, NULL, &buff, &net);
+    } else {
+        /* if invalid message send Reject-Message-To-Network */
+        PRINT(ERROR, "Error: Invalid message\n");
+        if (!msg_data->pooled) {
+            msg_data->pdu = buff;
+        }
+        free_data(msg_data);
+    }
+}
+
 void init_npdu(BACNET_NPDU_DATA *npdu_data,
     BACNET_NETWORK_MESSAGE_TYPE network_message_type,
     bool data_expecting_reply)
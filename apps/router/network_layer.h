@@ -57,6 +57,19 @@ void send_network_message(
     uint8_t ** buff,
     void *val);
 
+/* form the NPDU of an application message for its destination port */
+uint16_t process_msg(
+    BACMSG * msg,
+    MSG_DATA * data,
+    uint8_t ** buff);
+
+bool is_network_msg(
+    BACMSG * msg);
+
+/* process a message received by a port, and send it on to other ports */
+void route_message(
+    BACMSG * msg);
+
 void init_npdu(
     BACNET_NPDU_DATA * npdu_data,
     BACNET_NETWORK_MESSAGE_TYPE network_message_type,
@@ -30,6 +30,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "portthread.h"
+#include "bacnet/basic/sys/keytable.h"
+
+/* routing table, hashed by network number */
+static KEYTABLE DNET_Table;
+static DNET *DNET_Routes;
+static bool DNET_Table_Ready;
 
 ROUTER_PORT *find_snet(MSGBOX_ID id)
 {
@@ -47,75 +53,170 @@ ROUTER_PORT *find_snet(MSGBOX_ID id)
 
 ROUTER_PORT *find_dnet(uint16_t net, BACNET_ADDRESS *addr)
 {
-    ROUTER_PORT *port = head;
-    DNET *dnet;
+    DNET *route;
 
     /* for broadcast messages no search is needed */
     if (net == BACNET_BROADCAST_NETWORK)
-        return port;
+        return head;
 
-    while (port != NULL) {
-        /* check if DNET is directly connected to the router */
-        if (net == port->route_info.net)
-            return port;
+    route = find_route(net);
+    if (route == NULL)
+        return NULL;
 
-        /* else search router ports DNET list */
-        else if (port->route_info.dnets) {
-            dnet = port->route_info.dnets;
-            while (dnet != NULL) {
-                if (net == dnet->net) {
-                    if (addr) {
-                        memmove(&addr->len, &dnet->mac_len, 1);
-                        memmove(&addr->adr[0], &dnet->mac[0], MAX_MAC_LEN);
-                    }
-                    return port;
-                }
-                dnet = dnet->next;
-            }
-        }
-        port = port->next;
+    /* networks beyond another router are sent to that router */
+    if (addr && route->learned) {
+        memmove(&addr->len, &route->mac_len, 1);
+        memmove(&addr->adr[0], &route->mac[0], MAX_MAC_LEN);
     }
 
-    return NULL;
+    return route->port;
 }
 
-void add_dnet(RT_ENTRY *route_info, uint16_t net, BACNET_ADDRESS addr)
+static void dnet_table_init(void)
 {
-    DNET *dnet = route_info->dnets;
-    DNET *tmp;
-
-    if (dnet == NULL) {
-        route_info->dnets = (DNET *)malloc(sizeof(DNET));
-        memmove(&route_info->dnets->mac_len, &addr.len, 1);
-        memmove(&route_info->dnets->mac[0], &addr.adr[0], MAX_MAC_LEN);
-        route_info->dnets->net = net;
-        route_info->dnets->state = true;
-        route_info->dnets->next = NULL;
-    } else {
-        while (dnet != NULL) {
-            if (dnet->net == net) { /* make sure NETs are not repeated */
-                return;
-            }
-            tmp = dnet;
-            dnet = dnet->next;
-        }
+    if (!DNET_Table_Ready) {
+        Keytable_Init(&DNET_Table);
+        Keytable_Column_Add(&DNET_Table, (void **)&DNET_Routes, sizeof(DNET));
+        DNET_Table_Ready = true;
+    }
+}
+
+DNET *find_route(uint16_t net)
+{
+    uint32_t index;
+
+    index = Keytable_Index(&DNET_Table, net);
+    if (index == KEYTABLE_INDEX_NONE)
+        return NULL;
+
+    return &DNET_Routes[index];
+}
+
+bool add_port_dnet(ROUTER_PORT *port)
+{
+    uint16_t net = port->route_info.net;
+    uint32_t index;
+    DNET *route;
+
+    dnet_table_init();
+    index = Keytable_Index(&DNET_Table, net);
+    if (index == KEYTABLE_INDEX_NONE) {
+        index = Keytable_Add(&DNET_Table, net);
+        if (index == KEYTABLE_INDEX_NONE)
+            return false;
+    }
+    route = &DNET_Routes[index];
+    memset(route, 0, sizeof(DNET));
+    route->net = net;
+    route->state = DNET_REACHABLE;
+    route->port = port;
+
+    return true;
+}
+
+void add_dnet(ROUTER_PORT *port, uint16_t net, BACNET_ADDRESS addr)
+{
+    uint32_t index;
+    DNET *route;
+
+    if ((net == 0) || (net == BACNET_BROADCAST_NETWORK))
+        return;
+
+    dnet_table_init();
+    index = Keytable_Index(&DNET_Table, net);
+    if (index == KEYTABLE_INDEX_NONE) {
+        index = Keytable_Add(&DNET_Table, net);
+        if (index == KEYTABLE_INDEX_NONE)
+            return;
+    } else if (DNET_Routes[index].learned == 0) {
+        /* directly connected NETs are not learned */
+        return;
+    }
 
-        dnet = (DNET *)malloc(sizeof(DNET));
-        memmove(&dnet->mac_len, &addr.len, 1);
-        memmove(&dnet->mac[0], &addr.adr[0], MAX_MAC_LEN);
-        dnet->net = net;
-        dnet->state = true;
-        dnet->next = NULL;
-        tmp->next = dnet;
+    /* a route that is announced again is refreshed, or moved to
+       the router that announced it */
+    route = &DNET_Routes[index];
+    memmove(&route->mac_len, &addr.len, 1);
+    memmove(&route->mac[0], &addr.adr[0], MAX_MAC_LEN);
+    route->net = net;
+    route->state = DNET_REACHABLE;
+    route->port = port;
+    route->learned = time(NULL);
+}
+
+void remove_dnet(uint16_t net)
+{
+    DNET *route;
+
+    route = find_route(net);
+    if (route && route->learned) {
+        Keytable_Delete(&DNET_Table, net);
     }
 }
 
-void cleanup_dnets(DNET *dnets)
+void set_dnet_state(
+    ROUTER_PORT *port, uint16_t net, BACNET_ADDRESS *addr, DNET_STATE state)
 {
-    DNET *dnet = dnets;
-    while (dnet != NULL) {
-        dnet = dnet->next;
-        free(dnets);
-        dnets = dnet;
+    DNET *route;
+    uint32_t i;
+
+    if (net != BACNET_BROADCAST_NETWORK) {
+        route = find_route(net);
+        if (route && route->learned) {
+            route->state = state;
+        }
+        return;
+    }
+    /* every NET reached through the router */
+    for (i = 0; i < Keytable_Count(&DNET_Table); i++) {
+        route = &DNET_Routes[i];
+        if (route->learned && (route->port == port) &&
+            (route->mac_len == addr->len) &&
+            (memcmp(route->mac, addr->adr, route->mac_len) == 0)) {
+            route->state = state;
+        }
+    }
+}
+
+void age_dnets(time_t now)
+{
+    static time_t last_aged;
+    DNET *route;
+    uint32_t i;
+
+    if (now == last_aged)
+        return;
+    last_aged = now;
+
+    /* deleting moves the last entry into the hole, so go backwards */
+    for (i = Keytable_Count(&DNET_Table); i > 0; i--) {
+        route = &DNET_Routes[i - 1];
+        if (route->learned == 0)
+            continue;
+        if (route->learned > now) {
+            /* the clock was set back */
+            route->learned = now;
+        } else if ((now - route->learned) >= DNET_AGE_MAX) {
+            PRINT(INFO, "Route to NET %hu expired\n", route->net);
+            Keytable_Delete(&DNET_Table, route->net);
+        }
     }
 }
+
+unsigned dnet_count(void)
+{
+    return Keytable_Count(&DNET_Table);
+}
+
+DNET *dnet_by_index(unsigned index)
+{
+    if (index < Keytable_Count(&DNET_Table))
+        return &DNET_Routes[index];
+
+    return NULL;
+}
+
+void cleanup_dnets(void)
+{
+    Keytable_Clear(&DNET_Table);
+}
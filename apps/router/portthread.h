@@ -32,6 +32,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <time.h>
 #include "msgqueue.h"
 #include "bacnet/bacdef.h"
 #include "bacnet/npdu.h"
@@ -40,7 +41,9 @@
 #define INFO 2
 #define DEBUG 3
 
+#ifndef DEBUG_LEVEL
 #define DEBUG_LEVEL 3
+#endif
 #ifdef DEBUG_LEVEL
 #define PRINT(debug_level, ...) if(debug_level <= DEBUG_LEVEL) fprintf(stderr, __VA_ARGS__)
 #else
@@ -85,13 +88,28 @@ typedef union _port_params {
     } mstp_params;
 } PORT_PARAMS;
 
-/* list node for reacheble networks */
+/* seconds after which a learned route that was not announced again
+   is removed, and found again with Who-Is-Router-To-Network */
+#ifndef DNET_AGE_MAX
+#define DNET_AGE_MAX 3600
+#endif
+
+/* state of a route to a network */
+typedef enum {
+    DNET_REACHABLE,
+    DNET_BUSY /* Router-Busy-To-Network was received */
+} DNET_STATE;
+
+/* entry of the routing table for a reachable network */
 typedef struct _dnet {
-    uint8_t mac[MAX_MAC_LEN];
+    uint8_t mac[MAX_MAC_LEN]; /* next router, or empty if directly connected */
     uint8_t mac_len;
     uint16_t net;
-    bool state; /* enabled or disabled */
-    struct _dnet *next;
+    DNET_STATE state;
+    struct _port *port; /* router port that the network is reached through */
+    time_t learned; /* last announced, or zero if directly connected */
+    uint32_t packets; /* NPDUs routed to the network */
+    uint32_t octets;
 } DNET;
 
 /* information for routing table */
@@ -99,7 +117,6 @@ typedef struct _routing_table_entry {
     uint8_t mac[MAX_MAC_LEN];
     uint8_t mac_len;
     uint16_t net;
-    DNET *dnets;
 } RT_ENTRY;
 
 typedef struct _port {
@@ -126,13 +143,46 @@ ROUTER_PORT *find_dnet(
     uint16_t net,
     BACNET_ADDRESS * addr);
 
-/* add reacheble network for specified router port */
+/* get the routing table entry of a network, or NULL if not reachable.
+   The entry is valid until the routing table is changed. */
+DNET *find_route(
+    uint16_t net);
+
+/* add the directly connected network of a router port */
+bool add_port_dnet(
+    ROUTER_PORT * port);
+
+/* add or refresh a network that is reachable through a router port */
 void add_dnet(
-    RT_ENTRY * route_info,
+    ROUTER_PORT * port,
     uint16_t net,
     BACNET_ADDRESS addr);
 
+/* remove a network that is reached through another router */
+void remove_dnet(
+    uint16_t net);
+
+/* set the state of one network, or of every network reached through
+   the router at addr if net is BACNET_BROADCAST_NETWORK */
+void set_dnet_state(
+    ROUTER_PORT * port,
+    uint16_t net,
+    BACNET_ADDRESS * addr,
+    DNET_STATE state);
+
+/* remove the learned routes that were not announced for DNET_AGE_MAX */
+void age_dnets(
+    time_t now);
+
+/* number of entries in the routing table */
+unsigned dnet_count(
+    void);
+
+/* routing table entry by index, 0 to dnet_count() - 1 */
+DNET *dnet_by_index(
+    unsigned index);
+
 void cleanup_dnets(
-    DNET * dnets);
+    void);
 
 #endif /* end of PORTTHREAD_H */
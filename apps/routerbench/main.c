@@ -0,0 +1,303 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* command line tool that measures how many NPDUs per second the router
+   forwards between two BACnet/IP ports on the loopback interface.
+   A client sends unicast NPDUs for network 2 to the port of network 1,
+   and counts them as they arrive from the port of network 2, keeping a
+   window of NPDUs in flight. */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "bacnet/bacint.h"
+#include "bacnet/npdu.h"
+#include "bacnet/datalink/bvlc.h"
+#include "msgqueue.h"
+#include "portthread.h"
+#include "network_layer.h"
+#include "ipmodule.h"
+
+/* UDP ports of the router ports, and of the client */
+#define ROUTER_BENCH_PORT_1 47900
+#define ROUTER_BENCH_PORT_2 47901
+#define ROUTER_BENCH_SEND_PORT 47950
+#define ROUTER_BENCH_SINK_PORT 47951
+/* milliseconds without an NPDU after which those in flight are lost */
+#define ROUTER_BENCH_TIMEOUT 100
+
+ROUTER_PORT *head = NULL; /* pointer to list of router ports */
+
+int port_count;
+
+static pthread_t Port_Threads[2];
+static pthread_t Route_Thread;
+
+/**
+ * @brief Route the messages received by the ports until shutdown
+ * @param pArgs - message box of the router
+ */
+static void *router_bench_route_thread(void *pArgs)
+{
+    MSGBOX_ID main_id = *(MSGBOX_ID *)pArgs;
+    BACMSG msg_storage, *bacmsg = NULL;
+
+    for (;;) {
+        bacmsg = recv_from_msgbox(main_id, &msg_storage, 0);
+        if (!bacmsg) {
+            break;
+        }
+        if (bacmsg->type == DATA) {
+            route_message(bacmsg);
+        } else if ((bacmsg->type == SERVICE) &&
+            (bacmsg->subtype == SHUTDOWN)) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Start a BACnet/IP router port on the loopback interface
+ * @param index - index of the port thread
+ * @param main_id - message box of the router
+ * @param net - network number of the port
+ * @param udp_port - UDP port number of the port
+ * @return true if the port is running
+ */
+static bool router_bench_port_init(
+    unsigned index, MSGBOX_ID main_id, uint16_t net, uint16_t udp_port)
+{
+    ROUTER_PORT *port;
+    ROUTER_PORT **tail = &head;
+
+    port = calloc(1, sizeof(ROUTER_PORT));
+    if (!port) {
+        return false;
+    }
+    port->type = BIP;
+    port->state = INIT;
+    port->main_id = main_id;
+    port->port_id = INVALID_MSGBOX_ID;
+    port->iface = "lo";
+    port->func = dl_ip_thread;
+    port->route_info.net = net;
+    port->params.bip_params.port = udp_port;
+    if (!add_port_dnet(port)) {
+        free(port);
+        return false;
+    }
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = port;
+    port_count++;
+    if (pthread_create(&Port_Threads[index], NULL, port->func, port) != 0) {
+        return false;
+    }
+    while (__atomic_load_n(&port->state, __ATOMIC_ACQUIRE) == INIT) {
+        usleep(1000);
+    }
+
+    return (port->state == RUNNING);
+}
+
+/**
+ * @brief Stop the ports and the routing thread
+ * @param main_id - message box of the router
+ * @param threads - number of port threads that were started
+ */
+static void router_bench_cleanup(MSGBOX_ID main_id, unsigned threads)
+{
+    ROUTER_PORT *port;
+    BACMSG msg = { 0 };
+    unsigned i;
+
+    msg.origin = main_id;
+    msg.type = SERVICE;
+    msg.subtype = SHUTDOWN;
+    send_to_msgbox(main_id, &msg);
+    pthread_join(Route_Thread, NULL);
+    for (port = head; port; port = port->next) {
+        if (port->state == RUNNING) {
+            send_to_msgbox(port->port_id, &msg);
+        }
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(Port_Threads[i], NULL);
+    }
+    del_msgbox(main_id);
+    while (head) {
+        port = head->next;
+        free(head);
+        head = port;
+    }
+    cleanup_dnets();
+}
+
+/**
+ * @brief Open a UDP socket on the loopback interface
+ * @param udp_port - UDP port number to bind to
+ * @return the socket, or -1 on failure
+ */
+static int router_bench_socket(uint16_t udp_port)
+{
+    struct sockaddr_in sin = { 0 };
+    int sock_fd;
+    int size = 1024 * 1024;
+
+    sock_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    setsockopt(sock_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sin.sin_port = htons(udp_port);
+    if (bind(sock_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+        close(sock_fd);
+        return -1;
+    }
+
+    return sock_fd;
+}
+
+/**
+ * @brief Encode a BACnet/IP packet of an NPDU for network 2,
+ *  addressed to the sink socket.
+ * @param mtu - buffer for the packet
+ * @return length of the packet
+ */
+static int router_bench_encode(uint8_t *mtu)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data;
+    uint32_t addr = htonl(INADDR_LOOPBACK);
+    uint16_t port = htons(ROUTER_BENCH_SINK_PORT);
+    int len;
+    int i;
+
+    dest.net = 2;
+    dest.len = 6;
+    memcpy(&dest.adr[0], &addr, 4);
+    memcpy(&dest.adr[4], &port, 2);
+    npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    len = 4 + npdu_encode_pdu(&mtu[4], &dest, NULL, &npdu_data);
+    /* an unconfirmed service request with some payload */
+    mtu[len++] = PDU_TYPE_UNCONFIRMED_SERVICE_REQUEST;
+    mtu[len++] = SERVICE_UNCONFIRMED_PRIVATE_TRANSFER;
+    for (i = 0; i < 64; i++) {
+        mtu[len++] = (uint8_t)i;
+    }
+    mtu[0] = BVLL_TYPE_BACNET_IP;
+    mtu[1] = BVLC_ORIGINAL_UNICAST_NPDU;
+    encode_unsigned16(&mtu[2], (uint16_t)len);
+
+    return len;
+}
+
+static double router_bench_seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1000000000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    MSGBOX_ID main_id;
+    struct sockaddr_in router = { 0 };
+    struct pollfd fds;
+    uint8_t mtu[MAX_BIP_MPDU];
+    uint8_t rx_buf[MAX_BIP_MPDU];
+    unsigned long count = 100000;
+    unsigned long window = 64;
+    unsigned long sent = 0;
+    unsigned long received = 0;
+    unsigned long lost = 0;
+    unsigned threads = 0;
+    int send_fd, sink_fd;
+    int mtu_len;
+    double start, elapsed;
+
+    if (argc > 1) {
+        count = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        window = strtoul(argv[2], NULL, 0);
+    }
+    if ((count == 0) || (window == 0)) {
+        printf("Usage: %s [count [window]]\n"
+               "Route count NPDUs between two BACnet/IP ports on the "
+               "loopback interface,\nwith at most window NPDUs in flight.\n",
+            argv[0]);
+        return 1;
+    }
+    main_id = create_msgbox();
+    if (main_id == INVALID_MSGBOX_ID) {
+        fprintf(stderr, "Failed to create message box\n");
+        return 1;
+    }
+    if (router_bench_port_init(0, main_id, 1, ROUTER_BENCH_PORT_1)) {
+        threads++;
+        if (router_bench_port_init(1, main_id, 2, ROUTER_BENCH_PORT_2)) {
+            threads++;
+        }
+    }
+    pthread_create(&Route_Thread, NULL, router_bench_route_thread, &main_id);
+    send_fd = router_bench_socket(ROUTER_BENCH_SEND_PORT);
+    sink_fd = router_bench_socket(ROUTER_BENCH_SINK_PORT);
+    if ((threads < 2) || (send_fd < 0) || (sink_fd < 0)) {
+        fprintf(stderr, "Failed to open the ports on the loopback "
+                        "interface.\n");
+        router_bench_cleanup(main_id, threads);
+        return 1;
+    }
+    router.sin_family = AF_INET;
+    router.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    router.sin_port = htons(ROUTER_BENCH_PORT_1);
+    mtu_len = router_bench_encode(mtu);
+    fds.fd = sink_fd;
+    fds.events = POLLIN;
+    start = router_bench_seconds();
+    while ((received + lost) < count) {
+        while ((sent < count) && ((sent - received - lost) < window)) {
+            if (sendto(send_fd, mtu, mtu_len, 0, (struct sockaddr *)&router,
+                    sizeof(router)) < 0) {
+                break;
+            }
+            sent++;
+        }
+        fds.revents = 0;
+        if (poll(&fds, 1, ROUTER_BENCH_TIMEOUT) <= 0) {
+            lost = sent - received;
+            continue;
+        }
+        while (recv(sink_fd, rx_buf, sizeof(rx_buf), MSG_DONTWAIT) > 0) {
+            received++;
+        }
+    }
+    elapsed = router_bench_seconds() - start;
+    printf("%lu NPDUs routed in %.3f seconds: %.0f NPDUs/second, "
+           "%lu lost\n",
+        received, elapsed, elapsed > 0.0 ? (double)received / elapsed : 0.0,
+        lost);
+    close(send_fd);
+    close(sink_fd);
+    router_bench_cleanup(main_id, threads);
+
+    return 0;
+}
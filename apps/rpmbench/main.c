@@ -0,0 +1,552 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* command line tool that measures how many objects per second
+   a ReadPropertyMultiple moves, with and without segmentation */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define PRINT_ENABLED 1
+
+#include "bacnet/bacdef.h"
+#include "bacnet/config.h"
+#include "bacnet/bactext.h"
+#include "bacnet/bits.h"
+#include "bacnet/apdu.h"
+#include "bacnet/npdu.h"
+#include "bacnet/rpm.h"
+#include "bacnet/dcc.h"
+#include "bacnet/version.h"
+#include "bacnet/basic/binding/address.h"
+#include "bacnet/basic/object/device.h"
+#include "bacnet/basic/services.h"
+#include "bacnet/basic/sys/filename.h"
+#include "bacnet/basic/sys/mstimer.h"
+#include "bacnet/basic/tsm/tsm.h"
+#include "bacnet/datalink/datalink.h"
+#include "bacnet/datalink/dlenv.h"
+#include "bacport.h"
+
+/* buffer used for receive */
+static uint8_t Rx_Buf[MAX_MPDU] = { 0 };
+/* buffer used for the requests */
+static uint8_t Tx_Buf[MAX_PDU] = { 0 };
+
+/* global variables used in this file */
+static uint32_t Target_Device_Object_Instance = BACNET_MAX_INSTANCE;
+static BACNET_ADDRESS Target_Address;
+static unsigned Target_Max_APDU = 0;
+/* the objects being read, one list entry per object */
+static BACNET_READ_ACCESS_DATA *Read_Access_Data;
+static BACNET_PROPERTY_REFERENCE *Read_Property_Data;
+static unsigned Object_Count = 0;
+/* status of the request in progress */
+static uint8_t Request_Invoke_ID = 0;
+static bool Request_Complete = false;
+static bool Request_Aborted = false;
+static bool Error_Detected = false;
+static unsigned Objects_Received = 0;
+
+static void MyErrorHandler(BACNET_ADDRESS *src,
+    uint8_t invoke_id,
+    BACNET_ERROR_CLASS error_class,
+    BACNET_ERROR_CODE error_code)
+{
+    if (address_match(&Target_Address, src) &&
+        (invoke_id == Request_Invoke_ID)) {
+        printf("BACnet Error: %s: %s\n",
+            bactext_error_class_name((int)error_class),
+            bactext_error_code_name((int)error_code));
+        Error_Detected = true;
+        Request_Complete = true;
+    }
+}
+
+static void MyAbortHandler(
+    BACNET_ADDRESS *src, uint8_t invoke_id, uint8_t abort_reason, bool server)
+{
+    (void)server;
+    if (address_match(&Target_Address, src) &&
+        (invoke_id == Request_Invoke_ID)) {
+        if ((abort_reason == ABORT_REASON_SEGMENTATION_NOT_SUPPORTED) ||
+            (abort_reason == ABORT_REASON_BUFFER_OVERFLOW)) {
+            /* the reply did not fit - the caller may try smaller requests */
+            Request_Aborted = true;
+        } else {
+            printf("BACnet Abort: %s\n",
+                bactext_abort_reason_name((int)abort_reason));
+            Error_Detected = true;
+        }
+        Request_Complete = true;
+    }
+}
+
+static void MyRejectHandler(
+    BACNET_ADDRESS *src, uint8_t invoke_id, uint8_t reject_reason)
+{
+    if (address_match(&Target_Address, src) &&
+        (invoke_id == Request_Invoke_ID)) {
+        printf("BACnet Reject: %s\n",
+            bactext_reject_reason_name((int)reject_reason));
+        Error_Detected = true;
+        Request_Complete = true;
+    }
+}
+
+static void rpm_data_free(BACNET_READ_ACCESS_DATA *rpm_data)
+{
+    BACNET_READ_ACCESS_DATA *old_rpm_data;
+    BACNET_PROPERTY_REFERENCE *rpm_property;
+    BACNET_PROPERTY_REFERENCE *old_rpm_property;
+    BACNET_APPLICATION_DATA_VALUE *value;
+    BACNET_APPLICATION_DATA_VALUE *old_value;
+
+    while (rpm_data) {
+        rpm_property = rpm_data->listOfProperties;
+        while (rpm_property) {
+            value = rpm_property->value;
+            while (value) {
+                old_value = value;
+                value = value->next;
+                free(old_value);
+            }
+            old_rpm_property = rpm_property;
+            rpm_property = rpm_property->next;
+            free(old_rpm_property);
+        }
+        old_rpm_data = rpm_data;
+        rpm_data = rpm_data->next;
+        free(old_rpm_data);
+    }
+}
+
+/** Handler for a ReadPropertyMultiple ACK.
+ * Decodes the ACK and counts the objects that came back.
+ *
+ * @param service_request [in] The contents of the service request.
+ * @param service_len [in] The length of the service_request.
+ * @param src [in] BACNET_ADDRESS of the source of the message
+ * @param service_data [in] The BACNET_CONFIRMED_SERVICE_DATA information
+ *                          decoded from the APDU header of this message.
+ */
+static void My_Read_Property_Multiple_Ack_Handler(uint8_t *service_request,
+    uint16_t service_len,
+    BACNET_ADDRESS *src,
+    BACNET_CONFIRMED_SERVICE_ACK_DATA *service_data)
+{
+    int len = 0;
+    BACNET_READ_ACCESS_DATA *rpm_data;
+    BACNET_READ_ACCESS_DATA *rpm_object;
+
+    if (address_match(&Target_Address, src) &&
+        (service_data->invoke_id == Request_Invoke_ID)) {
+        rpm_data = calloc(1, sizeof(BACNET_READ_ACCESS_DATA));
+        if (rpm_data) {
+            len = rpm_ack_decode_service_request(
+                service_request, service_len, rpm_data);
+        }
+        if (len > 0) {
+            rpm_object = rpm_data;
+            while (rpm_object) {
+                Objects_Received++;
+                rpm_object = rpm_object->next;
+            }
+        } else {
+            fprintf(stderr, "RPM Ack Malformed!\n");
+            Error_Detected = true;
+        }
+        rpm_data_free(rpm_data);
+        Request_Complete = true;
+    }
+}
+
+static void Init_Service_Handlers(void)
+{
+    Device_Init(NULL);
+    /* we need to handle who-is
+       to support dynamic device binding to us */
+    apdu_set_unconfirmed_handler(SERVICE_UNCONFIRMED_WHO_IS, handler_who_is);
+    /* handle i-am to support binding to other devices */
+    apdu_set_unconfirmed_handler(SERVICE_UNCONFIRMED_I_AM, handler_i_am_bind);
+    /* set the handler for all the services we don't implement
+       It is required to send the proper reject message... */
+    apdu_set_unrecognized_service_handler_handler(handler_unrecognized_service);
+    /* we must implement read property - it's required! */
+    apdu_set_confirmed_handler(
+        SERVICE_CONFIRMED_READ_PROPERTY, handler_read_property);
+    /* handle the data coming back from confirmed requests */
+    apdu_set_confirmed_ack_handler(SERVICE_CONFIRMED_READ_PROP_MULTIPLE,
+        My_Read_Property_Multiple_Ack_Handler);
+    /* handle any errors coming back */
+    apdu_set_error_handler(
+        SERVICE_CONFIRMED_READ_PROP_MULTIPLE, MyErrorHandler);
+    apdu_set_abort_handler(MyAbortHandler);
+    apdu_set_reject_handler(MyRejectHandler);
+}
+
+static void cleanup(void)
+{
+    free(Read_Access_Data);
+    free(Read_Property_Data);
+}
+
+/** Sends a ReadPropertyMultiple request, with or without
+ * the Segmented-Response-Accepted bit, to the target device.
+ *
+ * @param read_access_data [in] linked list of objects to read
+ * @param segmented [in] true if a segmented ComplexACK is accepted
+ * @return invoke id of outgoing message, or 0 on failure
+ */
+static uint8_t rpm_bench_send(
+    BACNET_READ_ACCESS_DATA *read_access_data, bool segmented)
+{
+    BACNET_ADDRESS my_address;
+    BACNET_NPDU_DATA npdu_data;
+    uint8_t invoke_id = 0;
+    int pdu_len = 0;
+    int len = 0;
+
+    invoke_id = tsm_next_free_invokeID();
+    if (invoke_id) {
+        datalink_get_my_address(&my_address);
+        npdu_encode_npdu_data(&npdu_data, true, MESSAGE_PRIORITY_NORMAL);
+        pdu_len =
+            npdu_encode_pdu(&Tx_Buf[0], &Target_Address, &my_address, &npdu_data);
+        len = rpm_encode_apdu(&Tx_Buf[pdu_len], sizeof(Tx_Buf) - pdu_len,
+            invoke_id, read_access_data);
+        if ((len <= 0) || ((unsigned)len > Target_Max_APDU)) {
+            /* the request does not fit - try fewer objects */
+            Request_Aborted = true;
+            tsm_free_invoke_id(invoke_id);
+            return 0;
+        }
+        /* octet 0 of the confirmed request: SA bit */
+        if (segmented) {
+            Tx_Buf[pdu_len] |= BIT(1);
+        } else {
+            Tx_Buf[pdu_len] &= ~BIT(1);
+        }
+        pdu_len += len;
+        tsm_set_confirmed_unsegmented_transaction(
+            invoke_id, &Target_Address, &npdu_data, &Tx_Buf[0], pdu_len);
+        if (datalink_send_pdu(
+                &Target_Address, &npdu_data, &Tx_Buf[0], pdu_len) <= 0) {
+            fprintf(stderr,
+                "Failed to Send ReadPropertyMultiple Request (%s)!\n",
+                strerror(errno));
+        }
+    }
+
+    return invoke_id;
+}
+
+/** Receives and processes messages until the request in progress
+ * is complete, or it times out.
+ */
+static void rpm_bench_wait(void)
+{
+    BACNET_ADDRESS src = { 0 };
+    uint16_t pdu_len = 0;
+    unsigned long last_milliseconds = 0;
+    unsigned long current_milliseconds = 0;
+
+    last_milliseconds = mstimer_now();
+    while (!Request_Complete) {
+        current_milliseconds = mstimer_now();
+        if (current_milliseconds != last_milliseconds) {
+            tsm_timer_milliseconds(
+                (uint16_t)(current_milliseconds - last_milliseconds));
+            last_milliseconds = current_milliseconds;
+        }
+        if (tsm_invoke_id_failed(Request_Invoke_ID)) {
+            fprintf(stderr, "\rError: TSM Timeout!\n");
+            tsm_free_invoke_id(Request_Invoke_ID);
+            Error_Detected = true;
+            break;
+        }
+        pdu_len = datalink_receive(&src, &Rx_Buf[0], MAX_MPDU, 10);
+        if (pdu_len) {
+            npdu_handler(&src, &Rx_Buf[0], pdu_len);
+        }
+    }
+}
+
+/** Reads all of the objects, batch_size objects in each request.
+ *
+ * @param batch_size [in] number of objects in each request
+ * @param segmented [in] true if a segmented ComplexACK is accepted
+ * @param requests [out] number of requests that were sent
+ * @return true if all of the objects were read
+ */
+static bool rpm_bench_read_all(
+    unsigned batch_size, bool segmented, unsigned *requests)
+{
+    unsigned first = 0;
+    unsigned last = 0;
+    BACNET_READ_ACCESS_DATA *next;
+
+    while (first < Object_Count) {
+        last = first + batch_size - 1;
+        if (last >= Object_Count) {
+            last = Object_Count - 1;
+        }
+        /* cut the list at the end of this batch */
+        next = Read_Access_Data[last].next;
+        Read_Access_Data[last].next = NULL;
+        Request_Complete = false;
+        Request_Aborted = false;
+        Request_Invoke_ID = rpm_bench_send(&Read_Access_Data[first], segmented);
+        if (Request_Invoke_ID) {
+            (*requests)++;
+            rpm_bench_wait();
+        } else if (!Request_Aborted) {
+            Error_Detected = true;
+        }
+        Read_Access_Data[last].next = next;
+        if (Error_Detected || Request_Aborted) {
+            return false;
+        }
+        first = last + 1;
+    }
+
+    return true;
+}
+
+/** Runs one benchmark and prints its rate in objects per second.
+ * The requests are halved until each request and its reply fit.
+ *
+ * @param repeat [in] number of times to read all of the objects
+ * @param segmented [in] true if a segmented ComplexACK is accepted
+ * @return true if the benchmark completed
+ */
+static bool rpm_bench_run(unsigned repeat, bool segmented)
+{
+    unsigned batch_size = Object_Count;
+    unsigned requests = 0;
+    unsigned long start = 0;
+    unsigned long elapsed = 0;
+    unsigned i = 0;
+    bool status = false;
+
+    /* find a request size that works, outside of the timed runs */
+    while (!status) {
+        status = rpm_bench_read_all(batch_size, segmented, &requests);
+        if (Error_Detected) {
+            return false;
+        }
+        if (!status) {
+            if (batch_size == 1) {
+                fprintf(stderr, "Error: one object does not fit!\n");
+                return false;
+            }
+            batch_size = (batch_size + 1) / 2;
+        }
+    }
+    requests = 0;
+    Objects_Received = 0;
+    start = mstimer_now();
+    for (i = 0; i < repeat; i++) {
+        if (!rpm_bench_read_all(batch_size, segmented, &requests)) {
+            return false;
+        }
+    }
+    elapsed = mstimer_now() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    printf("%-11s %u objects in %u requests of up to %u objects: "
+           "%lu ms, %.1f objects/sec\n",
+        segmented ? "segmented" : "unsegmented", Objects_Received, requests,
+        batch_size, elapsed, (double)Objects_Received * 1000.0 / elapsed);
+
+    return true;
+}
+
+static void print_usage(char *filename)
+{
+    printf("Usage: %s device-instance object-type first-instance count\n"
+           "       [property] [--repeat N][--version][--help]\n",
+        filename);
+}
+
+static void print_help(char *filename)
+{
+    printf("Measure how many objects per second ReadPropertyMultiple\n"
+           "reads from a BACnet device, first in one request with a\n"
+           "segmented reply, then in as many unsegmented requests as\n"
+           "are needed for each reply to fit in one APDU.\n"
+           "device-instance:\n"
+           "BACnet Device Object Instance number that you are\n"
+           "trying to communicate to.\n"
+           "\nobject-type:\n"
+           "The object type of the objects that you are reading,\n"
+           "as a name string or as the integer enumeration.\n"
+           "\nfirst-instance count:\n"
+           "The objects first-instance to first-instance+count-1\n"
+           "are read.\n"
+           "\nproperty:\n"
+           "The property that is read from each object.\n"
+           "The default is Present Value (85).\n"
+           "\n--repeat N:\n"
+           "The number of times all of the objects are read.\n"
+           "The default is 10.\n"
+           "\nExample:\n"
+           "To read Present Value of Analog Value 0 to 199 in Device 123\n"
+           "use the following command:\n"
+           "%s 123 analog-value 0 200\n",
+        filename);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long start = 0;
+    unsigned long timeout = 0;
+    bool found = false;
+    BACNET_OBJECT_TYPE object_type = OBJECT_NONE;
+    uint32_t first_instance = 0;
+    unsigned property_id = PROP_PRESENT_VALUE;
+    unsigned repeat = 10;
+    int target_args = 0;
+    int argi = 0;
+    unsigned i = 0;
+    char *filename = NULL;
+
+    filename = filename_remove_path(argv[0]);
+    for (argi = 1; argi < argc; argi++) {
+        if (strcmp(argv[argi], "--help") == 0) {
+            print_usage(filename);
+            print_help(filename);
+            return 0;
+        }
+        if (strcmp(argv[argi], "--version") == 0) {
+            printf("%s %s\n", filename, BACNET_VERSION_TEXT);
+            printf("Copyright (C) 2014 by Steve Karg and others.\n"
+                   "This is free software; see the source for copying "
+                   "conditions.\n"
+                   "There is NO warranty; not even for MERCHANTABILITY or\n"
+                   "FITNESS FOR A PARTICULAR PURPOSE.\n");
+            return 0;
+        }
+        if (strcmp(argv[argi], "--repeat") == 0) {
+            if (++argi < argc) {
+                repeat = strtol(argv[argi], NULL, 0);
+            }
+        } else {
+            target_args++;
+            switch (target_args) {
+                case 1:
+                    Target_Device_Object_Instance =
+                        strtol(argv[argi], NULL, 0);
+                    break;
+                case 2:
+                    if (!bactext_object_type_strtol(
+                            argv[argi], &object_type)) {
+                        fprintf(stderr, "Error: object-type=%s invalid\n",
+                            argv[argi]);
+                        return 1;
+                    }
+                    break;
+                case 3:
+                    first_instance = strtol(argv[argi], NULL, 0);
+                    break;
+                case 4:
+                    Object_Count = strtol(argv[argi], NULL, 0);
+                    break;
+                case 5:
+                    property_id = strtol(argv[argi], NULL, 0);
+                    break;
+                default:
+                    print_usage(filename);
+                    return 1;
+            }
+        }
+    }
+    if (target_args < 4) {
+        print_usage(filename);
+        return 0;
+    }
+    if (Target_Device_Object_Instance >= BACNET_MAX_INSTANCE) {
+        fprintf(stderr, "device-instance=%u - it must be less than %u\n",
+            Target_Device_Object_Instance, BACNET_MAX_INSTANCE);
+        return 1;
+    }
+    if ((Object_Count == 0) ||
+        ((first_instance + Object_Count - 1) > BACNET_MAX_INSTANCE)) {
+        fprintf(stderr, "count=%u - the last instance must be %u or less\n",
+            Object_Count, BACNET_MAX_INSTANCE);
+        return 1;
+    }
+    if (property_id > MAX_BACNET_PROPERTY_ID) {
+        fprintf(stderr, "property=%u - it must be less than %u\n", property_id,
+            MAX_BACNET_PROPERTY_ID + 1);
+        return 1;
+    }
+    if (repeat == 0) {
+        repeat = 1;
+    }
+    atexit(cleanup);
+    Read_Access_Data = calloc(Object_Count, sizeof(BACNET_READ_ACCESS_DATA));
+    Read_Property_Data =
+        calloc(Object_Count, sizeof(BACNET_PROPERTY_REFERENCE));
+    if (!Read_Access_Data || !Read_Property_Data) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < Object_Count; i++) {
+        Read_Property_Data[i].propertyIdentifier = property_id;
+        Read_Property_Data[i].propertyArrayIndex = BACNET_ARRAY_ALL;
+        Read_Access_Data[i].object_type = object_type;
+        Read_Access_Data[i].object_instance = first_instance + i;
+        Read_Access_Data[i].listOfProperties = &Read_Property_Data[i];
+        if ((i + 1) < Object_Count) {
+            Read_Access_Data[i].next = &Read_Access_Data[i + 1];
+        }
+    }
+    /* setup my info */
+    Device_Set_Object_Instance_Number(BACNET_MAX_INSTANCE);
+    address_init();
+    Init_Service_Handlers();
+    dlenv_init();
+    atexit(datalink_cleanup);
+    /* try to bind with the device */
+    timeout = apdu_timeout() * apdu_retries();
+    found = address_bind_request(
+        Target_Device_Object_Instance, &Target_Max_APDU, &Target_Address);
+    if (!found) {
+        Send_WhoIs(
+            Target_Device_Object_Instance, Target_Device_Object_Instance);
+    }
+    start = mstimer_now();
+    while (!found) {
+        BACNET_ADDRESS src = { 0 };
+        uint16_t pdu_len = 0;
+
+        if ((mstimer_now() - start) > timeout) {
+            printf("\rError: APDU Timeout!\n");
+            return 1;
+        }
+        pdu_len = datalink_receive(&src, &Rx_Buf[0], MAX_MPDU, 100);
+        if (pdu_len) {
+            npdu_handler(&src, &Rx_Buf[0], pdu_len);
+        }
+        found = address_bind_request(
+            Target_Device_Object_Instance, &Target_Max_APDU, &Target_Address);
+    }
+#if BACNET_SEGMENTATION_ENABLED
+    if (!rpm_bench_run(repeat, true)) {
+        return 1;
+    }
+#else
+    printf("segmented   not supported in this build\n");
+#endif
+    if (!rpm_bench_run(repeat, false)) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -58,6 +58,17 @@
 #if defined(BAC_UCI)
 #include "bacnet/basic/ucix/ucix.h"
 #endif /* defined(BAC_UCI) */
+#if defined(__linux__) && defined(BACDL_BIP)
+/* wait on the BACnet/IP socket and the timers with epoll */
+#define SERVER_REACTOR 1
+#include "bacnet/datalink/bip.h"
+#include "reactor.h"
+#endif
+#if defined(__linux__) && BACNET_THREADS
+/* handle confirmed requests with a pool of threads */
+#define SERVER_WORKERS 1
+#include "workers.h"
+#endif
 
 /** @file server/main.c  Example server application using the BACnet Stack. */
 
@@ -71,6 +82,21 @@ static const char *BACnet_Version = BACNET_VERSION_TEXT;
 
 /** Buffer used for receiving */
 static uint8_t Rx_Buf[MAX_MPDU] = { 0 };
+#if defined(SERVER_REACTOR)
+/* milliseconds between calls of the transaction state machine timer */
+#define SERVER_TSM_TIMER_MS 100
+#endif
+#if defined(SERVER_WORKERS)
+/* number of threads that handle confirmed requests, or zero to
+   handle them with everything else */
+static unsigned Server_Workers;
+#endif
+#if TREND_LOG_MMAP
+/* directory of the Trend Log ring files, or NULL to log in memory */
+static const char *Server_Trend_Log_Directory;
+/* number of records in each Trend Log ring file */
+static uint32_t Server_Trend_Log_Size = TL_MAX_ENTRIES;
+#endif
 
 /** Initialize the handlers we will utilize.
  * @see Device_Init, apdu_set_unconfirmed_handler, apdu_set_confirmed_handler
@@ -146,9 +172,230 @@ static void Init_Service_Handlers(void)
 #endif
 }
 
+/** Run the tasks that are timed in seconds.
+ * @param elapsed_seconds [in] seconds since the last call
+ */
+static void Server_Seconds_Tasks(uint32_t elapsed_seconds)
+{
+    static uint32_t address_binding_tmr = 0;
+#if defined(INTRINSIC_REPORTING)
+    static uint32_t recipient_scan_tmr = 0;
+#endif
+#if defined(BACNET_TIME_MASTER)
+    BACNET_DATE_TIME bdatetime;
+#endif
+
+#if defined(SERVER_WORKERS)
+    workers_lock();
+#endif
+    dcc_timer_seconds(elapsed_seconds);
+    datalink_maintenance_timer(elapsed_seconds);
+    dlenv_maintenance_timer(elapsed_seconds);
+    Load_Control_State_Machine_Handler();
+    handler_cov_timer_seconds(elapsed_seconds);
+#if !defined(SERVER_REACTOR)
+    tsm_timer_milliseconds(elapsed_seconds * 1000);
+#endif
+    trend_log_timer(elapsed_seconds);
+#if defined(INTRINSIC_REPORTING)
+    Device_local_reporting_timer(elapsed_seconds);
+#endif
+#if defined(BACNET_TIME_MASTER)
+    Device_getCurrentDateTime(&bdatetime);
+    handler_timesync_task(&bdatetime);
+#endif
+    /* scan cache address */
+    address_binding_tmr += elapsed_seconds;
+    if (address_binding_tmr >= 60) {
+        address_cache_timer(address_binding_tmr);
+        address_binding_tmr = 0;
+    }
+#if defined(INTRINSIC_REPORTING)
+    /* try to find addresses of recipients */
+    recipient_scan_tmr += elapsed_seconds;
+    if (recipient_scan_tmr >= NC_RESCAN_RECIPIENTS_SECS) {
+        Notification_Class_find_recipient();
+        recipient_scan_tmr = 0;
+    }
+#endif
+#if defined(SERVER_WORKERS)
+    workers_unlock();
+#endif
+}
+
+/** Handle a received NPDU, or hand it to the worker threads.
+ * @param src [in] source address of the NPDU
+ * @param pdu [in] the NPDU
+ * @param pdu_len [in] length of the NPDU
+ */
+static void Server_NPDU_Handler(
+    BACNET_ADDRESS *src, uint8_t *pdu, uint16_t pdu_len)
+{
+#if defined(SERVER_WORKERS)
+    if (workers_dispatch(src, pdu, pdu_len)) {
+        return;
+    }
+    workers_lock();
+#endif
+    npdu_handler(src, pdu, pdu_len);
+#if defined(SERVER_WORKERS)
+    workers_unlock();
+#endif
+}
+
+/** Send the COV notifications of the objects that changed. */
+static void Server_COV_Task(void)
+{
+#if defined(SERVER_WORKERS)
+    workers_lock();
+#endif
+#if defined(SERVER_REACTOR)
+    while (!handler_cov_fsm()) {
+    }
+#else
+    handler_cov_task();
+#endif
+#if defined(SERVER_WORKERS)
+    workers_unlock();
+#endif
+}
+
+/** Evaluate the event state of the objects that changed, and of those
+ *  whose time delays are due. */
+static void Server_Event_Task(void)
+{
+#if defined(INTRINSIC_REPORTING)
+#if defined(SERVER_WORKERS)
+    workers_lock();
+#endif
+    Device_local_reporting();
+#if defined(SERVER_WORKERS)
+    workers_unlock();
+#endif
+#endif
+}
+
+#if defined(SERVER_WORKERS)
+/** Start the threads that handle confirmed requests.  The services
+ *  that only read the objects are handled in parallel.
+ * @return true if the worker threads are running
+ */
+static bool Server_Workers_Init(unsigned count)
+{
+    workers_shared_service_set(SERVICE_CONFIRMED_READ_PROPERTY, true);
+    workers_shared_service_set(SERVICE_CONFIRMED_READ_PROP_MULTIPLE, true);
+    workers_shared_service_set(SERVICE_CONFIRMED_READ_RANGE, true);
+    /* AtomicReadFile is not one of them: it moves the open file of the
+       File object, and adds to the index of its records */
+
+    return workers_init(count);
+}
+#endif
+
+#if TREND_LOG_MMAP
+/** Keep each Trend Log in a ring file in a directory, so that the
+ *  records survive a restart.
+ * @param directory - where the ring files are kept
+ * @param size - number of records in each ring file
+ * @return true if every Trend Log has its ring file
+ */
+static bool Server_Trend_Logs_Init(const char *directory, uint32_t size)
+{
+    char pathname[256];
+    uint32_t instance;
+    unsigned count;
+    unsigned index;
+    int len;
+
+    count = Trend_Log_Count();
+    for (index = 0; index < count; index++) {
+        instance = Trend_Log_Index_To_Instance(index);
+        len = snprintf(pathname, sizeof(pathname), "%s/trendlog-%lu.tlog",
+            directory, (unsigned long)instance);
+        if ((len < 0) || ((size_t)len >= sizeof(pathname)) ||
+            !Trend_Log_Storage_File_Set(instance, pathname, size)) {
+            fprintf(stderr, "Failed to open %s\n", pathname);
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+#if defined(SERVER_REACTOR)
+/** Handle the datagrams that are waiting on the BACnet/IP socket.
+ *  They are read in batches, and the replies to a batch are sent
+ *  together when it is done.
+ */
+static void Server_Datalink_Ready(int fd, void *context)
+{
+    BACNET_ADDRESS src = { 0 };
+    uint16_t pdu_len = 0;
+
+    (void)fd;
+    (void)context;
+    do {
+        pdu_len = datalink_receive(&src, &Rx_Buf[0], MAX_MPDU, 0);
+        if (pdu_len) {
+            Server_NPDU_Handler(&src, &Rx_Buf[0], pdu_len);
+        }
+    } while (bip_receive_pending());
+    bip_send_flush();
+}
+
+static void Server_Seconds_Timer(unsigned long milliseconds, void *context)
+{
+    (void)context;
+    Server_Seconds_Tasks(milliseconds / 1000);
+}
+
+static void Server_TSM_Timer(unsigned long milliseconds, void *context)
+{
+    (void)context;
+#if defined(SERVER_WORKERS)
+    workers_lock();
+#endif
+    tsm_timer_milliseconds(milliseconds);
+#if defined(SERVER_WORKERS)
+    workers_unlock();
+#endif
+}
+
+/** Wait on the BACnet/IP socket and the timers with the reactor.
+ * @return true if the reactor is used, or false to poll the datalink
+ */
+static bool Server_Reactor_Init(void)
+{
+    if (bip_socket() < 0) {
+        /* another datalink was chosen */
+        return false;
+    }
+    if (!reactor_init()) {
+        return false;
+    }
+    if (!reactor_fd_add(bip_socket(), Server_Datalink_Ready, NULL) ||
+        (reactor_timer_add(1000, Server_Seconds_Timer, NULL) < 0) ||
+        (reactor_timer_add(SERVER_TSM_TIMER_MS, Server_TSM_Timer, NULL) <
+            0)) {
+        reactor_cleanup();
+        return false;
+    }
+    bip_send_batch_enable(true);
+
+    return true;
+}
+#endif
+
 static void print_usage(const char *filename)
 {
     printf("Usage: %s [device-instance [device-name]]\n", filename);
+#if defined(SERVER_WORKERS)
+    printf("       [--workers N]\n");
+#endif
+#if TREND_LOG_MMAP
+    printf("       [--trend-logs directory [--trend-log-size N]]\n");
+#endif
     printf("       [--version][--help]\n");
 }
 
@@ -167,6 +414,21 @@ static void print_help(const char *filename)
     printf("To simulate Device 123 named Fred, use following command:\n"
            "%s 123 Fred\n",
         filename);
+#if defined(SERVER_WORKERS)
+    printf("--workers N:\n"
+           "Handle confirmed requests with N threads, up to %u.\n"
+           "The requests of each client are handled in order, and\n"
+           "requests that only read are handled in parallel.\n",
+        (unsigned)WORKERS_MAX);
+#endif
+#if TREND_LOG_MMAP
+    printf("--trend-logs directory:\n"
+           "Keep the Trend Log records in ring files in the directory,\n"
+           "so that they survive a restart.\n"
+           "--trend-log-size N:\n"
+           "Number of records in each ring file, %u by default.\n",
+        (unsigned)TL_MAX_ENTRIES);
+#endif
 }
 
 /** Main function of server demo.
@@ -189,20 +451,14 @@ int main(int argc, char *argv[])
     time_t last_seconds = 0;
     time_t current_seconds = 0;
     uint32_t elapsed_seconds = 0;
-    uint32_t elapsed_milliseconds = 0;
-    uint32_t address_binding_tmr = 0;
-#if defined(INTRINSIC_REPORTING)
-    uint32_t recipient_scan_tmr = 0;
-#endif
-#if defined(BACNET_TIME_MASTER)
-    BACNET_DATE_TIME bdatetime;
-#endif
 #if defined(BAC_UCI)
     int uciId = 0;
     struct uci_context *ctx;
 #endif
     int argi = 0;
+    unsigned int target_args = 0;
     const char *filename = NULL;
+    const char *device_name = NULL;
 
     filename = filename_remove_path(argv[0]);
     for (argi = 1; argi < argc; argi++) {
@@ -220,6 +476,47 @@ int main(int argc, char *argv[])
                    "FITNESS FOR A PARTICULAR PURPOSE.\n");
             return 0;
         }
+#if defined(SERVER_WORKERS)
+        if (strcmp(argv[argi], "--workers") == 0) {
+            if (++argi < argc) {
+                Server_Workers = strtoul(argv[argi], NULL, 0);
+            }
+            if ((Server_Workers == 0) || (Server_Workers > WORKERS_MAX)) {
+                print_usage(filename);
+                return 1;
+            }
+            continue;
+        }
+#endif
+#if TREND_LOG_MMAP
+        if (strcmp(argv[argi], "--trend-logs") == 0) {
+            if (++argi < argc) {
+                Server_Trend_Log_Directory = argv[argi];
+            } else {
+                print_usage(filename);
+                return 1;
+            }
+            continue;
+        }
+        if (strcmp(argv[argi], "--trend-log-size") == 0) {
+            if (++argi < argc) {
+                Server_Trend_Log_Size = strtoul(argv[argi], NULL, 0);
+            }
+            if (Server_Trend_Log_Size == 0) {
+                print_usage(filename);
+                return 1;
+            }
+            continue;
+        }
+#endif
+        if (target_args == 0) {
+            /* allow the device ID to be set */
+            Device_Set_Object_Instance_Number(strtol(argv[argi], NULL, 0));
+            target_args++;
+        } else if (target_args == 1) {
+            device_name = argv[argi];
+            target_args++;
+        }
     }
 #if defined(BAC_UCI)
     ctx = ucix_init("bacnet_dev");
@@ -229,14 +526,6 @@ int main(int argc, char *argv[])
     printf("ID: %i", uciId);
     if (uciId != 0) {
         Device_Set_Object_Instance_Number(uciId);
-    } else {
-#endif /* defined(BAC_UCI) */
-        /* allow the device ID to be set */
-        if (argc > 1) {
-            Device_Set_Object_Instance_Number(strtol(argv[1], NULL, 0));
-        }
-
-#if defined(BAC_UCI)
     }
     ucix_cleanup(ctx);
 #endif /* defined(BAC_UCI) */
@@ -250,15 +539,52 @@ int main(int argc, char *argv[])
        in our device bindings list */
     address_init();
     Init_Service_Handlers();
-    if (argc > 2) {
-        Device_Object_Name_ANSI_Init(argv[2]);
+#if defined(BACFILE)
+    /* the files of the File objects stay open until the server exits */
+    atexit(bacfile_cleanup);
+#endif
+    if (device_name) {
+        Device_Object_Name_ANSI_Init(device_name);
+    }
+#if TREND_LOG_MMAP
+    if (Server_Trend_Log_Directory) {
+        if (!Server_Trend_Logs_Init(
+                Server_Trend_Log_Directory, Server_Trend_Log_Size)) {
+            return 1;
+        }
+        atexit(Trend_Log_Storage_Cleanup);
     }
+#endif
     dlenv_init();
     atexit(datalink_cleanup);
     /* configure the timeout values */
     last_seconds = time(NULL);
     /* broadcast an I-Am on startup */
     Send_I_Am(&Handler_Transmit_Buffer[0]);
+#if defined(SERVER_WORKERS)
+    if (Server_Workers) {
+        if (!Server_Workers_Init(Server_Workers)) {
+            fprintf(stderr, "Failed to start %u worker threads\n",
+                Server_Workers);
+            return 1;
+        }
+        printf("Worker threads: %u\n", Server_Workers);
+        atexit(workers_cleanup);
+    }
+#endif
+#if defined(SERVER_REACTOR)
+    if (Server_Reactor_Init()) {
+        /* loop forever */
+        for (;;) {
+            /* the timers wake the loop at least every SERVER_TSM_TIMER_MS */
+            reactor_run_once(-1);
+            /* send the notifications of the objects that changed */
+            Server_COV_Task();
+            Server_Event_Task();
+            bip_send_flush();
+        }
+    }
+#endif
     /* loop forever */
     for (;;) {
         /* input */
@@ -269,43 +595,16 @@ int main(int argc, char *argv[])
 
         /* process */
         if (pdu_len) {
-            npdu_handler(&src, &Rx_Buf[0], pdu_len);
+            Server_NPDU_Handler(&src, &Rx_Buf[0], pdu_len);
         }
         /* at least one second has passed */
         elapsed_seconds = (uint32_t)(current_seconds - last_seconds);
         if (elapsed_seconds) {
             last_seconds = current_seconds;
-            dcc_timer_seconds(elapsed_seconds);
-            datalink_maintenance_timer(elapsed_seconds);
-            dlenv_maintenance_timer(elapsed_seconds);
-            Load_Control_State_Machine_Handler();
-            elapsed_milliseconds = elapsed_seconds * 1000;
-            handler_cov_timer_seconds(elapsed_seconds);
-            tsm_timer_milliseconds(elapsed_milliseconds);
-            trend_log_timer(elapsed_seconds);
-#if defined(INTRINSIC_REPORTING)
-            Device_local_reporting();
-#endif
-#if defined(BACNET_TIME_MASTER)
-            Device_getCurrentDateTime(&bdatetime);
-            handler_timesync_task(&bdatetime);
-#endif
-        }
-        handler_cov_task();
-        /* scan cache address */
-        address_binding_tmr += elapsed_seconds;
-        if (address_binding_tmr >= 60) {
-            address_cache_timer(address_binding_tmr);
-            address_binding_tmr = 0;
+            Server_Seconds_Tasks(elapsed_seconds);
         }
-#if defined(INTRINSIC_REPORTING)
-        /* try to find addresses of recipients */
-        recipient_scan_tmr += elapsed_seconds;
-        if (recipient_scan_tmr >= NC_RESCAN_RECIPIENTS_SECS) {
-            Notification_Class_find_recipient();
-            recipient_scan_tmr = 0;
-        }
-#endif
+        Server_COV_Task();
+        Server_Event_Task();
         /* output */
 
         /* blink LEDs, Turn on or off outputs, etc */
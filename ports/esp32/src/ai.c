@@ -34,6 +34,7 @@
 #include "bacnet/bacdcode.h"
 #include "bacnet/bacenum.h"
 #include "bacnet/bactext.h"
+#include "bacnet/cov.h"
 #include "bacnet/config.h" /* the custom stuff */
 #include "bacnet/basic/object/device.h"
 #include "bacnet/basic/services.h"
@@ -186,6 +187,8 @@ static void Analog_Input_COV_Detect(unsigned int index, float value)
         if (cov_delta >= cov_increment) {
             AI_Descr[index].Changed = true;
             AI_Descr[index].Prior_Value = value;
+            cov_change_detected_notify(
+                OBJECT_ANALOG_INPUT, Analog_Input_Index_To_Instance(index));
         }
     }
 }
@@ -350,6 +353,7 @@ void Analog_Input_Out_Of_Service_Set(uint32_t object_instance, bool value)
         September 2016 */
         if (AI_Descr[index].Out_Of_Service != value) {
             AI_Descr[index].Changed = true;
+            cov_change_detected_notify(OBJECT_ANALOG_INPUT, object_instance);
         }
         AI_Descr[index].Out_Of_Service = value;
     }
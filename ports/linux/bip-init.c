@@ -32,6 +32,10 @@
  -------------------------------------------
 ####COPYRIGHTEND####*/
 /* linux Ethernet/IP specific */
+#ifndef _GNU_SOURCE
+/* for recvmmsg() and sendmmsg() */
+#define _GNU_SOURCE
+#endif
 #include <asm/types.h>
 #include <netinet/ether.h>
 #include <netinet/in.h>
@@ -77,6 +81,33 @@ static bool BIP_Debug = false;
 /* interface name */
 static char BIP_Interface_Name[IF_NAMESIZE] = { 0 };
 
+/* number of datagrams read from the socket with one recvmmsg() */
+#ifndef BIP_RECEIVE_BATCH
+#define BIP_RECEIVE_BATCH 16
+#endif
+/* number of datagrams written to the socket with one sendmmsg() */
+#ifndef BIP_SEND_BATCH
+#define BIP_SEND_BATCH 16
+#endif
+/* zeros after each received datagram, as a safety margin for decoding */
+#define BIP_RECEIVE_MARGIN 16
+/* datagrams received and not yet handed to bip_receive() callers */
+static uint8_t BIP_Rx_Buffer[BIP_RECEIVE_BATCH]
+                            [BIP_MPDU_MAX + BIP_RECEIVE_MARGIN];
+static struct sockaddr_in BIP_Rx_Source[BIP_RECEIVE_BATCH];
+static struct iovec BIP_Rx_Iov[BIP_RECEIVE_BATCH];
+static struct mmsghdr BIP_Rx_Msg[BIP_RECEIVE_BATCH];
+static unsigned BIP_Rx_Count;
+static unsigned BIP_Rx_Index;
+/* datagrams queued by bip_send_mpdu() until bip_send_flush(),
+   by each thread that sends */
+static BACNET_THREAD_LOCAL bool BIP_Send_Batch;
+static BACNET_THREAD_LOCAL uint8_t BIP_Tx_Buffer[BIP_SEND_BATCH][BIP_MPDU_MAX];
+static BACNET_THREAD_LOCAL struct sockaddr_in BIP_Tx_Dest[BIP_SEND_BATCH];
+static BACNET_THREAD_LOCAL struct iovec BIP_Tx_Iov[BIP_SEND_BATCH];
+static BACNET_THREAD_LOCAL struct mmsghdr BIP_Tx_Msg[BIP_SEND_BATCH];
+static BACNET_THREAD_LOCAL unsigned BIP_Tx_Count;
+
 /**
  * @brief Print the IPv4 address with debug info
  * @param str - debug info string
@@ -263,12 +294,14 @@ uint8_t bip_get_subnet_prefix(void)
  * @param mtu - the bytes of data to send
  * @param mtu_len - the number of bytes of data to send
  *
- * @return Upon successful completion, returns the number of bytes sent.
+ * @return Upon successful completion, returns the number of bytes sent,
+ *  or queued by bip_send_batch_enable() to be sent by bip_send_flush().
  *  Otherwise, -1 shall be returned and errno set to indicate the error.
  */
 int bip_send_mpdu(BACNET_IP_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
 {
     struct sockaddr_in bip_dest = { 0 };
+    unsigned i = 0;
 
     /* assumes that the driver has already been initialized */
     if (BIP_Socket < 0) {
@@ -285,10 +318,236 @@ int bip_send_mpdu(BACNET_IP_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
     /* Send the packet */
     debug_print_ipv4(
         "Sending MPDU->", &bip_dest.sin_addr, bip_dest.sin_port, mtu_len);
+    if (BIP_Send_Batch && (mtu_len <= BIP_MPDU_MAX)) {
+        if (BIP_Tx_Count >= BIP_SEND_BATCH) {
+            bip_send_flush();
+        }
+        i = BIP_Tx_Count;
+        memcpy(&BIP_Tx_Buffer[i][0], mtu, mtu_len);
+        BIP_Tx_Dest[i] = bip_dest;
+        BIP_Tx_Iov[i].iov_base = &BIP_Tx_Buffer[i][0];
+        BIP_Tx_Iov[i].iov_len = mtu_len;
+        memset(&BIP_Tx_Msg[i], 0, sizeof(BIP_Tx_Msg[i]));
+        BIP_Tx_Msg[i].msg_hdr.msg_name = &BIP_Tx_Dest[i];
+        BIP_Tx_Msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        BIP_Tx_Msg[i].msg_hdr.msg_iov = &BIP_Tx_Iov[i];
+        BIP_Tx_Msg[i].msg_hdr.msg_iovlen = 1;
+        BIP_Tx_Count++;
+        return mtu_len;
+    }
     return sendto(BIP_Socket, (char *)mtu, mtu_len, 0,
         (struct sockaddr *)&bip_dest, sizeof(struct sockaddr));
 }
 
+/**
+ * @brief Send the same datagram to each address of a list, with one
+ *  sendmmsg() for up to BIP_SEND_BATCH of them.  The datagram is not
+ *  copied, and is sent at once even if bip_send_batch_enable() is on.
+ * @param dest_list - the destination addresses
+ * @param dest_count - number of destination addresses
+ * @param mtu - the bytes of data to send
+ * @param mtu_len - the number of bytes of data to send
+ * @param sent - returns true for each destination that it was sent to,
+ *  or NULL
+ * @return number of destinations that the datagram was sent to
+ */
+int bip_send_mpdu_list(BACNET_IP_ADDRESS *dest_list,
+    unsigned dest_count,
+    uint8_t *mtu,
+    uint16_t mtu_len,
+    bool *sent)
+{
+    struct sockaddr_in bip_dest[BIP_SEND_BATCH];
+    struct mmsghdr msg[BIP_SEND_BATCH];
+    struct iovec iov = { 0 };
+    unsigned batch = 0;
+    unsigned index = 0;
+    unsigned i = 0;
+    int count = 0;
+    int status = 0;
+
+    if (sent) {
+        for (i = 0; i < dest_count; i++) {
+            sent[i] = false;
+        }
+    }
+    if (BIP_Socket < 0) {
+        if (BIP_Debug) {
+            fprintf(stderr, "BIP: driver not initialized!\n");
+            fflush(stderr);
+        }
+        return 0;
+    }
+    /* keep the order of what was queued before */
+    if (BIP_Tx_Count) {
+        bip_send_flush();
+    }
+    iov.iov_base = mtu;
+    iov.iov_len = mtu_len;
+    while (index < dest_count) {
+        batch = dest_count - index;
+        if (batch > BIP_SEND_BATCH) {
+            batch = BIP_SEND_BATCH;
+        }
+        memset(msg, 0, sizeof(msg[0]) * batch);
+        for (i = 0; i < batch; i++) {
+            memset(&bip_dest[i], 0, sizeof(bip_dest[i]));
+            bip_dest[i].sin_family = AF_INET;
+            memcpy(&bip_dest[i].sin_addr.s_addr,
+                &dest_list[index + i].address[0], 4);
+            bip_dest[i].sin_port = htons(dest_list[index + i].port);
+            msg[i].msg_hdr.msg_name = &bip_dest[i];
+            msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msg[i].msg_hdr.msg_iov = &iov;
+            msg[i].msg_hdr.msg_iovlen = 1;
+            debug_print_ipv4("Sending MPDU->", &bip_dest[i].sin_addr,
+                bip_dest[i].sin_port, mtu_len);
+        }
+        i = 0;
+        while (i < batch) {
+            status = sendmmsg(BIP_Socket, &msg[i], batch - i, 0);
+            if (status > 0) {
+                count += status;
+                while (status > 0) {
+                    if (sent) {
+                        sent[index + i] = true;
+                    }
+                    i++;
+                    status--;
+                }
+            } else if ((status < 0) && (errno == EINTR)) {
+                continue;
+            } else {
+                /* drop the datagram that failed, and send the rest */
+                if (BIP_Debug) {
+                    fprintf(stderr, "BIP: sendmmsg failed!\n");
+                    fflush(stderr);
+                }
+                i++;
+            }
+        }
+        index += batch;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Queue the datagrams of bip_send_mpdu() instead of sending each
+ *  one at once, so that a burst of replies is sent with one sendmmsg().
+ *  The queue is sent when it is full, or by bip_send_flush().
+ *  Each thread that sends has its own queue.
+ * @param enable - true to queue, false to send the queue and stop queuing
+ */
+void bip_send_batch_enable(bool enable)
+{
+    if (!enable) {
+        bip_send_flush();
+    }
+    BIP_Send_Batch = enable;
+}
+
+/**
+ * @brief Send the datagrams queued by bip_send_mpdu() on this thread
+ * @return number of datagrams that were sent
+ */
+int bip_send_flush(void)
+{
+    unsigned index = 0;
+    int sent = 0;
+    int status = 0;
+
+    while ((BIP_Socket >= 0) && (index < BIP_Tx_Count)) {
+        status = sendmmsg(
+            BIP_Socket, &BIP_Tx_Msg[index], BIP_Tx_Count - index, 0);
+        if (status > 0) {
+            index += status;
+            sent += status;
+        } else if ((status < 0) && (errno == EINTR)) {
+            continue;
+        } else {
+            /* drop the datagram that failed, and send the rest */
+            if (BIP_Debug) {
+                fprintf(stderr, "BIP: sendmmsg failed!\n");
+                fflush(stderr);
+            }
+            index++;
+        }
+    }
+    BIP_Tx_Count = 0;
+
+    return sent;
+}
+
+/**
+ * @brief Get the socket of the BACnet/IP datalink, to wait on it
+ * @return the socket, or -1 if the datalink is not initialized
+ */
+int bip_socket(void)
+{
+    return BIP_Socket;
+}
+
+/**
+ * @brief Determine if datagrams that were already received are waiting
+ *  to be returned by bip_receive()
+ * @return true if bip_receive() can return without reading the socket
+ */
+bool bip_receive_pending(void)
+{
+    return (BIP_Rx_Index < BIP_Rx_Count);
+}
+
+/**
+ * @brief Read the datagrams that are waiting on the socket, up to
+ *  BIP_RECEIVE_BATCH of them, with one system call.
+ * @param timeout - number of milliseconds to wait for a datagram
+ */
+static void bip_receive_batch(unsigned timeout)
+{
+    fd_set read_fds;
+    struct timeval select_timeout;
+    int count = 0;
+    unsigned i = 0;
+
+    BIP_Rx_Count = 0;
+    BIP_Rx_Index = 0;
+    /* we could just use a non-blocking socket, but that consumes all
+       the CPU time.  We can use a timeout; it is only supported as
+       a select. */
+    if (timeout) {
+        if (timeout >= 1000) {
+            select_timeout.tv_sec = timeout / 1000;
+            select_timeout.tv_usec =
+                1000 * (timeout - select_timeout.tv_sec * 1000);
+        } else {
+            select_timeout.tv_sec = 0;
+            select_timeout.tv_usec = 1000 * timeout;
+        }
+        FD_ZERO(&read_fds);
+        FD_SET(BIP_Socket, &read_fds);
+        /* see if there is a packet for us */
+        if (select(BIP_Socket + 1, &read_fds, NULL, NULL, &select_timeout) <=
+            0) {
+            return;
+        }
+    }
+    for (i = 0; i < BIP_RECEIVE_BATCH; i++) {
+        BIP_Rx_Iov[i].iov_base = &BIP_Rx_Buffer[i][0];
+        BIP_Rx_Iov[i].iov_len = BIP_MPDU_MAX;
+        memset(&BIP_Rx_Msg[i], 0, sizeof(BIP_Rx_Msg[i]));
+        BIP_Rx_Msg[i].msg_hdr.msg_name = &BIP_Rx_Source[i];
+        BIP_Rx_Msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        BIP_Rx_Msg[i].msg_hdr.msg_iov = &BIP_Rx_Iov[i];
+        BIP_Rx_Msg[i].msg_hdr.msg_iovlen = 1;
+    }
+    count = recvmmsg(
+        BIP_Socket, BIP_Rx_Msg, BIP_RECEIVE_BATCH, MSG_DONTWAIT, NULL);
+    if (count > 0) {
+        BIP_Rx_Count = count;
+    }
+}
+
 /**
  * BACnet/IP Datalink Receive handler.
  *
@@ -303,83 +562,70 @@ uint16_t bip_receive(
     BACNET_ADDRESS *src, uint8_t *npdu, uint16_t max_npdu, unsigned timeout)
 {
     uint16_t npdu_len = 0; /* return value */
-    fd_set read_fds;
     int max = 0;
-    struct timeval select_timeout;
-    struct sockaddr_in sin = { 0 };
+    struct sockaddr_in *sin = NULL;
     BACNET_IP_ADDRESS addr = { { 0 } };
-    socklen_t sin_len = sizeof(sin);
     int received_bytes = 0;
     int offset = 0;
-    uint16_t i = 0;
+    uint8_t *mtu = NULL;
+    unsigned i = 0;
 
     /* Make sure the socket is open */
     if (BIP_Socket < 0) {
         return 0;
     }
-    /* we could just use a non-blocking socket, but that consumes all
-       the CPU time.  We can use a timeout; it is only supported as
-       a select. */
-    if (timeout >= 1000) {
-        select_timeout.tv_sec = timeout / 1000;
-        select_timeout.tv_usec =
-            1000 * (timeout - select_timeout.tv_sec * 1000);
-    } else {
-        select_timeout.tv_sec = 0;
-        select_timeout.tv_usec = 1000 * timeout;
-    }
-    FD_ZERO(&read_fds);
-    FD_SET(BIP_Socket, &read_fds);
-    max = BIP_Socket;
-    /* see if there is a packet for us */
-    if (select(max + 1, &read_fds, NULL, NULL, &select_timeout) > 0) {
-        received_bytes = recvfrom(max, (char *)&npdu[0], max_npdu, 0,
-            (struct sockaddr *)&sin, &sin_len);
-    } else {
-        return 0;
-    }
-    /* See if there is a problem */
-    if (received_bytes < 0) {
-        return 0;
+    /* return the datagrams of the last batch before reading more */
+    if (BIP_Rx_Index >= BIP_Rx_Count) {
+        bip_receive_batch(timeout);
+        if (BIP_Rx_Index >= BIP_Rx_Count) {
+            return 0;
+        }
     }
+    i = BIP_Rx_Index++;
+    mtu = &BIP_Rx_Buffer[i][0];
+    sin = &BIP_Rx_Source[i];
+    received_bytes = BIP_Rx_Msg[i].msg_len;
     /* no problem, just no bytes */
     if (received_bytes == 0) {
         return 0;
     }
+    /* too large for a BACnet/IP datagram */
+    if (BIP_Rx_Msg[i].msg_hdr.msg_flags & MSG_TRUNC) {
+        return 0;
+    }
     /* the signature of a BACnet/IPv packet */
-    if (npdu[0] != BVLL_TYPE_BACNET_IP) {
+    if (mtu[0] != BVLL_TYPE_BACNET_IP) {
         return 0;
     }
-    /* Erase up to 16 bytes after the received bytes as safety margin to
+    /* Erase 16 bytes after the received bytes as safety margin to
      * ensure that the decoding functions will run into a 'safe field'
      * of zero, if for any reason they would overrun, when parsing the
      * message. */
-    max = (int)max_npdu - received_bytes;
-    if (max > 0) {
-        if (max > 16) {
-            max = 16;
-        }
-        memset(&npdu[received_bytes], 0, max);
-    }
+    memset(&mtu[received_bytes], 0, BIP_RECEIVE_MARGIN);
     /* Data link layer addressing between B/IPv4 nodes consists of a 32-bit
        IPv4 address followed by a two-octet UDP port number (both of which
        shall be transmitted with the most significant octet first). This
        address shall be referred to as a B/IPv4 address.
     */
-    memcpy(&addr.address[0], &sin.sin_addr.s_addr, 4);
-    addr.port = ntohs(sin.sin_port);
+    memcpy(&addr.address[0], &sin->sin_addr.s_addr, 4);
+    addr.port = ntohs(sin->sin_port);
     debug_print_ipv4(
-        "Received MPDU->", &sin.sin_addr, sin.sin_port, received_bytes);
+        "Received MPDU->", &sin->sin_addr, sin->sin_port, received_bytes);
     /* pass the packet into the BBMD handler */
-    offset = bvlc_handler(&addr, src, npdu, received_bytes);
+    offset = bvlc_handler(&addr, src, mtu, received_bytes);
     if (offset > 0) {
         npdu_len = received_bytes - offset;
         debug_print_ipv4(
-            "Received NPDU->", &sin.sin_addr, sin.sin_port, npdu_len);
+            "Received NPDU->", &sin->sin_addr, sin->sin_port, npdu_len);
         if (npdu_len <= max_npdu) {
-            /* shift the buffer to return a valid NPDU */
-            for (i = 0; i < npdu_len; i++) {
-                npdu[i] = npdu[offset + i];
+            /* return a valid NPDU, with the same safety margin */
+            memcpy(&npdu[0], &mtu[offset], npdu_len);
+            max = (int)max_npdu - npdu_len;
+            if (max > 0) {
+                if (max > BIP_RECEIVE_MARGIN) {
+                    max = BIP_RECEIVE_MARGIN;
+                }
+                memset(&npdu[npdu_len], 0, max);
             }
         } else {
             if (BIP_Debug) {
@@ -843,9 +1089,13 @@ bool bip_valid(void)
 void bip_cleanup(void)
 {
     if (BIP_Socket != -1) {
+        bip_send_flush();
         close(BIP_Socket);
     }
     BIP_Socket = -1;
+    BIP_Rx_Count = 0;
+    BIP_Rx_Index = 0;
+    BIP_Tx_Count = 0;
 
     return;
 }
@@ -32,6 +32,11 @@
  -------------------------------------------
 ####COPYRIGHTEND####*/
 
+#ifndef _GNU_SOURCE
+/* for sendmmsg() */
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
 #include <ifaddrs.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,6 +67,10 @@ static void debug_print_ipv6(const char *str, const struct in6_addr *addr)
 
 /* unix socket */
 static int BIP6_Socket = -1;
+/* number of datagrams written to the socket with one sendmmsg() */
+#ifndef BIP6_SEND_BATCH
+#define BIP6_SEND_BATCH 16
+#endif
 /* local address - filled by init functions */
 static BACNET_IP6_ADDRESS BIP6_Addr;
 static BACNET_IP6_ADDRESS BIP6_Broadcast_Addr;
@@ -240,6 +249,87 @@ int bip6_send_mpdu(BACNET_IP6_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
         (struct sockaddr *)&bvlc_dest, sizeof(bvlc_dest));
 }
 
+/**
+ * @brief Send the same datagram to each address of a list, with one
+ *  sendmmsg() for up to BIP6_SEND_BATCH of them.  The datagram is not
+ *  copied.
+ * @param dest_list - the destination addresses
+ * @param dest_count - number of destination addresses
+ * @param mtu - the bytes of data to send
+ * @param mtu_len - the number of bytes of data to send
+ * @param sent - returns true for each destination that it was sent to,
+ *  or NULL
+ * @return number of destinations that the datagram was sent to
+ */
+int bip6_send_mpdu_list(BACNET_IP6_ADDRESS *dest_list,
+    unsigned dest_count,
+    uint8_t *mtu,
+    uint16_t mtu_len,
+    bool *sent)
+{
+    struct sockaddr_in6 bvlc_dest[BIP6_SEND_BATCH];
+    struct mmsghdr msg[BIP6_SEND_BATCH];
+    struct iovec iov = { 0 };
+    unsigned batch = 0;
+    unsigned index = 0;
+    unsigned i = 0;
+    int count = 0;
+    int status = 0;
+
+    if (sent) {
+        for (i = 0; i < dest_count; i++) {
+            sent[i] = false;
+        }
+    }
+    /* assumes that the driver has already been initialized */
+    if (BIP6_Socket < 0) {
+        return 0;
+    }
+    iov.iov_base = mtu;
+    iov.iov_len = mtu_len;
+    while (index < dest_count) {
+        batch = dest_count - index;
+        if (batch > BIP6_SEND_BATCH) {
+            batch = BIP6_SEND_BATCH;
+        }
+        memset(msg, 0, sizeof(msg[0]) * batch);
+        for (i = 0; i < batch; i++) {
+            memset(&bvlc_dest[i], 0, sizeof(bvlc_dest[i]));
+            bvlc_dest[i].sin6_family = AF_INET6;
+            memcpy(&bvlc_dest[i].sin6_addr.s6_addr,
+                &dest_list[index + i].address[0], IP6_ADDRESS_MAX);
+            bvlc_dest[i].sin6_port = htons(dest_list[index + i].port);
+            msg[i].msg_hdr.msg_name = &bvlc_dest[i];
+            msg[i].msg_hdr.msg_namelen = sizeof(bvlc_dest[i]);
+            msg[i].msg_hdr.msg_iov = &iov;
+            msg[i].msg_hdr.msg_iovlen = 1;
+            debug_print_ipv6("Sending MPDU->", &bvlc_dest[i].sin6_addr);
+        }
+        i = 0;
+        while (i < batch) {
+            status = sendmmsg(BIP6_Socket, &msg[i], batch - i, 0);
+            if (status > 0) {
+                count += status;
+                while (status > 0) {
+                    if (sent) {
+                        sent[index + i] = true;
+                    }
+                    i++;
+                    status--;
+                }
+            } else if ((status < 0) && (errno == EINTR)) {
+                continue;
+            } else {
+                /* drop the datagram that failed, and send the rest */
+                i++;
+            }
+        }
+        index += batch;
+    }
+
+    return count;
+}
+
 /**
  * The common send function for BACnet/IPv6 application layer
  *
@@ -34,10 +34,11 @@ bool datetime_local(BACNET_DATE *bdate,
 {
     bool status = false;
     struct tm *tblock = NULL;
+    struct tm tm_local;
     struct timeval tv;
 
     if (gettimeofday(&tv, NULL) == 0) {
-        tblock = (struct tm *)localtime((const time_t *)&tv.tv_sec);
+        tblock = localtime_r(&tv.tv_sec, &tm_local);
     }
     if (tblock) {
         status = true;
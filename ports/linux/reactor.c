@@ -0,0 +1,272 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include "reactor.h"
+
+/** @file linux/reactor.c  Event loop of sockets and timers with epoll. */
+
+/* a socket or timer that the reactor waits on */
+struct reactor_source {
+    int fd;
+    bool timer;
+    unsigned long interval_ms;
+    reactor_fd_callback fd_callback;
+    reactor_timer_callback timer_callback;
+    void *context;
+};
+
+static struct reactor_source Reactor_Sources[REACTOR_SOURCES_MAX];
+static int Reactor_Epoll_Fd = -1;
+
+/**
+ * @brief Find the source of a file descriptor
+ * @param fd - file descriptor, or -1 to find an unused source
+ * @return the source, or NULL if not found
+ */
+static struct reactor_source *reactor_source_find(int fd)
+{
+    unsigned i;
+
+    for (i = 0; i < REACTOR_SOURCES_MAX; i++) {
+        if (Reactor_Sources[i].fd == fd) {
+            return &Reactor_Sources[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Add a source to the epoll set
+ * @param source - source with its file descriptor set
+ * @return true if the source was added
+ */
+static bool reactor_source_add(struct reactor_source *source)
+{
+    struct epoll_event event = { 0 };
+
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    if (epoll_ctl(Reactor_Epoll_Fd, EPOLL_CTL_ADD, source->fd, &event) < 0) {
+        source->fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Create the epoll set of the reactor
+ * @return true if the reactor is ready to use
+ */
+bool reactor_init(void)
+{
+    unsigned i;
+
+    if (Reactor_Epoll_Fd >= 0) {
+        return true;
+    }
+    for (i = 0; i < REACTOR_SOURCES_MAX; i++) {
+        memset(&Reactor_Sources[i], 0, sizeof(struct reactor_source));
+        Reactor_Sources[i].fd = -1;
+    }
+    Reactor_Epoll_Fd = epoll_create1(EPOLL_CLOEXEC);
+
+    return (Reactor_Epoll_Fd >= 0);
+}
+
+/**
+ * @brief Close the epoll set and the timers of the reactor.
+ *  The sockets that were added are left open for their owners.
+ */
+void reactor_cleanup(void)
+{
+    unsigned i;
+
+    for (i = 0; i < REACTOR_SOURCES_MAX; i++) {
+        if ((Reactor_Sources[i].fd >= 0) && Reactor_Sources[i].timer) {
+            close(Reactor_Sources[i].fd);
+        }
+        Reactor_Sources[i].fd = -1;
+    }
+    if (Reactor_Epoll_Fd >= 0) {
+        close(Reactor_Epoll_Fd);
+    }
+    Reactor_Epoll_Fd = -1;
+}
+
+/**
+ * @brief Wait for a socket or other file descriptor to be readable.
+ *  The reactor waits level-triggered, so the callback does not need to
+ *  read everything that is pending.
+ * @param fd - file descriptor to wait on
+ * @param callback - function called when the file descriptor is readable
+ * @param context - passed to the callback
+ * @return true if the file descriptor was added
+ */
+bool reactor_fd_add(int fd, reactor_fd_callback callback, void *context)
+{
+    struct reactor_source *source;
+
+    if ((Reactor_Epoll_Fd < 0) || (fd < 0) || !callback) {
+        return false;
+    }
+    if (reactor_source_find(fd)) {
+        return false;
+    }
+    source = reactor_source_find(-1);
+    if (!source) {
+        return false;
+    }
+    source->fd = fd;
+    source->timer = false;
+    source->interval_ms = 0;
+    source->fd_callback = callback;
+    source->timer_callback = NULL;
+    source->context = context;
+
+    return reactor_source_add(source);
+}
+
+/**
+ * @brief Stop waiting on a file descriptor
+ * @param fd - file descriptor that was added
+ * @return true if the file descriptor was removed
+ */
+bool reactor_fd_remove(int fd)
+{
+    struct reactor_source *source;
+
+    if (fd < 0) {
+        return false;
+    }
+    source = reactor_source_find(fd);
+    if (!source) {
+        return false;
+    }
+    epoll_ctl(Reactor_Epoll_Fd, EPOLL_CTL_DEL, fd, NULL);
+    source->fd = -1;
+
+    return true;
+}
+
+/**
+ * @brief Add a periodic timer, using a timerfd
+ * @param interval_ms - period of the timer in milliseconds
+ * @param callback - function called when the timer expires
+ * @param context - passed to the callback
+ * @return the file descriptor of the timer, or -1 on failure
+ */
+int reactor_timer_add(
+    unsigned long interval_ms, reactor_timer_callback callback, void *context)
+{
+    struct reactor_source *source;
+    struct itimerspec spec = { 0 };
+    int fd;
+
+    if ((Reactor_Epoll_Fd < 0) || (interval_ms == 0) || !callback) {
+        return -1;
+    }
+    source = reactor_source_find(-1);
+    if (!source) {
+        return -1;
+    }
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0) {
+        close(fd);
+        return -1;
+    }
+    source->fd = fd;
+    source->timer = true;
+    source->interval_ms = interval_ms;
+    source->fd_callback = NULL;
+    source->timer_callback = callback;
+    source->context = context;
+    if (!reactor_source_add(source)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Remove and close a timer
+ * @param timer_fd - file descriptor returned by reactor_timer_add()
+ * @return true if the timer was removed
+ */
+bool reactor_timer_remove(int timer_fd)
+{
+    struct reactor_source *source;
+
+    if (timer_fd < 0) {
+        return false;
+    }
+    source = reactor_source_find(timer_fd);
+    if (!source || !source->timer) {
+        return false;
+    }
+    epoll_ctl(Reactor_Epoll_Fd, EPOLL_CTL_DEL, timer_fd, NULL);
+    close(timer_fd);
+    source->fd = -1;
+
+    return true;
+}
+
+/**
+ * @brief Wait for sockets or timers to be ready, and call their callbacks
+ * @param timeout_ms - milliseconds to wait, 0 to not wait,
+ *  or -1 to wait until something is ready
+ * @return number of callbacks that were called, or -1 on error
+ */
+int reactor_run_once(int timeout_ms)
+{
+    struct epoll_event events[REACTOR_SOURCES_MAX];
+    struct reactor_source *source;
+    uint64_t expirations = 0;
+    int count;
+    int i;
+
+    if (Reactor_Epoll_Fd < 0) {
+        return -1;
+    }
+    count = epoll_wait(Reactor_Epoll_Fd, events, REACTOR_SOURCES_MAX,
+        timeout_ms);
+    if (count < 0) {
+        /* a signal is not an error */
+        return (errno == EINTR) ? 0 : -1;
+    }
+    for (i = 0; i < count; i++) {
+        source = events[i].data.ptr;
+        /* removed by an earlier callback */
+        if (source->fd < 0) {
+            continue;
+        }
+        if (source->timer) {
+            if (read(source->fd, &expirations, sizeof(expirations)) !=
+                sizeof(expirations)) {
+                continue;
+            }
+            source->timer_callback(
+                (unsigned long)expirations * source->interval_ms,
+                source->context);
+        } else {
+            source->fd_callback(source->fd, source->context);
+        }
+    }
+
+    return count;
+}
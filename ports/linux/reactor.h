@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bacnet/bacnet_stack_exports.h"
+
+/* maximum number of sockets and timers that the reactor waits on */
+#ifndef REACTOR_SOURCES_MAX
+#define REACTOR_SOURCES_MAX 16
+#endif
+
+/* called when a file descriptor is ready to be read */
+typedef void (*reactor_fd_callback)(int fd, void *context);
+/* called when a timer has expired, with the milliseconds since
+   the last call, which may be several intervals if calls were missed */
+typedef void (*reactor_timer_callback)(
+    unsigned long milliseconds, void *context);
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    BACNET_STACK_EXPORT
+    bool reactor_init(
+        void);
+    BACNET_STACK_EXPORT
+    void reactor_cleanup(
+        void);
+    BACNET_STACK_EXPORT
+    bool reactor_fd_add(
+        int fd,
+        reactor_fd_callback callback,
+        void *context);
+    BACNET_STACK_EXPORT
+    bool reactor_fd_remove(
+        int fd);
+    BACNET_STACK_EXPORT
+    int reactor_timer_add(
+        unsigned long interval_ms,
+        reactor_timer_callback callback,
+        void *context);
+    BACNET_STACK_EXPORT
+    bool reactor_timer_remove(
+        int timer_fd);
+    BACNET_STACK_EXPORT
+    int reactor_run_once(
+        int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup Reactor Linux epoll event loop
+ * @ingroup DataLink
+ * The reactor waits on the datalink sockets and on timerfd timers with
+ * a single epoll set, and calls the callback of each one that is ready.
+ * Applications register their sockets and periodic tasks once, and then
+ * call reactor_run_once() in their main loop instead of polling.
+ */
+#endif
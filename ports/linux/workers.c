@@ -0,0 +1,304 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef _GNU_SOURCE
+/* for pthread_rwlockattr_setkind_np() */
+#define _GNU_SOURCE
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bacnet/bits.h"
+#include "bacnet/bacaddr.h"
+#include "bacnet/npdu.h"
+#include "bacnet/basic/npdu/h_npdu.h"
+#include "bacnet/basic/tsm/tsm.h"
+#include "workers.h"
+
+/** @file linux/workers.c  Pool of threads that handle confirmed requests. */
+
+/* a confirmed request waiting for a worker */
+struct workers_request {
+    BACNET_ADDRESS src;
+    uint16_t pdu_len;
+    /* true if the request only reads the objects */
+    bool shared;
+    uint8_t pdu[MAX_PDU];
+};
+
+/* a worker thread and the requests of its peers */
+struct worker {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    /* signaled when a request is added, or the worker is stopped */
+    pthread_cond_t ready;
+    /* signaled when a request has been handled */
+    pthread_cond_t space;
+    bool running;
+    /* the request being handled stays in the queue until it is done */
+    unsigned head;
+    unsigned count;
+    struct workers_request queue[WORKERS_QUEUE_SIZE];
+};
+
+static struct worker *Workers;
+static unsigned Worker_Count;
+/* protects the objects, and the rest of the stack, from the services
+   that change them */
+static pthread_rwlock_t Object_Lock;
+#if BACNET_SEGMENTATION_ENABLED
+/* keeps two workers from setting up segmented ComplexACKs at once */
+static pthread_mutex_t Segmented_Mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+/* the confirmed services that only read the objects */
+static bool Shared_Service[MAX_BACNET_CONFIRMED_SERVICE];
+
+/**
+ * @brief Choose the worker of a peer
+ * @param peer - address of the peer, including any routing information
+ * @return the worker that handles the requests of the peer
+ */
+static struct worker *workers_peer(BACNET_ADDRESS *peer)
+{
+    uint32_t hash = 2166136261UL;
+    unsigned i;
+
+    for (i = 0; (i < peer->mac_len) && (i < MAX_MAC_LEN); i++) {
+        hash = (hash ^ peer->mac[i]) * 16777619UL;
+    }
+    hash = (hash ^ (peer->net & 0xFF)) * 16777619UL;
+    hash = (hash ^ (peer->net >> 8)) * 16777619UL;
+    for (i = 0; (i < peer->len) && (i < MAX_MAC_LEN); i++) {
+        hash = (hash ^ peer->adr[i]) * 16777619UL;
+    }
+
+    return &Workers[hash % Worker_Count];
+}
+
+#if BACNET_SEGMENTATION_ENABLED
+static void workers_segmented_lock(bool lock)
+{
+    if (lock) {
+        pthread_mutex_lock(&Segmented_Mutex);
+    } else {
+        pthread_mutex_unlock(&Segmented_Mutex);
+    }
+}
+#endif
+
+/**
+ * @brief Handle the requests of a worker, in order, until it is stopped
+ * @param pArgs - the worker
+ */
+static void *workers_thread(void *pArgs)
+{
+    struct worker *worker = pArgs;
+    struct workers_request *request;
+
+    for (;;) {
+        pthread_mutex_lock(&worker->mutex);
+        while ((worker->count == 0) && worker->running) {
+            pthread_cond_wait(&worker->ready, &worker->mutex);
+        }
+        if (worker->count == 0) {
+            pthread_mutex_unlock(&worker->mutex);
+            break;
+        }
+        request = &worker->queue[worker->head];
+        pthread_mutex_unlock(&worker->mutex);
+        if (request->shared) {
+            pthread_rwlock_rdlock(&Object_Lock);
+        } else {
+            pthread_rwlock_wrlock(&Object_Lock);
+        }
+        npdu_handler(&request->src, &request->pdu[0], request->pdu_len);
+        pthread_rwlock_unlock(&Object_Lock);
+        pthread_mutex_lock(&worker->mutex);
+        worker->head = (worker->head + 1) % WORKERS_QUEUE_SIZE;
+        worker->count--;
+        pthread_cond_signal(&worker->space);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Start the worker threads
+ * @param count - number of worker threads, up to WORKERS_MAX
+ * @return true if the workers are running
+ */
+bool workers_init(unsigned count)
+{
+    pthread_rwlockattr_t attr;
+    unsigned i;
+
+    if (Worker_Count || (count == 0) || (count > WORKERS_MAX)) {
+        return false;
+    }
+    Workers = calloc(count, sizeof(struct worker));
+    if (!Workers) {
+        return false;
+    }
+    /* the receiving thread must not wait behind a stream of reads */
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(
+        &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&Object_Lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+#if BACNET_SEGMENTATION_ENABLED
+    tsm_set_segmented_lock_function(workers_segmented_lock);
+#endif
+    for (i = 0; i < count; i++) {
+        pthread_mutex_init(&Workers[i].mutex, NULL);
+        pthread_cond_init(&Workers[i].ready, NULL);
+        pthread_cond_init(&Workers[i].space, NULL);
+        Workers[i].running = true;
+        if (pthread_create(
+                &Workers[i].thread, NULL, workers_thread, &Workers[i]) != 0) {
+            break;
+        }
+        Worker_Count++;
+    }
+    if (Worker_Count < count) {
+        workers_cleanup();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stop the worker threads, once they have handled the requests
+ *  that are waiting
+ */
+void workers_cleanup(void)
+{
+    unsigned i;
+
+    for (i = 0; i < Worker_Count; i++) {
+        pthread_mutex_lock(&Workers[i].mutex);
+        Workers[i].running = false;
+        pthread_cond_signal(&Workers[i].ready);
+        pthread_mutex_unlock(&Workers[i].mutex);
+    }
+    for (i = 0; i < Worker_Count; i++) {
+        pthread_join(Workers[i].thread, NULL);
+        pthread_mutex_destroy(&Workers[i].mutex);
+        pthread_cond_destroy(&Workers[i].ready);
+        pthread_cond_destroy(&Workers[i].space);
+    }
+    if (Workers) {
+#if BACNET_SEGMENTATION_ENABLED
+        tsm_set_segmented_lock_function(NULL);
+#endif
+        pthread_rwlock_destroy(&Object_Lock);
+    }
+    free(Workers);
+    Workers = NULL;
+    Worker_Count = 0;
+}
+
+/**
+ * @brief Get the number of worker threads
+ * @return number of worker threads, or zero if they are not running
+ */
+unsigned workers_count(void)
+{
+    return Worker_Count;
+}
+
+/**
+ * @brief Set whether a confirmed service only reads the objects, so that
+ *  its requests can be handled in parallel with each other
+ * @param service - confirmed service
+ * @param shared - true if the service handler only reads the objects
+ */
+void workers_shared_service_set(BACNET_CONFIRMED_SERVICE service, bool shared)
+{
+    if (service < MAX_BACNET_CONFIRMED_SERVICE) {
+        Shared_Service[service] = shared;
+    }
+}
+
+/**
+ * @brief Hand a confirmed request to the worker of its peer.  If the
+ *  worker is busy with as many requests as it can hold, wait for it.
+ * @param src - source address of the NPDU
+ * @param pdu - the NPDU
+ * @param pdu_len - length of the NPDU
+ * @return true if a worker will handle the NPDU, or false if it is not
+ *  a confirmed request for this device, and the caller handles it with
+ *  npdu_handler() while holding workers_lock()
+ */
+bool workers_dispatch(BACNET_ADDRESS *src, uint8_t *pdu, uint16_t pdu_len)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_ADDRESS peer;
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    struct worker *worker;
+    struct workers_request *request;
+    uint8_t *apdu;
+    int apdu_offset;
+    bool shared = false;
+
+    if ((Worker_Count == 0) || (pdu_len < 1) || (pdu_len > MAX_PDU) ||
+        (pdu[0] != BACNET_PROTOCOL_VERSION)) {
+        return false;
+    }
+    bacnet_address_copy(&peer, src);
+    apdu_offset = bacnet_npdu_decode(&pdu[0], pdu_len, &dest, &peer,
+        &npdu_data);
+    if (npdu_data.network_layer_message || (apdu_offset <= 0) ||
+        (apdu_offset >= pdu_len) || (dest.net != 0)) {
+        return false;
+    }
+    apdu = &pdu[apdu_offset];
+    if ((apdu[0] & 0xF0) != PDU_TYPE_CONFIRMED_SERVICE_REQUEST) {
+        return false;
+    }
+    /* the segments of a request are gathered by the TSM */
+    if (!(apdu[0] & BIT(3)) && ((pdu_len - apdu_offset) >= 4) &&
+        (apdu[3] < MAX_BACNET_CONFIRMED_SERVICE)) {
+        shared = Shared_Service[apdu[3]];
+    }
+    worker = workers_peer(&peer);
+    pthread_mutex_lock(&worker->mutex);
+    while (worker->count >= WORKERS_QUEUE_SIZE) {
+        pthread_cond_wait(&worker->space, &worker->mutex);
+    }
+    request = &worker->queue[(worker->head + worker->count) %
+        WORKERS_QUEUE_SIZE];
+    bacnet_address_copy(&request->src, src);
+    memcpy(&request->pdu[0], pdu, pdu_len);
+    request->pdu_len = pdu_len;
+    request->shared = shared;
+    worker->count++;
+    pthread_cond_signal(&worker->ready);
+    pthread_mutex_unlock(&worker->mutex);
+
+    return true;
+}
+
+/**
+ * @brief Keep the workers from handling requests, so that the caller
+ *  can use the objects and the rest of the stack
+ */
+void workers_lock(void)
+{
+    if (Worker_Count) {
+        pthread_rwlock_wrlock(&Object_Lock);
+    }
+}
+
+/**
+ * @brief Let the workers handle requests again
+ */
+void workers_unlock(void)
+{
+    if (Worker_Count) {
+        pthread_rwlock_unlock(&Object_Lock);
+    }
+}
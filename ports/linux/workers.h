@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bacnet/bacnet_stack_exports.h"
+#include "bacnet/bacdef.h"
+#include "bacnet/bacenum.h"
+
+/* largest number of worker threads */
+#ifndef WORKERS_MAX
+#define WORKERS_MAX 16
+#endif
+/* number of confirmed requests waiting for each worker */
+#ifndef WORKERS_QUEUE_SIZE
+#define WORKERS_QUEUE_SIZE 32
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    BACNET_STACK_EXPORT
+    bool workers_init(
+        unsigned count);
+    BACNET_STACK_EXPORT
+    void workers_cleanup(
+        void);
+    BACNET_STACK_EXPORT
+    unsigned workers_count(
+        void);
+    BACNET_STACK_EXPORT
+    void workers_shared_service_set(
+        BACNET_CONFIRMED_SERVICE service,
+        bool shared);
+    BACNET_STACK_EXPORT
+    bool workers_dispatch(
+        BACNET_ADDRESS * src,
+        uint8_t * pdu,
+        uint16_t pdu_len);
+    BACNET_STACK_EXPORT
+    void workers_lock(
+        void);
+    BACNET_STACK_EXPORT
+    void workers_unlock(
+        void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+/** @defgroup Workers Linux pool of threads for confirmed requests
+ * @ingroup DataLink
+ * The thread that receives from the datalink hands each confirmed
+ * request to a pool of worker threads with workers_dispatch(), and
+ * handles everything else itself.
+ *
+ * The requests of each peer always go to the same worker, which
+ * handles them in the order they were received, so the replies to
+ * a peer are sent in order.
+ *
+ * The objects are protected by one lock.  The services that only read
+ * the objects, which are set with workers_shared_service_set(), share
+ * the lock and run in parallel.  Other confirmed services hold the lock
+ * alone, and so must the receiving thread, with workers_lock(), while it
+ * handles other messages or runs the timers of the objects and the TSM.
+ * The service handlers need BACNET_THREADS, so that each thread has its
+ * own transmit buffers.
+ */
+#endif
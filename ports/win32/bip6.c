@@ -364,6 +364,39 @@ int bip6_send_mpdu(BACNET_IP6_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
         (struct sockaddr *)&bvlc_dest, sizeof(bvlc_dest));
 }
 
+/**
+ * @brief Send the same datagram to each address of a list
+ * @param dest_list - the destination addresses
+ * @param dest_count - number of destination addresses
+ * @param mtu - the bytes of data to send
+ * @param mtu_len - the number of bytes of data to send
+ * @param sent - returns true for each destination that it was sent to,
+ *  or NULL
+ * @return number of destinations that the datagram was sent to
+ */
+int bip6_send_mpdu_list(BACNET_IP6_ADDRESS *dest_list,
+    unsigned dest_count,
+    uint8_t *mtu,
+    uint16_t mtu_len,
+    bool *sent)
+{
+    unsigned i = 0;
+    int count = 0;
+    bool status = false;
+
+    for (i = 0; i < dest_count; i++) {
+        status = (bip6_send_mpdu(&dest_list[i], mtu, mtu_len) > 0);
+        if (status) {
+            count++;
+        }
+        if (sent) {
+            sent[i] = status;
+        }
+    }
+
+    return count;
+}
+
 /**
  * The common send function for BACnet/IPv6 application layer
  *
@@ -34,6 +34,7 @@
 #include "bacnet/bacdcode.h"
 #include "bacnet/bacenum.h"
 #include "bacnet/bactext.h"
+#include "bacnet/cov.h"
 #include "bacnet/config.h" /* the custom stuff */
 #include "bacnet/basic/object/device.h"
 #include "bacnet/basic/services.h"
@@ -52,7 +53,35 @@
 #define MAX_ANALOG_INPUTS 4
 #endif
 
-static ANALOG_INPUT_DESCR AI_Descr[MAX_ANALOG_INPUTS];
+/* the properties of an object, all kept in its descriptor */
+typedef struct analog_input_port_descr {
+    unsigned Event_State:3;
+    float Present_Value;
+    BACNET_RELIABILITY Reliability;
+    bool Out_Of_Service;
+    uint8_t Units;
+    float Prior_Value;
+    float COV_Increment;
+    bool Changed;
+#if defined(INTRINSIC_REPORTING)
+    uint32_t Time_Delay;
+    uint32_t Notification_Class;
+    float High_Limit;
+    float Low_Limit;
+    float Deadband;
+    unsigned Limit_Enable:2;
+    unsigned Event_Enable:3;
+    unsigned Notify_Type:1;
+    ACKED_INFO Acked_Transitions[MAX_BACNET_EVENT_TRANSITION];
+    BACNET_DATE_TIME Event_Time_Stamps[MAX_BACNET_EVENT_TRANSITION];
+    /* time to generate event notification */
+    uint32_t Remaining_Time_Delay;
+    /* AckNotification informations */
+    ACK_NOTIFICATION Ack_notify_data;
+#endif
+} ANALOG_INPUT_PORT_DESCR;
+
+static ANALOG_INPUT_PORT_DESCR AI_Descr[MAX_ANALOG_INPUTS];
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
@@ -198,6 +227,8 @@ static void Analog_Input_COV_Detect(unsigned int index, float value)
         if (cov_delta >= cov_increment) {
             AI_Descr[index].Changed = true;
             AI_Descr[index].Prior_Value = value;
+            cov_change_detected_notify(
+                OBJECT_ANALOG_INPUT, Analog_Input_Index_To_Instance(index));
         }
     }
 }
@@ -359,6 +390,7 @@ void Analog_Input_Out_Of_Service_Set(uint32_t object_instance, bool value)
         September 2016 */
         if (AI_Descr[index].Out_Of_Service != value) {
             AI_Descr[index].Changed = true;
+            cov_change_detected_notify(OBJECT_ANALOG_INPUT, object_instance);
         }
         AI_Descr[index].Out_Of_Service = value;
     }
@@ -371,7 +403,7 @@ int Analog_Input_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
     int apdu_len = 0; /* return value */
     BACNET_BIT_STRING bit_string;
     BACNET_CHARACTER_STRING char_string;
-    ANALOG_INPUT_DESCR *CurrentAI;
+    ANALOG_INPUT_PORT_DESCR *CurrentAI;
     unsigned object_index = 0;
 #if defined(INTRINSIC_REPORTING)
     unsigned i = 0;
@@ -604,7 +636,7 @@ bool Analog_Input_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
     unsigned int object_index = 0;
     int len = 0;
     BACNET_APPLICATION_DATA_VALUE value;
-    ANALOG_INPUT_DESCR *CurrentAI;
+    ANALOG_INPUT_PORT_DESCR *CurrentAI;
 
     /* decode the some of the request */
     len = bacapp_decode_application_data(
@@ -799,7 +831,7 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
 #if defined(INTRINSIC_REPORTING)
     BACNET_EVENT_NOTIFICATION_DATA event_data = { 0 };
     BACNET_CHARACTER_STRING msgText = { 0 };
-    ANALOG_INPUT_DESCR *CurrentAI = NULL;
+    ANALOG_INPUT_PORT_DESCR *CurrentAI = NULL;
     unsigned int object_index = 0;
     uint8_t FromState = 0;
     uint8_t ToState = 0;
@@ -1207,7 +1239,7 @@ int Analog_Input_Event_Information(
 int Analog_Input_Alarm_Ack(
     BACNET_ALARM_ACK_DATA *alarmack_data, BACNET_ERROR_CODE *error_code)
 {
-    ANALOG_INPUT_DESCR *CurrentAI;
+    ANALOG_INPUT_PORT_DESCR *CurrentAI;
     unsigned int object_index;
 
     object_index = Analog_Input_Instance_To_Index(
@@ -36,6 +36,7 @@
 #include "bacnet/bacenum.h"
 #include "bacnet/bacapp.h"
 #include "bacnet/bactext.h"
+#include "bacnet/cov.h"
 #include "bacnet/config.h" /* the custom stuff */
 #include "bacnet/basic/object/device.h"
 #include "bacnet/basic/services.h"
@@ -45,7 +46,34 @@
 #define MAX_ANALOG_VALUES 4
 #endif
 
-static ANALOG_VALUE_DESCR AV_Descr[MAX_ANALOG_VALUES];
+/* the properties of an object, all kept in its descriptor */
+typedef struct analog_value_port_descr {
+    unsigned Event_State:3;
+    bool Out_Of_Service;
+    uint16_t Units;
+    float Present_Value;
+    float Prior_Value;
+    float COV_Increment;
+    bool Changed;
+#if defined(INTRINSIC_REPORTING)
+    uint32_t Time_Delay;
+    uint32_t Notification_Class;
+    float High_Limit;
+    float Low_Limit;
+    float Deadband;
+    unsigned Limit_Enable:2;
+    unsigned Event_Enable:3;
+    unsigned Notify_Type:1;
+    ACKED_INFO Acked_Transitions[MAX_BACNET_EVENT_TRANSITION];
+    BACNET_DATE_TIME Event_Time_Stamps[MAX_BACNET_EVENT_TRANSITION];
+    /* time to generate event notification */
+    uint32_t Remaining_Time_Delay;
+    /* AckNotification informations */
+    ACK_NOTIFICATION Ack_notify_data;
+#endif
+} ANALOG_VALUE_PORT_DESCR;
+
+static ANALOG_VALUE_PORT_DESCR AV_Descr[MAX_ANALOG_VALUES];
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Analog_Value_Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
@@ -98,7 +126,7 @@ void Analog_Value_Init(void)
 #endif
 
     for (i = 0; i < MAX_ANALOG_VALUES; i++) {
-        memset(&AV_Descr[i], 0x00, sizeof(ANALOG_VALUE_DESCR));
+        memset(&AV_Descr[i], 0x00, sizeof(ANALOG_VALUE_PORT_DESCR));
         AV_Descr[i].Present_Value = 0.0;
         AV_Descr[i].Units = UNITS_NO_UNITS;
         AV_Descr[i].Prior_Value = 0.0f;
@@ -216,6 +244,8 @@ static void Analog_Value_COV_Detect(unsigned int index, float value)
         if (cov_delta >= cov_increment) {
             AV_Descr[index].Changed = true;
             AV_Descr[index].Prior_Value = value;
+            cov_change_detected_notify(
+                OBJECT_ANALOG_VALUE, Analog_Value_Index_To_Instance(index));
         }
     }
 }
@@ -449,6 +479,7 @@ void Analog_Value_Out_Of_Service_Set(uint32_t object_instance, bool value)
     if (index < MAX_ANALOG_VALUES) {
         if (AV_Descr[index].Out_Of_Service != value) {
             AV_Descr[index].Changed = true;
+            cov_change_detected_notify(OBJECT_ANALOG_VALUE, object_instance);
         }
         AV_Descr[index].Out_Of_Service = value;
     }
@@ -470,7 +501,7 @@ int Analog_Value_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
     unsigned object_index = 0;
     bool state = false;
     uint8_t *apdu = NULL;
-    ANALOG_VALUE_DESCR *CurrentAV;
+    ANALOG_VALUE_PORT_DESCR *CurrentAV;
 #if defined(INTRINSIC_REPORTING)
     int len = 0;
     unsigned i = 0;
@@ -703,7 +734,7 @@ bool Analog_Value_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
     unsigned int object_index = 0;
     int len = 0;
     BACNET_APPLICATION_DATA_VALUE value;
-    ANALOG_VALUE_DESCR *CurrentAV;
+    ANALOG_VALUE_PORT_DESCR *CurrentAV;
 
     /* Valid data? */
     if (wp_data == NULL) {
@@ -920,7 +951,7 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
 #if defined(INTRINSIC_REPORTING)
     BACNET_EVENT_NOTIFICATION_DATA event_data;
     BACNET_CHARACTER_STRING msgText;
-    ANALOG_VALUE_DESCR *CurrentAV;
+    ANALOG_VALUE_PORT_DESCR *CurrentAV;
     unsigned int object_index;
     uint8_t FromState = 0;
     uint8_t ToState;
@@ -1300,7 +1331,7 @@ int Analog_Value_Event_Information(
 int Analog_Value_Alarm_Ack(
     BACNET_ALARM_ACK_DATA *alarmack_data, BACNET_ERROR_CODE *error_code)
 {
-    ANALOG_VALUE_DESCR *CurrentAV;
+    ANALOG_VALUE_PORT_DESCR *CurrentAV;
     unsigned int object_index;
 
     object_index = Analog_Value_Instance_To_Index(
@@ -297,6 +297,78 @@ int bip_send_mpdu(BACNET_IP_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
         (struct sockaddr *)&bip_dest, sizeof(struct sockaddr));
 }
 
+/**
+ * @brief Send the same datagram to each address of a list
+ * @param dest_list - the destination addresses
+ * @param dest_count - number of destination addresses
+ * @param mtu - the bytes of data to send
+ * @param mtu_len - the number of bytes of data to send
+ * @param sent - returns true for each destination that it was sent to,
+ *  or NULL
+ * @return number of destinations that the datagram was sent to
+ */
+int bip_send_mpdu_list(BACNET_IP_ADDRESS *dest_list,
+    unsigned dest_count,
+    uint8_t *mtu,
+    uint16_t mtu_len,
+    bool *sent)
+{
+    unsigned i = 0;
+    int count = 0;
+    bool status = false;
+
+    for (i = 0; i < dest_count; i++) {
+        status = (bip_send_mpdu(&dest_list[i], mtu, mtu_len) > 0);
+        if (status) {
+            count++;
+        }
+        if (sent) {
+            sent[i] = status;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Get the socket of the BACnet/IP datalink, to wait on it
+ * @return the socket, or -1 if the datalink is not initialized
+ */
+int bip_socket(void)
+{
+    return BIP_Socket;
+}
+
+/**
+ * @brief Determine if datagrams that were already received are waiting
+ *  to be returned by bip_receive().  This port reads one datagram at a time.
+ * @return false
+ */
+bool bip_receive_pending(void)
+{
+    return false;
+}
+
+/**
+ * @brief Queue the datagrams of bip_send_mpdu() instead of sending each
+ *  one at once.  This port always sends each datagram at once.
+ * @param enable - ignored
+ */
+void bip_send_batch_enable(bool enable)
+{
+    (void)enable;
+}
+
+/**
+ * @brief Send the datagrams queued by bip_send_mpdu().  This port does
+ *  not queue datagrams.
+ * @return 0
+ */
+int bip_send_flush(void)
+{
+    return 0;
+}
+
 /**
  * BACnet/IP Datalink Receive handler.
  *
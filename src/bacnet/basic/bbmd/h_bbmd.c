@@ -32,10 +32,13 @@
  -------------------------------------------
 ####COPYRIGHTEND####*/
 
+#include <limits.h> /* for UINT_MAX */
 #include <stdio.h> /* for standard i/o, like printing */
 #include <stdint.h> /* for standard integer types uint8_t etc. */
 #include <stdbool.h> /* for the standard bool type. */
+#include <stdlib.h> /* for malloc */
 #include <string.h> /* for memcpy */
+#include <time.h> /* for the time of the FDT backup */
 #include "bacnet/bacdcode.h"
 #include "bacnet/npdu.h"
 #include "bacnet/datalink/bip.h"
@@ -85,11 +88,79 @@ static uint16_t BVLC_Buffer_Len;
 #endif
 static BACNET_IP_BROADCAST_DISTRIBUTION_TABLE_ENTRY
     BBMD_Table[MAX_BBMD_ENTRIES];
-/* Foreign Device Table */
+/* Foreign Device Table, which grows a block of entries at a time up to
+   MAX_FD_ENTRIES.  The entries stay linked in one list, as for the BDT. */
 #ifndef MAX_FD_ENTRIES
-#define MAX_FD_ENTRIES 128
+#define MAX_FD_ENTRIES 4096
+#endif
+#ifndef FD_TABLE_BLOCK
+#define FD_TABLE_BLOCK 64
+#endif
+#define FDT_NONE UINT_MAX
+/* an FDT entry with its places in the address index, the expiry heap and
+   the forward list.  The entry comes first, so that each points to the
+   other. */
+typedef struct bbmd_fdt_slot {
+    BACNET_IP_FOREIGN_DEVICE_TABLE_ENTRY entry;
+    /* BBMD_Seconds when the entry expires */
+    uint32_t expires;
+    unsigned heap_index;
+    unsigned forward_index;
+    struct bbmd_fdt_slot *next_free;
+} BBMD_FDT_SLOT;
+typedef struct bbmd_fdt_block {
+    struct bbmd_fdt_block *next;
+    BBMD_FDT_SLOT slot[FD_TABLE_BLOCK];
+} BBMD_FDT_BLOCK;
+static BBMD_FDT_BLOCK FDT_First_Block;
+static BBMD_FDT_BLOCK *FDT_Last_Block = &FDT_First_Block;
+static unsigned FDT_Capacity;
+static BBMD_FDT_SLOT *FDT_Free;
+/* the valid entries, as a binary min-heap ordered by expiry */
+static BBMD_FDT_SLOT **FDT_Heap;
+static unsigned FDT_Count;
+/* the valid entries, hashed by address with linear probing */
+static BBMD_FDT_SLOT **FDT_Index;
+static unsigned FDT_Index_Size;
+/* where the FDT is kept across restarts, and whether it has changed.
+   The changes are written at most once each BBMD_FDT_BACKUP_INTERVAL
+   seconds, so that a burst of registrations and renewals costs one write.
+   An entry restored from an older file only expires sooner. */
+static char *FDT_Backup_File;
+static bool FDT_Backup_Pending;
+/* BBMD_Seconds when the FDT may be written again */
+static uint32_t FDT_Backup_Seconds;
+/* seconds counted by the maintenance timer */
+static uint32_t BBMD_Seconds;
+/* the clock of the FDT backup file, or NULL for the system clock */
+static bvlc_clock_function BBMD_Clock;
+/* The distinct destinations of the Forwarded-NPDUs for the BDT and for
+   the FDT, without our own address, with their counters.  The BDT list is
+   worked out again when the table changes, and the FDT list follows each
+   registration.  Both are checked again when our address or the NAT
+   handling changes. */
+typedef struct bbmd_forward_list {
+    bool valid;
+    unsigned count;
+    BACNET_IP_ADDRESS my_addr;
+    BACNET_IP_ADDRESS *dest;
+    BACNET_IP_FORWARD_COUNTS *counts;
+    /* Forwarded-NPDUs sent when the counters were last read */
+    uint32_t *forwarded;
+    uint32_t forwarded_seconds;
+    /* FDT entry of each destination */
+    BBMD_FDT_SLOT **slot;
+} BBMD_FORWARD_LIST;
+static BACNET_IP_ADDRESS BDT_Forward_Dest[MAX_BBMD_ENTRIES];
+static BACNET_IP_FORWARD_COUNTS BDT_Forward_Counts[MAX_BBMD_ENTRIES];
+static uint32_t BDT_Forwarded[MAX_BBMD_ENTRIES];
+static BBMD_FORWARD_LIST BDT_Forward = { false, 0, { { 0 }, 0 },
+    BDT_Forward_Dest, BDT_Forward_Counts, BDT_Forwarded, 0, NULL };
+static BBMD_FORWARD_LIST FDT_Forward;
+/* number of Forwarded-NPDUs handed to the port at once */
+#ifndef BBMD_FORWARD_CHUNK
+#define BBMD_FORWARD_CHUNK 64
 #endif
-static BACNET_IP_FOREIGN_DEVICE_TABLE_ENTRY FD_Table[MAX_FD_ENTRIES];
 #endif
 
 /**
@@ -224,6 +295,7 @@ void bvlc_bdt_restore_local(void)
             memcpy(BBMD_Table, BBMD_Table_tmp,
                 sizeof(BACNET_IP_BROADCAST_DISTRIBUTION_TABLE_ENTRY) *
                     MAX_BBMD_ENTRIES);
+            BDT_Forward.valid = false;
         }
     }
 }
@@ -237,6 +309,539 @@ void bvlc_bdt_restore_local(void)
 #endif
 #endif
 
+#if BBMD_ENABLED
+/** Hashes a B/IP address for the index of the FDT
+ *
+ * @param addr - B/IP address
+ * @return the place in the index where the search for the address starts
+ */
+static unsigned bbmd_fdt_hash(const BACNET_IP_ADDRESS *addr)
+{
+    uint32_t hash = 2166136261UL;
+    unsigned i = 0;
+
+    for (i = 0; i < IP_ADDRESS_MAX; i++) {
+        hash = (hash ^ addr->address[i]) * 16777619UL;
+    }
+    hash = (hash ^ (addr->port & 0xFF)) * 16777619UL;
+    hash = (hash ^ (addr->port >> 8)) * 16777619UL;
+
+    return hash & (FDT_Index_Size - 1);
+}
+
+/** Finds the place of a foreign device in the index of the FDT
+ *
+ * @param addr - B/IP address of the foreign device
+ * @return the place in the index, or FDT_NONE if it is not registered
+ */
+static unsigned bbmd_fdt_index_find(const BACNET_IP_ADDRESS *addr)
+{
+    unsigned i = 0;
+
+    if (!FDT_Index_Size) {
+        return FDT_NONE;
+    }
+    for (i = bbmd_fdt_hash(addr); FDT_Index[i];
+         i = (i + 1) & (FDT_Index_Size - 1)) {
+        if (!bvlc_address_different(&FDT_Index[i]->entry.dest_address, addr)) {
+            return i;
+        }
+    }
+
+    return FDT_NONE;
+}
+
+/** Finds a foreign device in the FDT
+ *
+ * @param addr - B/IP address of the foreign device
+ * @return the entry of the foreign device, or NULL if it is not registered
+ */
+static BBMD_FDT_SLOT *bbmd_fdt_find(const BACNET_IP_ADDRESS *addr)
+{
+    unsigned i = bbmd_fdt_index_find(addr);
+
+    return (i == FDT_NONE) ? NULL : FDT_Index[i];
+}
+
+/** Adds an entry to the index of the FDT, which has room for it
+ *
+ * @param slot - FDT entry
+ */
+static void bbmd_fdt_index_add(BBMD_FDT_SLOT *slot)
+{
+    unsigned i = 0;
+
+    for (i = bbmd_fdt_hash(&slot->entry.dest_address); FDT_Index[i];
+         i = (i + 1) & (FDT_Index_Size - 1)) {
+    }
+    FDT_Index[i] = slot;
+}
+
+/** Removes an entry from the index of the FDT, moving back the entries
+ * after it that could not have their own place, so that no search stops
+ * short of them.
+ *
+ * @param i - place of the entry in the index
+ */
+static void bbmd_fdt_index_remove(unsigned i)
+{
+    unsigned mask = FDT_Index_Size - 1;
+    unsigned j = i;
+    unsigned k = 0;
+
+    FDT_Index[i] = NULL;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!FDT_Index[j]) {
+            break;
+        }
+        k = bbmd_fdt_hash(&FDT_Index[j]->entry.dest_address);
+        if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+            /* still found from its own place */
+            continue;
+        }
+        FDT_Index[i] = FDT_Index[j];
+        FDT_Index[j] = NULL;
+        i = j;
+    }
+}
+
+/** Swaps two entries of the expiry heap of the FDT
+ *
+ * @param a - place of one entry in the heap
+ * @param b - place of the other entry in the heap
+ */
+static void bbmd_fdt_heap_swap(unsigned a, unsigned b)
+{
+    BBMD_FDT_SLOT *slot = FDT_Heap[a];
+
+    FDT_Heap[a] = FDT_Heap[b];
+    FDT_Heap[b] = slot;
+    FDT_Heap[a]->heap_index = a;
+    FDT_Heap[b]->heap_index = b;
+}
+
+/** Moves an entry of the expiry heap of the FDT, whose expiry has
+ * changed, up or down to where it belongs.
+ *
+ * @param i - place of the entry in the heap
+ */
+static void bbmd_fdt_heap_fix(unsigned i)
+{
+    unsigned child = 0;
+
+    while ((i > 0) &&
+        (FDT_Heap[i]->expires < FDT_Heap[(i - 1) / 2]->expires)) {
+        bbmd_fdt_heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        child = (2 * i) + 1;
+        if (child >= FDT_Count) {
+            break;
+        }
+        if (((child + 1) < FDT_Count) &&
+            (FDT_Heap[child + 1]->expires < FDT_Heap[child]->expires)) {
+            child++;
+        }
+        if (FDT_Heap[i]->expires <= FDT_Heap[child]->expires) {
+            break;
+        }
+        bbmd_fdt_heap_swap(i, child);
+        i = child;
+    }
+}
+
+/** Determines if a destination is left out of a forward list
+ *
+ * @param list - forward list of the BDT or of the FDT
+ * @param dest - destination
+ * @return true if the BBMD does not forward broadcasts to the destination
+ */
+static bool bbmd_forward_address_excluded(
+    BBMD_FORWARD_LIST *list, BACNET_IP_ADDRESS *dest)
+{
+    if (!bvlc_address_different(dest, &list->my_addr)) {
+        /* don't forward to our selves */
+        return true;
+    }
+    if (BVLC_NAT_Handling) {
+        if (bvlc_address_different(dest, &BVLC_Global_Address)) {
+            /* NAT router port forwards BACnet packets from global IP.
+               Packets sent to that global IP by us would end up back,
+               creating a loop. */
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Adds a foreign device to the end of the forward list of the FDT,
+ * unless the list is worked out again before it is used next.
+ *
+ * @param slot - FDT entry of the foreign device
+ */
+static void bbmd_fdt_forward_add(BBMD_FDT_SLOT *slot)
+{
+    BBMD_FORWARD_LIST *list = &FDT_Forward;
+    unsigned i = list->count;
+
+    if (!list->valid ||
+        bbmd_forward_address_excluded(list, &slot->entry.dest_address)) {
+        return;
+    }
+    bvlc_address_copy(&list->dest[i], &slot->entry.dest_address);
+    memset(&list->counts[i], 0, sizeof(list->counts[i]));
+    bvlc_address_copy(&list->counts[i].dest_address, &list->dest[i]);
+    list->forwarded[i] = 0;
+    list->slot[i] = slot;
+    slot->forward_index = i;
+    list->count++;
+}
+
+/** Removes a foreign device from the forward list of the FDT, moving
+ * the last destination of the list into its place.
+ *
+ * @param slot - FDT entry of the foreign device
+ */
+static void bbmd_fdt_forward_remove(BBMD_FDT_SLOT *slot)
+{
+    BBMD_FORWARD_LIST *list = &FDT_Forward;
+    unsigned i = slot->forward_index;
+    unsigned last = 0;
+
+    if (i == FDT_NONE) {
+        return;
+    }
+    last = --list->count;
+    if (i != last) {
+        bvlc_address_copy(&list->dest[i], &list->dest[last]);
+        list->counts[i] = list->counts[last];
+        list->forwarded[i] = list->forwarded[last];
+        list->slot[i] = list->slot[last];
+        list->slot[i]->forward_index = i;
+    }
+    slot->forward_index = FDT_NONE;
+}
+
+/** Makes room in the FDT for another block of entries, and in the index,
+ * the heap and the forward list that go with it.
+ *
+ * @return true if there is room for more entries
+ */
+static bool bbmd_fdt_grow(void)
+{
+    BBMD_FDT_BLOCK *block = NULL;
+    BBMD_FDT_SLOT **slots = NULL;
+    BBMD_FORWARD_LIST *list = &FDT_Forward;
+    unsigned capacity = FDT_Capacity + FD_TABLE_BLOCK;
+    unsigned index_size = FDT_Index_Size ? FDT_Index_Size : 1;
+    void *data = NULL;
+    unsigned i = 0;
+
+    if (FDT_Capacity >= MAX_FD_ENTRIES) {
+        return false;
+    }
+    data = realloc(FDT_Heap, capacity * sizeof(FDT_Heap[0]));
+    if (!data) {
+        return false;
+    }
+    FDT_Heap = data;
+    data = realloc(list->dest, capacity * sizeof(list->dest[0]));
+    if (!data) {
+        return false;
+    }
+    list->dest = data;
+    data = realloc(list->counts, capacity * sizeof(list->counts[0]));
+    if (!data) {
+        return false;
+    }
+    list->counts = data;
+    data = realloc(list->forwarded, capacity * sizeof(list->forwarded[0]));
+    if (!data) {
+        return false;
+    }
+    list->forwarded = data;
+    data = realloc(list->slot, capacity * sizeof(list->slot[0]));
+    if (!data) {
+        return false;
+    }
+    list->slot = data;
+    /* keep the index no more than half full */
+    while (index_size < (2 * capacity)) {
+        index_size *= 2;
+    }
+    if (index_size != FDT_Index_Size) {
+        slots = calloc(index_size, sizeof(slots[0]));
+        if (!slots) {
+            return false;
+        }
+    }
+    if (FDT_Capacity) {
+        block = calloc(1, sizeof(*block));
+        if (!block) {
+            free(slots);
+            return false;
+        }
+    } else {
+        block = &FDT_First_Block;
+    }
+    if (slots) {
+        free(FDT_Index);
+        FDT_Index = slots;
+        FDT_Index_Size = index_size;
+        for (i = 0; i < FDT_Count; i++) {
+            bbmd_fdt_index_add(FDT_Heap[i]);
+        }
+    }
+    /* the new entries are free, and linked to the end of the table */
+    for (i = 0; i < FD_TABLE_BLOCK; i++) {
+        block->slot[i].heap_index = FDT_NONE;
+        block->slot[i].forward_index = FDT_NONE;
+        if ((i + 1) < FD_TABLE_BLOCK) {
+            block->slot[i].entry.next = &block->slot[i + 1].entry;
+            block->slot[i].next_free = &block->slot[i + 1];
+        }
+    }
+    block->slot[FD_TABLE_BLOCK - 1].next_free = FDT_Free;
+    FDT_Free = &block->slot[0];
+    if (block != &FDT_First_Block) {
+        FDT_Last_Block->slot[FD_TABLE_BLOCK - 1].entry.next =
+            &block->slot[0].entry;
+        FDT_Last_Block->next = block;
+        FDT_Last_Block = block;
+    }
+    FDT_Capacity = capacity;
+
+    return true;
+}
+
+/** Registers a foreign device, or renews its registration
+ *
+ * @param addr - B/IP address of the foreign device
+ * @param ttl_seconds - time to live that it asked for
+ * @return true if the foreign device is in the FDT
+ */
+static bool bbmd_fdt_register(BACNET_IP_ADDRESS *addr, uint16_t ttl_seconds)
+{
+    BBMD_FDT_SLOT *slot = NULL;
+
+    slot = bbmd_fdt_find(addr);
+    if (!slot) {
+        if (FDT_Count >= MAX_FD_ENTRIES) {
+            return false;
+        }
+        if (!FDT_Free && !bbmd_fdt_grow()) {
+            return false;
+        }
+        slot = FDT_Free;
+        FDT_Free = slot->next_free;
+        slot->next_free = NULL;
+        bvlc_address_copy(&slot->entry.dest_address, addr);
+        slot->entry.valid = true;
+        bbmd_fdt_index_add(slot);
+        slot->heap_index = FDT_Count;
+        FDT_Heap[FDT_Count] = slot;
+        FDT_Count++;
+        bbmd_fdt_forward_add(slot);
+    }
+    slot->entry.ttl_seconds = ttl_seconds;
+    /* Upon receipt of a BVLL Register-Foreign-Device message,
+       a BBMD shall start a timer with a value equal to the
+       Time-to-Live parameter supplied plus a fixed grace
+       period of 30 seconds. */
+    if (ttl_seconds < (UINT16_MAX - 30)) {
+        slot->entry.ttl_seconds_remaining = ttl_seconds + 30;
+    } else {
+        slot->entry.ttl_seconds_remaining = UINT16_MAX;
+    }
+    slot->expires = BBMD_Seconds + slot->entry.ttl_seconds_remaining;
+    bbmd_fdt_heap_fix(slot->heap_index);
+    FDT_Backup_Pending = true;
+
+    return true;
+}
+
+/** Deletes a foreign device from the FDT
+ *
+ * @param slot - FDT entry of the foreign device
+ */
+static void bbmd_fdt_delete(BBMD_FDT_SLOT *slot)
+{
+    unsigned i = slot->heap_index;
+
+    bbmd_fdt_index_remove(bbmd_fdt_index_find(&slot->entry.dest_address));
+    FDT_Count--;
+    if (i != FDT_Count) {
+        FDT_Heap[i] = FDT_Heap[FDT_Count];
+        FDT_Heap[i]->heap_index = i;
+        bbmd_fdt_heap_fix(i);
+    }
+    slot->heap_index = FDT_NONE;
+    bbmd_fdt_forward_remove(slot);
+    slot->entry.valid = false;
+    slot->entry.ttl_seconds = 0;
+    slot->entry.ttl_seconds_remaining = 0;
+    slot->next_free = FDT_Free;
+    FDT_Free = slot;
+    FDT_Backup_Pending = true;
+}
+
+/** Brings the remaining time to live of each FDT entry, which is read
+ * through the FDT list, up to date with its expiry.  The expiry heap
+ * keeps the time of each entry, so this is only needed to read them,
+ * and is only done by the maintenance timer, so that the readers of the
+ * list never write to it.
+ */
+static void bbmd_fdt_remaining_update(void)
+{
+    BBMD_FDT_SLOT *slot = NULL;
+    unsigned i = 0;
+
+    for (i = 0; i < FDT_Count; i++) {
+        slot = FDT_Heap[i];
+        if (slot->expires > BBMD_Seconds) {
+            slot->entry.ttl_seconds_remaining =
+                (uint16_t)(slot->expires - BBMD_Seconds);
+        } else {
+            slot->entry.ttl_seconds_remaining = 0;
+        }
+    }
+}
+
+/** The current time of the FDT backup file
+ *
+ * @return the time from the clock of the BBMD
+ */
+static time_t bbmd_clock_now(void)
+{
+    if (BBMD_Clock) {
+        return BBMD_Clock();
+    }
+
+    return time(NULL);
+}
+
+/** Writes the FDT to its backup file, so that the registrations outlive
+ * a restart.  The file holds the time that it was written, and then each
+ * entry as it is encoded in a Read-FDT-Ack.
+ */
+static void bbmd_fdt_backup(void)
+{
+    uint8_t buffer[BACNET_IP_FDT_ENTRY_SIZE] = { 0 };
+    char *pathname = NULL;
+    FILE *file = NULL;
+    bool status = true;
+    int len = 0;
+    unsigned i = 0;
+
+    FDT_Backup_Pending = false;
+    FDT_Backup_Seconds = BBMD_Seconds + BBMD_FDT_BACKUP_INTERVAL;
+    bbmd_fdt_remaining_update();
+    pathname = malloc(strlen(FDT_Backup_File) + 5);
+    if (!pathname) {
+        return;
+    }
+    /* replace the backup all at once */
+    sprintf(pathname, "%s.tmp", FDT_Backup_File);
+    file = fopen(pathname, "wb");
+    if (file) {
+        encode_unsigned32(&buffer[0], (uint32_t)bbmd_clock_now());
+        status = (fwrite(buffer, 4, 1, file) == 1);
+        for (i = 0; status && (i < FDT_Count); i++) {
+            len = bvlc_encode_foreign_device_table_entry(
+                &buffer[0], sizeof(buffer), &FDT_Heap[i]->entry);
+            status = (fwrite(buffer, len, 1, file) == 1);
+        }
+        if (fclose(file) != 0) {
+            status = false;
+        }
+        if (!status || (rename(pathname, FDT_Backup_File) != 0)) {
+            remove(pathname);
+            debug_print_string("FDT backup failed");
+        }
+    }
+    free(pathname);
+}
+
+/** Restores the FDT from its backup file, less the time that has passed
+ * since it was written.
+ */
+static void bbmd_fdt_restore(void)
+{
+    uint8_t buffer[BACNET_IP_FDT_ENTRY_SIZE] = { 0 };
+    BACNET_IP_FOREIGN_DEVICE_TABLE_ENTRY entry = { 0 };
+    BBMD_FDT_SLOT *slot = NULL;
+    FILE *file = NULL;
+    uint32_t written = 0;
+    uint32_t now = 0;
+    uint32_t elapsed = 0;
+
+    file = fopen(FDT_Backup_File, "rb");
+    if (!file) {
+        return;
+    }
+    if (fread(buffer, 4, 1, file) == 1) {
+        decode_unsigned32(&buffer[0], &written);
+        now = (uint32_t)bbmd_clock_now();
+        if (now > written) {
+            elapsed = now - written;
+        }
+        while (fread(buffer, sizeof(buffer), 1, file) == 1) {
+            if (bvlc_decode_foreign_device_table_entry(
+                    &buffer[0], sizeof(buffer), &entry) <= 0) {
+                break;
+            }
+            if (entry.ttl_seconds_remaining <= elapsed) {
+                /* expired while we were away */
+                continue;
+            }
+            if (bbmd_fdt_register(&entry.dest_address, entry.ttl_seconds)) {
+                slot = bbmd_fdt_find(&entry.dest_address);
+                slot->entry.ttl_seconds_remaining =
+                    (uint16_t)(entry.ttl_seconds_remaining - elapsed);
+                slot->expires =
+                    BBMD_Seconds + slot->entry.ttl_seconds_remaining;
+                bbmd_fdt_heap_fix(slot->heap_index);
+            }
+        }
+    }
+    fclose(file);
+    /* the file is already up to date */
+    FDT_Backup_Pending = false;
+}
+
+/** Deletes every foreign device, and frees the room that the FDT grew */
+static void bbmd_fdt_cleanup(void)
+{
+    BBMD_FORWARD_LIST *list = &FDT_Forward;
+    BBMD_FDT_BLOCK *block = NULL;
+
+    while (FDT_First_Block.next) {
+        block = FDT_First_Block.next;
+        FDT_First_Block.next = block->next;
+        free(block);
+    }
+    memset(&FDT_First_Block, 0, sizeof(FDT_First_Block));
+    FDT_Last_Block = &FDT_First_Block;
+    FDT_Capacity = 0;
+    FDT_Free = NULL;
+    free(FDT_Heap);
+    FDT_Heap = NULL;
+    FDT_Count = 0;
+    free(FDT_Index);
+    FDT_Index = NULL;
+    FDT_Index_Size = 0;
+    free(list->dest);
+    free(list->counts);
+    free(list->forwarded);
+    free(list->slot);
+    memset(list, 0, sizeof(*list));
+    FDT_Backup_Pending = false;
+}
+#endif
+
 /** A timer function that is called about once a second.
  *
  * @param seconds - number of elapsed seconds since the last call
@@ -244,7 +849,18 @@ void bvlc_bdt_restore_local(void)
 void bvlc_maintenance_timer(uint16_t seconds)
 {
 #if BBMD_ENABLED
-    bvlc_foreign_device_table_maintenance_timer(&FD_Table[0], seconds);
+    BBMD_Seconds += seconds;
+    /* the foreign devices whose timers ran out are at the top of the heap */
+    while (FDT_Count && (FDT_Heap[0]->expires <= BBMD_Seconds)) {
+        bbmd_fdt_delete(FDT_Heap[0]);
+    }
+    bbmd_fdt_remaining_update();
+    if (FDT_Backup_Pending && FDT_Backup_File &&
+        ((int32_t)(BBMD_Seconds - FDT_Backup_Seconds) >= 0)) {
+        bbmd_fdt_backup();
+    }
+#else
+    (void)seconds;
 #endif
 }
 
@@ -331,6 +947,176 @@ static uint16_t bbmd_forward_npdu(
     return mtu_len;
 }
 
+/** Adds a destination to the forward list of the BDT, unless it is
+ * already there, keeping the counters it had before the list was worked
+ * out again
+ *
+ * @param list - forward list being worked out
+ * @param old_dest - destinations of the list before
+ * @param old_counts - counters of the list before
+ * @param old_count - number of destinations of the list before
+ * @param dest - destination to add
+ */
+static void bbmd_forward_list_add(BBMD_FORWARD_LIST *list,
+    BACNET_IP_ADDRESS *old_dest,
+    BACNET_IP_FORWARD_COUNTS *old_counts,
+    unsigned old_count,
+    BACNET_IP_ADDRESS *dest)
+{
+    BACNET_IP_FORWARD_COUNTS *counts = NULL;
+    unsigned i = 0;
+
+    if (bbmd_forward_address_excluded(list, dest)) {
+        return;
+    }
+    for (i = 0; i < list->count; i++) {
+        if (!bvlc_address_different(dest, &list->dest[i])) {
+            return;
+        }
+    }
+    counts = &list->counts[list->count];
+    memset(counts, 0, sizeof(*counts));
+    for (i = 0; i < old_count; i++) {
+        if (!bvlc_address_different(dest, &old_dest[i])) {
+            *counts = old_counts[i];
+            break;
+        }
+    }
+    bvlc_address_copy(&counts->dest_address, dest);
+    bvlc_address_copy(&list->dest[list->count], dest);
+    list->forwarded[list->count] = counts->forwarded;
+    list->count++;
+}
+
+/** Works out the forward list of the BDT or the FDT again if the BDT,
+ * our address or the NAT handling has changed since the last time.
+ *
+ * @param list - forward list of the BDT or of the FDT
+ */
+static void bbmd_forward_list_update(BBMD_FORWARD_LIST *list)
+{
+    BACNET_IP_ADDRESS old_dest[MAX_BBMD_ENTRIES];
+    BACNET_IP_FORWARD_COUNTS old_counts[MAX_BBMD_ENTRIES];
+    BACNET_IP_ADDRESS my_addr = { 0 };
+    BACNET_IP_ADDRESS bip_dest = { 0 };
+    BBMD_FDT_SLOT *slot = NULL;
+    unsigned old_count = 0;
+    unsigned i = 0;
+
+    bip_get_addr(&my_addr);
+    if (list->valid && !bvlc_address_different(&my_addr, &list->my_addr)) {
+        return;
+    }
+    bvlc_address_copy(&list->my_addr, &my_addr);
+    old_count = list->count;
+    list->count = 0;
+    if (list == &BDT_Forward) {
+        memcpy(old_dest, list->dest, old_count * sizeof(old_dest[0]));
+        memcpy(old_counts, list->counts, old_count * sizeof(old_counts[0]));
+        for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
+            if (BBMD_Table[i].valid) {
+                bvlc_broadcast_distribution_table_entry_forward_address(
+                    &bip_dest, &BBMD_Table[i]);
+                bbmd_forward_list_add(
+                    list, old_dest, old_counts, old_count, &bip_dest);
+            }
+        }
+    } else {
+        /* keep the foreign devices that are still destinations,
+           with their counters */
+        for (i = 0; i < old_count; i++) {
+            slot = list->slot[i];
+            slot->forward_index = FDT_NONE;
+            if (bbmd_forward_address_excluded(
+                    list, &slot->entry.dest_address)) {
+                continue;
+            }
+            bvlc_address_copy(&list->dest[list->count], &list->dest[i]);
+            list->counts[list->count] = list->counts[i];
+            list->forwarded[list->count] = list->forwarded[i];
+            list->slot[list->count] = slot;
+            slot->forward_index = list->count;
+            list->count++;
+        }
+        list->valid = true;
+        for (i = 0; i < FDT_Count; i++) {
+            if (FDT_Heap[i]->forward_index == FDT_NONE) {
+                bbmd_fdt_forward_add(FDT_Heap[i]);
+            }
+        }
+    }
+    list->valid = true;
+}
+
+/** Sends a Forwarded NPDU to each destination of a forward list,
+ * except back to its origin, with as few system calls as the port can.
+ *
+ * @param list - forward list of the BDT or of the FDT
+ * @param bip_src - source IP address and UDP port
+ * @param mtu - the Forwarded NPDU
+ * @param mtu_len - length of the Forwarded NPDU
+ */
+static void bbmd_forward_list_send(BBMD_FORWARD_LIST *list,
+    BACNET_IP_ADDRESS *bip_src,
+    uint8_t *mtu,
+    uint16_t mtu_len)
+{
+    bool sent[BBMD_FORWARD_CHUNK];
+    BBMD_FDT_SLOT *slot = NULL;
+    unsigned origin = 0;
+    unsigned start = 0;
+    unsigned end = 0;
+    unsigned i = 0;
+
+    bbmd_forward_list_update(list);
+    /* don't forward back to origin */
+    if (list == &BDT_Forward) {
+        for (origin = 0; origin < list->count; origin++) {
+            if (!bvlc_address_different(&list->dest[origin], bip_src)) {
+                break;
+            }
+        }
+    } else {
+        slot = bbmd_fdt_find(bip_src);
+        origin = slot ? slot->forward_index : FDT_NONE;
+    }
+    for (start = 0; start < list->count; start = end) {
+        end = start + BBMD_FORWARD_CHUNK;
+        if (end > list->count) {
+            end = list->count;
+        }
+        if ((origin >= start) && (origin < end)) {
+            if (origin > start) {
+                bip_send_mpdu_list(&list->dest[start], origin - start, mtu,
+                    mtu_len, &sent[0]);
+            }
+            if ((origin + 1) < end) {
+                bip_send_mpdu_list(&list->dest[origin + 1],
+                    end - (origin + 1), mtu, mtu_len,
+                    &sent[origin + 1 - start]);
+            }
+        } else {
+            bip_send_mpdu_list(
+                &list->dest[start], end - start, mtu, mtu_len, &sent[0]);
+        }
+        for (i = start; i < end; i++) {
+            if (i == origin) {
+                continue;
+            }
+            if (sent[i - start]) {
+                list->counts[i].forwarded++;
+            } else {
+                list->counts[i].dropped++;
+            }
+            if (list == &BDT_Forward) {
+                debug_print_bip("BDT Send Forwarded-NPDU", &list->dest[i]);
+            } else {
+                debug_print_bip("FDT Send Forwarded-NPDU", &list->dest[i]);
+            }
+        }
+    }
+}
+
 /** Sends all Broadcast Devices a Forwarded NPDU
  *
  * @param bip_src - source IP address and UDP port
@@ -347,11 +1133,7 @@ static uint16_t bbmd_bdt_forward_npdu(BACNET_IP_ADDRESS *bip_src,
 {
     uint8_t mtu[MAX_MPDU] = { 0 };
     uint16_t mtu_len = 0;
-    unsigned i = 0; /* loop counter */
-    BACNET_IP_ADDRESS bip_dest = { 0 };
-    BACNET_IP_ADDRESS my_addr = { 0 };
 
-    bip_get_addr(&my_addr);
     /* If we are forwarding an original broadcast message and the NAT
      * handling is enabled, change the source address to NAT routers
      * global IP address so the recipient can reply (local IP address
@@ -367,31 +1149,8 @@ static uint16_t bbmd_bdt_forward_npdu(BACNET_IP_ADDRESS *bip_src,
         mtu_len = (uint16_t)bvlc_encode_forwarded_npdu(
             &mtu[0], (uint16_t)sizeof(mtu), bip_src, npdu, npdu_length);
     }
-    /* loop through the BDT and send one to each entry */
-    for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
-        if (BBMD_Table[i].valid) {
-            bvlc_broadcast_distribution_table_entry_forward_address(
-                &bip_dest, &BBMD_Table[i]);
-            if (!bvlc_address_different(&bip_dest, &my_addr)) {
-                /* don't forward to our selves */
-                continue;
-            }
-            if (!bvlc_address_different(&bip_dest, bip_src)) {
-                /* don't forward back to origin */
-                continue;
-            }
-            if (BVLC_NAT_Handling) {
-                if (bvlc_address_different(&bip_dest, &BVLC_Global_Address)) {
-                    /* NAT router port forwards BACnet packets from global IP.
-                       Packets sent to that global IP by us would end up back,
-                       creating a loop. */
-                    continue;
-                }
-            }
-            bip_send_mpdu(&bip_dest, mtu, mtu_len);
-            debug_print_bip("BDT Send Forwarded-NPDU", &bip_dest);
-        }
-    }
+    /* send one to each distinct destination of the BDT */
+    bbmd_forward_list_send(&BDT_Forward, bip_src, mtu, mtu_len);
 
     return mtu_len;
 }
@@ -412,11 +1171,7 @@ static uint16_t bbmd_fdt_forward_npdu(BACNET_IP_ADDRESS *bip_src,
 {
     uint8_t mtu[MAX_MPDU] = { 0 };
     uint16_t mtu_len = 0;
-    unsigned i = 0; /* loop counter */
-    BACNET_IP_ADDRESS bip_dest = { 0 };
-    BACNET_IP_ADDRESS my_addr = { 0 };
 
-    bip_get_addr(&my_addr);
     /* If we are forwarding an original broadcast message and the NAT
      * handling is enabled, change the source address to NAT routers
      * global IP address so the recipient can reply (local IP address
@@ -432,31 +1187,8 @@ static uint16_t bbmd_fdt_forward_npdu(BACNET_IP_ADDRESS *bip_src,
         mtu_len = (uint16_t)bvlc_encode_forwarded_npdu(
             &mtu[0], (uint16_t)sizeof(mtu), bip_src, npdu, npdu_length);
     }
-
-    /* loop through the FDT and send one to each entry */
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
-        if (FD_Table[i].valid && FD_Table[i].ttl_seconds_remaining) {
-            bvlc_address_copy(&bip_dest, &FD_Table[i].dest_address);
-            if (!bvlc_address_different(&bip_dest, &my_addr)) {
-                /* don't forward to our selves */
-                continue;
-            }
-            if (!bvlc_address_different(&bip_dest, bip_src)) {
-                /* don't forward back to origin */
-                continue;
-            }
-            if (BVLC_NAT_Handling) {
-                if (bvlc_address_different(&bip_dest, &BVLC_Global_Address)) {
-                    /* NAT router port forwards BACnet packets from global IP.
-                       Packets sent to that global IP by us would end up back,
-                       creating a loop. */
-                    continue;
-                }
-            }
-            bip_send_mpdu(&bip_dest, mtu, mtu_len);
-            debug_print_bip("FDT Send Forwarded-NPDU", &bip_dest);
-        }
-    }
+    /* send one to each foreign device */
+    bbmd_forward_list_send(&FDT_Forward, bip_src, mtu, mtu_len);
 
     return mtu_len;
 }
@@ -830,6 +1562,7 @@ int bvlc_bbmd_enabled_handler(BACNET_IP_ADDRESS *addr,
     uint16_t offset = 0;
     uint16_t ttl_seconds = 0;
     BACNET_IP_ADDRESS fwd_address = { 0 };
+    BBMD_FDT_SLOT *fdt_slot = NULL;
     BACNET_IP_ADDRESS broadcast_address = { 0 };
 
     header_len =
@@ -854,6 +1587,7 @@ int bvlc_bbmd_enabled_handler(BACNET_IP_ADDRESS *addr,
             function_len = bvlc_decode_write_broadcast_distribution_table(
                 pdu, pdu_len, &BBMD_Table[0]);
             if (function_len > 0) {
+                BDT_Forward.valid = false;
                 /* BDT changed! Save backup to file */
                 bvlc_bdt_backup_local();
                 result_code = BVLC_RESULT_SUCCESSFUL_COMPLETION;
@@ -949,8 +1683,7 @@ int bvlc_bbmd_enabled_handler(BACNET_IP_ADDRESS *addr,
             function_len =
                 bvlc_decode_register_foreign_device(pdu, pdu_len, &ttl_seconds);
             if (function_len) {
-                if (bvlc_foreign_device_table_entry_add(
-                        &FD_Table[0], addr, ttl_seconds)) {
+                if (bbmd_fdt_register(addr, ttl_seconds)) {
                     result_code = BVLC_RESULT_SUCCESSFUL_COMPLETION;
                     send_result = true;
                 } else {
@@ -971,7 +1704,7 @@ int bvlc_bbmd_enabled_handler(BACNET_IP_ADDRESS *addr,
                with a result code of X'0040' indicating that the read attempt
                has failed. */
             BVLC_Buffer_Len = bvlc_encode_read_foreign_device_table_ack(
-                BVLC_Buffer, sizeof(BVLC_Buffer), &FD_Table[0]);
+                BVLC_Buffer, sizeof(BVLC_Buffer), bvlc_fdt_list());
             if (BVLC_Buffer_Len > 0) {
                 bip_send_mpdu(addr, BVLC_Buffer, BVLC_Buffer_Len);
             } else {
@@ -1000,8 +1733,9 @@ int bvlc_bbmd_enabled_handler(BACNET_IP_ADDRESS *addr,
             function_len =
                 bvlc_decode_delete_foreign_device(pdu, pdu_len, &fwd_address);
             if (function_len > 0) {
-                if (bvlc_foreign_device_table_entry_delete(
-                        &FD_Table[0], &fwd_address)) {
+                fdt_slot = bbmd_fdt_find(&fwd_address);
+                if (fdt_slot) {
+                    bbmd_fdt_delete(fdt_slot);
                     result_code = BVLC_RESULT_SUCCESSFUL_COMPLETION;
                     send_result = true;
                 } else {
@@ -1258,12 +1992,53 @@ void bvlc_set_function_code(uint8_t function_code)
 
 #if BBMD_ENABLED
 /**
- * @brief Get handle to foreign device table (FDT).
+ * @brief Get handle to foreign device table (FDT).  The remaining time
+ *  to live of each entry is brought up to date by the maintenance timer.
  * @return pointer to first entry of foreign device table
  */
 BACNET_IP_FOREIGN_DEVICE_TABLE_ENTRY *bvlc_fdt_list(void)
 {
-    return &FD_Table[0];
+    return &FDT_First_Block.slot[0].entry;
+}
+
+/**
+ * @brief Keep the foreign device table (FDT) in a file, so that the
+ *  foreign devices stay registered when the BBMD is restarted.  The
+ *  entries in the file that have not expired are restored now, and the
+ *  file is written by the maintenance timer after the FDT changes.
+ * @param pathname - name of the file, or NULL to stop keeping one
+ * @return true if the name of the file was kept
+ */
+bool bvlc_fdt_backup_file_set(const char *pathname)
+{
+    if (FDT_Backup_Pending && FDT_Backup_File) {
+        /* the last changes to the old file */
+        bbmd_fdt_backup();
+    }
+    free(FDT_Backup_File);
+    FDT_Backup_File = NULL;
+    if (!pathname) {
+        return true;
+    }
+    FDT_Backup_File = malloc(strlen(pathname) + 1);
+    if (!FDT_Backup_File) {
+        return false;
+    }
+    strcpy(FDT_Backup_File, pathname);
+    bbmd_fdt_restore();
+
+    return true;
+}
+
+/**
+ * @brief Set the clock of the FDT backup file, which tells how long the
+ *  BBMD was down for when the file is restored.
+ * @param clock - function that returns the current time,
+ *  or NULL to use the system clock
+ */
+void bvlc_fdt_clock_set(bvlc_clock_function clock)
+{
+    BBMD_Clock = clock;
 }
 
 /**
@@ -1275,12 +2050,78 @@ BACNET_IP_BROADCAST_DISTRIBUTION_TABLE_ENTRY *bvlc_bdt_list(void)
     return &BBMD_Table[0];
 }
 
+/**
+ * @brief Tell the BBMD that the entries of the broadcast distribution
+ *  table (BDT) were changed through bvlc_bdt_list(), so that it works
+ *  out where to forward broadcasts again.
+ */
+void bvlc_bdt_list_changed(void)
+{
+    BDT_Forward.valid = false;
+}
+
+/**
+ * @brief Copy the counters of a forward list
+ * @param list - forward list of the BDT or of the FDT
+ * @param counts - where to copy the counters
+ * @param size - number of counters that fit
+ * @return number of destinations, which may be more than were copied
+ */
+static unsigned bbmd_forward_list_counts(
+    BBMD_FORWARD_LIST *list, BACNET_IP_FORWARD_COUNTS *counts, unsigned size)
+{
+    uint32_t seconds = 0;
+    unsigned i = 0;
+
+    bbmd_forward_list_update(list);
+    seconds = BBMD_Seconds - list->forwarded_seconds;
+    if (seconds) {
+        for (i = 0; i < list->count; i++) {
+            list->counts[i].rate =
+                (list->counts[i].forwarded - list->forwarded[i]) / seconds;
+            list->forwarded[i] = list->counts[i].forwarded;
+        }
+        list->forwarded_seconds = BBMD_Seconds;
+    }
+    if (counts) {
+        memcpy(counts, list->counts,
+            (size < list->count ? size : list->count) * sizeof(*counts));
+    }
+
+    return list->count;
+}
+
+/**
+ * @brief Get the counters of the Forwarded-NPDUs sent to each distinct
+ *  destination of the broadcast distribution table (BDT).
+ * @param counts - where to copy the counters, or NULL
+ * @param size - number of counters that fit
+ * @return number of destinations, which may be more than were copied
+ */
+unsigned bvlc_bdt_forward_counts(BACNET_IP_FORWARD_COUNTS *counts, unsigned size)
+{
+    return bbmd_forward_list_counts(&BDT_Forward, counts, size);
+}
+
+/**
+ * @brief Get the counters of the Forwarded-NPDUs sent to each foreign
+ *  device of the foreign device table (FDT).
+ * @param counts - where to copy the counters, or NULL
+ * @param size - number of counters that fit
+ * @return number of destinations, which may be more than were copied
+ */
+unsigned bvlc_fdt_forward_counts(BACNET_IP_FORWARD_COUNTS *counts, unsigned size)
+{
+    return bbmd_forward_list_counts(&FDT_Forward, counts, size);
+}
+
 /**
  * @brief Invalidate all entries in the broadcast distribution table (BDT).
  */
 void bvlc_bdt_list_clear(void)
 {
     bvlc_broadcast_distribution_table_valid_clear(&BBMD_Table[0]);
+    BDT_Forward.valid = false;
     /* BDT changed! Save backup to file */
     bvlc_bdt_backup_local();
 }
@@ -1305,6 +2146,10 @@ void bvlc_set_global_address_for_nat(const BACNET_IP_ADDRESS *addr)
 {
     bvlc_address_copy(&BVLC_Global_Address, addr);
     BVLC_NAT_Handling = true;
+#if BBMD_ENABLED
+    BDT_Forward.valid = false;
+    FDT_Forward.valid = false;
+#endif
     debug_print_bip("NAT Address enabled", addr);
 }
 
@@ -1314,6 +2159,10 @@ void bvlc_set_global_address_for_nat(const BACNET_IP_ADDRESS *addr)
 void bvlc_disable_nat(void)
 {
     BVLC_NAT_Handling = false;
+#if BBMD_ENABLED
+    BDT_Forward.valid = false;
+    FDT_Forward.valid = false;
+#endif
     debug_print_string("NAT Address disabled");
 }
 
@@ -1323,7 +2172,12 @@ void bvlc_init(void)
     debug_print_string("Initializing (BBMD Enabled).");
     bvlc_broadcast_distribution_table_link_array(
         &BBMD_Table[0], MAX_BBMD_ENTRIES);
-    bvlc_foreign_device_table_link_array(&FD_Table[0], MAX_FD_ENTRIES);
+    bbmd_fdt_cleanup();
+    bbmd_fdt_grow();
+    if (FDT_Backup_File) {
+        bbmd_fdt_restore();
+    }
+    BDT_Forward.valid = false;
 #else
     debug_print_string("Initializing (BBMD Disabled).");
 #endif
@@ -32,10 +32,30 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 #include "bacnet/bacnet_stack_exports.h"
 #include "bacnet/bacdef.h"
 #include "bacnet/datalink/bvlc.h"
 
+/* seconds between writes of the FDT backup file */
+#ifndef BBMD_FDT_BACKUP_INTERVAL
+#define BBMD_FDT_BACKUP_INTERVAL 60
+#endif
+
+/* Forwarded-NPDUs sent by the BBMD to one destination */
+typedef struct BACnet_IP_Forward_Counts {
+    BACNET_IP_ADDRESS dest_address;
+    /* number sent */
+    uint32_t forwarded;
+    /* number that the port could not send */
+    uint32_t dropped;
+    /* number sent per second since the counters were last read */
+    uint32_t rate;
+} BACNET_IP_FORWARD_COUNTS;
+
+/* clock of the FDT backup file, which returns the current time */
+typedef time_t (*bvlc_clock_function)(void);
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -113,9 +133,28 @@ BACNET_IP_BROADCAST_DISTRIBUTION_TABLE_ENTRY *bvlc_bdt_list(void);
 BACNET_STACK_EXPORT
 void bvlc_bdt_list_clear(void);
 
+/* Tell the BBMD that the broadcast distribution table list was changed */
+BACNET_STACK_EXPORT
+void bvlc_bdt_list_changed(void);
+
+/* Get the counters of the Forwarded-NPDUs of each destination */
+BACNET_STACK_EXPORT
+unsigned bvlc_bdt_forward_counts(
+    BACNET_IP_FORWARD_COUNTS *counts, unsigned size);
+BACNET_STACK_EXPORT
+unsigned bvlc_fdt_forward_counts(
+    BACNET_IP_FORWARD_COUNTS *counts, unsigned size);
+
 /* Get foreign device table list */
 BACNET_IP_FOREIGN_DEVICE_TABLE_ENTRY *bvlc_fdt_list(void);
 
+/* Keep the foreign device table in a file across restarts */
+BACNET_STACK_EXPORT
+bool bvlc_fdt_backup_file_set(const char *pathname);
+/* Set the clock of the FDT backup file */
+BACNET_STACK_EXPORT
+void bvlc_fdt_clock_set(bvlc_clock_function clock);
+
 /* Backup broadcast distribution table to a file.
  * Filename is the BBMD_BACKUP_FILE constant
  */
@@ -66,6 +66,15 @@ static BACNET_IP6_BROADCAST_DISTRIBUTION_TABLE_ENTRY
 #define MAX_FD6_ENTRIES 128
 #endif
 static BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY FD_Table[MAX_FD6_ENTRIES];
+/* Forwarded-NPDUs sent to each entry of the tables */
+static BACNET_IP6_FORWARD_COUNTS BDT_Counts[MAX_BBMD6_ENTRIES];
+static BACNET_IP6_FORWARD_COUNTS FDT_Counts[MAX_FD6_ENTRIES];
+/* destinations of a Forwarded-NPDU: the BDT or the multicast address,
+   and the FDT, with the counts of each (none for the multicast) */
+#define BBMD6_FORWARD_SIZE (MAX_BBMD6_ENTRIES + MAX_FD6_ENTRIES)
+static BACNET_IP6_ADDRESS Forward_List[BBMD6_FORWARD_SIZE];
+static BACNET_IP6_FORWARD_COUNTS *Forward_Counts[BBMD6_FORWARD_SIZE];
+static bool Forward_Sent[BBMD6_FORWARD_SIZE];
 #endif
 
 /** A timer function that is called about once a second.
@@ -76,7 +85,10 @@ void bvlc6_maintenance_timer(uint16_t seconds)
 {
 #if defined(BACDL_BIP6) && BBMD6_ENABLED
     unsigned i = 0;
+#endif
 
+    VMAC_Timer(seconds);
+#if defined(BACDL_BIP6) && BBMD6_ENABLED
     for (i = 0; i < MAX_FD6_ENTRIES; i++) {
         if (FD_Table[i].valid) {
             if (FD_Table[i].ttl_seconds_remaining) {
@@ -87,6 +99,8 @@ void bvlc6_maintenance_timer(uint16_t seconds)
                 }
                 if (FD_Table[i].ttl_seconds_remaining == 0) {
                     FD_Table[i].valid = false;
+                    FDT_Counts[i].forwarded = 0;
+                    FDT_Counts[i].dropped = 0;
                 }
             }
         }
@@ -159,11 +173,16 @@ static bool bbmd6_add_vmac(uint32_t device_id, BACNET_IP6_ADDRESS *addr)
     struct vmac_data *vmac;
     struct vmac_data new_vmac;
 
-    if (addr) {
+    if (addr && bbmd6_address_to_vmac(&new_vmac, addr)) {
         vmac = VMAC_Find_By_Key(device_id);
         if (vmac) {
-            /* already exists - replace? */
-        } else if (bbmd6_address_to_vmac(&new_vmac, addr)) {
+            /* already exists - keep it from aging out while the
+               device is heard from at the same address.  If the
+               address changed, the old one ages out. */
+            if (!VMAC_Different(vmac, &new_vmac)) {
+                VMAC_Refresh(device_id);
+            }
+        } else {
             /* new entry - add it! */
             status = VMAC_Add(device_id, &new_vmac);
             debug_printf("BVLC6: Adding VMAC %lu.\n", (unsigned long)device_id);
@@ -302,95 +321,136 @@ int bvlc6_send_pdu(BACNET_ADDRESS *dest,
 
 #if defined(BACDL_BIP6) && BBMD6_ENABLED
 /**
- * The send function for Broacast Distribution Table
+ * Send a Forwarded-NPDU to the peer BBMDs in the BDT, or to the B/IPv6
+ * devices in the local multicast domain, and to each foreign device in
+ * the FDT.  The Forwarded-NPDU is encoded once by the caller, and all
+ * of the destinations are handed to the port in one call.
  *
- * @param addr - Points to a #BACNET_IP6_ADDRESS structure containing the
- *  source IPv6 address.
- * @param vmac_src - Source-Virtual-Address
- * @param npdu - the bytes of NPDU+APDU data to send
- * @param npdu_len - the number of bytes of NPDU+APDU data to send
+ * @param mtu - the encoded Forwarded-NPDU
+ * @param mtu_len - the number of bytes in the Forwarded-NPDU
+ * @param bdt - true to unicast it to each entry in the BDT, or false to
+ *  multicast it to the local multicast domain
  */
-static void bbmd6_send_pdu_bdt(uint8_t *mtu, unsigned int mtu_len)
+static void bbmd6_send_forward_npdu(uint8_t *mtu, uint16_t mtu_len, bool bdt)
 {
     BACNET_IP6_ADDRESS my_addr = { { 0 } };
+    unsigned count = 0;
     unsigned i = 0; /* loop counter */
 
-    if (mtu) {
-        bip6_get_addr(&my_addr);
-        for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
-            if (BBMD_Table[i].valid) {
-                if (bvlc6_address_different(
-                        &my_addr, &BBMD_Table[i].bip6_address)) {
-                    bip6_send_mpdu(&BBMD_Table[i].bip6_address, mtu, mtu_len);
-                }
+    if (!mtu || (mtu_len == 0)) {
+        return;
+    }
+    bip6_get_addr(&my_addr);
+    if (bdt) {
+        for (i = 0; i < MAX_BBMD6_ENTRIES; i++) {
+            if (BBMD_Table[i].valid &&
+                bvlc6_address_different(
+                    &my_addr, &BBMD_Table[i].bip6_address)) {
+                bvlc6_address_copy(
+                    &Forward_List[count], &BBMD_Table[i].bip6_address);
+                Forward_Counts[count] = &BDT_Counts[i];
+                count++;
+            }
+        }
+    } else {
+        bip6_get_broadcast_addr(&Forward_List[count]);
+        Forward_Counts[count] = NULL;
+        count++;
+    }
+    for (i = 0; i < MAX_FD6_ENTRIES; i++) {
+        if (FD_Table[i].valid &&
+            bvlc6_address_different(&my_addr, &FD_Table[i].bip6_address)) {
+            bvlc6_address_copy(
+                &Forward_List[count], &FD_Table[i].bip6_address);
+            Forward_Counts[count] = &FDT_Counts[i];
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    bip6_send_mpdu_list(Forward_List, count, mtu, mtu_len, Forward_Sent);
+    for (i = 0; i < count; i++) {
+        if (Forward_Counts[i]) {
+            if (Forward_Sent[i]) {
+                Forward_Counts[i]->forwarded++;
+            } else {
+                Forward_Counts[i]->dropped++;
             }
         }
     }
 }
 
 /**
- * The send function for Broacast Distribution Table
+ * Get handle to the broadcast distribution table (BDT)
  *
- * @param addr - Points to a #BACNET_IP6_ADDRESS structure containing the
- *  source IPv6 address.
- * @param vmac_src - Source-Virtual-Address
- * @param npdu - the bytes of NPDU+APDU data to send
- * @param npdu_len - the number of bytes of NPDU+APDU data to send
+ * @return pointer to the first entry of the linked entries of the BDT
  */
-static void bbmd6_send_pdu_fdt(uint8_t *mtu, unsigned int mtu_len)
+BACNET_IP6_BROADCAST_DISTRIBUTION_TABLE_ENTRY *bvlc6_bdt_list(void)
 {
-    BACNET_IP6_ADDRESS my_addr = { { 0 } };
-    unsigned i = 0; /* loop counter */
+    return &BBMD_Table[0];
+}
 
-    if (mtu) {
-        bip6_get_addr(&my_addr);
-        for (i = 0; i < MAX_FD_ENTRIES; i++) {
-            if (FD_Table[i].valid) {
-                if (bvlc6_address_different(
-                        &my_addr, &FD_Table[i].bip6_address)) {
-                    bip6_send_mpdu(&FD_Table[i].bip6_address, mtu, mtu_len);
-                }
-            }
-        }
-    }
+/**
+ * Get handle to the foreign device table (FDT)
+ *
+ * @return pointer to the first entry of the linked entries of the FDT
+ */
+BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY *bvlc6_fdt_list(void)
+{
+    return &FD_Table[0];
 }
 
 /**
- * The Forward NPDU send function for Broacast Distribution Table
+ * Get the number of Forwarded-NPDUs sent to each peer BBMD in the BDT
  *
- * @param addr - Points to a #BACNET_IP6_ADDRESS structure containing the
- *  source IPv6 address.
- * @param vmac_src - Source-Virtual-Address
- * @param npdu - the bytes of NPDU+APDU data to send
- * @param npdu_len - the number of bytes of NPDU+APDU data to send
+ * @param counts - array to hold the counts of each valid BDT entry
+ * @param size - number of entries in the array
+ * @return number of entries put into the array
  */
-static void bbmd6_send_forward_npdu(BACNET_IP6_ADDRESS *address,
-    uint32_t vmac_src,
-    uint8_t *npdu,
-    unsigned int npdu_len)
+unsigned bvlc6_bdt_forward_counts(
+    BACNET_IP6_FORWARD_COUNTS *counts, unsigned size)
 {
-    uint8_t mtu[MAX_MPDU] = { 0 };
-    uint16_t mtu_len = 0;
-    unsigned i = 0; /* loop counter */
+    unsigned count = 0;
+    unsigned i = 0;
 
-    for (i = 0; i < MAX_BBMD_ENTRIES; i++) {
+    for (i = 0; (i < MAX_BBMD6_ENTRIES) && (count < size); i++) {
         if (BBMD_Table[i].valid) {
-            if (bbmd6_address_match_self(&BBMD_Table[i].bip6_address)) {
-                /* don't forward to our selves */
-            } else {
-                bip6_send_mpdu(&BBMD_Table[i].bip6_address, mtu, mtu_len);
-            }
+            bvlc6_address_copy(
+                &counts[count].dest_address, &BBMD_Table[i].bip6_address);
+            counts[count].forwarded = BDT_Counts[i].forwarded;
+            counts[count].dropped = BDT_Counts[i].dropped;
+            count++;
         }
     }
-    for (i = 0; i < MAX_FD_ENTRIES; i++) {
+
+    return count;
+}
+
+/**
+ * Get the number of Forwarded-NPDUs sent to each foreign device in the FDT
+ *
+ * @param counts - array to hold the counts of each valid FDT entry
+ * @param size - number of entries in the array
+ * @return number of entries put into the array
+ */
+unsigned bvlc6_fdt_forward_counts(
+    BACNET_IP6_FORWARD_COUNTS *counts, unsigned size)
+{
+    unsigned count = 0;
+    unsigned i = 0;
+
+    for (i = 0; (i < MAX_FD6_ENTRIES) && (count < size); i++) {
         if (FD_Table[i].valid) {
-            if (bbmd6_address_match_self(&FD_Table[i].bip6_address)) {
-                /* don't forward to our selves */
-            } else {
-                bip6_send_mpdu(&FD_Table[i].bip6_address, mtu, mtu_len);
-            }
+            bvlc6_address_copy(
+                &counts[count].dest_address, &FD_Table[i].bip6_address);
+            counts[count].forwarded = FDT_Counts[i].forwarded;
+            counts[count].dropped = FDT_Counts[i].dropped;
+            count++;
         }
     }
+
+    return count;
 }
 
 #endif
@@ -787,10 +847,8 @@ int bvlc6_bbmd_enabled_handler(BACNET_IP6_ADDRESS *addr,
     uint16_t mtu_len)
 {
     uint16_t result_code = BVLC6_RESULT_SUCCESSFUL_COMPLETION;
-    uint32_t vmac_me = 0;
     uint32_t vmac_src = 0;
     uint32_t vmac_dst = 0;
-    uint32_t vmac_target = 0;
     uint8_t message_type = 0;
     uint16_t message_length = 0;
     int header_len = 0;
@@ -887,8 +945,8 @@ int bvlc6_bbmd_enabled_handler(BACNET_IP6_ADDRESS *addr,
                         BVLC6_Buffer_Len = bvlc6_encode_forwarded_npdu(
                             &BVLC6_Buffer[0], sizeof(BVLC6_Buffer), vmac_src,
                             addr, npdu, npdu_len);
-                        bbmd6_send_pdu_bdt(&BVLC6_Buffer[0], BVLC6_Buffer_Len);
-                        bbmd6_send_pdu_fdt(&BVLC6_Buffer[0], BVLC6_Buffer_Len);
+                        bbmd6_send_forward_npdu(
+                            &BVLC6_Buffer[0], BVLC6_Buffer_Len, true);
                     }
                     if (!bbmd6_address_match_self(addr)) {
                         /* The Virtual MAC address table shall be updated
@@ -912,11 +970,8 @@ int bvlc6_bbmd_enabled_handler(BACNET_IP6_ADDRESS *addr,
                         transmit it via multicast to B/IPv6 devices in the
                         local multicast domain. */
                     BVLC6_Buffer_Len = bvlc6_encode_forwarded_npdu(
-                        &BVLC6_Buffer[0], sizeof(BVLC6_Buffer), vmac_src, addr,
-                        npdu, npdu_len);
-                    bip6_get_broadcast_addr(&bvlc_dest);
-                    bip6_send_mpdu(
-                        &bvlc_dest, &BVLC6_Buffer[0], BVLC6_Buffer_Len);
+                        &BVLC6_Buffer[0], sizeof(BVLC6_Buffer), vmac_src,
+                        &fwd_address, npdu, npdu_len);
                     /*  In addition, the constructed BVLL Forwarded-NPDU
                         message shall be unicast to each foreign device in
                         the BBMD's FDT. If the BBMD is unable to transmit
@@ -924,7 +979,8 @@ int bvlc6_bbmd_enabled_handler(BACNET_IP6_ADDRESS *addr,
                         from a BBMD which is in the receiving BBMD's BDT,
                         no BVLC-Result shall be returned and the message
                         shall be discarded. */
-                    bbmd6_send_pdu_fdt(&BVLC6_Buffer[0], BVLC6_Buffer_Len);
+                    bbmd6_send_forward_npdu(
+                        &BVLC6_Buffer[0], BVLC6_Buffer_Len, false);
                     if (!bbmd6_address_match_self(addr)) {
                         /* The Virtual MAC address table shall be updated
                            using the respective parameter values of the
@@ -1049,6 +1105,10 @@ void bvlc6_cleanup(void)
  */
 void bvlc6_init(void)
 {
+#if defined(BACDL_BIP6) && BBMD6_ENABLED
+    unsigned i = 0;
+#endif
+
     VMAC_Init();
     BVLC6_Result_Code = BVLC6_RESULT_SUCCESSFUL_COMPLETION;
     BVLC6_Function_Code = BVLC6_RESULT;
@@ -1057,5 +1117,13 @@ void bvlc6_init(void)
 #if defined(BACDL_BIP6) && BBMD6_ENABLED
     memset(&BBMD_Table, 0, sizeof(BBMD_Table));
     memset(&FD_Table, 0, sizeof(FD_Table));
+    memset(&BDT_Counts, 0, sizeof(BDT_Counts));
+    memset(&FDT_Counts, 0, sizeof(FDT_Counts));
+    for (i = 1; i < MAX_BBMD6_ENTRIES; i++) {
+        BBMD_Table[i - 1].next = &BBMD_Table[i];
+    }
+    for (i = 1; i < MAX_FD6_ENTRIES; i++) {
+        FD_Table[i - 1].next = &FD_Table[i];
+    }
 #endif
 }
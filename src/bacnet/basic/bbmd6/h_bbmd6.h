@@ -36,6 +36,13 @@
 #include "bacnet/bacnet_stack_exports.h"
 #include "bacnet/datalink/bvlc6.h"
 
+/* Forwarded-NPDUs that the BBMD sent to one destination */
+typedef struct BACnet_IP6_Forward_Counts {
+    BACNET_IP6_ADDRESS dest_address;
+    uint32_t forwarded;
+    uint32_t dropped;
+} BACNET_IP6_FORWARD_COUNTS;
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -66,6 +73,20 @@ extern "C" {
         uint8_t *pdu,
         unsigned pdu_len);
 
+    BACNET_STACK_EXPORT
+    BACNET_IP6_BROADCAST_DISTRIBUTION_TABLE_ENTRY *bvlc6_bdt_list(void);
+    BACNET_STACK_EXPORT
+    BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY *bvlc6_fdt_list(void);
+
+    BACNET_STACK_EXPORT
+    unsigned bvlc6_bdt_forward_counts(
+        BACNET_IP6_FORWARD_COUNTS *counts,
+        unsigned size);
+    BACNET_STACK_EXPORT
+    unsigned bvlc6_fdt_forward_counts(
+        BACNET_IP6_FORWARD_COUNTS *counts,
+        unsigned size);
+
     BACNET_STACK_EXPORT
     int bvlc6_register_with_bbmd(
         BACNET_IP6_ADDRESS *bbmd_addr,
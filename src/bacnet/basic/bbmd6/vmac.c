@@ -38,7 +38,6 @@
 #include <stdlib.h>
 #include "bacnet/config.h"
 #include "bacnet/bacdef.h"
-#include "bacnet/basic/sys/keylist.h"
 /* me! */
 #include "bacnet/basic/bbmd6/vmac.h"
 
@@ -48,15 +47,192 @@
 /* This module is used to handle the virtual MAC address binding that */
 /* occurs in BACnet for ZigBee or IPv6. */
 
-/* Key List for storing the object data sorted by instance number  */
-static OS_Keylist VMAC_List;
+/* number of hash buckets to start with, doubled as the table grows */
+#ifndef VMAC_HASH_SIZE
+#define VMAC_HASH_SIZE 64
+#endif
+
+/* seconds after which a VMAC that was not refreshed is removed,
+   or 0 to keep the VMAC until it is deleted */
+#ifndef VMAC_LIFETIME
+#define VMAC_LIFETIME 0
+#endif
+
+/* a VMAC, in the hash chains of its device ID and of its address */
+struct vmac_entry {
+    /* first, so that the entry is found from its VMAC data */
+    struct vmac_data vmac;
+    uint32_t device_id;
+    /* VMAC_Seconds when the entry was added or refreshed */
+    uint32_t seconds;
+    struct vmac_entry *key_next;
+    struct vmac_entry *data_next;
+};
+
+/* hash chain heads for device ID and VMAC address lookups */
+static struct vmac_entry **VMAC_Key_Hash;
+static struct vmac_entry **VMAC_Data_Hash;
+/* number of buckets in each hash, a power of two */
+static unsigned int VMAC_Hash_Size;
+static unsigned int VMAC_Entry_Count;
+/* seconds counted by VMAC_Timer() */
+static uint32_t VMAC_Seconds;
+static uint32_t VMAC_Lifetime = VMAC_LIFETIME;
+
+/**
+ * Compute the hash bucket of a device ID
+ *
+ * @param device_id - BACnet device object instance number
+ *
+ * @return hash bucket index
+ */
+static unsigned int vmac_key_hash(uint32_t device_id)
+{
+    uint32_t hash = device_id * 2654435761UL;
+
+    return (unsigned int)((hash ^ (hash >> 16)) & (VMAC_Hash_Size - 1));
+}
+
+/**
+ * Compute the hash bucket of a VMAC address
+ *
+ * @param vmac - VMAC address
+ *
+ * @return hash bucket index
+ */
+static unsigned int vmac_data_hash(struct vmac_data *vmac)
+{
+    uint32_t hash = 2166136261UL;
+    unsigned int i = 0;
+
+    for (i = 0; (i < vmac->mac_len) && (i < VMAC_MAC_MAX); i++) {
+        hash = (hash ^ vmac->mac[i]) * 16777619UL;
+    }
+
+    return (unsigned int)(hash & (VMAC_Hash_Size - 1));
+}
+
+/**
+ * Find the entry of a device ID
+ *
+ * @param device_id - BACnet device object instance number
+ *
+ * @return the entry, or NULL if the device ID is not in the table
+ */
+static struct vmac_entry *vmac_entry_find(uint32_t device_id)
+{
+    struct vmac_entry *pEntry = NULL;
+
+    if (VMAC_Key_Hash) {
+        pEntry = VMAC_Key_Hash[vmac_key_hash(device_id)];
+        while (pEntry) {
+            if (pEntry->device_id == device_id) {
+                break;
+            }
+            pEntry = pEntry->key_next;
+        }
+    }
+
+    return pEntry;
+}
+
+/**
+ * Link an entry into both hash chains
+ *
+ * @param pEntry - entry to link
+ */
+static void vmac_entry_link(struct vmac_entry *pEntry)
+{
+    unsigned int hash = 0;
+
+    hash = vmac_key_hash(pEntry->device_id);
+    pEntry->key_next = VMAC_Key_Hash[hash];
+    VMAC_Key_Hash[hash] = pEntry;
+    hash = vmac_data_hash(&pEntry->vmac);
+    pEntry->data_next = VMAC_Data_Hash[hash];
+    VMAC_Data_Hash[hash] = pEntry;
+}
+
+/**
+ * Unlink an entry from both hash chains
+ *
+ * @param pEntry - entry to unlink
+ */
+static void vmac_entry_unlink(struct vmac_entry *pEntry)
+{
+    struct vmac_entry **pNext;
+
+    pNext = &VMAC_Key_Hash[vmac_key_hash(pEntry->device_id)];
+    while (*pNext) {
+        if (*pNext == pEntry) {
+            *pNext = pEntry->key_next;
+            break;
+        }
+        pNext = &(*pNext)->key_next;
+    }
+    pNext = &VMAC_Data_Hash[vmac_data_hash(&pEntry->vmac)];
+    while (*pNext) {
+        if (*pNext == pEntry) {
+            *pNext = pEntry->data_next;
+            break;
+        }
+        pNext = &(*pNext)->data_next;
+    }
+}
+
+/**
+ * Allocate the hash buckets, moving any entries into them
+ *
+ * @param size - number of buckets in each hash, a power of two
+ *
+ * @return true if the buckets were allocated
+ */
+static bool vmac_hash_resize(unsigned int size)
+{
+    struct vmac_entry **key_hash;
+    struct vmac_entry **data_hash;
+    struct vmac_entry *pEntry;
+    struct vmac_entry *pNext;
+    struct vmac_entry *pList = NULL;
+    unsigned int i = 0;
+
+    key_hash = calloc(size, sizeof(struct vmac_entry *));
+    data_hash = calloc(size, sizeof(struct vmac_entry *));
+    if (!key_hash || !data_hash) {
+        free(key_hash);
+        free(data_hash);
+        return false;
+    }
+    /* gather the entries into one list, through key_next */
+    for (i = 0; i < VMAC_Hash_Size; i++) {
+        pEntry = VMAC_Key_Hash[i];
+        while (pEntry) {
+            pNext = pEntry->key_next;
+            pEntry->key_next = pList;
+            pList = pEntry;
+            pEntry = pNext;
+        }
+    }
+    free(VMAC_Key_Hash);
+    free(VMAC_Data_Hash);
+    VMAC_Key_Hash = key_hash;
+    VMAC_Data_Hash = data_hash;
+    VMAC_Hash_Size = size;
+    while (pList) {
+        pEntry = pList;
+        pList = pEntry->key_next;
+        vmac_entry_link(pEntry);
+    }
+
+    return true;
+}
 
 /**
  * Returns the number of VMAC in the list
  */
 unsigned int VMAC_Count(void)
 {
-    return (unsigned int)Keylist_Count(VMAC_List);
+    return VMAC_Entry_Count;
 }
 
 /**
@@ -70,28 +246,38 @@ unsigned int VMAC_Count(void)
 bool VMAC_Add(uint32_t device_id, struct vmac_data *src)
 {
     bool status = false;
-    struct vmac_data *pVMAC = NULL;
-    int index = 0;
+    struct vmac_entry *pEntry = NULL;
     size_t i = 0;
 
-    pVMAC = Keylist_Data(VMAC_List, device_id);
-    if (!pVMAC) {
-        pVMAC = calloc(1, sizeof(struct vmac_data));
-        if (pVMAC) {
+    if (!VMAC_Key_Hash) {
+        return false;
+    }
+    pEntry = vmac_entry_find(device_id);
+    if (!pEntry) {
+        if (VMAC_Entry_Count >= VMAC_Hash_Size) {
+            /* keep the chains short; if the table can not grow,
+               the chains get longer */
+            (void)vmac_hash_resize(VMAC_Hash_Size * 2);
+        }
+        pEntry = calloc(1, sizeof(struct vmac_entry));
+        if (pEntry) {
             /* copy the MAC into the data store */
-            for (i = 0; i < sizeof(pVMAC->mac); i++) {
+            for (i = 0; i < sizeof(pEntry->vmac.mac); i++) {
                 if (i < src->mac_len) {
-                    pVMAC->mac[i] = src->mac[i];
+                    pEntry->vmac.mac[i] = src->mac[i];
                 } else {
                     break;
                 }
             }
-            pVMAC->mac_len = src->mac_len;
-            index = Keylist_Data_Add(VMAC_List, device_id, pVMAC);
-            if (index >= 0) {
-                status = true;
-                printf("VMAC %u added.\n", (unsigned int)device_id);
-            }
+            pEntry->vmac.mac_len = src->mac_len;
+            pEntry->device_id = device_id;
+            pEntry->seconds = VMAC_Seconds;
+            vmac_entry_link(pEntry);
+            VMAC_Entry_Count++;
+            status = true;
+#if PRINT_ENABLED
+            printf("VMAC %u added.\n", (unsigned int)device_id);
+#endif
         }
     }
 
@@ -103,16 +289,18 @@ bool VMAC_Add(uint32_t device_id, struct vmac_data *src)
  *
  * @param device_id - BACnet device object instance number
  *
- * @return pointer to the VMAC data from the list - be sure to free() it!
+ * @return true if the VMAC was found and deleted
  */
 bool VMAC_Delete(uint32_t device_id)
 {
     bool status = false;
-    struct vmac_data *pVMAC;
+    struct vmac_entry *pEntry;
 
-    pVMAC = Keylist_Data_Delete(VMAC_List, device_id);
-    if (pVMAC) {
-        free(pVMAC);
+    pEntry = vmac_entry_find(device_id);
+    if (pEntry) {
+        vmac_entry_unlink(pEntry);
+        VMAC_Entry_Count--;
+        free(pEntry);
         status = true;
     }
 
@@ -128,7 +316,14 @@ bool VMAC_Delete(uint32_t device_id)
  */
 struct vmac_data *VMAC_Find_By_Key(uint32_t device_id)
 {
-    return Keylist_Data(VMAC_List, device_id);
+    struct vmac_entry *pEntry;
+
+    pEntry = vmac_entry_find(device_id);
+    if (pEntry) {
+        return &pEntry->vmac;
+    }
+
+    return NULL;
 }
 
 /** Compare the VMAC address
@@ -205,45 +400,110 @@ bool VMAC_Match(struct vmac_data *vmac1, struct vmac_data *vmac2)
 bool VMAC_Find_By_Data(struct vmac_data *vmac, uint32_t *device_id)
 {
     bool status = false;
-    struct vmac_data *list_vmac;
-    int count = 0;
-    int index = 0;
-
-    count = Keylist_Count(VMAC_List);
-    while (count) {
-        index = count - 1;
-        list_vmac = Keylist_Data_Index(VMAC_List, index);
-        if (list_vmac) {
-            if (VMAC_Match(vmac, list_vmac)) {
+    struct vmac_entry *pEntry = NULL;
+
+    if (VMAC_Data_Hash && vmac) {
+        pEntry = VMAC_Data_Hash[vmac_data_hash(vmac)];
+        while (pEntry) {
+            if (VMAC_Match(vmac, &pEntry->vmac)) {
                 if (device_id) {
-                    *device_id = Keylist_Key(VMAC_List, index);
+                    *device_id = pEntry->device_id;
                 }
                 status = true;
                 break;
             }
+            pEntry = pEntry->data_next;
         }
-        count--;
     }
 
     return status;
 }
 
+/**
+ * Marks a VMAC as still in use, so that it is not aged out
+ *
+ * @param device_id - BACnet device object instance number
+ *
+ * @return true if the VMAC was found
+ */
+bool VMAC_Refresh(uint32_t device_id)
+{
+    struct vmac_entry *pEntry;
+
+    pEntry = vmac_entry_find(device_id);
+    if (pEntry) {
+        pEntry->seconds = VMAC_Seconds;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Sets how long a VMAC is kept after it was added or last refreshed
+ *
+ * @param seconds - lifetime in seconds, or 0 to keep the VMAC until
+ *  it is deleted
+ */
+void VMAC_Lifetime_Set(uint32_t seconds)
+{
+    VMAC_Lifetime = seconds;
+}
+
+/**
+ * Ages the VMAC, and removes those that were not refreshed within
+ * their lifetime
+ *
+ * @param seconds - number of seconds elapsed since the last call
+ */
+void VMAC_Timer(uint16_t seconds)
+{
+    struct vmac_entry *pEntry;
+    struct vmac_entry *pNext;
+    unsigned int i = 0;
+
+    VMAC_Seconds += seconds;
+    if ((VMAC_Lifetime == 0) || !VMAC_Key_Hash) {
+        return;
+    }
+    for (i = 0; i < VMAC_Hash_Size; i++) {
+        pEntry = VMAC_Key_Hash[i];
+        while (pEntry) {
+            pNext = pEntry->key_next;
+            if ((VMAC_Seconds - pEntry->seconds) >= VMAC_Lifetime) {
+                vmac_entry_unlink(pEntry);
+                VMAC_Entry_Count--;
+                free(pEntry);
+            }
+            pEntry = pNext;
+        }
+    }
+}
+
 /**
  * Cleans up the memory used by the VMAC list data
  */
 void VMAC_Cleanup(void)
 {
-    struct vmac_data *pVMAC;
+    struct vmac_entry *pEntry;
+    struct vmac_entry *pNext;
+    unsigned int i = 0;
 
-    if (VMAC_List) {
-        do {
-            pVMAC = Keylist_Data_Pop(VMAC_List);
-            if (pVMAC) {
-                free(pVMAC);
+    if (VMAC_Key_Hash) {
+        for (i = 0; i < VMAC_Hash_Size; i++) {
+            pEntry = VMAC_Key_Hash[i];
+            while (pEntry) {
+                pNext = pEntry->key_next;
+                free(pEntry);
+                pEntry = pNext;
             }
-        } while (pVMAC);
-        Keylist_Delete(VMAC_List);
-        VMAC_List = NULL;
+        }
+        free(VMAC_Key_Hash);
+        free(VMAC_Data_Hash);
+        VMAC_Key_Hash = NULL;
+        VMAC_Data_Hash = NULL;
+        VMAC_Hash_Size = 0;
+        VMAC_Entry_Count = 0;
     }
 }
 
@@ -252,10 +512,17 @@ void VMAC_Cleanup(void)
  */
 void VMAC_Init(void)
 {
-    VMAC_List = Keylist_Create();
-    if (VMAC_List) {
-        atexit(VMAC_Cleanup);
+    static bool cleanup_registered;
+
+    VMAC_Cleanup();
+    if (vmac_hash_resize(VMAC_HASH_SIZE)) {
+        if (!cleanup_registered) {
+            atexit(VMAC_Cleanup);
+            cleanup_registered = true;
+        }
+#if PRINT_ENABLED
         printf("VMAC List initialized.\n");
+#endif
     }
 }
 
@@ -298,7 +565,111 @@ void testVMAC(Test *pTest)
     VMAC_Cleanup();
 }
 
+static void testVMACAddress(struct vmac_data *vmac, uint32_t device_id)
+{
+    unsigned int i = 0;
+
+    /* an IPv6 address and port that differ in a few octets */
+    for (i = 0; i < VMAC_MAC_MAX; i++) {
+        vmac->mac[i] = 0x20 + i;
+    }
+    vmac->mac[12] = (uint8_t)(device_id >> 24);
+    vmac->mac[13] = (uint8_t)(device_id >> 16);
+    vmac->mac[14] = (uint8_t)(device_id >> 8);
+    vmac->mac[15] = (uint8_t)device_id;
+    vmac->mac_len = VMAC_MAC_MAX;
+}
+
+void testVMACTable(Test *pTest)
+{
+    struct vmac_data test_vmac_data;
+    uint32_t test_device_id = 0;
+    uint32_t device_id = 0;
+    unsigned int count = 5000;
+    bool status = false;
+
+    VMAC_Init();
+    for (device_id = 0; device_id < count; device_id++) {
+        testVMACAddress(&test_vmac_data, device_id * 7);
+        status = VMAC_Add(device_id * 7, &test_vmac_data);
+        ct_test(pTest, status);
+    }
+    ct_test(pTest, VMAC_Count() == count);
+    /* the same device ID is not added twice */
+    status = VMAC_Add(0, &test_vmac_data);
+    ct_test(pTest, !status);
+    for (device_id = 0; device_id < count; device_id++) {
+        testVMACAddress(&test_vmac_data, device_id * 7);
+        status = VMAC_Find_By_Data(&test_vmac_data, &test_device_id);
+        ct_test(pTest, status);
+        ct_test(pTest, test_device_id == (device_id * 7));
+        ct_test(pTest, VMAC_Find_By_Key(device_id * 7) != NULL);
+        ct_test(pTest, VMAC_Find_By_Key((device_id * 7) + 1) == NULL);
+    }
+    /* deleted VMAC are not found by either key */
+    for (device_id = 0; device_id < count; device_id += 2) {
+        status = VMAC_Delete(device_id * 7);
+        ct_test(pTest, status);
+    }
+    ct_test(pTest, VMAC_Count() == (count / 2));
+    testVMACAddress(&test_vmac_data, 14);
+    status = VMAC_Find_By_Data(&test_vmac_data, &test_device_id);
+    ct_test(pTest, !status);
+    testVMACAddress(&test_vmac_data, 21);
+    status = VMAC_Find_By_Data(&test_vmac_data, &test_device_id);
+    ct_test(pTest, status);
+    ct_test(pTest, test_device_id == 21);
+    /* VMAC that are not refreshed age out */
+    VMAC_Lifetime_Set(60);
+    VMAC_Timer(30);
+    ct_test(pTest, VMAC_Refresh(21));
+    ct_test(pTest, !VMAC_Refresh(14));
+    VMAC_Timer(30);
+    ct_test(pTest, VMAC_Count() == 1);
+    ct_test(pTest, VMAC_Find_By_Key(21) != NULL);
+    VMAC_Timer(30);
+    ct_test(pTest, VMAC_Count() == 0);
+    status = VMAC_Find_By_Data(&test_vmac_data, &test_device_id);
+    ct_test(pTest, !status);
+    VMAC_Lifetime_Set(0);
+    VMAC_Cleanup();
+}
+
 #ifdef TEST_VMAC
+#include <time.h>
+
+/* measure how many VMAC addresses are looked up per second */
+static void testVMACBenchmark(unsigned int count)
+{
+    struct vmac_data test_vmac_data;
+    uint32_t test_device_id = 0;
+    uint32_t device_id = 0;
+    unsigned long lookups = 0;
+    unsigned int round = 0;
+    clock_t start, elapsed;
+
+    VMAC_Init();
+    for (device_id = 0; device_id < count; device_id++) {
+        testVMACAddress(&test_vmac_data, device_id);
+        VMAC_Add(device_id, &test_vmac_data);
+    }
+    start = clock();
+    for (round = 0; round < 100; round++) {
+        for (device_id = 0; device_id < count; device_id++) {
+            testVMACAddress(&test_vmac_data, device_id);
+            if (VMAC_Find_By_Data(&test_vmac_data, &test_device_id)) {
+                lookups++;
+            }
+        }
+    }
+    elapsed = clock() - start;
+    printf("VMAC: %u entries, %lu lookups in %.3f seconds: "
+           "%.0f lookups/second\n",
+        count, lookups, (double)elapsed / CLOCKS_PER_SEC,
+        elapsed ? (double)lookups * CLOCKS_PER_SEC / elapsed : 0.0);
+    VMAC_Cleanup();
+}
+
 int main(void)
 {
     Test *pTest;
@@ -308,11 +679,15 @@ int main(void)
     /* individual tests */
     rc = ct_addTestFunction(pTest, testVMAC);
     assert(rc);
+    rc = ct_addTestFunction(pTest, testVMACTable);
+    assert(rc);
 
     ct_setStream(pTest, stdout);
     ct_run(pTest);
     (void)ct_report(pTest);
     ct_destroy(pTest);
+    testVMACBenchmark(1000);
+    testVMACBenchmark(10000);
 
     return 0;
 }
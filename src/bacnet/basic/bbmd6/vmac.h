@@ -46,6 +46,12 @@ extern "C" {
         struct vmac_data *vmac1,
         struct vmac_data *vmac2);
     BACNET_STACK_EXPORT
+    bool VMAC_Refresh(uint32_t device_id);
+    BACNET_STACK_EXPORT
+    void VMAC_Lifetime_Set(uint32_t seconds);
+    BACNET_STACK_EXPORT
+    void VMAC_Timer(uint16_t seconds);
+    BACNET_STACK_EXPORT
     void VMAC_Cleanup(void);
     BACNET_STACK_EXPORT
     void VMAC_Init(void);
@@ -55,6 +61,9 @@ extern "C" {
     BACNET_STACK_EXPORT
     void testVMAC(
         Test * pTest);
+    BACNET_STACK_EXPORT
+    void testVMACTable(
+        Test * pTest);
 #endif
 
 #ifdef __cplusplus
@@ -70,14 +70,45 @@ static uint32_t Own_Device_ID = 0xFFFFFFFF;
 #define MAX_ADDRESS_CACHE 255
 #endif
 
+#if (MAX_ADDRESS_CACHE >= 0xFFFF)
+#error "MAX_ADDRESS_CACHE must be less than 65535"
+#endif
+
+/* Number of hash buckets used to index the cache by device instance
+   and by network address.  One bucket per entry keeps the chains short. */
+#if !defined(MAX_ADDRESS_CACHE_HASH)
+#define MAX_ADDRESS_CACHE_HASH MAX_ADDRESS_CACHE
+#endif
+
+/* marks the end of a hash chain, LRU list or free list */
+#define ADDRESS_CACHE_NONE 0xFFFF
+
 static struct Address_Cache_Entry {
     uint8_t Flags;
     uint32_t device_id;
     unsigned max_apdu;
     BACNET_ADDRESS address;
     uint32_t TimeToLive;
+    /* next entry in the device instance hash chain, or the free list */
+    uint16_t Device_Next;
+    /* next entry in the network address hash chain */
+    uint16_t MAC_Next;
+    /* least recently used list - head is the most recently used */
+    uint16_t LRU_Prev;
+    uint16_t LRU_Next;
 } Address_Cache[MAX_ADDRESS_CACHE];
 
+/* hash chain heads for device instance and network address lookups */
+static uint16_t Device_Hash[MAX_ADDRESS_CACHE_HASH];
+static uint16_t MAC_Hash[MAX_ADDRESS_CACHE_HASH];
+static uint16_t LRU_Head = ADDRESS_CACHE_NONE;
+static uint16_t LRU_Tail = ADDRESS_CACHE_NONE;
+static uint16_t Free_Head = ADDRESS_CACHE_NONE;
+/* number of bound entries, which are the entries in the MAC hash */
+static unsigned Bound_Count;
+/* indexes are built on first use if address_init() was not called */
+static bool Address_Index_Valid;
+
 /* State flags for cache entries */
 
 /* Address cache entry in use */
@@ -174,6 +205,281 @@ bool address_match(BACNET_ADDRESS *dest, BACNET_ADDRESS *src)
     return true;
 }
 
+/**
+ * @brief Compute the device instance hash bucket
+ * @param device_id  device instance
+ * @return hash bucket index
+ */
+static unsigned address_device_hash(uint32_t device_id)
+{
+    return (unsigned)(device_id % MAX_ADDRESS_CACHE_HASH);
+}
+
+/**
+ * @brief Compute the network address hash bucket using the same
+ *  fields that bacnet_address_same() compares.
+ * @param src  BACnet address
+ * @return hash bucket index
+ */
+static unsigned address_mac_hash(BACNET_ADDRESS *src)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261UL;
+    uint8_t i = 0;
+    uint8_t max_len = 0;
+
+    hash = (hash ^ (uint8_t)(src->net >> 8)) * 16777619UL;
+    hash = (hash ^ (uint8_t)(src->net & 0xFF)) * 16777619UL;
+    max_len = src->len;
+    if (max_len > MAX_MAC_LEN) {
+        max_len = MAX_MAC_LEN;
+    }
+    hash = (hash ^ max_len) * 16777619UL;
+    for (i = 0; i < max_len; i++) {
+        hash = (hash ^ src->adr[i]) * 16777619UL;
+    }
+    if (src->net == 0) {
+        max_len = src->mac_len;
+        if (max_len > MAX_MAC_LEN) {
+            max_len = MAX_MAC_LEN;
+        }
+        hash = (hash ^ max_len) * 16777619UL;
+        for (i = 0; i < max_len; i++) {
+            hash = (hash ^ src->mac[i]) * 16777619UL;
+        }
+    }
+
+    return (unsigned)(hash % MAX_ADDRESS_CACHE_HASH);
+}
+
+/**
+ * @brief Convert a cache entry pointer to its table index
+ * @param pMatch  cache entry
+ * @return table index
+ */
+static uint16_t address_entry_index(struct Address_Cache_Entry *pMatch)
+{
+    return (uint16_t)(pMatch - &Address_Cache[0]);
+}
+
+static void address_cache_index_rebuild(void);
+
+/**
+ * @brief Find the in-use entry (bound or not) for a device instance
+ * @param device_id  device instance
+ * @return pointer to the entry, or NULL if not found
+ */
+static struct Address_Cache_Entry *address_entry_by_device(uint32_t device_id)
+{
+    struct Address_Cache_Entry *pMatch;
+    uint16_t index;
+
+    if (!Address_Index_Valid) {
+        address_cache_index_rebuild();
+    }
+    index = Device_Hash[address_device_hash(device_id)];
+    while (index != ADDRESS_CACHE_NONE) {
+        pMatch = &Address_Cache[index];
+        if (pMatch->device_id == device_id) {
+            return pMatch;
+        }
+        index = pMatch->Device_Next;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Move an entry to the most recently used end of the LRU list,
+ *  inserting it if not yet in the list.
+ * @param pMatch  cache entry
+ * @param linked  true if the entry is already in the LRU list
+ */
+static void address_lru_touch(struct Address_Cache_Entry *pMatch, bool linked)
+{
+    uint16_t index = address_entry_index(pMatch);
+
+    if (linked) {
+        if (LRU_Head == index) {
+            return;
+        }
+        /* unlink - entry is not the head so it has a previous entry */
+        Address_Cache[pMatch->LRU_Prev].LRU_Next = pMatch->LRU_Next;
+        if (pMatch->LRU_Next != ADDRESS_CACHE_NONE) {
+            Address_Cache[pMatch->LRU_Next].LRU_Prev = pMatch->LRU_Prev;
+        } else {
+            LRU_Tail = pMatch->LRU_Prev;
+        }
+    }
+    pMatch->LRU_Prev = ADDRESS_CACHE_NONE;
+    pMatch->LRU_Next = LRU_Head;
+    if (LRU_Head != ADDRESS_CACHE_NONE) {
+        Address_Cache[LRU_Head].LRU_Prev = index;
+    } else {
+        LRU_Tail = index;
+    }
+    LRU_Head = index;
+}
+
+/**
+ * @brief Add a bound entry to the network address index
+ * @param pMatch  cache entry
+ */
+static void address_mac_link(struct Address_Cache_Entry *pMatch)
+{
+    unsigned hash = address_mac_hash(&pMatch->address);
+
+    pMatch->MAC_Next = MAC_Hash[hash];
+    MAC_Hash[hash] = address_entry_index(pMatch);
+    Bound_Count++;
+}
+
+/**
+ * @brief Remove a bound entry from the network address index.
+ *  The address must not have changed since the entry was linked.
+ * @param pMatch  cache entry
+ */
+static void address_mac_unlink(struct Address_Cache_Entry *pMatch)
+{
+    uint16_t index = address_entry_index(pMatch);
+    uint16_t *pNext;
+
+    pNext = &MAC_Hash[address_mac_hash(&pMatch->address)];
+    while (*pNext != ADDRESS_CACHE_NONE) {
+        if (*pNext == index) {
+            *pNext = pMatch->MAC_Next;
+            pMatch->MAC_Next = ADDRESS_CACHE_NONE;
+            Bound_Count--;
+            break;
+        }
+        pNext = &Address_Cache[*pNext].MAC_Next;
+    }
+}
+
+/**
+ * @brief Link a newly filled in-use entry into the device instance index,
+ *  the LRU list, and if bound, the network address index.
+ * @param pMatch  cache entry
+ */
+static void address_entry_link(struct Address_Cache_Entry *pMatch)
+{
+    unsigned hash = address_device_hash(pMatch->device_id);
+
+    pMatch->Device_Next = Device_Hash[hash];
+    Device_Hash[hash] = address_entry_index(pMatch);
+    address_lru_touch(pMatch, false);
+    if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) {
+        address_mac_link(pMatch);
+    }
+}
+
+/**
+ * @brief Unlink an in-use entry from every index
+ * @param pMatch  cache entry
+ */
+static void address_entry_unlink(struct Address_Cache_Entry *pMatch)
+{
+    uint16_t index = address_entry_index(pMatch);
+    uint16_t *pNext;
+
+    if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) {
+        address_mac_unlink(pMatch);
+    }
+    pNext = &Device_Hash[address_device_hash(pMatch->device_id)];
+    while (*pNext != ADDRESS_CACHE_NONE) {
+        if (*pNext == index) {
+            *pNext = pMatch->Device_Next;
+            break;
+        }
+        pNext = &Address_Cache[*pNext].Device_Next;
+    }
+    if (pMatch->LRU_Prev != ADDRESS_CACHE_NONE) {
+        Address_Cache[pMatch->LRU_Prev].LRU_Next = pMatch->LRU_Next;
+    } else {
+        LRU_Head = pMatch->LRU_Next;
+    }
+    if (pMatch->LRU_Next != ADDRESS_CACHE_NONE) {
+        Address_Cache[pMatch->LRU_Next].LRU_Prev = pMatch->LRU_Prev;
+    } else {
+        LRU_Tail = pMatch->LRU_Prev;
+    }
+    pMatch->LRU_Prev = ADDRESS_CACHE_NONE;
+    pMatch->LRU_Next = ADDRESS_CACHE_NONE;
+}
+
+/**
+ * @brief Release an entry back to the free list. In-use entries are
+ *  unlinked from the indexes first.
+ * @param pMatch  cache entry
+ */
+static void address_entry_free(struct Address_Cache_Entry *pMatch)
+{
+    if ((pMatch->Flags & BAC_ADDR_IN_USE) != 0) {
+        address_entry_unlink(pMatch);
+    }
+    pMatch->Flags = 0;
+    pMatch->Device_Next = Free_Head;
+    Free_Head = address_entry_index(pMatch);
+}
+
+/**
+ * @brief Take an entry from the free list
+ * @return pointer to a free entry, or NULL if the cache is full
+ */
+static struct Address_Cache_Entry *address_entry_alloc(void)
+{
+    struct Address_Cache_Entry *pMatch = NULL;
+
+    if (!Address_Index_Valid) {
+        address_cache_index_rebuild();
+    }
+    if (Free_Head != ADDRESS_CACHE_NONE) {
+        pMatch = &Address_Cache[Free_Head];
+        Free_Head = pMatch->Device_Next;
+        pMatch->Device_Next = ADDRESS_CACHE_NONE;
+    }
+
+    return pMatch;
+}
+
+/**
+ * @brief Rebuild the hash indexes, LRU list and free list from the
+ *  entry flags, for example after the cache table was restored from
+ *  persistent memory.
+ */
+static void address_cache_index_rebuild(void)
+{
+    struct Address_Cache_Entry *pMatch;
+    unsigned index;
+
+    for (index = 0; index < MAX_ADDRESS_CACHE_HASH; index++) {
+        Device_Hash[index] = ADDRESS_CACHE_NONE;
+        MAC_Hash[index] = ADDRESS_CACHE_NONE;
+    }
+    LRU_Head = ADDRESS_CACHE_NONE;
+    LRU_Tail = ADDRESS_CACHE_NONE;
+    Free_Head = ADDRESS_CACHE_NONE;
+    Bound_Count = 0;
+    Address_Index_Valid = true;
+    /* walk backwards so the free list hands out the lowest index first */
+    index = MAX_ADDRESS_CACHE;
+    while (index > 0) {
+        index--;
+        pMatch = &Address_Cache[index];
+        pMatch->Device_Next = ADDRESS_CACHE_NONE;
+        pMatch->MAC_Next = ADDRESS_CACHE_NONE;
+        pMatch->LRU_Prev = ADDRESS_CACHE_NONE;
+        pMatch->LRU_Next = ADDRESS_CACHE_NONE;
+        if ((pMatch->Flags & BAC_ADDR_IN_USE) != 0) {
+            address_entry_link(pMatch);
+        } else if ((pMatch->Flags & BAC_ADDR_RESERVED) == 0) {
+            pMatch->Flags = 0;
+            pMatch->Device_Next = Free_Head;
+            Free_Head = (uint16_t)index;
+        }
+    }
+}
+
 /**
  * @brief Remove a device from the address list.
  *
@@ -184,15 +490,12 @@ void address_remove_device(uint32_t device_id)
     struct Address_Cache_Entry *pMatch;
     uint32_t index = 0;
 
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
-            (pMatch->device_id == device_id)) {
-            pMatch->Flags = 0;
-            if (index < Top_Protected_Entry) {
-                Top_Protected_Entry--;
-            }
-            break;
+    pMatch = address_entry_by_device(device_id);
+    if (pMatch) {
+        index = address_entry_index(pMatch);
+        address_entry_free(pMatch);
+        if (index < Top_Protected_Entry) {
+            Top_Protected_Entry--;
         }
     }
 
@@ -200,11 +503,11 @@ void address_remove_device(uint32_t device_id)
 }
 
 /**
- * @brief Search the cache for the entry nearest expiry and delete it. Mark the
- * entry as reserved with a 1 hour TTL and return a pointer to the reserved
- * entry. Will not delete a static entry and returns NULL pointer if no
- * entry available to free up. Does not check for free entries as it is
- * assumed we are calling this due to the lack of those.
+ * @brief Search the least recently used end of the cache for an entry to
+ * delete. Mark the entry as reserved with a 1 hour TTL and return a pointer
+ * to the reserved entry. Will not delete a static entry and returns NULL
+ * pointer if no entry available to free up. Does not check for free entries
+ * as it is assumed we are calling this due to the lack of those.
  *
  * @return Pointer to the entry that has been removed or NULL.
  */
@@ -212,54 +515,43 @@ static struct Address_Cache_Entry *address_remove_oldest(void)
 {
     struct Address_Cache_Entry *pMatch;
     struct Address_Cache_Entry *pCandidate;
-    uint32_t ulTime;
-    unsigned index;
+    uint16_t index;
 
     pCandidate = NULL;
     if (Top_Protected_Entry > (MAX_ADDRESS_CACHE - 1)) {
         return pCandidate;
     }
-    /* Longest possible non static time to live */
-    ulTime = BAC_ADDR_FOREVER - 1;
 
     /* First pass - try only in use and bound entries */
-
-    for (index = Top_Protected_Entry; index < MAX_ADDRESS_CACHE; index++) {
+    index = LRU_Tail;
+    while (index != ADDRESS_CACHE_NONE) {
         pMatch = &Address_Cache[index];
-        if ((pMatch->Flags &
-                (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ | BAC_ADDR_STATIC)) ==
-            BAC_ADDR_IN_USE) {
-            if (pMatch->TimeToLive <= ulTime) { 
-                /* Shorter lived entry found */
-                ulTime = pMatch->TimeToLive;
-                pCandidate = pMatch;
-            }
+        if (((pMatch->Flags &
+                 (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ | BAC_ADDR_STATIC)) ==
+                BAC_ADDR_IN_USE) &&
+            (index >= Top_Protected_Entry)) {
+            pCandidate = pMatch;
+            break;
         }
+        index = pMatch->LRU_Prev;
     }
-
-    if (pCandidate != NULL) { 
-        /* Found something to free up */
-        pCandidate->Flags = BAC_ADDR_RESERVED;
-        /* only reserve it for a short while */
-        pCandidate->TimeToLive = BAC_ADDR_SHORT_TIME; 
-        return (pCandidate);
-    }
-
-    /* Second pass - try in use and un bound as last resort */
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if ((pMatch->Flags &
-                (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ | BAC_ADDR_STATIC)) ==
-            ((uint8_t)(BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ))) {
-            if (pMatch->TimeToLive <= ulTime) { /* Shorter lived entry found */
-                ulTime = pMatch->TimeToLive;
+    if (pCandidate == NULL) {
+        /* Second pass - try in use and un bound as last resort */
+        index = LRU_Tail;
+        while (index != ADDRESS_CACHE_NONE) {
+            pMatch = &Address_Cache[index];
+            if ((pMatch->Flags &
+                    (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ | BAC_ADDR_STATIC)) ==
+                ((uint8_t)(BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ))) {
                 pCandidate = pMatch;
+                break;
             }
+            index = pMatch->LRU_Prev;
         }
     }
-
-    if (pCandidate != NULL) { 
+    if (pCandidate != NULL) {
         /* Found something to free up */
+        address_entry_unlink(pCandidate);
         pCandidate->Flags = BAC_ADDR_RESERVED;
         /* only reserve it for a short while */
         pCandidate->TimeToLive = BAC_ADDR_SHORT_TIME;
@@ -422,6 +714,7 @@ void address_init(void)
         pMatch = &Address_Cache[index];
         pMatch->Flags = 0;
     }
+    address_cache_index_rebuild();
 #ifdef BACNET_ADDRESS_CACHE_FILE
     address_file_init(Address_Cache_Filename);
 #endif
@@ -455,6 +748,7 @@ void address_init_partial(void)
             pMatch->Flags = 0;
         }
     }
+    address_cache_index_rebuild();
 #ifdef BACNET_ADDRESS_CACHE_FILE
     address_file_init(Address_Cache_Filename);
 #endif
@@ -476,26 +770,21 @@ void address_set_device_TTL(
     uint32_t device_id, uint32_t TimeOut, bool StaticFlag)
 {
     struct Address_Cache_Entry *pMatch;
-    unsigned index;
 
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
-            (pMatch->device_id == device_id)) {
-            if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) { 
-                /* If bound then we have either static or normaal */
-                if (StaticFlag) {
-                    pMatch->Flags |= BAC_ADDR_STATIC;
-                    pMatch->TimeToLive = BAC_ADDR_FOREVER;
-                } else {
-                    pMatch->Flags &= ~BAC_ADDR_STATIC;
-                    pMatch->TimeToLive = TimeOut;
-                }
+    pMatch = address_entry_by_device(device_id);
+    if (pMatch) {
+        if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) {
+            /* If bound then we have either static or normaal */
+            if (StaticFlag) {
+                pMatch->Flags |= BAC_ADDR_STATIC;
+                pMatch->TimeToLive = BAC_ADDR_FOREVER;
             } else {
-            	/* For unbound we can only set the time to live */
-                pMatch->TimeToLive = TimeOut; 
+                pMatch->Flags &= ~BAC_ADDR_STATIC;
+                pMatch->TimeToLive = TimeOut;
             }
-            break; /* Exit now if found at all - bound or unbound */
+        } else {
+            /* For unbound we can only set the time to live */
+            pMatch->TimeToLive = TimeOut;
         }
     }
 }
@@ -512,22 +801,15 @@ bool address_get_by_device(
 {
     struct Address_Cache_Entry *pMatch;
     bool found = false; /* return value */
-    unsigned index;
 
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
-            (pMatch->device_id == device_id)) {
-            if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) { 
-                /* If bound then fetch data */
-                bacnet_address_copy(src, &pMatch->address);
-                *max_apdu = pMatch->max_apdu;
-                /* Prove we found it */
-                found = true; 
-            }
-            /* Exit now if found at all - bound or unbound */
-            break; 
-        }
+    pMatch = address_entry_by_device(device_id);
+    if (pMatch && ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0)) {
+        /* If bound then fetch data */
+        bacnet_address_copy(src, &pMatch->address);
+        *max_apdu = pMatch->max_apdu;
+        address_lru_touch(pMatch, true);
+        /* Prove we found it */
+        found = true;
     }
 
     return found;
@@ -545,21 +827,24 @@ bool address_get_device_id(BACNET_ADDRESS *src, uint32_t *device_id)
 {
     struct Address_Cache_Entry *pMatch;
     bool found = false; /* return value */
-    unsigned index;
+    uint16_t index;
 
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
+    if (!Address_Index_Valid) {
+        address_cache_index_rebuild();
+    }
+    /* only bound entries are in the network address index */
+    index = MAC_Hash[address_mac_hash(src)];
+    while (index != ADDRESS_CACHE_NONE) {
         pMatch = &Address_Cache[index];
-        if ((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ)) == 
-            BAC_ADDR_IN_USE) { 
-            /* If bound */
-            if (bacnet_address_same(&pMatch->address, src)) {
-                if (device_id) {
-                    *device_id = pMatch->device_id;
-                }
-                found = true;
-                break;
+        if (bacnet_address_same(&pMatch->address, src)) {
+            if (device_id) {
+                *device_id = pMatch->device_id;
             }
+            address_lru_touch(pMatch, true);
+            found = true;
+            break;
         }
+        index = pMatch->MAC_Next;
     }
 
     return found;
@@ -574,9 +859,7 @@ bool address_get_device_id(BACNET_ADDRESS *src, uint32_t *device_id)
  */
 void address_add(uint32_t device_id, unsigned max_apdu, BACNET_ADDRESS *src)
 {
-    bool found = false; /* return value */
     struct Address_Cache_Entry *pMatch;
-    unsigned index;
 
     if (Own_Device_ID == device_id) {
         return;
@@ -589,61 +872,49 @@ void address_add(uint32_t device_id, unsigned max_apdu, BACNET_ADDRESS *src)
        bind request if it exists */
 
     /* existing device or bind request outstanding - update address */
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
+    pMatch = address_entry_by_device(device_id);
+    if (pMatch) {
         /* Device already in the list, then update the values. */
-        if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
-            (pMatch->device_id == device_id)) {
-            bacnet_address_copy(&pMatch->address, src);
-            pMatch->max_apdu = max_apdu;
-            /* Pick the right time to live */
-            if ((pMatch->Flags & BAC_ADDR_BIND_REQ) != 0) { 
-                /* Bind requested so long time */
-                pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
-            } else if ((pMatch->Flags & BAC_ADDR_STATIC) != 0) { 
-                /* Static already so make sure it never expires */
-                pMatch->TimeToLive = BAC_ADDR_FOREVER;
-            } else if ((pMatch->Flags & BAC_ADDR_SHORT_TTL) != 0) { 
-                /* Opportunistic entry so leave on short fuse */
-                pMatch->TimeToLive = BAC_ADDR_SHORT_TIME;
-            } else {
-            	/* Renewing existing entry */
-                pMatch->TimeToLive = BAC_ADDR_LONG_TIME; 
-            }
-            /* Clear bind request flag just in case */
-            pMatch->Flags &= ~BAC_ADDR_BIND_REQ; 
-            found = true;
-            break;
+        if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) {
+            address_mac_unlink(pMatch);
         }
-    }
-    /* New device - add to cache if there is room. */
-    if (!found) {
-        for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-            pMatch = &Address_Cache[index];
-            if ((pMatch->Flags & BAC_ADDR_IN_USE) == 0) {
-                pMatch->Flags = BAC_ADDR_IN_USE;
-                pMatch->device_id = device_id;
-                pMatch->max_apdu = max_apdu;
-                bacnet_address_copy(&pMatch->address, src);
-                /* Opportunistic entry so leave on short fuse */
-                pMatch->TimeToLive = BAC_ADDR_SHORT_TIME; 
-                found = true;
-                break;
-            }
+        bacnet_address_copy(&pMatch->address, src);
+        pMatch->max_apdu = max_apdu;
+        /* Pick the right time to live */
+        if ((pMatch->Flags & BAC_ADDR_BIND_REQ) != 0) {
+            /* Bind requested so long time */
+            pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
+        } else if ((pMatch->Flags & BAC_ADDR_STATIC) != 0) {
+            /* Static already so make sure it never expires */
+            pMatch->TimeToLive = BAC_ADDR_FOREVER;
+        } else if ((pMatch->Flags & BAC_ADDR_SHORT_TTL) != 0) {
+            /* Opportunistic entry so leave on short fuse */
+            pMatch->TimeToLive = BAC_ADDR_SHORT_TIME;
+        } else {
+            /* Renewing existing entry */
+            pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
         }
+        /* Clear bind request flag just in case */
+        pMatch->Flags &= ~BAC_ADDR_BIND_REQ;
+        address_mac_link(pMatch);
+        address_lru_touch(pMatch, true);
+        return;
     }
+    /* New device - add to cache if there is room. */
+    pMatch = address_entry_alloc();
     /* If adding has failed, see if we can squeeze it in by removed the oldest
      * entry. */
-    if (!found) {
+    if (pMatch == NULL) {
         pMatch = address_remove_oldest();
-        if (pMatch != NULL) {
-            pMatch->Flags = BAC_ADDR_IN_USE;
-            pMatch->device_id = device_id;
-            pMatch->max_apdu = max_apdu;
-            bacnet_address_copy(&pMatch->address, src);
-            /* Opportunistic entry so leave on short fuse */
-            pMatch->TimeToLive = BAC_ADDR_SHORT_TIME; 
-        }
+    }
+    if (pMatch != NULL) {
+        pMatch->Flags = BAC_ADDR_IN_USE;
+        pMatch->device_id = device_id;
+        pMatch->max_apdu = max_apdu;
+        bacnet_address_copy(&pMatch->address, src);
+        /* Opportunistic entry so leave on short fuse */
+        pMatch->TimeToLive = BAC_ADDR_SHORT_TIME;
+        address_entry_link(pMatch);
     }
     return;
 }
@@ -668,61 +939,50 @@ bool address_device_bind_request(uint32_t device_id,
 {
     bool found = false; /* return value */
     struct Address_Cache_Entry *pMatch;
-    unsigned index;
 
     /* existing device - update address info if currently bound */
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
-            (pMatch->device_id == device_id)) {
-            if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) { 
-                /* Already bound */
-                found = true;
-                if (src) {
-                    bacnet_address_copy(src, &pMatch->address);
-                }
-                if (max_apdu) {
-                    *max_apdu = pMatch->max_apdu;
-                }
-                if (device_ttl) {
-                    *device_ttl = pMatch->TimeToLive;
-                }
-                if ((pMatch->Flags & BAC_ADDR_SHORT_TTL) != 0) { 
-                    /* Was picked up opportunistacilly */
-                    /* Convert to normal entry  */
-                    pMatch->Flags &= ~BAC_ADDR_SHORT_TTL;
-                    /* And give it a decent time to live */
-                    pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
-                }
+    pMatch = address_entry_by_device(device_id);
+    if (pMatch) {
+        if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) {
+            /* Already bound */
+            found = true;
+            if (src) {
+                bacnet_address_copy(src, &pMatch->address);
+            }
+            if (max_apdu) {
+                *max_apdu = pMatch->max_apdu;
+            }
+            if (device_ttl) {
+                *device_ttl = pMatch->TimeToLive;
+            }
+            if ((pMatch->Flags & BAC_ADDR_SHORT_TTL) != 0) {
+                /* Was picked up opportunistacilly */
+                /* Convert to normal entry  */
+                pMatch->Flags &= ~BAC_ADDR_SHORT_TTL;
+                /* And give it a decent time to live */
+                pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
             }
-            /* True if bound, false if bind request outstanding */
-            return (found); 
         }
+        address_lru_touch(pMatch, true);
+        /* True if bound, false if bind request outstanding */
+        return (found);
     }
 
     /* Not there already so look for a free entry to put it in */
-    /* existing device - update address info if currently bound */
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if ((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_RESERVED)) == 0) {
-            /* In use and awaiting binding */
-            pMatch->Flags = (uint8_t)(BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ);
-            pMatch->device_id = device_id;
-            /* No point in leaving bind requests in for long haul */
-            pMatch->TimeToLive = BAC_ADDR_SHORT_TIME;
-            /* now would be a good time to do a Who-Is request */
-            return (false);
-        }
+    pMatch = address_entry_alloc();
+    if (pMatch == NULL) {
+        /* No free entries, See if we can squeeze it in by dropping an
+         * existing one */
+        pMatch = address_remove_oldest();
     }
-
-    /* No free entries, See if we can squeeze it in by dropping an existing one
-     */
-    pMatch = address_remove_oldest();
     if (pMatch != NULL) {
+        /* In use and awaiting binding */
         pMatch->Flags = (uint8_t)(BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ);
         pMatch->device_id = device_id;
         /* No point in leaving bind requests in for long haul */
         pMatch->TimeToLive = BAC_ADDR_SHORT_TIME;
+        address_entry_link(pMatch);
+        /* now would be a good time to do a Who-Is request */
     }
     return (false);
 }
@@ -756,24 +1016,24 @@ void address_add_binding(
     uint32_t device_id, unsigned max_apdu, BACNET_ADDRESS *src)
 {
     struct Address_Cache_Entry *pMatch;
-    unsigned index;
 
     /* existing device or bind request - update address */
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        if (((pMatch->Flags & BAC_ADDR_IN_USE) != 0) &&
-            (pMatch->device_id == device_id)) {
-            bacnet_address_copy(&pMatch->address, src);
-            pMatch->max_apdu = max_apdu;
-            /* Clear bind request flag in case it was set */
-            pMatch->Flags &= ~BAC_ADDR_BIND_REQ;
-            /* Only update TTL if not static */
-            if ((pMatch->Flags & BAC_ADDR_STATIC) == 0) {
-                /* and set it on a long fuse */
-                pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
-            }
-            break;
+    pMatch = address_entry_by_device(device_id);
+    if (pMatch) {
+        if ((pMatch->Flags & BAC_ADDR_BIND_REQ) == 0) {
+            address_mac_unlink(pMatch);
+        }
+        bacnet_address_copy(&pMatch->address, src);
+        pMatch->max_apdu = max_apdu;
+        /* Clear bind request flag in case it was set */
+        pMatch->Flags &= ~BAC_ADDR_BIND_REQ;
+        address_mac_link(pMatch);
+        /* Only update TTL if not static */
+        if ((pMatch->Flags & BAC_ADDR_STATIC) == 0) {
+            /* and set it on a long fuse */
+            pMatch->TimeToLive = BAC_ADDR_LONG_TIME;
         }
+        address_lru_touch(pMatch, true);
     }
     return;
 }
@@ -849,20 +1109,8 @@ bool address_get_by_index(unsigned index,
  */
 unsigned address_count(void)
 {
-    struct Address_Cache_Entry *pMatch;
-    unsigned count = 0; /* return value */
-    unsigned index;
-
-    for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
-        pMatch = &Address_Cache[index];
-        /* Only count bound entries */
-        if ((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_BIND_REQ)) ==
-            BAC_ADDR_IN_USE) {
-            count++;
-        }
-    }
-
-    return count;
+    /* Only count bound entries */
+    return Bound_Count;
 }
 
 /**
@@ -1140,7 +1388,7 @@ void address_cache_timer(uint16_t uSeconds)
 {
     struct Address_Cache_Entry *pMatch;
     unsigned index;
-    
+
     for (index = 0; index < MAX_ADDRESS_CACHE; index++) {
         pMatch = &Address_Cache[index];
         if (((pMatch->Flags & (BAC_ADDR_IN_USE | BAC_ADDR_RESERVED)) != 0) &&
@@ -1150,7 +1398,7 @@ void address_cache_timer(uint16_t uSeconds)
             if (pMatch->TimeToLive >= uSeconds) {
                 pMatch->TimeToLive -= uSeconds;
             } else {
-                pMatch->Flags = 0;
+                address_entry_free(pMatch);
             }
         }
     }
@@ -133,7 +133,7 @@ unsigned Access_Rights_Instance_To_Index(uint32_t object_instance)
 bool Access_Rights_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
     if (object_instance < MAX_ACCESS_RIGHTSS) {
@@ -36,7 +36,9 @@
 #include "bacnet/bactext.h"
 #include "bacnet/config.h" /* the custom stuff */
 #include "bacnet/basic/object/device.h"
+#include "bacnet/cov.h"
 #include "bacnet/basic/services.h"
+#include "bacnet/basic/sys/keytable.h"
 #include "bacnet/proplist.h"
 #include "bacnet/timestamp.h"
 #include "bacnet/basic/object/ai.h"
@@ -48,11 +50,22 @@
 #define PRINTF(...)
 #endif
 
+/* number of objects created by Analog_Input_Init() - more may be
+   created or deleted with Analog_Input_Create() and Analog_Input_Delete() */
 #ifndef MAX_ANALOG_INPUTS
 #define MAX_ANALOG_INPUTS 4
 #endif
 
-static ANALOG_INPUT_DESCR AI_Descr[MAX_ANALOG_INPUTS];
+/* The objects are kept in a table indexed by instance number.  The
+   values that are read for every COV check are kept in arrays of their
+   own, and the rest of each object in AI_Descr. */
+static KEYTABLE AI_Table;
+static ANALOG_INPUT_DESCR *AI_Descr;
+static float *AI_Present_Value;
+static float *AI_Prior_Value;
+static float *AI_COV_Increment;
+static bool *AI_Out_Of_Service;
+static bool *AI_Changed;
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
@@ -86,86 +99,272 @@ void Analog_Input_Property_Lists(
     return;
 }
 
-void Analog_Input_Init(void)
+/**
+ * @brief Set up the columns of the object table, once
+ * @return true if the columns are set up
+ */
+static bool Analog_Input_Table_Init(void)
+{
+    if (AI_Table.column_count) {
+        return true;
+    }
+    Keytable_Init(&AI_Table);
+    if (Keytable_Column_Add(
+            &AI_Table, (void **)&AI_Descr, sizeof(ANALOG_INPUT_DESCR)) &&
+        Keytable_Column_Add(
+            &AI_Table, (void **)&AI_Present_Value, sizeof(float)) &&
+        Keytable_Column_Add(
+            &AI_Table, (void **)&AI_Prior_Value, sizeof(float)) &&
+        Keytable_Column_Add(
+            &AI_Table, (void **)&AI_COV_Increment, sizeof(float)) &&
+        Keytable_Column_Add(
+            &AI_Table, (void **)&AI_Out_Of_Service, sizeof(bool)) &&
+        Keytable_Column_Add(&AI_Table, (void **)&AI_Changed, sizeof(bool))) {
+        return true;
+    }
+    Keytable_Init(&AI_Table);
+
+    return false;
+}
+
+/**
+ * @brief Set the properties of a new object to their defaults
+ * @param index - object index of the new object
+ */
+static void Analog_Input_Object_Defaults(unsigned index)
 {
-    unsigned i;
 #if defined(INTRINSIC_REPORTING)
     unsigned j;
 #endif
 
-    for (i = 0; i < MAX_ANALOG_INPUTS; i++) {
-        AI_Descr[i].Present_Value = 0.0f;
-        AI_Descr[i].Out_Of_Service = false;
-        AI_Descr[i].Units = UNITS_PERCENT;
-        AI_Descr[i].Reliability = RELIABILITY_NO_FAULT_DETECTED;
-        AI_Descr[i].Prior_Value = 0.0f;
-        AI_Descr[i].COV_Increment = 1.0f;
-        AI_Descr[i].Changed = false;
+    AI_Present_Value[index] = 0.0f;
+    AI_Out_Of_Service[index] = false;
+    AI_Descr[index].Units = UNITS_PERCENT;
+    AI_Descr[index].Reliability = RELIABILITY_NO_FAULT_DETECTED;
+    AI_Prior_Value[index] = 0.0f;
+    AI_COV_Increment[index] = 1.0f;
+    AI_Changed[index] = false;
 #if defined(INTRINSIC_REPORTING)
-        AI_Descr[i].Event_State = EVENT_STATE_NORMAL;
-        /* notification class not connected */
-        AI_Descr[i].Notification_Class = BACNET_MAX_INSTANCE;
-        /* initialize Event time stamps using wildcards
-           and set Acked_transitions */
-        for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
-            datetime_wildcard_set(&AI_Descr[i].Event_Time_Stamps[j]);
-            AI_Descr[i].Acked_Transitions[j].bIsAcked = true;
+    AI_Descr[index].Event_State = EVENT_STATE_NORMAL;
+    AI_Descr[index].Time_Delay_Running = false;
+    AI_Descr[index].Time_Delay_Timer = false;
+    AI_Descr[index].Reporting_Queued = false;
+    /* notification class not connected */
+    AI_Descr[index].Notification_Class = BACNET_MAX_INSTANCE;
+    /* initialize Event time stamps using wildcards
+       and set Acked_transitions */
+    for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
+        datetime_wildcard_set(&AI_Descr[index].Event_Time_Stamps[j]);
+        AI_Descr[index].Acked_Transitions[j].bIsAcked = true;
+    }
+#endif
+}
+
+#if defined(INTRINSIC_REPORTING)
+/**
+ * @brief Add the object to the index of active events, if its Event_State
+ *  is not NORMAL or a transition is not acknowledged, or else remove it
+ * @param index - object index of the object
+ */
+static void Analog_Input_Event_Index_Update(unsigned index)
+{
+    bool active;
+
+    active = (AI_Descr[index].Event_State != EVENT_STATE_NORMAL) ||
+        !AI_Descr[index].Acked_Transitions[TRANSITION_TO_OFFNORMAL].bIsAcked ||
+        !AI_Descr[index].Acked_Transitions[TRANSITION_TO_FAULT].bIsAcked ||
+        !AI_Descr[index].Acked_Transitions[TRANSITION_TO_NORMAL].bIsAcked;
+    handler_get_event_information_active_set(
+        OBJECT_ANALOG_INPUT, Analog_Input_Index_To_Instance(index), active);
+}
+
+/**
+ * @brief Ask for the object to be evaluated on the next pass of intrinsic
+ *  reporting, unless it is already queued
+ * @param index - object index of the object
+ */
+static void Analog_Input_Reporting_Request(unsigned index)
+{
+    if (!AI_Descr[index].Reporting_Queued) {
+        AI_Descr[index].Reporting_Queued = Device_Intrinsic_Reporting_Request(
+            OBJECT_ANALOG_INPUT, Analog_Input_Index_To_Instance(index));
+    }
+}
+
+/**
+ * @brief Ask for the object to be evaluated when its time delay expires.
+ *  Without a timer, the object is evaluated on each pass until then.
+ * @param index - object index of the object
+ * @param seconds - number of seconds until the time delay expires
+ */
+static void Analog_Input_Time_Delay_Timer(unsigned index, uint32_t seconds)
+{
+    AI_Descr[index].Time_Delay_Timer = Device_Intrinsic_Reporting_Timer(
+        OBJECT_ANALOG_INPUT, Analog_Input_Index_To_Instance(index), seconds);
+    if (!AI_Descr[index].Time_Delay_Timer) {
+        Analog_Input_Reporting_Request(index);
+    }
+}
+
+/**
+ * @brief Run the time delay of an event state transition whose conditions
+ *  are met.  The delay starts the first time that it is run, and the
+ *  object is evaluated again when it expires.
+ * @param index - object index of the object
+ * @return true once the conditions have been met for Time_Delay seconds
+ */
+static bool Analog_Input_Time_Delay(unsigned index)
+{
+    ANALOG_INPUT_DESCR *CurrentAI = &AI_Descr[index];
+    uint32_t seconds = Device_Intrinsic_Reporting_Seconds();
+
+    if (!CurrentAI->Time_Delay_Running) {
+        if (CurrentAI->Time_Delay == 0) {
+            return true;
         }
+        CurrentAI->Time_Delay_Running = true;
+        CurrentAI->Time_Delay_Expires = seconds + CurrentAI->Time_Delay;
+        Analog_Input_Time_Delay_Timer(index, CurrentAI->Time_Delay);
+        return false;
+    }
+    if ((int32_t)(seconds - CurrentAI->Time_Delay_Expires) < 0) {
+        if (!CurrentAI->Time_Delay_Timer) {
+            Analog_Input_Time_Delay_Timer(
+                index, CurrentAI->Time_Delay_Expires - seconds);
+        }
+        return false;
+    }
+    CurrentAI->Time_Delay_Running = false;
+
+    return true;
+}
+#endif
+
+/**
+ * @brief Create an Analog Input object
+ * @param object_instance - object-instance number of the object
+ * @return true if the object was created, or already exists
+ */
+bool Analog_Input_Create(uint32_t object_instance)
+{
+    uint32_t index;
+
+    if (object_instance >= BACNET_MAX_INSTANCE) {
+        return false;
+    }
+    if (!Analog_Input_Table_Init()) {
+        return false;
+    }
+    if (Keytable_Index(&AI_Table, object_instance) != KEYTABLE_INDEX_NONE) {
+        return true;
+    }
+    index = Keytable_Add(&AI_Table, object_instance);
+    if (index == KEYTABLE_INDEX_NONE) {
+        return false;
+    }
+    Analog_Input_Object_Defaults(index);
+
+    return true;
+}
 
-        /* Set handler for GetEventInformation function */
-        handler_get_event_information_set(
-            OBJECT_ANALOG_INPUT, Analog_Input_Event_Information);
-        /* Set handler for AcknowledgeAlarm function */
-        handler_alarm_ack_set(OBJECT_ANALOG_INPUT, Analog_Input_Alarm_Ack);
-        /* Set handler for GetAlarmSummary Service */
-        handler_get_alarm_summary_set(
-            OBJECT_ANALOG_INPUT, Analog_Input_Alarm_Summary);
+/**
+ * @brief Delete an Analog Input object
+ * @param object_instance - object-instance number of the object
+ * @return true if the object was deleted
+ */
+bool Analog_Input_Delete(uint32_t object_instance)
+{
+#if defined(INTRINSIC_REPORTING)
+    handler_get_event_information_active_set(
+        OBJECT_ANALOG_INPUT, object_instance, false);
 #endif
+    return Keytable_Delete(&AI_Table, object_instance);
+}
+
+/**
+ * @brief Delete all the Analog Input objects, and free their memory
+ */
+void Analog_Input_Cleanup(void)
+{
+#if defined(INTRINSIC_REPORTING)
+    handler_get_event_information_active_clear(OBJECT_ANALOG_INPUT);
+#endif
+    Keytable_Clear(&AI_Table);
+}
+
+void Analog_Input_Init(void)
+{
+    unsigned i;
+
+    Analog_Input_Cleanup();
+    for (i = 0; i < MAX_ANALOG_INPUTS; i++) {
+        Analog_Input_Create(i);
     }
+#if defined(INTRINSIC_REPORTING)
+    /* Set handler for GetEventInformation function */
+    handler_get_event_information_set(
+        OBJECT_ANALOG_INPUT, Analog_Input_Event_Information);
+    handler_get_event_information_index_set(
+        OBJECT_ANALOG_INPUT, Analog_Input_Instance_To_Index);
+    /* Set handler for AcknowledgeAlarm function */
+    handler_alarm_ack_set(OBJECT_ANALOG_INPUT, Analog_Input_Alarm_Ack);
+    /* Set handler for GetAlarmSummary Service */
+    handler_get_alarm_summary_set(
+        OBJECT_ANALOG_INPUT, Analog_Input_Alarm_Summary);
+#endif
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
+/**
+ * @brief Determine if the object instance exists
+ * @param object_instance - object-instance number of the object
+ * @return true if the object exists
+ */
 bool Analog_Input_Valid_Instance(uint32_t object_instance)
 {
     unsigned int index;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         return true;
     }
 
     return false;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
+/**
+ * @brief Get the number of Analog Input objects
+ * @return the number of objects
+ */
 unsigned Analog_Input_Count(void)
 {
-    return MAX_ANALOG_INPUTS;
+    return Keytable_Count(&AI_Table);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
+/**
+ * @brief Get the object-instance number of the object at an index.
+ *  The index of an object may change when another object is deleted.
+ * @param index - object index, 0..Analog_Input_Count()-1
+ * @return the object-instance number, or BACNET_MAX_INSTANCE if the
+ *  index is not valid
+ */
 uint32_t Analog_Input_Index_To_Instance(unsigned index)
 {
-    return index;
+    if (index < Keytable_Count(&AI_Table)) {
+        return Keytable_Key(&AI_Table, index);
+    }
+
+    return BACNET_MAX_INSTANCE;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/**
+ * @brief Get the object index of an object-instance number
+ * @param object_instance - object-instance number of the object
+ * @return the object index, or Analog_Input_Count() or more
+ *  if the object does not exist
+ */
 unsigned Analog_Input_Instance_To_Index(uint32_t object_instance)
 {
-    unsigned index = MAX_ANALOG_INPUTS;
-
-    if (object_instance < MAX_ANALOG_INPUTS) {
-        index = object_instance;
-    }
-
-    return index;
+    return Keytable_Index(&AI_Table, object_instance);
 }
 
 float Analog_Input_Present_Value(uint32_t object_instance)
@@ -174,8 +373,8 @@ float Analog_Input_Present_Value(uint32_t object_instance)
     unsigned int index;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        value = AI_Descr[index].Present_Value;
+    if (index < Keytable_Count(&AI_Table)) {
+        value = AI_Present_Value[index];
     }
 
     return value;
@@ -187,17 +386,19 @@ static void Analog_Input_COV_Detect(unsigned int index, float value)
     float cov_increment = 0.0;
     float cov_delta = 0.0;
 
-    if (index < MAX_ANALOG_INPUTS) {
-        prior_value = AI_Descr[index].Prior_Value;
-        cov_increment = AI_Descr[index].COV_Increment;
+    if (index < Keytable_Count(&AI_Table)) {
+        prior_value = AI_Prior_Value[index];
+        cov_increment = AI_COV_Increment[index];
         if (prior_value > value) {
             cov_delta = prior_value - value;
         } else {
             cov_delta = value - prior_value;
         }
         if (cov_delta >= cov_increment) {
-            AI_Descr[index].Changed = true;
-            AI_Descr[index].Prior_Value = value;
+            AI_Changed[index] = true;
+            AI_Prior_Value[index] = value;
+            cov_change_detected_notify(
+                OBJECT_ANALOG_INPUT, Analog_Input_Index_To_Instance(index));
         }
     }
 }
@@ -207,22 +408,26 @@ void Analog_Input_Present_Value_Set(uint32_t object_instance, float value)
     unsigned int index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         Analog_Input_COV_Detect(index, value);
-        AI_Descr[index].Present_Value = value;
+        AI_Present_Value[index] = value;
+#if defined(INTRINSIC_REPORTING)
+        Analog_Input_Reporting_Request(index);
+#endif
     }
 }
 
 bool Analog_Input_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     unsigned int index;
     bool status = false;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        sprintf(text_string, "ANALOG INPUT %lu", (unsigned long)index);
+    if (index < Keytable_Count(&AI_Table)) {
+        sprintf(
+            text_string, "ANALOG INPUT %lu", (unsigned long)object_instance);
         status = characterstring_init_ansi(object_name, text_string);
     }
 
@@ -243,7 +448,7 @@ unsigned Analog_Input_Event_State(uint32_t object_instance)
 
 #if defined(INTRINSIC_REPORTING)
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         state = AI_Descr[index].Event_State;
     }
 #endif
@@ -257,8 +462,8 @@ bool Analog_Input_Change_Of_Value(uint32_t object_instance)
     bool changed = false;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        changed = AI_Descr[index].Changed;
+    if (index < Keytable_Count(&AI_Table)) {
+        changed = AI_Changed[index];
     }
 
     return changed;
@@ -269,8 +474,8 @@ void Analog_Input_Change_Of_Value_Clear(uint32_t object_instance)
     unsigned index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        AI_Descr[index].Changed = false;
+    if (index < Keytable_Count(&AI_Table)) {
+        AI_Changed[index] = false;
     }
 }
 
@@ -294,12 +499,12 @@ bool Analog_Input_Encode_Value_List(
     unsigned index = 0; /* offset from instance lookup */
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         if (AI_Descr[index].Event_State != EVENT_STATE_NORMAL) {
             in_alarm = true;
         }
-        out_of_service = AI_Descr[index].Out_Of_Service;
-        present_value = AI_Descr[index].Present_Value;
+        out_of_service = AI_Out_Of_Service[index];
+        present_value = AI_Present_Value[index];
         status = cov_value_list_encode_real(value_list, present_value,
             in_alarm, fault, overridden, out_of_service);
     }
@@ -313,8 +518,8 @@ float Analog_Input_COV_Increment(uint32_t object_instance)
     float value = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        value = AI_Descr[index].COV_Increment;
+    if (index < Keytable_Count(&AI_Table)) {
+        value = AI_COV_Increment[index];
     }
 
     return value;
@@ -325,9 +530,9 @@ void Analog_Input_COV_Increment_Set(uint32_t object_instance, float value)
     unsigned index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        AI_Descr[index].COV_Increment = value;
-        Analog_Input_COV_Detect(index, AI_Descr[index].Present_Value);
+    if (index < Keytable_Count(&AI_Table)) {
+        AI_COV_Increment[index] = value;
+        Analog_Input_COV_Detect(index, AI_Present_Value[index]);
     }
 }
 
@@ -337,8 +542,8 @@ bool Analog_Input_Out_Of_Service(uint32_t object_instance)
     bool value = false;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
-        value = AI_Descr[index].Out_Of_Service;
+    if (index < Keytable_Count(&AI_Table)) {
+        value = AI_Out_Of_Service[index];
     }
 
     return value;
@@ -349,7 +554,7 @@ void Analog_Input_Out_Of_Service_Set(uint32_t object_instance, bool value)
     unsigned index = 0;
 
     index = Analog_Input_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         /* 	BACnet Testing Observed Incident oi00104
                 The Changed flag was not being set when a client wrote to the
         Out-of-Service bit. Revealed by BACnet Test Client v1.8.16 (
@@ -358,10 +563,11 @@ void Analog_Input_Out_Of_Service_Set(uint32_t object_instance, bool value)
         Please feel free to remove this comment when my changes accepted after
         suitable time for review by all interested parties. Say 6 months ->
         September 2016 */
-        if (AI_Descr[index].Out_Of_Service != value) {
-            AI_Descr[index].Changed = true;
+        if (AI_Out_Of_Service[index] != value) {
+            AI_Changed[index] = true;
+            cov_change_detected_notify(OBJECT_ANALOG_INPUT, object_instance);
         }
-        AI_Descr[index].Out_Of_Service = value;
+        AI_Out_Of_Service[index] = value;
     }
 }
 
@@ -386,7 +592,7 @@ int Analog_Input_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
     }
 
     object_index = Analog_Input_Instance_To_Index(rpdata->object_instance);
-    if (object_index < MAX_ANALOG_INPUTS) {
+    if (object_index < Keytable_Count(&AI_Table)) {
         CurrentAI = &AI_Descr[object_index];
     } else {
         return BACNET_STATUS_ERROR;
@@ -424,7 +630,7 @@ int Analog_Input_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
             bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
             bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
             bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE,
-                CurrentAI->Out_Of_Service);
+                AI_Out_Of_Service[object_index]);
 
             apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
             break;
@@ -442,7 +648,7 @@ int Analog_Input_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
 
         case PROP_OUT_OF_SERVICE:
             apdu_len =
-                encode_application_boolean(&apdu[0], CurrentAI->Out_Of_Service);
+                encode_application_boolean(&apdu[0], AI_Out_Of_Service[object_index]);
             break;
 
         case PROP_UNITS:
@@ -452,7 +658,7 @@ int Analog_Input_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
 
         case PROP_COV_INCREMENT:
             apdu_len =
-                encode_application_real(&apdu[0], CurrentAI->COV_Increment);
+                encode_application_real(&apdu[0], AI_COV_Increment[object_index]);
             break;
 
 #if defined(INTRINSIC_REPORTING)
@@ -625,7 +831,7 @@ bool Analog_Input_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
         return false;
     }
     object_index = Analog_Input_Instance_To_Index(wp_data->object_instance);
-    if (object_index < MAX_ANALOG_INPUTS) {
+    if (object_index < Keytable_Count(&AI_Table)) {
         CurrentAI = &AI_Descr[object_index];
     } else {
         return false;
@@ -636,7 +842,7 @@ bool Analog_Input_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             status = write_property_type_valid(wp_data, &value,
                 BACNET_APPLICATION_TAG_REAL);
             if (status) {
-                if (CurrentAI->Out_Of_Service == true) {
+                if (AI_Out_Of_Service[object_index] == true) {
                     Analog_Input_Present_Value_Set(
                         wp_data->object_instance, value.type.Real);
                 } else {
@@ -685,7 +891,7 @@ bool Analog_Input_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
                 BACNET_APPLICATION_TAG_UNSIGNED_INT);
             if (status) {
                 CurrentAI->Time_Delay = value.type.Unsigned_Int;
-                CurrentAI->Remaining_Time_Delay = CurrentAI->Time_Delay;
+                CurrentAI->Time_Delay_Running = false;
             }
             break;
 
@@ -792,6 +998,13 @@ bool Analog_Input_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             break;
     }
 
+#if defined(INTRINSIC_REPORTING)
+    if (status) {
+        /* the limits or the event algorithm may have changed */
+        Analog_Input_Reporting_Request(object_index);
+    }
+#endif
+
     return status;
 }
 
@@ -809,11 +1022,12 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
     bool SendNotify = false;
 
     object_index = Analog_Input_Instance_To_Index(object_instance);
-    if (object_index < MAX_ANALOG_INPUTS) {
+    if (object_index < Keytable_Count(&AI_Table)) {
         CurrentAI = &AI_Descr[object_index];
     } else {
         return;
     }
+    CurrentAI->Reporting_Queued = false;
     /* check limits */
     if (!CurrentAI->Limit_Enable) {
         return; /* limits are not configured */
@@ -822,6 +1036,8 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
     if (CurrentAI->Ack_notify_data.bSendAckNotify) {
         /* clean bSendAckNotify flag */
         CurrentAI->Ack_notify_data.bSendAckNotify = false;
+        /* the limits are evaluated on the next pass */
+        Analog_Input_Reporting_Request(object_index);
         /* copy toState */
         ToState = CurrentAI->Ack_notify_data.EventState;
         PRINTF("Analog-Input[%d]: Send AckNotification.\n", object_instance);
@@ -850,10 +1066,8 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_HIGH_LIMIT_ENABLE) &&
                     ((CurrentAI->Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ==
                         EVENT_ENABLE_TO_OFFNORMAL)) {
-                    if (!CurrentAI->Remaining_Time_Delay)
+                    if (Analog_Input_Time_Delay(object_index))
                         CurrentAI->Event_State = EVENT_STATE_HIGH_LIMIT;
-                    else
-                        CurrentAI->Remaining_Time_Delay--;
                     break;
                 }
 
@@ -869,14 +1083,12 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_LOW_LIMIT_ENABLE) &&
                     ((CurrentAI->Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ==
                         EVENT_ENABLE_TO_OFFNORMAL)) {
-                    if (!CurrentAI->Remaining_Time_Delay)
+                    if (Analog_Input_Time_Delay(object_index))
                         CurrentAI->Event_State = EVENT_STATE_LOW_LIMIT;
-                    else
-                        CurrentAI->Remaining_Time_Delay--;
                     break;
                 }
                 /* value of the object is still in the same event state */
-                CurrentAI->Remaining_Time_Delay = CurrentAI->Time_Delay;
+                CurrentAI->Time_Delay_Running = false;
                 break;
 
             case EVENT_STATE_HIGH_LIMIT:
@@ -894,14 +1106,12 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_HIGH_LIMIT_ENABLE) &&
                     ((CurrentAI->Event_Enable & EVENT_ENABLE_TO_NORMAL) ==
                         EVENT_ENABLE_TO_NORMAL)) {
-                    if (!CurrentAI->Remaining_Time_Delay)
+                    if (Analog_Input_Time_Delay(object_index))
                         CurrentAI->Event_State = EVENT_STATE_NORMAL;
-                    else
-                        CurrentAI->Remaining_Time_Delay--;
                     break;
                 }
                 /* value of the object is still in the same event state */
-                CurrentAI->Remaining_Time_Delay = CurrentAI->Time_Delay;
+                CurrentAI->Time_Delay_Running = false;
                 break;
 
             case EVENT_STATE_LOW_LIMIT:
@@ -919,14 +1129,12 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_LOW_LIMIT_ENABLE) &&
                     ((CurrentAI->Event_Enable & EVENT_ENABLE_TO_NORMAL) ==
                         EVENT_ENABLE_TO_NORMAL)) {
-                    if (!CurrentAI->Remaining_Time_Delay)
+                    if (Analog_Input_Time_Delay(object_index))
                         CurrentAI->Event_State = EVENT_STATE_NORMAL;
-                    else
-                        CurrentAI->Remaining_Time_Delay--;
                     break;
                 }
                 /* value of the object is still in the same event state */
-                CurrentAI->Remaining_Time_Delay = CurrentAI->Time_Delay;
+                CurrentAI->Time_Delay_Running = false;
                 break;
 
             default:
@@ -1072,7 +1280,7 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
                 STATUS_FLAG_OVERRIDDEN, false);
             bitstring_set_bit(
                 &event_data.notificationParams.outOfRange.statusFlags,
-                STATUS_FLAG_OUT_OF_SERVICE, CurrentAI->Out_Of_Service);
+                STATUS_FLAG_OUT_OF_SERVICE, AI_Out_Of_Service[object_index]);
             /* Deadband used for limit checking. */
             event_data.notificationParams.outOfRange.deadband =
                 CurrentAI->Deadband;
@@ -1128,6 +1336,7 @@ void Analog_Input_Intrinsic_Reporting(uint32_t object_instance)
             }
         }
     }
+    Analog_Input_Event_Index_Update(object_index);
 #endif /* defined(INTRINSIC_REPORTING) */
 }
 
@@ -1140,7 +1349,7 @@ int Analog_Input_Event_Information(
     int i;
 
     /* check index */
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         /* Event_State not equal to NORMAL */
         IsActiveEvent = (AI_Descr[index].Event_State != EVENT_STATE_NORMAL);
 
@@ -1214,7 +1423,7 @@ int Analog_Input_Alarm_Ack(
     object_index = Analog_Input_Instance_To_Index(
         alarmack_data->eventObjectIdentifier.instance);
 
-    if (object_index < MAX_ANALOG_INPUTS)
+    if (object_index < Keytable_Count(&AI_Table))
         CurrentAI = &AI_Descr[object_index];
     else {
         *error_code = ERROR_CODE_UNKNOWN_OBJECT;
@@ -1305,6 +1514,8 @@ int Analog_Input_Alarm_Ack(
         default:
             return -2;
     }
+    Analog_Input_Event_Index_Update(object_index);
+    Analog_Input_Reporting_Request(object_index);
     CurrentAI->Ack_notify_data.bSendAckNotify = true;
     CurrentAI->Ack_notify_data.EventState = alarmack_data->eventStateAcked;
 
@@ -1315,7 +1526,7 @@ int Analog_Input_Alarm_Summary(
     unsigned index, BACNET_GET_ALARM_SUMMARY_DATA *getalarm_data)
 {
     /* check index */
-    if (index < MAX_ANALOG_INPUTS) {
+    if (index < Keytable_Count(&AI_Table)) {
         /* Event_State is not equal to NORMAL  and
            Notify_Type property value is ALARM */
         if ((AI_Descr[index].Event_State != EVENT_STATE_NORMAL) &&
@@ -43,15 +43,12 @@
 extern "C" {
 #endif /* __cplusplus */
 
+    /* the properties of an object that are not often used -
+       Present_Value, Out_Of_Service and the COV data are kept apart */
     typedef struct analog_input_descr {
         unsigned Event_State:3;
-        float Present_Value;
         BACNET_RELIABILITY Reliability;
-        bool Out_Of_Service;
         uint8_t Units;
-        float Prior_Value;
-        float COV_Increment;
-        bool Changed;
 #if defined(INTRINSIC_REPORTING)
         uint32_t Time_Delay;
         uint32_t Notification_Class;
@@ -63,8 +60,14 @@ extern "C" {
         unsigned Notify_Type:1;
         ACKED_INFO Acked_Transitions[MAX_BACNET_EVENT_TRANSITION];
         BACNET_DATE_TIME Event_Time_Stamps[MAX_BACNET_EVENT_TRANSITION];
-        /* time to generate event notification */
-        uint32_t Remaining_Time_Delay;
+        /* second that the time delay of an event state transition
+           expires, while the conditions of the transition are met */
+        uint32_t Time_Delay_Expires;
+        bool Time_Delay_Running;
+        /* true if a timer evaluates the object when the delay expires */
+        bool Time_Delay_Timer;
+        /* true while the object waits to be evaluated */
+        bool Reporting_Queued;
         /* AckNotification informations */
         ACK_NOTIFICATION Ack_notify_data;
 #endif
@@ -91,6 +94,15 @@ extern "C" {
     BACNET_STACK_EXPORT
     bool Analog_Input_Object_Instance_Add(
         uint32_t instance);
+    BACNET_STACK_EXPORT
+    bool Analog_Input_Create(
+        uint32_t object_instance);
+    BACNET_STACK_EXPORT
+    bool Analog_Input_Delete(
+        uint32_t object_instance);
+    BACNET_STACK_EXPORT
+    void Analog_Input_Cleanup(
+        void);
 
     BACNET_STACK_EXPORT
     bool Analog_Input_Object_Name(
@@ -36,7 +36,9 @@
 #include "bacnet/wp.h"
 #include "bacnet/basic/object/ao.h"
 #include "bacnet/basic/services.h"
+#include "bacnet/basic/sys/keytable.h"
 
+/* number of objects created by Analog_Output_Init() */
 #ifndef MAX_ANALOG_OUTPUTS
 #define MAX_ANALOG_OUTPUTS 4
 #endif
@@ -51,13 +53,13 @@
 /* Here is our Priority Array.  They are supposed to be Real, but */
 /* we don't have that kind of memory, so we will use a single byte */
 /* and load a Real for returning the value when asked. */
-static uint8_t Analog_Output_Level[MAX_ANALOG_OUTPUTS][BACNET_MAX_PRIORITY];
+/* The objects are rows of a table that is found by object instance, */
+/* and each property is a column array of the table. */
+static KEYTABLE AO_Table;
+static uint8_t (*Analog_Output_Level)[BACNET_MAX_PRIORITY];
 /* Writable out-of-service allows others to play with our Present Value */
 /* without changing the physical output */
-static bool Out_Of_Service[MAX_ANALOG_OUTPUTS];
-
-/* we need to have our arrays initialized before answering any calls */
-static bool Analog_Output_Initialized = false;
+static bool *Out_Of_Service;
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
@@ -85,63 +87,132 @@ void Analog_Output_Property_Lists(
     return;
 }
 
-void Analog_Output_Init(void)
+/**
+ * @brief Add the property columns to the table of objects, once
+ * @return true if the table has its columns
+ */
+static bool Analog_Output_Table_Init(void)
 {
-    unsigned i, j;
+    if (AO_Table.column_count) {
+        return true;
+    }
+    Keytable_Init(&AO_Table);
+    if (Keytable_Column_Add(&AO_Table, (void **)&Analog_Output_Level,
+            sizeof(Analog_Output_Level[0])) &&
+        Keytable_Column_Add(
+            &AO_Table, (void **)&Out_Of_Service, sizeof(bool))) {
+        return true;
+    }
+    Keytable_Init(&AO_Table);
 
-    if (!Analog_Output_Initialized) {
-        Analog_Output_Initialized = true;
+    return false;
+}
 
-        /* initialize all the analog output priority arrays to NULL */
-        for (i = 0; i < MAX_ANALOG_OUTPUTS; i++) {
-            for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
-                Analog_Output_Level[i][j] = AO_LEVEL_NULL;
-            }
-        }
+/**
+ * @brief Create an Analog Output object, with all the priorities
+ *  relinquished
+ * @param object_instance - object-instance number of the object
+ * @return true if the object was created or already exists
+ */
+bool Analog_Output_Create(uint32_t object_instance)
+{
+    uint32_t index;
+    unsigned j;
+
+    if (object_instance >= BACNET_MAX_INSTANCE) {
+        return false;
+    }
+    if (!Analog_Output_Table_Init()) {
+        return false;
+    }
+    if (Keytable_Index(&AO_Table, object_instance) != KEYTABLE_INDEX_NONE) {
+        return true;
     }
+    index = Keytable_Add(&AO_Table, object_instance);
+    if (index == KEYTABLE_INDEX_NONE) {
+        return false;
+    }
+    for (j = 0; j < BACNET_MAX_PRIORITY; j++) {
+        Analog_Output_Level[index][j] = AO_LEVEL_NULL;
+    }
+    Out_Of_Service[index] = false;
 
-    return;
+    return true;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need validate that the */
-/* given instance exists */
-bool Analog_Output_Valid_Instance(uint32_t object_instance)
+/**
+ * @brief Delete an Analog Output object
+ * @param object_instance - object-instance number of the object
+ * @return true if the object was deleted
+ */
+bool Analog_Output_Delete(uint32_t object_instance)
 {
-    if (object_instance < MAX_ANALOG_OUTPUTS) {
-        return true;
+    return Keytable_Delete(&AO_Table, object_instance);
+}
+
+/**
+ * @brief Delete all the Analog Output objects, and free their memory
+ */
+void Analog_Output_Cleanup(void)
+{
+    Keytable_Clear(&AO_Table);
+}
+
+void Analog_Output_Init(void)
+{
+    unsigned i;
+
+    Analog_Output_Cleanup();
+    for (i = 0; i < MAX_ANALOG_OUTPUTS; i++) {
+        Analog_Output_Create(i);
     }
 
-    return false;
+    return;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then count how many you have */
+/**
+ * @brief Determine if the object instance exists
+ * @param object_instance - object-instance number of the object
+ * @return true if the object exists
+ */
+bool Analog_Output_Valid_Instance(uint32_t object_instance)
+{
+    return Keytable_Index(&AO_Table, object_instance) != KEYTABLE_INDEX_NONE;
+}
+
+/**
+ * @brief Get the number of Analog Output objects
+ * @return the number of objects
+ */
 unsigned Analog_Output_Count(void)
 {
-    return MAX_ANALOG_OUTPUTS;
+    return Keytable_Count(&AO_Table);
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the instance */
-/* that correlates to the correct index */
+/**
+ * @brief Get the object instance of the object at an index
+ * @param index - object index, 0 to count-1
+ * @return the object instance, or BACNET_MAX_INSTANCE if the index
+ *  is not in use
+ */
 uint32_t Analog_Output_Index_To_Instance(unsigned index)
 {
-    return index;
+    if (index < Keytable_Count(&AO_Table)) {
+        return Keytable_Key(&AO_Table, index);
+    }
+
+    return BACNET_MAX_INSTANCE;
 }
 
-/* we simply have 0-n object instances.  Yours might be */
-/* more complex, and then you need to return the index */
-/* that correlates to the correct instance number */
+/**
+ * @brief Get the object index of an object-instance number
+ * @param object_instance - object-instance number of the object
+ * @return the object index, or Analog_Output_Count() or more
+ *  if the object does not exist
+ */
 unsigned Analog_Output_Instance_To_Index(uint32_t object_instance)
 {
-    unsigned index = MAX_ANALOG_OUTPUTS;
-
-    if (object_instance < MAX_ANALOG_OUTPUTS) {
-        index = object_instance;
-    }
-
-    return index;
+    return Keytable_Index(&AO_Table, object_instance);
 }
 
 float Analog_Output_Present_Value(uint32_t object_instance)
@@ -151,7 +222,7 @@ float Analog_Output_Present_Value(uint32_t object_instance)
     unsigned i = 0;
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < Keytable_Count(&AO_Table)) {
         for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
             if (Analog_Output_Level[index][i] != AO_LEVEL_NULL) {
                 value = Analog_Output_Level[index][i];
@@ -170,7 +241,7 @@ unsigned Analog_Output_Present_Value_Priority(uint32_t object_instance)
     unsigned priority = 0; /* return value */
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < Keytable_Count(&AO_Table)) {
         for (i = 0; i < BACNET_MAX_PRIORITY; i++) {
             if (Analog_Output_Level[index][i] != AO_LEVEL_NULL) {
                 priority = i + 1;
@@ -189,7 +260,7 @@ bool Analog_Output_Present_Value_Set(
     bool status = false;
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < Keytable_Count(&AO_Table)) {
         if (priority && (priority <= BACNET_MAX_PRIORITY) &&
             (priority != 6 /* reserved */) && (value >= 0.0) &&
             (value <= 100.0)) {
@@ -214,7 +285,7 @@ bool Analog_Output_Present_Value_Relinquish(
     bool status = false;
 
     index = Analog_Output_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < Keytable_Count(&AO_Table)) {
         if (priority && (priority <= BACNET_MAX_PRIORITY) &&
             (priority != 6 /* reserved */)) {
             Analog_Output_Level[index][priority - 1] = AO_LEVEL_NULL;
@@ -235,10 +306,10 @@ bool Analog_Output_Present_Value_Relinquish(
 bool Analog_Output_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
-    if (object_instance < MAX_ANALOG_OUTPUTS) {
+    if (Analog_Output_Valid_Instance(object_instance)) {
         sprintf(
             text_string, "ANALOG OUTPUT %lu", (unsigned long)object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -253,7 +324,7 @@ bool Analog_Output_Out_Of_Service(uint32_t instance)
     bool oos_flag = false;
 
     index = Analog_Output_Instance_To_Index(instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < Keytable_Count(&AO_Table)) {
         oos_flag = Out_Of_Service[index];
     }
 
@@ -265,7 +336,7 @@ void Analog_Output_Out_Of_Service_Set(uint32_t instance, bool oos_flag)
     unsigned index = 0;
 
     index = Analog_Output_Instance_To_Index(instance);
-    if (index < MAX_ANALOG_OUTPUTS) {
+    if (index < Keytable_Count(&AO_Table)) {
         Out_Of_Service[index] = oos_flag;
     }
 }
@@ -288,6 +359,11 @@ int Analog_Output_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
         return 0;
     }
     apdu = rpdata->application_data;
+    if (!Analog_Output_Valid_Instance(rpdata->object_instance)) {
+        rpdata->error_class = ERROR_CLASS_OBJECT;
+        rpdata->error_code = ERROR_CODE_UNKNOWN_OBJECT;
+        return BACNET_STATUS_ERROR;
+    }
     switch (rpdata->object_property) {
         case PROP_OBJECT_IDENTIFIER:
             apdu_len = encode_application_object_id(
@@ -38,14 +38,27 @@
 #include "bacnet/bactext.h"
 #include "bacnet/config.h" /* the custom stuff */
 #include "bacnet/basic/object/device.h"
+#include "bacnet/cov.h"
 #include "bacnet/basic/services.h"
+#include "bacnet/basic/sys/keytable.h"
 #include "bacnet/basic/object/av.h"
 
+/* number of objects created by Analog_Value_Init() - more may be
+   created or deleted with Analog_Value_Create() and Analog_Value_Delete() */
 #ifndef MAX_ANALOG_VALUES
 #define MAX_ANALOG_VALUES 4
 #endif
 
-static ANALOG_VALUE_DESCR AV_Descr[MAX_ANALOG_VALUES];
+/* The objects are kept in a table indexed by instance number.  The
+   values that are read for every COV check are kept in arrays of their
+   own, and the rest of each object in AV_Descr. */
+static KEYTABLE AV_Table;
+static ANALOG_VALUE_DESCR *AV_Descr;
+static float *AV_Present_Value;
+static float *AV_Prior_Value;
+static float *AV_COV_Increment;
+static bool *AV_Out_Of_Service;
+static bool *AV_Changed;
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Analog_Value_Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
@@ -88,49 +101,229 @@ void Analog_Value_Property_Lists(
 }
 
 /**
- * Initialize the analog values.
+ * Set up the columns of the object table, once.
+ *
+ * @return true if the columns are set up
  */
-void Analog_Value_Init(void)
+static bool Analog_Value_Table_Init(void)
+{
+    if (AV_Table.column_count) {
+        return true;
+    }
+    Keytable_Init(&AV_Table);
+    if (Keytable_Column_Add(
+            &AV_Table, (void **)&AV_Descr, sizeof(ANALOG_VALUE_DESCR)) &&
+        Keytable_Column_Add(
+            &AV_Table, (void **)&AV_Present_Value, sizeof(float)) &&
+        Keytable_Column_Add(
+            &AV_Table, (void **)&AV_Prior_Value, sizeof(float)) &&
+        Keytable_Column_Add(
+            &AV_Table, (void **)&AV_COV_Increment, sizeof(float)) &&
+        Keytable_Column_Add(
+            &AV_Table, (void **)&AV_Out_Of_Service, sizeof(bool)) &&
+        Keytable_Column_Add(&AV_Table, (void **)&AV_Changed, sizeof(bool))) {
+        return true;
+    }
+    Keytable_Init(&AV_Table);
+
+    return false;
+}
+
+/**
+ * Set the properties of a new object to their defaults.
+ *
+ * @param index  Object index of the new object
+ */
+static void Analog_Value_Object_Defaults(unsigned index)
 {
-    unsigned i;
 #if defined(INTRINSIC_REPORTING)
     unsigned j;
 #endif
 
-    for (i = 0; i < MAX_ANALOG_VALUES; i++) {
-        memset(&AV_Descr[i], 0x00, sizeof(ANALOG_VALUE_DESCR));
-        AV_Descr[i].Present_Value = 0.0;
-        AV_Descr[i].Units = UNITS_NO_UNITS;
-        AV_Descr[i].Prior_Value = 0.0f;
-        AV_Descr[i].COV_Increment = 1.0f;
-        AV_Descr[i].Changed = false;
+    AV_Present_Value[index] = 0.0;
+    AV_Descr[index].Units = UNITS_NO_UNITS;
+    AV_Prior_Value[index] = 0.0f;
+    AV_COV_Increment[index] = 1.0f;
+    AV_Changed[index] = false;
 #if defined(INTRINSIC_REPORTING)
-        AV_Descr[i].Event_State = EVENT_STATE_NORMAL;
-        /* notification class not connected */
-        AV_Descr[i].Notification_Class = BACNET_MAX_INSTANCE;
-        /* initialize Event time stamps using wildcards
-           and set Acked_transitions */
-        for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
-            datetime_wildcard_set(&AV_Descr[i].Event_Time_Stamps[j]);
-            AV_Descr[i].Acked_Transitions[j].bIsAcked = true;
+    AV_Descr[index].Event_State = EVENT_STATE_NORMAL;
+    AV_Descr[index].Time_Delay_Running = false;
+    AV_Descr[index].Time_Delay_Timer = false;
+    AV_Descr[index].Reporting_Queued = false;
+    /* notification class not connected */
+    AV_Descr[index].Notification_Class = BACNET_MAX_INSTANCE;
+    /* initialize Event time stamps using wildcards
+       and set Acked_transitions */
+    for (j = 0; j < MAX_BACNET_EVENT_TRANSITION; j++) {
+        datetime_wildcard_set(&AV_Descr[index].Event_Time_Stamps[j]);
+        AV_Descr[index].Acked_Transitions[j].bIsAcked = true;
+    }
+#endif
+}
+
+#if defined(INTRINSIC_REPORTING)
+/**
+ * @brief Add the object to the index of active events, if its Event_State
+ *  is not NORMAL or a transition is not acknowledged, or else remove it
+ * @param index - object index of the object
+ */
+static void Analog_Value_Event_Index_Update(unsigned index)
+{
+    bool active;
+
+    active = (AV_Descr[index].Event_State != EVENT_STATE_NORMAL) ||
+        !AV_Descr[index].Acked_Transitions[TRANSITION_TO_OFFNORMAL].bIsAcked ||
+        !AV_Descr[index].Acked_Transitions[TRANSITION_TO_FAULT].bIsAcked ||
+        !AV_Descr[index].Acked_Transitions[TRANSITION_TO_NORMAL].bIsAcked;
+    handler_get_event_information_active_set(
+        OBJECT_ANALOG_VALUE, Analog_Value_Index_To_Instance(index), active);
+}
+
+/**
+ * @brief Ask for the object to be evaluated on the next pass of intrinsic
+ *  reporting, unless it is already queued
+ * @param index - object index of the object
+ */
+static void Analog_Value_Reporting_Request(unsigned index)
+{
+    if (!AV_Descr[index].Reporting_Queued) {
+        AV_Descr[index].Reporting_Queued = Device_Intrinsic_Reporting_Request(
+            OBJECT_ANALOG_VALUE, Analog_Value_Index_To_Instance(index));
+    }
+}
+
+/**
+ * @brief Ask for the object to be evaluated when its time delay expires.
+ *  Without a timer, the object is evaluated on each pass until then.
+ * @param index - object index of the object
+ * @param seconds - number of seconds until the time delay expires
+ */
+static void Analog_Value_Time_Delay_Timer(unsigned index, uint32_t seconds)
+{
+    AV_Descr[index].Time_Delay_Timer = Device_Intrinsic_Reporting_Timer(
+        OBJECT_ANALOG_VALUE, Analog_Value_Index_To_Instance(index), seconds);
+    if (!AV_Descr[index].Time_Delay_Timer) {
+        Analog_Value_Reporting_Request(index);
+    }
+}
+
+/**
+ * @brief Run the time delay of an event state transition whose conditions
+ *  are met.  The delay starts the first time that it is run, and the
+ *  object is evaluated again when it expires.
+ * @param index - object index of the object
+ * @return true once the conditions have been met for Time_Delay seconds
+ */
+static bool Analog_Value_Time_Delay(unsigned index)
+{
+    ANALOG_VALUE_DESCR *CurrentAV = &AV_Descr[index];
+    uint32_t seconds = Device_Intrinsic_Reporting_Seconds();
+
+    if (!CurrentAV->Time_Delay_Running) {
+        if (CurrentAV->Time_Delay == 0) {
+            return true;
         }
+        CurrentAV->Time_Delay_Running = true;
+        CurrentAV->Time_Delay_Expires = seconds + CurrentAV->Time_Delay;
+        Analog_Value_Time_Delay_Timer(index, CurrentAV->Time_Delay);
+        return false;
+    }
+    if ((int32_t)(seconds - CurrentAV->Time_Delay_Expires) < 0) {
+        if (!CurrentAV->Time_Delay_Timer) {
+            Analog_Value_Time_Delay_Timer(
+                index, CurrentAV->Time_Delay_Expires - seconds);
+        }
+        return false;
+    }
+    CurrentAV->Time_Delay_Running = false;
+
+    return true;
+}
+#endif
+
+/**
+ * Create an analog value.  An existing object is left as is.
+ *
+ * @param object_instance Object instance
+ *
+ * @return true if the object was created, or already exists
+ */
+bool Analog_Value_Create(uint32_t object_instance)
+{
+    uint32_t index;
+
+    if (object_instance >= BACNET_MAX_INSTANCE) {
+        return false;
+    }
+    if (!Analog_Value_Table_Init()) {
+        return false;
+    }
+    if (Keytable_Index(&AV_Table, object_instance) != KEYTABLE_INDEX_NONE) {
+        return true;
+    }
+    index = Keytable_Add(&AV_Table, object_instance);
+    if (index == KEYTABLE_INDEX_NONE) {
+        return false;
+    }
+    Analog_Value_Object_Defaults(index);
 
-        /* Set handler for GetEventInformation function */
-        handler_get_event_information_set(
-            OBJECT_ANALOG_VALUE, Analog_Value_Event_Information);
-        /* Set handler for AcknowledgeAlarm function */
-        handler_alarm_ack_set(OBJECT_ANALOG_VALUE, Analog_Value_Alarm_Ack);
-        /* Set handler for GetAlarmSummary Service */
-        handler_get_alarm_summary_set(
-            OBJECT_ANALOG_VALUE, Analog_Value_Alarm_Summary);
+    return true;
+}
+
+/**
+ * Delete an analog value.
+ *
+ * @param object_instance Object instance
+ *
+ * @return true if the object was deleted
+ */
+bool Analog_Value_Delete(uint32_t object_instance)
+{
+#if defined(INTRINSIC_REPORTING)
+    handler_get_event_information_active_set(
+        OBJECT_ANALOG_VALUE, object_instance, false);
 #endif
+    return Keytable_Delete(&AV_Table, object_instance);
+}
+
+/**
+ * Delete all the analog values, and free their memory.
+ */
+void Analog_Value_Cleanup(void)
+{
+#if defined(INTRINSIC_REPORTING)
+    handler_get_event_information_active_clear(OBJECT_ANALOG_VALUE);
+#endif
+    Keytable_Clear(&AV_Table);
+}
+
+/**
+ * Initialize the analog values.
+ */
+void Analog_Value_Init(void)
+{
+    unsigned i;
+
+    Analog_Value_Cleanup();
+    for (i = 0; i < MAX_ANALOG_VALUES; i++) {
+        Analog_Value_Create(i);
     }
+#if defined(INTRINSIC_REPORTING)
+    /* Set handler for GetEventInformation function */
+    handler_get_event_information_set(
+        OBJECT_ANALOG_VALUE, Analog_Value_Event_Information);
+    handler_get_event_information_index_set(
+        OBJECT_ANALOG_VALUE, Analog_Value_Instance_To_Index);
+    /* Set handler for AcknowledgeAlarm function */
+    handler_alarm_ack_set(OBJECT_ANALOG_VALUE, Analog_Value_Alarm_Ack);
+    /* Set handler for GetAlarmSummary Service */
+    handler_get_alarm_summary_set(
+        OBJECT_ANALOG_VALUE, Analog_Value_Alarm_Summary);
+#endif
 }
 
 /**
- * We simply have 0-n object instances. Yours might be
- * more complex, and then you need validate that the
- * given instance exists.
+ * Determine if the object instance exists.
  *
  * @param object_instance Object instance
  *
@@ -138,7 +331,8 @@ void Analog_Value_Init(void)
  */
 bool Analog_Value_Valid_Instance(uint32_t object_instance)
 {
-    if (object_instance < MAX_ANALOG_VALUES) {
+    if (Analog_Value_Instance_To_Index(object_instance) <
+        Keytable_Count(&AV_Table)) {
         return true;
     }
 
@@ -152,41 +346,37 @@ bool Analog_Value_Valid_Instance(uint32_t object_instance)
  */
 unsigned Analog_Value_Count(void)
 {
-    return MAX_ANALOG_VALUES;
+    return Keytable_Count(&AV_Table);
 }
 
 /**
- * We simply have 0-n object instances.  Yours might be
- * more complex, and then you need to return the instance
- * that correlates to the correct index.
+ * Return the instance of the object at an index.  The index of an
+ * object may change when another object is deleted.
  *
- * @param index Index
+ * @param index Index, 0..Analog_Value_Count()-1
  *
- * @return Object instance
+ * @return Object instance, or BACNET_MAX_INSTANCE if the index is invalid
  */
 uint32_t Analog_Value_Index_To_Instance(unsigned index)
 {
-    return index;
+    if (index < Keytable_Count(&AV_Table)) {
+        return Keytable_Key(&AV_Table, index);
+    }
+
+    return BACNET_MAX_INSTANCE;
 }
 
 /**
- * We simply have 0-n object instances.  Yours might be
- * more complex, and then you need to return the index
- * that correlates to the correct instance number
+ * Return the index of an object instance.
  *
  * @param object_instance Object instance
  *
- * @return Index in the object table.
+ * @return Index in the object table, or Analog_Value_Count() or more
+ *         if the object does not exist.
  */
 unsigned Analog_Value_Instance_To_Index(uint32_t object_instance)
 {
-    unsigned index = MAX_ANALOG_VALUES;
-
-    if (object_instance < MAX_ANALOG_VALUES) {
-        index = object_instance;
-    }
-
-    return index;
+    return Keytable_Index(&AV_Table, object_instance);
 }
 
 /**
@@ -205,17 +395,19 @@ static void Analog_Value_COV_Detect(unsigned int index, float value)
     float cov_increment = 0.0;
     float cov_delta = 0.0;
 
-    if (index < MAX_ANALOG_VALUES) {
-        prior_value = AV_Descr[index].Prior_Value;
-        cov_increment = AV_Descr[index].COV_Increment;
+    if (index < Keytable_Count(&AV_Table)) {
+        prior_value = AV_Prior_Value[index];
+        cov_increment = AV_COV_Increment[index];
         if (prior_value > value) {
             cov_delta = prior_value - value;
         } else {
             cov_delta = value - prior_value;
         }
         if (cov_delta >= cov_increment) {
-            AV_Descr[index].Changed = true;
-            AV_Descr[index].Prior_Value = value;
+            AV_Changed[index] = true;
+            AV_Prior_Value[index] = value;
+            cov_change_detected_notify(
+                OBJECT_ANALOG_VALUE, Analog_Value_Index_To_Instance(index));
         }
     }
 }
@@ -237,9 +429,12 @@ bool Analog_Value_Present_Value_Set(
     bool status = false;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
+    if (index < Keytable_Count(&AV_Table)) {
         Analog_Value_COV_Detect(index, value);
-        AV_Descr[index].Present_Value = value;
+        AV_Present_Value[index] = value;
+#if defined(INTRINSIC_REPORTING)
+        Analog_Value_Reporting_Request(index);
+#endif
         status = true;
     }
     return status;
@@ -258,8 +453,8 @@ float Analog_Value_Present_Value(uint32_t object_instance)
     unsigned index = 0;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        value = AV_Descr[index].Present_Value;
+    if (index < Keytable_Count(&AV_Table)) {
+        value = AV_Present_Value[index];
     }
 
     return value;
@@ -278,10 +473,10 @@ float Analog_Value_Present_Value(uint32_t object_instance)
 bool Analog_Value_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
-    if (object_instance < MAX_ANALOG_VALUES) {
+    if (Analog_Value_Valid_Instance(object_instance)) {
         sprintf(
             text_string, "ANALOG VALUE %lu", (unsigned long)object_instance);
         status = characterstring_init_ansi(object_name, text_string);
@@ -304,7 +499,7 @@ unsigned Analog_Value_Event_State(uint32_t object_instance)
 
 #if defined(INTRINSIC_REPORTING)
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
+    if (index < Keytable_Count(&AV_Table)) {
         state = AV_Descr[index].Event_State;
     }
 #endif
@@ -326,8 +521,8 @@ bool Analog_Value_Change_Of_Value(uint32_t object_instance)
     bool changed = false;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        changed = AV_Descr[index].Changed;
+    if (index < Keytable_Count(&AV_Table)) {
+        changed = AV_Changed[index];
     }
 
     return changed;
@@ -343,8 +538,8 @@ void Analog_Value_Change_Of_Value_Clear(uint32_t object_instance)
     unsigned index = 0;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        AV_Descr[index].Changed = false;
+    if (index < Keytable_Count(&AV_Table)) {
+        AV_Changed[index] = false;
     }
 }
 
@@ -411,8 +606,8 @@ float Analog_Value_COV_Increment(uint32_t object_instance)
     float value = 0;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        value = AV_Descr[index].COV_Increment;
+    if (index < Keytable_Count(&AV_Table)) {
+        value = AV_COV_Increment[index];
     }
 
     return value;
@@ -423,9 +618,9 @@ void Analog_Value_COV_Increment_Set(uint32_t object_instance, float value)
     unsigned index = 0;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        AV_Descr[index].COV_Increment = value;
-        Analog_Value_COV_Detect(index, AV_Descr[index].Present_Value);
+    if (index < Keytable_Count(&AV_Table)) {
+        AV_COV_Increment[index] = value;
+        Analog_Value_COV_Detect(index, AV_Present_Value[index]);
     }
 }
 
@@ -435,8 +630,8 @@ bool Analog_Value_Out_Of_Service(uint32_t object_instance)
     bool value = false;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        value = AV_Descr[index].Out_Of_Service;
+    if (index < Keytable_Count(&AV_Table)) {
+        value = AV_Out_Of_Service[index];
     }
 
     return value;
@@ -447,11 +642,12 @@ void Analog_Value_Out_Of_Service_Set(uint32_t object_instance, bool value)
     unsigned index = 0;
 
     index = Analog_Value_Instance_To_Index(object_instance);
-    if (index < MAX_ANALOG_VALUES) {
-        if (AV_Descr[index].Out_Of_Service != value) {
-            AV_Descr[index].Changed = true;
+    if (index < Keytable_Count(&AV_Table)) {
+        if (AV_Out_Of_Service[index] != value) {
+            AV_Changed[index] = true;
+            cov_change_detected_notify(OBJECT_ANALOG_VALUE, object_instance);
         }
-        AV_Descr[index].Out_Of_Service = value;
+        AV_Out_Of_Service[index] = value;
     }
 }
 
@@ -489,7 +685,7 @@ int Analog_Value_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
     apdu = rpdata->application_data;
 
     object_index = Analog_Value_Instance_To_Index(rpdata->object_instance);
-    if (object_index >= MAX_ANALOG_VALUES) {
+    if (object_index >= Keytable_Count(&AV_Table)) {
         rpdata->error_class = ERROR_CLASS_OBJECT;
         rpdata->error_code = ERROR_CODE_UNKNOWN_OBJECT;
         return BACNET_STATUS_ERROR;
@@ -530,7 +726,7 @@ int Analog_Value_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
             bitstring_set_bit(&bit_string, STATUS_FLAG_FAULT, false);
             bitstring_set_bit(&bit_string, STATUS_FLAG_OVERRIDDEN, false);
             bitstring_set_bit(&bit_string, STATUS_FLAG_OUT_OF_SERVICE,
-                CurrentAV->Out_Of_Service);
+                AV_Out_Of_Service[object_index]);
 
             apdu_len = encode_application_bitstring(&apdu[0], &bit_string);
             break;
@@ -546,7 +742,7 @@ int Analog_Value_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
             break;
 
         case PROP_OUT_OF_SERVICE:
-            state = CurrentAV->Out_Of_Service;
+            state = AV_Out_Of_Service[object_index];
             apdu_len = encode_application_boolean(&apdu[0], state);
             break;
 
@@ -557,7 +753,7 @@ int Analog_Value_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
 
         case PROP_COV_INCREMENT:
             apdu_len =
-                encode_application_real(&apdu[0], CurrentAV->COV_Increment);
+                encode_application_real(&apdu[0], AV_COV_Increment[object_index]);
             break;
 
 #if defined(INTRINSIC_REPORTING)
@@ -735,7 +931,7 @@ bool Analog_Value_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
 
     /* Valid object? */
     object_index = Analog_Value_Instance_To_Index(wp_data->object_instance);
-    if (object_index >= MAX_ANALOG_VALUES) {
+    if (object_index >= Keytable_Count(&AV_Table)) {
         wp_data->error_class = ERROR_CLASS_OBJECT;
         wp_data->error_code = ERROR_CODE_UNKNOWN_OBJECT;
         return false;
@@ -775,7 +971,7 @@ bool Analog_Value_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             status = write_property_type_valid(wp_data, &value,
                 BACNET_APPLICATION_TAG_BOOLEAN);
             if (status) {
-                CurrentAV->Out_Of_Service = value.type.Boolean;
+                AV_Out_Of_Service[object_index] = value.type.Boolean;
             }
             break;
 
@@ -808,7 +1004,7 @@ bool Analog_Value_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
                 BACNET_APPLICATION_TAG_UNSIGNED_INT);
             if (status) {
                 CurrentAV->Time_Delay = value.type.Unsigned_Int;
-                CurrentAV->Remaining_Time_Delay = CurrentAV->Time_Delay;
+                CurrentAV->Time_Delay_Running = false;
             }
             break;
 
@@ -913,6 +1109,13 @@ bool Analog_Value_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             break;
     }
 
+#if defined(INTRINSIC_REPORTING)
+    if (status) {
+        /* the limits or the event algorithm may have changed */
+        Analog_Value_Reporting_Request(object_index);
+    }
+#endif
+
     return status;
 }
 
@@ -930,10 +1133,11 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
     bool SendNotify = false;
 
     object_index = Analog_Value_Instance_To_Index(object_instance);
-    if (object_index < MAX_ANALOG_VALUES)
+    if (object_index < Keytable_Count(&AV_Table))
         CurrentAV = &AV_Descr[object_index];
     else
         return;
+    CurrentAV->Reporting_Queued = false;
 
     /* check limits */
     if (!CurrentAV->Limit_Enable)
@@ -942,6 +1146,8 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
     if (CurrentAV->Ack_notify_data.bSendAckNotify) {
         /* clean bSendAckNotify flag */
         CurrentAV->Ack_notify_data.bSendAckNotify = false;
+        /* the limits are evaluated on the next pass */
+        Analog_Value_Reporting_Request(object_index);
         /* copy toState */
         ToState = CurrentAV->Ack_notify_data.EventState;
 
@@ -975,10 +1181,8 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_HIGH_LIMIT_ENABLE) &&
                     ((CurrentAV->Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ==
                         EVENT_ENABLE_TO_OFFNORMAL)) {
-                    if (!CurrentAV->Remaining_Time_Delay)
+                    if (Analog_Value_Time_Delay(object_index))
                         CurrentAV->Event_State = EVENT_STATE_HIGH_LIMIT;
-                    else
-                        CurrentAV->Remaining_Time_Delay--;
                     break;
                 }
 
@@ -994,14 +1198,12 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_LOW_LIMIT_ENABLE) &&
                     ((CurrentAV->Event_Enable & EVENT_ENABLE_TO_OFFNORMAL) ==
                         EVENT_ENABLE_TO_OFFNORMAL)) {
-                    if (!CurrentAV->Remaining_Time_Delay)
+                    if (Analog_Value_Time_Delay(object_index))
                         CurrentAV->Event_State = EVENT_STATE_LOW_LIMIT;
-                    else
-                        CurrentAV->Remaining_Time_Delay--;
                     break;
                 }
                 /* value of the object is still in the same event state */
-                CurrentAV->Remaining_Time_Delay = CurrentAV->Time_Delay;
+                CurrentAV->Time_Delay_Running = false;
                 break;
 
             case EVENT_STATE_HIGH_LIMIT:
@@ -1019,14 +1221,12 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_HIGH_LIMIT_ENABLE) &&
                     ((CurrentAV->Event_Enable & EVENT_ENABLE_TO_NORMAL) ==
                         EVENT_ENABLE_TO_NORMAL)) {
-                    if (!CurrentAV->Remaining_Time_Delay)
+                    if (Analog_Value_Time_Delay(object_index))
                         CurrentAV->Event_State = EVENT_STATE_NORMAL;
-                    else
-                        CurrentAV->Remaining_Time_Delay--;
                     break;
                 }
                 /* value of the object is still in the same event state */
-                CurrentAV->Remaining_Time_Delay = CurrentAV->Time_Delay;
+                CurrentAV->Time_Delay_Running = false;
                 break;
 
             case EVENT_STATE_LOW_LIMIT:
@@ -1044,14 +1244,12 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
                         EVENT_LOW_LIMIT_ENABLE) &&
                     ((CurrentAV->Event_Enable & EVENT_ENABLE_TO_NORMAL) ==
                         EVENT_ENABLE_TO_NORMAL)) {
-                    if (!CurrentAV->Remaining_Time_Delay)
+                    if (Analog_Value_Time_Delay(object_index))
                         CurrentAV->Event_State = EVENT_STATE_NORMAL;
-                    else
-                        CurrentAV->Remaining_Time_Delay--;
                     break;
                 }
                 /* value of the object is still in the same event state */
-                CurrentAV->Remaining_Time_Delay = CurrentAV->Time_Delay;
+                CurrentAV->Time_Delay_Running = false;
                 break;
 
             default:
@@ -1177,7 +1375,7 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
                 STATUS_FLAG_OVERRIDDEN, false);
             bitstring_set_bit(
                 &event_data.notificationParams.outOfRange.statusFlags,
-                STATUS_FLAG_OUT_OF_SERVICE, CurrentAV->Out_Of_Service);
+                STATUS_FLAG_OUT_OF_SERVICE, AV_Out_Of_Service[object_index]);
             /* Deadband used for limit checking. */
             event_data.notificationParams.outOfRange.deadband =
                 CurrentAV->Deadband;
@@ -1221,6 +1419,7 @@ void Analog_Value_Intrinsic_Reporting(uint32_t object_instance)
             }
         }
     }
+    Analog_Value_Event_Index_Update(object_index);
 #endif /* defined(INTRINSIC_REPORTING) */
 }
 
@@ -1233,7 +1432,7 @@ int Analog_Value_Event_Information(
     int i;
 
     /* check index */
-    if (index < MAX_ANALOG_VALUES) {
+    if (index < Keytable_Count(&AV_Table)) {
         /* Event_State not equal to NORMAL */
         IsActiveEvent = (AV_Descr[index].Event_State != EVENT_STATE_NORMAL);
 
@@ -1307,7 +1506,7 @@ int Analog_Value_Alarm_Ack(
     object_index = Analog_Value_Instance_To_Index(
         alarmack_data->eventObjectIdentifier.instance);
 
-    if (object_index < MAX_ANALOG_VALUES)
+    if (object_index < Keytable_Count(&AV_Table))
         CurrentAV = &AV_Descr[object_index];
     else {
         *error_code = ERROR_CODE_UNKNOWN_OBJECT;
@@ -1402,6 +1601,8 @@ int Analog_Value_Alarm_Ack(
             return -2;
     }
 
+    Analog_Value_Event_Index_Update(object_index);
+    Analog_Value_Reporting_Request(object_index);
     /* Need to send AckNotification. */
     CurrentAV->Ack_notify_data.bSendAckNotify = true;
     CurrentAV->Ack_notify_data.EventState = alarmack_data->eventStateAcked;
@@ -1414,7 +1615,7 @@ int Analog_Value_Alarm_Summary(
     unsigned index, BACNET_GET_ALARM_SUMMARY_DATA *getalarm_data)
 {
     /* check index */
-    if (index < MAX_ANALOG_VALUES) {
+    if (index < Keytable_Count(&AV_Table)) {
         /* Event_State is not equal to NORMAL  and
            Notify_Type property value is ALARM */
         if ((AV_Descr[index].Event_State != EVENT_STATE_NORMAL) &&
@@ -44,14 +44,11 @@
 extern "C" {
 #endif /* __cplusplus */
 
+    /* the properties of an object that are not often used -
+       Present_Value, Out_Of_Service and the COV data are kept apart */
     typedef struct analog_value_descr {
         unsigned Event_State:3;
-        bool Out_Of_Service;
         uint16_t Units;
-        float Present_Value;
-        float Prior_Value;
-        float COV_Increment;
-        bool Changed;
 #if defined(INTRINSIC_REPORTING)
         uint32_t Time_Delay;
         uint32_t Notification_Class;
@@ -63,8 +60,14 @@ extern "C" {
         unsigned Notify_Type:1;
         ACKED_INFO Acked_Transitions[MAX_BACNET_EVENT_TRANSITION];
         BACNET_DATE_TIME Event_Time_Stamps[MAX_BACNET_EVENT_TRANSITION];
-        /* time to generate event notification */
-        uint32_t Remaining_Time_Delay;
+        /* second that the time delay of an event state transition
+           expires, while the conditions of the transition are met */
+        uint32_t Time_Delay_Expires;
+        bool Time_Delay_Running;
+        /* true if a timer evaluates the object when the delay expires */
+        bool Time_Delay_Timer;
+        /* true while the object waits to be evaluated */
+        bool Reporting_Queued;
         /* AckNotification informations */
         ACK_NOTIFICATION Ack_notify_data;
 #endif
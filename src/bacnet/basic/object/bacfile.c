@@ -47,15 +47,32 @@
 typedef struct {
     uint32_t instance;
     char *filename;
+    /* the file stays open between requests */
+    FILE *pFile;
+    /* false if the open file can only be read */
+    bool writable;
+    /* where each record (line) starts, as far as the file has been read */
+    long *record_offset;
+    uint32_t record_count;
+    uint32_t record_size;
+    /* true if the last record offset is the end of the file */
+    bool record_end;
 } BACNET_FILE_LISTING;
 
 #ifndef FILE_RECORD_SIZE
 #define FILE_RECORD_SIZE MAX_OCTET_STRING_BYTES
 #endif
 
+/* number of record offsets first kept for a file, doubled as needed */
+#ifndef FILE_RECORD_INDEX_BLOCK
+#define FILE_RECORD_INDEX_BLOCK 64
+#endif
+
 static BACNET_FILE_LISTING BACnet_File_Listing[] = {
-    { 0, "temp_0.txt" }, { 1, "temp_1.txt" }, { 2, "temp_2.txt" },
-    { 0, NULL } /* last file indication */
+    { .instance = 0, .filename = "temp_0.txt" },
+    { .instance = 1, .filename = "temp_1.txt" },
+    { .instance = 2, .filename = "temp_2.txt" },
+    { .instance = 0, .filename = NULL } /* last file indication */
 };
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
@@ -84,20 +101,31 @@ void BACfile_Property_Lists(
     return;
 }
 
-static char *bacfile_name(uint32_t instance)
+static BACNET_FILE_LISTING *bacfile_listing(uint32_t instance)
 {
     uint32_t index = 0;
-    char *filename = NULL;
 
     /* linear search for file instance match */
     while (BACnet_File_Listing[index].filename) {
         if (BACnet_File_Listing[index].instance == instance) {
-            filename = BACnet_File_Listing[index].filename;
-            break;
+            return &BACnet_File_Listing[index];
         }
         index++;
     }
 
+    return NULL;
+}
+
+static char *bacfile_name(uint32_t instance)
+{
+    BACNET_FILE_LISTING *file = NULL;
+    char *filename = NULL;
+
+    file = bacfile_listing(instance);
+    if (file) {
+        filename = file->filename;
+    }
+
     return filename;
 }
 
@@ -163,6 +191,166 @@ static long fsize(FILE *pFile)
     return (size);
 }
 
+/**
+ * @brief Close the file of a File object, and forget its records
+ * @param file - File object
+ */
+static void bacfile_close(BACNET_FILE_LISTING *file)
+{
+    if (file->pFile) {
+        fclose(file->pFile);
+        file->pFile = NULL;
+    }
+    free(file->record_offset);
+    file->record_offset = NULL;
+    file->record_count = 0;
+    file->record_size = 0;
+    file->record_end = false;
+}
+
+/**
+ * @brief Get the open file of a File object, opening it the first time
+ * @param file - File object
+ * @param write - true if the file will be written
+ * @param create - true to create the file if it does not exist
+ * @return the open file, or NULL if it could not be opened
+ */
+static FILE *bacfile_open(BACNET_FILE_LISTING *file, bool write, bool create)
+{
+    if (file->pFile && write && !file->writable) {
+        /* it was opened to be read, so try again to write it */
+        bacfile_close(file);
+    }
+    if (!file->pFile) {
+        file->writable = true;
+        file->pFile = fopen(file->filename, "rb+");
+        if (!file->pFile && create) {
+            file->pFile = fopen(file->filename, "wb+");
+        }
+        if (!file->pFile && !write) {
+            /* a file that can not be written can still be read */
+            file->pFile = fopen(file->filename, "rb");
+            file->writable = false;
+        }
+    }
+
+    return file->pFile;
+}
+
+/**
+ * @brief Forget where the records start after an octet of a file
+ *  was written.  The records that start at or before it are unchanged.
+ * @param file - File object
+ * @param position - offset of the first octet written
+ */
+static void bacfile_record_written(BACNET_FILE_LISTING *file, long position)
+{
+    uint32_t low = 1;
+    uint32_t high = file->record_count;
+    uint32_t middle;
+
+    if (file->record_end) {
+        /* the end of the file is not a record of its own once
+           octets are added to the last record */
+        high--;
+        file->record_end = false;
+    }
+    while (low < high) {
+        middle = low + ((high - low) / 2);
+        if (file->record_offset[middle] <= position) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (file->record_count > low) {
+        file->record_count = low;
+    }
+}
+
+/**
+ * @brief Find where a record of a file starts.  The records are the
+ *  lines that fgets() would read, and the offsets of the records before
+ *  it are kept, so each record of the file is only searched for once.
+ * @param file - File object with an open file
+ * @param record - record number, starting at 0
+ * @param offset - [out] where the record starts, or the end of the file
+ *  if the file has fewer records
+ * @return true if the record is in the file
+ */
+static bool bacfile_record_offset(
+    BACNET_FILE_LISTING *file, uint32_t record, long *offset)
+{
+    char buffer[256];
+    long *record_offset;
+    long start, position;
+    size_t len, limit;
+    char *newline;
+
+    if (!file->record_offset) {
+        file->record_offset = malloc(FILE_RECORD_INDEX_BLOCK * sizeof(long));
+        if (!file->record_offset) {
+            return false;
+        }
+        file->record_size = FILE_RECORD_INDEX_BLOCK;
+        file->record_offset[0] = 0;
+        file->record_count = 1;
+        file->record_end = false;
+    }
+    /* find the start of the record after it too, where it ends */
+    while ((record >= (file->record_count - 1)) && !file->record_end) {
+        start = file->record_offset[file->record_count - 1];
+        if (fseek(file->pFile, start, SEEK_SET) != 0) {
+            return false;
+        }
+        position = start;
+        for (;;) {
+            limit = (FILE_RECORD_SIZE - 1) - (size_t)(position - start);
+            if (limit == 0) {
+                break;
+            }
+            if (limit > sizeof(buffer)) {
+                limit = sizeof(buffer);
+            }
+            len = fread(buffer, 1, limit, file->pFile);
+            if (len == 0) {
+                break;
+            }
+            newline = memchr(buffer, '\n', len);
+            if (newline) {
+                position += (long)(newline - buffer) + 1;
+                break;
+            }
+            position += (long)len;
+        }
+        if (position == start) {
+            /* no more records */
+            file->record_end = true;
+            break;
+        }
+        if (file->record_count == file->record_size) {
+            record_offset = realloc(file->record_offset,
+                file->record_size * 2 * sizeof(long));
+            if (!record_offset) {
+                return false;
+            }
+            file->record_offset = record_offset;
+            file->record_size *= 2;
+        }
+        file->record_offset[file->record_count++] = position;
+    }
+    if (record < (file->record_count - 1)) {
+        *offset = file->record_offset[record];
+        return true;
+    }
+    *offset = file->record_offset[file->record_count - 1];
+
+    return false;
+}
+
+/* The size is read through a file of its own, since ReadProperty may run
+   on several threads, and the open file of the File object is only used
+   by AtomicReadFile and AtomicWriteFile, one request at a time. */
 BACNET_UNSIGNED_INTEGER bacfile_file_size(uint32_t object_instance)
 {
     char *pFilename = NULL;
@@ -416,15 +604,15 @@ uint32_t bacfile_instance_from_tsm(uint8_t invokeID)
 
 bool bacfile_read_stream_data(BACNET_ATOMIC_READ_FILE_DATA *data)
 {
-    char *pFilename = NULL;
+    BACNET_FILE_LISTING *file = NULL;
     bool found = false;
     FILE *pFile = NULL;
     size_t len = 0;
 
-    pFilename = bacfile_name(data->object_instance);
-    if (pFilename) {
+    file = bacfile_listing(data->object_instance);
+    if (file) {
         found = true;
-        pFile = fopen(pFilename, "rb");
+        pFile = bacfile_open(file, false, false);
         if (pFile) {
             (void)fseek(pFile, data->type.stream.fileStartPosition, SEEK_SET);
             len = fread(octetstring_value(&data->fileData[0]), 1,
@@ -435,7 +623,6 @@ bool bacfile_read_stream_data(BACNET_ATOMIC_READ_FILE_DATA *data)
                 data->endOfFile = false;
             }
             octetstring_truncate(&data->fileData[0], len);
-            fclose(pFile);
         } else {
             octetstring_truncate(&data->fileData[0], 0);
             data->endOfFile = true;
@@ -448,87 +635,173 @@ bool bacfile_read_stream_data(BACNET_ATOMIC_READ_FILE_DATA *data)
     return found;
 }
 
-bool bacfile_write_stream_data(BACNET_ATOMIC_WRITE_FILE_DATA *data)
+bool bacfile_read_record_data(BACNET_ATOMIC_READ_FILE_DATA *data)
 {
-    char *pFilename = NULL;
+    BACNET_FILE_LISTING *file = NULL;
     bool found = false;
     FILE *pFile = NULL;
+    uint32_t record = 0;
+    uint32_t i = 0;
+    long start = 0, end = 0;
+    size_t len = 0;
 
-    pFilename = bacfile_name(data->object_instance);
-    if (pFilename) {
+    file = bacfile_listing(data->object_instance);
+    if (file && (data->type.record.fileStartRecord >= 0)) {
         found = true;
-        if (data->type.stream.fileStartPosition == 0) {
-            /* open the file as a clean slate when starting at 0 */
-            pFile = fopen(pFilename, "wb");
-        } else if (data->type.stream.fileStartPosition == -1) {
+        record = (uint32_t)data->type.record.fileStartRecord;
+        pFile = bacfile_open(file, false, false);
+        if (pFile) {
+            while ((i < data->type.record.RecordCount) &&
+                (i < BACNET_READ_FILE_RECORD_COUNT)) {
+                if (!bacfile_record_offset(file, record + i, &start)) {
+                    break;
+                }
+                if (!bacfile_record_offset(file, record + i + 1, &end) &&
+                    !file->record_end) {
+                    /* where the record ends is not known */
+                    break;
+                }
+                if (fseek(pFile, start, SEEK_SET) != 0) {
+                    break;
+                }
+                len = (size_t)(end - start);
+                if (len > MAX_OCTET_STRING_BYTES) {
+                    len = MAX_OCTET_STRING_BYTES;
+                }
+                len = fread(
+                    octetstring_value(&data->fileData[i]), 1, len, pFile);
+                octetstring_truncate(&data->fileData[i], len);
+                i++;
+            }
+            data->endOfFile = !bacfile_record_offset(file, record + i, &start);
+        } else {
+            data->endOfFile = true;
+        }
+        data->type.record.RecordCount = i;
+    }
+
+    return found;
+}
+
+/**
+ * @brief Write octets to the file of a File object
+ * @param file - File object
+ * @param position - where to write, or -1 to append to the end of
+ *  the file.  Writing at 0 starts the file again.
+ * @param octets - octets to write
+ */
+static void bacfile_write_stream(
+    BACNET_FILE_LISTING *file, int32_t position, BACNET_OCTET_STRING *octets)
+{
+    FILE *pFile = NULL;
+
+    if (position == 0) {
+        /* open the file as a clean slate when starting at 0 */
+        bacfile_close(file);
+        pFile = fopen(file->filename, "wb+");
+        file->pFile = pFile;
+        file->writable = true;
+    } else {
+        pFile = bacfile_open(file, true, (position == -1));
+    }
+    if (pFile) {
+        if (position == -1) {
             /* If 'File Start Position' parameter has the special
                value -1, then the write operation shall be treated
                as an append to the current end of file. */
-            pFile = fopen(pFilename, "ab+");
+            (void)fseek(pFile, 0L, SEEK_END);
         } else {
-            /* open for update */
-            pFile = fopen(pFilename, "rb+");
+            (void)fseek(pFile, position, SEEK_SET);
         }
-        if (pFile) {
-            if (data->type.stream.fileStartPosition != -1) {
-                (void)fseek(
-                    pFile, data->type.stream.fileStartPosition, SEEK_SET);
-            }
-            if (fwrite(octetstring_value(&data->fileData[0]),
-                    octetstring_length(&data->fileData[0]), 1, pFile) != 1) {
-                /* do something if it fails? */
-            }
-            fclose(pFile);
+        bacfile_record_written(file, ftell(pFile));
+        if (fwrite(octetstring_value(octets), octetstring_length(octets), 1,
+                pFile) != 1) {
+            /* do something if it fails? */
         }
+        fflush(pFile);
     }
-
-    return found;
 }
 
-bool bacfile_write_record_data(BACNET_ATOMIC_WRITE_FILE_DATA *data)
+/**
+ * @brief Write records to the file of a File object, over the records
+ *  from the one given
+ * @param file - File object
+ * @param record - first record to write, or -1 to append to the end of
+ *  the file.  Writing at 0 starts the file again.
+ * @param records - records to write
+ * @param count - number of records to write
+ */
+static void bacfile_write_records(BACNET_FILE_LISTING *file,
+    int32_t record,
+    BACNET_OCTET_STRING *records,
+    uint32_t count)
 {
-    char *pFilename = NULL;
-    bool found = false;
     FILE *pFile = NULL;
+    long position = 0;
     uint32_t i = 0;
-    char dummy_data[FILE_RECORD_SIZE];
-    char *pData = NULL;
 
-    pFilename = bacfile_name(data->object_instance);
-    if (pFilename) {
-        found = true;
-        if (data->type.record.fileStartRecord == 0) {
-            /* open the file as a clean slate when starting at 0 */
-            pFile = fopen(pFilename, "wb");
-        } else if (data->type.record.fileStartRecord == -1) {
+    if (record == 0) {
+        /* open the file as a clean slate when starting at 0 */
+        bacfile_close(file);
+        pFile = fopen(file->filename, "wb+");
+        file->pFile = pFile;
+        file->writable = true;
+    } else {
+        pFile = bacfile_open(file, true, (record == -1));
+    }
+    if (pFile) {
+        if (record == -1) {
             /* If 'File Start Record' parameter has the special
                value -1, then the write operation shall be treated
                as an append to the current end of file. */
-            pFile = fopen(pFilename, "ab+");
-        } else {
-            /* open for update */
-            pFile = fopen(pFilename, "rb+");
+            (void)fseek(pFile, 0L, SEEK_END);
+            position = ftell(pFile);
+        } else if (record > 0) {
+            /* past the end of the file, the records are appended */
+            (void)bacfile_record_offset(file, (uint32_t)record, &position);
         }
-        if (pFile) {
-            if ((data->type.record.fileStartRecord != -1) &&
-                (data->type.record.fileStartRecord > 0)) {
-                for (i = 0; i < (uint32_t)data->type.record.fileStartRecord;
-                     i++) {
-                    pData = fgets(&dummy_data[0], sizeof(dummy_data), pFile);
-                    if ((pData == NULL) || feof(pFile)) {
-                        break;
-                    }
-                }
-            }
-            for (i = 0; i < data->type.record.returnedRecordCount; i++) {
-                if (fwrite(octetstring_value(&data->fileData[i]),
-                        octetstring_length(&data->fileData[i]), 1,
-                        pFile) != 1) {
-                    /* do something if it fails? */
-                }
+        (void)fseek(pFile, position, SEEK_SET);
+        bacfile_record_written(file, position);
+        for (i = 0; i < count; i++) {
+            if (fwrite(octetstring_value(&records[i]),
+                    octetstring_length(&records[i]), 1, pFile) != 1) {
+                /* do something if it fails? */
             }
-            fclose(pFile);
         }
+        fflush(pFile);
+    }
+}
+
+bool bacfile_write_stream_data(BACNET_ATOMIC_WRITE_FILE_DATA *data)
+{
+    BACNET_FILE_LISTING *file = NULL;
+    bool found = false;
+
+    file = bacfile_listing(data->object_instance);
+    if (file) {
+        found = true;
+        bacfile_write_stream(
+            file, data->type.stream.fileStartPosition, &data->fileData[0]);
+    }
+
+    return found;
+}
+
+bool bacfile_write_record_data(BACNET_ATOMIC_WRITE_FILE_DATA *data)
+{
+    BACNET_FILE_LISTING *file = NULL;
+    bool found = false;
+    uint32_t count = 0;
+
+    file = bacfile_listing(data->object_instance);
+    if (file) {
+        found = true;
+        count = data->type.record.returnedRecordCount;
+        if (count > BACNET_WRITE_FILE_RECORD_COUNT) {
+            count = BACNET_WRITE_FILE_RECORD_COUNT;
+        }
+        bacfile_write_records(
+            file, data->type.record.fileStartRecord, &data->fileData[0], count);
     }
 
     return found;
@@ -537,25 +810,14 @@ bool bacfile_write_record_data(BACNET_ATOMIC_WRITE_FILE_DATA *data)
 bool bacfile_read_ack_stream_data(
     uint32_t instance, BACNET_ATOMIC_READ_FILE_DATA *data)
 {
+    BACNET_FILE_LISTING *file = NULL;
     bool found = false;
-    FILE *pFile = NULL;
-    char *pFilename = NULL;
 
-    pFilename = bacfile_name(instance);
-    if (pFilename) {
+    file = bacfile_listing(instance);
+    if (file) {
         found = true;
-        pFile = fopen(pFilename, "rb");
-        if (pFile) {
-            (void)fseek(pFile, data->type.stream.fileStartPosition, SEEK_SET);
-            if (fwrite(octetstring_value(&data->fileData[0]),
-                    octetstring_length(&data->fileData[0]), 1, pFile) != 1) {
-#if PRINT_ENABLED
-                fprintf(stderr, "Failed to write to %s (%lu)!\n", pFilename,
-                    (unsigned long)instance);
-#endif
-            }
-            fclose(pFile);
-        }
+        bacfile_write_stream(
+            file, data->type.stream.fileStartPosition, &data->fileData[0]);
     }
 
     return found;
@@ -564,39 +826,19 @@ bool bacfile_read_ack_stream_data(
 bool bacfile_read_ack_record_data(
     uint32_t instance, BACNET_ATOMIC_READ_FILE_DATA *data)
 {
+    BACNET_FILE_LISTING *file = NULL;
     bool found = false;
-    FILE *pFile = NULL;
-    char *pFilename = NULL;
-    uint32_t i = 0;
-    char dummy_data[MAX_OCTET_STRING_BYTES] = { 0 };
-    char *pData = NULL;
+    uint32_t count = 0;
 
-    pFilename = bacfile_name(instance);
-    if (pFilename) {
+    file = bacfile_listing(instance);
+    if (file) {
         found = true;
-        pFile = fopen(pFilename, "rb");
-        if (pFile) {
-            if (data->type.record.fileStartRecord > 0) {
-                for (i = 0; i < (uint32_t)data->type.record.fileStartRecord;
-                     i++) {
-                    pData = fgets(&dummy_data[0], sizeof(dummy_data), pFile);
-                    if ((pData == NULL) || feof(pFile)) {
-                        break;
-                    }
-                }
-            }
-            for (i = 0; i < data->type.record.RecordCount; i++) {
-                if (fwrite(octetstring_value(&data->fileData[i]),
-                        octetstring_length(&data->fileData[i]), 1,
-                        pFile) != 1) {
-#if PRINT_ENABLED
-                    fprintf(stderr, "Failed to write to %s (%lu)!\n", pFilename,
-                        (unsigned long)instance);
-#endif
-                }
-            }
-            fclose(pFile);
+        count = BACNET_READ_FILE_RECORD_COUNT;
+        if (data->type.record.RecordCount < count) {
+            count = (uint32_t)data->type.record.RecordCount;
         }
+        bacfile_write_records(
+            file, data->type.record.fileStartRecord, &data->fileData[0], count);
     }
 
     return found;
@@ -605,3 +847,17 @@ bool bacfile_read_ack_record_data(
 void bacfile_init(void)
 {
 }
+
+/**
+ * @brief Close the files of the File objects, for example so that they
+ *  can be changed by another program
+ */
+void bacfile_cleanup(void)
+{
+    uint32_t index = 0;
+
+    while (BACnet_File_Listing[index].filename) {
+        bacfile_close(&BACnet_File_Listing[index]);
+        index++;
+    }
+}
@@ -109,6 +109,9 @@ extern "C" {
     void bacfile_init(
         void);
     BACNET_STACK_EXPORT
+    void bacfile_cleanup(
+        void);
+    BACNET_STACK_EXPORT
     BACNET_UNSIGNED_INTEGER bacfile_file_size(
         uint32_t instance);
 
@@ -262,6 +262,7 @@ bool Binary_Input_Present_Value_Set(
         }
         if (Present_Value[index] != value) {
             Change_Of_Value[index] = true;
+            cov_change_detected_notify(OBJECT_BINARY_INPUT, object_instance);
         }
         Present_Value[index] = value;
         status = true;
@@ -278,6 +279,7 @@ void Binary_Input_Out_Of_Service_Set(uint32_t object_instance, bool value)
     if (index < MAX_BINARY_INPUTS) {
         if (Out_Of_Service[index] != value) {
             Change_Of_Value[index] = true;
+            cov_change_detected_notify(OBJECT_BINARY_INPUT, object_instance);
         }
         Out_Of_Service[index] = value;
     }
@@ -288,7 +290,7 @@ void Binary_Input_Out_Of_Service_Set(uint32_t object_instance, bool value)
 bool Binary_Input_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
     unsigned index = 0;
 
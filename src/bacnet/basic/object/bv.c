@@ -209,7 +209,7 @@ BACNET_BINARY_PV Binary_Value_Present_Value(uint32_t object_instance)
 bool Binary_Value_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
     if (object_instance < MAX_BINARY_VALUES) {
@@ -134,6 +134,10 @@ static object_functions_t Object_Table[] = {
         NULL /* COV */, NULL /* COV Clear */,
         NULL /* Intrinsic Reporting */ }
 };
+/* the entry of Object_Table for each standard object type,
+   built by Device_Init(); until then, Object_Table is searched */
+static object_functions_t *Object_Type_Table[OBJECT_PROPRIETARY_MIN];
+static bool Object_Type_Table_Valid;
 
 /** Glue function to let the Device object, when called by a handler,
  * lookup which Object type needs to be invoked.
@@ -148,6 +152,10 @@ static struct object_functions *Device_Objects_Find_Functions(
 {
     struct object_functions *pObject = NULL;
 
+    if (Object_Type_Table_Valid && (Object_Type < OBJECT_PROPRIETARY_MIN)) {
+        return Object_Type_Table[Object_Type];
+    }
+    /* proprietary object types are not in the dispatch table */
     pObject = &Object_Table[0];
     while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
         /* handle each object type */
@@ -161,6 +169,27 @@ static struct object_functions *Device_Objects_Find_Functions(
     return (NULL);
 }
 
+/** Build the dispatch table of the standard object types from the
+ * Object_Table, so that the handlers find the object helper functions
+ * without a search.
+ * @ingroup ObjHelpers
+ */
+static void Device_Objects_Dispatch_Init(void)
+{
+    struct object_functions *pObject = NULL;
+
+    memset(Object_Type_Table, 0, sizeof(Object_Type_Table));
+    pObject = &Object_Table[0];
+    while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
+        if ((pObject->Object_Type < OBJECT_PROPRIETARY_MIN) &&
+            (Object_Type_Table[pObject->Object_Type] == NULL)) {
+            Object_Type_Table[pObject->Object_Type] = pObject;
+        }
+        pObject++;
+    }
+    Object_Type_Table_Valid = true;
+}
+
 /** For a given object type, returns the special property list.
  * This function is used for ReadPropertyMultiple calls which want
  * just Required, just Optional, or All properties.
@@ -496,7 +525,11 @@ uint8_t Device_Protocol_Revision(void)
 
 BACNET_SEGMENTATION Device_Segmentation_Supported(void)
 {
+#if BACNET_SEGMENTATION_ENABLED
+    return SEGMENTATION_BOTH;
+#else
     return SEGMENTATION_NONE;
+#endif
 }
 
 uint32_t Device_Database_Revision(void)
@@ -1058,6 +1091,7 @@ void Device_Init(object_functions_t *object_table)
     datetime_init();
     /* we don't use the object table passed in */
     (void)object_table;
+    Device_Objects_Dispatch_Init();
     pObject = &Object_Table[0];
     while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
         if (pObject->Object_Init) {
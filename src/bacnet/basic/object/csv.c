@@ -37,6 +37,7 @@
 #include "bacnet/rp.h"
 #include "bacnet/wp.h"
 #include "bacnet/basic/object/csv.h"
+#include "bacnet/cov.h"
 #include "bacnet/basic/services.h"
 
 /* number of demo objects */
@@ -214,6 +215,8 @@ bool CharacterString_Value_Present_Value_Set(
     if (index < MAX_CHARACTERSTRING_VALUES) {
         if (!characterstring_same(&Present_Value[index], object_name)) {
             Changed[index] = true;
+            cov_change_detected_notify(
+                OBJECT_CHARACTERSTRING_VALUE, object_instance);
         }
         status = characterstring_copy(&Present_Value[index], object_name);
     }
@@ -256,6 +259,8 @@ static void CharacterString_Value_Out_Of_Service_Set(
     if (index < MAX_CHARACTERSTRING_VALUES) {
         if (Out_Of_Service[index] != value) {
             Changed[index] = true;
+            cov_change_detected_notify(
+                OBJECT_CHARACTERSTRING_VALUE, object_instance);
         }
         Out_Of_Service[index] = value;
     }
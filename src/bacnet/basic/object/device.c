@@ -28,6 +28,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h> /* for realloc */
 #include <string.h> /* for memmove */
 #include "bacnet/bacdef.h"
 #include "bacnet/bacdcode.h"
@@ -88,6 +89,9 @@ extern bool Routed_Device_Write_Property_Local(
 
 /* may be overridden by outside table */
 static object_functions_t *Object_Table;
+/* the entry of Object_Table for each standard object type,
+   built by Device_Init() */
+static object_functions_t *Object_Type_Table[OBJECT_PROPRIETARY_MIN];
 
 static object_functions_t My_Object_Table[] = {
     { OBJECT_DEVICE, NULL /* Init - don't init Device or it will recourse! */,
@@ -281,8 +285,12 @@ static struct object_functions *Device_Objects_Find_Functions(
 {
     struct object_functions *pObject = NULL;
 
+    if (Object_Type < OBJECT_PROPRIETARY_MIN) {
+        return Object_Type_Table[Object_Type];
+    }
+    /* proprietary object types are not in the dispatch table */
     pObject = Object_Table;
-    while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
+    while (pObject && (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE)) {
         /* handle each object type */
         if (pObject->Object_Type == Object_Type) {
             return (pObject);
@@ -293,6 +301,26 @@ static struct object_functions *Device_Objects_Find_Functions(
     return (NULL);
 }
 
+/** Build the dispatch table of the standard object types from the
+ * Object_Table, so that the handlers find the object helper functions
+ * without a search.  The first entry of a type is used, as before.
+ * @ingroup ObjHelpers
+ */
+static void Device_Objects_Dispatch_Init(void)
+{
+    struct object_functions *pObject = NULL;
+
+    memset(Object_Type_Table, 0, sizeof(Object_Type_Table));
+    pObject = Object_Table;
+    while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
+        if ((pObject->Object_Type < OBJECT_PROPRIETARY_MIN) &&
+            (Object_Type_Table[pObject->Object_Type] == NULL)) {
+            Object_Type_Table[pObject->Object_Type] = pObject;
+        }
+        pObject++;
+    }
+}
+
 /** Try to find a rr_info_function helper function for the requested object
  * type.
  * @ingroup ObjIntf
@@ -378,6 +406,9 @@ static const int Device_Properties_Optional[] = {
 #endif
     PROP_DESCRIPTION, PROP_LOCAL_TIME, PROP_UTC_OFFSET, PROP_LOCAL_DATE,
     PROP_DAYLIGHT_SAVINGS_STATUS, PROP_LOCATION, PROP_ACTIVE_COV_SUBSCRIPTIONS,
+#if BACNET_SEGMENTATION_ENABLED
+    PROP_MAX_SEGMENTS_ACCEPTED, PROP_APDU_SEGMENT_TIMEOUT,
+#endif
 #if defined(BACNET_TIME_MASTER)
     PROP_TIME_SYNCHRONIZATION_RECIPIENTS, PROP_TIME_SYNCHRONIZATION_INTERVAL,
     PROP_ALIGN_INTERVALS, PROP_INTERVAL_OFFSET,
@@ -423,8 +454,8 @@ static char Description[MAX_DEV_DESC_LEN + 1] = "server";
 /* Protocol_Services_Supported - dynamically generated */
 /* Protocol_Object_Types_Supported - in RP encoding */
 /* Object_List - dynamically generated */
-/* static BACNET_SEGMENTATION Segmentation_Supported = SEGMENTATION_NONE; */
-/* static uint8_t Max_Segments_Accepted = 0; */
+/* Segmentation_Supported - BACNET_SEGMENTATION_ENABLED, not settable */
+/* Max_Segments_Accepted - MAX_SEGMENTS_ACCEPTED, not settable */
 /* VT_Classes_Supported */
 /* Active_VT_Sessions */
 static BACNET_TIME Local_Time; /* rely on OS, if there is one */
@@ -774,7 +805,11 @@ uint8_t Device_Protocol_Revision(void)
 
 BACNET_SEGMENTATION Device_Segmentation_Supported(void)
 {
+#if BACNET_SEGMENTATION_ENABLED
+    return SEGMENTATION_BOTH;
+#else
     return SEGMENTATION_NONE;
+#endif
 }
 
 uint32_t Device_Database_Revision(void)
@@ -1082,6 +1117,11 @@ int Device_Read_Property_Local(BACNET_READ_PROPERTY_DATA *rpdata)
     uint8_t *apdu = NULL;
     struct object_functions *pObject = NULL;
     bool found = false;
+    /* read into locals, since reads may run on several threads */
+    BACNET_DATE local_date = { 0 };
+    BACNET_TIME local_time = { 0 };
+    int16_t utc_offset = 0;
+    bool dst_status = false;
     uint16_t apdu_max = 0;
 
     if ((rpdata == NULL) || (rpdata->application_data == NULL) ||
@@ -1140,21 +1180,20 @@ int Device_Read_Property_Local(BACNET_READ_PROPERTY_DATA *rpdata)
                 encode_application_character_string(&apdu[0], &char_string);
             break;
         case PROP_LOCAL_TIME:
-            Update_Current_Time();
-            apdu_len = encode_application_time(&apdu[0], &Local_Time);
+            datetime_local(&local_date, &local_time, &utc_offset, &dst_status);
+            apdu_len = encode_application_time(&apdu[0], &local_time);
             break;
         case PROP_UTC_OFFSET:
-            Update_Current_Time();
-            apdu_len = encode_application_signed(&apdu[0], UTC_Offset);
+            datetime_local(&local_date, &local_time, &utc_offset, &dst_status);
+            apdu_len = encode_application_signed(&apdu[0], utc_offset);
             break;
         case PROP_LOCAL_DATE:
-            Update_Current_Time();
-            apdu_len = encode_application_date(&apdu[0], &Local_Date);
+            datetime_local(&local_date, &local_time, &utc_offset, &dst_status);
+            apdu_len = encode_application_date(&apdu[0], &local_date);
             break;
         case PROP_DAYLIGHT_SAVINGS_STATUS:
-            Update_Current_Time();
-            apdu_len =
-                encode_application_boolean(&apdu[0], Daylight_Savings_Status);
+            datetime_local(&local_date, &local_time, &utc_offset, &dst_status);
+            apdu_len = encode_application_boolean(&apdu[0], dst_status);
             break;
         case PROP_PROTOCOL_VERSION:
             apdu_len = encode_application_unsigned(
@@ -1257,6 +1296,16 @@ int Device_Read_Property_Local(BACNET_READ_PROPERTY_DATA *rpdata)
         case PROP_NUMBER_OF_APDU_RETRIES:
             apdu_len = encode_application_unsigned(&apdu[0], apdu_retries());
             break;
+#if BACNET_SEGMENTATION_ENABLED
+        case PROP_MAX_SEGMENTS_ACCEPTED:
+            apdu_len =
+                encode_application_unsigned(&apdu[0], MAX_SEGMENTS_ACCEPTED);
+            break;
+        case PROP_APDU_SEGMENT_TIMEOUT:
+            apdu_len =
+                encode_application_unsigned(&apdu[0], apdu_segment_timeout());
+            break;
+#endif
         case PROP_DEVICE_ADDRESS_BINDING:
             apdu_len = address_list_encode(&apdu[0], apdu_max);
             break;
@@ -1423,6 +1472,15 @@ bool Device_Write_Property_Local(BACNET_WRITE_PROPERTY_DATA *wp_data)
                 apdu_timeout_set((uint16_t)value.type.Unsigned_Int);
             }
             break;
+#if BACNET_SEGMENTATION_ENABLED
+        case PROP_APDU_SEGMENT_TIMEOUT:
+            status = write_property_type_valid(wp_data, &value,
+                BACNET_APPLICATION_TAG_UNSIGNED_INT);
+            if (status) {
+                apdu_segment_timeout_set((uint16_t)value.type.Unsigned_Int);
+            }
+            break;
+#endif
         case PROP_VENDOR_IDENTIFIER:
             status = write_property_type_valid(wp_data, &value,
                 BACNET_APPLICATION_TAG_UNSIGNED_INT);
@@ -1608,6 +1666,9 @@ bool Device_Write_Property_Local(BACNET_WRITE_PROPERTY_DATA *wp_data)
         case PROP_OBJECT_LIST:
         case PROP_MAX_APDU_LENGTH_ACCEPTED:
         case PROP_SEGMENTATION_SUPPORTED:
+#if BACNET_SEGMENTATION_ENABLED
+        case PROP_MAX_SEGMENTS_ACCEPTED:
+#endif
         case PROP_DEVICE_ADDRESS_BINDING:
         case PROP_DATABASE_REVISION:
         case PROP_ACTIVE_COV_SUBSCRIPTIONS:
@@ -1747,29 +1808,259 @@ void Device_COV_Clear(BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
 }
 
 #if defined(INTRINSIC_REPORTING)
+/* Intrinsic reporting is driven by the objects: they ask for their event
+   state to be evaluated when their Present_Value or event properties
+   change, and when the time delay of a transition is due.  The objects
+   waiting to be evaluated are queued, and the time delays are kept on a
+   timer wheel that turns once a second. */
+#ifndef INTRINSIC_REPORTING_WHEEL_SLOTS
+#define INTRINSIC_REPORTING_WHEEL_SLOTS 64
+#endif
+/* Define as 1 to evaluate every object on each call of
+   Device_local_reporting(), for objects that do not ask to be evaluated */
+#ifndef BACNET_INTRINSIC_REPORTING_POLLING
+#define BACNET_INTRINSIC_REPORTING_POLLING 0
+#endif
+#define REPORTING_QUEUE_BLOCK 16
+#define REPORTING_TIMER_BLOCK 16
+
+/* the objects waiting to be evaluated, in the order that they asked.
+   The objects keep a flag so that each of them is queued once, and the
+   queue grows to hold them all. */
+static BACNET_OBJECT_ID *Reporting_Queue;
+static unsigned Reporting_Queue_Count;
+static unsigned Reporting_Queue_Size;
+/* when the queue cannot grow, every object is evaluated once */
+static bool Reporting_Queue_Overflow;
+
+/* a time delay that is running, on the wheel or the free list */
+struct reporting_timer {
+    BACNET_OBJECT_ID object_id;
+    uint32_t expires;
+    /* index + 1 of the next timer, or 0 at the end of a list */
+    unsigned next;
+};
+static struct reporting_timer *Reporting_Timers;
+static unsigned Reporting_Timer_Size;
+static unsigned Reporting_Timer_Free;
+static unsigned Reporting_Wheel[INTRINSIC_REPORTING_WHEEL_SLOTS];
+/* seconds counted by Device_local_reporting_timer() */
+static uint32_t Reporting_Seconds;
+
+/**
+ * @brief Ask for the event state of an object to be evaluated on the
+ *  next call of Device_local_reporting().  Objects call this when their
+ *  Present_Value or any property used by their event algorithm changes,
+ *  unless they are already queued.
+ * @param object_type - type of the object
+ * @param object_instance - instance of the object
+ * @return true if the object is queued, or false if every object is
+ *  evaluated on the next call instead
+ */
+bool Device_Intrinsic_Reporting_Request(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    BACNET_OBJECT_ID *queue;
+    unsigned size;
+
+    if (Reporting_Queue_Overflow) {
+        return false;
+    }
+    if (Reporting_Queue_Count >= Reporting_Queue_Size) {
+        size = Reporting_Queue_Size ? Reporting_Queue_Size * 2
+                                    : REPORTING_QUEUE_BLOCK;
+        queue = realloc(Reporting_Queue, size * sizeof(BACNET_OBJECT_ID));
+        if (!queue) {
+            Reporting_Queue_Overflow = true;
+            return false;
+        }
+        Reporting_Queue = queue;
+        Reporting_Queue_Size = size;
+    }
+    Reporting_Queue[Reporting_Queue_Count].type = object_type;
+    Reporting_Queue[Reporting_Queue_Count].instance = object_instance;
+    Reporting_Queue_Count++;
+
+    return true;
+}
+
+/**
+ * @brief Get the number of objects waiting to be evaluated
+ * @return number of objects in the queue of intrinsic reporting
+ */
+unsigned Device_Intrinsic_Reporting_Queue_Count(void)
+{
+    return Reporting_Queue_Count;
+}
+
+/**
+ * @brief Ask for the event state of an object to be evaluated once a
+ *  number of seconds have passed, when its time delay is due.  A timer
+ *  is not cancelled, so the object checks that the delay has expired.
+ * @param object_type - type of the object
+ * @param object_instance - instance of the object
+ * @param seconds - number of seconds from now
+ * @return true if the timer is running
+ */
+bool Device_Intrinsic_Reporting_Timer(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance, uint32_t seconds)
+{
+    struct reporting_timer *timers;
+    unsigned index;
+    unsigned size;
+    unsigned slot;
+
+    if (seconds == 0) {
+        Device_Intrinsic_Reporting_Request(object_type, object_instance);
+        return true;
+    }
+    if (Reporting_Timer_Free == 0) {
+        size = Reporting_Timer_Size ? Reporting_Timer_Size * 2
+                                    : REPORTING_TIMER_BLOCK;
+        timers =
+            realloc(Reporting_Timers, size * sizeof(struct reporting_timer));
+        if (!timers) {
+            return false;
+        }
+        /* push the new timers on the free list */
+        for (index = size; index > Reporting_Timer_Size; index--) {
+            timers[index - 1].next = Reporting_Timer_Free;
+            Reporting_Timer_Free = index;
+        }
+        Reporting_Timers = timers;
+        Reporting_Timer_Size = size;
+    }
+    index = Reporting_Timer_Free - 1;
+    Reporting_Timer_Free = Reporting_Timers[index].next;
+    Reporting_Timers[index].object_id.type = object_type;
+    Reporting_Timers[index].object_id.instance = object_instance;
+    Reporting_Timers[index].expires = Reporting_Seconds + seconds;
+    slot = Reporting_Timers[index].expires % INTRINSIC_REPORTING_WHEEL_SLOTS;
+    Reporting_Timers[index].next = Reporting_Wheel[slot];
+    Reporting_Wheel[slot] = index + 1;
+
+    return true;
+}
+
+/**
+ * @brief Get the seconds counted by the intrinsic reporting timer, to
+ *  compare with the time that a time delay expires
+ * @return seconds since the device started
+ */
+uint32_t Device_Intrinsic_Reporting_Seconds(void)
+{
+    return Reporting_Seconds;
+}
+
+/**
+ * @brief Queue the objects whose time delays in a slot of the wheel are due
+ * @param slot - slot of the timer wheel
+ */
+static void Device_Intrinsic_Reporting_Expire(unsigned slot)
+{
+    struct reporting_timer *timer;
+    unsigned *link;
+    unsigned index;
+
+    link = &Reporting_Wheel[slot];
+    while (*link) {
+        index = *link - 1;
+        timer = &Reporting_Timers[index];
+        if ((int32_t)(Reporting_Seconds - timer->expires) < 0) {
+            /* due on a later turn of the wheel */
+            link = &timer->next;
+            continue;
+        }
+        *link = timer->next;
+        Device_Intrinsic_Reporting_Request(
+            timer->object_id.type, timer->object_id.instance);
+        timer->next = Reporting_Timer_Free;
+        Reporting_Timer_Free = index + 1;
+    }
+}
+
+/**
+ * @brief Turn the timer wheel of intrinsic reporting, and queue the
+ *  objects whose time delays are due.  Call it about once a second.
+ * @param seconds - number of seconds since the last call
+ */
+void Device_local_reporting_timer(uint32_t seconds)
+{
+    unsigned slot;
+
+    if (seconds > INTRINSIC_REPORTING_WHEEL_SLOTS) {
+        /* the wheel turns more than once, so visit every slot */
+        Reporting_Seconds += seconds;
+        for (slot = 0; slot < INTRINSIC_REPORTING_WHEEL_SLOTS; slot++) {
+            Device_Intrinsic_Reporting_Expire(slot);
+        }
+        return;
+    }
+    while (seconds) {
+        Reporting_Seconds++;
+        Device_Intrinsic_Reporting_Expire(
+            Reporting_Seconds % INTRINSIC_REPORTING_WHEEL_SLOTS);
+        seconds--;
+    }
+}
+
+/**
+ * @brief Evaluate the event state of an object
+ * @param object_type - type of the object
+ * @param object_instance - instance of the object
+ */
+static void Device_Intrinsic_Reporting_Object(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    struct object_functions *pObject;
+
+    pObject = Device_Objects_Find_Functions(object_type);
+    if (pObject && pObject->Object_Intrinsic_Reporting &&
+        pObject->Object_Valid_Instance &&
+        pObject->Object_Valid_Instance(object_instance)) {
+        pObject->Object_Intrinsic_Reporting(object_instance);
+    }
+}
+
+/**
+ * @brief Evaluate the event state of the objects that asked for it, or of
+ *  every object if BACNET_INTRINSIC_REPORTING_POLLING is set or too many
+ *  objects asked at once.
+ */
 void Device_local_reporting(void)
 {
-    struct object_functions *pObject = NULL;
     uint32_t objects_count = 0;
     uint32_t object_instance = 0;
     BACNET_OBJECT_TYPE object_type = OBJECT_NONE;
     uint32_t idx = 0;
-
-    objects_count = Device_Object_List_Count();
-
-    /* loop for all objects */
-    for (idx = 1; idx <= objects_count; idx++) {
-        Device_Object_List_Identifier(idx, &object_type, &object_instance);
-
-        pObject = Device_Objects_Find_Functions(object_type);
-        if (pObject != NULL) {
-            if (pObject->Object_Valid_Instance &&
-                pObject->Object_Valid_Instance(object_instance)) {
-                if (pObject->Object_Intrinsic_Reporting) {
-                    pObject->Object_Intrinsic_Reporting(object_instance);
-                }
-            }
+    unsigned count;
+
+    /* confirmed notifications that waited for a free TSM slot */
+    Notification_Class_notify_task();
+    if (BACNET_INTRINSIC_REPORTING_POLLING || Reporting_Queue_Overflow) {
+        Reporting_Queue_Overflow = false;
+        Reporting_Queue_Count = 0;
+        objects_count = Device_Object_List_Count();
+        /* loop for all objects */
+        for (idx = 1; idx <= objects_count; idx++) {
+            Device_Object_List_Identifier(idx, &object_type, &object_instance);
+            Device_Intrinsic_Reporting_Object(object_type, object_instance);
         }
+        return;
+    }
+    /* the objects queued while these are evaluated wait for the next call */
+    count = Reporting_Queue_Count;
+    for (idx = 0; (idx < count) && (idx < Reporting_Queue_Count); idx++) {
+        object_type = Reporting_Queue[idx].type;
+        object_instance = Reporting_Queue[idx].instance;
+        Device_Intrinsic_Reporting_Object(object_type, object_instance);
+    }
+    if (Reporting_Queue_Count > idx) {
+        memmove(&Reporting_Queue[0], &Reporting_Queue[idx],
+            (Reporting_Queue_Count - idx) * sizeof(BACNET_OBJECT_ID));
+        Reporting_Queue_Count -= idx;
+    } else {
+        Reporting_Queue_Count = 0;
     }
 }
 #endif
@@ -1828,6 +2119,7 @@ void Device_Init(object_functions_t *object_table)
     } else {
         Object_Table = &My_Object_Table[0];
     }
+    Device_Objects_Dispatch_Init();
     pObject = Object_Table;
     while (pObject->Object_Type < MAX_BACNET_OBJECT_TYPE) {
         if (pObject->Object_Init) {
@@ -441,6 +441,24 @@ extern "C" {
     BACNET_STACK_EXPORT
     void Device_local_reporting(
         void);
+    BACNET_STACK_EXPORT
+    void Device_local_reporting_timer(
+        uint32_t seconds);
+    BACNET_STACK_EXPORT
+    bool Device_Intrinsic_Reporting_Request(
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance);
+    BACNET_STACK_EXPORT
+    unsigned Device_Intrinsic_Reporting_Queue_Count(
+        void);
+    BACNET_STACK_EXPORT
+    bool Device_Intrinsic_Reporting_Timer(
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance,
+        uint32_t seconds);
+    BACNET_STACK_EXPORT
+    uint32_t Device_Intrinsic_Reporting_Seconds(
+        void);
 #endif
 
 /* Prototypes for Routing functionality in the Device Object.
@@ -173,7 +173,7 @@ static BACNET_LIFE_SAFETY_STATE Life_Safety_Point_Present_Value(
 bool Life_Safety_Point_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
     if (object_instance < MAX_LIFE_SAFETY_POINTS) {
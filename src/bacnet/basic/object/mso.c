@@ -169,7 +169,7 @@ uint32_t Multistate_Output_Present_Value(uint32_t object_instance)
 bool Multistate_Output_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
     if (object_instance < MAX_MULTISTATE_OUTPUTS) {
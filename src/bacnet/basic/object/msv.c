@@ -36,6 +36,7 @@
 #include "bacnet/rp.h"
 #include "bacnet/wp.h"
 #include "bacnet/basic/object/msv.h"
+#include "bacnet/cov.h"
 #include "bacnet/basic/services.h"
 
 /* number of demo objects */
@@ -166,6 +167,8 @@ bool Multistate_Value_Present_Value_Set(
         if ((value > 0) && (value <= MULTISTATE_NUMBER_OF_STATES)) {
             if (Present_Value[index] != (uint8_t)value) {
                 Change_Of_Value[index] = true;
+                cov_change_detected_notify(
+                    OBJECT_MULTI_STATE_VALUE, object_instance);
             }
             Present_Value[index] = (uint8_t)value;
             status = true;
@@ -196,6 +199,8 @@ void Multistate_Value_Out_Of_Service_Set(uint32_t object_instance, bool value)
     if (index < MAX_MULTISTATE_VALUES) {
         if (Out_Of_Service[index] != value) {
             Change_Of_Value[index] = true;
+            cov_change_detected_notify(
+                OBJECT_MULTI_STATE_VALUE, object_instance);
         }
         Out_Of_Service[index] = value;
     }
@@ -31,9 +31,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "bacnet/basic/binding/address.h"
+#include "bacnet/bacaddr.h"
 #include "bacnet/bacdef.h"
 #include "bacnet/bacdcode.h"
 #include "bacnet/bacenum.h"
@@ -59,9 +61,56 @@
 #define MAX_NOTIFICATION_CLASSES 2
 #endif
 
+/* number of confirmed notifications that wait for a free TSM slot;
+   by default, enough for one event sent to a whole recipient list */
+#ifndef NC_NOTIFY_QUEUE_SIZE
+#define NC_NOTIFY_QUEUE_SIZE NC_MAX_RECIPIENTS
+#endif
+
 #if defined(INTRINSIC_REPORTING)
 static NOTIFICATION_CLASS_INFO NC_Info[MAX_NOTIFICATION_CLASSES];
 
+/* a recipient that is active at the current time of day.  Destinations
+   of the list that send the same notification to the same recipient
+   are merged into one, with the transitions of all of them. */
+struct nc_active_recipient {
+    uint8_t index; /* of the first destination in the Recipient_List */
+    uint8_t transitions;
+};
+
+/* the active recipients of a class, which stay the same from one
+   time of day until another, on a day of the week */
+struct nc_active_list {
+    bool valid;
+    uint8_t wday;
+    /* hundredths of a second since midnight */
+    uint32_t from_time;
+    /* the list is compiled again at this time, which is not included */
+    uint32_t to_time;
+    uint8_t count;
+    struct nc_active_recipient recipient[NC_MAX_RECIPIENTS];
+};
+static struct nc_active_list NC_Active[MAX_NOTIFICATION_CLASSES];
+
+/* the devices of all the recipient lists, each once, for discovery */
+static uint32_t NC_Devices[MAX_NOTIFICATION_CLASSES * NC_MAX_RECIPIENTS];
+static unsigned NC_Devices_Count;
+static bool NC_Devices_Valid;
+
+/* confirmed notifications that wait for a free TSM slot, in order.
+   Each is followed by its encoded service request, and is only
+   allocated while it waits. */
+struct nc_notify {
+    BACNET_ADDRESS dest;
+    uint16_t max_apdu;
+    uint16_t service_request_len;
+};
+static struct nc_notify *NC_Notify_Queue[NC_NOTIFY_QUEUE_SIZE];
+static unsigned NC_Notify_Head;
+static unsigned NC_Notify_Count;
+/* confirmed notifications that were not sent because the queue was full */
+static unsigned NC_Notify_Dropped;
+
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Notification_Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
     PROP_OBJECT_NAME, PROP_OBJECT_TYPE, PROP_NOTIFICATION_CLASS, PROP_PRIORITY,
@@ -120,7 +169,18 @@ void Notification_Class_Init(void)
             RECIPIENT_TYPE_DEVICE;
 		NC_Info[NotifyIdx].Recipient_List->Recipient._.DeviceIdentifier =
             4194303;
+        NC_Active[NotifyIdx].valid = false;
     }
+    NC_Devices_Valid = false;
+    /* the notifications that still wait are let go */
+    while (NC_Notify_Count) {
+        free(NC_Notify_Queue[NC_Notify_Head]);
+        NC_Notify_Queue[NC_Notify_Head] = NULL;
+        NC_Notify_Head = (NC_Notify_Head + 1) % NC_NOTIFY_QUEUE_SIZE;
+        NC_Notify_Count--;
+    }
+    NC_Notify_Head = 0;
+    NC_Notify_Dropped = 0;
 
     return;
 }
@@ -170,7 +230,7 @@ unsigned Notification_Class_Instance_To_Index(uint32_t object_instance)
 bool Notification_Class_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     unsigned int index;
     bool status = false;
 
@@ -746,8 +806,14 @@ bool Notification_Class_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
                      * &src); */
                 }
             }
+            /* the recipients are compiled again when they are needed */
+            NC_Active[Notification_Class_Instance_To_Index(
+                          wp_data->object_instance)]
+                .valid = false;
+            NC_Devices_Valid = false;
 
             status = true;
+            break;
 
         case PROP_OBJECT_NAME:
             wp_data->error_class = ERROR_CLASS_PROPERTY;
@@ -784,50 +850,198 @@ void Notification_Class_Get_Priorities(
         pPriorityArray[i] = CurrentNotify->Priority[i];
 }
 
-static bool IsRecipientActive(
-    BACNET_DESTINATION *pBacDest, uint8_t EventToState)
+/**
+ * @brief Get the transitions of the recipients that are notified of
+ *  an event
+ * @param EventToState - the state the event goes to
+ * @return the transition, as TRANSITION_TO_x_MASKED, or zero
+ */
+static uint8_t nc_transition_mask(uint8_t EventToState)
 {
-    BACNET_DATE_TIME DateTime;
-
-    /* valid Transitions */
     switch (EventToState) {
         case EVENT_STATE_OFFNORMAL:
         case EVENT_STATE_HIGH_LIMIT:
         case EVENT_STATE_LOW_LIMIT:
-            if (!(pBacDest->Transitions & TRANSITION_TO_OFFNORMAL_MASKED))
-                return false;
-            break;
-
+            return TRANSITION_TO_OFFNORMAL_MASKED;
         case EVENT_STATE_FAULT:
-            if (!(pBacDest->Transitions & TRANSITION_TO_FAULT_MASKED))
-                return false;
-            break;
-
+            return TRANSITION_TO_FAULT_MASKED;
         case EVENT_STATE_NORMAL:
-            if (!(pBacDest->Transitions & TRANSITION_TO_NORMAL_MASKED))
-                return false;
-            break;
-
+            return TRANSITION_TO_NORMAL_MASKED;
         default:
-            return false; /* shouldn't happen */
+            return 0; /* shouldn't happen */
     }
+}
 
-    /* get actual date and time */
-    Device_getCurrentDateTime(&DateTime);
+/**
+ * @brief Get a time of day in hundredths of a second since midnight
+ * @param btime - the time of day
+ * @return hundredths of a second since midnight
+ */
+static uint32_t nc_time_hundredths(BACNET_TIME *btime)
+{
+    return ((uint32_t)btime->hour * 360000UL) +
+        ((uint32_t)btime->min * 6000UL) + ((uint32_t)btime->sec * 100UL) +
+        btime->hundredths;
+}
 
-    /* valid Days */
-    if (!((0x01 << (DateTime.date.wday - 1)) & pBacDest->ValidDays))
+/**
+ * @brief Determine if two destinations send the same notifications
+ *  to the same recipient
+ * @param dest1 - first destination
+ * @param dest2 - second destination
+ * @return true if the destinations only differ in their transitions
+ *  and time of day
+ */
+static bool nc_same_recipient(
+    BACNET_DESTINATION *dest1, BACNET_DESTINATION *dest2)
+{
+    if ((dest1->Recipient.RecipientType != dest2->Recipient.RecipientType) ||
+        (dest1->ProcessIdentifier != dest2->ProcessIdentifier) ||
+        (dest1->ConfirmedNotify != dest2->ConfirmedNotify)) {
         return false;
+    }
+    if (dest1->Recipient.RecipientType == RECIPIENT_TYPE_DEVICE) {
+        return dest1->Recipient._.DeviceIdentifier ==
+            dest2->Recipient._.DeviceIdentifier;
+    }
 
-    /* valid FromTime */
-    if (datetime_compare_time(&DateTime.time, &pBacDest->FromTime) < 0)
-        return false;
+    return bacnet_address_same(
+        &dest1->Recipient._.Address, &dest2->Recipient._.Address);
+}
 
-    /* valid ToTime */
-    if (datetime_compare_time(&pBacDest->ToTime, &DateTime.time) < 0)
-        return false;
+/**
+ * @brief Compile the recipients of a class that are active at a time,
+ *  and the times of day between which they stay active
+ * @param notify_index - index of the notification class
+ * @param DateTime - the current date and time
+ */
+static void nc_active_compile(unsigned notify_index, BACNET_DATE_TIME *DateTime)
+{
+    NOTIFICATION_CLASS_INFO *CurrentNotify = &NC_Info[notify_index];
+    struct nc_active_list *active = &NC_Active[notify_index];
+    BACNET_DESTINATION *pBacDest;
+    uint32_t now, from_time, to_time;
+    uint8_t index, i;
+
+    now = nc_time_hundredths(&DateTime->time);
+    active->wday = DateTime->date.wday;
+    active->from_time = 0;
+    active->to_time = UINT32_MAX;
+    active->count = 0;
+    pBacDest = &CurrentNotify->Recipient_List[0];
+    for (index = 0; index < NC_MAX_RECIPIENTS; index++, pBacDest++) {
+        if (pBacDest->Recipient.RecipientType == RECIPIENT_TYPE_NOTINITIALIZED)
+            break; /* recipient doesn't defined - end of list */
+        /* valid Days */
+        if (!((0x01 << (DateTime->date.wday - 1)) & pBacDest->ValidDays))
+            continue;
+        /* valid FromTime and ToTime, which is included */
+        from_time = nc_time_hundredths(&pBacDest->FromTime);
+        to_time = nc_time_hundredths(&pBacDest->ToTime) + 1;
+        if (now < from_time) {
+            if (from_time < active->to_time)
+                active->to_time = from_time;
+            continue;
+        }
+        if (now >= to_time) {
+            if (to_time > active->from_time)
+                active->from_time = to_time;
+            continue;
+        }
+        if (from_time > active->from_time)
+            active->from_time = from_time;
+        if (to_time < active->to_time)
+            active->to_time = to_time;
+        /* merge with the same recipient */
+        for (i = 0; i < active->count; i++) {
+            if (nc_same_recipient(
+                    &CurrentNotify->Recipient_List[active->recipient[i].index],
+                    pBacDest))
+                break;
+        }
+        if (i < active->count) {
+            active->recipient[i].transitions |= pBacDest->Transitions;
+        } else {
+            active->recipient[i].index = index;
+            active->recipient[i].transitions = pBacDest->Transitions;
+            active->count++;
+        }
+    }
+    active->valid = true;
+}
+
+/**
+ * @brief Get the recipients of a class that are active now, compiling
+ *  them again when the recipient list was written, or the time of day
+ *  passed the start or end of one of the destinations.
+ * @param notify_index - index of the notification class
+ * @return the active recipients
+ */
+static struct nc_active_list *nc_active_list(unsigned notify_index)
+{
+    struct nc_active_list *active = &NC_Active[notify_index];
+    BACNET_DATE_TIME DateTime;
+    uint32_t now;
 
-    return true;
+    /* get actual date and time */
+    Device_getCurrentDateTime(&DateTime);
+    now = nc_time_hundredths(&DateTime.time);
+    if (!active->valid || (active->wday != DateTime.date.wday) ||
+        (now < active->from_time) || (now >= active->to_time)) {
+        nc_active_compile(notify_index, &DateTime);
+    }
+
+    return active;
+}
+
+/**
+ * @brief Send a confirmed notification, or queue it until a TSM slot
+ *  is free, so that the notifications of many events are paced by the
+ *  replies of their recipients.
+ * @param dest - address of the recipient
+ * @param max_apdu - largest APDU the recipient accepts
+ * @param event_data - the notification
+ */
+static void nc_send_confirmed(BACNET_ADDRESS *dest,
+    unsigned max_apdu,
+    BACNET_EVENT_NOTIFICATION_DATA *event_data)
+{
+    struct nc_notify *notify;
+    int len;
+
+    if (max_apdu > sizeof(Handler_Transmit_Buffer)) {
+        max_apdu = sizeof(Handler_Transmit_Buffer);
+    }
+    /* the queued notifications go first */
+    if ((NC_Notify_Count == 0) && tsm_transaction_available()) {
+        Send_CEvent_Notify_Address(
+            Handler_Transmit_Buffer, max_apdu, event_data, dest);
+        return;
+    }
+    if (NC_Notify_Count >= NC_NOTIFY_QUEUE_SIZE) {
+        NC_Notify_Dropped++;
+        PRINTF("Notification Class[%u]: notification queue is full\n",
+            event_data->notificationClass);
+        return;
+    }
+    /* the transmit buffer is free until the notification is sent */
+    len = event_notify_encode_service_request(
+        Handler_Transmit_Buffer, event_data);
+    if (len <= 0) {
+        return;
+    }
+    notify = malloc(sizeof(struct nc_notify) + len);
+    if (!notify) {
+        NC_Notify_Dropped++;
+        return;
+    }
+    notify->dest = *dest;
+    notify->max_apdu = (uint16_t)max_apdu;
+    notify->service_request_len = (uint16_t)len;
+    memcpy(notify + 1, Handler_Transmit_Buffer, len);
+    NC_Notify_Queue[(NC_Notify_Head + NC_Notify_Count) %
+        NC_NOTIFY_QUEUE_SIZE] = notify;
+    NC_Notify_Count++;
 }
 
 void Notification_Class_common_reporting_function(
@@ -837,7 +1051,9 @@ void Notification_Class_common_reporting_function(
 
     NOTIFICATION_CLASS_INFO *CurrentNotify;
     BACNET_DESTINATION *pBacDest;
+    struct nc_active_list *active;
     uint32_t notify_index;
+    uint8_t transition;
     uint8_t index;
 
     notify_index =
@@ -890,50 +1106,88 @@ void Notification_Class_common_reporting_function(
     /* send notifications for active recipients */
     PRINTF("Notification Class[%u]: send notifications\n",
         event_data->notificationClass);
-    /* pointer to first recipient */
-    pBacDest = &CurrentNotify->Recipient_List[0];
-    for (index = 0; index < NC_MAX_RECIPIENTS; index++, pBacDest++) {
-        /* check if recipient is defined */
-        if (pBacDest->Recipient.RecipientType == RECIPIENT_TYPE_NOTINITIALIZED)
-            break; /* recipient doesn't defined - end of list */
-
-        if (IsRecipientActive(pBacDest, event_data->toState)) {
-            BACNET_ADDRESS dest;
-            uint32_t device_id;
-            unsigned max_apdu;
-
-            /* Process Identifier */
-            event_data->processIdentifier = pBacDest->ProcessIdentifier;
-
-            /* send notification */
-            if (pBacDest->Recipient.RecipientType == RECIPIENT_TYPE_DEVICE) {
-                /* send notification to the specified device */
-                device_id = pBacDest->Recipient._.DeviceIdentifier;
-                PRINTF("Notification Class[%u]: send notification to %u\n",
-                    event_data->notificationClass, (unsigned)device_id);
-                if (pBacDest->ConfirmedNotify == true)
-                    Send_CEvent_Notify(device_id, event_data);
-                else if (address_get_by_device(device_id, &max_apdu, &dest))
-                    Send_UEvent_Notify(
-                        Handler_Transmit_Buffer, event_data, &dest);
-            } else if (pBacDest->Recipient.RecipientType ==
-                RECIPIENT_TYPE_ADDRESS) {
-                PRINTF("Notification Class[%u]: send notification to ADDR\n",
-                    event_data->notificationClass);
-                /* send notification to the address indicated */
-                if (pBacDest->ConfirmedNotify == true) {
-                    if (address_get_device_id(&dest, &device_id))
-                        Send_CEvent_Notify(device_id, event_data);
-                } else {
-                    dest = pBacDest->Recipient._.Address;
-                    Send_UEvent_Notify(
-                        Handler_Transmit_Buffer, event_data, &dest);
-                }
-            }
+    transition = nc_transition_mask(event_data->toState);
+    active = nc_active_list(notify_index);
+    for (index = 0; index < active->count; index++) {
+        BACNET_ADDRESS dest;
+        uint32_t device_id;
+        unsigned max_apdu;
+
+        if (!(active->recipient[index].transitions & transition))
+            continue;
+        pBacDest =
+            &CurrentNotify->Recipient_List[active->recipient[index].index];
+        /* Process Identifier */
+        event_data->processIdentifier = pBacDest->ProcessIdentifier;
+
+        /* send notification */
+        if (pBacDest->Recipient.RecipientType == RECIPIENT_TYPE_DEVICE) {
+            /* send notification to the specified device */
+            device_id = pBacDest->Recipient._.DeviceIdentifier;
+            PRINTF("Notification Class[%u]: send notification to %u\n",
+                event_data->notificationClass, (unsigned)device_id);
+            if (!address_get_by_device(device_id, &max_apdu, &dest))
+                continue;
+            if (pBacDest->ConfirmedNotify == true)
+                nc_send_confirmed(&dest, max_apdu, event_data);
+            else
+                Send_UEvent_Notify(Handler_Transmit_Buffer, event_data, &dest);
+        } else if (pBacDest->Recipient.RecipientType ==
+            RECIPIENT_TYPE_ADDRESS) {
+            PRINTF("Notification Class[%u]: send notification to ADDR\n",
+                event_data->notificationClass);
+            /* send notification to the address indicated */
+            dest = pBacDest->Recipient._.Address;
+            if (pBacDest->ConfirmedNotify == true)
+                nc_send_confirmed(&dest, MAX_APDU, event_data);
+            else
+                Send_UEvent_Notify(Handler_Transmit_Buffer, event_data, &dest);
         }
     }
 }
 
+/**
+ * @brief Send the confirmed notifications that wait for a free TSM slot.
+ *  It should be called often, for example with the intrinsic reporting
+ *  of the objects.
+ */
+void Notification_Class_notify_task(void)
+{
+    struct nc_notify *notify;
+
+    while (NC_Notify_Count && tsm_transaction_available()) {
+        notify = NC_Notify_Queue[NC_Notify_Head];
+        Send_CEvent_Notify_Encoded(Handler_Transmit_Buffer, notify->max_apdu,
+            (uint8_t *)(notify + 1), notify->service_request_len,
+            &notify->dest);
+        free(notify);
+        NC_Notify_Queue[NC_Notify_Head] = NULL;
+        NC_Notify_Head = (NC_Notify_Head + 1) % NC_NOTIFY_QUEUE_SIZE;
+        NC_Notify_Count--;
+    }
+}
+
+/**
+ * @brief Get the number of confirmed notifications that wait for a free
+ *  TSM slot
+ * @return number of queued notifications
+ */
+unsigned Notification_Class_Notify_Queue_Count(void)
+{
+    return NC_Notify_Count;
+}
+
+/**
+ * @brief Get the number of confirmed notifications that were not sent
+ *  because the queue was full, since the notification classes were
+ *  initialized.  The queue holds NC_NOTIFY_QUEUE_SIZE notifications.
+ * @return number of dropped notifications
+ */
+unsigned Notification_Class_Notify_Dropped(void)
+{
+    return NC_Notify_Dropped;
+}
+
 /* This function tries to find the addresses of the defined devices. */
 /* It should be called periodically (example once per minute). */
 void Notification_Class_find_recipient(void)
@@ -944,29 +1198,39 @@ void Notification_Class_find_recipient(void)
     unsigned max_apdu = 0;
     uint32_t notify_index;
     uint32_t DeviceID;
+    unsigned i;
     uint8_t idx;
 
-    for (notify_index = 0; notify_index < MAX_NOTIFICATION_CLASSES;
-         notify_index++) {
-        /* pointer to current notification */
-        CurrentNotify =
-            &NC_Info[Notification_Class_Instance_To_Index(notify_index)];
-        /* pointer to first recipient */
-        pBacDest = &CurrentNotify->Recipient_List[0];
-        for (idx = 0; idx < NC_MAX_RECIPIENTS; idx++, pBacDest++) {
-            if (CurrentNotify->Recipient_List[idx].Recipient.RecipientType ==
-                RECIPIENT_TYPE_DEVICE) {
+    if (!NC_Devices_Valid) {
+        /* gather the devices of the recipient lists, each once */
+        NC_Devices_Count = 0;
+        for (notify_index = 0; notify_index < MAX_NOTIFICATION_CLASSES;
+             notify_index++) {
+            /* pointer to current notification */
+            CurrentNotify = &NC_Info[notify_index];
+            /* pointer to first recipient */
+            pBacDest = &CurrentNotify->Recipient_List[0];
+            for (idx = 0; idx < NC_MAX_RECIPIENTS; idx++, pBacDest++) {
+                if (pBacDest->Recipient.RecipientType !=
+                    RECIPIENT_TYPE_DEVICE)
+                    continue;
                 /* Device ID */
-                DeviceID = CurrentNotify->Recipient_List[idx]
-                               .Recipient._.DeviceIdentifier;
-                /* Send who_ is request only when address of device is unknown.
-                 */
-                if (!address_bind_request(DeviceID, &max_apdu, &src))
-                    Send_WhoIs(DeviceID, DeviceID);
-            } else if (CurrentNotify->Recipient_List[idx]
-                           .Recipient.RecipientType == RECIPIENT_TYPE_ADDRESS) {
+                DeviceID = pBacDest->Recipient._.DeviceIdentifier;
+                for (i = 0; i < NC_Devices_Count; i++) {
+                    if (NC_Devices[i] == DeviceID)
+                        break;
+                }
+                if (i == NC_Devices_Count)
+                    NC_Devices[NC_Devices_Count++] = DeviceID;
             }
         }
+        NC_Devices_Valid = true;
+    }
+    for (i = 0; i < NC_Devices_Count; i++) {
+        DeviceID = NC_Devices[i];
+        /* Send who_ is request only when address of device is unknown. */
+        if (!address_bind_request(DeviceID, &max_apdu, &src))
+            Send_WhoIs(DeviceID, DeviceID);
     }
 }
 #endif /* defined(INTRINSIC_REPORTING) */
@@ -144,6 +144,18 @@ BACnetRecipient ::= CHOICE {
     BACNET_STACK_EXPORT
     void Notification_Class_find_recipient(
         void);
+
+    BACNET_STACK_EXPORT
+    void Notification_Class_notify_task(
+        void);
+
+    BACNET_STACK_EXPORT
+    unsigned Notification_Class_Notify_Queue_Count(
+        void);
+
+    BACNET_STACK_EXPORT
+    unsigned Notification_Class_Notify_Dropped(
+        void);
 #endif /* defined(INTRINSIC_REPORTING) */
 
 
@@ -25,6 +25,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h> /* for calloc */
 #include <string.h> /* for memmove */
 #include "bacnet/bacdef.h"
 #include "bacnet/bacdcode.h"
@@ -43,14 +44,53 @@
 #if defined(BACFILE)
 #include "bacnet/basic/object/bacfile.h" /* object list dependency */
 #endif
+#if TREND_LOG_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 /* number of demo objects */
 #ifndef MAX_TREND_LOGS
 #define MAX_TREND_LOGS 8
 #endif
 
+/* default buffers, used until a log is given one of another size */
 static TL_DATA_REC Logs[MAX_TREND_LOGS][TL_MAX_ENTRIES];
 static TL_LOG_INFO LogInfo[MAX_TREND_LOGS];
+/* The logs that are waiting for their next reading, as a binary min-heap
+ * ordered by the time each is due, and the position of each log in it */
+static int Schedule[MAX_TREND_LOGS];
+static int Schedule_Position[MAX_TREND_LOGS];
+static int Schedule_Count;
+/* COV logs whose source object has changed since their last reading */
+static bool COV_Changed[MAX_TREND_LOGS];
+/* the clock of the logs, or NULL for the system clock */
+static trend_log_clock_function Trend_Log_Clock;
+
+#if TREND_LOG_MMAP
+/* Header at the start of the ring file of a log, followed by the
+ * records.  The records are stored as they are in memory, so a file
+ * is only read back by the build that wrote it. */
+typedef struct tl_file_header {
+    uint32_t ulMagic;
+    uint16_t usVersion;
+    uint16_t usRecordSize;
+    uint32_t ulBufferSize;
+    uint32_t ulIndex; /* Current insertion point */
+    uint32_t ulRecordCount;
+    uint32_t ulTotalRecordCount;
+    uint32_t ulReserved[2]; /* keeps the records 8 byte aligned */
+} TL_FILE_HEADER;
+
+#define TL_FILE_MAGIC 0x474F4C54UL /* "TLOG" */
+#define TL_FILE_VERSION 1
+
+/* the mapped ring file of each log, or NULL if it is in memory */
+static TL_FILE_HEADER *LogFile[MAX_TREND_LOGS];
+static size_t LogFileSize[MAX_TREND_LOGS];
+#endif
 
 /* These three arrays are used by the ReadPropertyMultiple handler */
 static const int Trend_Log_Properties_Required[] = { PROP_OBJECT_IDENTIFIER,
@@ -81,6 +121,29 @@ static const int Trend_Log_Properties_Optional[] = { PROP_DESCRIPTION,
 
 static const int Trend_Log_Properties_Proprietary[] = { -1 };
 
+/**
+ * @brief Set the clock of the trend logs
+ * @param clock - function that returns the current time,
+ *  or NULL to use the system clock
+ */
+void Trend_Log_Clock_Set(trend_log_clock_function clock)
+{
+    Trend_Log_Clock = clock;
+}
+
+/**
+ * @brief The current time of the trend logs
+ * @return the time from the clock of the logs
+ */
+static time_t Trend_Log_Now(void)
+{
+    if (Trend_Log_Clock) {
+        return Trend_Log_Clock();
+    }
+
+    return time(NULL);
+}
+
 void Trend_Log_Property_Lists(
     const int **pRequired, const int **pOptional, const int **pProprietary)
 {
@@ -138,6 +201,12 @@ unsigned Trend_Log_Instance_To_Index(uint32_t object_instance)
     return index;
 }
 
+static void TL_Schedule_Next(int iLog, time_t tNow);
+static void TL_COV_Changed(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance);
+static BACNET_COV_CHANGE_NOTIFICATION TL_COV_Notification = { NULL,
+    TL_COV_Changed };
+
 /*
  * Things to do when starting up the stack for Trend Logs.
  * Should be called whenever we reset the device or power it up
@@ -203,6 +272,8 @@ void Trend_Log_Init(void)
             LogInfo[iLog].ucTimeFlags = 0;
             LogInfo[iLog].ulIntervalOffset = 0;
             LogInfo[iLog].iIndex = 0;
+            LogInfo[iLog].pRecords = Logs[iLog];
+            LogInfo[iLog].ulBufferSize = TL_MAX_ENTRIES;
             LogInfo[iLog].ulLogInterval = 900;
             LogInfo[iLog].ulRecordCount = TL_MAX_ENTRIES;
             LogInfo[iLog].ulTotalRecordCount = 10000;
@@ -223,12 +294,214 @@ void Trend_Log_Init(void)
                 &LogInfo[iLog].StopTime, 2020, 12, 22, 23, 59, 59, 99);
             LogInfo[iLog].tStopTime =
                 TL_BAC_Time_To_Local(&LogInfo[iLog].StopTime);
+            Schedule_Position[iLog] = -1;
+            TL_Schedule_Next(iLog, Trend_Log_Now());
         }
+        /* COV logs take a reading when their object reports a change */
+        cov_change_detected_notification_add(&TL_COV_Notification);
     }
 
     return;
 }
 
+/*
+ * Give a log back its default buffer, which starts out empty.
+ */
+static void TL_Storage_Release(int iLog)
+{
+    TL_LOG_INFO *CurrentLog = &LogInfo[iLog];
+
+#if TREND_LOG_MMAP
+    if (LogFile[iLog]) {
+        /* the kernel writes the records back to the file */
+        munmap(LogFile[iLog], LogFileSize[iLog]);
+        LogFile[iLog] = NULL;
+        LogFileSize[iLog] = 0;
+        CurrentLog->pRecords = Logs[iLog];
+    }
+#endif
+    if (CurrentLog->pRecords != Logs[iLog]) {
+        free(CurrentLog->pRecords);
+    }
+    CurrentLog->pRecords = Logs[iLog];
+    CurrentLog->ulBufferSize = TL_MAX_ENTRIES;
+    CurrentLog->ulRecordCount = 0;
+    CurrentLog->iIndex = 0;
+}
+
+/*
+ * Get the number of records the buffer of a log can hold.
+ */
+uint32_t Trend_Log_Buffer_Size(uint32_t object_instance)
+{
+    unsigned index = Trend_Log_Instance_To_Index(object_instance);
+
+    if (index >= MAX_TREND_LOGS) {
+        return 0;
+    }
+    Trend_Log_Init();
+
+    return LogInfo[index].ulBufferSize;
+}
+
+/*
+ * Give a log an empty buffer in memory that holds buffer_size records,
+ * or its default buffer if buffer_size is 0.
+ */
+bool Trend_Log_Buffer_Size_Set(uint32_t object_instance, uint32_t buffer_size)
+{
+    unsigned index = Trend_Log_Instance_To_Index(object_instance);
+    TL_DATA_REC *pRecords = NULL;
+
+    if ((index >= MAX_TREND_LOGS) || (buffer_size > INT32_MAX)) {
+        return false;
+    }
+    Trend_Log_Init();
+    if (buffer_size && (buffer_size != TL_MAX_ENTRIES)) {
+        pRecords = calloc(buffer_size, sizeof(TL_DATA_REC));
+        if (!pRecords) {
+            return false;
+        }
+    }
+    TL_Storage_Release(index);
+    if (pRecords) {
+        LogInfo[index].pRecords = pRecords;
+        LogInfo[index].ulBufferSize = buffer_size;
+    }
+
+    return true;
+}
+
+#if TREND_LOG_MMAP
+/*
+ * Keep the buffer of a log in a ring file of buffer_size records,
+ * which is created if need be.  A file written with the same buffer
+ * size carries on from where it was, without being read in; otherwise
+ * the log starts out empty.
+ */
+bool Trend_Log_Storage_File_Set(
+    uint32_t object_instance, const char *pathname, uint32_t buffer_size)
+{
+    unsigned index = Trend_Log_Instance_To_Index(object_instance);
+    TL_LOG_INFO *CurrentLog;
+    TL_FILE_HEADER *pHeader;
+    struct stat st;
+    uint64_t file_size;
+    size_t size;
+    void *map;
+    int fd;
+
+    if ((index >= MAX_TREND_LOGS) || !pathname || (buffer_size == 0) ||
+        (buffer_size > INT32_MAX)) {
+        return false;
+    }
+    /* the file is mapped, so it must fit in the address space */
+    file_size = sizeof(TL_FILE_HEADER) +
+        ((uint64_t)buffer_size * sizeof(TL_DATA_REC));
+    size = (size_t)file_size;
+    if (size != file_size) {
+        return false;
+    }
+    Trend_Log_Init();
+    fd = open(pathname, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if ((fstat(fd, &st) < 0) ||
+        (((size_t)st.st_size != size) && (ftruncate(fd, (off_t)size) < 0))) {
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    TL_Storage_Release(index);
+    CurrentLog = &LogInfo[index];
+    pHeader = map;
+    LogFile[index] = pHeader;
+    LogFileSize[index] = size;
+    CurrentLog->pRecords = (TL_DATA_REC *)(pHeader + 1);
+    CurrentLog->ulBufferSize = buffer_size;
+    if ((pHeader->ulMagic == TL_FILE_MAGIC) &&
+        (pHeader->usVersion == TL_FILE_VERSION) &&
+        (pHeader->usRecordSize == sizeof(TL_DATA_REC)) &&
+        (pHeader->ulBufferSize == buffer_size) &&
+        (pHeader->ulIndex < buffer_size) &&
+        (pHeader->ulRecordCount <= buffer_size)) {
+        CurrentLog->iIndex = (int)pHeader->ulIndex;
+        CurrentLog->ulRecordCount = pHeader->ulRecordCount;
+        CurrentLog->ulTotalRecordCount = pHeader->ulTotalRecordCount;
+    } else {
+        memset(pHeader, 0, sizeof(TL_FILE_HEADER));
+        pHeader->ulMagic = TL_FILE_MAGIC;
+        pHeader->usVersion = TL_FILE_VERSION;
+        pHeader->usRecordSize = sizeof(TL_DATA_REC);
+        pHeader->ulBufferSize = buffer_size;
+        pHeader->ulTotalRecordCount = CurrentLog->ulTotalRecordCount;
+    }
+
+    return true;
+}
+#endif
+
+/*
+ * Give every log back its default buffer, closing any ring files.
+ */
+void Trend_Log_Storage_Cleanup(void)
+{
+    int iLog;
+
+    for (iLog = 0; iLog < MAX_TREND_LOGS; iLog++) {
+        if (LogInfo[iLog].pRecords != Logs[iLog]) {
+            TL_Storage_Release(iLog);
+        }
+    }
+}
+
+/*
+ * Get a record of a log by its 0 based position, oldest first.
+ */
+static TL_DATA_REC *TL_Record(int iLog, uint32_t ulPosition)
+{
+    TL_LOG_INFO *CurrentLog = &LogInfo[iLog];
+
+    if (CurrentLog->ulRecordCount < CurrentLog->ulBufferSize) {
+        return &CurrentLog->pRecords[ulPosition];
+    }
+
+    return &CurrentLog->pRecords[((uint32_t)CurrentLog->iIndex + ulPosition) %
+        CurrentLog->ulBufferSize];
+}
+
+/*
+ * Add a record to a log, pushing out the oldest one if the log is full.
+ */
+static void TL_Append_Rec(int iLog, TL_DATA_REC *pRecord)
+{
+    TL_LOG_INFO *CurrentLog = &LogInfo[iLog];
+
+    CurrentLog->pRecords[CurrentLog->iIndex++] = *pRecord;
+    if ((uint32_t)CurrentLog->iIndex >= CurrentLog->ulBufferSize) {
+        CurrentLog->iIndex = 0;
+    }
+
+    CurrentLog->ulTotalRecordCount++;
+
+    if (CurrentLog->ulRecordCount < CurrentLog->ulBufferSize) {
+        CurrentLog->ulRecordCount++;
+    }
+#if TREND_LOG_MMAP
+    if (LogFile[iLog]) {
+        /* the record is in place before the header counts it */
+        LogFile[iLog]->ulIndex = (uint32_t)CurrentLog->iIndex;
+        LogFile[iLog]->ulRecordCount = CurrentLog->ulRecordCount;
+        LogFile[iLog]->ulTotalRecordCount = CurrentLog->ulTotalRecordCount;
+    }
+#endif
+}
+
 /*
  * Note: we use the instance number here and build the name based
  * on the assumption that there is a 1 to 1 correspondance. If there
@@ -237,7 +510,7 @@ void Trend_Log_Init(void)
 bool Trend_Log_Object_Name(
     uint32_t object_instance, BACNET_CHARACTER_STRING *object_name)
 {
-    static char text_string[32] = ""; /* okay for single thread */
+    char text_string[32] = "";
     bool status = false;
 
     if (object_instance < MAX_TREND_LOGS) {
@@ -294,7 +567,8 @@ int Trend_Log_Read_Property(BACNET_READ_PROPERTY_DATA *rpdata)
             break;
 
         case PROP_BUFFER_SIZE:
-            apdu_len = encode_application_unsigned(&apdu[0], TL_MAX_ENTRIES);
+            apdu_len = encode_application_unsigned(
+                &apdu[0], CurrentLog->ulBufferSize);
             break;
 
         case PROP_LOG_BUFFER:
@@ -455,7 +729,7 @@ bool Trend_Log_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
                  * set */
                 if ((CurrentLog->bEnable == false) &&
                     (CurrentLog->bStopWhenFull == true) &&
-                    (CurrentLog->ulRecordCount == TL_MAX_ENTRIES) &&
+                    (CurrentLog->ulRecordCount == CurrentLog->ulBufferSize) &&
                     (value.type.Boolean == true)) {
                     status = false;
                     wp_data->error_class = ERROR_CLASS_OBJECT;
@@ -498,7 +772,7 @@ bool Trend_Log_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
                     CurrentLog->bStopWhenFull = value.type.Boolean;
 
                     if ((value.type.Boolean == true) &&
-                        (CurrentLog->ulRecordCount == TL_MAX_ENTRIES) &&
+                        (CurrentLog->ulRecordCount == CurrentLog->ulBufferSize) &&
                         (CurrentLog->bEnable == true)) {
                         /* When full log is switched from normal to stop when
                          * full disable the log and record the fact - see
@@ -542,27 +816,20 @@ bool Trend_Log_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             status = write_property_type_valid(wp_data, &value,
                 BACNET_APPLICATION_TAG_ENUMERATED);
             if (status) {
-                if (value.type.Enumerated != LOGGING_TYPE_COV) {
-                    CurrentLog->LoggingType =
-                        (BACNET_LOGGING_TYPE)value.type.Enumerated;
-                    if (value.type.Enumerated == LOGGING_TYPE_POLLED) {
-                        /* As per 12.25.27 pick a suitable default if interval
-                         * is 0 */
-                        if (CurrentLog->ulLogInterval == 0) {
-                            CurrentLog->ulLogInterval = 900;
-                        }
-                    }
-                    if (value.type.Enumerated == LOGGING_TYPE_TRIGGERED) {
-                        /* As per 12.25.27 0 the interval if triggered logging
-                         * selected */
-                        CurrentLog->ulLogInterval = 0;
+                CurrentLog->LoggingType =
+                    (BACNET_LOGGING_TYPE)value.type.Enumerated;
+                if (value.type.Enumerated == LOGGING_TYPE_POLLED) {
+                    /* As per 12.25.27 pick a suitable default if interval
+                     * is 0 */
+                    if (CurrentLog->ulLogInterval == 0) {
+                        CurrentLog->ulLogInterval = 900;
                     }
-                } else {
-                    /* We don't currently support COV */
-                    status = false;
-                    wp_data->error_class = ERROR_CLASS_PROPERTY;
-                    wp_data->error_code =
-                        ERROR_CODE_OPTIONAL_FUNCTIONALITY_NOT_SUPPORTED;
+                }
+                if ((value.type.Enumerated == LOGGING_TYPE_TRIGGERED) ||
+                    (value.type.Enumerated == LOGGING_TYPE_COV)) {
+                    /* As per 12.25.27 0 the interval if triggered or COV
+                     * logging selected */
+                    CurrentLog->ulLogInterval = 0;
                 }
             }
             break;
@@ -715,16 +982,14 @@ bool Trend_Log_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             status = write_property_type_valid(wp_data, &value,
                 BACNET_APPLICATION_TAG_UNSIGNED_INT);
             if (status) {
-                if ((CurrentLog->LoggingType == LOGGING_TYPE_POLLED) &&
-                    (value.type.Unsigned_Int == 0)) {
-                    /* We don't support COV at the moment so don't allow
-                     * switching to it by clearing interval whilst in polling
-                     * mode */
-                    wp_data->error_class = ERROR_CLASS_PROPERTY;
-                    wp_data->error_code =
-                        ERROR_CODE_OPTIONAL_FUNCTIONALITY_NOT_SUPPORTED;
-                    status = false;
+                if (value.type.Unsigned_Int == 0) {
+                    /* Clearing the interval switches to COV logging, see
+                     * 135-2008 12.25.14 */
+                    CurrentLog->LoggingType = LOGGING_TYPE_COV;
+                    CurrentLog->ulLogInterval = 0;
                 } else {
+                    /* and setting it switches back to polling */
+                    CurrentLog->LoggingType = LOGGING_TYPE_POLLED;
                     /* We only log to 1 sec accuracy so must divide by 100
                      * before passing it on */
                     CurrentLog->ulLogInterval = value.type.Unsigned_Int / 100;
@@ -780,6 +1045,10 @@ bool Trend_Log_Write_Property(BACNET_WRITE_PROPERTY_DATA *wp_data)
             wp_data->error_code = ERROR_CODE_WRITE_ACCESS_DENIED;
             break;
     }
+    if (status) {
+        /* any of the properties may change when the next reading is due */
+        TL_Schedule_Next(log_index, Trend_Log_Now());
+    }
 
     return status;
 }
@@ -815,12 +1084,9 @@ bool TrendLogGetRRInfo(
 
 void TL_Insert_Status_Rec(int iLog, BACNET_LOG_STATUS eStatus, bool bState)
 {
-    TL_LOG_INFO *CurrentLog;
     TL_DATA_REC TempRec;
 
-    CurrentLog = &LogInfo[iLog];
-
-    TempRec.tTimeStamp = time(NULL);
+    TempRec.tTimeStamp = Trend_Log_Now();
     TempRec.ucRecType = TL_TYPE_STATUS;
     TempRec.ucStatus = 0;
     TempRec.Datum.ucLogStatus = 0;
@@ -844,16 +1110,7 @@ void TL_Insert_Status_Rec(int iLog, BACNET_LOG_STATUS eStatus, bool bState)
             break;
     }
 
-    Logs[iLog][CurrentLog->iIndex++] = TempRec;
-    if (CurrentLog->iIndex >= TL_MAX_ENTRIES) {
-        CurrentLog->iIndex = 0;
-    }
-
-    CurrentLog->ulTotalRecordCount++;
-
-    if (CurrentLog->ulRecordCount < TL_MAX_ENTRIES) {
-        CurrentLog->ulRecordCount++;
-    }
+    TL_Append_Rec(iLog, &TempRec);
 }
 
 /*****************************************************************************
@@ -884,7 +1141,7 @@ bool TL_Is_Enabled(int iLog)
         bStatus = false;
     } else if (CurrentLog->ucTimeFlags != (TL_T_START_WILD | TL_T_STOP_WILD)) {
         /* enabled and either 1 wild card or none */
-        tNow = time(NULL);
+        tNow = Trend_Log_Now();
 #if 0
         printf("\nFlags - %u, Current - %u, Start - %u, Stop - %u\n",
             (unsigned int) CurrentLog->ucTimeFlags, (unsigned int) Now,
@@ -957,8 +1214,15 @@ time_t TL_BAC_Time_To_Local(BACNET_DATE_TIME *SourceTime)
 void TL_Local_Time_To_BAC(BACNET_DATE_TIME *DestTime, time_t SourceTime)
 {
     struct tm *TempTime;
+#if BACNET_THREADS && !defined(_MSC_VER)
+    struct tm LocalTime;
+
+    /* ReadRange may run on several threads */
+    TempTime = localtime_r(&SourceTime, &LocalTime);
+#else
 
     TempTime = localtime(&SourceTime);
+#endif
 
     DestTime->date.year = (uint16_t)(TempTime->tm_year + 1900);
     DestTime->date.month = (uint8_t)(TempTime->tm_mon + 1);
@@ -986,17 +1250,89 @@ void TL_Local_Time_To_BAC(BACNET_DATE_TIME *DestTime, time_t SourceTime)
  * We do assume the list cannot change whilst we are accessing it so would  *
  * not be multithread safe if there are other tasks that write to the log.  *
  *                                                                          *
- * We take the simple approach here to filling the buffer by taking a max   *
- * size for a single entry and then stopping if there is less than that     *
- * left in the buffer. You could build each entry in a seperate buffer and  *
- * determine the exact length before copying but this is time consuming,    *
- * requires more memory and would probably only let you sqeeeze one more    *
- * entry in on occasion. The value is calculated as 10 bytes for the time   *
- * stamp + 6 bytes for our largest data item (bit string capped at 32 bits) *
- * + 3 bytes for the status flags + 4 for the context tags to give 23.      *
+ * Each entry is encoded once, straight into the buffer while there is     *
+ * room for the largest entry. After that each entry is built in a small    *
+ * scratch buffer and only copied in if it fits, so the buffer is filled    *
+ * right up to the limit. The largest entry is 12 bytes for the time stamp  *
+ * + 7 bytes for our largest data item (bit string capped at 32 bits, or an *
+ * error) + 3 bytes for the status flags + 2 for the context tags, or 24.   *
  ****************************************************************************/
 
-#define TL_MAX_ENC 23 /* Maximum size of encoded log entry, see above */
+#define TL_MAX_ENC 24 /* Maximum size of encoded log entry, see above */
+
+/*
+ * Encode up to uiCount entries of a log, starting at the 1 based entry
+ * uiIndex, until the end of the log or of the space in the APDU, and set
+ * the result flags to match.
+ */
+static int TL_encode_entries(uint8_t *apdu,
+    BACNET_READ_RANGE_DATA *pRequest,
+    int iLog,
+    uint32_t uiIndex,
+    uint32_t uiCount)
+{
+    TL_LOG_INFO *CurrentLog = &LogInfo[iLog];
+    uint8_t Scratch[TL_MAX_ENC];
+    uint32_t uiRemaining = 0; /* Amount of unused space in packet */
+    uint32_t uiLast = 0; /* Entry number we finished encoding on */
+    int iLen = 0;
+    int iTemp = 0;
+
+    uiRemaining = MAX_APDU - pRequest->Overhead;
+    if (uiIndex == 1) {
+        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_FIRST_ITEM, true);
+    }
+    while ((uiCount > 0) && (uiIndex <= CurrentLog->ulRecordCount)) {
+        if (uiRemaining >= TL_MAX_ENC) {
+            iTemp = TL_encode_entry(&apdu[iLen], iLog, uiIndex);
+        } else {
+            iTemp = TL_encode_entry(&Scratch[0], iLog, uiIndex);
+            if ((uint32_t)iTemp > uiRemaining) {
+                /* Can't fit any more in! Say there was more */
+                bitstring_set_bit(
+                    &pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS, true);
+                break;
+            }
+            memcpy(&apdu[iLen], &Scratch[0], iTemp);
+        }
+        uiRemaining -= iTemp; /* Reduce the remaining space */
+        iLen += iTemp; /* and increase the length consumed */
+        uiLast = uiIndex; /* Record the last entry encoded */
+        uiIndex++; /* and get ready for next one */
+        uiCount--;
+        pRequest->ItemCount++; /* Chalk up another one for the response count */
+    }
+    if (uiLast == CurrentLog->ulRecordCount) {
+        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM, true);
+    }
+
+    return iLen;
+}
+
+/*
+ * Find the number of entries at the start of a log whose time stamps are
+ * before tRefTime, or also equal to it if bEqual is set. The time stamps
+ * go up from the oldest entry to the newest, so this is a binary search.
+ */
+static uint32_t TL_Time_Position(int iLog, time_t tRefTime, bool bEqual)
+{
+    uint32_t uiLow = 0;
+    uint32_t uiHigh = LogInfo[iLog].ulRecordCount;
+    uint32_t uiMiddle = 0;
+    time_t tStamp = 0;
+
+    while (uiLow < uiHigh) {
+        uiMiddle = uiLow + ((uiHigh - uiLow) / 2);
+        tStamp = TL_Record(iLog, uiMiddle)->tTimeStamp;
+        if ((tStamp < tRefTime) || (bEqual && (tStamp == tRefTime))) {
+            uiLow = uiMiddle + 1;
+        } else {
+            uiHigh = uiMiddle;
+        }
+    }
+
+    return uiLow;
+}
 
 int rr_trend_log_encode(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
 {
@@ -1032,18 +1368,11 @@ int rr_trend_log_encode(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
 int TL_encode_by_position(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
 {
     int log_index = 0;
-    int iLen = 0;
     int32_t iTemp = 0;
     TL_LOG_INFO *CurrentLog = NULL;
 
-    uint32_t uiIndex = 0; /* Current entry number */
-    uint32_t uiFirst = 0; /* Entry number we started encoding from */
-    uint32_t uiLast = 0; /* Entry number we finished encoding on */
     uint32_t uiTarget = 0; /* Last entry we are required to encode */
-    uint32_t uiRemaining = 0; /* Amount of unused space in packet */
 
-    /* See how much space we have */
-    uiRemaining = MAX_APDU - pRequest->Overhead;
     log_index = Trend_Log_Instance_To_Index(pRequest->object_instance);
     CurrentLog = &LogInfo[log_index];
     if (pRequest->RequestType == RR_READ_ALL) {
@@ -1099,38 +1428,8 @@ int TL_encode_by_position(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
         uiTarget = CurrentLog->ulRecordCount;
     }
 
-    uiIndex = pRequest->Range.RefIndex;
-    uiFirst = uiIndex; /* Record where we started from */
-    while (uiIndex <= uiTarget) {
-        if (uiRemaining < TL_MAX_ENC) {
-            /*
-             * Can't fit any more in! We just set the result flag to say there
-             * was more and drop out of the loop early
-             */
-            bitstring_set_bit(
-                &pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS, true);
-            break;
-        }
-
-        iTemp = TL_encode_entry(&apdu[iLen], log_index, uiIndex);
-
-        uiRemaining -= iTemp; /* Reduce the remaining space */
-        iLen += iTemp; /* and increase the length consumed */
-        uiLast = uiIndex; /* Record the last entry encoded */
-        uiIndex++; /* and get ready for next one */
-        pRequest->ItemCount++; /* Chalk up another one for the response count */
-    }
-
-    /* Set remaining result flags if necessary */
-    if (uiFirst == 1) {
-        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_FIRST_ITEM, true);
-    }
-
-    if (uiLast == CurrentLog->ulRecordCount) {
-        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM, true);
-    }
-
-    return (iLen);
+    return (TL_encode_entries(apdu, pRequest, log_index,
+        pRequest->Range.RefIndex, uiTarget - pRequest->Range.RefIndex + 1));
 }
 
 /****************************************************************************
@@ -1144,14 +1443,8 @@ int TL_encode_by_sequence(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
 {
     int log_index = 0;
     int iLen = 0;
-    int32_t iTemp = 0;
     TL_LOG_INFO *CurrentLog = NULL;
 
-    uint32_t uiIndex = 0; /* Current entry number */
-    uint32_t uiFirst = 0; /* Entry number we started encoding from */
-    uint32_t uiLast = 0; /* Entry number we finished encoding on */
-    uint32_t uiSequence = 0; /* Tracking sequenc number when encoding */
-    uint32_t uiRemaining = 0; /* Amount of unused space in packet */
     uint32_t uiFirstSeq = 0; /* Sequence number for 1st record in log */
 
     uint32_t uiBegin = 0; /* Starting Sequence number for request */
@@ -1161,8 +1454,6 @@ int TL_encode_by_sequence(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
     bool bWrapLog =
         false; /* Has log sequence range spanned the max for uint32_t? */
 
-    /* See how much space we have */
-    uiRemaining = MAX_APDU - pRequest->Overhead;
     log_index = Trend_Log_Instance_To_Index(pRequest->object_instance);
     CurrentLog = &LogInfo[log_index];
     /* Figure out the sequence number for the first record, last is
@@ -1247,39 +1538,8 @@ int TL_encode_by_sequence(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
     /* We now have a range that lies completely within the log buffer
      * and we need to figure out where that starts in the buffer.
      */
-    uiIndex = uiBegin - uiFirstSeq + 1;
-    uiSequence = uiBegin;
-    uiFirst = uiIndex; /* Record where we started from */
-    while (uiSequence != uiEnd + 1) {
-        if (uiRemaining < TL_MAX_ENC) {
-            /*
-             * Can't fit any more in! We just set the result flag to say there
-             * was more and drop out of the loop early
-             */
-            bitstring_set_bit(
-                &pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS, true);
-            break;
-        }
-
-        iTemp = TL_encode_entry(&apdu[iLen], log_index, uiIndex);
-
-        uiRemaining -= iTemp; /* Reduce the remaining space */
-        iLen += iTemp; /* and increase the length consumed */
-        uiLast = uiIndex; /* Record the last entry encoded */
-        uiIndex++; /* and get ready for next one */
-        uiSequence++;
-        pRequest->ItemCount++; /* Chalk up another one for the response count */
-    }
-
-    /* Set remaining result flags if necessary */
-    if (uiFirst == 1) {
-        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_FIRST_ITEM, true);
-    }
-
-    if (uiLast == CurrentLog->ulRecordCount) {
-        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM, true);
-    }
-
+    iLen = TL_encode_entries(apdu, pRequest, log_index,
+        uiBegin - uiFirstSeq + 1, uiEnd - uiBegin + 1);
     pRequest->FirstSequence = uiBegin;
 
     return (iLen);
@@ -1296,136 +1556,53 @@ int TL_encode_by_time(uint8_t *apdu, BACNET_READ_RANGE_DATA *pRequest)
 {
     int log_index = 0;
     int iLen = 0;
-    int32_t iTemp = 0;
-    int iCount = 0;
     TL_LOG_INFO *CurrentLog = NULL;
 
-    uint32_t uiIndex = 0; /* Current entry number */
-    uint32_t uiFirst = 0; /* Entry number we started encoding from */
-    uint32_t uiLast = 0; /* Entry number we finished encoding on */
-    uint32_t uiRemaining = 0; /* Amount of unused space in packet */
+    uint32_t uiStart = 0; /* 0 based entry we start encoding from */
+    uint32_t uiCount = 0; /* Number of entries requested */
     uint32_t uiFirstSeq = 0; /* Sequence number for 1st record in log */
     time_t tRefTime = 0; /* The time from the request in local format */
 
-    /* See how much space we have */
-    uiRemaining = MAX_APDU - pRequest->Overhead;
     log_index = Trend_Log_Instance_To_Index(pRequest->object_instance);
     CurrentLog = &LogInfo[log_index];
 
     tRefTime = TL_BAC_Time_To_Local(&pRequest->Range.RefTime);
-    /* Find correct position for oldest entry in log */
-    if (CurrentLog->ulRecordCount < TL_MAX_ENTRIES) {
-        uiIndex = 0;
-    } else {
-        uiIndex = CurrentLog->iIndex;
-    }
+    /* Figure out the sequence number for the first record, last is
+     * ulTotalRecordCount */
+    uiFirstSeq =
+        CurrentLog->ulTotalRecordCount - (CurrentLog->ulRecordCount - 1);
 
     if (pRequest->Count < 0) {
-        /* Start at end of log and look for record which has
-         * timestamp greater than or equal to the reference.
+        /* Find the records which have a timestamp before the reference,
+         * and end with the last of them.
          */
-        iCount = CurrentLog->ulRecordCount - 1;
-        /* Start out with the sequence number for the last record */
-        uiFirstSeq = CurrentLog->ulTotalRecordCount;
-        for (;;) {
-            if (Logs[pRequest->object_instance]
-                    [(uiIndex + iCount) % TL_MAX_ENTRIES]
-                        .tTimeStamp < tRefTime) {
-                break;
-            }
-
-            uiFirstSeq--;
-            iCount--;
-            if (iCount < 0) {
-                return (0);
-            }
+        uiStart = TL_Time_Position(log_index, tRefTime, false);
+        if (uiStart == 0) {
+            return (0);
         }
-
-        /* We have an and point for our request,
-         * now work backwards to find where we should start from
-         */
-
-        pRequest->Count = -pRequest->Count; /* Conveert to +ve count */
+        uiCount = -pRequest->Count; /* Convert to +ve count */
         /* If count would bring us back beyond the limits
          * Of the buffer then pin it to the start of the buffer
-         * otherwise adjust starting point and sequence number
-         * appropriately.
          */
-        iTemp = pRequest->Count - 1;
-        if (iTemp > iCount) {
-            uiFirstSeq -= iCount;
-            pRequest->Count = iCount + 1;
-            iCount = 0;
-        } else {
-            uiFirstSeq -= iTemp;
-            iCount -= iTemp;
+        if (uiCount > uiStart) {
+            uiCount = uiStart;
         }
+        uiStart -= uiCount;
+        pRequest->Count = uiCount;
     } else {
-        /* Start at beginning of log and look for 1st record which has
-         * timestamp greater than the reference time.
+        /* Start at the 1st record which has timestamp greater than the
+         * reference time.
          */
-        iCount = 0;
-        /* Figure out the sequence number for the first record, last is
-         * ulTotalRecordCount */
-        uiFirstSeq =
-            CurrentLog->ulTotalRecordCount - (CurrentLog->ulRecordCount - 1);
-        for (;;) {
-            if (Logs[pRequest->object_instance]
-                    [(uiIndex + iCount) % TL_MAX_ENTRIES]
-                        .tTimeStamp > tRefTime) {
-                break;
-            }
-
-            uiFirstSeq++;
-            iCount++;
-            if ((uint32_t)iCount == CurrentLog->ulRecordCount) {
-                return (0);
-            }
+        uiStart = TL_Time_Position(log_index, tRefTime, true);
+        if (uiStart == CurrentLog->ulRecordCount) {
+            return (0);
         }
+        uiCount = pRequest->Count;
     }
 
     /* We now have a starting point for the operation and a +ve count */
-
-    uiIndex = iCount + 1; /* Convert to BACnet 1 based reference */
-    uiFirst = uiIndex; /* Record where we started from */
-    iCount = pRequest->Count;
-    while (iCount != 0) {
-        if (uiRemaining < TL_MAX_ENC) {
-            /*
-             * Can't fit any more in! We just set the result flag to say there
-             * was more and drop out of the loop early
-             */
-            bitstring_set_bit(
-                &pRequest->ResultFlags, RESULT_FLAG_MORE_ITEMS, true);
-            break;
-        }
-
-        iTemp = TL_encode_entry(&apdu[iLen], log_index, uiIndex);
-
-        uiRemaining -= iTemp; /* Reduce the remaining space */
-        iLen += iTemp; /* and increase the length consumed */
-        uiLast = uiIndex; /* Record the last entry encoded */
-        uiIndex++; /* and get ready for next one */
-        pRequest->ItemCount++; /* Chalk up another one for the response count */
-        iCount--; /* And finally cross another one off the requested count */
-
-        if (uiIndex >
-            CurrentLog
-                ->ulRecordCount) { /* Finish up if we hit the end of the log */
-            break;
-        }
-    }
-
-    /* Set remaining result flags if necessary */
-    if (uiFirst == 1) {
-        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_FIRST_ITEM, true);
-    }
-
-    if (uiLast == CurrentLog->ulRecordCount) {
-        bitstring_set_bit(&pRequest->ResultFlags, RESULT_FLAG_LAST_ITEM, true);
-    }
-
-    pRequest->FirstSequence = uiFirstSeq;
+    iLen = TL_encode_entries(apdu, pRequest, log_index, uiStart + 1, uiCount);
+    pRequest->FirstSequence = uiFirstSeq + uiStart;
 
     return (iLen);
 }
@@ -1441,12 +1618,7 @@ int TL_encode_entry(uint8_t *apdu, int iLog, int iEntry)
     /* Convert from BACnet 1 based to 0 based array index and then
      * handle wrap around of the circular buffer */
 
-    if (LogInfo[iLog].ulRecordCount < TL_MAX_ENTRIES) {
-        pSource = &Logs[iLog][(iEntry - 1) % TL_MAX_ENTRIES];
-    } else {
-        pSource =
-            &Logs[iLog][(LogInfo[iLog].iIndex + iEntry - 1) % TL_MAX_ENTRIES];
-    }
+    pSource = TL_Record(iLog, iEntry - 1);
 
     iLen = 0;
     /* First stick the time stamp in with tag [0] */
@@ -1591,6 +1763,56 @@ static int local_read_property(uint8_t *value,
  * Attempt to fetch the logged property and store it in the Trend Log       *
  ****************************************************************************/
 
+/*
+ * Read the Present_Value and Status_Flags of a local object straight from
+ * its COV value list, which saves encoding and then decoding them again.
+ * Returns false if the object has no value list, or the value is of a
+ * type that is not recorded this way.
+ */
+static bool TL_fetch_value_list(
+    BACNET_DEVICE_OBJECT_PROPERTY_REFERENCE *Source, TL_DATA_REC *pRec)
+{
+    BACNET_PROPERTY_VALUE value_list[2];
+
+    if ((Source->propertyIdentifier != PROP_PRESENT_VALUE) ||
+        (Source->arrayIndex != BACNET_ARRAY_ALL) ||
+        !Device_Value_List_Supported(Source->objectIdentifier.type)) {
+        return false;
+    }
+    bacapp_property_value_list_init(&value_list[0], 2);
+    if (!Device_Encode_Value_List(Source->objectIdentifier.type,
+            Source->objectIdentifier.instance, &value_list[0])) {
+        return false;
+    }
+    switch (value_list[0].value.tag) {
+        case BACNET_APPLICATION_TAG_REAL:
+            pRec->ucRecType = TL_TYPE_REAL;
+            pRec->Datum.fReal = value_list[0].value.type.Real;
+            break;
+        case BACNET_APPLICATION_TAG_ENUMERATED:
+            pRec->ucRecType = TL_TYPE_ENUM;
+            pRec->Datum.ulEnum = value_list[0].value.type.Enumerated;
+            break;
+        case BACNET_APPLICATION_TAG_UNSIGNED_INT:
+            pRec->ucRecType = TL_TYPE_UNSIGN;
+            pRec->Datum.ulUValue = value_list[0].value.type.Unsigned_Int;
+            break;
+        case BACNET_APPLICATION_TAG_BOOLEAN:
+            pRec->ucRecType = TL_TYPE_BOOL;
+            pRec->Datum.ucBoolean = value_list[0].value.type.Boolean;
+            break;
+        default:
+            return false;
+    }
+    pRec->ucStatus = 128;
+    if (value_list[1].value.tag == BACNET_APPLICATION_TAG_BIT_STRING) {
+        pRec->ucStatus |=
+            bitstring_octet(&value_list[1].value.type.Bit_String, 0);
+    }
+
+    return true;
+}
+
 static void TL_fetch_property(int iLog)
 {
     uint8_t ValueBuf[MAX_APDU]; /* This is a big buffer in case someone selects
@@ -1612,10 +1834,14 @@ static void TL_fetch_property(int iLog)
 
     /* Record the current time in the log entry and also in the info block
      * for the log so we can figure out when the next reading is due */
-    TempRec.tTimeStamp = time(NULL);
+    TempRec.tTimeStamp = Trend_Log_Now();
     CurrentLog->tLastDataTime = TempRec.tTimeStamp;
     TempRec.ucStatus = 0;
 
+    if (TL_fetch_value_list(&LogInfo[iLog].Source, &TempRec)) {
+        TL_Append_Rec(iLog, &TempRec);
+        return;
+    }
     iLen = local_read_property(
         ValueBuf, StatusBuf, &LogInfo[iLog].Source, &error_class, &error_code);
     if (iLen < 0) {
@@ -1703,85 +1929,199 @@ static void TL_fetch_property(int iLog)
         TempRec.ucStatus = 128 | bitstring_octet(&TempBits, 0);
     }
 
-    Logs[iLog][CurrentLog->iIndex++] = TempRec;
-    if (CurrentLog->iIndex >= TL_MAX_ENTRIES) {
-        CurrentLog->iIndex = 0;
+    TL_Append_Rec(iLog, &TempRec);
+}
+
+/****************************************************************************
+ * Work out when a log is next due for a reading, or return false if it is  *
+ * waiting for a trigger, a change of value or a write to its properties.   *
+ * The checks of the start and stop times mirror those of TL_Is_Enabled(). *
+ ****************************************************************************/
+
+static bool TL_Next_Sample_Time(int iLog, time_t tNow, time_t *ptNext)
+{
+    TL_LOG_INFO *CurrentLog = &LogInfo[iLog];
+    time_t tFrom = tNow;
+    time_t tNext = 0;
+    time_t tInterval = 0;
+
+    if (CurrentLog->bEnable == false) {
+        return false;
+    }
+    if ((CurrentLog->ucTimeFlags == 0) &&
+        (CurrentLog->tStopTime < CurrentLog->tStartTime)) {
+        return false;
+    }
+    if (((CurrentLog->ucTimeFlags & TL_T_STOP_WILD) == 0) &&
+        (tNow > CurrentLog->tStopTime)) {
+        return false;
+    }
+    if (((CurrentLog->ucTimeFlags & TL_T_START_WILD) == 0) &&
+        (tNow < CurrentLog->tStartTime)) {
+        tFrom = CurrentLog->tStartTime;
+    }
+    if (CurrentLog->bTrigger || COV_Changed[iLog]) {
+        /* Polled logs that are aligned to the clock never have a trigger */
+        *ptNext = tFrom;
+        return true;
+    }
+    if ((CurrentLog->LoggingType != LOGGING_TYPE_POLLED) ||
+        (CurrentLog->ulLogInterval == 0)) {
+        return false;
+    }
+    tInterval = (time_t)CurrentLog->ulLogInterval;
+    if (CurrentLog->bAlignIntervals == true) {
+        if ((tFrom - CurrentLog->tLastDataTime) > tInterval) {
+            /* Take a reading as soon as possible if we have waited more
+             * than a period since the last one, after a power down say */
+            tNext = tFrom;
+        } else {
+            /* otherwise at the next time that matches the interval and
+             * the offset */
+            tNext = tFrom - (tFrom % tInterval) +
+                (time_t)(CurrentLog->ulIntervalOffset % tInterval);
+            if (tNext < tFrom) {
+                tNext += tInterval;
+            }
+            if (tNext <= CurrentLog->tLastDataTime) {
+                tNext += tInterval;
+            }
+        }
+    } else {
+        tNext = CurrentLog->tLastDataTime + tInterval;
+        if (tNext < tFrom) {
+            tNext = tFrom;
+        }
     }
+    *ptNext = tNext;
 
-    CurrentLog->ulTotalRecordCount++;
+    return true;
+}
 
-    if (CurrentLog->ulRecordCount < TL_MAX_ENTRIES) {
-        CurrentLog->ulRecordCount++;
+static bool TL_Schedule_Before(int iFirst, int iSecond)
+{
+    return LogInfo[Schedule[iFirst]].tNextSampleTime <
+        LogInfo[Schedule[iSecond]].tNextSampleTime;
+}
+
+static void TL_Schedule_Swap(int iFirst, int iSecond)
+{
+    int iLog = Schedule[iFirst];
+
+    Schedule[iFirst] = Schedule[iSecond];
+    Schedule[iSecond] = iLog;
+    Schedule_Position[Schedule[iFirst]] = iFirst;
+    Schedule_Position[Schedule[iSecond]] = iSecond;
+}
+
+/* Move the log at a position of the schedule up or down to its place */
+static void TL_Schedule_Fix(int iPosition)
+{
+    int iParent = 0;
+    int iChild = 0;
+
+    while (iPosition > 0) {
+        iParent = (iPosition - 1) / 2;
+        if (!TL_Schedule_Before(iPosition, iParent)) {
+            break;
+        }
+        TL_Schedule_Swap(iPosition, iParent);
+        iPosition = iParent;
+    }
+    for (;;) {
+        iChild = (2 * iPosition) + 1;
+        if (iChild >= Schedule_Count) {
+            break;
+        }
+        if (((iChild + 1) < Schedule_Count) &&
+            TL_Schedule_Before(iChild + 1, iChild)) {
+            iChild++;
+        }
+        if (!TL_Schedule_Before(iChild, iPosition)) {
+            break;
+        }
+        TL_Schedule_Swap(iPosition, iChild);
+        iPosition = iChild;
+    }
+}
+
+static void TL_Unschedule(int iLog)
+{
+    int iPosition = Schedule_Position[iLog];
+
+    if (iPosition < 0) {
+        return;
+    }
+    Schedule_Position[iLog] = -1;
+    Schedule_Count--;
+    if (iPosition < Schedule_Count) {
+        Schedule[iPosition] = Schedule[Schedule_Count];
+        Schedule_Position[Schedule[iPosition]] = iPosition;
+        TL_Schedule_Fix(iPosition);
+    }
+}
+
+/* Put a log in the schedule at the time of its next reading, if any */
+static void TL_Schedule_Next(int iLog, time_t tNow)
+{
+    if (!TL_Next_Sample_Time(iLog, tNow, &LogInfo[iLog].tNextSampleTime)) {
+        TL_Unschedule(iLog);
+        return;
+    }
+    if (Schedule_Position[iLog] < 0) {
+        Schedule[Schedule_Count] = iLog;
+        Schedule_Position[iLog] = Schedule_Count;
+        Schedule_Count++;
+    }
+    TL_Schedule_Fix(Schedule_Position[iLog]);
+}
+
+/* COV logs of an object that has changed take a reading at the next tick,
+ * once the object has its new value */
+static void TL_COV_Changed(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    TL_LOG_INFO *CurrentLog = NULL;
+    int iLog = 0;
+
+    for (iLog = 0; iLog < MAX_TREND_LOGS; iLog++) {
+        CurrentLog = &LogInfo[iLog];
+        if ((CurrentLog->LoggingType == LOGGING_TYPE_COV) &&
+            (CurrentLog->Source.objectIdentifier.type == object_type) &&
+            (CurrentLog->Source.objectIdentifier.instance ==
+                object_instance)) {
+            COV_Changed[iLog] = true;
+            TL_Schedule_Next(iLog, Trend_Log_Now());
+        }
     }
 }
 
 /****************************************************************************
- * Check each log to see if any data needs to be recorded.                  *
+ * Take a reading for each log that is due, leaving the others alone.       *
  ****************************************************************************/
 
 void trend_log_timer(uint16_t uSeconds)
 {
-    TL_LOG_INFO *CurrentLog = NULL;
     int iCount = 0;
+    int iLog = 0;
     time_t tNow = 0;
 
     (void)uSeconds;
     /* use OS to get the current time */
-    tNow = time(NULL);
-    for (iCount = 0; iCount < MAX_TREND_LOGS; iCount++) {
-        CurrentLog = &LogInfo[iCount];
-        if (TL_Is_Enabled(iCount)) {
-            if (CurrentLog->LoggingType == LOGGING_TYPE_POLLED) {
-                /* For polled logs we first need to see if they are clock
-                 * aligned or not.
-                 */
-                if (CurrentLog->bAlignIntervals == true) {
-                    /* Aligned logging so use the combination of the interval
-                     * and the offset to decide when to log. Also log a reading
-                     * if more than interval time has elapsed since last reading
-                     * to ensure we don't miss a reading if we aren't called at
-                     * the precise second when the match occurrs.
-                     */
-                    /*                if(((tNow % CurrentLog->ulLogInterval) >=
-                     * (CurrentLog->ulIntervalOffset %
-                     * CurrentLog->ulLogInterval)) && */
-                    /*                   ((tNow - CurrentLog->tLastDataTime) >=
-                     * CurrentLog->ulLogInterval)) { */
-                    if ((tNow % CurrentLog->ulLogInterval) ==
-                        (CurrentLog->ulIntervalOffset %
-                            CurrentLog->ulLogInterval)) {
-                        /* Record value if time synchronised trigger condition
-                         * is met and at least one period has elapsed.
-                         */
-                        TL_fetch_property(iCount);
-                    } else if ((tNow - CurrentLog->tLastDataTime) >
-                        CurrentLog->ulLogInterval) {
-                        /* Also record value if we have waited more than a
-                         * period since the last reading. This ensures we take a
-                         * reading as soon as possible after a power down if we
-                         * have been off for more than a single period.
-                         */
-                        TL_fetch_property(iCount);
-                    }
-                } else if (((tNow - CurrentLog->tLastDataTime) >=
-                               CurrentLog->ulLogInterval) ||
-                    (CurrentLog->bTrigger == true)) {
-                    /* If not aligned take a reading when we have either waited
-                     * long enough or a trigger is set.
-                     */
-                    TL_fetch_property(iCount);
-                }
-
-                CurrentLog->bTrigger = false; /* Clear this every time */
-            } else if (CurrentLog->LoggingType == LOGGING_TYPE_TRIGGERED) {
-                /* Triggered logs take a reading when the trigger is set and
-                 * then reset the trigger to wait for the next event
-                 */
-                if (CurrentLog->bTrigger == true) {
-                    TL_fetch_property(iCount);
-                    CurrentLog->bTrigger = false;
-                }
-            }
+    tNow = Trend_Log_Now();
+    /* each log is due at most once, so this is the most to wake */
+    for (iCount = 0; (iCount < MAX_TREND_LOGS) && (Schedule_Count > 0);
+         iCount++) {
+        iLog = Schedule[0];
+        if (LogInfo[iLog].tNextSampleTime > tNow) {
+            break;
+        }
+        if (TL_Is_Enabled(iLog)) {
+            TL_fetch_property(iLog);
         }
+        /* Triggered logs wait for the next event */
+        LogInfo[iLog].bTrigger = false;
+        COV_Changed[iLog] = false;
+        TL_Schedule_Next(iLog, tNow);
     }
 }
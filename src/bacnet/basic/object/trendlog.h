@@ -81,7 +81,19 @@ extern "C" {
 #define TL_T_START_WILD 1       /* Start time is wild carded */
 #define TL_T_STOP_WILD  2       /* Stop Time is wild carded */
 
-#define TL_MAX_ENTRIES 1000     /* Entries per datalog */
+#ifndef TL_MAX_ENTRIES
+#define TL_MAX_ENTRIES 1000     /* Default entries per datalog */
+#endif
+
+/* Trend Log buffers can be kept in memory-mapped ring files, so that
+ * they survive a restart and only the pages being used are in memory */
+#ifndef TREND_LOG_MMAP
+#if defined(__unix__) || defined(__APPLE__)
+#define TREND_LOG_MMAP 1
+#else
+#define TREND_LOG_MMAP 0
+#endif
+#endif
 
 /* Structure containing config and status info for a Trend Log */
 
@@ -103,6 +115,9 @@ extern "C" {
         bool bTrigger;  /* Set to 1 to cause a reading to be taken */
         int iIndex;     /* Current insertion point */
         time_t tLastDataTime;
+        time_t tNextSampleTime; /* When the log is next due for a reading */
+        uint32_t ulBufferSize;  /* Number of records the buffer can hold */
+        TL_DATA_REC *pRecords;  /* The buffer, in memory or in a file */
     } TL_LOG_INFO;
 
 /*
@@ -123,6 +138,11 @@ extern "C" {
 #define TL_TYPE_DELTA   9
 #define TL_TYPE_ANY     10      /* We don't support this particular can of worms! */
 
+/* clock of the trend logs, which returns the current time */
+    typedef time_t(
+        *trend_log_clock_function) (
+        void);
+
 
     BACNET_STACK_EXPORT
     void Trend_Log_Property_Lists(
@@ -161,6 +181,27 @@ extern "C" {
     BACNET_STACK_EXPORT
     void Trend_Log_Init(
         void);
+    BACNET_STACK_EXPORT
+    void Trend_Log_Clock_Set(
+        trend_log_clock_function clock);
+
+    BACNET_STACK_EXPORT
+    uint32_t Trend_Log_Buffer_Size(
+        uint32_t object_instance);
+    BACNET_STACK_EXPORT
+    bool Trend_Log_Buffer_Size_Set(
+        uint32_t object_instance,
+        uint32_t buffer_size);
+#if TREND_LOG_MMAP
+    BACNET_STACK_EXPORT
+    bool Trend_Log_Storage_File_Set(
+        uint32_t object_instance,
+        const char *pathname,
+        uint32_t buffer_size);
+#endif
+    BACNET_STACK_EXPORT
+    void Trend_Log_Storage_Cleanup(
+        void);
 
     BACNET_STACK_EXPORT
     void TL_Insert_Status_Rec(
@@ -52,6 +52,10 @@
 static uint16_t Timeout_Milliseconds = 3000;
 /* Number of APDU Retries */
 static uint8_t Number_Of_Retries = 3;
+#if BACNET_SEGMENTATION_ENABLED
+/* APDU Segment Timeout in Milliseconds */
+static uint16_t Segment_Timeout_Milliseconds = 2000;
+#endif
 
 /* a simple table for crossing the services supported */
 static BACNET_SERVICES_SUPPORTED
@@ -420,6 +424,18 @@ void apdu_retries_set(uint8_t value)
     Number_Of_Retries = value;
 }
 
+#if BACNET_SEGMENTATION_ENABLED
+uint16_t apdu_segment_timeout(void)
+{
+    return Segment_Timeout_Milliseconds;
+}
+
+void apdu_segment_timeout_set(uint16_t milliseconds)
+{
+    Segment_Timeout_Milliseconds = milliseconds;
+}
+#endif
+
 /* When network communications are completely disabled,
    only DeviceCommunicationControl and ReinitializeDevice APDUs
    shall be processed and no messages shall be initiated.
@@ -505,6 +521,9 @@ void apdu_handler(BACNET_ADDRESS *src,
     uint32_t error_class = 0;
     uint8_t reason = 0;
     bool server = false;
+#if BACNET_SEGMENTATION_ENABLED
+    bool segmented = false;
+#endif
 
     if (apdu) {
         /* PDU Type */
@@ -520,6 +539,19 @@ void apdu_handler(BACNET_ADDRESS *src,
                        initiated. */
                     break;
                 }
+#if BACNET_SEGMENTATION_ENABLED
+                if (service_data.segmented_message) {
+                    if (!tsm_segmented_receive(src, apdu, apdu_len,
+                            &service_request, &service_request_len)) {
+                        /* more segments to come */
+                        break;
+                    }
+                    /* the whole request is handled as one message */
+                    service_data.segmented_message = false;
+                    service_data.more_follows = false;
+                    segmented = true;
+                }
+#endif
                 if ((service_choice < MAX_BACNET_CONFIRMED_SERVICE) &&
                     (Confirmed_Function[service_choice])) {
                     Confirmed_Function[service_choice](service_request,
@@ -528,6 +560,11 @@ void apdu_handler(BACNET_ADDRESS *src,
                     Unrecognized_Service_Handler(service_request,
                         service_request_len, src, &service_data);
                 }
+#if BACNET_SEGMENTATION_ENABLED
+                if (segmented) {
+                    tsm_segmented_request_free(src, service_data.invoke_id);
+                }
+#endif
                 break;
             case PDU_TYPE_UNCONFIRMED_SERVICE_REQUEST:
                 if (apdu_len >= 2) {
@@ -603,6 +640,18 @@ void apdu_handler(BACNET_ADDRESS *src,
                     service_choice = apdu[len++];
                     service_request = &apdu[len];
                     service_request_len = apdu_len - (uint16_t)len;
+#if BACNET_SEGMENTATION_ENABLED
+                    if (service_ack_data.segmented_message) {
+                        if (!tsm_segmented_receive(src, apdu, apdu_len,
+                                &service_request, &service_request_len)) {
+                            /* more segments to come */
+                            break;
+                        }
+                        /* the whole ACK is handled as one message */
+                        service_ack_data.segmented_message = false;
+                        service_ack_data.more_follows = false;
+                    }
+#endif
                     switch (service_choice) {
                         case SERVICE_CONFIRMED_GET_ALARM_SUMMARY:
                         case SERVICE_CONFIRMED_GET_ENROLLMENT_SUMMARY:
@@ -636,9 +685,16 @@ void apdu_handler(BACNET_ADDRESS *src,
                 }
                 break;
             case PDU_TYPE_SEGMENT_ACK:
-                /* FIXME: what about a denial of service attack here?
-                   we could check src to see if that matched the tsm */
-                tsm_free_invoke_id(invoke_id);
+                if (apdu_len >= 4) {
+                    server = apdu[0] & BIT(0);
+                    invoke_id = apdu[1];
+#if BACNET_SEGMENTATION_ENABLED
+                    /* the source must match the peer of a segmented
+                       ComplexACK that we are sending */
+                    tsm_segment_ack_received(src, invoke_id, apdu[2],
+                        apdu[3], (apdu[0] & BIT(1)) ? true : false, server);
+#endif
+                }
                 break;
             case PDU_TYPE_ERROR:
                 if (apdu_len >= 3) {
@@ -729,6 +785,12 @@ void apdu_handler(BACNET_ADDRESS *src,
                         Abort_Function(src, invoke_id, reason, server);
                     }
                     tsm_free_invoke_id(invoke_id);
+#if BACNET_SEGMENTATION_ENABLED
+                    if (!server) {
+                        /* the client gave up on our segmented transfer */
+                        tsm_segmented_free(src, invoke_id);
+                    }
+#endif
                 }
                 break;
             default:
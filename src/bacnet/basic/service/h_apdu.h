@@ -185,6 +185,14 @@ extern "C" {
     BACNET_STACK_EXPORT
     void apdu_retries_set(
         uint8_t value);
+#if BACNET_SEGMENTATION_ENABLED
+    BACNET_STACK_EXPORT
+    uint16_t apdu_segment_timeout(
+        void);
+    BACNET_STACK_EXPORT
+    void apdu_segment_timeout_set(
+        uint16_t value);
+#endif
 
     BACNET_STACK_EXPORT
     void apdu_handler(
@@ -164,12 +164,11 @@ void handler_atomic_read_file(uint8_t *service_request,
 #endif
             }
         } else if (data.access == FILE_RECORD_ACCESS) {
-            if (data.type.record.fileStartRecord >=
-                BACNET_READ_FILE_RECORD_COUNT) {
+            if (data.type.record.fileStartRecord < 0) {
                 error_class = ERROR_CLASS_SERVICES;
                 error_code = ERROR_CODE_INVALID_FILE_START_POSITION;
                 error = true;
-            } else if (bacfile_read_stream_data(&data)) {
+            } else if (bacfile_read_record_data(&data)) {
 #if PRINT_ENABLED
                 fprintf(stderr, "ARF: fileStartRecord %d, %u RecordCount.\n",
                     (int)data.type.record.fileStartRecord,
@@ -25,6 +25,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "bacnet/config.h"
@@ -53,8 +54,10 @@
 
 /** @file h_cov.c  Handles Change of Value (COV) services. */
 
+/* a recipient of COV notifications, shared by its subscriptions */
 typedef struct BACnet_COV_Address {
-    bool valid : 1;
+    /* number of subscriptions using this address, or zero if unused */
+    unsigned ref_count;
     BACNET_ADDRESS dest;
 } BACNET_COV_ADDRESS;
 
@@ -64,6 +67,8 @@ typedef struct BACnet_COV_Subscription_Flags {
     bool valid : 1;
     bool issueConfirmedNotifications : 1; /* optional */
     bool send_requested : 1;
+    /* in the list of subscriptions that the COV task visits */
+    bool pending : 1;
 } BACNET_COV_SUBSCRIPTION_FLAGS;
 
 typedef struct BACnet_COV_Subscription {
@@ -73,16 +78,78 @@ typedef struct BACnet_COV_Subscription {
     uint32_t subscriberProcessIdentifier;
     uint32_t lifetime; /* optional */
     BACNET_OBJECT_ID monitoredObjectIdentifier;
+    /* next subscription in the monitored object hash chain,
+       or in the free list */
+    uint16_t object_next;
+    /* next subscription in the pending list */
+    uint16_t pending_next;
 } BACNET_COV_SUBSCRIPTION;
 
+/* The subscriptions are allocated in blocks as they are needed,
+   up to a limit which can be lowered at run time. */
 #ifndef MAX_COV_SUBCRIPTIONS
-#define MAX_COV_SUBCRIPTIONS 128
+#define MAX_COV_SUBCRIPTIONS 1024
+#endif
+#if (MAX_COV_SUBCRIPTIONS >= 0xFFFF)
+#error "MAX_COV_SUBCRIPTIONS must be less than 65535"
 #endif
-static BACNET_COV_SUBSCRIPTION COV_Subscriptions[MAX_COV_SUBCRIPTIONS];
+#ifndef COV_SUBSCRIPTION_BLOCK_SIZE
+#define COV_SUBSCRIPTION_BLOCK_SIZE 32
+#endif
+#define COV_SUBSCRIPTION_BLOCKS \
+    ((MAX_COV_SUBCRIPTIONS + COV_SUBSCRIPTION_BLOCK_SIZE - 1) / \
+        COV_SUBSCRIPTION_BLOCK_SIZE)
+static BACNET_COV_SUBSCRIPTION
+    *COV_Subscription_Blocks[COV_SUBSCRIPTION_BLOCKS];
+/* number of subscriptions in the allocated blocks */
+static unsigned COV_Subscription_Allocated;
+static unsigned COV_Subscription_Limit = MAX_COV_SUBCRIPTIONS;
+/* The recipient addresses are kept in a table that grows as needed,
+   up to a limit which can be lowered at run time. */
 #ifndef MAX_COV_ADDRESSES
-#define MAX_COV_ADDRESSES 16
+#define MAX_COV_ADDRESSES 256
+#endif
+static BACNET_COV_ADDRESS *COV_Addresses;
+static unsigned COV_Address_Allocated;
+static unsigned COV_Address_Limit = MAX_COV_ADDRESSES;
+/* usage counters */
+static BACNET_COV_STATISTICS COV_Statistics;
+
+/* Number of hash buckets used to index the subscriptions
+   by monitored object. */
+#ifndef MAX_COV_OBJECT_HASH
+#define MAX_COV_OBJECT_HASH 256
+#endif
+/* Number of changed objects that are queued for the COV task.
+   If the queue overflows, every subscribed object is checked. */
+#ifndef MAX_COV_DIRTY_OBJECTS
+#define MAX_COV_DIRTY_OBJECTS 32
 #endif
-static BACNET_COV_ADDRESS COV_Addresses[MAX_COV_ADDRESSES];
+/* Define as 1 to check every subscribed object on each COV task cycle,
+   for objects that do not call cov_change_detected_notify() */
+#ifndef BACNET_COV_POLLING
+#define BACNET_COV_POLLING 0
+#endif
+
+/* marks the end of a hash chain, the pending list, or the free list */
+#define COV_SUBSCRIPTION_NONE 0xFFFF
+/* marks a subscription without a recipient address */
+#define COV_ADDRESS_NONE ((unsigned)-1)
+
+/* hash chain heads of the subscriptions, by monitored object */
+static uint16_t COV_Object_Hash[MAX_COV_OBJECT_HASH];
+/* subscriptions that have a notification to send or confirm */
+static uint16_t COV_Pending_Head = COV_SUBSCRIPTION_NONE;
+static uint16_t COV_Pending_Tail = COV_SUBSCRIPTION_NONE;
+/* unused subscriptions in the allocated blocks */
+static uint16_t COV_Subscription_Free = COV_SUBSCRIPTION_NONE;
+/* objects that reported a change of value */
+static BACNET_OBJECT_ID COV_Dirty_Objects[MAX_COV_DIRTY_OBJECTS];
+static unsigned COV_Dirty_Head;
+static unsigned COV_Dirty_Count;
+static bool COV_Dirty_Overflow;
+/* indexes are built on first use if handler_cov_init() was not called */
+static bool COV_Index_Valid;
 
 /**
  * Gets the address from the list of COV addresses
@@ -96,8 +163,8 @@ static BACNET_ADDRESS *cov_address_get(unsigned index)
 {
     BACNET_ADDRESS *cov_dest = NULL;
 
-    if (index < MAX_COV_ADDRESSES) {
-        if (COV_Addresses[index].valid) {
+    if (index < COV_Address_Allocated) {
+        if (COV_Addresses[index].ref_count) {
             cov_dest = &COV_Addresses[index].dest;
         }
     }
@@ -106,77 +173,459 @@ static BACNET_ADDRESS *cov_address_get(unsigned index)
 }
 
 /**
- * Removes the address from the list of COV addresses, if it is not
- * used by other COV subscriptions
+ * Releases a reference to an address in the list of COV addresses.
+ * The address is removed when it is not used by any COV subscription.
+ *
+ * @param  index - offset into COV address list where address is stored
  */
-static void cov_address_remove_unused(void)
+static void cov_address_release(unsigned index)
 {
-    unsigned index = 0;
-    unsigned cov_index = 0;
-    bool found = false;
-
-    for (cov_index = 0; cov_index < MAX_COV_ADDRESSES; cov_index++) {
-        if (COV_Addresses[cov_index].valid) {
-            found = false;
-            for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-                if ((COV_Subscriptions[index].flag.valid) &&
-                    (COV_Subscriptions[index].dest_index == cov_index)) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                COV_Addresses[cov_index].valid = false;
+    if (index < COV_Address_Allocated) {
+        if (COV_Addresses[index].ref_count) {
+            COV_Addresses[index].ref_count--;
+            if (COV_Addresses[index].ref_count == 0) {
+                COV_Statistics.recipients--;
             }
         }
     }
 }
 
 /**
- * Adds the address to the list of COV addresses
+ * Adds a reference to the address in the list of COV addresses,
+ * growing the list if there is no room, up to its limit.
  *
  * @param  dest - address to be added if there is room in the list
  *
- * @return index number 0..N, or -1 if unable to add
+ * @return index number 0..N, or COV_ADDRESS_NONE if unable to add
  */
-static int cov_address_add(BACNET_ADDRESS *dest)
+static unsigned cov_address_add(BACNET_ADDRESS *dest)
 {
-    int index = -1;
+    unsigned index = COV_ADDRESS_NONE;
     unsigned i = 0;
-    bool found = false;
-    bool valid = false;
-    BACNET_ADDRESS *cov_dest = NULL;
+    unsigned size = 0;
+    BACNET_COV_ADDRESS *addresses = NULL;
 
-    if (dest) {
-        for (i = 0; i < MAX_COV_ADDRESSES; i++) {
-            valid = COV_Addresses[i].valid;
-            if (valid) {
-                cov_dest = &COV_Addresses[i].dest;
-                found = bacnet_address_same(dest, cov_dest);
-                if (found) {
-                    index = i;
-                    break;
-                }
+    if (!dest) {
+        return COV_ADDRESS_NONE;
+    }
+    for (i = 0; i < COV_Address_Allocated; i++) {
+        if (COV_Addresses[i].ref_count) {
+            if (bacnet_address_same(dest, &COV_Addresses[i].dest)) {
+                COV_Addresses[i].ref_count++;
+                return i;
             }
+        } else if (index == COV_ADDRESS_NONE) {
+            index = i;
         }
-        if (!found) {
-            /* find a free place to add a new address */
-            for (i = 0; i < MAX_COV_ADDRESSES; i++) {
-                valid = COV_Addresses[i].valid;
-                if (!valid) {
-                    index = i;
-                    cov_dest = &COV_Addresses[i].dest;
-                    bacnet_address_copy(cov_dest, dest);
-                    COV_Addresses[i].valid = true;
-                    break;
-                }
+    }
+    if ((index == COV_ADDRESS_NONE) &&
+        (COV_Address_Allocated < COV_Address_Limit)) {
+        /* grow the list */
+        size = COV_Address_Allocated * 2;
+        if (size < 8) {
+            size = 8;
+        }
+        if (size > COV_Address_Limit) {
+            size = COV_Address_Limit;
+        }
+        addresses = realloc(COV_Addresses, size * sizeof(BACNET_COV_ADDRESS));
+        if (addresses) {
+            memset(&addresses[COV_Address_Allocated], 0,
+                (size - COV_Address_Allocated) * sizeof(BACNET_COV_ADDRESS));
+            COV_Addresses = addresses;
+            index = COV_Address_Allocated;
+            COV_Address_Allocated = size;
+        }
+    }
+    if ((index != COV_ADDRESS_NONE) &&
+        (COV_Statistics.recipients < COV_Address_Limit)) {
+        bacnet_address_copy(&COV_Addresses[index].dest, dest);
+        COV_Addresses[index].ref_count = 1;
+        COV_Statistics.recipients++;
+        if (COV_Statistics.recipients > COV_Statistics.recipients_high_water) {
+            COV_Statistics.recipients_high_water = COV_Statistics.recipients;
+        }
+    } else {
+        index = COV_ADDRESS_NONE;
+    }
+
+    return index;
+}
+
+/**
+ * @brief Get a subscription from the allocated blocks
+ * @param index - subscription index, less than COV_Subscription_Allocated
+ * @return pointer to the subscription
+ */
+static BACNET_COV_SUBSCRIPTION *cov_subscription_entry(unsigned index)
+{
+    return &COV_Subscription_Blocks[index / COV_SUBSCRIPTION_BLOCK_SIZE]
+                                   [index % COV_SUBSCRIPTION_BLOCK_SIZE];
+}
+
+/**
+ * @brief Allocate another block of subscriptions, and put them
+ *  in the free list.
+ * @return true if a block was allocated
+ */
+static bool cov_subscription_block_add(void)
+{
+    BACNET_COV_SUBSCRIPTION *block;
+    unsigned block_index;
+    unsigned i;
+
+    if (COV_Subscription_Allocated >= COV_Subscription_Limit) {
+        return false;
+    }
+    block_index = COV_Subscription_Allocated / COV_SUBSCRIPTION_BLOCK_SIZE;
+    if (block_index >= COV_SUBSCRIPTION_BLOCKS) {
+        return false;
+    }
+    block =
+        calloc(COV_SUBSCRIPTION_BLOCK_SIZE, sizeof(BACNET_COV_SUBSCRIPTION));
+    if (!block) {
+        return false;
+    }
+    COV_Subscription_Blocks[block_index] = block;
+    /* link in reverse so that the lowest index is used first */
+    for (i = COV_SUBSCRIPTION_BLOCK_SIZE; i > 0; i--) {
+        block[i - 1].dest_index = COV_ADDRESS_NONE;
+        block[i - 1].object_next = COV_Subscription_Free;
+        block[i - 1].pending_next = COV_SUBSCRIPTION_NONE;
+        COV_Subscription_Free =
+            (uint16_t)(COV_Subscription_Allocated + i - 1);
+    }
+    COV_Subscription_Allocated += COV_SUBSCRIPTION_BLOCK_SIZE;
+
+    return true;
+}
+
+/**
+ * @brief Take an unused subscription from the free list
+ * @return subscription index, or COV_SUBSCRIPTION_NONE if at the limit
+ */
+static uint16_t cov_subscription_alloc(void)
+{
+    uint16_t index = COV_SUBSCRIPTION_NONE;
+
+    if (COV_Statistics.subscriptions >= COV_Subscription_Limit) {
+        return COV_SUBSCRIPTION_NONE;
+    }
+    if (COV_Subscription_Free == COV_SUBSCRIPTION_NONE) {
+        (void)cov_subscription_block_add();
+    }
+    if (COV_Subscription_Free != COV_SUBSCRIPTION_NONE) {
+        index = COV_Subscription_Free;
+        COV_Subscription_Free = cov_subscription_entry(index)->object_next;
+        cov_subscription_entry(index)->object_next = COV_SUBSCRIPTION_NONE;
+        COV_Statistics.subscriptions++;
+        if (COV_Statistics.subscriptions >
+            COV_Statistics.subscriptions_high_water) {
+            COV_Statistics.subscriptions_high_water =
+                COV_Statistics.subscriptions;
+        }
+    }
+
+    return index;
+}
+
+/**
+ * @brief Compute the monitored object hash bucket
+ * @param object_type - type of the monitored object
+ * @param object_instance - instance of the monitored object
+ * @return hash bucket index
+ */
+static unsigned cov_object_hash(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    return (unsigned)(BACNET_ID_VALUE(object_instance, object_type) %
+        MAX_COV_OBJECT_HASH);
+}
+
+/**
+ * @brief Compute the monitored object hash bucket of a subscription
+ * @param entry - subscription
+ * @return hash bucket index
+ */
+static unsigned cov_subscription_hash(BACNET_COV_SUBSCRIPTION *entry)
+{
+    return cov_object_hash(
+        (BACNET_OBJECT_TYPE)entry->monitoredObjectIdentifier.type,
+        entry->monitoredObjectIdentifier.instance);
+}
+
+/**
+ * @brief Check if a subscription monitors an object
+ * @param entry - subscription
+ * @param object_type - type of the monitored object
+ * @param object_instance - instance of the monitored object
+ * @return true if the subscription monitors the object
+ */
+static bool cov_subscription_object_same(BACNET_COV_SUBSCRIPTION *entry,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    return (entry->monitoredObjectIdentifier.type == object_type) &&
+        (entry->monitoredObjectIdentifier.instance == object_instance);
+}
+
+/**
+ * @brief Add a subscription to the monitored object index
+ * @param index - subscription index
+ */
+static void cov_object_link(unsigned index)
+{
+    BACNET_COV_SUBSCRIPTION *entry = cov_subscription_entry(index);
+    unsigned hash = cov_subscription_hash(entry);
+
+    entry->object_next = COV_Object_Hash[hash];
+    COV_Object_Hash[hash] = (uint16_t)index;
+}
+
+/**
+ * @brief Remove a subscription from the monitored object index
+ * @param index - subscription index
+ */
+static void cov_object_unlink(unsigned index)
+{
+    BACNET_COV_SUBSCRIPTION *entry = cov_subscription_entry(index);
+    uint16_t *pNext;
+
+    pNext = &COV_Object_Hash[cov_subscription_hash(entry)];
+    while (*pNext != COV_SUBSCRIPTION_NONE) {
+        if (*pNext == index) {
+            *pNext = entry->object_next;
+            entry->object_next = COV_SUBSCRIPTION_NONE;
+            break;
+        }
+        pNext = &cov_subscription_entry(*pNext)->object_next;
+    }
+}
+
+/**
+ * @brief Add a subscription to the end of the pending list, so that
+ *  the COV task visits it.  Entries are removed by the COV task
+ *  once they have nothing left to send or confirm.
+ * @param index - subscription index
+ */
+static void cov_pending_add(unsigned index)
+{
+    BACNET_COV_SUBSCRIPTION *entry = cov_subscription_entry(index);
+
+    if (entry->flag.pending) {
+        return;
+    }
+    entry->flag.pending = true;
+    entry->pending_next = COV_SUBSCRIPTION_NONE;
+    if (COV_Pending_Tail == COV_SUBSCRIPTION_NONE) {
+        COV_Pending_Head = (uint16_t)index;
+    } else {
+        cov_subscription_entry(COV_Pending_Tail)->pending_next =
+            (uint16_t)index;
+    }
+    COV_Pending_Tail = (uint16_t)index;
+}
+
+/**
+ * @brief Mark a subscription as having a notification to send
+ * @param index - subscription index
+ */
+static void cov_send_request_mark(unsigned index)
+{
+    cov_subscription_entry(index)->flag.send_requested = true;
+    cov_pending_add(index);
+}
+
+/**
+ * @brief Check if any subscription monitors an object
+ * @param object_type - type of the monitored object
+ * @param object_instance - instance of the monitored object
+ * @return true if the object has a subscription
+ */
+static bool cov_object_subscribed(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    BACNET_COV_SUBSCRIPTION *entry;
+    uint16_t index;
+
+    index = COV_Object_Hash[cov_object_hash(object_type, object_instance)];
+    while (index != COV_SUBSCRIPTION_NONE) {
+        entry = cov_subscription_entry(index);
+        if (cov_subscription_object_same(entry, object_type, object_instance)) {
+            return true;
+        }
+        index = entry->object_next;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Queue an object that reported a change of value, if it is
+ *  monitored by any subscription.  Called from the objects by way of
+ *  cov_change_detected_notify().
+ * @param object_type - type of the object that changed
+ * @param object_instance - instance of the object that changed
+ */
+static void cov_change_detected(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    unsigned tail;
+
+    if (!COV_Index_Valid) {
+        return;
+    }
+    if (!cov_object_subscribed(object_type, object_instance)) {
+        return;
+    }
+    if (COV_Dirty_Count) {
+        /* an object that changes again before the COV task runs */
+        tail = (COV_Dirty_Head + COV_Dirty_Count - 1) % MAX_COV_DIRTY_OBJECTS;
+        if ((COV_Dirty_Objects[tail].type == object_type) &&
+            (COV_Dirty_Objects[tail].instance == object_instance)) {
+            return;
+        }
+    }
+    if (COV_Dirty_Count >= MAX_COV_DIRTY_OBJECTS) {
+        COV_Dirty_Overflow = true;
+        return;
+    }
+    tail = (COV_Dirty_Head + COV_Dirty_Count) % MAX_COV_DIRTY_OBJECTS;
+    COV_Dirty_Objects[tail].type = object_type;
+    COV_Dirty_Objects[tail].instance = object_instance;
+    COV_Dirty_Count++;
+}
+
+/**
+ * @brief Visit the subscriptions of a changed object, and mark them
+ *  to send a notification if the object confirms the change.
+ * @param object_type - type of the object that changed
+ * @param object_instance - instance of the object that changed
+ */
+static void cov_object_changed(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    BACNET_COV_SUBSCRIPTION *entry;
+    uint16_t index;
+    bool marked = false;
+
+    if (!Device_COV(object_type, object_instance)) {
+        return;
+    }
+    index = COV_Object_Hash[cov_object_hash(object_type, object_instance)];
+    while (index != COV_SUBSCRIPTION_NONE) {
+        entry = cov_subscription_entry(index);
+        if (cov_subscription_object_same(entry, object_type, object_instance)) {
+            cov_send_request_mark(index);
+            marked = true;
+        }
+        index = entry->object_next;
+    }
+    if (marked) {
+#if PRINT_ENABLED
+        fprintf(stderr, "COVtask: Marking...\n");
+#endif
+        Device_COV_Clear(object_type, object_instance);
+    }
+}
+
+/**
+ * @brief Build the subscription indexes and the free list from the
+ *  allocated subscriptions, and start listening for objects that
+ *  have changed.
+ */
+static void cov_index_init(void)
+{
+    BACNET_COV_SUBSCRIPTION *entry;
+    unsigned index = 0;
+
+    for (index = 0; index < MAX_COV_OBJECT_HASH; index++) {
+        COV_Object_Hash[index] = COV_SUBSCRIPTION_NONE;
+    }
+    COV_Pending_Head = COV_SUBSCRIPTION_NONE;
+    COV_Pending_Tail = COV_SUBSCRIPTION_NONE;
+    COV_Subscription_Free = COV_SUBSCRIPTION_NONE;
+    /* in reverse so that the lowest free index is used first */
+    for (index = COV_Subscription_Allocated; index > 0; index--) {
+        entry = cov_subscription_entry(index - 1);
+        entry->flag.pending = false;
+        entry->pending_next = COV_SUBSCRIPTION_NONE;
+        if (entry->flag.valid) {
+            cov_object_link(index - 1);
+        } else {
+            entry->object_next = COV_Subscription_Free;
+            COV_Subscription_Free = (uint16_t)(index - 1);
+        }
+    }
+    for (index = 0; index < COV_Subscription_Allocated; index++) {
+        entry = cov_subscription_entry(index);
+        if (entry->flag.valid &&
+            (entry->flag.send_requested || entry->invokeID)) {
+            cov_pending_add(index);
+        }
+    }
+    COV_Dirty_Head = 0;
+    COV_Dirty_Count = 0;
+    COV_Dirty_Overflow = false;
+    cov_change_detected_callback_set(cov_change_detected);
+    COV_Index_Valid = true;
+}
+
+/**
+ * @brief Find the subscription that matches the monitored object,
+ *  the process identifier, and the subscriber address.
+ * @param src - address of the subscriber
+ * @param cov_data - monitored object and process identifier
+ * @return subscription index, or COV_SUBSCRIPTION_NONE if not found
+ */
+static uint16_t cov_subscription_find(
+    BACNET_ADDRESS *src, BACNET_SUBSCRIBE_COV_DATA *cov_data)
+{
+    BACNET_COV_SUBSCRIPTION *entry;
+    BACNET_OBJECT_TYPE object_type;
+    uint32_t object_instance;
+    uint16_t index;
+    BACNET_ADDRESS *dest = NULL;
+
+    object_type = (BACNET_OBJECT_TYPE)cov_data->monitoredObjectIdentifier.type;
+    object_instance = cov_data->monitoredObjectIdentifier.instance;
+    index = COV_Object_Hash[cov_object_hash(object_type, object_instance)];
+    while (index != COV_SUBSCRIPTION_NONE) {
+        entry = cov_subscription_entry(index);
+        if (cov_subscription_object_same(entry, object_type, object_instance) &&
+            (entry->subscriberProcessIdentifier ==
+                cov_data->subscriberProcessIdentifier)) {
+            dest = cov_address_get(entry->dest_index);
+            /* skip address matching if we don't have an address */
+            if (!dest || bacnet_address_same(src, dest)) {
+                break;
             }
         }
+        index = entry->object_next;
     }
 
     return index;
 }
 
+/**
+ * @brief Remove a subscription and put it in the free list.
+ *  It is dropped from the pending list by the COV task.
+ * @param index - subscription index
+ */
+static void cov_subscription_remove(unsigned index)
+{
+    BACNET_COV_SUBSCRIPTION *entry = cov_subscription_entry(index);
+
+    cov_object_unlink(index);
+    cov_address_release(entry->dest_index);
+    /* initialize with invalid COV address */
+    entry->flag.valid = false;
+    entry->dest_index = COV_ADDRESS_NONE;
+    entry->object_next = COV_Subscription_Free;
+    COV_Subscription_Free = (uint16_t)index;
+    COV_Statistics.subscriptions--;
+}
+
 /*
 BACnetCOVSubscription ::= SEQUENCE {
 Recipient [0] BACnetRecipientProcess,
@@ -298,12 +747,14 @@ int handler_cov_encode_subscriptions(uint8_t *apdu, int max_apdu)
     int len = 0;
     int apdu_len = 0;
     unsigned index = 0;
+    BACNET_COV_SUBSCRIPTION *entry;
 
     if (apdu) {
-        for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-            if (COV_Subscriptions[index].flag.valid) {
-                len = cov_encode_subscription(&apdu[apdu_len],
-                    max_apdu - apdu_len, &COV_Subscriptions[index]);
+        for (index = 0; index < COV_Subscription_Allocated; index++) {
+            entry = cov_subscription_entry(index);
+            if (entry->flag.valid) {
+                len = cov_encode_subscription(
+                    &apdu[apdu_len], max_apdu - apdu_len, entry);
                 apdu_len += len;
                 /* TODO: too late here to notice that we overran the buffer */
                 if (apdu_len > max_apdu) {
@@ -316,28 +767,68 @@ int handler_cov_encode_subscriptions(uint8_t *apdu, int max_apdu)
     return apdu_len;
 }
 
-/** Handler to initialize the COV list, clearing and disabling each entry.
+/** Handler to initialize the COV list, releasing the memory of
+ *  the subscriptions and recipients, and clearing the counters.
  * @ingroup DSCOV
  */
 void handler_cov_init(void)
 {
     unsigned index = 0;
 
-    for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-        /* initialize with invalid COV address */
-        COV_Subscriptions[index].flag.valid = false;
-        COV_Subscriptions[index].dest_index = MAX_COV_ADDRESSES;
-        COV_Subscriptions[index].subscriberProcessIdentifier = 0;
-        COV_Subscriptions[index].monitoredObjectIdentifier.type =
-            OBJECT_ANALOG_INPUT;
-        COV_Subscriptions[index].monitoredObjectIdentifier.instance = 0;
-        COV_Subscriptions[index].flag.issueConfirmedNotifications = false;
-        COV_Subscriptions[index].invokeID = 0;
-        COV_Subscriptions[index].lifetime = 0;
-        COV_Subscriptions[index].flag.send_requested = false;
+    for (index = 0; index < COV_SUBSCRIPTION_BLOCKS; index++) {
+        free(COV_Subscription_Blocks[index]);
+        COV_Subscription_Blocks[index] = NULL;
     }
-    for (index = 0; index < MAX_COV_ADDRESSES; index++) {
-        COV_Addresses[index].valid = false;
+    COV_Subscription_Allocated = 0;
+    free(COV_Addresses);
+    COV_Addresses = NULL;
+    COV_Address_Allocated = 0;
+    memset(&COV_Statistics, 0, sizeof(COV_Statistics));
+    cov_index_init();
+}
+
+/** Set the number of COV subscriptions that may be in use at once.
+ *  Existing subscriptions are kept if the limit is lowered below them.
+ * @ingroup DSCOV
+ * @param limit - number of subscriptions, up to MAX_COV_SUBCRIPTIONS
+ * @return true if the limit was set
+ */
+bool handler_cov_subscription_limit_set(unsigned limit)
+{
+    if (limit > MAX_COV_SUBCRIPTIONS) {
+        return false;
+    }
+    COV_Subscription_Limit = limit;
+
+    return true;
+}
+
+/** Set the number of COV recipient addresses that may be in use at once.
+ *  Existing recipients are kept if the limit is lowered below them.
+ * @ingroup DSCOV
+ * @param limit - number of recipients, up to MAX_COV_ADDRESSES
+ * @return true if the limit was set
+ */
+bool handler_cov_recipient_limit_set(unsigned limit)
+{
+    if (limit > MAX_COV_ADDRESSES) {
+        return false;
+    }
+    COV_Address_Limit = limit;
+
+    return true;
+}
+
+/** Get the usage counters of the COV subscriptions and recipients.
+ * @ingroup DSCOV
+ * @param statistics [out] the counters
+ */
+void handler_cov_statistics(BACNET_COV_STATISTICS *statistics)
+{
+    if (statistics) {
+        *statistics = COV_Statistics;
+        statistics->subscriptions_allocated = COV_Subscription_Allocated;
+        statistics->recipients_allocated = COV_Address_Allocated;
     }
 }
 
@@ -346,89 +837,76 @@ static bool cov_list_subscribe(BACNET_ADDRESS *src,
     BACNET_ERROR_CLASS *error_class,
     BACNET_ERROR_CODE *error_code)
 {
-    bool existing_entry = false;
-    int index;
-    int first_invalid_index = -1;
+    BACNET_COV_SUBSCRIPTION *entry;
+    unsigned dest_index;
+    uint16_t index;
     bool found = true;
-    bool address_match = false;
-    BACNET_ADDRESS *dest = NULL;
 
-    /* unable to subscribe - resources? */
     /* unable to cancel subscription - other? */
 
+    if (!COV_Index_Valid) {
+        cov_index_init();
+    }
     /* existing? - match Object ID and Process ID and address */
-    for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-        if (COV_Subscriptions[index].flag.valid) {
-            dest = cov_address_get(COV_Subscriptions[index].dest_index);
-            if (dest) {
-                address_match = bacnet_address_same(src, dest);
-            } else {
-                /* skip address matching - we don't have an address */
-                address_match = true;
-            }
-            if ((COV_Subscriptions[index].monitoredObjectIdentifier.type ==
-                    cov_data->monitoredObjectIdentifier.type) &&
-                (COV_Subscriptions[index].monitoredObjectIdentifier.instance ==
-                    cov_data->monitoredObjectIdentifier.instance) &&
-                (COV_Subscriptions[index].subscriberProcessIdentifier ==
-                    cov_data->subscriberProcessIdentifier) &&
-                address_match) {
-                existing_entry = true;
-                if (cov_data->cancellationRequest) {
-                    /* initialize with invalid COV address */
-                    COV_Subscriptions[index].flag.valid = false;
-                    COV_Subscriptions[index].dest_index = MAX_COV_ADDRESSES;
-                    cov_address_remove_unused();
-                } else {
-                    COV_Subscriptions[index].dest_index = cov_address_add(src);
-                    COV_Subscriptions[index].flag.issueConfirmedNotifications =
-                        cov_data->issueConfirmedNotifications;
-                    COV_Subscriptions[index].lifetime = cov_data->lifetime;
-                    COV_Subscriptions[index].flag.send_requested = true;
-                }
-                if (COV_Subscriptions[index].invokeID) {
-                    tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
-                    COV_Subscriptions[index].invokeID = 0;
-                }
-                break;
-            }
+    index = cov_subscription_find(src, cov_data);
+    if (index != COV_SUBSCRIPTION_NONE) {
+        entry = cov_subscription_entry(index);
+        if (cov_data->cancellationRequest) {
+            cov_subscription_remove(index);
         } else {
-            if (first_invalid_index < 0) {
-                first_invalid_index = index;
+            dest_index = cov_address_add(src);
+            if (dest_index != COV_ADDRESS_NONE) {
+                cov_address_release(entry->dest_index);
+                entry->dest_index = dest_index;
             }
+            entry->flag.issueConfirmedNotifications =
+                cov_data->issueConfirmedNotifications;
+            entry->lifetime = cov_data->lifetime;
+            cov_send_request_mark(index);
         }
-    }
-    if (!existing_entry && (first_invalid_index >= 0) &&
-        (!cov_data->cancellationRequest)) {
-        index = first_invalid_index;
-        found = true;
-        COV_Subscriptions[index].flag.valid = true;
-        COV_Subscriptions[index].dest_index = cov_address_add(src);
-        COV_Subscriptions[index].monitoredObjectIdentifier.type =
-            cov_data->monitoredObjectIdentifier.type;
-        COV_Subscriptions[index].monitoredObjectIdentifier.instance =
-            cov_data->monitoredObjectIdentifier.instance;
-        COV_Subscriptions[index].subscriberProcessIdentifier =
-            cov_data->subscriberProcessIdentifier;
-        COV_Subscriptions[index].flag.issueConfirmedNotifications =
-            cov_data->issueConfirmedNotifications;
-        COV_Subscriptions[index].invokeID = 0;
-        COV_Subscriptions[index].lifetime = cov_data->lifetime;
-        COV_Subscriptions[index].flag.send_requested = true;
-    } else if (!existing_entry) {
-        if (first_invalid_index < 0) {
+        if (entry->invokeID) {
+            tsm_free_invoke_id(entry->invokeID);
+            entry->invokeID = 0;
+        }
+    } else if (!cov_data->cancellationRequest) {
+        /* unable to subscribe - resources? */
+        dest_index = cov_address_add(src);
+        if (dest_index != COV_ADDRESS_NONE) {
+            index = cov_subscription_alloc();
+            if (index == COV_SUBSCRIPTION_NONE) {
+                cov_address_release(dest_index);
+            }
+        }
+        if (index != COV_SUBSCRIPTION_NONE) {
+            entry = cov_subscription_entry(index);
+            entry->flag.valid = true;
+            entry->dest_index = dest_index;
+            entry->monitoredObjectIdentifier.type =
+                cov_data->monitoredObjectIdentifier.type;
+            entry->monitoredObjectIdentifier.instance =
+                cov_data->monitoredObjectIdentifier.instance;
+            entry->subscriberProcessIdentifier =
+                cov_data->subscriberProcessIdentifier;
+            entry->flag.issueConfirmedNotifications =
+                cov_data->issueConfirmedNotifications;
+            entry->invokeID = 0;
+            entry->lifetime = cov_data->lifetime;
+            cov_object_link(index);
+            cov_send_request_mark(index);
+        } else {
             /* Out of resources */
+            COV_Statistics.subscriptions_rejected++;
             *error_class = ERROR_CLASS_RESOURCES;
             *error_code = ERROR_CODE_NO_SPACE_TO_ADD_LIST_ELEMENT;
             found = false;
-        } else {
-            /* cancellationRequest - valid object not subscribed */
-            /* From BACnet Standard 135-2010-13.14.2
-               ...Cancellations that are issued for which no matching COV
-               context can be found shall succeed as if a context had
-               existed, returning 'Result(+)'. */
-            found = true;
         }
+    } else {
+        /* cancellationRequest - valid object not subscribed */
+        /* From BACnet Standard 135-2010-13.14.2
+           ...Cancellations that are issued for which no matching COV
+           context can be found shall succeed as if a context had
+           existed, returning 'Result(+)'. */
+        found = true;
     }
 
     return found;
@@ -514,38 +992,37 @@ COV_FAILED:
 static void cov_lifetime_expiration_handler(
     unsigned index, uint32_t elapsed_seconds, uint32_t lifetime_seconds)
 {
-    if (index < MAX_COV_SUBCRIPTIONS) {
+    BACNET_COV_SUBSCRIPTION *entry;
+
+    if (index < COV_Subscription_Allocated) {
+        entry = cov_subscription_entry(index);
         /* handle lifetime expiration */
         if (lifetime_seconds >= elapsed_seconds) {
-            COV_Subscriptions[index].lifetime -= elapsed_seconds;
+            entry->lifetime -= elapsed_seconds;
 #if 0
             fprintf(stderr, "COVtimer: subscription[%d].lifetime=%lu\n", index,
-                (unsigned long) COV_Subscriptions[index].lifetime);
+                (unsigned long) entry->lifetime);
 #endif
         } else {
-            COV_Subscriptions[index].lifetime = 0;
+            entry->lifetime = 0;
         }
-        if (COV_Subscriptions[index].lifetime == 0) {
+        if (entry->lifetime == 0) {
             /* expire the subscription */
 #if PRINT_ENABLED
             fprintf(stderr, "COVtimer: PID=%u ",
-                COV_Subscriptions[index].subscriberProcessIdentifier);
+                entry->subscriberProcessIdentifier);
             fprintf(stderr, "%s %u ",
                 bactext_object_type_name(
-                    COV_Subscriptions[index].monitoredObjectIdentifier.type),
-                COV_Subscriptions[index].monitoredObjectIdentifier.instance);
-            fprintf(stderr, "time remaining=%u seconds ",
-                COV_Subscriptions[index].lifetime);
+                    entry->monitoredObjectIdentifier.type),
+                entry->monitoredObjectIdentifier.instance);
+            fprintf(stderr, "time remaining=%u seconds ", entry->lifetime);
             fprintf(stderr, "\n");
 #endif
-            /* initialize with invalid COV address */
-            COV_Subscriptions[index].flag.valid = false;
-            COV_Subscriptions[index].dest_index = MAX_COV_ADDRESSES;
-            cov_address_remove_unused();
-            if (COV_Subscriptions[index].flag.issueConfirmedNotifications) {
-                if (COV_Subscriptions[index].invokeID) {
-                    tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
-                    COV_Subscriptions[index].invokeID = 0;
+            cov_subscription_remove(index);
+            if (entry->flag.issueConfirmedNotifications) {
+                if (entry->invokeID) {
+                    tsm_free_invoke_id(entry->invokeID);
+                    entry->invokeID = 0;
                 }
             }
         }
@@ -577,12 +1054,14 @@ void handler_cov_timer_seconds(uint32_t elapsed_seconds)
 {
     unsigned index = 0;
     uint32_t lifetime_seconds = 0;
+    BACNET_COV_SUBSCRIPTION *entry;
 
     if (elapsed_seconds) {
         /* handle the subscription timeouts */
-        for (index = 0; index < MAX_COV_SUBCRIPTIONS; index++) {
-            if (COV_Subscriptions[index].flag.valid) {
-                lifetime_seconds = COV_Subscriptions[index].lifetime;
+        for (index = 0; index < COV_Subscription_Allocated; index++) {
+            entry = cov_subscription_entry(index);
+            if (entry->flag.valid) {
+                lifetime_seconds = entry->lifetime;
                 if (lifetime_seconds) {
                     /* only expire COV with definite lifetimes */
                     cov_lifetime_expiration_handler(
@@ -593,91 +1072,141 @@ void handler_cov_timer_seconds(uint32_t elapsed_seconds)
     }
 }
 
+/** Handler to send the notifications of the subscribed objects that
+ *  have changed, one step each time it is called.
+ * @ingroup DSCOV
+ * Objects report their changes with cov_change_detected_notify(), and
+ * only the subscriptions of those objects are visited, by way of the
+ * monitored object index.  Every subscribed object is checked instead
+ * if the queue of changed objects overflowed, or if BACNET_COV_POLLING
+ * is enabled.  The subscriptions that have notifications to send or
+ * confirm are kept in a pending list.
+ *
+ * @return true when a cycle of the COV task has completed
+ */
 bool handler_cov_fsm(void)
 {
-    static int index = 0;
+    static unsigned index = 0;
+    static uint16_t pending_prev = COV_SUBSCRIPTION_NONE;
+    static uint16_t pending_index = COV_SUBSCRIPTION_NONE;
+    uint16_t pending_next = COV_SUBSCRIPTION_NONE;
     BACNET_OBJECT_TYPE object_type = MAX_BACNET_OBJECT_TYPE;
     uint32_t object_instance = 0;
     bool status = false;
     bool send = false;
+    BACNET_COV_SUBSCRIPTION *cov_subscription;
     BACNET_PROPERTY_VALUE value_list[MAX_COV_PROPERTIES];
     /* states for transmitting */
     static enum {
         COV_STATE_IDLE = 0,
         COV_STATE_MARK,
         COV_STATE_CLEAR,
-        COV_STATE_FREE,
+        COV_STATE_DIRTY,
         COV_STATE_SEND
     } cov_task_state = COV_STATE_IDLE;
 
     switch (cov_task_state) {
         case COV_STATE_IDLE:
+            if (!COV_Index_Valid) {
+                cov_index_init();
+            }
             index = 0;
-            cov_task_state = COV_STATE_MARK;
+            if (COV_Dirty_Overflow || BACNET_COV_POLLING) {
+                COV_Dirty_Overflow = false;
+                cov_task_state = COV_STATE_MARK;
+            } else {
+                cov_task_state = COV_STATE_DIRTY;
+            }
             break;
         case COV_STATE_MARK:
             /* mark any subscriptions where the value has changed */
-            if (COV_Subscriptions[index].flag.valid) {
-                object_type = (BACNET_OBJECT_TYPE)COV_Subscriptions[index]
-                                  .monitoredObjectIdentifier.type;
+            if (index >= COV_Subscription_Allocated) {
+                /* no subscriptions, or the list was initialized */
+                index = 0;
+                cov_task_state = COV_STATE_DIRTY;
+                break;
+            }
+            cov_subscription = cov_subscription_entry(index);
+            if (cov_subscription->flag.valid) {
+                object_type = (BACNET_OBJECT_TYPE)cov_subscription
+                                  ->monitoredObjectIdentifier.type;
                 object_instance =
-                    COV_Subscriptions[index].monitoredObjectIdentifier.instance;
+                    cov_subscription->monitoredObjectIdentifier.instance;
                 status = Device_COV(object_type, object_instance);
                 if (status) {
-                    COV_Subscriptions[index].flag.send_requested = true;
+                    cov_send_request_mark(index);
 #if PRINT_ENABLED
                     fprintf(stderr, "COVtask: Marking...\n");
 #endif
                 }
             }
             index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
+            if (index >= COV_Subscription_Allocated) {
                 index = 0;
                 cov_task_state = COV_STATE_CLEAR;
             }
             break;
         case COV_STATE_CLEAR:
             /* clear the COV flag after checking all subscriptions */
-            if ((COV_Subscriptions[index].flag.valid) &&
-                (COV_Subscriptions[index].flag.send_requested)) {
-                object_type = (BACNET_OBJECT_TYPE)COV_Subscriptions[index]
-                                  .monitoredObjectIdentifier.type;
+            if (index >= COV_Subscription_Allocated) {
+                index = 0;
+                cov_task_state = COV_STATE_DIRTY;
+                break;
+            }
+            cov_subscription = cov_subscription_entry(index);
+            if ((cov_subscription->flag.valid) &&
+                (cov_subscription->flag.send_requested)) {
+                object_type = (BACNET_OBJECT_TYPE)cov_subscription
+                                  ->monitoredObjectIdentifier.type;
                 object_instance =
-                    COV_Subscriptions[index].monitoredObjectIdentifier.instance;
+                    cov_subscription->monitoredObjectIdentifier.instance;
                 Device_COV_Clear(object_type, object_instance);
             }
             index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
+            if (index >= COV_Subscription_Allocated) {
                 index = 0;
-                cov_task_state = COV_STATE_FREE;
+                cov_task_state = COV_STATE_DIRTY;
             }
             break;
-        case COV_STATE_FREE:
-            /* confirmed notification house keeping */
-            if ((COV_Subscriptions[index].flag.valid) &&
-                (COV_Subscriptions[index].flag.issueConfirmedNotifications) &&
-                (COV_Subscriptions[index].invokeID)) {
-                if (tsm_invoke_id_free(COV_Subscriptions[index].invokeID)) {
-                    COV_Subscriptions[index].invokeID = 0;
-                } else if (tsm_invoke_id_failed(
-                               COV_Subscriptions[index].invokeID)) {
-                    tsm_free_invoke_id(COV_Subscriptions[index].invokeID);
-                    COV_Subscriptions[index].invokeID = 0;
-                }
-            }
-            index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
-                index = 0;
+        case COV_STATE_DIRTY:
+            /* mark the subscriptions of an object that has changed */
+            if (COV_Dirty_Count) {
+                object_type = (BACNET_OBJECT_TYPE)COV_Dirty_Objects[
+                    COV_Dirty_Head].type;
+                object_instance = COV_Dirty_Objects[COV_Dirty_Head].instance;
+                COV_Dirty_Head = (COV_Dirty_Head + 1) % MAX_COV_DIRTY_OBJECTS;
+                COV_Dirty_Count--;
+                cov_object_changed(object_type, object_instance);
+            } else {
+                pending_prev = COV_SUBSCRIPTION_NONE;
+                pending_index = COV_Pending_Head;
                 cov_task_state = COV_STATE_SEND;
             }
             break;
         case COV_STATE_SEND:
+            if ((pending_index == COV_SUBSCRIPTION_NONE) ||
+                (pending_index >= COV_Subscription_Allocated)) {
+                cov_task_state = COV_STATE_IDLE;
+                break;
+            }
+            cov_subscription = cov_subscription_entry(pending_index);
+            /* confirmed notification house keeping */
+            if ((cov_subscription->flag.valid) &&
+                (cov_subscription->flag.issueConfirmedNotifications) &&
+                (cov_subscription->invokeID)) {
+                if (tsm_invoke_id_free(cov_subscription->invokeID)) {
+                    cov_subscription->invokeID = 0;
+                } else if (tsm_invoke_id_failed(cov_subscription->invokeID)) {
+                    tsm_free_invoke_id(cov_subscription->invokeID);
+                    cov_subscription->invokeID = 0;
+                }
+            }
             /* send any COVs that are requested */
-            if ((COV_Subscriptions[index].flag.valid) &&
-                (COV_Subscriptions[index].flag.send_requested)) {
+            if ((cov_subscription->flag.valid) &&
+                (cov_subscription->flag.send_requested)) {
                 send = true;
-                if (COV_Subscriptions[index].flag.issueConfirmedNotifications) {
-                    if (COV_Subscriptions[index].invokeID != 0) {
+                if (cov_subscription->flag.issueConfirmedNotifications) {
+                    if (cov_subscription->invokeID != 0) {
                         /* already sending */
                         send = false;
                     }
@@ -687,10 +1216,10 @@ bool handler_cov_fsm(void)
                     }
                 }
                 if (send) {
-                    object_type = (BACNET_OBJECT_TYPE)COV_Subscriptions[index]
-                                      .monitoredObjectIdentifier.type;
-                    object_instance = COV_Subscriptions[index]
-                                          .monitoredObjectIdentifier.instance;
+                    object_type = (BACNET_OBJECT_TYPE)cov_subscription
+                                      ->monitoredObjectIdentifier.type;
+                    object_instance =
+                        cov_subscription->monitoredObjectIdentifier.instance;
 #if PRINT_ENABLED
                     fprintf(stderr, "COVtask: Sending...\n");
 #endif
@@ -700,19 +1229,34 @@ bool handler_cov_fsm(void)
                     status = Device_Encode_Value_List(
                         object_type, object_instance, &value_list[0]);
                     if (status) {
-                        status = cov_send_request(
-                            &COV_Subscriptions[index], &value_list[0]);
+                        status =
+                            cov_send_request(cov_subscription, &value_list[0]);
                     }
                     if (status) {
-                        COV_Subscriptions[index].flag.send_requested = false;
+                        cov_subscription->flag.send_requested = false;
                     }
                 }
             }
-            index++;
-            if (index >= MAX_COV_SUBCRIPTIONS) {
-                index = 0;
-                cov_task_state = COV_STATE_IDLE;
+            /* drop the subscription from the pending list when done */
+            pending_next = cov_subscription->pending_next;
+            if ((cov_subscription->flag.valid) &&
+                (cov_subscription->flag.send_requested ||
+                    cov_subscription->invokeID)) {
+                pending_prev = pending_index;
+            } else {
+                if (pending_prev == COV_SUBSCRIPTION_NONE) {
+                    COV_Pending_Head = pending_next;
+                } else {
+                    cov_subscription_entry(pending_prev)->pending_next =
+                        pending_next;
+                }
+                if (COV_Pending_Tail == pending_index) {
+                    COV_Pending_Tail = pending_prev;
+                }
+                cov_subscription->flag.pending = false;
+                cov_subscription->pending_next = COV_SUBSCRIPTION_NONE;
             }
+            pending_index = pending_next;
             break;
         default:
             index = 0;
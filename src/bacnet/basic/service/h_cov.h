@@ -37,6 +37,22 @@
 #include "bacnet/bacenum.h"
 #include "bacnet/apdu.h"
 
+/* usage counters of the COV subscriptions and their recipients */
+typedef struct BACnet_COV_Statistics {
+    /* subscriptions in use, and the most that have been in use */
+    unsigned subscriptions;
+    unsigned subscriptions_high_water;
+    /* subscriptions that were refused for lack of resources */
+    unsigned subscriptions_rejected;
+    /* subscriptions that memory has been allocated for */
+    unsigned subscriptions_allocated;
+    /* recipient addresses in use, and the most that have been in use */
+    unsigned recipients;
+    unsigned recipients_high_water;
+    /* recipient addresses that memory has been allocated for */
+    unsigned recipients_allocated;
+} BACNET_COV_STATISTICS;
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -63,6 +79,15 @@ extern "C" {
     int handler_cov_encode_subscriptions(
         uint8_t * apdu,
         int max_apdu);
+    BACNET_STACK_EXPORT
+    bool handler_cov_subscription_limit_set(
+        unsigned limit);
+    BACNET_STACK_EXPORT
+    bool handler_cov_recipient_limit_set(
+        unsigned limit);
+    BACNET_STACK_EXPORT
+    void handler_cov_statistics(
+        BACNET_COV_STATISTICS * statistics);
 
 #ifdef __cplusplus
 }
@@ -62,6 +62,10 @@ void handler_get_alarm_summary(uint8_t *service_request,
     int alarm_value = 0;
     unsigned i = 0;
     unsigned j = 0;
+    unsigned index = 0;
+    unsigned position = 0;
+    uint32_t instance = 0;
+    get_event_index_function get_event_index = NULL;
     bool error = false;
     BACNET_ADDRESS my_address;
     BACNET_NPDU_DATA npdu_data;
@@ -89,8 +93,20 @@ void handler_get_alarm_summary(uint8_t *service_request,
 
     for (i = 0; i < MAX_BACNET_OBJECT_TYPE; i++) {
         if (Get_Alarm_Summary[i]) {
+            /* the objects in alarm are among the active events */
+            get_event_index = handler_get_event_information_index(i);
+            position = handler_get_event_information_active_find(i, 0);
             for (j = 0; j < 0xffff; j++) {
-                alarm_value = Get_Alarm_Summary[i](j, &getalarm_data);
+                index = j;
+                if (get_event_index) {
+                    if (!handler_get_event_information_active(
+                            position, i, &instance)) {
+                        break;
+                    }
+                    position++;
+                    index = get_event_index(instance);
+                }
+                alarm_value = Get_Alarm_Summary[i](index, &getalarm_data);
                 if (alarm_value > 0) {
                     len = get_alarm_summary_ack_encode_apdu_data(
                         &Handler_Transmit_Buffer[pdu_len + apdu_len],
@@ -101,7 +117,7 @@ void handler_get_alarm_summary(uint8_t *service_request,
                     } else {
                         apdu_len += len;
                     }
-                } else if (alarm_value < 0) {
+                } else if ((alarm_value < 0) && !get_event_index) {
                     break;
                 }
             }
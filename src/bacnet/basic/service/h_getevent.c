@@ -25,6 +25,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "bacnet/config.h"
@@ -40,11 +41,20 @@
 #include "bacnet/basic/object/device.h"
 #include "bacnet/basic/tsm/tsm.h"
 #include "bacnet/basic/services.h"
+#include "bacnet/basic/sys/key.h"
 #include "bacnet/datalink/datalink.h"
 
 /** @file h_getevent.c  Handles Get Event Information request. */
 
 static get_event_info_function Get_Event_Info[MAX_BACNET_OBJECT_TYPE];
+/* object types that keep the index of their active events up to date */
+static get_event_index_function Get_Event_Index[MAX_BACNET_OBJECT_TYPE];
+/* objects whose Event_State is not NORMAL, or that have a transition
+   which is not acknowledged, sorted by object type and instance */
+#define ACTIVE_EVENT_BLOCK 16
+static KEY *Active_Events;
+static unsigned Active_Event_Count;
+static unsigned Active_Event_Size;
 
 /** print eventState
  */
@@ -74,6 +84,200 @@ void handler_get_event_information_set(
     }
 }
 
+/**
+ * @brief Set the function that finds the object index of an instance,
+ *  for an object type that reports its active events with
+ *  handler_get_event_information_active_set().  The GetEventInformation
+ *  and GetAlarmSummary handlers then visit only the objects in the index
+ *  of active events, instead of every object of the type.
+ * @param object_type - type of the objects
+ * @param pFunction - function that finds the object index, or NULL if
+ *  every object of the type is visited
+ */
+void handler_get_event_information_index_set(
+    BACNET_OBJECT_TYPE object_type, get_event_index_function pFunction)
+{
+    if (object_type < MAX_BACNET_OBJECT_TYPE) {
+        Get_Event_Index[object_type] = pFunction;
+    }
+}
+
+/**
+ * @brief Determine if an object type reports its active events
+ * @param object_type - type of the objects
+ * @return the function that finds the object index of an instance,
+ *  or NULL if every object of the type has to be visited
+ */
+get_event_index_function handler_get_event_information_index(
+    BACNET_OBJECT_TYPE object_type)
+{
+    if (object_type < MAX_BACNET_OBJECT_TYPE) {
+        return Get_Event_Index[object_type];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find where an object is, or would be, in the active events
+ * @param key - object type and instance
+ * @return position of the first active event at or after the object
+ */
+static unsigned active_event_position(KEY key)
+{
+    unsigned low = 0;
+    unsigned high = Active_Event_Count;
+    unsigned middle;
+
+    while (low < high) {
+        middle = low + ((high - low) / 2);
+        if (Active_Events[middle] < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * @brief Find the end of the active events of an object type
+ * @param object_type - type of the objects
+ * @return position of the first active event of a greater object type
+ */
+static unsigned active_event_type_end(BACNET_OBJECT_TYPE object_type)
+{
+    if (object_type >= KEY_TYPE_MASK) {
+        return Active_Event_Count;
+    }
+
+    return active_event_position(KEY_ENCODE(object_type + 1, 0));
+}
+
+/**
+ * @brief Add an object to the active events, or remove it.  Objects call
+ *  this whenever their Event_State or Acked_Transitions change.
+ * @param object_type - type of the object
+ * @param object_instance - instance of the object
+ * @param active - true if the Event_State is not NORMAL, or a transition
+ *  is not acknowledged
+ * @return true if the index of active events is up to date
+ */
+bool handler_get_event_information_active_set(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance, bool active)
+{
+    KEY key = KEY_ENCODE(object_type, object_instance);
+    KEY *events;
+    unsigned position;
+    unsigned size;
+
+    position = active_event_position(key);
+    if ((position < Active_Event_Count) && (Active_Events[position] == key)) {
+        if (!active) {
+            Active_Event_Count--;
+            memmove(&Active_Events[position], &Active_Events[position + 1],
+                (Active_Event_Count - position) * sizeof(KEY));
+        }
+        return true;
+    }
+    if (!active) {
+        return true;
+    }
+    if (Active_Event_Count >= Active_Event_Size) {
+        size = Active_Event_Size ? Active_Event_Size * 2 : ACTIVE_EVENT_BLOCK;
+        events = realloc(Active_Events, size * sizeof(KEY));
+        if (!events) {
+            return false;
+        }
+        Active_Events = events;
+        Active_Event_Size = size;
+    }
+    memmove(&Active_Events[position + 1], &Active_Events[position],
+        (Active_Event_Count - position) * sizeof(KEY));
+    Active_Events[position] = key;
+    Active_Event_Count++;
+
+    return true;
+}
+
+/**
+ * @brief Remove every object of a type from the active events, or every
+ *  object when the type is MAX_BACNET_OBJECT_TYPE.  The memory of the
+ *  index is freed once it is empty.
+ * @param object_type - type of the objects
+ */
+void handler_get_event_information_active_clear(BACNET_OBJECT_TYPE object_type)
+{
+    unsigned first;
+    unsigned last;
+
+    if (object_type < MAX_BACNET_OBJECT_TYPE) {
+        first = active_event_position(KEY_ENCODE(object_type, 0));
+        last = active_event_type_end(object_type);
+        memmove(&Active_Events[first], &Active_Events[last],
+            (Active_Event_Count - last) * sizeof(KEY));
+        Active_Event_Count -= (last - first);
+    } else {
+        Active_Event_Count = 0;
+    }
+    if (Active_Event_Count == 0) {
+        free(Active_Events);
+        Active_Events = NULL;
+        Active_Event_Size = 0;
+    }
+}
+
+/**
+ * @brief Find the first active event of an object type whose instance is
+ *  the same or greater than an instance
+ * @param object_type - type of the objects
+ * @param object_instance - instance to start at
+ * @return position to hand to handler_get_event_information_active()
+ */
+unsigned handler_get_event_information_active_find(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    if (object_instance > KEY_ID_MASK) {
+        return active_event_type_end(object_type);
+    }
+
+    return active_event_position(KEY_ENCODE(object_type, object_instance));
+}
+
+/**
+ * @brief Get the active event at a position, if it is an object of a type
+ * @param position - position from handler_get_event_information_active_find(),
+ *  plus one for each active event visited since
+ * @param object_type - type of the objects
+ * @param object_instance - instance of the object [out]
+ * @return true if the active event at the position is of the object type
+ */
+bool handler_get_event_information_active(unsigned position,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t *object_instance)
+{
+    if ((position < Active_Event_Count) &&
+        ((BACNET_OBJECT_TYPE)KEY_DECODE_TYPE(Active_Events[position]) ==
+            object_type)) {
+        if (object_instance) {
+            *object_instance = KEY_DECODE_ID(Active_Events[position]);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Get the number of objects with active events
+ * @return number of objects in the index of active events
+ */
+unsigned handler_get_event_information_active_count(void)
+{
+    return Active_Event_Count;
+}
+
 void handler_get_event_information(uint8_t *service_request,
     uint16_t service_len,
     BACNET_ADDRESS *src,
@@ -93,6 +297,9 @@ void handler_get_event_information(uint8_t *service_request,
     BACNET_ADDRESS my_address;
     BACNET_OBJECT_ID object_id;
     unsigned i = 0, j = 0; /* counter */
+    unsigned index = 0;
+    unsigned position = 0;
+    uint32_t instance = 0;
     BACNET_GET_EVENT_INFORMATION_DATA getevent_data;
     int valid_event = 0;
 
@@ -136,56 +343,86 @@ void handler_get_event_information(uint8_t *service_request,
     }
     pdu_len += len;
     apdu_len = len;
-    for (i = 0; i < MAX_BACNET_OBJECT_TYPE; i++) {
-        if (Get_Event_Info[i]) {
-            for (j = 0; j < 0xffff; j++) {
-                valid_event = Get_Event_Info[i](j, &getevent_data);
-                if (valid_event > 0) {
-                    /* encode GetEvent_data only when type of object_id has max
-                     * value */
-                    if (object_id.type != MAX_BACNET_OBJECT_TYPE) {
-                        if ((object_id.type ==
-                                getevent_data.objectIdentifier.type) &&
-                            (object_id.instance ==
-                                getevent_data.objectIdentifier.instance)) {
-                            /* found 'Last Received Object Identifier'
-                               so should set type of object_id to max value */
-                            object_id.type = MAX_BACNET_OBJECT_TYPE;
-                        }
-                        continue;
+    for (i = 0; (i < MAX_BACNET_OBJECT_TYPE) && !more_events; i++) {
+        if (!Get_Event_Info[i]) {
+            continue;
+        }
+        if (object_id.type != MAX_BACNET_OBJECT_TYPE) {
+            if (i < object_id.type) {
+                continue;
+            }
+            if (i > object_id.type) {
+                /* 'Last Received Object Identifier' is not an object
+                   with events, so continue with the next type */
+                object_id.type = MAX_BACNET_OBJECT_TYPE;
+            }
+        }
+        if (Get_Event_Index[i]) {
+            /* visit only the objects with active events */
+            if (object_id.type == i) {
+                position = handler_get_event_information_active_find(
+                    i, object_id.instance + 1);
+                object_id.type = MAX_BACNET_OBJECT_TYPE;
+            } else {
+                position = handler_get_event_information_active_find(i, 0);
+            }
+        }
+        for (j = 0; j < 0xffff; j++) {
+            index = j;
+            if (Get_Event_Index[i]) {
+                if (!handler_get_event_information_active(
+                        position, i, &instance)) {
+                    break;
+                }
+                position++;
+                index = Get_Event_Index[i](instance);
+            }
+            valid_event = Get_Event_Info[i](index, &getevent_data);
+            if (valid_event > 0) {
+                /* encode GetEvent_data only when type of object_id has max
+                 * value */
+                if (object_id.type != MAX_BACNET_OBJECT_TYPE) {
+                    if ((object_id.type ==
+                            getevent_data.objectIdentifier.type) &&
+                        (object_id.instance ==
+                            getevent_data.objectIdentifier.instance)) {
+                        /* found 'Last Received Object Identifier'
+                           so should set type of object_id to max value */
+                        object_id.type = MAX_BACNET_OBJECT_TYPE;
                     }
+                    continue;
+                }
 
-                    getevent_data.next = NULL;
-                    len = getevent_ack_encode_apdu_data(
-                        &Handler_Transmit_Buffer[pdu_len],
-                        sizeof(Handler_Transmit_Buffer) - pdu_len,
-                        &getevent_data);
-                    if (len <= 0) {
+                getevent_data.next = NULL;
+                len = getevent_ack_encode_apdu_data(
+                    &Handler_Transmit_Buffer[pdu_len],
+                    sizeof(Handler_Transmit_Buffer) - pdu_len,
+                    &getevent_data);
+                if (len <= 0) {
+                    error = true;
+                    goto GET_EVENT_ERROR;
+                }
+                apdu_len += len;
+                if ((apdu_len >= service_data->max_resp - 2) ||
+                    (apdu_len >= MAX_APDU - 2)) {
+                    /* Device must be able to fit minimum
+                       one event information.
+                       Length of one event informations needs
+                       more than 50 octets. */
+                    if ((service_data->max_resp < 128) ||
+                        (MAX_APDU < 128)) {
+                        len = BACNET_STATUS_ABORT;
                         error = true;
                         goto GET_EVENT_ERROR;
-                    }
-                    apdu_len += len;
-                    if ((apdu_len >= service_data->max_resp - 2) ||
-                        (apdu_len >= MAX_APDU - 2)) {
-                        /* Device must be able to fit minimum
-                           one event information.
-                           Length of one event informations needs
-                           more than 50 octets. */
-                        if ((service_data->max_resp < 128) ||
-                            (MAX_APDU < 128)) {
-                            len = BACNET_STATUS_ABORT;
-                            error = true;
-                            goto GET_EVENT_ERROR;
-                        } else {
-                            more_events = true;
-                        }
-                        break;
                     } else {
-                        pdu_len += len;
+                        more_events = true;
                     }
-                } else if (valid_event < 0) {
                     break;
+                } else {
+                    pdu_len += len;
                 }
+            } else if ((valid_event < 0) && !Get_Event_Index[i]) {
+                break;
             }
         }
     }
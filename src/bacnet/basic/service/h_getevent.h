@@ -39,6 +39,11 @@
 #include "bacnet/event.h"
 #include "bacnet/getevent.h"
 
+/* finds the object index of an object instance */
+typedef unsigned (
+    *get_event_index_function) (
+    uint32_t object_instance);
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -48,6 +53,34 @@ extern "C" {
         BACNET_OBJECT_TYPE object_type,
         get_event_info_function pFunction);
 
+    BACNET_STACK_EXPORT
+    void handler_get_event_information_index_set(
+        BACNET_OBJECT_TYPE object_type,
+        get_event_index_function pFunction);
+    BACNET_STACK_EXPORT
+    get_event_index_function handler_get_event_information_index(
+        BACNET_OBJECT_TYPE object_type);
+    BACNET_STACK_EXPORT
+    bool handler_get_event_information_active_set(
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance,
+        bool active);
+    BACNET_STACK_EXPORT
+    void handler_get_event_information_active_clear(
+        BACNET_OBJECT_TYPE object_type);
+    BACNET_STACK_EXPORT
+    unsigned handler_get_event_information_active_find(
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance);
+    BACNET_STACK_EXPORT
+    bool handler_get_event_information_active(
+        unsigned position,
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t * object_instance);
+    BACNET_STACK_EXPORT
+    unsigned handler_get_event_information_active_count(
+        void);
+
     BACNET_STACK_EXPORT
     void handler_get_event_information(
         uint8_t * service_request,
@@ -81,6 +81,8 @@ void handler_read_property(uint8_t *service_request,
     bool error = true; /* assume that there is an error */
     int bytes_sent = 0;
     BACNET_ADDRESS my_address;
+    uint8_t *apdu = NULL;
+    int apdu_size = 0;
 
     /* configure default error code as an abort since it is common */
     rpdata.error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
@@ -89,6 +91,17 @@ void handler_read_property(uint8_t *service_request,
     npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
     npdu_len = npdu_encode_pdu(
         &Handler_Transmit_Buffer[0], src, &my_address, &npdu_data);
+    if (npdu_len > 0) {
+        apdu = &Handler_Transmit_Buffer[npdu_len];
+        apdu_size = sizeof(Handler_Transmit_Buffer) - npdu_len;
+#if BACNET_SEGMENTATION_ENABLED
+        if (service_data->segmented_response_accepted) {
+            /* a large ACK is sent in segments by the TSM */
+            apdu = &Handler_Segmented_Buffer[0];
+            apdu_size = sizeof(Handler_Segmented_Buffer);
+        }
+#endif
+    }
     if (npdu_len <= 0) {
         /* If 0 or negative, there were problems with the data or encoding. */
         len = BACNET_STATUS_ABORT;
@@ -141,20 +154,17 @@ void handler_read_property(uint8_t *service_request,
             }
 #endif
             apdu_len = rp_ack_encode_apdu_init(
-                &Handler_Transmit_Buffer[npdu_len], service_data->invoke_id,
-                &rpdata);
+                &apdu[0], service_data->invoke_id, &rpdata);
             /* configure our storage */
-            rpdata.application_data =
-                &Handler_Transmit_Buffer[npdu_len + apdu_len];
-            rpdata.application_data_len =
-                sizeof(Handler_Transmit_Buffer) - (npdu_len + apdu_len);
+            rpdata.application_data = &apdu[apdu_len];
+            rpdata.application_data_len = apdu_size - apdu_len;
             len = Device_Read_Property(&rpdata);
             if (len >= 0) {
                 apdu_len += len;
-                len = rp_ack_encode_apdu_object_property_end(
-                    &Handler_Transmit_Buffer[npdu_len + apdu_len]);
+                len = rp_ack_encode_apdu_object_property_end(&apdu[apdu_len]);
                 apdu_len += len;
-                if (apdu_len > service_data->max_resp) {
+                if ((apdu_len > service_data->max_resp) &&
+                    (apdu == &Handler_Transmit_Buffer[npdu_len])) {
                     /* too big for the sender - send an abort!
                        Setting of error code needed here as read property
                        processing may have overriden the default set at start */
@@ -212,6 +222,17 @@ void handler_read_property(uint8_t *service_request,
         }
     }
 
+#if BACNET_SEGMENTATION_ENABLED
+    if (!error && (apdu == &Handler_Segmented_Buffer[0])) {
+        if (!tsm_segmented_complex_ack_send(
+                src, &npdu_data, service_data, apdu, (uint16_t)apdu_len)) {
+#if PRINT_ENABLED
+            fprintf(stderr, "RP: Unable to send segmented Ack!\n");
+#endif
+        }
+        return;
+    }
+#endif
     pdu_len = npdu_len + apdu_len;
     bytes_sent = datalink_send_pdu(
         src, &npdu_data, &Handler_Transmit_Buffer[0], pdu_len);
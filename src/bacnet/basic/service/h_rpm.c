@@ -30,7 +30,6 @@
 #include <string.h>
 #include <errno.h>
 #include "bacnet/config.h"
-#include "bacnet/memcopy.h"
 #include "bacnet/bacdef.h"
 #include "bacnet/bacdcode.h"
 #include "bacnet/apdu.h"
@@ -50,7 +49,67 @@
 
 /** @file h_rpm.c  Handles Read Property Multiple requests. */
 
-static uint8_t Temp_Buf[MAX_APDU] = { 0 };
+/* largest part of a reply that is encoded at a time, other than
+   a property value: an object identifier or property identifier
+   with its tags, or an error */
+#define RPM_REPLY_PART_MAX 16
+
+/* The reply is encoded in place: each part is written at the end of
+   the reply, and is only kept if it fits within the size of the reply.
+   The objects encode property values assuming room for MAX_APDU octets,
+   so a part is only encoded in place when the buffer has that much room
+   past the end of the reply - otherwise it is encoded in a scratch
+   buffer and copied. */
+typedef struct rpm_reply {
+    uint8_t *apdu;
+    /* length of the reply */
+    unsigned len;
+    /* largest length of the reply */
+    unsigned size;
+    /* octets of the buffer from the start of the reply */
+    unsigned capacity;
+    /* for parts that do not fit in the rest of the buffer */
+    uint8_t *scratch;
+} RPM_REPLY;
+
+/* the NPDU and the reply, with room past the largest reply for
+   a property value to be encoded before it is known to fit */
+static BACNET_THREAD_LOCAL uint8_t RPM_Buffer[MAX_PDU + MAX_APDU + 2];
+
+/**
+ * @brief Get the place to encode the next part of the reply
+ * @param reply - reply being encoded
+ * @param len - the largest length of the part
+ * @return the end of the reply, or the scratch buffer
+ */
+static uint8_t *rpm_reply_tail(RPM_REPLY *reply, unsigned len)
+{
+    if ((reply->capacity - reply->len) >= len) {
+        return &reply->apdu[reply->len];
+    }
+
+    return reply->scratch;
+}
+
+/**
+ * @brief Keep a part that was encoded at the tail of the reply
+ * @param reply - reply being encoded
+ * @param part - the part, from rpm_reply_tail()
+ * @param len - length of the part
+ * @return true if the part fits in the reply
+ */
+static bool rpm_reply_commit(RPM_REPLY *reply, uint8_t *part, unsigned len)
+{
+    if ((reply->len + len) > reply->size) {
+        return false;
+    }
+    if (part != &reply->apdu[reply->len]) {
+        memmove(&reply->apdu[reply->len], part, len);
+    }
+    reply->len += len;
+
+    return true;
+}
 
 static BACNET_PROPERTY_ID RPM_Object_Property(
     struct special_property_list_t *pPropertyList,
@@ -104,32 +163,32 @@ static unsigned RPM_Object_Property_Count(
     return count;
 }
 
-/** Encode the RPM property returning the length of the encoding,
-   or 0 if there is no room to fit the encoding.  */
-static int RPM_Encode_Property(
-    uint8_t *apdu, uint16_t offset, uint16_t max_apdu, BACNET_RPM_DATA *rpmdata)
+/** Encode the RPM property at the end of the reply, returning the length
+   of the encoding, or an error status if there is no room to fit it.  */
+static int RPM_Encode_Property(RPM_REPLY *reply, BACNET_RPM_DATA *rpmdata)
 {
     int len = 0;
-    size_t copy_len = 0;
-    int apdu_len = 0;
+    unsigned start = reply->len;
+    uint8_t *part = NULL;
     BACNET_READ_PROPERTY_DATA rpdata;
 
+    part = rpm_reply_tail(reply, RPM_REPLY_PART_MAX);
     len = rpm_ack_encode_apdu_object_property(
-        &Temp_Buf[0], rpmdata->object_property, rpmdata->array_index);
-    copy_len = memcopy(&apdu[0], &Temp_Buf[0], offset, len, max_apdu);
-    if (copy_len == 0) {
+        part, rpmdata->object_property, rpmdata->array_index);
+    if (!rpm_reply_commit(reply, part, len)) {
         rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
         return BACNET_STATUS_ABORT;
     }
-    apdu_len += len;
+    /* the value is read in place, after room for its opening tag */
+    part = rpm_reply_tail(reply, 1 + MAX_APDU + 1);
     rpdata.error_class = ERROR_CLASS_OBJECT;
     rpdata.error_code = ERROR_CODE_UNKNOWN_OBJECT;
     rpdata.object_type = rpmdata->object_type;
     rpdata.object_instance = rpmdata->object_instance;
     rpdata.object_property = rpmdata->object_property;
     rpdata.array_index = rpmdata->array_index;
-    rpdata.application_data = &Temp_Buf[0];
-    rpdata.application_data_len = sizeof(Temp_Buf);
+    rpdata.application_data = &part[1];
+    rpdata.application_data_len = MAX_APDU;
     len = Device_Read_Property(&rpdata);
     if (len < 0) {
         if ((len == BACNET_STATUS_ABORT) || (len == BACNET_STATUS_REJECT)) {
@@ -138,27 +197,21 @@ static int RPM_Encode_Property(
             return len; /* Ie, Abort */
         }
         /* error was returned - encode that for the response */
+        part = rpm_reply_tail(reply, RPM_REPLY_PART_MAX);
         len = rpm_ack_encode_apdu_object_property_error(
-            &Temp_Buf[0], rpdata.error_class, rpdata.error_code);
-        copy_len =
-            memcopy(&apdu[0], &Temp_Buf[0], offset + apdu_len, len, max_apdu);
-
-        if (copy_len == 0) {
-            rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
-            return BACNET_STATUS_ABORT;
-        }
-    } else if ((offset + apdu_len + 1 + len + 1) < max_apdu) {
-        /* enough room to fit the property value and tags */
-        len = rpm_ack_encode_apdu_object_property_value(
-            &apdu[offset + apdu_len], &Temp_Buf[0], len);
+            part, rpdata.error_class, rpdata.error_code);
     } else {
+        /* add the tags around the property value */
+        len = rpm_ack_encode_apdu_object_property_value(part, &part[1], len);
+    }
+    if (!rpm_reply_commit(reply, part, len)) {
         /* not enough room - abort! */
+        reply->len = start;
         rpmdata->error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
         return BACNET_STATUS_ABORT;
     }
-    apdu_len += len;
 
-    return apdu_len;
+    return reply->len - start;
 }
 
 /** Handler for a ReadPropertyMultiple Service request.
@@ -187,26 +240,40 @@ void handler_read_property_multiple(uint8_t *service_request,
 {
     bool berror = false;
     int len = 0;
-    uint16_t copy_len = 0;
     uint16_t decode_len = 0;
     int pdu_len = 0;
     BACNET_NPDU_DATA npdu_data;
     int bytes_sent;
     BACNET_ADDRESS my_address;
     BACNET_RPM_DATA rpmdata;
+    RPM_REPLY reply;
     int apdu_len = 0;
     int npdu_len = 0;
     int error = 0;
+    uint8_t *part = NULL;
 
     if (service_data && (service_len > 0)) {
-        /* jps_debug - see if we are utilizing all the buffer */
-        /* memset(&Handler_Transmit_Buffer[0], 0xff,
-         * sizeof(Handler_Transmit_Buffer)); */
         /* encode the NPDU portion of the packet */
         datalink_get_my_address(&my_address);
         npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
-        npdu_len = npdu_encode_pdu(
-            &Handler_Transmit_Buffer[0], src, &my_address, &npdu_data);
+        npdu_len =
+            npdu_encode_pdu(&RPM_Buffer[0], src, &my_address, &npdu_data);
+        /* the reply is encoded where it is sent from */
+        reply.apdu = &RPM_Buffer[npdu_len];
+        reply.len = 0;
+        reply.size = MAX_APDU;
+        reply.capacity = sizeof(RPM_Buffer) - npdu_len;
+        reply.scratch = NULL;
+#if BACNET_SEGMENTATION_ENABLED
+        if (service_data->segmented_response_accepted) {
+            /* a large ACK is sent in segments by the TSM */
+            reply.apdu = &Handler_Segmented_Buffer[0];
+            reply.size = sizeof(Handler_Segmented_Buffer);
+            reply.capacity = sizeof(Handler_Segmented_Buffer);
+            /* the NPDU is kept for an error, abort, or reject */
+            reply.scratch = &RPM_Buffer[npdu_len];
+        }
+#endif
 
         if (service_data->segmented_message) {
             rpmdata.error_code = ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
@@ -217,8 +284,8 @@ void handler_read_property_multiple(uint8_t *service_request,
         } else {
             /* decode apdu request & encode apdu reply
                encode complex ack, invoke id, service choice */
-            apdu_len = rpm_ack_encode_apdu_init(
-                &Handler_Transmit_Buffer[npdu_len], service_data->invoke_id);
+            reply.len =
+                rpm_ack_encode_apdu_init(&reply.apdu[0], service_data->invoke_id);
 
             for (;;) {
                 /* Start by looking for an object ID */
@@ -259,10 +326,9 @@ void handler_read_property_multiple(uint8_t *service_request,
 #endif
 
                 /* Stick this object id into the reply - if it will fit */
-                len = rpm_ack_encode_apdu_object_begin(&Temp_Buf[0], &rpmdata);
-                copy_len = memcopy(&Handler_Transmit_Buffer[npdu_len],
-                    &Temp_Buf[0], apdu_len, len, MAX_APDU);
-                if (copy_len == 0) {
+                part = rpm_reply_tail(&reply, RPM_REPLY_PART_MAX);
+                len = rpm_ack_encode_apdu_object_begin(part, &rpmdata);
+                if (!rpm_reply_commit(&reply, part, len)) {
 #if PRINT_ENABLED
                     fprintf(stderr, "RPM: Response too big!\r\n");
 #endif
@@ -273,7 +339,6 @@ void handler_read_property_multiple(uint8_t *service_request,
                     break;
                 }
 
-                apdu_len += copy_len;
                 /* do each property of this object of the RPM request */
                 for (;;) {
                     /* Fetch a property */
@@ -303,15 +368,10 @@ void handler_read_property_multiple(uint8_t *service_request,
                         if (rpmdata.array_index != BACNET_ARRAY_ALL) {
                             /* No array index options for this special property.
                                Encode error for this object property response */
-                            len = rpm_ack_encode_apdu_object_property(
-                                &Temp_Buf[0], rpmdata.object_property,
-                                rpmdata.array_index);
-
-                            copy_len =
-                                memcopy(&Handler_Transmit_Buffer[npdu_len],
-                                    &Temp_Buf[0], apdu_len, len, MAX_APDU);
-
-                            if (copy_len == 0) {
+                            part = rpm_reply_tail(&reply, RPM_REPLY_PART_MAX);
+                            len = rpm_ack_encode_apdu_object_property(part,
+                                rpmdata.object_property, rpmdata.array_index);
+                            if (!rpm_reply_commit(&reply, part, len)) {
 #if PRINT_ENABLED
                                 fprintf(stderr,
                                     "RPM: Too full to encode property!\r\n");
@@ -323,17 +383,11 @@ void handler_read_property_multiple(uint8_t *service_request,
                                 break; // The berror flag ensures that both
                                        // loops will be broken!
                             }
-
-                            apdu_len += len;
+                            part = rpm_reply_tail(&reply, RPM_REPLY_PART_MAX);
                             len = rpm_ack_encode_apdu_object_property_error(
-                                &Temp_Buf[0], ERROR_CLASS_PROPERTY,
+                                part, ERROR_CLASS_PROPERTY,
                                 ERROR_CODE_PROPERTY_IS_NOT_AN_ARRAY);
-
-                            copy_len =
-                                memcopy(&Handler_Transmit_Buffer[npdu_len],
-                                    &Temp_Buf[0], apdu_len, len, MAX_APDU);
-
-                            if (copy_len == 0) {
+                            if (!rpm_reply_commit(&reply, part, len)) {
 #if PRINT_ENABLED
                                 fprintf(stderr,
                                     "RPM: Too full to encode error!\r\n");
@@ -345,7 +399,6 @@ void handler_read_property_multiple(uint8_t *service_request,
                                 break; // The berror flag ensures that both
                                        // loops will be broken!
                             }
-                            apdu_len += len;
                         } else {
                             special_object_property = rpmdata.object_property;
                             Device_Objects_Property_List(rpmdata.object_type,
@@ -367,12 +420,9 @@ void handler_read_property_multiple(uint8_t *service_request,
                                     rpmdata.object_property =
                                         RPM_Object_Property(&property_list,
                                             special_object_property, index);
-                                    len = RPM_Encode_Property(
-                                        &Handler_Transmit_Buffer[npdu_len],
-                                        (uint16_t)apdu_len, MAX_APDU, &rpmdata);
-                                    if (len > 0) {
-                                        apdu_len += len;
-                                    } else {
+                                    len =
+                                        RPM_Encode_Property(&reply, &rpmdata);
+                                    if (len <= 0) {
 #if PRINT_ENABLED
                                         fprintf(stderr,
                                             "RPM: Too full for property!\r\n");
@@ -387,12 +437,8 @@ void handler_read_property_multiple(uint8_t *service_request,
                         }
                     } else {
                         /* handle an individual property */
-                        len = RPM_Encode_Property(
-                            &Handler_Transmit_Buffer[npdu_len],
-                            (uint16_t)apdu_len, MAX_APDU, &rpmdata);
-                        if (len > 0) {
-                            apdu_len += len;
-                        } else {
+                        len = RPM_Encode_Property(&reply, &rpmdata);
+                        if (len <= 0) {
 #if PRINT_ENABLED
                             fprintf(stderr,
                                 "RPM: Too full for individual property!\r\n");
@@ -409,10 +455,9 @@ void handler_read_property_multiple(uint8_t *service_request,
                         /* Reached end of property list so cap the result list
                          */
                         decode_len++;
-                        len = rpm_ack_encode_apdu_object_end(&Temp_Buf[0]);
-                        copy_len = memcopy(&Handler_Transmit_Buffer[npdu_len],
-                            &Temp_Buf[0], apdu_len, len, MAX_APDU);
-                        if (copy_len == 0) {
+                        part = rpm_reply_tail(&reply, RPM_REPLY_PART_MAX);
+                        len = rpm_ack_encode_apdu_object_end(part);
+                        if (!rpm_reply_commit(&reply, part, len)) {
 #if PRINT_ENABLED
                             fprintf(stderr,
                                 "RPM: Too full to encode object end!\r\n");
@@ -423,8 +468,6 @@ void handler_read_property_multiple(uint8_t *service_request,
                             berror = true;
                             break; // The berror flag ensures that both loops
                                    // will be broken!
-                        } else {
-                            apdu_len += copy_len;
                         }
                         break; /* finished with this property list */
                     }
@@ -439,8 +482,8 @@ void handler_read_property_multiple(uint8_t *service_request,
             } // for(;;)
 
             /* If not having an error so far, check the remaining space. */
-            if (!berror) {
-                if (apdu_len > service_data->max_resp) {
+            if (!berror && (reply.apdu == &RPM_Buffer[npdu_len])) {
+                if (reply.len > (unsigned)service_data->max_resp) {
                     /* too big for the sender - send an abort */
                     rpmdata.error_code =
                         ERROR_CODE_ABORT_SEGMENTATION_NOT_SUPPORTED;
@@ -452,27 +495,28 @@ void handler_read_property_multiple(uint8_t *service_request,
                 }
             }
         }
+        apdu_len = reply.len;
 
         /* Error fallback. */
         if (error) {
             if (error == BACNET_STATUS_ABORT) {
-                apdu_len = abort_encode_apdu(&Handler_Transmit_Buffer[npdu_len],
+                apdu_len = abort_encode_apdu(&RPM_Buffer[npdu_len],
                     service_data->invoke_id,
                     abort_convert_error_code(rpmdata.error_code), true);
 #if PRINT_ENABLED
                 fprintf(stderr, "RPM: Sending Abort!\n");
 #endif
             } else if (error == BACNET_STATUS_ERROR) {
-                apdu_len = bacerror_encode_apdu(
-                    &Handler_Transmit_Buffer[npdu_len], service_data->invoke_id,
+                apdu_len = bacerror_encode_apdu(&RPM_Buffer[npdu_len],
+                    service_data->invoke_id,
                     SERVICE_CONFIRMED_READ_PROP_MULTIPLE, rpmdata.error_class,
                     rpmdata.error_code);
 #if PRINT_ENABLED
                 fprintf(stderr, "RPM: Sending Error!\n");
 #endif
             } else if (error == BACNET_STATUS_REJECT) {
-                apdu_len = reject_encode_apdu(
-                    &Handler_Transmit_Buffer[npdu_len], service_data->invoke_id,
+                apdu_len = reject_encode_apdu(&RPM_Buffer[npdu_len],
+                    service_data->invoke_id,
                     reject_convert_error_code(rpmdata.error_code));
 #if PRINT_ENABLED
                 fprintf(stderr, "RPM: Sending Reject!\n");
@@ -480,9 +524,20 @@ void handler_read_property_multiple(uint8_t *service_request,
             }
         }
 
+#if BACNET_SEGMENTATION_ENABLED
+        if (!error && (reply.apdu == &Handler_Segmented_Buffer[0])) {
+            if (!tsm_segmented_complex_ack_send(src, &npdu_data, service_data,
+                    reply.apdu, (uint16_t)apdu_len)) {
+#if PRINT_ENABLED
+                fprintf(stderr, "RPM: Unable to send segmented Ack!\n");
+#endif
+            }
+            return;
+        }
+#endif
         pdu_len = apdu_len + npdu_len;
-        bytes_sent = datalink_send_pdu(
-            src, &npdu_data, &Handler_Transmit_Buffer[0], pdu_len);
+        bytes_sent =
+            datalink_send_pdu(src, &npdu_data, &RPM_Buffer[0], pdu_len);
         if (bytes_sent <= 0) {
 #if PRINT_ENABLED
             fprintf(stderr, "RPM: Failed to send PDU (%s)!\n", strerror(errno));
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include "bacnet/bacdcode.h"
 #include "bacnet/event.h"
 #include "bacnet/dcc.h"
 /* some demo stuff needed */
@@ -108,6 +109,81 @@ uint8_t Send_CEvent_Notify_Address(uint8_t *pdu, uint16_t pdu_size,
     return invoke_id;
 }
 
+/** Sends a Confirmed Alarm/Event Notification whose service request was
+ * encoded earlier, for example while it waited for a free TSM slot.
+ * @ingroup EVNOTFCN
+ *
+ * @param pdu [in] the PDU buffer used for sending the message
+ * @param pdu_size [in] Size of the PDU buffer
+ * @param service_request [in] The notification, as encoded by
+ *  event_notify_encode_service_request()
+ * @param service_request_len [in] Number of bytes of the service request
+ * @param dest [in] BACNET_ADDRESS of the destination device
+ * @return invoke id of outgoing message, or 0 if communication is disabled,
+ *         or no tsm slot is available.
+ */
+uint8_t Send_CEvent_Notify_Encoded(uint8_t *pdu, uint16_t pdu_size,
+    uint8_t *service_request, uint16_t service_request_len,
+    BACNET_ADDRESS *dest)
+{
+    int pdu_len = 0;
+#if PRINT_ENABLED
+    int bytes_sent = 0;
+#endif
+    BACNET_NPDU_DATA npdu_data;
+    BACNET_ADDRESS my_address;
+    uint8_t invoke_id = 0;
+
+    if (!dcc_communication_enabled()) {
+        return 0;
+    }
+    if (!dest) {
+        return 0;
+    }
+    /* is there a tsm available? */
+    invoke_id = tsm_next_free_invokeID();
+    if (invoke_id) {
+        /* encode the NPDU portion of the packet */
+        datalink_get_my_address(&my_address);
+        npdu_encode_npdu_data(&npdu_data, true, MESSAGE_PRIORITY_NORMAL);
+        pdu_len = npdu_encode_pdu(pdu, dest, &my_address, &npdu_data);
+        /* will it fit in the sender? */
+        if ((pdu_len + 4 + service_request_len) < pdu_size) {
+            /* the APDU header, with our invoke id, and the request */
+            pdu[pdu_len] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
+            pdu[pdu_len + 1] = encode_max_segs_max_apdu(0, MAX_APDU);
+            pdu[pdu_len + 2] = invoke_id;
+            pdu[pdu_len + 3] = SERVICE_CONFIRMED_EVENT_NOTIFICATION;
+            pdu_len += 4;
+            memcpy(&pdu[pdu_len], service_request, service_request_len);
+            pdu_len += service_request_len;
+            tsm_set_confirmed_unsegmented_transaction(invoke_id, dest,
+                &npdu_data, pdu, (uint16_t)pdu_len);
+#if PRINT_ENABLED
+            bytes_sent =
+#endif
+                datalink_send_pdu(dest, &npdu_data, pdu, pdu_len);
+#if PRINT_ENABLED
+            if (bytes_sent <= 0) {
+                fprintf(stderr,
+                    "Failed to Send ConfirmedEventNotification Request (%s)!\n",
+                    strerror(errno));
+            }
+#endif
+        } else {
+            tsm_free_invoke_id(invoke_id);
+            invoke_id = 0;
+#if PRINT_ENABLED
+            fprintf(stderr,
+                "Failed to Send ConfirmedEventNotification Request "
+                "(exceeds destination maximum APDU)!\n");
+#endif
+        }
+    }
+
+    return invoke_id;
+}
+
 /** Sends an Confirmed Alarm/Event Notification.
  * @ingroup EVNOTFCN
  *
@@ -0,0 +1,351 @@
+/**
+ * @file
+ * @brief Hashed table of keyed rows, with the data of the rows kept
+ *  in separate column arrays
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bacnet/basic/sys/keytable.h"
+
+/* minimum number of rows to allocate memory for */
+#define KEYTABLE_CHUNK 8
+
+/**
+ * @brief Hash a key into one of the hash chains
+ * @param table - table with a power of two number of chains
+ * @param key - key of the row
+ * @return the hash chain of the key
+ */
+static uint32_t keytable_hash(const KEYTABLE *table, KEY key)
+{
+    uint32_t hash = (uint32_t)key * 0x9E3779B1UL;
+
+    hash ^= hash >> 16;
+
+    return hash & (table->bucket_count - 1);
+}
+
+/**
+ * @brief Link each row into its hash chain
+ * @param table - table to be indexed
+ */
+static void keytable_rehash(KEYTABLE *table)
+{
+    uint32_t i = 0;
+    uint32_t bucket = 0;
+
+    for (i = 0; i < table->bucket_count; i++) {
+        table->buckets[i] = KEYTABLE_INDEX_NONE;
+    }
+    for (i = 0; i < table->count; i++) {
+        bucket = keytable_hash(table, table->keys[i]);
+        table->next[i] = table->buckets[bucket];
+        table->buckets[bucket] = i;
+    }
+}
+
+/**
+ * @brief Resize one array, and zero the new elements
+ * @param data - pointer to the array, which is changed on success
+ * @param size - size of each element
+ * @param old_count - number of elements in the array
+ * @param new_count - number of elements wanted
+ * @return true if the array was resized
+ */
+static bool keytable_array_resize(
+    void **data, size_t size, uint32_t old_count, uint32_t new_count)
+{
+    uint8_t *array = NULL;
+
+    array = realloc(*data, (size_t)new_count * size);
+    if (!array) {
+        return false;
+    }
+    if (new_count > old_count) {
+        memset(&array[(size_t)old_count * size], 0,
+            (size_t)(new_count - old_count) * size);
+    }
+    *data = array;
+
+    return true;
+}
+
+/**
+ * @brief Initialize an empty table without any columns
+ * @param table - table to be initialized
+ */
+void Keytable_Init(KEYTABLE *table)
+{
+    if (table) {
+        memset(table, 0, sizeof(KEYTABLE));
+    }
+}
+
+/**
+ * @brief Add a column to the table.  The array is allocated, and kept
+ *  as large as the rows of the table, in the owner's pointer.
+ * @param table - table to add the column to
+ * @param data - the owner's pointer to the array of the column
+ * @param size - size of each element of the array
+ * @return true if the column was added
+ */
+bool Keytable_Column_Add(KEYTABLE *table, void **data, size_t size)
+{
+    if (!table || !data || (size == 0)) {
+        return false;
+    }
+    if (table->column_count >= KEYTABLE_COLUMNS_MAX) {
+        return false;
+    }
+    *data = NULL;
+    if (table->size) {
+        if (!keytable_array_resize(data, size, 0, table->size)) {
+            return false;
+        }
+    }
+    table->columns[table->column_count].data = data;
+    table->columns[table->column_count].size = size;
+    table->column_count++;
+
+    return true;
+}
+
+/**
+ * @brief Allocate memory for a number of rows, so that they can be
+ *  added without allocating more.
+ * @param table - table to be grown
+ * @param size - number of rows
+ * @return true if there is memory for the rows
+ */
+bool Keytable_Reserve(KEYTABLE *table, uint32_t size)
+{
+    uint32_t bucket_count = KEYTABLE_CHUNK;
+    unsigned i = 0;
+    void *data = NULL;
+
+    if (!table) {
+        return false;
+    }
+    if (size <= table->size) {
+        return true;
+    }
+    for (i = 0; i < table->column_count; i++) {
+        if (!keytable_array_resize(table->columns[i].data,
+                table->columns[i].size, table->size, size)) {
+            return false;
+        }
+    }
+    data = table->keys;
+    if (!keytable_array_resize(&data, sizeof(KEY), table->size, size)) {
+        return false;
+    }
+    table->keys = data;
+    data = table->next;
+    if (!keytable_array_resize(&data, sizeof(uint32_t), table->size, size)) {
+        return false;
+    }
+    table->next = data;
+    /* keep a chain for each row */
+    while (bucket_count < size) {
+        bucket_count <<= 1;
+    }
+    if (bucket_count != table->bucket_count) {
+        data = table->buckets;
+        if (!keytable_array_resize(&data, sizeof(uint32_t),
+                table->bucket_count, bucket_count)) {
+            return false;
+        }
+        table->buckets = data;
+        table->bucket_count = bucket_count;
+        keytable_rehash(table);
+    }
+    table->size = size;
+
+    return true;
+}
+
+/**
+ * @brief Find the row of a key
+ * @param table - table to search
+ * @param key - key of the row
+ * @return the index of the row, or KEYTABLE_INDEX_NONE if not found
+ */
+uint32_t Keytable_Index(const KEYTABLE *table, KEY key)
+{
+    uint32_t index = KEYTABLE_INDEX_NONE;
+
+    if (table && table->count) {
+        index = table->buckets[keytable_hash(table, key)];
+        while (index != KEYTABLE_INDEX_NONE) {
+            if (table->keys[index] == key) {
+                break;
+            }
+            index = table->next[index];
+        }
+    }
+
+    return index;
+}
+
+/**
+ * @brief Add a row for a key, growing the table if needed.
+ *  The columns of the new row are zero.
+ * @param table - table to add the row to
+ * @param key - key of the row
+ * @return the index of the new row, or KEYTABLE_INDEX_NONE if the key
+ *  is already in the table or there is no memory for the row
+ */
+uint32_t Keytable_Add(KEYTABLE *table, KEY key)
+{
+    uint32_t index = KEYTABLE_INDEX_NONE;
+    uint32_t bucket = 0;
+    uint32_t size = 0;
+
+    if (!table) {
+        return KEYTABLE_INDEX_NONE;
+    }
+    if (Keytable_Index(table, key) != KEYTABLE_INDEX_NONE) {
+        return KEYTABLE_INDEX_NONE;
+    }
+    if (table->count == table->size) {
+        size = table->size * 2;
+        if (size < KEYTABLE_CHUNK) {
+            size = KEYTABLE_CHUNK;
+        }
+        if (!Keytable_Reserve(table, size)) {
+            return KEYTABLE_INDEX_NONE;
+        }
+    }
+    index = table->count;
+    table->keys[index] = key;
+    bucket = keytable_hash(table, key);
+    table->next[index] = table->buckets[bucket];
+    table->buckets[bucket] = index;
+    table->count++;
+
+    return index;
+}
+
+/**
+ * @brief Find the link in a hash chain that points to a row
+ * @param table - table to search
+ * @param index - index of the row
+ * @return pointer to the link
+ */
+static uint32_t *keytable_link(KEYTABLE *table, uint32_t index)
+{
+    uint32_t *link = NULL;
+
+    link = &table->buckets[keytable_hash(table, table->keys[index])];
+    while (*link != index) {
+        link = &table->next[*link];
+    }
+
+    return link;
+}
+
+/**
+ * @brief Delete the row of a key.  The last row is moved into its
+ *  place, so the index of the last row changes.
+ * @param table - table to delete the row from
+ * @param key - key of the row
+ * @return true if the row was found and deleted
+ */
+bool Keytable_Delete(KEYTABLE *table, KEY key)
+{
+    uint32_t index = 0;
+    uint32_t last = 0;
+    uint32_t *link = NULL;
+    uint8_t *array = NULL;
+    size_t size = 0;
+    unsigned i = 0;
+
+    index = Keytable_Index(table, key);
+    if (index == KEYTABLE_INDEX_NONE) {
+        return false;
+    }
+    link = keytable_link(table, index);
+    *link = table->next[index];
+    last = table->count - 1;
+    if (index != last) {
+        /* move the last row into the hole */
+        link = keytable_link(table, last);
+        *link = index;
+        table->next[index] = table->next[last];
+        table->keys[index] = table->keys[last];
+        for (i = 0; i < table->column_count; i++) {
+            array = *table->columns[i].data;
+            size = table->columns[i].size;
+            memcpy(&array[(size_t)index * size], &array[(size_t)last * size],
+                size);
+        }
+    }
+    for (i = 0; i < table->column_count; i++) {
+        array = *table->columns[i].data;
+        size = table->columns[i].size;
+        memset(&array[(size_t)last * size], 0, size);
+    }
+    table->count--;
+
+    return true;
+}
+
+/**
+ * @brief Get the key of a row
+ * @param table - table of the row
+ * @param index - index of the row
+ * @return the key of the row, or zero if the index is not in use
+ */
+KEY Keytable_Key(const KEYTABLE *table, uint32_t index)
+{
+    if (table && (index < table->count)) {
+        return table->keys[index];
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the number of rows in use
+ * @param table - table of the rows
+ * @return the number of rows
+ */
+uint32_t Keytable_Count(const KEYTABLE *table)
+{
+    if (table) {
+        return table->count;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Delete all the rows, and free the memory of the table and
+ *  its columns.  The columns remain in the table.
+ * @param table - table to be cleared
+ */
+void Keytable_Clear(KEYTABLE *table)
+{
+    unsigned i = 0;
+
+    if (!table) {
+        return;
+    }
+    for (i = 0; i < table->column_count; i++) {
+        free(*table->columns[i].data);
+        *table->columns[i].data = NULL;
+    }
+    free(table->keys);
+    table->keys = NULL;
+    free(table->next);
+    table->next = NULL;
+    free(table->buckets);
+    table->buckets = NULL;
+    table->bucket_count = 0;
+    table->count = 0;
+    table->size = 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Hashed table of keyed rows, with the data of the rows kept
+ *  in separate column arrays
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#ifndef KEYTABLE_H
+#define KEYTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bacnet/bacnet_stack_exports.h"
+#include "key.h"
+
+/* The rows of the table are kept packed in the first count entries of
+   each column, so that a column can be scanned as a plain array.  A row
+   is found by its key with a hash index.  Deleting a row moves the last
+   row into its place, which changes the index of the last row. */
+
+/* maximum number of columns in a table */
+#ifndef KEYTABLE_COLUMNS_MAX
+#define KEYTABLE_COLUMNS_MAX 8
+#endif
+
+/* returned as the index of a key that is not in the table */
+#define KEYTABLE_INDEX_NONE UINT32_MAX
+
+/* a column is an array that is grown with the rows of the table */
+struct Keytable_Column {
+    /* the owner's pointer to the array */
+    void **data;
+    /* size of each element of the array */
+    size_t size;
+};
+
+typedef struct Keytable {
+    /* key of each row */
+    KEY *keys;
+    /* next row in the hash chain of each row */
+    uint32_t *next;
+    /* first row of each hash chain */
+    uint32_t *buckets;
+    /* number of hash chains - a power of two */
+    uint32_t bucket_count;
+    /* number of rows in use */
+    uint32_t count;
+    /* number of rows allocated */
+    uint32_t size;
+    struct Keytable_Column columns[KEYTABLE_COLUMNS_MAX];
+    unsigned column_count;
+} KEYTABLE;
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+    BACNET_STACK_EXPORT
+    void Keytable_Init(
+        KEYTABLE * table);
+    BACNET_STACK_EXPORT
+    bool Keytable_Column_Add(
+        KEYTABLE * table,
+        void **data,
+        size_t size);
+    BACNET_STACK_EXPORT
+    bool Keytable_Reserve(
+        KEYTABLE * table,
+        uint32_t size);
+    BACNET_STACK_EXPORT
+    uint32_t Keytable_Add(
+        KEYTABLE * table,
+        KEY key);
+    BACNET_STACK_EXPORT
+    bool Keytable_Delete(
+        KEYTABLE * table,
+        KEY key);
+    BACNET_STACK_EXPORT
+    uint32_t Keytable_Index(
+        const KEYTABLE * table,
+        KEY key);
+    BACNET_STACK_EXPORT
+    KEY Keytable_Key(
+        const KEYTABLE * table,
+        uint32_t index);
+    BACNET_STACK_EXPORT
+    uint32_t Keytable_Count(
+        const KEYTABLE * table);
+    BACNET_STACK_EXPORT
+    void Keytable_Clear(
+        KEYTABLE * table);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif
@@ -35,7 +35,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include "bacnet/bits.h"
+#include "bacnet/abort.h"
 #include "bacnet/apdu.h"
 #include "bacnet/bacaddr.h"
 #include "bacnet/bacdef.h"
@@ -49,7 +51,10 @@
 
 /** @file tsm.c  BACnet Transaction State Machine operations  */
 /* FIXME: modify basic service handlers to use TSM rather than this buffer! */
-uint8_t Handler_Transmit_Buffer[MAX_PDU];
+BACNET_THREAD_LOCAL uint8_t Handler_Transmit_Buffer[MAX_PDU];
+#if BACNET_SEGMENTATION_ENABLED
+BACNET_THREAD_LOCAL uint8_t Handler_Segmented_Buffer[MAX_APDU_SEGMENTED];
+#endif
 
 #if (MAX_TSM_TRANSACTIONS)
 /* Really only needed for segmented messages */
@@ -57,12 +62,47 @@ uint8_t Handler_Transmit_Buffer[MAX_PDU];
 /* If we are only a server and only initiate broadcasts, */
 /* then we don't need a TSM layer. */
 
-/* FIXME: not coded for segmentation */
+#if (MAX_TSM_TRANSACTIONS > 255)
+#error "MAX_TSM_TRANSACTIONS must be 255 or less"
+#endif
+#if BACNET_SEGMENTATION_ENABLED && (MAX_APDU_SEGMENTED > 65535)
+#error "MAX_APDU_SEGMENTED must be 65535 or less"
+#endif
 
 /* declare space for the TSM transactions, and set it up in the init. */
 /* table rules: an Invoke ID = 0 is an unused spot in the table */
 static BACNET_TSM_DATA TSM_List[MAX_TSM_TRANSACTIONS];
 
+/* marks the end of a free list or timer list */
+#define TSM_INDEX_NONE 0xFF
+
+/* invoke ID to table index + 1, or zero if the invoke ID is not in use */
+static uint8_t TSM_Invoke_Index[256];
+/* stack of unused table entries */
+static uint8_t TSM_Free_List[MAX_TSM_TRANSACTIONS];
+static uint8_t TSM_Free_Count;
+static bool TSM_Initialized;
+
+/* The request timers are kept on a hashed timer wheel so that each
+   call to tsm_timer_milliseconds() only visits the entries that are
+   due in the elapsed ticks, rather than every transaction. */
+#if !defined(TSM_TIMER_WHEEL_SLOTS)
+#define TSM_TIMER_WHEEL_SLOTS 64
+#endif
+#if !defined(TSM_TIMER_TICK_MILLISECONDS)
+#define TSM_TIMER_TICK_MILLISECONDS 10
+#endif
+static struct TSM_Timer_Node {
+    uint32_t expire_tick;
+    uint8_t prev;
+    uint8_t next;
+    bool armed;
+} TSM_Timer[MAX_TSM_TRANSACTIONS];
+static uint8_t TSM_Timer_Wheel[TSM_TIMER_WHEEL_SLOTS];
+/* last tick processed, and milliseconds not yet counted as a tick */
+static uint32_t TSM_Timer_Tick;
+static uint16_t TSM_Timer_Remainder;
+
 /* invoke ID for incrementing between subsequent calls. */
 static uint8_t Current_Invoke_ID = 1;
 
@@ -73,48 +113,104 @@ void tsm_set_timeout_handler(tsm_timeout_function pFunction)
     Timeout_Function = pFunction;
 }
 
-/** Find the given Invoke-Id in the list and
- *  return the index.
- *
- * @param invokeID  Invoke Id
- *
- * @return Index of the id or MAX_TSM_TRANSACTIONS
- *         if not found
+/** Set up the free list, invoke ID index and timer wheel on first use.
  */
-static uint8_t tsm_find_invokeID_index(uint8_t invokeID)
+static void tsm_init_check(void)
 {
     unsigned i = 0; /* counter */
-    uint8_t index = MAX_TSM_TRANSACTIONS; /* return value */
 
-    const BACNET_TSM_DATA *plist = TSM_List;
+    if (TSM_Initialized) {
+        return;
+    }
+    TSM_Initialized = true;
+    for (i = 0; i < 256; i++) {
+        TSM_Invoke_Index[i] = 0;
+    }
+    /* push backwards so the lowest index is handed out first */
+    TSM_Free_Count = 0;
+    i = MAX_TSM_TRANSACTIONS;
+    while (i > 0) {
+        i--;
+        TSM_List[i].InvokeID = 0;
+        TSM_List[i].state = TSM_STATE_IDLE;
+        TSM_Timer[i].armed = false;
+        TSM_Free_List[TSM_Free_Count++] = (uint8_t)i;
+    }
+    for (i = 0; i < TSM_TIMER_WHEEL_SLOTS; i++) {
+        TSM_Timer_Wheel[i] = TSM_INDEX_NONE;
+    }
+    TSM_Timer_Tick = 0;
+    TSM_Timer_Remainder = 0;
+}
 
-    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++, plist++) {
-        if (plist->InvokeID == invokeID) {
-            index = (uint8_t)i;
-            break;
-        }
+/** Remove a transaction from the timer wheel.
+ *
+ * @param index  Index of the transaction
+ */
+static void tsm_timer_stop(uint8_t index)
+{
+    struct TSM_Timer_Node *node = &TSM_Timer[index];
+
+    if (!node->armed) {
+        return;
+    }
+    if (node->prev != TSM_INDEX_NONE) {
+        TSM_Timer[node->prev].next = node->next;
+    } else {
+        TSM_Timer_Wheel[node->expire_tick % TSM_TIMER_WHEEL_SLOTS] =
+            node->next;
     }
+    if (node->next != TSM_INDEX_NONE) {
+        TSM_Timer[node->next].prev = node->prev;
+    }
+    node->armed = false;
+}
 
-    return index;
+/** Put a transaction on the timer wheel, replacing any running timer.
+ *
+ * @param index  Index of the transaction
+ * @param milliseconds  Time until the timer expires
+ */
+static void tsm_timer_start(uint8_t index, uint16_t milliseconds)
+{
+    struct TSM_Timer_Node *node = &TSM_Timer[index];
+    uint32_t ticks;
+    unsigned slot;
+
+    tsm_timer_stop(index);
+    TSM_List[index].RequestTimer = milliseconds;
+    /* round up so that the timer never expires early */
+    ticks = ((uint32_t)milliseconds + TSM_TIMER_TICK_MILLISECONDS - 1) /
+        TSM_TIMER_TICK_MILLISECONDS;
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    node->expire_tick = TSM_Timer_Tick + ticks;
+    slot = node->expire_tick % TSM_TIMER_WHEEL_SLOTS;
+    node->prev = TSM_INDEX_NONE;
+    node->next = TSM_Timer_Wheel[slot];
+    if (node->next != TSM_INDEX_NONE) {
+        TSM_Timer[node->next].prev = index;
+    }
+    TSM_Timer_Wheel[slot] = index;
+    node->armed = true;
 }
 
-/** Find the first free index in the TSM table.
+/** Find the given Invoke-Id in the list and
+ *  return the index.
+ *
+ * @param invokeID  Invoke Id
  *
  * @return Index of the id or MAX_TSM_TRANSACTIONS
- *         if no entry is free.
+ *         if not found
  */
-static uint8_t tsm_find_first_free_index(void)
+static uint8_t tsm_find_invokeID_index(uint8_t invokeID)
 {
-    unsigned i = 0; /* counter */
     uint8_t index = MAX_TSM_TRANSACTIONS; /* return value */
 
-    const BACNET_TSM_DATA *plist = TSM_List;
-
-    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++, plist++) {
-        if (plist->InvokeID == 0) {
-            index = (uint8_t)i;
-            break;
-        }
+    tsm_init_check();
+    if ((invokeID != 0) && (TSM_Invoke_Index[invokeID] != 0)) {
+        index = TSM_Invoke_Index[invokeID] - 1;
     }
 
     return index;
@@ -126,20 +222,9 @@ static uint8_t tsm_find_first_free_index(void)
  */
 bool tsm_transaction_available(void)
 {
-    bool status = false; /* return value */
-    unsigned i = 0; /* counter */
-
-    const BACNET_TSM_DATA *plist = TSM_List;
-
-    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++, plist++) {
-        if (plist->InvokeID == 0) {
-            /* one is available! */
-            status = true;
-            break;
-        }
-    }
+    tsm_init_check();
 
-    return status;
+    return (TSM_Free_Count > 0);
 }
 
 /** Return the count of idle transaction.
@@ -148,19 +233,9 @@ bool tsm_transaction_available(void)
  */
 uint8_t tsm_transaction_idle_count(void)
 {
-    uint8_t count = 0; /* return value */
-    unsigned i = 0; /* counter */
-
-    const BACNET_TSM_DATA *plist = TSM_List;
-
-    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++, plist++) {
-        if ((plist->InvokeID == 0) && (plist->state == TSM_STATE_IDLE)) {
-            /* one is available! */
-            count++;
-        }
-    }
+    tsm_init_check();
 
-    return count;
+    return TSM_Free_Count;
 }
 
 /**
@@ -186,41 +261,33 @@ uint8_t tsm_next_free_invokeID(void)
 {
     uint8_t index = 0;
     uint8_t invokeID = 0;
-    bool found = false;
     BACNET_TSM_DATA *plist = NULL;
 
     /* Is there even space available? */
     if (tsm_transaction_available()) {
-        while (!found) {
-            index = tsm_find_invokeID_index(Current_Invoke_ID);
-            if (index == MAX_TSM_TRANSACTIONS) {
-                /* Not found, so this invokeID is not used */
-                found = true;
-                /* set this id into the table */
-                index = tsm_find_first_free_index();
-                if (index != MAX_TSM_TRANSACTIONS) {
-                    plist = &TSM_List[index];
-                    plist->InvokeID = invokeID = Current_Invoke_ID;
-                    plist->state = TSM_STATE_IDLE;
-                    plist->RequestTimer = apdu_timeout();
-                    /* update for the next call or check */
-                    Current_Invoke_ID++;
-                    /* skip zero - we treat that internally as invalid or no
-                     * free */
-                    if (Current_Invoke_ID == 0) {
-                        Current_Invoke_ID = 1;
-                    }
-                }
-            } else {
-                /* found! This invokeID is already used */
-                /* try next one */
-                Current_Invoke_ID++;
-                /* skip zero - we treat that internally as invalid or no free */
-                if (Current_Invoke_ID == 0) {
-                    Current_Invoke_ID = 1;
-                }
+        /* there are fewer transactions than invoke IDs,
+           so an unused invoke ID will be found */
+        while (TSM_Invoke_Index[Current_Invoke_ID] != 0) {
+            /* This invokeID is already used, try next one */
+            Current_Invoke_ID++;
+            /* skip zero - we treat that internally as invalid or no free */
+            if (Current_Invoke_ID == 0) {
+                Current_Invoke_ID = 1;
             }
         }
+        /* set this id into the table */
+        index = TSM_Free_List[--TSM_Free_Count];
+        plist = &TSM_List[index];
+        plist->InvokeID = invokeID = Current_Invoke_ID;
+        plist->state = TSM_STATE_IDLE;
+        plist->RequestTimer = apdu_timeout();
+        TSM_Invoke_Index[invokeID] = index + 1;
+        /* update for the next call or check */
+        Current_Invoke_ID++;
+        /* skip zero - we treat that internally as invalid or no free */
+        if (Current_Invoke_ID == 0) {
+            Current_Invoke_ID = 1;
+        }
     }
 
     return invokeID;
@@ -253,7 +320,7 @@ void tsm_set_confirmed_unsegmented_transaction(uint8_t invokeID,
             plist->state = TSM_STATE_AWAIT_CONFIRMATION;
             plist->RetryCount = 0;
             /* start the timer */
-            plist->RequestTimer = apdu_timeout();
+            tsm_timer_start(index, apdu_timeout());
             /* copy the data */
             for (j = 0; j < apdu_len; j++) {
                 plist->apdu[j] = apdu[j];
@@ -314,6 +381,796 @@ bool tsm_get_transaction_pdu(uint8_t invokeID,
     return found;
 }
 
+#if BACNET_SEGMENTATION_ENABLED
+/* segmented messages being sent or received */
+static BACNET_TSM_SEGMENTED_DATA
+    TSM_Segmented_List[MAX_TSM_SEGMENTED_TRANSACTIONS];
+/* each segment, SegmentACK or Abort is built here for sending */
+static BACNET_THREAD_LOCAL uint8_t TSM_Segment_PDU[MAX_PDU];
+/* Service handlers that run on several threads at once may each call
+   tsm_segmented_complex_ack_send(); everything else in the TSM is only
+   used by one thread at a time. */
+static tsm_lock_function Segmented_Lock_Function;
+
+/* octets in front of the service data in each segment */
+#define TSM_SEGMENTED_REQUEST_HEADER_LEN 6
+#define TSM_SEGMENTED_COMPLEX_ACK_HEADER_LEN 5
+/* the sequence number is one octet */
+#define TSM_SEGMENTS_MAX 256
+
+/** Encode the NPDU, then send a header followed by some service data.
+ *
+ * @param dest  Pointer to the BACnet destination address.
+ * @param npdu_data  Pointer to the NPDU structure.
+ * @param header  APDU header octets
+ * @param header_len  Number of header octets
+ * @param data  Service data octets, or NULL
+ * @param data_len  Number of service data octets
+ */
+static void tsm_segmented_pdu_send(BACNET_ADDRESS *dest,
+    BACNET_NPDU_DATA *npdu_data,
+    uint8_t *header,
+    unsigned header_len,
+    uint8_t *data,
+    unsigned data_len)
+{
+    BACNET_ADDRESS my_address;
+    int pdu_len = 0;
+
+    datalink_get_my_address(&my_address);
+    pdu_len =
+        npdu_encode_pdu(&TSM_Segment_PDU[0], dest, &my_address, npdu_data);
+    if ((pdu_len <= 0) ||
+        ((pdu_len + header_len + data_len) > sizeof(TSM_Segment_PDU))) {
+        return;
+    }
+    memcpy(&TSM_Segment_PDU[pdu_len], header, header_len);
+    pdu_len += header_len;
+    if (data && data_len) {
+        memcpy(&TSM_Segment_PDU[pdu_len], data, data_len);
+        pdu_len += data_len;
+    }
+    datalink_send_pdu(dest, npdu_data, &TSM_Segment_PDU[0], pdu_len);
+}
+
+/** Send an Abort for a segmented message.
+ *
+ * @param dest  Pointer to the BACnet destination address.
+ * @param invokeID  Invoke-ID
+ * @param server  True if this device is the server of the transaction
+ * @param reason  Abort reason, see ABORT_REASON_X enumeration
+ */
+static void tsm_segmented_abort_send(
+    BACNET_ADDRESS *dest, uint8_t invokeID, bool server, uint8_t reason)
+{
+    BACNET_NPDU_DATA npdu_data;
+    uint8_t apdu[3];
+    int apdu_len = 0;
+
+    npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    apdu_len = abort_encode_apdu(&apdu[0], invokeID, reason, server);
+    tsm_segmented_pdu_send(dest, &npdu_data, &apdu[0], apdu_len, NULL, 0);
+}
+
+/** Send a SegmentACK for the segments received so far.
+ *
+ * @param pseg  Segmented message being received
+ * @param nak  True if a segment was received out of order
+ * @param sequence_number  The last segment received in order
+ */
+static void tsm_segment_ack_send(
+    BACNET_TSM_SEGMENTED_DATA *pseg, bool nak, uint8_t sequence_number)
+{
+    uint8_t apdu[4];
+
+    apdu[0] = PDU_TYPE_SEGMENT_ACK;
+    if (nak) {
+        apdu[0] |= BIT(1);
+    }
+    if (pseg->server) {
+        apdu[0] |= BIT(0);
+    }
+    apdu[1] = pseg->InvokeID;
+    apdu[2] = sequence_number;
+    apdu[3] = pseg->ActualWindowSize;
+    tsm_segmented_pdu_send(
+        &pseg->peer, &pseg->npdu_data, &apdu[0], sizeof(apdu), NULL, 0);
+}
+
+/** Find a segmented message by its invoke ID and our part in it.
+ *
+ * @param peer  Address of the peer, or NULL to match any peer
+ * @param invokeID  Invoke-ID
+ * @param server  True if this device is the server of the transaction
+ *
+ * @return the segmented message, or NULL if not found
+ */
+static BACNET_TSM_SEGMENTED_DATA *tsm_segmented_find(
+    BACNET_ADDRESS *peer, uint8_t invokeID, bool server)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_SEGMENTED_TRANSACTIONS; i++) {
+        pseg = &TSM_Segmented_List[i];
+        if ((pseg->state != TSM_STATE_IDLE) && (pseg->server == server) &&
+            (pseg->InvokeID == invokeID) &&
+            ((peer == NULL) || bacnet_address_same(&pseg->peer, peer))) {
+            return pseg;
+        }
+    }
+
+    return NULL;
+}
+
+/** Find an unused segmented message.
+ *
+ * @return the segmented message, or NULL if all are in use
+ */
+static BACNET_TSM_SEGMENTED_DATA *tsm_segmented_alloc(void)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_SEGMENTED_TRANSACTIONS; i++) {
+        if (TSM_Segmented_List[i].state == TSM_STATE_IDLE) {
+            return &TSM_Segmented_List[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void tsm_segmented_release(BACNET_TSM_SEGMENTED_DATA *pseg)
+{
+    pseg->state = TSM_STATE_IDLE;
+    pseg->SegmentTimer = 0;
+    pseg->data_len = 0;
+}
+
+/** Mark the client transaction as failed, as if it had timed out.
+ *
+ * @param invokeID  Invoke-ID
+ */
+static void tsm_segmented_client_failed(uint8_t invokeID)
+{
+    uint8_t index;
+
+    index = tsm_find_invokeID_index(invokeID);
+    if (index < MAX_TSM_TRANSACTIONS) {
+        tsm_timer_stop(index);
+        TSM_List[index].state = TSM_STATE_IDLE;
+        if (Timeout_Function) {
+            Timeout_Function(invokeID);
+        }
+    }
+}
+
+/** Check if we are sending this segmented message, rather than
+ *  receiving it.
+ *
+ * @param pseg  Segmented message
+ *
+ * @return true if we are sending the segments
+ */
+static bool tsm_segmented_sending(BACNET_TSM_SEGMENTED_DATA *pseg)
+{
+    if (pseg->server) {
+        return (pseg->state == TSM_STATE_SEGMENTED_RESPONSE);
+    }
+
+    return (pseg->state == TSM_STATE_SEGMENTED_REQUEST);
+}
+
+/** FillWindow: send the segments of a window, beginning with
+ *  the given sequence number.
+ *
+ * @param pseg  Segmented message being sent
+ * @param sequence_number  First segment of the window
+ */
+static void tsm_segmented_fill_window(
+    BACNET_TSM_SEGMENTED_DATA *pseg, uint8_t sequence_number)
+{
+    uint8_t header[TSM_SEGMENTED_REQUEST_HEADER_LEN];
+    unsigned header_len = 0;
+    unsigned segment = 0;
+    unsigned offset = 0;
+    unsigned len = 0;
+    unsigned ix = 0;
+    bool more_follows = false;
+
+    for (ix = 0; ix < pseg->ActualWindowSize; ix++) {
+        segment = (unsigned)sequence_number + ix;
+        if (segment >= pseg->segment_count) {
+            break;
+        }
+        offset = segment * pseg->segment_size;
+        len = pseg->data_len - offset;
+        if (len > pseg->segment_size) {
+            len = pseg->segment_size;
+        }
+        more_follows = ((segment + 1) < pseg->segment_count);
+        if (pseg->server) {
+            header[0] = PDU_TYPE_COMPLEX_ACK | BIT(3);
+            if (more_follows) {
+                header[0] |= BIT(2);
+            }
+            header[1] = pseg->InvokeID;
+            header[2] = (uint8_t)segment;
+            header[3] = pseg->ProposedWindowSize;
+            header[4] = pseg->service_choice;
+            header_len = TSM_SEGMENTED_COMPLEX_ACK_HEADER_LEN;
+        } else {
+            /* we accept a segmented response to a segmented request */
+            header[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST | BIT(3) | BIT(1);
+            if (more_follows) {
+                header[0] |= BIT(2);
+            }
+            header[1] = pseg->max_segs_max_apdu;
+            header[2] = pseg->InvokeID;
+            header[3] = (uint8_t)segment;
+            header[4] = pseg->ProposedWindowSize;
+            header[5] = pseg->service_choice;
+            header_len = TSM_SEGMENTED_REQUEST_HEADER_LEN;
+        }
+        tsm_segmented_pdu_send(&pseg->peer, &pseg->npdu_data, &header[0],
+            header_len, &pseg->data[offset], len);
+        if (!more_follows) {
+            pseg->SentAllSegments = true;
+        }
+    }
+}
+
+/** Copy the service data and send the first segment, which is
+ *  a window of one segment until the peer answers with a SegmentACK.
+ *
+ * @param pseg  Segmented message to be sent
+ * @param data  Service data
+ * @param data_len  Number of octets of service data
+ * @param segment_size  Service data octets in each segment
+ */
+static void tsm_segmented_send_start(BACNET_TSM_SEGMENTED_DATA *pseg,
+    uint8_t *data,
+    uint16_t data_len,
+    uint16_t segment_size)
+{
+    if (data != &pseg->data[0]) {
+        memmove(&pseg->data[0], data, data_len);
+    }
+    pseg->data_len = data_len;
+    pseg->segment_size = segment_size;
+    pseg->segment_count = (data_len + segment_size - 1) / segment_size;
+    pseg->SegmentRetryCount = 0;
+    pseg->SentAllSegments = false;
+    pseg->InitialSequenceNumber = 0;
+    pseg->LastSequenceNumber = 0;
+    pseg->ActualWindowSize = 1;
+    pseg->ProposedWindowSize = BACNET_SEGMENT_WINDOW_SIZE;
+    tsm_segmented_fill_window(pseg, 0);
+    pseg->SegmentTimer = apdu_segment_timeout();
+}
+
+/** Send a confirmed request that is too large for the peer in segments.
+ *  The invoke ID must have come from tsm_next_free_invokeID().
+ *
+ * @param invokeID  Invoke-ID
+ * @param dest  Pointer to the BACnet destination address.
+ * @param ndpu_data  Pointer to the NPDU structure.
+ * @param apdu  The whole request, encoded as if it were not segmented.
+ * @param apdu_len  Bytes valid in the request.
+ * @param max_apdu  Largest APDU that the destination accepts.
+ *
+ * @return true if the first segment was sent
+ */
+bool tsm_set_confirmed_segmented_transaction(uint8_t invokeID,
+    BACNET_ADDRESS *dest,
+    BACNET_NPDU_DATA *ndpu_data,
+    uint8_t *apdu,
+    uint16_t apdu_len,
+    unsigned max_apdu)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg = NULL;
+    BACNET_TSM_DATA *plist;
+    uint16_t segment_size = 0;
+    uint8_t index;
+
+    if (!dest || !ndpu_data || !apdu || (apdu_len < 4)) {
+        return false;
+    }
+    index = tsm_find_invokeID_index(invokeID);
+    if (index >= MAX_TSM_TRANSACTIONS) {
+        return false;
+    }
+    if (max_apdu > MAX_APDU) {
+        max_apdu = MAX_APDU;
+    }
+    if (max_apdu <= TSM_SEGMENTED_REQUEST_HEADER_LEN) {
+        return false;
+    }
+    segment_size = (uint16_t)(max_apdu - TSM_SEGMENTED_REQUEST_HEADER_LEN);
+    if ((((unsigned)apdu_len - 4 + segment_size - 1) / segment_size) >
+        TSM_SEGMENTS_MAX) {
+        return false;
+    }
+    pseg = tsm_segmented_alloc();
+    if (!pseg) {
+        return false;
+    }
+    plist = &TSM_List[index];
+    plist->state = TSM_STATE_SEGMENTED_REQUEST;
+    plist->RetryCount = 0;
+    tsm_timer_stop(index);
+    /* keep what fits of the request for tsm_get_transaction_pdu() */
+    plist->apdu_len = apdu_len;
+    if (plist->apdu_len > sizeof(plist->apdu)) {
+        plist->apdu_len = sizeof(plist->apdu);
+    }
+    memcpy(&plist->apdu[0], apdu, plist->apdu_len);
+    npdu_copy_data(&plist->npdu_data, ndpu_data);
+    bacnet_address_copy(&plist->dest, dest);
+    /* SendConfirmedSegmented */
+    pseg->state = TSM_STATE_SEGMENTED_REQUEST;
+    pseg->server = false;
+    pseg->InvokeID = invokeID;
+    bacnet_address_copy(&pseg->peer, dest);
+    npdu_copy_data(&pseg->npdu_data, ndpu_data);
+    pseg->max_segs_max_apdu =
+        encode_max_segs_max_apdu(MAX_SEGMENTS_ACCEPTED, MAX_APDU);
+    pseg->service_choice = apdu[3];
+    tsm_segmented_send_start(pseg, &apdu[4], apdu_len - 4, segment_size);
+
+    return true;
+}
+
+/** Set the function that keeps the segmented transactions from being
+ *  set up by two service handlers at once, when the handlers run on
+ *  several threads.
+ *
+ * @param pFunction  Function that locks or unlocks, or NULL
+ */
+void tsm_set_segmented_lock_function(tsm_lock_function pFunction)
+{
+    Segmented_Lock_Function = pFunction;
+}
+
+/** Send a ComplexACK, in segments if it is too large for the client.
+ *  The client is sent an Abort if it can not accept the segments.
+ *
+ * @param dest  Pointer to the BACnet destination address.
+ * @param ndpu_data  Pointer to the NPDU structure.
+ * @param service_data  The header of the confirmed request
+ * @param apdu  The whole ComplexACK, encoded as if it were not segmented.
+ * @param apdu_len  Bytes valid in the ComplexACK.
+ *
+ * @return true if the ComplexACK, or its first segment, was sent
+ */
+bool tsm_segmented_complex_ack_send(BACNET_ADDRESS *dest,
+    BACNET_NPDU_DATA *ndpu_data,
+    BACNET_CONFIRMED_SERVICE_DATA *service_data,
+    uint8_t *apdu,
+    uint16_t apdu_len)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg = NULL;
+    uint16_t segment_size = 0;
+    unsigned segment_count = 0;
+    unsigned max_apdu = MAX_APDU;
+    uint8_t reason = ABORT_REASON_OTHER;
+
+    if (!dest || !ndpu_data || !service_data || !apdu || (apdu_len < 3)) {
+        return false;
+    }
+    if ((service_data->max_resp > 0) &&
+        ((unsigned)service_data->max_resp < max_apdu)) {
+        max_apdu = service_data->max_resp;
+    }
+    if (apdu_len <= max_apdu) {
+        tsm_segmented_pdu_send(dest, ndpu_data, apdu, apdu_len, NULL, 0);
+        return true;
+    }
+    segment_size = (uint16_t)(max_apdu - TSM_SEGMENTED_COMPLEX_ACK_HEADER_LEN);
+    segment_count = ((unsigned)apdu_len - 3 + segment_size - 1) / segment_size;
+    if (Segmented_Lock_Function) {
+        Segmented_Lock_Function(true);
+    }
+    if (!service_data->segmented_response_accepted) {
+        reason = ABORT_REASON_SEGMENTATION_NOT_SUPPORTED;
+    } else if ((segment_count > TSM_SEGMENTS_MAX) ||
+        ((service_data->max_segs > 0) && (service_data->max_segs <= 64) &&
+            (segment_count > (unsigned)service_data->max_segs))) {
+        reason = ABORT_REASON_BUFFER_OVERFLOW;
+    } else {
+        /* the slot that held a segmented request is reused */
+        pseg = tsm_segmented_find(dest, service_data->invoke_id, true);
+        if (!pseg) {
+            pseg = tsm_segmented_alloc();
+        }
+    }
+    if (!pseg) {
+        if (Segmented_Lock_Function) {
+            Segmented_Lock_Function(false);
+        }
+        tsm_segmented_abort_send(dest, service_data->invoke_id, true, reason);
+        return false;
+    }
+    /* SendSegmentedComplexACK */
+    pseg->state = TSM_STATE_SEGMENTED_RESPONSE;
+    pseg->server = true;
+    pseg->InvokeID = service_data->invoke_id;
+    bacnet_address_copy(&pseg->peer, dest);
+    npdu_copy_data(&pseg->npdu_data, ndpu_data);
+    pseg->max_segs_max_apdu = 0;
+    pseg->service_choice = apdu[2];
+    tsm_segmented_send_start(pseg, &apdu[3], apdu_len - 3, segment_size);
+    if (Segmented_Lock_Function) {
+        Segmented_Lock_Function(false);
+    }
+
+    return true;
+}
+
+/** Handle a segment of a confirmed request or of a ComplexACK.
+ *  Segments are acknowledged as each window fills, and the
+ *  service data is gathered until the last segment arrives.
+ *
+ * @param src  Pointer to the BACnet source address.
+ * @param apdu  The received segment
+ * @param apdu_len  Bytes valid in the received segment
+ * @param service_request  Set to the whole service data when complete
+ * @param service_request_len  Set to the length of the service data
+ *
+ * @return true if the last segment was received.  The service data
+ *  is kept until tsm_segmented_request_free() for a request,
+ *  or tsm_free_invoke_id() for a ComplexACK.
+ */
+bool tsm_segmented_receive(BACNET_ADDRESS *src,
+    uint8_t *apdu,
+    uint16_t apdu_len,
+    uint8_t **service_request,
+    uint16_t *service_request_len)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg = NULL;
+    bool server = false;
+    bool more_follows = false;
+    uint8_t invokeID = 0;
+    uint8_t sequence_number = 0;
+    uint8_t window_size = 0;
+    uint8_t service_choice = 0;
+    uint16_t header_len = 0;
+    uint16_t data_len = 0;
+    uint8_t index = MAX_TSM_TRANSACTIONS;
+
+    if (!src || !apdu || !service_request || !service_request_len) {
+        return false;
+    }
+    more_follows = (apdu[0] & BIT(2)) ? true : false;
+    if ((apdu[0] & 0xF0) == PDU_TYPE_CONFIRMED_SERVICE_REQUEST) {
+        header_len = TSM_SEGMENTED_REQUEST_HEADER_LEN;
+        if (apdu_len < header_len) {
+            return false;
+        }
+        server = true;
+        invokeID = apdu[2];
+        sequence_number = apdu[3];
+        window_size = apdu[4];
+        service_choice = apdu[5];
+    } else if ((apdu[0] & 0xF0) == PDU_TYPE_COMPLEX_ACK) {
+        header_len = TSM_SEGMENTED_COMPLEX_ACK_HEADER_LEN;
+        if (apdu_len < header_len) {
+            return false;
+        }
+        invokeID = apdu[1];
+        sequence_number = apdu[2];
+        window_size = apdu[3];
+        service_choice = apdu[4];
+    } else {
+        return false;
+    }
+    data_len = apdu_len - header_len;
+    tsm_init_check();
+    if (server) {
+        pseg = tsm_segmented_find(src, invokeID, true);
+    } else {
+        pseg = tsm_segmented_find(NULL, invokeID, false);
+    }
+    if (pseg) {
+        if (pseg->state != (server ? TSM_STATE_SEGMENTED_REQUEST
+                                   : TSM_STATE_SEGMENTED_CONFIRMATION)) {
+            /* a late duplicate of a message that is complete */
+            return false;
+        }
+        if ((service_choice != pseg->service_choice) ||
+            (sequence_number != (uint8_t)(pseg->LastSequenceNumber + 1))) {
+            /* SegmentReceivedOutOfOrder */
+            pseg->InitialSequenceNumber = pseg->LastSequenceNumber;
+            tsm_segment_ack_send(pseg, true, pseg->LastSequenceNumber);
+            pseg->SegmentTimer = 4 * apdu_segment_timeout();
+            return false;
+        }
+        if (((uint32_t)pseg->data_len + data_len) > sizeof(pseg->data)) {
+            tsm_segmented_abort_send(
+                src, invokeID, server, ABORT_REASON_BUFFER_OVERFLOW);
+            tsm_segmented_release(pseg);
+            if (!server) {
+                tsm_segmented_client_failed(invokeID);
+            }
+            return false;
+        }
+        memcpy(&pseg->data[pseg->data_len], &apdu[header_len], data_len);
+        pseg->data_len += data_len;
+        pseg->LastSequenceNumber = sequence_number;
+        pseg->SegmentTimer = 4 * apdu_segment_timeout();
+        if (!more_follows) {
+            /* LastSegmentOfMessage */
+            tsm_segment_ack_send(pseg, false, sequence_number);
+        } else if (sequence_number ==
+            (uint8_t)(pseg->InitialSequenceNumber + pseg->ActualWindowSize)) {
+            /* LastSegmentOfGroupReceived */
+            pseg->InitialSequenceNumber = sequence_number;
+            tsm_segment_ack_send(pseg, false, sequence_number);
+            return false;
+        } else {
+            /* NewSegmentReceived */
+            return false;
+        }
+    } else {
+        if (sequence_number != 0) {
+            /* not the start of a message that we know about */
+            return false;
+        }
+        if (!server) {
+            /* only a client waiting for this reply accepts it */
+            index = tsm_find_invokeID_index(invokeID);
+            if ((index >= MAX_TSM_TRANSACTIONS) ||
+                (TSM_List[index].state != TSM_STATE_AWAIT_CONFIRMATION)) {
+                return false;
+            }
+        }
+        pseg = tsm_segmented_alloc();
+        if (!pseg || (data_len > sizeof(pseg->data))) {
+            tsm_segmented_abort_send(src, invokeID, server, ABORT_REASON_OTHER);
+            if (!server) {
+                tsm_segmented_client_failed(invokeID);
+            }
+            return false;
+        }
+        pseg->state = server ? TSM_STATE_SEGMENTED_REQUEST
+                             : TSM_STATE_SEGMENTED_CONFIRMATION;
+        pseg->server = server;
+        pseg->InvokeID = invokeID;
+        bacnet_address_copy(&pseg->peer, src);
+        npdu_encode_npdu_data(&pseg->npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+        pseg->max_segs_max_apdu = server ? apdu[1] : 0;
+        pseg->service_choice = service_choice;
+        pseg->SegmentRetryCount = 0;
+        pseg->SentAllSegments = false;
+        pseg->ProposedWindowSize = window_size;
+        /* the window is the smaller of what was proposed and ours */
+        pseg->ActualWindowSize = window_size;
+        if (pseg->ActualWindowSize > BACNET_SEGMENT_WINDOW_SIZE) {
+            pseg->ActualWindowSize = BACNET_SEGMENT_WINDOW_SIZE;
+        }
+        if (pseg->ActualWindowSize == 0) {
+            pseg->ActualWindowSize = 1;
+        }
+        pseg->InitialSequenceNumber = 0;
+        pseg->LastSequenceNumber = 0;
+        memcpy(&pseg->data[0], &apdu[header_len], data_len);
+        pseg->data_len = data_len;
+        if (!server) {
+            tsm_timer_stop(index);
+            TSM_List[index].state = TSM_STATE_SEGMENTED_CONFIRMATION;
+        }
+        tsm_segment_ack_send(pseg, false, 0);
+        pseg->SegmentTimer = 4 * apdu_segment_timeout();
+        if (more_follows) {
+            return false;
+        }
+    }
+    /* the whole message has arrived */
+    pseg->SegmentTimer = 0;
+    if (server) {
+        pseg->state = TSM_STATE_AWAIT_RESPONSE;
+    }
+    *service_request = &pseg->data[0];
+    *service_request_len = pseg->data_len;
+
+    return true;
+}
+
+/** Handle a SegmentACK for a segmented message that we are sending.
+ *
+ * @param src  Pointer to the BACnet source address.
+ * @param invokeID  Invoke-ID
+ * @param sequence_number  Last segment that the peer received in order
+ * @param actual_window_size  Number of segments to send in the next window
+ * @param nak  True if the peer received a segment out of order
+ * @param server  True if the SegmentACK was sent by a server
+ */
+void tsm_segment_ack_received(BACNET_ADDRESS *src,
+    uint8_t invokeID,
+    uint8_t sequence_number,
+    uint8_t actual_window_size,
+    bool nak,
+    bool server)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg = NULL;
+    uint8_t offset = 0;
+    uint8_t index;
+
+    tsm_init_check();
+    if (server) {
+        /* acknowledging our segmented request */
+        pseg = tsm_segmented_find(NULL, invokeID, false);
+    } else {
+        /* acknowledging our segmented ComplexACK */
+        pseg = tsm_segmented_find(src, invokeID, true);
+    }
+    if (!pseg || !tsm_segmented_sending(pseg)) {
+        return;
+    }
+    offset = (uint8_t)(sequence_number - pseg->InitialSequenceNumber);
+    if ((offset >= pseg->ActualWindowSize) &&
+        !(nak && (offset == 0xFF))) {
+        /* DuplicateACK_Received - a negative ACK for the segment
+           before the window is taken as a request to resend it all */
+        pseg->SegmentTimer = apdu_segment_timeout();
+        return;
+    }
+    if (pseg->SentAllSegments && !nak &&
+        ((unsigned)sequence_number + 1 == pseg->segment_count)) {
+        /* FinalSegmentACK_Received */
+        if (!pseg->server) {
+            index = tsm_find_invokeID_index(invokeID);
+            if (index < MAX_TSM_TRANSACTIONS) {
+                TSM_List[index].state = TSM_STATE_AWAIT_CONFIRMATION;
+                /* resending only the first segment would not help */
+                TSM_List[index].RetryCount = apdu_retries();
+                tsm_timer_start(index, apdu_timeout());
+            }
+        }
+        tsm_segmented_release(pseg);
+        return;
+    }
+    /* NewSegmentACK_Received */
+    if (actual_window_size == 0) {
+        actual_window_size = 1;
+    } else if (actual_window_size > 127) {
+        actual_window_size = 127;
+    }
+    pseg->ActualWindowSize = actual_window_size;
+    pseg->InitialSequenceNumber = (uint8_t)(sequence_number + 1);
+    pseg->SegmentRetryCount = 0;
+    pseg->SentAllSegments = false;
+    tsm_segmented_fill_window(pseg, pseg->InitialSequenceNumber);
+    pseg->SegmentTimer = apdu_segment_timeout();
+}
+
+/** Handle an expired segment timer.  A window of segments is sent
+ *  again until the retries are used up; a message being received
+ *  is given up.
+ *
+ * @param pseg  Segmented message
+ */
+static void tsm_segmented_timer_expired(BACNET_TSM_SEGMENTED_DATA *pseg)
+{
+    if (tsm_segmented_sending(pseg) &&
+        (pseg->SegmentRetryCount < apdu_retries())) {
+        pseg->SegmentRetryCount++;
+        tsm_segmented_fill_window(pseg, pseg->InitialSequenceNumber);
+        pseg->SegmentTimer = apdu_segment_timeout();
+        return;
+    }
+    tsm_segmented_release(pseg);
+    if (!pseg->server) {
+        tsm_segmented_client_failed(pseg->InvokeID);
+    }
+}
+
+/** Count down the segment timers.
+ *
+ * @param milliseconds - Count of milliseconds passed, since the last call.
+ */
+static void tsm_segmented_timer(uint16_t milliseconds)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_SEGMENTED_TRANSACTIONS; i++) {
+        pseg = &TSM_Segmented_List[i];
+        if ((pseg->state == TSM_STATE_IDLE) || (pseg->SegmentTimer == 0)) {
+            continue;
+        }
+        if (pseg->SegmentTimer > milliseconds) {
+            pseg->SegmentTimer -= milliseconds;
+        } else {
+            pseg->SegmentTimer = 0;
+            tsm_segmented_timer_expired(pseg);
+        }
+    }
+}
+
+/** Free a segmented request once the service handler is done with it.
+ *  A segmented ComplexACK that is being sent in reply is not freed.
+ *
+ * @param src  Pointer to the BACnet source address.
+ * @param invokeID  Invoke-ID
+ */
+void tsm_segmented_request_free(BACNET_ADDRESS *src, uint8_t invokeID)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg;
+
+    pseg = tsm_segmented_find(src, invokeID, true);
+    if (pseg && (pseg->state == TSM_STATE_AWAIT_RESPONSE)) {
+        tsm_segmented_release(pseg);
+    }
+}
+
+/** Free any segmented message of a transaction where we are
+ *  the server, such as when the client sends an Abort.
+ *
+ * @param src  Pointer to the BACnet source address.
+ * @param invokeID  Invoke-ID
+ */
+void tsm_segmented_free(BACNET_ADDRESS *src, uint8_t invokeID)
+{
+    BACNET_TSM_SEGMENTED_DATA *pseg;
+
+    pseg = tsm_segmented_find(src, invokeID, true);
+    if (pseg) {
+        tsm_segmented_release(pseg);
+    }
+}
+
+/** Return the count of idle segmented messages.
+ *
+ * @return Count of idle segmented messages.
+ */
+uint8_t tsm_segmented_idle_count(void)
+{
+    uint8_t count = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < MAX_TSM_SEGMENTED_TRANSACTIONS; i++) {
+        if (TSM_Segmented_List[i].state == TSM_STATE_IDLE) {
+            count++;
+        }
+    }
+
+    return count;
+}
+#endif
+
+/** Handle an expired request timer: resend the request, or give up
+ *  once the retries are used up.
+ *
+ * @param index  Index of the transaction
+ */
+static void tsm_timer_expired(uint8_t index)
+{
+    BACNET_TSM_DATA *plist = &TSM_List[index];
+
+    if (plist->state != TSM_STATE_AWAIT_CONFIRMATION) {
+        return;
+    }
+    plist->RequestTimer = 0;
+    /* AWAIT_CONFIRMATION */
+    if (plist->RetryCount < apdu_retries()) {
+        tsm_timer_start(index, apdu_timeout());
+        plist->RetryCount++;
+        datalink_send_pdu(
+            &plist->dest, &plist->npdu_data, &plist->apdu[0], plist->apdu_len);
+    } else {
+        /* note: the invoke id has not been cleared yet
+           and this indicates a failed message:
+           IDLE and a valid invoke id */
+        plist->state = TSM_STATE_IDLE;
+        if (plist->InvokeID != 0) {
+            if (Timeout_Function) {
+                Timeout_Function(plist->InvokeID);
+            }
+        }
+    }
+}
+
 /** Called once a millisecond or slower.
  *  This function calls the handler for a
  *  timeout 'Timeout_Function', if neccessary.
@@ -322,38 +1179,57 @@ bool tsm_get_transaction_pdu(uint8_t invokeID,
  */
 void tsm_timer_milliseconds(uint16_t milliseconds)
 {
-    unsigned i = 0; /* counter */
-
-    BACNET_TSM_DATA *plist = &TSM_List[0];
+    uint32_t elapsed_ticks = 0;
+    uint32_t tick = 0;
+    uint32_t slots = 0;
+    uint8_t index = 0;
+    uint8_t next = 0;
+    uint8_t expired = TSM_INDEX_NONE;
+    struct TSM_Timer_Node *node;
 
-    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++, plist++) {
-        if (plist->state == TSM_STATE_AWAIT_CONFIRMATION) {
-            if (plist->RequestTimer > milliseconds) {
-                plist->RequestTimer -= milliseconds;
-            } else {
-                plist->RequestTimer = 0;
-            }
-            /* AWAIT_CONFIRMATION */
-            if (plist->RequestTimer == 0) {
-                if (plist->RetryCount < apdu_retries()) {
-                    plist->RequestTimer = apdu_timeout();
-                    plist->RetryCount++;
-                    datalink_send_pdu(&plist->dest, &plist->npdu_data,
-                        &plist->apdu[0], plist->apdu_len);
-                } else {
-                    /* note: the invoke id has not been cleared yet
-                       and this indicates a failed message:
-                       IDLE and a valid invoke id */
-                    plist->state = TSM_STATE_IDLE;
-                    if (plist->InvokeID != 0) {
-                        if (Timeout_Function) {
-                            Timeout_Function(plist->InvokeID);
-                        }
-                    }
-                }
+    tsm_init_check();
+#if BACNET_SEGMENTATION_ENABLED
+    tsm_segmented_timer(milliseconds);
+#endif
+    elapsed_ticks = ((uint32_t)TSM_Timer_Remainder + milliseconds) /
+        TSM_TIMER_TICK_MILLISECONDS;
+    TSM_Timer_Remainder = (uint16_t)(
+        ((uint32_t)TSM_Timer_Remainder + milliseconds) %
+        TSM_TIMER_TICK_MILLISECONDS);
+    if (elapsed_ticks == 0) {
+        return;
+    }
+    /* a long gap only needs one turn of the wheel */
+    slots = elapsed_ticks;
+    if (slots > TSM_TIMER_WHEEL_SLOTS) {
+        slots = TSM_TIMER_WHEEL_SLOTS;
+    }
+    tick = TSM_Timer_Tick;
+    TSM_Timer_Tick += elapsed_ticks;
+    /* detach the due timers first, since the handlers may
+       start or stop other timers */
+    while (slots > 0) {
+        slots--;
+        tick++;
+        index = TSM_Timer_Wheel[tick % TSM_TIMER_WHEEL_SLOTS];
+        while (index != TSM_INDEX_NONE) {
+            node = &TSM_Timer[index];
+            next = node->next;
+            /* others in this slot are due on a later turn of the wheel */
+            if ((int32_t)(node->expire_tick - TSM_Timer_Tick) <= 0) {
+                tsm_timer_stop(index);
+                /* reuse the prev link to chain the expired list */
+                node->prev = expired;
+                expired = index;
             }
+            index = next;
         }
     }
+    while (expired != TSM_INDEX_NONE) {
+        index = expired;
+        expired = TSM_Timer[index].prev;
+        tsm_timer_expired(index);
+    }
 }
 
 /** Frees the invokeID and sets its state to IDLE
@@ -365,11 +1241,22 @@ void tsm_free_invoke_id(uint8_t invokeID)
     uint8_t index;
     BACNET_TSM_DATA *plist;
 
+#if BACNET_SEGMENTATION_ENABLED
+    BACNET_TSM_SEGMENTED_DATA *pseg;
+
+    pseg = tsm_segmented_find(NULL, invokeID, false);
+    if (pseg) {
+        tsm_segmented_release(pseg);
+    }
+#endif
     index = tsm_find_invokeID_index(invokeID);
     if (index < MAX_TSM_TRANSACTIONS) {
         plist = &TSM_List[index];
+        tsm_timer_stop(index);
         plist->state = TSM_STATE_IDLE;
         plist->InvokeID = 0;
+        TSM_Invoke_Index[invokeID] = 0;
+        TSM_Free_List[TSM_Free_Count++] = index;
     }
 }
 
@@ -31,6 +31,7 @@
 #include "bacnet/config.h"
 #include "bacnet/bacdef.h"
 #include "bacnet/npdu.h"
+#include "bacnet/apdu.h"
 
 /* note: TSM functionality is optional - only needed if we are
    doing client requests */
@@ -40,8 +41,13 @@ extern "C" {
 #endif /* __cplusplus */
 
     /* FIXME: modify basic service handlers to use TSM rather than this buffer! */
-    BACNET_STACK_EXPORT extern 
+    BACNET_STACK_EXPORT extern BACNET_THREAD_LOCAL
     uint8_t Handler_Transmit_Buffer[MAX_PDU];
+#if BACNET_SEGMENTATION_ENABLED
+    /* service handlers encode a ComplexACK that may need segments here */
+    BACNET_STACK_EXPORT extern BACNET_THREAD_LOCAL
+    uint8_t Handler_Segmented_Buffer[MAX_APDU_SEGMENTED];
+#endif
 
 #ifdef __cplusplus
 }
@@ -56,7 +62,8 @@ typedef enum {
     TSM_STATE_AWAIT_CONFIRMATION,
     TSM_STATE_AWAIT_RESPONSE,
     TSM_STATE_SEGMENTED_REQUEST,
-    TSM_STATE_SEGMENTED_CONFIRMATION
+    TSM_STATE_SEGMENTED_CONFIRMATION,
+    TSM_STATE_SEGMENTED_RESPONSE
 } BACNET_TSM_STATE;
 
 /* 5.4.1 Variables And Parameters */
@@ -81,7 +88,8 @@ typedef struct BACnet_TSM_Data {
     /*  used to perform timeout on PDU segments */
     /*uint8_t SegmentTimer; */
     /* used to perform timeout on Confirmed Requests */
-    /* in milliseconds */
+    /* in milliseconds - the timeout when the timer was last started,
+       since the running timers are kept on the TSM timer wheel */
     uint16_t RequestTimer;
     /* unique id */
     uint8_t InvokeID;
@@ -96,9 +104,58 @@ typedef struct BACnet_TSM_Data {
     unsigned apdu_len;
 } BACNET_TSM_DATA;
 
+#if BACNET_SEGMENTATION_ENABLED
+/* 5.4.1 Variables And Parameters, for a message that is being
+   sent or received in segments.  These are kept apart from the
+   transactions since each one holds the whole message. */
+typedef struct BACnet_TSM_Segmented_Data {
+    /* SEGMENTED_REQUEST, SEGMENTED_CONFIRMATION, SEGMENTED_RESPONSE,
+       or AWAIT_RESPONSE once a segmented request has been received */
+    BACNET_TSM_STATE state;
+    /* true if this device is the server of the transaction */
+    bool server;
+    /* unique id */
+    uint8_t InvokeID;
+    /* the peer that we are sending to or receiving from */
+    BACNET_ADDRESS peer;
+    /* the network layer info */
+    BACNET_NPDU_DATA npdu_data;
+    /* confirmed request header octet 1, or zero for a ComplexACK */
+    uint8_t max_segs_max_apdu;
+    uint8_t service_choice;
+    /* used to count segment retries */
+    uint8_t SegmentRetryCount;
+    /* used to control APDU retries and the acceptance of server replies */
+    bool SentAllSegments;
+    /* stores the sequence number of the last segment received in order */
+    uint8_t LastSequenceNumber;
+    /* stores the sequence number of the first segment of */
+    /* a sequence of segments that fill a window */
+    uint8_t InitialSequenceNumber;
+    /* stores the current window size */
+    uint8_t ActualWindowSize;
+    /* stores the window size proposed by the segment sender */
+    uint8_t ProposedWindowSize;
+    /* used to perform timeout on PDU segments, in milliseconds */
+    uint16_t SegmentTimer;
+    /* service data octets carried in each segment we send */
+    uint16_t segment_size;
+    /* number of segments we send */
+    uint16_t segment_count;
+    /* the service data being sent or reassembled */
+    uint8_t data[MAX_APDU_SEGMENTED];
+    uint16_t data_len;
+} BACNET_TSM_SEGMENTED_DATA;
+#endif
+
 typedef void (
     *tsm_timeout_function) (
     uint8_t invoke_id);
+/* called with true before, and false after, a service handler sets up
+   a segmented ComplexACK, when service handlers run on several threads */
+typedef void (
+    *tsm_lock_function) (
+    bool lock);
 
 
 #ifdef __cplusplus
@@ -153,6 +210,53 @@ extern "C" {
     bool tsm_invoke_id_failed(
         uint8_t invokeID);
 
+#if BACNET_SEGMENTATION_ENABLED
+    BACNET_STACK_EXPORT
+    bool tsm_set_confirmed_segmented_transaction(
+        uint8_t invokeID,
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * ndpu_data,
+        uint8_t * apdu,
+        uint16_t apdu_len,
+        unsigned max_apdu);
+    BACNET_STACK_EXPORT
+    void tsm_set_segmented_lock_function(
+        tsm_lock_function pFunction);
+    BACNET_STACK_EXPORT
+    bool tsm_segmented_complex_ack_send(
+        BACNET_ADDRESS * dest,
+        BACNET_NPDU_DATA * ndpu_data,
+        BACNET_CONFIRMED_SERVICE_DATA * service_data,
+        uint8_t * apdu,
+        uint16_t apdu_len);
+    BACNET_STACK_EXPORT
+    bool tsm_segmented_receive(
+        BACNET_ADDRESS * src,
+        uint8_t * apdu,
+        uint16_t apdu_len,
+        uint8_t ** service_request,
+        uint16_t * service_request_len);
+    BACNET_STACK_EXPORT
+    void tsm_segment_ack_received(
+        BACNET_ADDRESS * src,
+        uint8_t invokeID,
+        uint8_t sequence_number,
+        uint8_t actual_window_size,
+        bool nak,
+        bool server);
+    BACNET_STACK_EXPORT
+    void tsm_segmented_request_free(
+        BACNET_ADDRESS * src,
+        uint8_t invokeID);
+    BACNET_STACK_EXPORT
+    void tsm_segmented_free(
+        BACNET_ADDRESS * src,
+        uint8_t invokeID);
+    BACNET_STACK_EXPORT
+    uint8_t tsm_segmented_idle_count(
+        void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -113,6 +113,50 @@
 #if !defined(MAX_TSM_TRANSACTIONS)
 #define MAX_TSM_TRANSACTIONS 255
 #endif
+
+/* Segmentation of confirmed requests and ComplexACKs. */
+/* Define as 1 to send and receive segmented messages. */
+/* Each segmented transaction holds a whole message */
+/* of up to MAX_APDU_SEGMENTED octets. */
+#if !defined(BACNET_SEGMENTATION_ENABLED)
+#define BACNET_SEGMENTATION_ENABLED 0
+#endif
+#if BACNET_SEGMENTATION_ENABLED
+/* number of segments in a message that we will accept */
+#if !defined(MAX_SEGMENTS_ACCEPTED)
+#define MAX_SEGMENTS_ACCEPTED 16
+#endif
+/* largest message we will send or receive in segments */
+#if !defined(MAX_APDU_SEGMENTED)
+#define MAX_APDU_SEGMENTED (MAX_APDU * MAX_SEGMENTS_ACCEPTED)
+#endif
+/* number of segmented messages being sent or received at once */
+#if !defined(MAX_TSM_SEGMENTED_TRANSACTIONS)
+#define MAX_TSM_SEGMENTED_TRANSACTIONS 4
+#endif
+/* the window size proposed when we send segments, 1..127 */
+#if !defined(BACNET_SEGMENT_WINDOW_SIZE)
+#define BACNET_SEGMENT_WINDOW_SIZE 16
+#endif
+#endif
+
+/* Service handlers that run on several threads at once. */
+/* Define as 1 to give each thread its own transmit buffers, */
+/* so that requests can be handled by a pool of threads. */
+#if !defined(BACNET_THREADS)
+#define BACNET_THREADS 0
+#endif
+#if BACNET_THREADS
+#if defined(_MSC_VER)
+#define BACNET_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define BACNET_THREAD_LOCAL __thread
+#else
+#define BACNET_THREAD_LOCAL _Thread_local
+#endif
+#else
+#define BACNET_THREAD_LOCAL
+#endif
 /* The address cache is used for binding to BACnet devices */
 /* The number of entries corresponds to the number of */
 /* devices that might respond to an I-Am on the network. */
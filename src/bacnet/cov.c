@@ -984,6 +984,70 @@ bool cov_value_list_encode_character_string(
 }
 #endif
 
+/* the COV service handler that is told about objects that have changed */
+static BACnet_COV_Change_Callback COV_Change_Callback;
+/* the others that are told about them, such as COV trend logs */
+static BACNET_COV_CHANGE_NOTIFICATION COV_Change_Notification_Head;
+
+/**
+ * @brief Set the function that is told about objects that have changed,
+ *  usually by the COV service handler.
+ * @param callback - function to call, or NULL for none
+ */
+void cov_change_detected_callback_set(BACnet_COV_Change_Callback callback)
+{
+    COV_Change_Callback = callback;
+}
+
+/**
+ * @brief Add a function that is told about objects that have changed,
+ *  besides the COV service handler.
+ * @param notification - node with the function to call, which is kept
+ *  in a list and so must stay valid
+ */
+void cov_change_detected_notification_add(
+    BACNET_COV_CHANGE_NOTIFICATION *notification)
+{
+    BACNET_COV_CHANGE_NOTIFICATION *head;
+
+    head = &COV_Change_Notification_Head;
+    do {
+        if (head->next == notification) {
+            /* already here! */
+            break;
+        } else if (!head->next) {
+            /* first available free node */
+            head->next = notification;
+            break;
+        }
+        head = head->next;
+    } while (head);
+}
+
+/**
+ * @brief Report that the COV properties of an object have changed,
+ *  so that only the subscriptions for this object need to be visited.
+ *  Objects call this whenever they set their change-of-value flag.
+ * @param object_type - type of the object that changed
+ * @param object_instance - instance of the object that changed
+ */
+void cov_change_detected_notify(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    BACNET_COV_CHANGE_NOTIFICATION *head;
+
+    if (COV_Change_Callback) {
+        COV_Change_Callback(object_type, object_instance);
+    }
+    head = COV_Change_Notification_Head.next;
+    while (head) {
+        if (head->callback) {
+            head->callback(object_type, object_instance);
+        }
+        head = head->next;
+    }
+}
+
 #ifdef BAC_TEST
 #include <assert.h>
 #include <string.h>
@@ -62,6 +62,16 @@ typedef struct BACnet_COV_Notification {
     BACnet_COV_Notification_Callback callback;
 } BACNET_COV_NOTIFICATION;
 
+/* callback for an object whose COV properties have changed */
+typedef void (*BACnet_COV_Change_Callback)
+    (BACNET_OBJECT_TYPE object_type, uint32_t object_instance);
+/* other users that are told about objects that have changed */
+struct BACnet_COV_Change_Notification;
+typedef struct BACnet_COV_Change_Notification {
+    struct BACnet_COV_Change_Notification *next;
+    BACnet_COV_Change_Callback callback;
+} BACNET_COV_CHANGE_NOTIFICATION;
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -169,6 +179,17 @@ extern "C" {
         bool overridden,
         bool out_of_service);
 
+    BACNET_STACK_EXPORT
+    void cov_change_detected_callback_set(
+        BACnet_COV_Change_Callback callback);
+    BACNET_STACK_EXPORT
+    void cov_change_detected_notification_add(
+        BACNET_COV_CHANGE_NOTIFICATION * notification);
+    BACNET_STACK_EXPORT
+    void cov_change_detected_notify(
+        BACNET_OBJECT_TYPE object_type,
+        uint32_t object_instance);
+
 #ifdef BAC_TEST
 #include "ctest.h"
     BACNET_STACK_EXPORT
@@ -74,6 +74,13 @@ extern "C" {
     BACNET_STACK_EXPORT
     int bip_send_mpdu(BACNET_IP_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len);
 
+    BACNET_STACK_EXPORT
+    int bip_send_mpdu_list(BACNET_IP_ADDRESS *dest_list,
+        unsigned dest_count,
+        uint8_t *mtu,
+        uint16_t mtu_len,
+        bool *sent);
+
     BACNET_STACK_EXPORT
     uint16_t bip_receive(BACNET_ADDRESS *src,
         uint8_t *pdu,
@@ -115,6 +122,20 @@ extern "C" {
     BACNET_STACK_EXPORT
     void bip_debug_enable(void);
 
+    /* batched datagrams - only the linux port batches, the other ports
+       send each datagram at once */
+    BACNET_STACK_EXPORT
+    int bip_socket(void);
+
+    BACNET_STACK_EXPORT
+    bool bip_receive_pending(void);
+
+    BACNET_STACK_EXPORT
+    void bip_send_batch_enable(bool enable);
+
+    BACNET_STACK_EXPORT
+    int bip_send_flush(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -96,6 +96,13 @@ extern "C" {
         uint8_t * mtu,
         uint16_t mtu_len);
     BACNET_STACK_EXPORT
+    int bip6_send_mpdu_list(
+        BACNET_IP6_ADDRESS *dest_list,
+        unsigned dest_count,
+        uint8_t * mtu,
+        uint16_t mtu_len,
+        bool *sent);
+    BACNET_STACK_EXPORT
     bool bip6_send_pdu_queue_empty(
         void);
     BACNET_STACK_EXPORT
@@ -171,6 +171,10 @@ int dlenv_register_as_foreign_device(void)
         }
         BBMD_Timer_Seconds = (uint16_t)BBMD_TTL_Seconds;
     } else {
+        pEnv = getenv("BACNET_FDT_BACKUP_FILE");
+        if (pEnv) {
+            bvlc_fdt_backup_file_set(pEnv);
+        }
         for (entry_number = 1; entry_number <= 128; entry_number++) {
             bdt_entry_valid = false;
             sprintf(bbmd_env, "BACNET_BDT_ADDR_%u", entry_number);
@@ -217,6 +221,7 @@ int dlenv_register_as_foreign_device(void)
                 }
                 bvlc_broadcast_distribution_table_entry_append(
                     bvlc_bdt_list(), &BBMD_Table_Entry);
+                bvlc_bdt_list_changed();
                 if (BIP_DL_Debug) {
                     fprintf(stderr, "BBMD %4u: %u.%u.%u.%u:%u %u.%u.%u.%u\n",
                         entry_number,
@@ -406,6 +411,8 @@ void dlenv_maintenance_timer(uint16_t elapsed_seconds)
  *   - BACNET_BDT_PORT_1 - UDP port of the BBMD table entry 1..128 (optional)
  *   - BACNET_BDT_MASK_1 - dotted IPv4 mask of the BBMD table
  *       entry 1..128 (optional)
+ *   - BACNET_FDT_BACKUP_FILE - file that keeps the foreign device table
+ *       across restarts (optional)
  *   - BACNET_IP_NAT_ADDR - dotted IPv4 address of the public facing router
  * - BACDL_MSTP: (BACnet MS/TP)
  *   - BACNET_MAX_INFO_FRAMES
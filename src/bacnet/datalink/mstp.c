@@ -48,6 +48,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h> /* for memcpy */
 #if PRINT_ENABLED
 #include <stdio.h>
 #endif
@@ -212,24 +213,21 @@ uint16_t MSTP_Create_Frame(uint8_t *buffer, /* where frame is loaded */
     buffer[0] = 0x55;
     buffer[1] = 0xFF;
     buffer[2] = frame_type;
-    crc8 = CRC_Calc_Header(buffer[2], crc8);
     buffer[3] = destination;
-    crc8 = CRC_Calc_Header(buffer[3], crc8);
     buffer[4] = source;
-    crc8 = CRC_Calc_Header(buffer[4], crc8);
     buffer[5] = data_len >> 8; /* MSB first */
-    crc8 = CRC_Calc_Header(buffer[5], crc8);
     buffer[6] = data_len & 0xFF;
-    crc8 = CRC_Calc_Header(buffer[6], crc8);
+    crc8 = CRC_Calc_Header_Buffer(&buffer[2], 5, crc8);
     buffer[7] = ~crc8;
 
     index = 8;
-    while (data_len && data && (index < buffer_len)) {
-        buffer[index] = *data;
-        crc16 = CRC_Calc_Data(buffer[index], crc16);
-        data++;
-        index++;
-        data_len--;
+    if (data) {
+        if (data_len > (buffer_len - index)) {
+            data_len = buffer_len - index;
+        }
+        memcpy(&buffer[index], data, data_len);
+        crc16 = CRC_Calc_Data_Buffer(&buffer[index], data_len, crc16);
+        index += data_len;
     }
     /* append the data CRC if necessary */
     if (index > 8) {
@@ -33,6 +33,7 @@
 ####COPYRIGHTEND####*/
 #include <stdint.h>
 #include "bacnet/bacenum.h"
+#include "bacnet/bits.h"
 #include "bacnet/bacdcode.h"
 #include "bacnet/bacdef.h"
 #include "bacnet/readrange.h"
@@ -76,8 +77,14 @@ int rr_encode_apdu(
     int apdu_len = 0; /* total length of the apdu, return value */
 
     if (apdu) {
+#if BACNET_SEGMENTATION_ENABLED
+        /* a large ReadRange-ACK may be returned in segments */
+        apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST | BIT(1);
+        apdu[1] = encode_max_segs_max_apdu(MAX_SEGMENTS_ACCEPTED, MAX_APDU);
+#else
         apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
         apdu[1] = encode_max_segs_max_apdu(0, MAX_APDU);
+#endif
         apdu[2] = invoke_id;
         apdu[3] = SERVICE_CONFIRMED_READ_RANGE; /* service choice */
         apdu_len = 4;
@@ -29,6 +29,7 @@
 #include <stdint.h> /* for standard integer types uint8_t etc. */
 #include <stdbool.h> /* for the standard bool type. */
 #include <string.h> /* for memcpy */
+#include <time.h>
 #include <assert.h>
 #include <string.h>
 #include "bacnet/bacdcode.h"
@@ -56,6 +57,14 @@ static uint8_t Test_Sent_Message_Length;
 static uint8_t Test_Sent_Message_Buffer[MAX_MPDU];
 static uint16_t Test_Sent_Message_Buffer_Length;
 static BACNET_IP_ADDRESS Test_Sent_Message_Dest;
+static unsigned Test_Sent_Message_Count;
+/* the clock of the FDT backup file */
+static time_t Test_Time = 1600000000;
+
+static time_t test_clock(void)
+{
+    return Test_Time;
+}
 
 /* network stub functions */
 /**
@@ -106,6 +115,35 @@ int bip_send_mpdu(BACNET_IP_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
     return 0;
 }
 
+/**
+ * The send function for a list of destinations
+ *
+ * @param dest_list - the destination addresses
+ * @param dest_count - number of destination addresses
+ * @param mtu - the bytes of data to send
+ * @param mtu_len - the number of bytes of data to send
+ * @param sent - returns true for each destination, or NULL
+ * @return number of destinations that the datagram was sent to
+ */
+int bip_send_mpdu_list(BACNET_IP_ADDRESS *dest_list,
+    unsigned dest_count,
+    uint8_t *mtu,
+    uint16_t mtu_len,
+    bool *sent)
+{
+    unsigned i = 0;
+
+    Test_Sent_Message_Count += dest_count;
+    for (i = 0; i < dest_count; i++) {
+        bip_send_mpdu(&dest_list[i], mtu, mtu_len);
+        if (sent) {
+            sent[i] = true;
+        }
+    }
+
+    return dest_count;
+}
+
 /** Return the Object Instance number for our (single) Device Object.
  * This is a key function, widely invoked by the handler code, since
  * it provides "our" (ie, local) address.
@@ -240,6 +278,230 @@ static void test_BBMD_Result(Test *pTest)
     }
 }
 
+static void test_BBMD_BDT_Entry(
+    const char *addrstr, uint32_t broadcast_mask)
+{
+    BACNET_IP_BROADCAST_DISTRIBUTION_TABLE_ENTRY bdt_entry = { 0 };
+
+    bvlc_address_port_from_ascii(&bdt_entry.dest_address, addrstr, "0xBAC0");
+    bvlc_broadcast_distribution_mask_from_host(
+        &bdt_entry.broadcast_mask, broadcast_mask);
+    bvlc_broadcast_distribution_table_entry_append(bvlc_bdt_list(), &bdt_entry);
+}
+
+/**
+ * @brief Test that broadcasts are forwarded once to each distinct
+ *  destination of the BDT and the FDT, but not to self or origin
+ */
+static void test_BBMD_Forward(Test *pTest)
+{
+    BACNET_IP_FORWARD_COUNTS counts[4];
+    BACNET_IP_ADDRESS addr;
+    BACNET_ADDRESS src;
+    /* Who-Is */
+    uint8_t npdu[4] = { BACNET_PROTOCOL_VERSION, 0,
+        PDU_TYPE_UNCONFIRMED_SERVICE_REQUEST, SERVICE_UNCONFIRMED_WHO_IS };
+    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint16_t mtu_len = 0;
+    unsigned count = 0;
+
+    test_setup();
+    bvlc_address_port_from_ascii(&IUT.BIP_Addr, "192.168.1.10", "0xBAC0");
+    bvlc_bdt_list_clear();
+    test_BBMD_BDT_Entry("192.168.1.10", 0xFFFFFFFFL);
+    /* both of these forward to 10.0.0.255 */
+    test_BBMD_BDT_Entry("10.0.0.1", 0xFFFFFF00L);
+    test_BBMD_BDT_Entry("10.0.0.2", 0xFFFFFF00L);
+    test_BBMD_BDT_Entry("10.0.1.1", 0xFFFFFFFFL);
+    bvlc_bdt_list_changed();
+    count = bvlc_bdt_forward_counts(counts, 4);
+    ct_test(pTest, count == 2);
+    /* a foreign device registers */
+    bvlc_address_port_from_ascii(&addr, "172.16.0.5", "0xBAC0");
+    mtu_len = bvlc_encode_register_foreign_device(&mtu[0], sizeof(mtu), 60);
+    bvlc_bbmd_enabled_handler(&addr, &src, &mtu[0], mtu_len);
+    count = bvlc_fdt_forward_counts(counts, 4);
+    ct_test(pTest, count == 1);
+
+    /* a local broadcast goes to the BDT peers and the foreign device */
+    Test_Sent_Message_Count = 0;
+    bvlc_address_port_from_ascii(&addr, "192.168.1.100", "0xBAC0");
+    mtu_len = bvlc_encode_original_broadcast(
+        &mtu[0], sizeof(mtu), npdu, sizeof(npdu));
+    bvlc_bbmd_enabled_handler(&addr, &src, &mtu[0], mtu_len);
+    ct_test(pTest, Test_Sent_Message_Count == 3);
+    /* the foreign device broadcast goes to the BDT peers only */
+    Test_Sent_Message_Count = 0;
+    bvlc_address_port_from_ascii(&addr, "172.16.0.5", "0xBAC0");
+    mtu_len = bvlc_encode_distribute_broadcast_to_network(
+        &mtu[0], sizeof(mtu), npdu, sizeof(npdu));
+    bvlc_bbmd_enabled_handler(&addr, &src, &mtu[0], mtu_len);
+    ct_test(pTest, Test_Sent_Message_Count == 2);
+    count = bvlc_bdt_forward_counts(counts, 4);
+    ct_test(pTest, count == 2);
+    ct_test(pTest, counts[0].forwarded == 2);
+    ct_test(pTest, counts[1].forwarded == 2);
+    ct_test(pTest, counts[0].dropped == 0);
+    count = bvlc_fdt_forward_counts(counts, 4);
+    ct_test(pTest, count == 1);
+    ct_test(pTest, counts[0].forwarded == 1);
+    bvlc_maintenance_timer(1);
+    count = bvlc_fdt_forward_counts(counts, 4);
+    ct_test(pTest, counts[0].rate == 1);
+    /* and leaves when its time to live is up */
+    bvlc_maintenance_timer(90);
+    count = bvlc_fdt_forward_counts(counts, 4);
+    ct_test(pTest, count == 0);
+    bvlc_bdt_list_clear();
+    test_cleanup();
+}
+
+static void test_BBMD_FD_Register(unsigned number, uint16_t ttl_seconds)
+{
+    BACNET_IP_ADDRESS addr = { 0 };
+    BACNET_ADDRESS src = { 0 };
+    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint16_t mtu_len = 0;
+
+    bvlc_address_set(&addr, 172, 16, number / 256, number % 256);
+    addr.port = 0xBAC0;
+    mtu_len = bvlc_encode_register_foreign_device(
+        &mtu[0], sizeof(mtu), ttl_seconds);
+    bvlc_bbmd_enabled_handler(&addr, &src, &mtu[0], mtu_len);
+}
+
+static uint16_t test_BBMD_FD_Remaining(unsigned number)
+{
+    BACNET_IP_FOREIGN_DEVICE_TABLE_ENTRY *fdt_entry = NULL;
+    BACNET_IP_ADDRESS addr = { 0 };
+
+    bvlc_address_set(&addr, 172, 16, number / 256, number % 256);
+    addr.port = 0xBAC0;
+    for (fdt_entry = bvlc_fdt_list(); fdt_entry; fdt_entry = fdt_entry->next) {
+        if (fdt_entry->valid &&
+            !bvlc_address_different(&fdt_entry->dest_address, &addr)) {
+            return fdt_entry->ttl_seconds_remaining;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Count the entries in the FDT backup file
+ */
+static unsigned test_BBMD_FD_Backup_Count(const char *pathname)
+{
+    FILE *file = NULL;
+    long size = 0;
+
+    file = fopen(pathname, "rb");
+    if (!file) {
+        return 0;
+    }
+    if (fseek(file, 0, SEEK_END) == 0) {
+        size = ftell(file);
+    }
+    fclose(file);
+    if (size < 4) {
+        return 0;
+    }
+
+    return (unsigned)(size - 4) / BACNET_IP_FDT_ENTRY_SIZE;
+}
+
+/**
+ * @brief Test that the FDT grows, renews and expires its foreign devices,
+ *  and that it is kept across restarts
+ */
+static void test_BBMD_FDT(Test *pTest)
+{
+    const char *backup = "fdt_backup.tmp";
+    BACNET_IP_ADDRESS addr = { 0 };
+    BACNET_ADDRESS src = { 0 };
+    uint8_t mtu[MAX_MPDU] = { 0 };
+    uint16_t mtu_len = 0;
+    unsigned count = 0;
+    unsigned i = 0;
+
+    test_setup();
+    bvlc_fdt_clock_set(test_clock);
+    remove(backup);
+    bvlc_address_port_from_ascii(&IUT.BIP_Addr, "192.168.1.10", "0xBAC0");
+    /* more foreign devices than fit in one block of the table */
+    for (i = 0; i < 300; i++) {
+        test_BBMD_FD_Register(i, 10 + (i % 50));
+    }
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 300);
+    count = bvlc_fdt_forward_counts(NULL, 0);
+    ct_test(pTest, count == 300);
+    /* a renewal restarts the timer */
+    test_BBMD_FD_Register(0, 100);
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 300);
+    ct_test(pTest, test_BBMD_FD_Remaining(0) == 130);
+    /* the shortest times to live run out first */
+    bvlc_maintenance_timer(39);
+    count = bvlc_fdt_forward_counts(NULL, 0);
+    ct_test(pTest, count == 300);
+    bvlc_maintenance_timer(1);
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 295);
+    count = bvlc_fdt_forward_counts(NULL, 0);
+    ct_test(pTest, count == 295);
+    ct_test(pTest, test_BBMD_FD_Remaining(0) == 90);
+    ct_test(pTest, test_BBMD_FD_Remaining(50) == 0);
+    ct_test(pTest, test_BBMD_FD_Remaining(51) == 1);
+    /* a delete */
+    bvlc_address_set(&addr, 172, 16, 0, 1);
+    addr.port = 0xBAC0;
+    mtu_len =
+        bvlc_encode_delete_foreign_device(&mtu[0], sizeof(mtu), &addr);
+    bvlc_bbmd_enabled_handler(&addr, &src, &mtu[0], mtu_len);
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 294);
+    ct_test(pTest, test_BBMD_FD_Remaining(1) == 0);
+    /* a new registration takes a free entry */
+    test_BBMD_FD_Register(1000, 60);
+    count = bvlc_fdt_forward_counts(NULL, 0);
+    ct_test(pTest, count == 295);
+    /* the table survives a restart, less the time it was down for */
+    ct_test(pTest, bvlc_fdt_backup_file_set(backup));
+    bvlc_maintenance_timer(1);
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 290);
+    ct_test(pTest, test_BBMD_FD_Backup_Count(backup) == 290);
+    Test_Time += 10;
+    bvlc_init();
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 230);
+    ct_test(pTest, test_BBMD_FD_Remaining(0) == 79);
+    ct_test(pTest, test_BBMD_FD_Remaining(1000) == 79);
+    ct_test(pTest, test_BBMD_FD_Remaining(12) == 1);
+    count = bvlc_fdt_forward_counts(NULL, 0);
+    ct_test(pTest, count == 230);
+    /* the changes are written at most once each interval */
+    test_BBMD_FD_Register(2000, 600);
+    test_BBMD_FD_Register(2001, 600);
+    bvlc_maintenance_timer(1);
+    ct_test(pTest, test_BBMD_FD_Backup_Count(backup) == 290);
+    bvlc_maintenance_timer(BBMD_FDT_BACKUP_INTERVAL - 1);
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, test_BBMD_FD_Backup_Count(backup) == count);
+    test_BBMD_FD_Register(2002, 600);
+    ct_test(pTest, test_BBMD_FD_Backup_Count(backup) == count);
+    /* and the last changes when the file is let go */
+    ct_test(pTest, bvlc_fdt_backup_file_set(NULL));
+    ct_test(pTest, test_BBMD_FD_Backup_Count(backup) == (count + 1));
+    bvlc_init();
+    count = bvlc_foreign_device_table_valid_count(bvlc_fdt_list());
+    ct_test(pTest, count == 0);
+    remove(backup);
+    bvlc_fdt_clock_set(NULL);
+    test_cleanup();
+}
+
 static void test_BBMD_Handler(Test *pTest)
 {
     bool rc;
@@ -249,6 +511,10 @@ static void test_BBMD_Handler(Test *pTest)
     assert(rc);
     rc = ct_addTestFunction(pTest, test_Initiate_Original_Broadcast_NPDU);
     assert(rc);
+    rc = ct_addTestFunction(pTest, test_BBMD_Forward);
+    assert(rc);
+    rc = ct_addTestFunction(pTest, test_BBMD_FDT);
+    assert(rc);
 }
 
 int main(void)
@@ -57,6 +57,11 @@ static uint8_t Test_Sent_Message_Length;
 static uint8_t Test_Sent_Message_Buffer[MAX_MPDU];
 static uint16_t Test_Sent_Message_Buffer_Length;
 static BACNET_IP6_ADDRESS Test_Sent_Message_Dest;
+/* for the Forwarded-NPDU destinations sent from the handler */
+static BACNET_IP6_ADDRESS Test_Forward_List[8];
+static unsigned Test_Forward_Count;
+static BACNET_IP6_ADDRESS Test_Forward_Drop;
+static uint8_t Test_Forward_Message_Type;
 
 /* network stub functions */
 /**
@@ -107,6 +112,44 @@ int bip6_send_mpdu(BACNET_IP6_ADDRESS *dest, uint8_t *mtu, uint16_t mtu_len)
     return 0;
 }
 
+/**
+ * The send function for a list of BACnet/IPv6 destinations
+ *
+ * @param dest_list - array of destination addresses
+ * @param dest_count - number of destinations in the array
+ * @param mtu - the bytes of data to send
+ * @param mtu_len - the number of bytes of data to send
+ * @param sent - array that returns true for each destination sent to,
+ *  and false for the destination matching Test_Forward_Drop
+ *
+ * @return the number of destinations that the data was sent to
+ */
+int bip6_send_mpdu_list(BACNET_IP6_ADDRESS *dest_list,
+    unsigned dest_count,
+    uint8_t *mtu,
+    uint16_t mtu_len,
+    bool *sent)
+{
+    uint16_t message_length = 0;
+    unsigned i = 0;
+    int count = 0;
+
+    bvlc6_decode_header(
+        mtu, mtu_len, &Test_Forward_Message_Type, &message_length);
+    Test_Forward_Count = dest_count;
+    for (i = 0; i < dest_count; i++) {
+        if (i < (sizeof(Test_Forward_List) / sizeof(Test_Forward_List[0]))) {
+            bvlc6_address_copy(&Test_Forward_List[i], &dest_list[i]);
+        }
+        sent[i] = bvlc6_address_different(&dest_list[i], &Test_Forward_Drop);
+        if (sent[i]) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
 /** Return the Object Instance number for our (single) Device Object.
  * This is a key function, widely invoked by the handler code, since
  * it provides "our" (ie, local) address.
@@ -283,6 +326,180 @@ static void test_BBMD_Result(Test *pTest)
     }
 }
 
+/**
+ * @brief Find the forward counts of an address
+ */
+static BACNET_IP6_FORWARD_COUNTS *test_forward_counts_find(
+    BACNET_IP6_FORWARD_COUNTS *counts,
+    unsigned count,
+    BACNET_IP6_ADDRESS *addr)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < count; i++) {
+        if (!bvlc6_address_different(&counts[i].dest_address, addr)) {
+            return &counts[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find an address in the forwarded destination list
+ */
+static bool test_forward_list_contains(BACNET_IP6_ADDRESS *addr)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < Test_Forward_Count; i++) {
+        if (!bvlc6_address_different(&Test_Forward_List[i], addr)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Test the Forwarded-NPDU destinations and the BDT and FDT counts
+ */
+static void test_BBMD_Forward_NPDU(Test *pTest)
+{
+    BACNET_IP6_BROADCAST_DISTRIBUTION_TABLE_ENTRY *bdt = NULL;
+    BACNET_IP6_FOREIGN_DEVICE_TABLE_ENTRY *fdt = NULL;
+    BACNET_IP6_FORWARD_COUNTS counts[8] = { 0 };
+    BACNET_IP6_FORWARD_COUNTS *entry = NULL;
+    BACNET_IP6_ADDRESS bbmd_a = { { 0 } };
+    BACNET_IP6_ADDRESS bbmd_b = { { 0 } };
+    BACNET_IP6_ADDRESS fd_a = { { 0 } };
+    BACNET_IP6_ADDRESS fd_b = { { 0 } };
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_ADDRESS src = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t npdu[MAX_MPDU] = { 0 };
+    uint8_t mtu[MAX_MPDU] = { 0 };
+    int npdu_len = 0;
+    int mtu_len = 0;
+    unsigned count = 0;
+
+    test_setup();
+    bvlc6_address_set(&bbmd_a, 0x2001, 0x0DBB, 0xAC10, 0xFE02, 0, 0, 0, 1);
+    bbmd_a.port = 0xBAC0U;
+    bvlc6_address_set(&bbmd_b, 0x2001, 0x0DBB, 0xAC10, 0xFE03, 0, 0, 0, 1);
+    bbmd_b.port = 0xBAC0U;
+    bvlc6_address_set(&fd_a, 0x2001, 0x0DBB, 0xAC10, 0xFE04, 0, 0, 0, 1);
+    fd_a.port = 0xBAC0U;
+    bvlc6_address_set(&fd_b, 0x2001, 0x0DBB, 0xAC10, 0xFE05, 0, 0, 0, 1);
+    fd_b.port = 0xBAC0U;
+    /* BDT: two peers and an entry for this BBMD */
+    bdt = bvlc6_bdt_list();
+    ct_test(pTest, bdt != NULL);
+    bdt->valid = true;
+    bvlc6_address_copy(&bdt->bip6_address, &bbmd_a);
+    bdt = bdt->next;
+    bdt->valid = true;
+    bvlc6_address_copy(&bdt->bip6_address, &IUT.BIP6_Addr);
+    bdt = bdt->next;
+    bdt->valid = true;
+    bvlc6_address_copy(&bdt->bip6_address, &bbmd_b);
+    /* FDT: two foreign devices and an entry for this BBMD */
+    fdt = bvlc6_fdt_list();
+    ct_test(pTest, fdt != NULL);
+    fdt->valid = true;
+    bvlc6_address_copy(&fdt->bip6_address, &fd_a);
+    fdt->ttl_seconds = 60;
+    fdt->ttl_seconds_remaining = 60;
+    fdt = fdt->next;
+    fdt->valid = true;
+    bvlc6_address_copy(&fdt->bip6_address, &IUT.BIP6_Addr);
+    fdt->ttl_seconds = 60;
+    fdt->ttl_seconds_remaining = 60;
+    fdt = fdt->next;
+    fdt->valid = true;
+    bvlc6_address_copy(&fdt->bip6_address, &fd_b);
+    fdt->ttl_seconds = 10;
+    fdt->ttl_seconds_remaining = 10;
+    /* an unconfirmed broadcast NPDU */
+    dest.net = BACNET_BROADCAST_NETWORK;
+    npdu_encode_npdu_data(&npdu_data, false, MESSAGE_PRIORITY_NORMAL);
+    npdu_len = npdu_encode_pdu(&npdu[0], &dest, &TD.BACnet_Address,
+        &npdu_data);
+    npdu_len += iam_encode_apdu(&npdu[npdu_len], TD.Device_ID, MAX_APDU,
+        SEGMENTATION_NONE, BACNET_VENDOR_ID);
+    /* Original-Broadcast-NPDU: unicast to the BDT and FDT, except self */
+    bvlc6_address_copy(&Test_Forward_Drop, &bbmd_b);
+    Test_Forward_Count = 0;
+    mtu_len = bvlc6_encode_original_broadcast(
+        &mtu[0], sizeof(mtu), TD.Device_ID, &npdu[0], npdu_len);
+    ct_test(pTest, mtu_len > 0);
+    bvlc6_bbmd_enabled_handler(&TD.BIP6_Addr, &src, &mtu[0], mtu_len);
+    ct_test(pTest, Test_Forward_Message_Type == BVLC6_FORWARDED_NPDU);
+    ct_test(pTest, Test_Forward_Count == 4);
+    ct_test(pTest, test_forward_list_contains(&bbmd_a));
+    ct_test(pTest, test_forward_list_contains(&bbmd_b));
+    ct_test(pTest, test_forward_list_contains(&fd_a));
+    ct_test(pTest, test_forward_list_contains(&fd_b));
+    ct_test(pTest, !test_forward_list_contains(&IUT.BIP6_Addr));
+    ct_test(pTest, !test_forward_list_contains(&IUT.BIP6_Broadcast_Addr));
+    count = bvlc6_bdt_forward_counts(counts, 8);
+    ct_test(pTest, count == 3);
+    entry = test_forward_counts_find(counts, count, &bbmd_a);
+    ct_test(pTest, entry && (entry->forwarded == 1) && (entry->dropped == 0));
+    entry = test_forward_counts_find(counts, count, &bbmd_b);
+    ct_test(pTest, entry && (entry->forwarded == 0) && (entry->dropped == 1));
+    entry = test_forward_counts_find(counts, count, &IUT.BIP6_Addr);
+    ct_test(pTest, entry && (entry->forwarded == 0) && (entry->dropped == 0));
+    count = bvlc6_fdt_forward_counts(counts, 8);
+    ct_test(pTest, count == 3);
+    entry = test_forward_counts_find(counts, count, &fd_a);
+    ct_test(pTest, entry && (entry->forwarded == 1) && (entry->dropped == 0));
+    entry = test_forward_counts_find(counts, count, &fd_b);
+    ct_test(pTest, entry && (entry->forwarded == 1) && (entry->dropped == 0));
+    entry = test_forward_counts_find(counts, count, &IUT.BIP6_Addr);
+    ct_test(pTest, entry && (entry->forwarded == 0) && (entry->dropped == 0));
+    /* Forwarded-NPDU: multicast to the local domain, unicast to the FDT */
+    bvlc6_address_copy(&Test_Forward_Drop, &fd_b);
+    Test_Forward_Count = 0;
+    mtu_len = bvlc6_encode_forwarded_npdu(&mtu[0], sizeof(mtu), TD.Device_ID,
+        &TD.BIP6_Addr, &npdu[0], npdu_len);
+    ct_test(pTest, mtu_len > 0);
+    bvlc6_bbmd_enabled_handler(&bbmd_a, &src, &mtu[0], mtu_len);
+    ct_test(pTest, Test_Forward_Message_Type == BVLC6_FORWARDED_NPDU);
+    ct_test(pTest, Test_Forward_Count == 3);
+    ct_test(pTest, test_forward_list_contains(&IUT.BIP6_Broadcast_Addr));
+    ct_test(pTest, test_forward_list_contains(&fd_a));
+    ct_test(pTest, test_forward_list_contains(&fd_b));
+    ct_test(pTest, !test_forward_list_contains(&bbmd_a));
+    ct_test(pTest, !test_forward_list_contains(&bbmd_b));
+    ct_test(pTest, !test_forward_list_contains(&IUT.BIP6_Addr));
+    /* the multicast is not counted against any BDT entry */
+    count = bvlc6_bdt_forward_counts(counts, 8);
+    entry = test_forward_counts_find(counts, count, &bbmd_a);
+    ct_test(pTest, entry && (entry->forwarded == 1) && (entry->dropped == 0));
+    entry = test_forward_counts_find(counts, count, &bbmd_b);
+    ct_test(pTest, entry && (entry->forwarded == 0) && (entry->dropped == 1));
+    count = bvlc6_fdt_forward_counts(counts, 8);
+    entry = test_forward_counts_find(counts, count, &fd_a);
+    ct_test(pTest, entry && (entry->forwarded == 2) && (entry->dropped == 0));
+    entry = test_forward_counts_find(counts, count, &fd_b);
+    ct_test(pTest, entry && (entry->forwarded == 1) && (entry->dropped == 1));
+    /* the counts of a foreign device are reset when its entry expires */
+    bvlc6_maintenance_timer(10);
+    count = bvlc6_fdt_forward_counts(counts, 8);
+    ct_test(pTest, count == 2);
+    ct_test(pTest, test_forward_counts_find(counts, count, &fd_b) == NULL);
+    entry = test_forward_counts_find(counts, count, &fd_a);
+    ct_test(pTest, entry && (entry->forwarded == 2) && (entry->dropped == 0));
+    fdt->valid = true;
+    fdt->ttl_seconds_remaining = fdt->ttl_seconds;
+    count = bvlc6_fdt_forward_counts(counts, 8);
+    ct_test(pTest, count == 3);
+    entry = test_forward_counts_find(counts, count, &fd_b);
+    ct_test(pTest, entry && (entry->forwarded == 0) && (entry->dropped == 0));
+    test_cleanup();
+}
+
 static void test_BBMD6(Test *pTest)
 {
     bool rc;
@@ -294,6 +511,8 @@ static void test_BBMD6(Test *pTest)
     assert(rc);
     rc = ct_addTestFunction(pTest, test_Initiate_Original_Broadcast_NPDU);
     assert(rc);
+    rc = ct_addTestFunction(pTest, test_BBMD_Forward_NPDU);
+    assert(rc);
 }
 
 int main(void)
@@ -186,6 +186,69 @@ static void testAddress(void)
         zassert_equal(count, (MAX_ADDRESS_CACHE - i - 1), NULL);
     }
 }
+
+static void testAddressEviction(void)
+{
+    unsigned i;
+    BACNET_ADDRESS src;
+    BACNET_ADDRESS test_address;
+    uint32_t test_device_id = 0;
+    unsigned test_max_apdu = 0;
+    unsigned max_apdu = 480;
+
+    address_init();
+    /* fill the cache */
+    for (i = 0; i < MAX_ADDRESS_CACHE; i++) {
+        set_address(i, &src);
+        address_add(i + 1, max_apdu, &src);
+    }
+    zassert_equal(address_count(), MAX_ADDRESS_CACHE, NULL);
+    /* use the oldest entry so that the next oldest gets evicted */
+    zassert_true(
+        address_get_by_device(1, &test_max_apdu, &test_address), NULL);
+    set_address(MAX_ADDRESS_CACHE, &src);
+    address_add(MAX_ADDRESS_CACHE + 1, max_apdu, &src);
+    zassert_equal(address_count(), MAX_ADDRESS_CACHE, NULL);
+    zassert_true(
+        address_get_by_device(1, &test_max_apdu, &test_address), NULL);
+    zassert_false(
+        address_get_by_device(2, &test_max_apdu, &test_address), NULL);
+    zassert_true(address_get_by_device(
+        MAX_ADDRESS_CACHE + 1, &test_max_apdu, &test_address), NULL);
+    zassert_true(bacnet_address_same(&test_address, &src), NULL);
+    zassert_true(address_get_device_id(&src, &test_device_id), NULL);
+    zassert_equal(test_device_id, MAX_ADDRESS_CACHE + 1, NULL);
+    /* the old address of the evicted device is no longer indexed */
+    set_address(1, &src);
+    zassert_false(address_get_device_id(&src, &test_device_id), NULL);
+    /* a changed address replaces the old one in the MAC index */
+    set_address(0, &src);
+    zassert_true(address_get_device_id(&src, &test_device_id), NULL);
+    zassert_equal(test_device_id, 1, NULL);
+    set_address(1, &src);
+    address_add(1, max_apdu, &src);
+    zassert_true(address_get_device_id(&src, &test_device_id), NULL);
+    zassert_equal(test_device_id, 1, NULL);
+    set_address(0, &src);
+    zassert_false(address_get_device_id(&src, &test_device_id), NULL);
+    /* a static entry is never evicted */
+    address_set_device_TTL(3, 0, true);
+    address_get_by_device(3, &test_max_apdu, &test_address);
+    for (i = 0; i < MAX_ADDRESS_CACHE; i++) {
+        set_address(i, &src);
+        src.net = 8;
+        address_add(0x10000 + i, max_apdu, &src);
+    }
+    zassert_true(
+        address_get_by_device(3, &test_max_apdu, &test_address), NULL);
+    zassert_equal(address_count(), MAX_ADDRESS_CACHE, NULL);
+    /* expired entries are released back to the cache */
+    address_cache_timer(0xFFFF);
+    address_cache_timer(0xFFFF);
+    zassert_equal(address_count(), 1, NULL);
+    address_init();
+    zassert_equal(address_count(), 0, NULL);
+}
 /**
  * @}
  */
@@ -196,13 +259,15 @@ void test_main(void)
 #ifdef BACNET_ADDRESS_CACHE_FILE
     ztest_test_suite(address_tests,
      ztest_unit_test(testAddressFile),
-     ztest_unit_test(testAddress)
+     ztest_unit_test(testAddress),
+     ztest_unit_test(testAddressEviction)
      );
 
     ztest_run_test_suite(address_tests);
 #else
     ztest_test_suite(address_tests,
-     ztest_unit_test(testAddress)
+     ztest_unit_test(testAddress),
+     ztest_unit_test(testAddressEviction)
      );
 
     ztest_run_test_suite(address_tests);
@@ -46,6 +46,49 @@ static void testAnalogInput(void)
 
     return;
 }
+
+/**
+ * @brief Test creating and deleting sparse object instances
+ */
+static void testAnalogInputCreateDelete(void)
+{
+    const uint32_t num_objects = 1000;
+    uint32_t instance;
+    unsigned count;
+    unsigned i;
+
+    Analog_Input_Init();
+    count = Analog_Input_Count();
+    for (i = 0; i < num_objects; i++) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Input_Create(instance), NULL);
+        Analog_Input_Present_Value_Set(instance, (float)i);
+    }
+    zassert_equal(Analog_Input_Count(), count + num_objects, NULL);
+    zassert_true(Analog_Input_Create(100000), NULL);
+    zassert_equal(Analog_Input_Count(), count + num_objects, NULL);
+    zassert_false(Analog_Input_Create(BACNET_MAX_INSTANCE), NULL);
+    zassert_false(Analog_Input_Valid_Instance(100001), NULL);
+    for (i = 0; i < num_objects; i += 2) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Input_Delete(instance), NULL);
+        zassert_false(Analog_Input_Valid_Instance(instance), NULL);
+    }
+    zassert_equal(Analog_Input_Count(), count + (num_objects / 2), NULL);
+    for (i = 1; i < num_objects; i += 2) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Input_Valid_Instance(instance), NULL);
+        zassert_true(Analog_Input_Present_Value(instance) == (float)i, NULL);
+    }
+    for (i = 0; i < Analog_Input_Count(); i++) {
+        instance = Analog_Input_Index_To_Instance(i);
+        zassert_equal(Analog_Input_Instance_To_Index(instance), i, NULL);
+    }
+    Analog_Input_Cleanup();
+    zassert_equal(Analog_Input_Count(), 0, NULL);
+
+    return;
+}
 /**
  * @}
  */
@@ -54,7 +97,8 @@ static void testAnalogInput(void)
 void test_main(void)
 {
     ztest_test_suite(ai_tests,
-     ztest_unit_test(testAnalogInput)
+     ztest_unit_test(testAnalogInput),
+     ztest_unit_test(testAnalogInputCreateDelete)
      );
 
     ztest_run_test_suite(ai_tests);
@@ -46,6 +46,76 @@ static void testAnalogOutput(void)
 
     return;
 }
+
+/**
+ * @brief Test creating and deleting sparse object instances
+ */
+static void testAnalogOutputCreateDelete(void)
+{
+    const uint32_t num_objects = 1000;
+    uint32_t instance;
+    unsigned count;
+    unsigned i;
+
+    Analog_Output_Init();
+    count = Analog_Output_Count();
+    for (i = 0; i < num_objects; i++) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Output_Create(instance), NULL);
+        zassert_true(
+            Analog_Output_Present_Value_Set(instance, (float)(i % 100), 8),
+            NULL);
+    }
+    zassert_equal(Analog_Output_Count(), count + num_objects, NULL);
+    zassert_true(Analog_Output_Create(100000), NULL);
+    zassert_equal(Analog_Output_Count(), count + num_objects, NULL);
+    zassert_false(Analog_Output_Create(BACNET_MAX_INSTANCE), NULL);
+    zassert_false(Analog_Output_Valid_Instance(100001), NULL);
+    for (i = 0; i < num_objects; i += 2) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Output_Delete(instance), NULL);
+        zassert_false(Analog_Output_Valid_Instance(instance), NULL);
+        zassert_false(Analog_Output_Delete(instance), NULL);
+    }
+    zassert_equal(Analog_Output_Count(), count + (num_objects / 2), NULL);
+    for (i = 1; i < num_objects; i += 2) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Output_Valid_Instance(instance), NULL);
+        zassert_true(
+            Analog_Output_Present_Value(instance) == (float)(i % 100), NULL);
+        zassert_equal(Analog_Output_Present_Value_Priority(instance), 8, NULL);
+    }
+    for (i = 0; i < Analog_Output_Count(); i++) {
+        instance = Analog_Output_Index_To_Instance(i);
+        zassert_equal(Analog_Output_Instance_To_Index(instance), i, NULL);
+    }
+    Analog_Output_Cleanup();
+    zassert_equal(Analog_Output_Count(), 0, NULL);
+
+    return;
+}
+
+/**
+ * @brief Test that Init sets up the same objects each time it is called
+ */
+static void testAnalogOutputInit(void)
+{
+    unsigned count;
+
+    Analog_Output_Init();
+    count = Analog_Output_Count();
+    zassert_true(count > 0, NULL);
+    zassert_true(Analog_Output_Present_Value_Set(0, 50.0f, 1), NULL);
+    zassert_true(Analog_Output_Create(12345), NULL);
+    Analog_Output_Init();
+    zassert_equal(Analog_Output_Count(), count, NULL);
+    zassert_false(Analog_Output_Valid_Instance(12345), NULL);
+    zassert_true(Analog_Output_Valid_Instance(0), NULL);
+    zassert_equal(Analog_Output_Present_Value_Priority(0), 0, NULL);
+    zassert_true(Analog_Output_Present_Value(0) == 0.0f, NULL);
+
+    return;
+}
 /**
  * @}
  */
@@ -54,7 +124,9 @@ static void testAnalogOutput(void)
 void test_main(void)
 {
     ztest_test_suite(ao_tests,
-     ztest_unit_test(testAnalogOutput)
+     ztest_unit_test(testAnalogOutput),
+     ztest_unit_test(testAnalogOutputCreateDelete),
+     ztest_unit_test(testAnalogOutputInit)
      );
 
     ztest_run_test_suite(ao_tests);
@@ -46,6 +46,72 @@ static void testAnalog_Value(void)
 
     return;
 }
+
+/**
+ * @brief Test creating and deleting sparse object instances
+ */
+static void testAnalog_Value_Create_Delete(void)
+{
+    const uint32_t num_objects = 1000;
+    uint32_t instance;
+    unsigned count;
+    unsigned i;
+
+    Analog_Value_Init();
+    count = Analog_Value_Count();
+    for (i = 0; i < num_objects; i++) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Value_Create(instance), NULL);
+        zassert_true(
+            Analog_Value_Present_Value_Set(instance, (float)i, 16), NULL);
+    }
+    zassert_equal(Analog_Value_Count(), count + num_objects, NULL);
+    zassert_true(Analog_Value_Create(100000), NULL);
+    zassert_equal(Analog_Value_Count(), count + num_objects, NULL);
+    zassert_false(Analog_Value_Create(BACNET_MAX_INSTANCE), NULL);
+    zassert_false(Analog_Value_Valid_Instance(100001), NULL);
+    for (i = 0; i < num_objects; i += 2) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Value_Delete(instance), NULL);
+        zassert_false(Analog_Value_Valid_Instance(instance), NULL);
+        zassert_false(Analog_Value_Delete(instance), NULL);
+    }
+    zassert_equal(Analog_Value_Count(), count + (num_objects / 2), NULL);
+    for (i = 1; i < num_objects; i += 2) {
+        instance = 100000 + (i * 37);
+        zassert_true(Analog_Value_Valid_Instance(instance), NULL);
+        zassert_true(Analog_Value_Present_Value(instance) == (float)i, NULL);
+    }
+    for (i = 0; i < Analog_Value_Count(); i++) {
+        instance = Analog_Value_Index_To_Instance(i);
+        zassert_equal(Analog_Value_Instance_To_Index(instance), i, NULL);
+    }
+    Analog_Value_Cleanup();
+    zassert_equal(Analog_Value_Count(), 0, NULL);
+
+    return;
+}
+
+/**
+ * @brief Test that Init sets up the same objects each time it is called
+ */
+static void testAnalog_Value_Init(void)
+{
+    unsigned count;
+
+    Analog_Value_Init();
+    count = Analog_Value_Count();
+    zassert_true(count > 0, NULL);
+    zassert_true(Analog_Value_Present_Value_Set(0, 50.0f, 16), NULL);
+    zassert_true(Analog_Value_Create(12345), NULL);
+    Analog_Value_Init();
+    zassert_equal(Analog_Value_Count(), count, NULL);
+    zassert_false(Analog_Value_Valid_Instance(12345), NULL);
+    zassert_true(Analog_Value_Valid_Instance(0), NULL);
+    zassert_true(Analog_Value_Present_Value(0) == 0.0f, NULL);
+
+    return;
+}
 /**
  * @}
  */
@@ -54,7 +120,9 @@ static void testAnalog_Value(void)
 void test_main(void)
 {
     ztest_test_suite(av_tests,
-     ztest_unit_test(testAnalog_Value)
+     ztest_unit_test(testAnalog_Value),
+     ztest_unit_test(testAnalog_Value_Create_Delete),
+     ztest_unit_test(testAnalog_Value_Init)
      );
 
     ztest_run_test_suite(av_tests);
@@ -0,0 +1,167 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test BACnet File object APIs
+ */
+
+#include <ztest.h>
+#include <stdio.h>
+#include <string.h>
+#include <bacnet/basic/object/bacfile.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+static void bacfile_write_record(int32_t record, const char *text)
+{
+    BACNET_ATOMIC_WRITE_FILE_DATA data = { 0 };
+    bool status;
+
+    data.object_type = OBJECT_FILE;
+    data.object_instance = 0;
+    data.access = FILE_RECORD_ACCESS;
+    data.type.record.fileStartRecord = record;
+    data.type.record.returnedRecordCount = 1;
+    octetstring_init(&data.fileData[0], (uint8_t *)text, strlen(text));
+    status = bacfile_write_record_data(&data);
+    zassert_true(status, NULL);
+}
+
+static void bacfile_read_record(int32_t record,
+    const char *text,
+    bool end_of_file)
+{
+    BACNET_ATOMIC_READ_FILE_DATA data = { 0 };
+    bool status;
+
+    data.object_type = OBJECT_FILE;
+    data.object_instance = 0;
+    data.access = FILE_RECORD_ACCESS;
+    data.type.record.fileStartRecord = record;
+    data.type.record.RecordCount = 1;
+    status = bacfile_read_record_data(&data);
+    zassert_true(status, NULL);
+    zassert_equal(data.endOfFile, end_of_file, NULL);
+    if (text) {
+        zassert_equal(data.type.record.RecordCount, 1, NULL);
+        zassert_equal(octetstring_length(&data.fileData[0]), strlen(text),
+            NULL);
+        zassert_mem_equal(octetstring_value(&data.fileData[0]), text,
+            strlen(text), NULL);
+    } else {
+        zassert_equal(data.type.record.RecordCount, 0, NULL);
+    }
+}
+
+/**
+ * @brief Test reading and writing records, which are lines of the file
+ */
+static void testBACfile_Records(void)
+{
+    BACNET_ATOMIC_WRITE_FILE_DATA data = { 0 };
+    char text[32];
+    unsigned i;
+
+    bacfile_init();
+    bacfile_write_record(0, "line0\n");
+    bacfile_write_record(-1, "line1\n");
+    bacfile_write_record(-1, "line2\n");
+    zassert_equal(bacfile_file_size(0), 18, NULL);
+    bacfile_read_record(0, "line0\n", false);
+    bacfile_read_record(2, "line2\n", true);
+    bacfile_read_record(1, "line1\n", false);
+    bacfile_read_record(3, NULL, true);
+    /* writing over a record moves the records after it */
+    bacfile_write_record(1, "LINE-ONE-LONGER\n");
+    bacfile_read_record(1, "LINE-ONE-LONGER\n", true);
+    bacfile_read_record(2, NULL, true);
+    /* a last record without a newline grows when appended to */
+    data.object_type = OBJECT_FILE;
+    data.object_instance = 0;
+    data.access = FILE_STREAM_ACCESS;
+    data.type.stream.fileStartPosition = -1;
+    octetstring_init(&data.fileData[0], (uint8_t *)"abc", 3);
+    zassert_true(bacfile_write_stream_data(&data), NULL);
+    bacfile_read_record(2, "abc", true);
+    bacfile_write_record(-1, "def\n");
+    bacfile_read_record(2, "abcdef\n", true);
+    /* a record past the end of the file is appended */
+    bacfile_write_record(10, "line3\n");
+    bacfile_read_record(3, "line3\n", true);
+    /* many records */
+    bacfile_write_record(0, "record 0\n");
+    for (i = 1; i < 1000; i++) {
+        snprintf(text, sizeof(text), "record %u\n", i);
+        bacfile_write_record(-1, text);
+    }
+    bacfile_read_record(999, "record 999\n", true);
+    bacfile_read_record(500, "record 500\n", false);
+    bacfile_write_record(500, "RECORD 500\n");
+    bacfile_read_record(501, "record 501\n", false);
+    bacfile_read_record(500, "RECORD 500\n", false);
+    bacfile_cleanup();
+    remove("temp_0.txt");
+}
+
+/**
+ * @brief Test reading and writing a stream of octets
+ */
+static void testBACfile_Stream(void)
+{
+    BACNET_ATOMIC_WRITE_FILE_DATA wdata = { 0 };
+    BACNET_ATOMIC_READ_FILE_DATA rdata = { 0 };
+    bool status;
+
+    bacfile_init();
+    wdata.object_type = OBJECT_FILE;
+    wdata.object_instance = 1;
+    wdata.access = FILE_STREAM_ACCESS;
+    wdata.type.stream.fileStartPosition = 0;
+    octetstring_init(&wdata.fileData[0], (uint8_t *)"0123456789", 10);
+    status = bacfile_write_stream_data(&wdata);
+    zassert_true(status, NULL);
+    wdata.type.stream.fileStartPosition = 4;
+    octetstring_init(&wdata.fileData[0], (uint8_t *)"ab", 2);
+    status = bacfile_write_stream_data(&wdata);
+    zassert_true(status, NULL);
+    zassert_equal(bacfile_file_size(1), 10, NULL);
+    rdata.object_type = OBJECT_FILE;
+    rdata.object_instance = 1;
+    rdata.access = FILE_STREAM_ACCESS;
+    rdata.type.stream.fileStartPosition = 2;
+    rdata.type.stream.requestedOctetCount = 5;
+    status = bacfile_read_stream_data(&rdata);
+    zassert_true(status, NULL);
+    zassert_false(rdata.endOfFile, NULL);
+    zassert_equal(octetstring_length(&rdata.fileData[0]), 5, NULL);
+    zassert_mem_equal(octetstring_value(&rdata.fileData[0]), "23ab6", 5,
+        NULL);
+    rdata.type.stream.fileStartPosition = 8;
+    status = bacfile_read_stream_data(&rdata);
+    zassert_true(status, NULL);
+    zassert_true(rdata.endOfFile, NULL);
+    zassert_equal(octetstring_length(&rdata.fileData[0]), 2, NULL);
+    rdata.object_instance = 99;
+    status = bacfile_read_stream_data(&rdata);
+    zassert_false(status, NULL);
+    bacfile_cleanup();
+    remove("temp_1.txt");
+}
+/**
+ * @}
+ */
+
+
+void test_main(void)
+{
+    ztest_test_suite(bacfile_tests,
+     ztest_unit_test(testBACfile_Records),
+     ztest_unit_test(testBACfile_Stream)
+     );
+
+    ztest_run_test_suite(bacfile_tests);
+}
@@ -0,0 +1,360 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test the queue and the timer wheel of intrinsic reporting, and
+ *  the time delays of the Analog Input object
+ */
+
+#include <ztest.h>
+#include <bacnet/bacapp.h>
+#include <bacnet/bacdcode.h>
+#include <bacnet/rp.h>
+#include <bacnet/wp.h>
+#include <bacnet/basic/object/ai.h>
+#include <bacnet/basic/object/device.h>
+#include <bacnet/basic/service/h_alarm_ack.h>
+#include <bacnet/basic/service/h_get_alarm_sum.h>
+#include <bacnet/basic/service/s_cevent.h>
+#include <bacnet/basic/service/s_uevent.h>
+#include <bacnet/basic/service/s_whois.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+/* more objects than the first block of the queue */
+#define TEST_OBJECTS 100
+
+void handler_alarm_ack_set(
+    BACNET_OBJECT_TYPE object_type, alarm_ack_function pFunction)
+{
+    (void)object_type;
+    (void)pFunction;
+}
+
+void handler_get_alarm_summary_set(
+    BACNET_OBJECT_TYPE object_type, get_alarm_summary_function pFunction)
+{
+    (void)object_type;
+    (void)pFunction;
+}
+
+uint8_t Send_CEvent_Notify_Address(uint8_t *pdu,
+    uint16_t pdu_size,
+    BACNET_EVENT_NOTIFICATION_DATA *data,
+    BACNET_ADDRESS *dest)
+{
+    (void)pdu;
+    (void)pdu_size;
+    (void)data;
+    (void)dest;
+
+    return 0;
+}
+
+uint8_t Send_CEvent_Notify_Encoded(uint8_t *pdu,
+    uint16_t pdu_size,
+    uint8_t *service_request,
+    uint16_t service_request_len,
+    BACNET_ADDRESS *dest)
+{
+    (void)pdu;
+    (void)pdu_size;
+    (void)service_request;
+    (void)service_request_len;
+    (void)dest;
+
+    return 0;
+}
+
+int Send_UEvent_Notify(uint8_t *buffer,
+    BACNET_EVENT_NOTIFICATION_DATA *data,
+    BACNET_ADDRESS *dest)
+{
+    (void)buffer;
+    (void)data;
+    (void)dest;
+
+    return 0;
+}
+
+void Send_WhoIs(int32_t low_limit, int32_t high_limit)
+{
+    (void)low_limit;
+    (void)high_limit;
+}
+
+static void write_property(uint32_t instance,
+    BACNET_PROPERTY_ID property,
+    uint8_t *apdu,
+    int apdu_len)
+{
+    BACNET_WRITE_PROPERTY_DATA wp_data = { 0 };
+
+    wp_data.object_type = OBJECT_ANALOG_INPUT;
+    wp_data.object_instance = instance;
+    wp_data.object_property = property;
+    wp_data.array_index = BACNET_ARRAY_ALL;
+    wp_data.priority = BACNET_NO_PRIORITY;
+    memcpy(wp_data.application_data, apdu, apdu_len);
+    wp_data.application_data_len = apdu_len;
+    zassert_true(Analog_Input_Write_Property(&wp_data), NULL);
+}
+
+static void write_real(
+    uint32_t instance, BACNET_PROPERTY_ID property, float value)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len;
+
+    len = encode_application_real(&apdu[0], value);
+    write_property(instance, property, apdu, len);
+}
+
+static void write_unsigned(
+    uint32_t instance, BACNET_PROPERTY_ID property, uint32_t value)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len;
+
+    len = encode_application_unsigned(&apdu[0], value);
+    write_property(instance, property, apdu, len);
+}
+
+static void write_bits(uint32_t instance,
+    BACNET_PROPERTY_ID property,
+    uint8_t bits_used,
+    uint8_t value)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    BACNET_BIT_STRING bit_string;
+    uint8_t bit;
+    int len;
+
+    bitstring_init(&bit_string);
+    for (bit = 0; bit < bits_used; bit++) {
+        bitstring_set_bit(&bit_string, bit, (value & (1 << bit)) != 0);
+    }
+    len = encode_application_bitstring(&apdu[0], &bit_string);
+    write_property(instance, property, apdu, len);
+}
+
+static BACNET_EVENT_STATE event_state(uint32_t instance)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    BACNET_READ_PROPERTY_DATA rpdata = { 0 };
+    BACNET_APPLICATION_DATA_VALUE value = { 0 };
+    int len;
+
+    rpdata.object_type = OBJECT_ANALOG_INPUT;
+    rpdata.object_instance = instance;
+    rpdata.object_property = PROP_EVENT_STATE;
+    rpdata.array_index = BACNET_ARRAY_ALL;
+    rpdata.application_data = &apdu[0];
+    rpdata.application_data_len = sizeof(apdu);
+    len = Analog_Input_Read_Property(&rpdata);
+    zassert_true(len > 0, NULL);
+    len = bacapp_decode_application_data(&apdu[0], len, &value);
+    zassert_true(len > 0, NULL);
+    zassert_equal(value.tag, BACNET_APPLICATION_TAG_ENUMERATED, NULL);
+
+    return (BACNET_EVENT_STATE)value.type.Enumerated;
+}
+
+/**
+ * @brief Set up the Analog Inputs, with a high limit of 50 on the
+ *  first of them, and an empty queue
+ */
+static void test_setup(uint32_t time_delay)
+{
+    Device_Init(NULL);
+    write_real(0, PROP_HIGH_LIMIT, 50.0f);
+    write_real(0, PROP_LOW_LIMIT, 0.0f);
+    write_real(0, PROP_DEADBAND, 5.0f);
+    write_unsigned(0, PROP_TIME_DELAY, time_delay);
+    write_bits(0, PROP_LIMIT_ENABLE, 2, EVENT_HIGH_LIMIT_ENABLE);
+    write_bits(0, PROP_EVENT_ENABLE, 3,
+        EVENT_ENABLE_TO_OFFNORMAL | EVENT_ENABLE_TO_FAULT |
+            EVENT_ENABLE_TO_NORMAL);
+    Analog_Input_Present_Value_Set(0, 25.0f);
+    Device_local_reporting();
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    zassert_equal(event_state(0), EVENT_STATE_NORMAL, NULL);
+}
+
+/**
+ * @brief Test that each object is queued once, and that the queue holds
+ *  every object that asks to be evaluated
+ */
+static void testReportingQueue(void)
+{
+    unsigned i;
+
+    test_setup(0);
+    /* an object that changes often is queued once */
+    for (i = 0; i < 10; i++) {
+        Analog_Input_Present_Value_Set(0, 20.0f + i);
+    }
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    /* and queued again once it has been evaluated */
+    Analog_Input_Present_Value_Set(0, 30.0f);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    /* many objects, each of them changing more than once */
+    for (i = 1; i < TEST_OBJECTS; i++) {
+        zassert_true(Analog_Input_Create(i), NULL);
+    }
+    for (i = 0; i < TEST_OBJECTS; i++) {
+        Analog_Input_Present_Value_Set(i, 1.0f);
+    }
+    for (i = TEST_OBJECTS; i > 0; i--) {
+        Analog_Input_Present_Value_Set(i - 1, 2.0f);
+    }
+    zassert_equal(
+        Device_Intrinsic_Reporting_Queue_Count(), TEST_OBJECTS, NULL);
+    Device_local_reporting();
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    /* a change to the event properties queues the object */
+    write_real(TEST_OBJECTS - 1, PROP_HIGH_LIMIT, 90.0f);
+    write_real(TEST_OBJECTS - 1, PROP_LOW_LIMIT, 10.0f);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    /* a deleted object that is queued is skipped */
+    Analog_Input_Present_Value_Set(TEST_OBJECTS - 1, 3.0f);
+    zassert_true(Analog_Input_Delete(TEST_OBJECTS - 1), NULL);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+}
+
+/**
+ * @brief Test the transitions of an object with a time delay
+ */
+static void testReportingTimeDelay(void)
+{
+    test_setup(5);
+    /* the high limit is exceeded, and the time delay starts */
+    Analog_Input_Present_Value_Set(0, 60.0f);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_NORMAL, NULL);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    Device_local_reporting_timer(4);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    /* a change while the delay runs does not restart it */
+    Analog_Input_Present_Value_Set(0, 61.0f);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_NORMAL, NULL);
+    Device_local_reporting_timer(1);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    /* within the deadband, the object stays in HIGH_LIMIT */
+    Analog_Input_Present_Value_Set(0, 48.0f);
+    Device_local_reporting();
+    Device_local_reporting_timer(10);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    /* below the deadband, the time delay starts again */
+    Analog_Input_Present_Value_Set(0, 40.0f);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    Device_local_reporting_timer(3);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    /* back above it before the delay expires, so the delay stops */
+    Analog_Input_Present_Value_Set(0, 55.0f);
+    Device_local_reporting();
+    Device_local_reporting_timer(2);
+    /* the timer is not cancelled, and finds the conditions not met */
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    /* the delay starts over, and the object returns to NORMAL */
+    Analog_Input_Present_Value_Set(0, 40.0f);
+    Device_local_reporting();
+    Device_local_reporting_timer(4);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    Device_local_reporting_timer(1);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_NORMAL, NULL);
+}
+
+/**
+ * @brief Test time delays longer than a turn of the timer wheel, and
+ *  timers that run more than a turn of the wheel at once
+ */
+static void testReportingWheel(void)
+{
+    unsigned i;
+
+    /* a time delay that is longer than a turn of the wheel */
+    test_setup(100);
+    Analog_Input_Present_Value_Set(0, 60.0f);
+    Device_local_reporting();
+    for (i = 0; i < 99; i++) {
+        Device_local_reporting_timer(1);
+        zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    }
+    Device_local_reporting_timer(1);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    /* more seconds than a turn of the wheel at once */
+    test_setup(10);
+    Analog_Input_Present_Value_Set(0, 60.0f);
+    Device_local_reporting();
+    Device_local_reporting_timer(200);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    /* a timer that is not yet due is kept when the wheel turns at once */
+    test_setup(300);
+    Analog_Input_Present_Value_Set(0, 60.0f);
+    Device_local_reporting();
+    Device_local_reporting_timer(200);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    Device_local_reporting_timer(99);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+    Device_local_reporting_timer(1);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+    Device_local_reporting();
+    zassert_equal(event_state(0), EVENT_STATE_HIGH_LIMIT, NULL);
+    /* timers on many objects */
+    test_setup(0);
+    for (i = 1; i < TEST_OBJECTS; i++) {
+        zassert_true(Analog_Input_Create(i), NULL);
+    }
+    for (i = 0; i < TEST_OBJECTS; i++) {
+        zassert_true(
+            Device_Intrinsic_Reporting_Timer(OBJECT_ANALOG_INPUT, i, 1 + i),
+            NULL);
+    }
+    for (i = 0; i < TEST_OBJECTS; i++) {
+        Device_local_reporting_timer(1);
+        zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 1, NULL);
+        Device_local_reporting();
+    }
+    Device_local_reporting_timer(1);
+    zassert_equal(Device_Intrinsic_Reporting_Queue_Count(), 0, NULL);
+}
+
+/**
+ * @}
+ */
+
+void test_main(void)
+{
+    ztest_test_suite(device_reporting_tests,
+     ztest_unit_test(testReportingQueue),
+     ztest_unit_test(testReportingTimeDelay),
+     ztest_unit_test(testReportingWheel)
+     );
+
+    ztest_run_test_suite(device_reporting_tests);
+}
@@ -0,0 +1,441 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test the active recipients and the notification queue of the
+ *  Notification Class object
+ */
+
+#include <ztest.h>
+#include <bacnet/bacapp.h>
+#include <bacnet/bacdcode.h>
+#include <bacnet/wp.h>
+#include <bacnet/basic/binding/address.h>
+#include <bacnet/basic/object/device.h>
+#include <bacnet/basic/object/nc.h>
+#include <bacnet/basic/service/s_cevent.h>
+#include <bacnet/basic/service/s_uevent.h>
+#include <bacnet/basic/service/s_whois.h>
+#include <bacnet/basic/tsm/tsm.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+#define TEST_NOTIFY_MAX 16
+#define TEST_ALL_DAYS 0x7F
+#define TEST_ALL_TRANSITIONS                                \
+    (TRANSITION_TO_OFFNORMAL_MASKED | TRANSITION_TO_FAULT_MASKED | \
+        TRANSITION_TO_NORMAL_MASKED)
+
+/* a notification that was sent */
+struct test_notify {
+    bool confirmed;
+    uint32_t device_id;
+    uint32_t process_id;
+    BACNET_EVENT_STATE to_state;
+    char text[16];
+};
+static struct test_notify Test_Notify[TEST_NOTIFY_MAX];
+static unsigned Test_Notify_Count;
+static bool Test_TSM_Available;
+static BACNET_DATE_TIME Test_DateTime;
+
+uint8_t Handler_Transmit_Buffer[MAX_PDU];
+
+uint32_t Device_Object_Instance_Number(void)
+{
+    return 1234;
+}
+
+void Device_getCurrentDateTime(BACNET_DATE_TIME *DateTime)
+{
+    *DateTime = Test_DateTime;
+}
+
+bool tsm_transaction_available(void)
+{
+    return Test_TSM_Available;
+}
+
+/* every device is bound, at a MAC address of its instance */
+bool address_get_by_device(
+    uint32_t device_id, unsigned *max_apdu, BACNET_ADDRESS *src)
+{
+    memset(src, 0, sizeof(*src));
+    src->mac[0] = (uint8_t)device_id;
+    src->mac_len = 1;
+    *max_apdu = MAX_APDU;
+
+    return true;
+}
+
+bool address_bind_request(
+    uint32_t device_id, unsigned *max_apdu, BACNET_ADDRESS *src)
+{
+    return address_get_by_device(device_id, max_apdu, src);
+}
+
+void Send_WhoIs(int32_t low_limit, int32_t high_limit)
+{
+    (void)low_limit;
+    (void)high_limit;
+}
+
+static void test_notify_record(
+    bool confirmed, BACNET_EVENT_NOTIFICATION_DATA *data, BACNET_ADDRESS *dest)
+{
+    struct test_notify *notify;
+
+    zassert_true(Test_Notify_Count < TEST_NOTIFY_MAX, NULL);
+    notify = &Test_Notify[Test_Notify_Count++];
+    memset(notify, 0, sizeof(*notify));
+    notify->confirmed = confirmed;
+    notify->device_id = dest->mac[0];
+    notify->process_id = data->processIdentifier;
+    notify->to_state = data->toState;
+    if (data->messageText) {
+        characterstring_ansi_copy(
+            notify->text, sizeof(notify->text), data->messageText);
+    }
+}
+
+uint8_t Send_CEvent_Notify_Address(uint8_t *pdu,
+    uint16_t pdu_size,
+    BACNET_EVENT_NOTIFICATION_DATA *data,
+    BACNET_ADDRESS *dest)
+{
+    (void)pdu;
+    (void)pdu_size;
+    test_notify_record(true, data, dest);
+
+    return 1;
+}
+
+/* a queued notification, sent as it was encoded */
+uint8_t Send_CEvent_Notify_Encoded(uint8_t *pdu,
+    uint16_t pdu_size,
+    uint8_t *service_request,
+    uint16_t service_request_len,
+    BACNET_ADDRESS *dest)
+{
+    BACNET_EVENT_NOTIFICATION_DATA data = { 0 };
+    BACNET_CHARACTER_STRING message_text = { 0 };
+    int len;
+
+    (void)pdu;
+    (void)pdu_size;
+    data.messageText = &message_text;
+    len = event_notify_decode_service_request(
+        service_request, service_request_len, &data);
+    zassert_equal(len, service_request_len, NULL);
+    test_notify_record(true, &data, dest);
+
+    return 1;
+}
+
+int Send_UEvent_Notify(uint8_t *buffer,
+    BACNET_EVENT_NOTIFICATION_DATA *data,
+    BACNET_ADDRESS *dest)
+{
+    (void)buffer;
+    test_notify_record(false, data, dest);
+
+    return 1;
+}
+
+static void test_time_set(
+    uint8_t wday, uint8_t hour, uint8_t min, uint8_t sec, uint8_t hundredths)
+{
+    Test_DateTime.date.wday = wday;
+    datetime_set_time(&Test_DateTime.time, hour, min, sec, hundredths);
+}
+
+/**
+ * @brief Encode one BACnetDestination of a Recipient_List
+ * @return number of bytes encoded
+ */
+static int test_destination_encode(uint8_t *apdu,
+    uint8_t valid_days,
+    uint8_t from_hour,
+    uint8_t to_hour,
+    uint32_t device_id,
+    uint32_t process_id,
+    bool confirmed,
+    uint8_t transitions)
+{
+    BACNET_BIT_STRING bit_string;
+    BACNET_TIME btime;
+    int len = 0;
+    unsigned i;
+
+    bitstring_init(&bit_string);
+    for (i = 0; i < MAX_BACNET_DAYS_OF_WEEK; i++) {
+        bitstring_set_bit(&bit_string, i, (valid_days & (1 << i)) != 0);
+    }
+    len += encode_application_bitstring(&apdu[len], &bit_string);
+    datetime_set_time(&btime, from_hour, 0, 0, 0);
+    len += encode_application_time(&apdu[len], &btime);
+    datetime_set_time(&btime, to_hour, 0, 0, 0);
+    len += encode_application_time(&apdu[len], &btime);
+    len += encode_context_object_id(&apdu[len], 0, OBJECT_DEVICE, device_id);
+    len += encode_application_unsigned(&apdu[len], process_id);
+    len += encode_application_boolean(&apdu[len], confirmed);
+    bitstring_init(&bit_string);
+    for (i = 0; i < MAX_BACNET_EVENT_TRANSITION; i++) {
+        bitstring_set_bit(&bit_string, i, (transitions & (1 << i)) != 0);
+    }
+    len += encode_application_bitstring(&apdu[len], &bit_string);
+
+    return len;
+}
+
+static void test_recipient_list_write(uint8_t *apdu, int apdu_len)
+{
+    BACNET_WRITE_PROPERTY_DATA wp_data = { 0 };
+
+    wp_data.object_type = OBJECT_NOTIFICATION_CLASS;
+    wp_data.object_instance = 0;
+    wp_data.object_property = PROP_RECIPIENT_LIST;
+    wp_data.array_index = BACNET_ARRAY_ALL;
+    wp_data.priority = BACNET_NO_PRIORITY;
+    memcpy(wp_data.application_data, apdu, apdu_len);
+    wp_data.application_data_len = apdu_len;
+    zassert_true(Notification_Class_Write_Property(&wp_data), NULL);
+}
+
+/**
+ * @brief Report an event of class 0, and get the number of
+ *  notifications that were sent for it
+ */
+static unsigned test_event(BACNET_EVENT_STATE to_state, const char *text)
+{
+    BACNET_EVENT_NOTIFICATION_DATA event_data = { 0 };
+    BACNET_CHARACTER_STRING message_text;
+    unsigned count = Test_Notify_Count;
+
+    event_data.notificationClass = 0;
+    event_data.eventType = EVENT_OUT_OF_RANGE;
+    event_data.fromState = EVENT_STATE_NORMAL;
+    event_data.toState = to_state;
+    if (text) {
+        characterstring_init_ansi(&message_text, text);
+        event_data.messageText = &message_text;
+    }
+    Notification_Class_common_reporting_function(&event_data);
+
+    return Test_Notify_Count - count;
+}
+
+static void test_setup(void)
+{
+    Notification_Class_Init();
+    memset(&Test_DateTime, 0, sizeof(Test_DateTime));
+    memset(Test_Notify, 0, sizeof(Test_Notify));
+    Test_Notify_Count = 0;
+    Test_TSM_Available = true;
+}
+
+static void testRecipientWindow(void)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    test_setup();
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 8, 17, 1, 1,
+        false, TEST_ALL_TRANSITIONS);
+    len += test_destination_encode(
+        &apdu[len], 0x01, 13, 17, 2, 2, false, TEST_ALL_TRANSITIONS);
+    test_recipient_list_write(apdu, len);
+
+    /* the FromTime is included */
+    test_time_set(1, 7, 59, 59, 99);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 0, NULL);
+    test_time_set(1, 8, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 1, NULL);
+    zassert_equal(Test_Notify[0].device_id, 1, NULL);
+    /* compiled again at the FromTime of the next destination */
+    test_time_set(1, 12, 59, 59, 99);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 1, NULL);
+    test_time_set(1, 13, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 2, NULL);
+    /* the ToTime is included too */
+    test_time_set(1, 17, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 2, NULL);
+    test_time_set(1, 17, 0, 0, 1);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 0, NULL);
+    /* compiled again on another day, where only the first is valid */
+    test_time_set(1, 14, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 2, NULL);
+    test_time_set(2, 14, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 1, NULL);
+    zassert_equal(Test_Notify[Test_Notify_Count - 1].device_id, 1, NULL);
+    test_time_set(7, 14, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 1, NULL);
+    test_time_set(1, 14, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 2, NULL);
+    /* compiled again after the recipient list is written */
+    len = test_destination_encode(&apdu[0], TEST_ALL_DAYS, 15, 16, 1, 1,
+        false, TEST_ALL_TRANSITIONS);
+    test_recipient_list_write(apdu, len);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 0, NULL);
+}
+
+static void testRecipientMerge(void)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    test_setup();
+    test_time_set(1, 12, 0, 0, 0);
+    /* the same recipient, merged with the transitions of each */
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 1, 1,
+        false, TRANSITION_TO_OFFNORMAL_MASKED);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 8, 17, 1, 1,
+        false, TRANSITION_TO_NORMAL_MASKED);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 10, 14, 1, 1,
+        false, TRANSITION_TO_OFFNORMAL_MASKED);
+    test_recipient_list_write(apdu, len);
+    zassert_equal(test_event(EVENT_STATE_HIGH_LIMIT, NULL), 1, NULL);
+    zassert_equal(test_event(EVENT_STATE_NORMAL, NULL), 1, NULL);
+    zassert_equal(test_event(EVENT_STATE_FAULT, NULL), 0, NULL);
+    /* outside the window of the second, only its own transitions go */
+    test_time_set(1, 18, 0, 0, 0);
+    zassert_equal(test_event(EVENT_STATE_NORMAL, NULL), 0, NULL);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 1, NULL);
+
+    /* another process or another service is another recipient */
+    test_setup();
+    test_time_set(1, 12, 0, 0, 0);
+    len = 0;
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 1, 1,
+        false, TEST_ALL_TRANSITIONS);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 1, 2,
+        false, TEST_ALL_TRANSITIONS);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 1, 1,
+        true, TEST_ALL_TRANSITIONS);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 2, 1,
+        false, TEST_ALL_TRANSITIONS);
+    test_recipient_list_write(apdu, len);
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, NULL), 4, NULL);
+    zassert_false(Test_Notify[0].confirmed, NULL);
+    zassert_equal(Test_Notify[0].device_id, 1, NULL);
+    zassert_equal(Test_Notify[0].process_id, 1, NULL);
+    zassert_false(Test_Notify[1].confirmed, NULL);
+    zassert_equal(Test_Notify[1].device_id, 1, NULL);
+    zassert_equal(Test_Notify[1].process_id, 2, NULL);
+    zassert_true(Test_Notify[2].confirmed, NULL);
+    zassert_equal(Test_Notify[2].device_id, 1, NULL);
+    zassert_equal(Test_Notify[2].process_id, 1, NULL);
+    zassert_false(Test_Notify[3].confirmed, NULL);
+    zassert_equal(Test_Notify[3].device_id, 2, NULL);
+    zassert_equal(Test_Notify[3].process_id, 1, NULL);
+}
+
+static void testNotifyQueue(void)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+    unsigned i;
+
+    test_setup();
+    test_time_set(1, 12, 0, 0, 0);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 1, 1,
+        true, TEST_ALL_TRANSITIONS);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 2, 2,
+        true, TEST_ALL_TRANSITIONS);
+    test_recipient_list_write(apdu, len);
+    /* queued while the TSM is busy */
+    Test_TSM_Available = false;
+    zassert_equal(test_event(EVENT_STATE_OFFNORMAL, "offnormal"), 0, NULL);
+    zassert_equal(Notification_Class_Notify_Queue_Count(), 2, NULL);
+    Notification_Class_notify_task();
+    zassert_equal(Test_Notify_Count, 0, NULL);
+    /* queued behind the others while any wait */
+    Test_TSM_Available = true;
+    zassert_equal(test_event(EVENT_STATE_NORMAL, "normal"), 0, NULL);
+    zassert_equal(Notification_Class_Notify_Queue_Count(), 4, NULL);
+    /* sent in order */
+    Notification_Class_notify_task();
+    zassert_equal(Notification_Class_Notify_Queue_Count(), 0, NULL);
+    zassert_equal(Test_Notify_Count, 4, NULL);
+    for (i = 0; i < 4; i++) {
+        zassert_true(Test_Notify[i].confirmed, NULL);
+        zassert_equal(Test_Notify[i].device_id, 1 + (i % 2), NULL);
+        zassert_equal(Test_Notify[i].process_id, 1 + (i % 2), NULL);
+    }
+    zassert_equal(Test_Notify[0].to_state, EVENT_STATE_OFFNORMAL, NULL);
+    zassert_equal(strcmp(Test_Notify[0].text, "offnormal"), 0, NULL);
+    zassert_equal(Test_Notify[1].to_state, EVENT_STATE_OFFNORMAL, NULL);
+    zassert_equal(strcmp(Test_Notify[1].text, "offnormal"), 0, NULL);
+    zassert_equal(Test_Notify[2].to_state, EVENT_STATE_NORMAL, NULL);
+    zassert_equal(strcmp(Test_Notify[2].text, "normal"), 0, NULL);
+    zassert_equal(Test_Notify[3].to_state, EVENT_STATE_NORMAL, NULL);
+    zassert_equal(strcmp(Test_Notify[3].text, "normal"), 0, NULL);
+    /* sent at once when none wait */
+    zassert_equal(test_event(EVENT_STATE_FAULT, NULL), 2, NULL);
+    zassert_equal(Test_Notify_Count, 6, NULL);
+    zassert_equal(Notification_Class_Notify_Dropped(), 0, NULL);
+}
+
+static void testNotifyQueueFull(void)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+    unsigned i;
+
+    test_setup();
+    test_time_set(1, 12, 0, 0, 0);
+    len += test_destination_encode(&apdu[len], TEST_ALL_DAYS, 0, 23, 1, 1,
+        true, TEST_ALL_TRANSITIONS);
+    test_recipient_list_write(apdu, len);
+    Test_TSM_Available = false;
+    for (i = 0; i < NC_NOTIFY_QUEUE_SIZE; i++) {
+        test_event(EVENT_STATE_OFFNORMAL, NULL);
+    }
+    zassert_equal(Notification_Class_Notify_Queue_Count(),
+        NC_NOTIFY_QUEUE_SIZE, NULL);
+    zassert_equal(Notification_Class_Notify_Dropped(), 0, NULL);
+    /* the queue is full: the next ones are dropped, and counted */
+    test_event(EVENT_STATE_NORMAL, NULL);
+    test_event(EVENT_STATE_NORMAL, NULL);
+    zassert_equal(Notification_Class_Notify_Queue_Count(),
+        NC_NOTIFY_QUEUE_SIZE, NULL);
+    zassert_equal(Notification_Class_Notify_Dropped(), 2, NULL);
+    Test_TSM_Available = true;
+    Notification_Class_notify_task();
+    zassert_equal(Test_Notify_Count, NC_NOTIFY_QUEUE_SIZE, NULL);
+    for (i = 0; i < Test_Notify_Count; i++) {
+        zassert_equal(Test_Notify[i].to_state, EVENT_STATE_OFFNORMAL, NULL);
+    }
+    /* the queue wraps around */
+    Test_TSM_Available = false;
+    test_event(EVENT_STATE_FAULT, NULL);
+    test_event(EVENT_STATE_NORMAL, NULL);
+    Test_TSM_Available = true;
+    Notification_Class_notify_task();
+    zassert_equal(Test_Notify_Count, NC_NOTIFY_QUEUE_SIZE + 2, NULL);
+    zassert_equal(Test_Notify[NC_NOTIFY_QUEUE_SIZE].to_state,
+        EVENT_STATE_FAULT, NULL);
+    zassert_equal(Test_Notify[NC_NOTIFY_QUEUE_SIZE + 1].to_state,
+        EVENT_STATE_NORMAL, NULL);
+    zassert_equal(Notification_Class_Notify_Dropped(), 2, NULL);
+}
+
+/**
+ * @}
+ */
+
+void test_main(void)
+{
+    ztest_test_suite(nc_tests,
+     ztest_unit_test(testRecipientWindow),
+     ztest_unit_test(testRecipientMerge),
+     ztest_unit_test(testNotifyQueue),
+     ztest_unit_test(testNotifyQueueFull)
+     );
+
+    ztest_run_test_suite(nc_tests);
+}
@@ -0,0 +1,467 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test BACnet Trend Log object storage APIs
+ */
+
+#include <stdio.h>
+#include <ztest.h>
+#include <bacnet/bacdcode.h>
+#include <bacnet/bacreal.h>
+#include <bacnet/datetime.h>
+#include <bacnet/readrange.h>
+#include <bacnet/wp.h>
+#include <bacnet/basic/object/ai.h>
+#include <bacnet/basic/object/device.h>
+#include <bacnet/basic/object/trendlog.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+static uint32_t read_unsigned_property(
+    uint32_t instance, BACNET_PROPERTY_ID property)
+{
+    BACNET_READ_PROPERTY_DATA rpdata = { 0 };
+    BACNET_APPLICATION_DATA_VALUE value = { 0 };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    rpdata.application_data = &apdu[0];
+    rpdata.application_data_len = sizeof(apdu);
+    rpdata.object_type = OBJECT_TRENDLOG;
+    rpdata.object_instance = instance;
+    rpdata.object_property = property;
+    rpdata.array_index = BACNET_ARRAY_ALL;
+    len = Trend_Log_Read_Property(&rpdata);
+    zassert_true(len > 0, NULL);
+    len = bacapp_decode_application_data(&apdu[0], len, &value);
+    zassert_true(len > 0, NULL);
+    zassert_equal(value.tag, BACNET_APPLICATION_TAG_UNSIGNED_INT, NULL);
+
+    return value.type.Unsigned_Int;
+}
+
+/**
+ * @brief Test the buffers in memory, of the default and other sizes
+ */
+static void testTrendLogBufferSize(void)
+{
+    uint8_t first[MAX_APDU] = { 0 };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int first_len = 0;
+    int len = 0;
+    int i = 0;
+
+    Device_Init(NULL);
+    zassert_equal(Trend_Log_Buffer_Size(0), TL_MAX_ENTRIES, NULL);
+    zassert_equal(
+        read_unsigned_property(0, PROP_BUFFER_SIZE), TL_MAX_ENTRIES, NULL);
+    zassert_equal(Trend_Log_Buffer_Size(Trend_Log_Count()), 0, NULL);
+    zassert_false(Trend_Log_Buffer_Size_Set(Trend_Log_Count(), 10), NULL);
+
+    zassert_true(Trend_Log_Buffer_Size_Set(0, 10), NULL);
+    zassert_equal(Trend_Log_Buffer_Size(0), 10, NULL);
+    zassert_equal(read_unsigned_property(0, PROP_BUFFER_SIZE), 10, NULL);
+    zassert_equal(read_unsigned_property(0, PROP_RECORD_COUNT), 0, NULL);
+    for (i = 0; i < 15; i++) {
+        TL_Insert_Status_Rec(0, LOG_STATUS_LOG_DISABLED, (i & 1));
+    }
+    zassert_equal(read_unsigned_property(0, PROP_RECORD_COUNT), 10, NULL);
+    /* the oldest record left is the 6th one inserted */
+    first_len = TL_encode_entry(&first[0], 0, 1);
+    zassert_true(first_len > 0, NULL);
+    TL_Insert_Status_Rec(0, LOG_STATUS_LOG_DISABLED, true);
+    len = TL_encode_entry(&apdu[0], 0, 10);
+    zassert_equal(len, first_len, NULL);
+    zassert_equal(memcmp(apdu, first, len), 0, NULL);
+
+    zassert_true(Trend_Log_Buffer_Size_Set(0, 0), NULL);
+    zassert_equal(Trend_Log_Buffer_Size(0), TL_MAX_ENTRIES, NULL);
+    zassert_equal(read_unsigned_property(0, PROP_RECORD_COUNT), 0, NULL);
+    Trend_Log_Storage_Cleanup();
+}
+
+static int read_range(BACNET_READ_RANGE_DATA *pRequest,
+    uint8_t *apdu,
+    uint32_t instance,
+    int request_type,
+    int32_t count,
+    int space)
+{
+    pRequest->object_type = OBJECT_TRENDLOG;
+    pRequest->object_instance = instance;
+    pRequest->object_property = PROP_LOG_BUFFER;
+    pRequest->array_index = BACNET_ARRAY_ALL;
+    pRequest->RequestType = request_type;
+    pRequest->Overhead = MAX_APDU - space;
+    pRequest->Count = count;
+
+    return rr_trend_log_encode(apdu, pRequest);
+}
+
+static void entry_time(uint32_t instance, int entry, BACNET_DATE_TIME *btime)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    len = TL_encode_entry(&apdu[0], instance, entry);
+    zassert_true(len > 0, NULL);
+    len = bacapp_decode_context_datetime(&apdu[0], 0, btime);
+    zassert_true(len > 0, NULL);
+}
+
+static void check_first_entry(uint32_t instance, uint8_t *apdu, int entry)
+{
+    uint8_t expected[MAX_APDU] = { 0 };
+    int len = 0;
+
+    len = TL_encode_entry(&expected[0], instance, entry);
+    zassert_true(len > 0, NULL);
+    zassert_equal(memcmp(apdu, expected, len), 0, NULL);
+}
+
+/**
+ * @brief Test ReadRange by position, sequence and time of the demo log,
+ *  which has 1000 records 15 minutes apart, numbered 9001 to 10000
+ */
+static void testTrendLogReadRange(void)
+{
+    BACNET_READ_RANGE_DATA request = { 0 };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    Device_Init(NULL);
+    /* records of log 2 have status flags, so each is 22 bytes */
+    request.Range.RefIndex = 1;
+    len = read_range(&request, apdu, 2, RR_BY_POSITION, 1000, 110);
+    zassert_equal(len, 110, NULL);
+    zassert_equal(request.ItemCount, 5, NULL);
+    zassert_true(
+        bitstring_bit(&request.ResultFlags, RESULT_FLAG_FIRST_ITEM), NULL);
+    zassert_true(
+        bitstring_bit(&request.ResultFlags, RESULT_FLAG_MORE_ITEMS), NULL);
+    zassert_false(
+        bitstring_bit(&request.ResultFlags, RESULT_FLAG_LAST_ITEM), NULL);
+    len = read_range(&request, apdu, 2, RR_BY_POSITION, 1000, 109);
+    zassert_equal(len, 88, NULL);
+    zassert_equal(request.ItemCount, 4, NULL);
+
+    request.Range.RefIndex = 998;
+    len = read_range(&request, apdu, 2, RR_BY_POSITION, 10, MAX_APDU / 2);
+    zassert_equal(request.ItemCount, 3, NULL);
+    zassert_true(
+        bitstring_bit(&request.ResultFlags, RESULT_FLAG_LAST_ITEM), NULL);
+    check_first_entry(2, apdu, 998);
+
+    request.Range.RefSeqNum = 9500;
+    len = read_range(&request, apdu, 2, RR_BY_SEQUENCE, 3, MAX_APDU / 2);
+    zassert_equal(request.ItemCount, 3, NULL);
+    zassert_equal(request.FirstSequence, 9500, NULL);
+    check_first_entry(2, apdu, 500);
+
+    entry_time(2, 100, &request.Range.RefTime);
+    len = read_range(&request, apdu, 2, RR_BY_TIME, 5, MAX_APDU / 2);
+    zassert_equal(len, 5 * 22, NULL);
+    zassert_equal(request.ItemCount, 5, NULL);
+    zassert_equal(request.FirstSequence, 9101, NULL);
+    check_first_entry(2, apdu, 101);
+    entry_time(2, 100, &request.Range.RefTime);
+    len = read_range(&request, apdu, 2, RR_BY_TIME, -5, MAX_APDU / 2);
+    zassert_equal(request.ItemCount, 5, NULL);
+    zassert_equal(request.FirstSequence, 9095, NULL);
+    check_first_entry(2, apdu, 95);
+    entry_time(2, 3, &request.Range.RefTime);
+    len = read_range(&request, apdu, 2, RR_BY_TIME, -2000, MAX_APDU / 2);
+    zassert_equal(request.ItemCount, 2, NULL);
+    zassert_equal(request.FirstSequence, 9001, NULL);
+    zassert_true(
+        bitstring_bit(&request.ResultFlags, RESULT_FLAG_FIRST_ITEM), NULL);
+    entry_time(2, 1, &request.Range.RefTime);
+    len = read_range(&request, apdu, 2, RR_BY_TIME, -5, MAX_APDU / 2);
+    zassert_equal(len, 0, NULL);
+    zassert_equal(request.ItemCount, 0, NULL);
+    entry_time(2, 1000, &request.Range.RefTime);
+    len = read_range(&request, apdu, 2, RR_BY_TIME, 5, MAX_APDU / 2);
+    zassert_equal(len, 0, NULL);
+    zassert_equal(request.ItemCount, 0, NULL);
+}
+
+static bool write_property(uint32_t instance,
+    BACNET_PROPERTY_ID property,
+    uint8_t *apdu,
+    int apdu_len)
+{
+    BACNET_WRITE_PROPERTY_DATA wpdata = { 0 };
+
+    wpdata.object_type = OBJECT_TRENDLOG;
+    wpdata.object_instance = instance;
+    wpdata.object_property = property;
+    wpdata.array_index = BACNET_ARRAY_ALL;
+    memcpy(&wpdata.application_data[0], apdu, apdu_len);
+    wpdata.application_data_len = apdu_len;
+    wpdata.priority = BACNET_NO_PRIORITY;
+
+    return Trend_Log_Write_Property(&wpdata);
+}
+
+/**
+ * @brief Test that a COV log takes a reading when its object changes,
+ *  and only then
+ */
+static void testTrendLogCOV(void)
+{
+    BACNET_DATE_TIME btime = { 0 };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    uint32_t total = 0;
+    float real_value = 0.0f;
+    int len = 0;
+
+    Device_Init(NULL);
+    zassert_true(Analog_Input_Valid_Instance(3), NULL);
+    /* log all the time */
+    datetime_wildcard_set(&btime);
+    len = encode_application_date(&apdu[0], &btime.date);
+    len += encode_application_time(&apdu[len], &btime.time);
+    zassert_true(write_property(3, PROP_START_TIME, apdu, len), NULL);
+    zassert_true(write_property(3, PROP_STOP_TIME, apdu, len), NULL);
+    /* no interval is logging on COV */
+    len = encode_application_unsigned(&apdu[0], 0);
+    zassert_true(write_property(3, PROP_LOG_INTERVAL, apdu, len), NULL);
+    len = encode_application_unsigned(&apdu[0], 0);
+    zassert_true(write_property(3, PROP_RECORD_COUNT, apdu, len), NULL);
+    total = read_unsigned_property(3, PROP_TOTAL_RECORD_COUNT);
+    trend_log_timer(1);
+    zassert_equal(
+        read_unsigned_property(3, PROP_TOTAL_RECORD_COUNT), total, NULL);
+
+    /* the reading is of the new value, at the next tick */
+    Analog_Input_Present_Value_Set(3, 10.0f);
+    zassert_equal(
+        read_unsigned_property(3, PROP_TOTAL_RECORD_COUNT), total, NULL);
+    trend_log_timer(1);
+    zassert_equal(
+        read_unsigned_property(3, PROP_TOTAL_RECORD_COUNT), total + 1, NULL);
+    len = TL_encode_entry(&apdu[0], 3, read_unsigned_property(3,
+        PROP_RECORD_COUNT));
+    zassert_true(len > 0, NULL);
+    /* skip the timestamp and the opening tag of the value */
+    len = bacapp_decode_context_datetime(&apdu[0], 0, &btime);
+    zassert_true(len > 0, NULL);
+    len = decode_context_real(&apdu[len + 1], TL_TYPE_REAL, &real_value);
+    zassert_true(len > 0, NULL);
+    zassert_equal(real_value, 10.0f, NULL);
+    trend_log_timer(1);
+    Analog_Input_Present_Value_Set(3, 10.5f);
+    trend_log_timer(1);
+    zassert_equal(
+        read_unsigned_property(3, PROP_TOTAL_RECORD_COUNT), total + 1, NULL);
+
+    /* an interval goes back to polling */
+    len = encode_application_unsigned(&apdu[0], 6000);
+    zassert_true(write_property(3, PROP_LOG_INTERVAL, apdu, len), NULL);
+    Analog_Input_Present_Value_Set(3, 20.0f);
+    trend_log_timer(1);
+    zassert_equal(
+        read_unsigned_property(3, PROP_TOTAL_RECORD_COUNT), total + 1, NULL);
+}
+
+/* the clock of the trend logs in the tests */
+static time_t Test_Time;
+
+static time_t test_clock(void)
+{
+    return Test_Time;
+}
+
+static void write_unsigned(
+    uint32_t instance, BACNET_PROPERTY_ID property, uint32_t value)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    len = encode_application_unsigned(&apdu[0], value);
+    zassert_true(write_property(instance, property, apdu, len), NULL);
+}
+
+static void write_boolean(
+    uint32_t instance, BACNET_PROPERTY_ID property, bool value)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int len = 0;
+
+    len = encode_application_boolean(&apdu[0], value);
+    zassert_true(write_property(instance, property, apdu, len), NULL);
+}
+
+/**
+ * @brief Run the trend logs at a time, and count the readings of a log
+ */
+static uint32_t timer_at(time_t tNow, uint32_t instance)
+{
+    Test_Time = tNow;
+    trend_log_timer(1);
+
+    return read_unsigned_property(instance, PROP_TOTAL_RECORD_COUNT);
+}
+
+/**
+ * @brief Test that polled logs take their readings when they are due,
+ *  each at its own interval, with and without aligning to the clock
+ */
+static void testTrendLogSchedule(void)
+{
+    /* a multiple of a minute */
+    const time_t tStart = 1700000040;
+    BACNET_DATE_TIME btime = { 0 };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    uint32_t total4 = 0;
+    uint32_t total5 = 0;
+    uint32_t instance = 0;
+    int len = 0;
+
+    Device_Init(NULL);
+    Test_Time = tStart;
+    Trend_Log_Clock_Set(test_clock);
+    datetime_wildcard_set(&btime);
+    len = encode_application_date(&apdu[0], &btime.date);
+    len += encode_application_time(&apdu[len], &btime.time);
+    for (instance = 4; instance <= 5; instance++) {
+        zassert_true(write_property(instance, PROP_START_TIME, apdu, len),
+            NULL);
+        zassert_true(write_property(instance, PROP_STOP_TIME, apdu, len),
+            NULL);
+        write_boolean(instance, PROP_ALIGN_INTERVALS, false);
+        write_unsigned(instance, PROP_RECORD_COUNT, 0);
+    }
+    write_unsigned(4, PROP_LOG_INTERVAL, 6000);
+    write_unsigned(5, PROP_LOG_INTERVAL, 9000);
+    total4 = read_unsigned_property(4, PROP_TOTAL_RECORD_COUNT);
+    total5 = read_unsigned_property(5, PROP_TOTAL_RECORD_COUNT);
+
+    /* the last readings were long ago, so both are due at once */
+    zassert_equal(timer_at(tStart, 4), total4 + 1, NULL);
+    zassert_equal(read_unsigned_property(5, PROP_TOTAL_RECORD_COUNT),
+        total5 + 1, NULL);
+    zassert_equal(timer_at(tStart, 4), total4 + 1, NULL);
+    /* and then each at its own interval from its last reading */
+    zassert_equal(timer_at(tStart + 59, 4), total4 + 1, NULL);
+    zassert_equal(timer_at(tStart + 60, 4), total4 + 2, NULL);
+    zassert_equal(read_unsigned_property(5, PROP_TOTAL_RECORD_COUNT),
+        total5 + 1, NULL);
+    zassert_equal(timer_at(tStart + 90, 5), total5 + 2, NULL);
+    zassert_equal(read_unsigned_property(4, PROP_TOTAL_RECORD_COUNT),
+        total4 + 2, NULL);
+    zassert_equal(timer_at(tStart + 120, 4), total4 + 3, NULL);
+    /* a late tick takes one reading of each log that is due */
+    zassert_equal(timer_at(tStart + 200, 4), total4 + 4, NULL);
+    zassert_equal(read_unsigned_property(5, PROP_TOTAL_RECORD_COUNT),
+        total5 + 3, NULL);
+
+    /* aligned to the clock, at 10 seconds past each minute */
+    write_boolean(4, PROP_ALIGN_INTERVALS, true);
+    write_unsigned(4, PROP_INTERVAL_OFFSET, 1000);
+    zassert_equal(timer_at(tStart + 249, 4), total4 + 4, NULL);
+    zassert_equal(timer_at(tStart + 250, 4), total4 + 5, NULL);
+    zassert_equal(timer_at(tStart + 250, 4), total4 + 5, NULL);
+    zassert_equal(timer_at(tStart + 309, 4), total4 + 5, NULL);
+    zassert_equal(timer_at(tStart + 310, 4), total4 + 6, NULL);
+    /* the other log keeps its own interval, from the late reading */
+    zassert_equal(read_unsigned_property(5, PROP_TOTAL_RECORD_COUNT),
+        total5 + 4, NULL);
+    zassert_equal(timer_at(tStart + 398, 5), total5 + 4, NULL);
+    zassert_equal(timer_at(tStart + 399, 5), total5 + 5, NULL);
+
+    /* a disabled log leaves the schedule */
+    write_boolean(4, PROP_ENABLE, false);
+    total4 = read_unsigned_property(4, PROP_TOTAL_RECORD_COUNT);
+    zassert_equal(timer_at(tStart + 430, 4), total4, NULL);
+    zassert_equal(timer_at(tStart + 490, 4), total4, NULL);
+    zassert_equal(read_unsigned_property(5, PROP_TOTAL_RECORD_COUNT),
+        total5 + 6, NULL);
+    write_boolean(4, PROP_ENABLE, true);
+    write_boolean(5, PROP_ENABLE, false);
+    Trend_Log_Clock_Set(NULL);
+}
+
+#if TREND_LOG_MMAP
+/**
+ * @brief Test that the records in a ring file survive closing it
+ */
+static void testTrendLogStorageFile(void)
+{
+    const char *pathname = "test_trendlog.tlog";
+    uint8_t entries[3][MAX_APDU] = { { 0 } };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    int entry_len[3] = { 0 };
+    uint32_t total = 0;
+    int len = 0;
+    int i = 0;
+
+    Device_Init(NULL);
+    remove(pathname);
+    zassert_false(Trend_Log_Storage_File_Set(1, pathname, 0), NULL);
+    zassert_false(Trend_Log_Storage_File_Set(1, NULL, 8), NULL);
+    zassert_true(Trend_Log_Storage_File_Set(1, pathname, 8), NULL);
+    zassert_equal(Trend_Log_Buffer_Size(1), 8, NULL);
+    zassert_equal(read_unsigned_property(1, PROP_RECORD_COUNT), 0, NULL);
+    for (i = 0; i < 11; i++) {
+        TL_Insert_Status_Rec(1, LOG_STATUS_LOG_DISABLED, (i % 3) == 0);
+    }
+    zassert_equal(read_unsigned_property(1, PROP_RECORD_COUNT), 8, NULL);
+    total = read_unsigned_property(1, PROP_TOTAL_RECORD_COUNT);
+    for (i = 0; i < 3; i++) {
+        entry_len[i] = TL_encode_entry(&entries[i][0], 1, 6 + i);
+        zassert_true(entry_len[i] > 0, NULL);
+    }
+    Trend_Log_Storage_Cleanup();
+    zassert_equal(Trend_Log_Buffer_Size(1), TL_MAX_ENTRIES, NULL);
+    zassert_equal(read_unsigned_property(1, PROP_RECORD_COUNT), 0, NULL);
+
+    /* the same size carries on from where the log was */
+    zassert_true(Trend_Log_Storage_File_Set(1, pathname, 8), NULL);
+    zassert_equal(read_unsigned_property(1, PROP_RECORD_COUNT), 8, NULL);
+    zassert_equal(
+        read_unsigned_property(1, PROP_TOTAL_RECORD_COUNT), total, NULL);
+    for (i = 0; i < 3; i++) {
+        len = TL_encode_entry(&apdu[0], 1, 6 + i);
+        zassert_equal(len, entry_len[i], NULL);
+        zassert_equal(memcmp(apdu, entries[i], len), 0, NULL);
+    }
+    TL_Insert_Status_Rec(1, LOG_STATUS_BUFFER_PURGED, true);
+    zassert_equal(
+        read_unsigned_property(1, PROP_TOTAL_RECORD_COUNT), total + 1, NULL);
+    len = TL_encode_entry(&apdu[0], 1, 5);
+    zassert_equal(len, entry_len[0], NULL);
+    zassert_equal(memcmp(apdu, entries[0], len), 0, NULL);
+
+    /* another size starts out empty */
+    zassert_true(Trend_Log_Storage_File_Set(1, pathname, 16), NULL);
+    zassert_equal(Trend_Log_Buffer_Size(1), 16, NULL);
+    zassert_equal(read_unsigned_property(1, PROP_RECORD_COUNT), 0, NULL);
+    Trend_Log_Storage_Cleanup();
+    remove(pathname);
+}
+#endif
+/**
+ * @}
+ */
+
+
+void test_main(void)
+{
+    ztest_test_suite(trendlog_tests,
+     ztest_unit_test(testTrendLogBufferSize),
+     ztest_unit_test(testTrendLogReadRange),
+     ztest_unit_test(testTrendLogCOV),
+     ztest_unit_test(testTrendLogSchedule)
+#if TREND_LOG_MMAP
+     , ztest_unit_test(testTrendLogStorageFile)
+#endif
+     );
+
+    ztest_run_test_suite(trendlog_tests);
+}
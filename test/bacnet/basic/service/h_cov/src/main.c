@@ -0,0 +1,510 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test the COV subscription handler and COV task
+ */
+
+#include <string.h>
+#include <ztest.h>
+#include <bacnet/bacdcode.h>
+#include <bacnet/cov.h>
+#include <bacnet/npdu.h>
+#include <bacnet/basic/object/device.h>
+#include <bacnet/basic/service/h_apdu.h>
+#include <bacnet/basic/service/h_cov.h>
+#include <bacnet/basic/tsm/tsm.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+/* the default limits of h_cov.c */
+#define TEST_COV_SUBSCRIPTIONS 1024
+#define TEST_COV_ADDRESSES 256
+#define TEST_COV_BLOCK_SIZE 32
+/* more objects than the changed object queue holds */
+#define TEST_COV_OBJECTS 40
+
+/* the objects that have changed, as seen by Device_COV() */
+static BACNET_OBJECT_ID Changed_Objects[TEST_COV_OBJECTS * 2];
+static unsigned Changed_Count;
+static unsigned COV_Clear_Count;
+/* the PDUs sent by the handler */
+static unsigned Notify_Count;
+static unsigned Confirmed_Notify_Count;
+static unsigned Simple_Ack_Count;
+static unsigned Error_Count;
+static uint8_t Last_Invoke_ID;
+
+static unsigned changed_find(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    unsigned i;
+
+    for (i = 0; i < Changed_Count; i++) {
+        if ((Changed_Objects[i].type == object_type) &&
+            (Changed_Objects[i].instance == object_instance)) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+bool Device_COV(BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    return changed_find(object_type, object_instance) < Changed_Count;
+}
+
+void Device_COV_Clear(BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    unsigned i = changed_find(object_type, object_instance);
+
+    if (i < Changed_Count) {
+        Changed_Count--;
+        Changed_Objects[i] = Changed_Objects[Changed_Count];
+        COV_Clear_Count++;
+    }
+}
+
+bool Device_Encode_Value_List(BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance,
+    BACNET_PROPERTY_VALUE *value_list)
+{
+    (void)object_type;
+    (void)object_instance;
+    return cov_value_list_encode_real(
+        value_list, 1.0f, false, false, false, false);
+}
+
+bool Device_Value_List_Supported(BACNET_OBJECT_TYPE object_type)
+{
+    (void)object_type;
+    return true;
+}
+
+bool Device_Valid_Object_Id(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    (void)object_instance;
+    return object_type != OBJECT_DEVICE;
+}
+
+uint32_t Device_Object_Instance_Number(void)
+{
+    return 1234;
+}
+
+uint16_t apdu_timeout(void)
+{
+    return 3000;
+}
+
+uint8_t apdu_retries(void)
+{
+    return 3;
+}
+
+void bip_get_my_address(BACNET_ADDRESS *my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+}
+
+int bip_send_pdu(BACNET_ADDRESS *dest,
+    BACNET_NPDU_DATA *npdu_data,
+    uint8_t *pdu,
+    unsigned pdu_len)
+{
+    BACNET_ADDRESS npdu_dest = { 0 }, npdu_src = { 0 };
+    BACNET_NPDU_DATA npdu = { 0 };
+    uint8_t *apdu;
+    int len;
+
+    (void)dest;
+    (void)npdu_data;
+    len = bacnet_npdu_decode(pdu, pdu_len, &npdu_dest, &npdu_src, &npdu);
+    zassert_true(len > 0, NULL);
+    apdu = &pdu[len];
+    switch (apdu[0] & 0xF0) {
+        case PDU_TYPE_UNCONFIRMED_SERVICE_REQUEST:
+            if (apdu[1] == SERVICE_UNCONFIRMED_COV_NOTIFICATION) {
+                Notify_Count++;
+            }
+            break;
+        case PDU_TYPE_CONFIRMED_SERVICE_REQUEST:
+            if (apdu[3] == SERVICE_CONFIRMED_COV_NOTIFICATION) {
+                Confirmed_Notify_Count++;
+                Last_Invoke_ID = apdu[2];
+            }
+            break;
+        case PDU_TYPE_SIMPLE_ACK:
+            Simple_Ack_Count++;
+            break;
+        case PDU_TYPE_ERROR:
+            Error_Count++;
+            break;
+        default:
+            break;
+    }
+
+    return (int)pdu_len;
+}
+
+/**
+ * @brief Start each test with an empty COV list and the default limits
+ */
+static void test_setup(void)
+{
+    zassert_true(
+        handler_cov_subscription_limit_set(TEST_COV_SUBSCRIPTIONS), NULL);
+    zassert_true(handler_cov_recipient_limit_set(TEST_COV_ADDRESSES), NULL);
+    handler_cov_init();
+    Changed_Count = 0;
+    COV_Clear_Count = 0;
+    Notify_Count = 0;
+    Confirmed_Notify_Count = 0;
+    Simple_Ack_Count = 0;
+    Error_Count = 0;
+}
+
+static void test_address(BACNET_ADDRESS *src, uint8_t mac)
+{
+    memset(src, 0, sizeof(BACNET_ADDRESS));
+    src->mac_len = 1;
+    src->mac[0] = mac;
+}
+
+/**
+ * @brief Send a SubscribeCOV request to the handler
+ * @return true if the handler replied with a Simple-ACK
+ */
+static bool test_subscribe(uint8_t mac,
+    uint32_t pid,
+    uint32_t instance,
+    bool confirmed,
+    bool cancel)
+{
+    BACNET_SUBSCRIBE_COV_DATA cov_data = { 0 };
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    BACNET_ADDRESS src;
+    uint8_t apdu[MAX_APDU];
+    unsigned acks = Simple_Ack_Count;
+    int len;
+
+    test_address(&src, mac);
+    cov_data.subscriberProcessIdentifier = pid;
+    cov_data.monitoredObjectIdentifier.type = OBJECT_ANALOG_INPUT;
+    cov_data.monitoredObjectIdentifier.instance = instance;
+    cov_data.cancellationRequest = cancel;
+    cov_data.issueConfirmedNotifications = confirmed;
+    cov_data.lifetime = 300;
+    len = cov_subscribe_encode_apdu(apdu, sizeof(apdu), 1, &cov_data);
+    zassert_true(len > 4, NULL);
+    service_data.invoke_id = 1;
+    handler_cov_subscribe(&apdu[4], (uint16_t)(len - 4), &src, &service_data);
+
+    return Simple_Ack_Count > acks;
+}
+
+/**
+ * @brief Report a change of value of an object, the way the objects do
+ */
+static void test_object_changed(uint32_t instance)
+{
+    if (!Device_COV(OBJECT_ANALOG_INPUT, instance)) {
+        zassert_true(Changed_Count < (TEST_COV_OBJECTS * 2), NULL);
+        Changed_Objects[Changed_Count].type = OBJECT_ANALOG_INPUT;
+        Changed_Objects[Changed_Count].instance = instance;
+        Changed_Count++;
+    }
+    cov_change_detected_notify(OBJECT_ANALOG_INPUT, instance);
+}
+
+/**
+ * @brief Run the COV task until it completes a cycle
+ */
+static void test_cov_cycle(void)
+{
+    unsigned i;
+
+    for (i = 0; i < 100000; i++) {
+        if (handler_cov_fsm()) {
+            return;
+        }
+    }
+    zassert_unreachable("COV task did not complete a cycle");
+}
+
+static void testCOVLimits(void)
+{
+    BACNET_COV_STATISTICS stats = { 0 };
+
+    test_setup();
+    zassert_false(
+        handler_cov_subscription_limit_set(TEST_COV_SUBSCRIPTIONS + 1), NULL);
+    zassert_false(handler_cov_recipient_limit_set(TEST_COV_ADDRESSES + 1), NULL);
+    /* subscriptions */
+    zassert_true(handler_cov_subscription_limit_set(2), NULL);
+    zassert_true(test_subscribe(1, 1, 1, false, false), NULL);
+    zassert_true(test_subscribe(1, 1, 2, false, false), NULL);
+    zassert_false(test_subscribe(1, 1, 3, false, false), NULL);
+    zassert_equal(Error_Count, 1, NULL);
+    /* an existing subscription is renewed at the limit */
+    zassert_true(test_subscribe(1, 1, 2, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 2, NULL);
+    zassert_equal(stats.subscriptions_rejected, 1, NULL);
+    /* recipients */
+    zassert_true(handler_cov_subscription_limit_set(10), NULL);
+    zassert_true(handler_cov_recipient_limit_set(1), NULL);
+    zassert_true(test_subscribe(1, 1, 3, false, false), NULL);
+    zassert_false(test_subscribe(2, 1, 3, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 3, NULL);
+    zassert_equal(stats.subscriptions_rejected, 2, NULL);
+    zassert_equal(stats.recipients, 1, NULL);
+    /* lowering the limit keeps the existing subscriptions */
+    zassert_true(handler_cov_subscription_limit_set(1), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 3, NULL);
+    zassert_true(test_subscribe(1, 1, 3, false, true), NULL);
+    zassert_false(test_subscribe(1, 1, 4, false, false), NULL);
+}
+
+static void testCOVRecipientRefcount(void)
+{
+    BACNET_COV_STATISTICS stats = { 0 };
+
+    test_setup();
+    zassert_true(test_subscribe(1, 1, 1, false, false), NULL);
+    zassert_true(test_subscribe(1, 2, 1, false, false), NULL);
+    zassert_true(test_subscribe(1, 1, 2, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 3, NULL);
+    zassert_equal(stats.recipients, 1, NULL);
+    zassert_true(test_subscribe(2, 1, 1, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.recipients, 2, NULL);
+    zassert_equal(stats.recipients_high_water, 2, NULL);
+    /* the address is kept while any subscription uses it */
+    zassert_true(test_subscribe(1, 1, 1, false, true), NULL);
+    zassert_true(test_subscribe(1, 2, 1, false, true), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.recipients, 2, NULL);
+    zassert_true(test_subscribe(1, 1, 2, false, true), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.recipients, 1, NULL);
+    /* cancelling twice does not release the address twice */
+    zassert_true(test_subscribe(1, 1, 2, false, true), NULL);
+    zassert_true(test_subscribe(2, 1, 1, false, true), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 0, NULL);
+    zassert_equal(stats.recipients, 0, NULL);
+    zassert_equal(stats.recipients_high_water, 2, NULL);
+    /* the freed address is reused */
+    zassert_true(test_subscribe(3, 1, 1, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.recipients, 1, NULL);
+}
+
+static void testCOVBlockPool(void)
+{
+    BACNET_COV_STATISTICS stats = { 0 };
+    unsigned i;
+
+    test_setup();
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions_allocated, 0, NULL);
+    zassert_equal(stats.recipients_allocated, 0, NULL);
+    zassert_true(test_subscribe(1, 1, 0, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions_allocated, TEST_COV_BLOCK_SIZE, NULL);
+    for (i = 1; i <= TEST_COV_BLOCK_SIZE; i++) {
+        zassert_true(test_subscribe(1, 1, i, false, false), NULL);
+    }
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, TEST_COV_BLOCK_SIZE + 1, NULL);
+    zassert_equal(
+        stats.subscriptions_allocated, TEST_COV_BLOCK_SIZE * 2, NULL);
+    /* the blocks are kept and reused after the subscriptions end */
+    for (i = 0; i <= TEST_COV_BLOCK_SIZE; i++) {
+        zassert_true(test_subscribe(1, 1, i, false, true), NULL);
+    }
+    for (i = 0; i <= TEST_COV_BLOCK_SIZE; i++) {
+        zassert_true(test_subscribe(2, 1, i, false, false), NULL);
+    }
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, TEST_COV_BLOCK_SIZE + 1, NULL);
+    zassert_equal(stats.subscriptions_high_water, TEST_COV_BLOCK_SIZE + 1,
+        NULL);
+    zassert_equal(
+        stats.subscriptions_allocated, TEST_COV_BLOCK_SIZE * 2, NULL);
+    zassert_true(handler_cov_encode_subscriptions(NULL, 0) == 0, NULL);
+    /* init releases the blocks */
+    handler_cov_init();
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 0, NULL);
+    zassert_equal(stats.subscriptions_allocated, 0, NULL);
+    zassert_equal(stats.recipients_allocated, 0, NULL);
+}
+
+static void testCOVSubscriptionIndex(void)
+{
+    BACNET_COV_STATISTICS stats = { 0 };
+
+    test_setup();
+    /* the same object, by process and by recipient */
+    zassert_true(test_subscribe(1, 1, 5, false, false), NULL);
+    zassert_true(test_subscribe(1, 2, 5, false, false), NULL);
+    zassert_true(test_subscribe(2, 1, 5, false, false), NULL);
+    /* an object in the same hash bucket */
+    zassert_true(test_subscribe(1, 1, 5 + 256, false, false), NULL);
+    /* renewal matches the existing subscription */
+    zassert_true(test_subscribe(1, 2, 5, false, false), NULL);
+    handler_cov_statistics(&stats);
+    zassert_equal(stats.subscriptions, 4, NULL);
+    /* the first notification of each subscription */
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 4, NULL);
+    /* a change of one object reaches only its own subscriptions */
+    Notify_Count = 0;
+    test_object_changed(5);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 3, NULL);
+    zassert_equal(Changed_Count, 0, NULL);
+    Notify_Count = 0;
+    test_object_changed(5 + 256);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 1, NULL);
+    /* a cancelled subscription leaves the index */
+    zassert_true(test_subscribe(1, 2, 5, false, true), NULL);
+    test_cov_cycle();
+    Notify_Count = 0;
+    test_object_changed(5);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 2, NULL);
+}
+
+static void testCOVDirtyQueue(void)
+{
+    unsigned i;
+
+    test_setup();
+    for (i = 0; i < TEST_COV_OBJECTS; i++) {
+        zassert_true(test_subscribe(1, 1, i, false, false), NULL);
+    }
+    test_cov_cycle();
+    zassert_equal(Notify_Count, TEST_COV_OBJECTS, NULL);
+    /* an object that is not subscribed is not queued */
+    Notify_Count = 0;
+    COV_Clear_Count = 0;
+    test_object_changed(TEST_COV_OBJECTS);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 0, NULL);
+    zassert_equal(COV_Clear_Count, 0, NULL);
+    Changed_Count = 0;
+    /* an object that changes again before the task runs is sent once */
+    test_object_changed(1);
+    test_object_changed(1);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 1, NULL);
+    zassert_equal(COV_Clear_Count, 1, NULL);
+    /* more changes than the queue holds are all sent */
+    Notify_Count = 0;
+    COV_Clear_Count = 0;
+    for (i = 0; i < TEST_COV_OBJECTS; i++) {
+        test_object_changed(i);
+    }
+    test_cov_cycle();
+    zassert_equal(Notify_Count, TEST_COV_OBJECTS, NULL);
+    zassert_equal(COV_Clear_Count, TEST_COV_OBJECTS, NULL);
+    zassert_equal(Changed_Count, 0, NULL);
+    /* and the queue is used again after the overflow */
+    Notify_Count = 0;
+    test_object_changed(3);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 1, NULL);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 1, NULL);
+}
+
+static void testCOVPendingList(void)
+{
+    test_setup();
+    zassert_true(test_subscribe(1, 1, 1, true, false), NULL);
+    zassert_true(test_subscribe(1, 1, 2, false, false), NULL);
+    test_cov_cycle();
+    zassert_equal(Confirmed_Notify_Count, 1, NULL);
+    zassert_equal(Notify_Count, 1, NULL);
+    /* the confirmed notification waits for its reply */
+    test_object_changed(1);
+    test_object_changed(2);
+    test_cov_cycle();
+    zassert_equal(Confirmed_Notify_Count, 1, NULL);
+    zassert_equal(Notify_Count, 2, NULL);
+    test_cov_cycle();
+    zassert_equal(Confirmed_Notify_Count, 1, NULL);
+    /* and is sent once the reply arrives */
+    tsm_free_invoke_id(Last_Invoke_ID);
+    test_cov_cycle();
+    zassert_equal(Confirmed_Notify_Count, 2, NULL);
+    tsm_free_invoke_id(Last_Invoke_ID);
+    test_cov_cycle();
+    test_cov_cycle();
+    zassert_equal(Confirmed_Notify_Count, 2, NULL);
+    zassert_equal(Notify_Count, 2, NULL);
+    /* a cancelled subscription with a notification to send */
+    test_object_changed(2);
+    zassert_true(test_subscribe(1, 1, 2, false, true), NULL);
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 2, NULL);
+    zassert_true(test_subscribe(1, 1, 1, true, true), NULL);
+    test_cov_cycle();
+    zassert_equal(Confirmed_Notify_Count, 2, NULL);
+}
+
+static void testCOVTaskEmpty(void)
+{
+    unsigned i;
+
+    /* the task runs without any subscriptions */
+    test_setup();
+    for (i = 0; i < 5; i++) {
+        handler_cov_task();
+    }
+    test_cov_cycle();
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 0, NULL);
+    /* and when the list is initialized in the middle of a cycle */
+    for (i = 0; i < 4; i++) {
+        zassert_true(test_subscribe(1, 1, i, false, false), NULL);
+    }
+    test_object_changed(1);
+    handler_cov_task();
+    handler_cov_task();
+    handler_cov_init();
+    test_cov_cycle();
+    test_cov_cycle();
+    zassert_equal(Notify_Count, 0, NULL);
+}
+/**
+ * @}
+ */
+
+void test_main(void)
+{
+    ztest_test_suite(h_cov_tests,
+     ztest_unit_test(testCOVLimits),
+     ztest_unit_test(testCOVRecipientRefcount),
+     ztest_unit_test(testCOVBlockPool),
+     ztest_unit_test(testCOVSubscriptionIndex),
+     ztest_unit_test(testCOVDirtyQueue),
+     ztest_unit_test(testCOVPendingList),
+     ztest_unit_test(testCOVTaskEmpty)
+     );
+
+    ztest_run_test_suite(h_cov_tests);
+}
@@ -0,0 +1,702 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test the index of active events, and the GetEventInformation
+ *  and GetAlarmSummary handlers that use it
+ */
+
+#include <string.h>
+#include <ztest.h>
+#include <bacnet/bacdcode.h>
+#include <bacnet/get_alarm_sum.h>
+#include <bacnet/getevent.h>
+#include <bacnet/npdu.h>
+#include <bacnet/basic/service/h_get_alarm_sum.h>
+#include <bacnet/basic/service/h_getevent.h>
+#include <bacnet/basic/sys/key.h>
+#include <bacnet/basic/tsm/tsm.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+#define TEST_OBJECTS 4
+#define TEST_EVENTS 16
+
+struct test_object {
+    uint32_t instance;
+    BACNET_EVENT_STATE event_state;
+    bool acked;
+    BACNET_NOTIFY_TYPE notify_type;
+};
+
+/* Analog Inputs and Binary Values keep the index of active events,
+   and the Analog Values are visited one by one */
+static struct test_object Analog_Inputs[TEST_OBJECTS];
+static struct test_object Analog_Values[TEST_OBJECTS];
+static struct test_object Binary_Values[1];
+/* the APDU sent by the handler */
+static uint8_t Sent_APDU[MAX_PDU];
+static unsigned Sent_APDU_Len;
+
+uint32_t Device_Object_Instance_Number(void)
+{
+    return 1234;
+}
+
+uint16_t apdu_timeout(void)
+{
+    return 3000;
+}
+
+uint8_t apdu_retries(void)
+{
+    return 3;
+}
+
+void bip_get_my_address(BACNET_ADDRESS *my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+}
+
+int bip_send_pdu(BACNET_ADDRESS *dest,
+    BACNET_NPDU_DATA *npdu_data,
+    uint8_t *pdu,
+    unsigned pdu_len)
+{
+    BACNET_ADDRESS npdu_dest = { 0 }, npdu_src = { 0 };
+    BACNET_NPDU_DATA npdu = { 0 };
+    int len;
+
+    (void)dest;
+    (void)npdu_data;
+    len = bacnet_npdu_decode(pdu, pdu_len, &npdu_dest, &npdu_src, &npdu);
+    zassert_true(len > 0, NULL);
+    Sent_APDU_Len = pdu_len - len;
+    memcpy(Sent_APDU, &pdu[len], Sent_APDU_Len);
+
+    return (int)pdu_len;
+}
+
+static bool test_object_active(struct test_object *object)
+{
+    return (object->event_state != EVENT_STATE_NORMAL) || !object->acked;
+}
+
+static unsigned test_object_index(
+    struct test_object *objects, unsigned count, uint32_t instance)
+{
+    unsigned index;
+
+    for (index = 0; index < count; index++) {
+        if (objects[index].instance == instance) {
+            break;
+        }
+    }
+
+    return index;
+}
+
+static int test_event_info(struct test_object *objects,
+    unsigned count,
+    BACNET_OBJECT_TYPE object_type,
+    unsigned index,
+    BACNET_GET_EVENT_INFORMATION_DATA *getevent_data)
+{
+    unsigned i;
+
+    if (index >= count) {
+        return -1;
+    }
+    if (!test_object_active(&objects[index])) {
+        return 0;
+    }
+    getevent_data->objectIdentifier.type = object_type;
+    getevent_data->objectIdentifier.instance = objects[index].instance;
+    getevent_data->eventState = objects[index].event_state;
+    bitstring_init(&getevent_data->acknowledgedTransitions);
+    bitstring_set_bit(&getevent_data->acknowledgedTransitions,
+        TRANSITION_TO_OFFNORMAL, objects[index].acked);
+    bitstring_set_bit(&getevent_data->acknowledgedTransitions,
+        TRANSITION_TO_FAULT, true);
+    bitstring_set_bit(&getevent_data->acknowledgedTransitions,
+        TRANSITION_TO_NORMAL, true);
+    for (i = 0; i < 3; i++) {
+        getevent_data->eventTimeStamps[i].tag = TIME_STAMP_SEQUENCE;
+        getevent_data->eventTimeStamps[i].value.sequenceNum = i;
+        getevent_data->eventPriorities[i] = 100;
+    }
+    getevent_data->notifyType = objects[index].notify_type;
+    bitstring_init(&getevent_data->eventEnable);
+    bitstring_set_bit(&getevent_data->eventEnable, TRANSITION_TO_OFFNORMAL,
+        true);
+    bitstring_set_bit(&getevent_data->eventEnable, TRANSITION_TO_FAULT, true);
+    bitstring_set_bit(&getevent_data->eventEnable, TRANSITION_TO_NORMAL, true);
+
+    return 1;
+}
+
+static int test_alarm_summary(struct test_object *objects,
+    unsigned count,
+    BACNET_OBJECT_TYPE object_type,
+    unsigned index,
+    BACNET_GET_ALARM_SUMMARY_DATA *getalarm_data)
+{
+    if (index >= count) {
+        return -1;
+    }
+    if ((objects[index].event_state == EVENT_STATE_NORMAL) ||
+        (objects[index].notify_type != NOTIFY_ALARM)) {
+        return 0;
+    }
+    getalarm_data->objectIdentifier.type = object_type;
+    getalarm_data->objectIdentifier.instance = objects[index].instance;
+    getalarm_data->alarmState = objects[index].event_state;
+    bitstring_init(&getalarm_data->acknowledgedTransitions);
+    bitstring_set_bit(&getalarm_data->acknowledgedTransitions,
+        TRANSITION_TO_OFFNORMAL, objects[index].acked);
+    bitstring_set_bit(&getalarm_data->acknowledgedTransitions,
+        TRANSITION_TO_FAULT, true);
+    bitstring_set_bit(&getalarm_data->acknowledgedTransitions,
+        TRANSITION_TO_NORMAL, true);
+
+    return 1;
+}
+
+static unsigned AI_Index(uint32_t instance)
+{
+    return test_object_index(Analog_Inputs, TEST_OBJECTS, instance);
+}
+
+static int AI_Event_Info(
+    unsigned index, BACNET_GET_EVENT_INFORMATION_DATA *getevent_data)
+{
+    return test_event_info(Analog_Inputs, TEST_OBJECTS, OBJECT_ANALOG_INPUT,
+        index, getevent_data);
+}
+
+static int AI_Alarm_Summary(
+    unsigned index, BACNET_GET_ALARM_SUMMARY_DATA *getalarm_data)
+{
+    return test_alarm_summary(Analog_Inputs, TEST_OBJECTS,
+        OBJECT_ANALOG_INPUT, index, getalarm_data);
+}
+
+static int AV_Event_Info(
+    unsigned index, BACNET_GET_EVENT_INFORMATION_DATA *getevent_data)
+{
+    return test_event_info(Analog_Values, TEST_OBJECTS, OBJECT_ANALOG_VALUE,
+        index, getevent_data);
+}
+
+static int AV_Alarm_Summary(
+    unsigned index, BACNET_GET_ALARM_SUMMARY_DATA *getalarm_data)
+{
+    return test_alarm_summary(Analog_Values, TEST_OBJECTS,
+        OBJECT_ANALOG_VALUE, index, getalarm_data);
+}
+
+static unsigned BV_Index(uint32_t instance)
+{
+    return test_object_index(Binary_Values, 1, instance);
+}
+
+static int BV_Event_Info(
+    unsigned index, BACNET_GET_EVENT_INFORMATION_DATA *getevent_data)
+{
+    return test_event_info(
+        Binary_Values, 1, OBJECT_BINARY_VALUE, index, getevent_data);
+}
+
+static int BV_Alarm_Summary(
+    unsigned index, BACNET_GET_ALARM_SUMMARY_DATA *getalarm_data)
+{
+    return test_alarm_summary(
+        Binary_Values, 1, OBJECT_BINARY_VALUE, index, getalarm_data);
+}
+
+static void test_object_set(struct test_object *object,
+    uint32_t instance,
+    BACNET_EVENT_STATE event_state,
+    bool acked,
+    BACNET_NOTIFY_TYPE notify_type)
+{
+    object->instance = instance;
+    object->event_state = event_state;
+    object->acked = acked;
+    object->notify_type = notify_type;
+}
+
+/**
+ * @brief Start each test with an empty index of active events
+ */
+static void test_setup(void)
+{
+    handler_get_event_information_active_clear(MAX_BACNET_OBJECT_TYPE);
+    zassert_equal(handler_get_event_information_active_count(), 0, NULL);
+}
+
+/**
+ * @brief Set up the objects of the handler tests:
+ *  AI-1 HIGH_LIMIT alarm, AI-5 NORMAL not acknowledged, AI-9 LOW_LIMIT
+ *  event, AI-12 NORMAL; AV-10 NORMAL, AV-11 HIGH_LIMIT alarm, AV-12
+ *  NORMAL, AV-13 NORMAL not acknowledged; BV-3 FAULT alarm
+ */
+static void test_objects_setup(void)
+{
+    unsigned i;
+
+    test_setup();
+    test_object_set(
+        &Analog_Inputs[0], 1, EVENT_STATE_HIGH_LIMIT, true, NOTIFY_ALARM);
+    test_object_set(
+        &Analog_Inputs[1], 5, EVENT_STATE_NORMAL, false, NOTIFY_ALARM);
+    test_object_set(
+        &Analog_Inputs[2], 9, EVENT_STATE_LOW_LIMIT, true, NOTIFY_EVENT);
+    test_object_set(
+        &Analog_Inputs[3], 12, EVENT_STATE_NORMAL, true, NOTIFY_ALARM);
+    test_object_set(
+        &Analog_Values[0], 10, EVENT_STATE_NORMAL, true, NOTIFY_ALARM);
+    test_object_set(
+        &Analog_Values[1], 11, EVENT_STATE_HIGH_LIMIT, true, NOTIFY_ALARM);
+    test_object_set(
+        &Analog_Values[2], 12, EVENT_STATE_NORMAL, true, NOTIFY_ALARM);
+    test_object_set(
+        &Analog_Values[3], 13, EVENT_STATE_NORMAL, false, NOTIFY_ALARM);
+    test_object_set(
+        &Binary_Values[0], 3, EVENT_STATE_FAULT, true, NOTIFY_ALARM);
+    handler_get_event_information_set(OBJECT_ANALOG_INPUT, AI_Event_Info);
+    handler_get_event_information_index_set(OBJECT_ANALOG_INPUT, AI_Index);
+    handler_get_alarm_summary_set(OBJECT_ANALOG_INPUT, AI_Alarm_Summary);
+    handler_get_event_information_set(OBJECT_ANALOG_VALUE, AV_Event_Info);
+    handler_get_event_information_index_set(OBJECT_ANALOG_VALUE, NULL);
+    handler_get_alarm_summary_set(OBJECT_ANALOG_VALUE, AV_Alarm_Summary);
+    handler_get_event_information_set(OBJECT_BINARY_VALUE, BV_Event_Info);
+    handler_get_event_information_index_set(OBJECT_BINARY_VALUE, BV_Index);
+    handler_get_alarm_summary_set(OBJECT_BINARY_VALUE, BV_Alarm_Summary);
+    for (i = 0; i < TEST_OBJECTS; i++) {
+        handler_get_event_information_active_set(OBJECT_ANALOG_INPUT,
+            Analog_Inputs[i].instance,
+            test_object_active(&Analog_Inputs[i]));
+    }
+    handler_get_event_information_active_set(OBJECT_BINARY_VALUE,
+        Binary_Values[0].instance, test_object_active(&Binary_Values[0]));
+}
+
+/**
+ * @brief Send a GetEventInformation request to the handler, and decode
+ *  the objects of its acknowledgement
+ * @param last - Last Received Object Identifier, or NULL
+ * @param max_resp - maximum size of the response
+ * @param objects - the objects in the acknowledgement [out]
+ * @param more_events - the More Events flag of the acknowledgement [out]
+ * @return number of objects in the acknowledgement
+ */
+static unsigned test_get_event_information(BACNET_OBJECT_ID *last,
+    unsigned max_resp,
+    BACNET_OBJECT_ID *objects,
+    bool *more_events)
+{
+    uint8_t apdu[MAX_APDU] = { 0 };
+    BACNET_GET_EVENT_INFORMATION_DATA data[TEST_EVENTS] = { 0 };
+    BACNET_GET_EVENT_INFORMATION_DATA *event;
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    BACNET_ADDRESS src = { 0 };
+    uint8_t tag_number = 0;
+    uint32_t len_value = 0;
+    unsigned count = 0;
+    unsigned i;
+    int len;
+
+    len = getevent_encode_apdu(apdu, 1, last);
+    zassert_true(len >= 4, NULL);
+    service_data.invoke_id = 1;
+    service_data.max_resp = max_resp;
+    Sent_APDU_Len = 0;
+    handler_get_event_information(&apdu[4], len - 4, &src, &service_data);
+    zassert_true(Sent_APDU_Len > 3, NULL);
+    zassert_equal(Sent_APDU[0], PDU_TYPE_COMPLEX_ACK, NULL);
+    zassert_equal(
+        Sent_APDU[2], SERVICE_CONFIRMED_GET_EVENT_INFORMATION, NULL);
+    zassert_true(Sent_APDU_Len <= max_resp, NULL);
+    if (decode_is_closing_tag_number(&Sent_APDU[4], 0)) {
+        /* an empty list of event summaries */
+        len = 5;
+        len += decode_tag_number_and_value(
+            &Sent_APDU[len], &tag_number, &len_value);
+        zassert_equal(tag_number, 1, NULL);
+        *more_events = decode_context_boolean(&Sent_APDU[len]);
+        return 0;
+    }
+    for (i = 0; i < TEST_EVENTS - 1; i++) {
+        data[i].next = &data[i + 1];
+    }
+    len = getevent_ack_decode_service_request(
+        &Sent_APDU[3], Sent_APDU_Len - 3, &data[0], more_events);
+    zassert_true(len > 0, NULL);
+    for (event = &data[0]; event; event = event->next) {
+        objects[count] = event->objectIdentifier;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Send a GetAlarmSummary request to the handler, and decode the
+ *  objects of its acknowledgement
+ * @param objects - the objects in the acknowledgement [out]
+ * @return number of objects in the acknowledgement
+ */
+static unsigned test_get_alarm_summary(BACNET_OBJECT_ID *objects)
+{
+    BACNET_GET_ALARM_SUMMARY_DATA data = { 0 };
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    BACNET_ADDRESS src = { 0 };
+    unsigned count = 0;
+    unsigned offset = 3;
+    int len;
+
+    service_data.invoke_id = 2;
+    service_data.max_resp = MAX_APDU;
+    Sent_APDU_Len = 0;
+    handler_get_alarm_summary(NULL, 0, &src, &service_data);
+    zassert_true(Sent_APDU_Len >= 3, NULL);
+    zassert_equal(Sent_APDU[0], PDU_TYPE_COMPLEX_ACK, NULL);
+    zassert_equal(Sent_APDU[2], SERVICE_CONFIRMED_GET_ALARM_SUMMARY, NULL);
+    while (offset < Sent_APDU_Len) {
+        len = get_alarm_summary_ack_decode_apdu_data(
+            &Sent_APDU[offset], Sent_APDU_Len - offset, &data);
+        zassert_true(len > 0, NULL);
+        objects[count] = data.objectIdentifier;
+        count++;
+        offset += len;
+    }
+
+    return count;
+}
+
+static void test_object_id_check(BACNET_OBJECT_ID *object_id,
+    BACNET_OBJECT_TYPE object_type,
+    uint32_t object_instance)
+{
+    zassert_equal(object_id->type, object_type, NULL);
+    zassert_equal(object_id->instance, object_instance, NULL);
+}
+
+/**
+ * @brief Test adding, removing and clearing the active events
+ */
+static void testActiveEventSet(void)
+{
+    uint32_t instance = 0;
+    unsigned position;
+    unsigned i;
+
+    test_setup();
+    /* added out of order, and kept sorted by type and instance */
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_VALUE, 7, true), NULL);
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_INPUT, 30, true), NULL);
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_INPUT, 2, true), NULL);
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_INPUT, 17, true), NULL);
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_VALUE, 1, true), NULL);
+    zassert_equal(handler_get_event_information_active_count(), 5, NULL);
+    /* adding an active object again does not change the index */
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_INPUT, 17, true), NULL);
+    zassert_equal(handler_get_event_information_active_count(), 5, NULL);
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, 0);
+    zassert_equal(position, 0, NULL);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, 2, NULL);
+    zassert_true(handler_get_event_information_active(
+                     position + 1, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, 17, NULL);
+    zassert_true(handler_get_event_information_active(
+                     position + 2, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, 30, NULL);
+    zassert_false(handler_get_event_information_active(
+                      position + 3, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_true(handler_get_event_information_active(
+                     position + 3, OBJECT_ANALOG_VALUE, &instance), NULL);
+    zassert_equal(instance, 1, NULL);
+    zassert_true(handler_get_event_information_active(
+                     position + 4, OBJECT_ANALOG_VALUE, &instance), NULL);
+    zassert_equal(instance, 7, NULL);
+    zassert_false(handler_get_event_information_active(
+                      position + 5, OBJECT_ANALOG_VALUE, &instance), NULL);
+    /* removing an object that is not active does nothing */
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_INPUT, 3, false), NULL);
+    zassert_equal(handler_get_event_information_active_count(), 5, NULL);
+    /* removing an active object keeps the rest sorted */
+    zassert_true(handler_get_event_information_active_set(
+                     OBJECT_ANALOG_INPUT, 17, false), NULL);
+    zassert_equal(handler_get_event_information_active_count(), 4, NULL);
+    zassert_true(handler_get_event_information_active(
+                     1, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, 30, NULL);
+    /* clearing a type leaves the other types */
+    handler_get_event_information_active_clear(OBJECT_ANALOG_INPUT);
+    zassert_equal(handler_get_event_information_active_count(), 2, NULL);
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, 0);
+    zassert_false(handler_get_event_information_active(
+                      position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_ANALOG_VALUE, &instance), NULL);
+    zassert_equal(instance, 1, NULL);
+    /* clearing a type without active events leaves the index */
+    handler_get_event_information_active_clear(OBJECT_BINARY_VALUE);
+    zassert_equal(handler_get_event_information_active_count(), 2, NULL);
+    /* more objects than the first block of the index */
+    for (i = 0; i < 100; i++) {
+        zassert_true(handler_get_event_information_active_set(
+                         OBJECT_BINARY_VALUE, 100 - i, true), NULL);
+    }
+    zassert_equal(handler_get_event_information_active_count(), 102, NULL);
+    position = handler_get_event_information_active_find(
+        OBJECT_BINARY_VALUE, 0);
+    for (i = 0; i < 100; i++) {
+        zassert_true(handler_get_event_information_active(
+                         position + i, OBJECT_BINARY_VALUE, &instance), NULL);
+        zassert_equal(instance, i + 1, NULL);
+    }
+    /* clearing every type empties the index */
+    handler_get_event_information_active_clear(MAX_BACNET_OBJECT_TYPE);
+    zassert_equal(handler_get_event_information_active_count(), 0, NULL);
+    zassert_false(handler_get_event_information_active(
+                      0, OBJECT_ANALOG_VALUE, &instance), NULL);
+}
+
+/**
+ * @brief Test finding the active events at the boundaries of the types
+ *  and of the instances
+ */
+static void testActiveEventFind(void)
+{
+    uint32_t instance = 0;
+    unsigned position;
+
+    test_setup();
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 0, true);
+    handler_get_event_information_active_set(
+        OBJECT_ANALOG_INPUT, KEY_ID_MASK, true);
+    handler_get_event_information_active_set(OBJECT_BINARY_VALUE, 0, true);
+    /* the first instance of a type */
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, 0);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, 0, NULL);
+    /* the next instance is the last instance of the type */
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, 1);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, KEY_ID_MASK, NULL);
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, KEY_ID_MASK);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_equal(instance, KEY_ID_MASK, NULL);
+    /* past the last instance is the end of the type, not a wrap around
+       to the first instance of the type */
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, KEY_ID_MASK + 1);
+    zassert_false(handler_get_event_information_active(
+                      position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_BINARY_VALUE, &instance), NULL);
+    zassert_equal(instance, 0, NULL);
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_INPUT, BACNET_MAX_INSTANCE + 1);
+    zassert_false(handler_get_event_information_active(
+                      position, OBJECT_ANALOG_INPUT, &instance), NULL);
+    /* a type without active events between two types with them */
+    position = handler_get_event_information_active_find(
+        OBJECT_ANALOG_VALUE, 0);
+    zassert_false(handler_get_event_information_active(
+                      position, OBJECT_ANALOG_VALUE, &instance), NULL);
+    zassert_true(handler_get_event_information_active(
+                     position, OBJECT_BINARY_VALUE, &instance), NULL);
+    /* the last type */
+    position = handler_get_event_information_active_find(
+        OBJECT_BINARY_VALUE, 1);
+    zassert_equal(position, handler_get_event_information_active_count(),
+        NULL);
+    zassert_false(handler_get_event_information_active(
+                      position, OBJECT_BINARY_VALUE, &instance), NULL);
+    handler_get_event_information_active_clear(MAX_BACNET_OBJECT_TYPE);
+}
+
+/**
+ * @brief Test GetEventInformation with indexed and non-indexed types
+ */
+static void testGetEventInformation(void)
+{
+    BACNET_OBJECT_ID objects[TEST_EVENTS] = { 0 };
+    BACNET_OBJECT_ID last = { 0 };
+    bool more_events = true;
+    unsigned count;
+
+    test_objects_setup();
+    /* AI-12 and AV-10, AV-12 are NORMAL and acknowledged */
+    zassert_equal(handler_get_event_information_active_count(), 4, NULL);
+    count = test_get_event_information(NULL, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 6, NULL);
+    zassert_false(more_events, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_INPUT, 1);
+    test_object_id_check(&objects[1], OBJECT_ANALOG_INPUT, 5);
+    test_object_id_check(&objects[2], OBJECT_ANALOG_INPUT, 9);
+    test_object_id_check(&objects[3], OBJECT_ANALOG_VALUE, 11);
+    test_object_id_check(&objects[4], OBJECT_ANALOG_VALUE, 13);
+    test_object_id_check(&objects[5], OBJECT_BINARY_VALUE, 3);
+    /* continue after an indexed type */
+    last.type = OBJECT_ANALOG_INPUT;
+    last.instance = 5;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 4, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_INPUT, 9);
+    test_object_id_check(&objects[1], OBJECT_ANALOG_VALUE, 11);
+    /* continue after the last object of an indexed type */
+    last.instance = 9;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 3, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_VALUE, 11);
+    /* continue after a non-indexed type */
+    last.type = OBJECT_ANALOG_VALUE;
+    last.instance = 11;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 2, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_VALUE, 13);
+    test_object_id_check(&objects[1], OBJECT_BINARY_VALUE, 3);
+    /* continue after a type without events */
+    last.type = OBJECT_ANALOG_OUTPUT;
+    last.instance = 1;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 3, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_VALUE, 11);
+    /* continue after the last object */
+    last.type = OBJECT_BINARY_VALUE;
+    last.instance = 3;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 0, NULL);
+    zassert_false(more_events, NULL);
+    handler_get_event_information_active_clear(MAX_BACNET_OBJECT_TYPE);
+}
+
+/**
+ * @brief Test GetEventInformation continuing after an object that is no
+ *  longer active, and after a response that did not hold every event
+ */
+static void testGetEventInformationResume(void)
+{
+    BACNET_OBJECT_ID objects[TEST_EVENTS] = { 0 };
+    BACNET_OBJECT_ID last = { 0 };
+    bool more_events = false;
+    unsigned total = 0;
+    unsigned count;
+
+    test_objects_setup();
+    /* AI-5 was the Last Received Object Identifier, and is acknowledged
+       before the next request */
+    Analog_Inputs[1].acked = true;
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 5, false);
+    last.type = OBJECT_ANALOG_INPUT;
+    last.instance = 5;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 4, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_INPUT, 9);
+    test_object_id_check(&objects[1], OBJECT_ANALOG_VALUE, 11);
+    test_object_id_check(&objects[2], OBJECT_ANALOG_VALUE, 13);
+    test_object_id_check(&objects[3], OBJECT_BINARY_VALUE, 3);
+    /* the last object of a type is no longer active */
+    Analog_Inputs[2].event_state = EVENT_STATE_NORMAL;
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 9, false);
+    last.instance = 9;
+    count = test_get_event_information(&last, MAX_APDU, objects, &more_events);
+    zassert_equal(count, 3, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_VALUE, 11);
+    /* a small response holds only some of the events, and the next
+       request continues after the last of them */
+    Analog_Inputs[1].acked = false;
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 5, true);
+    Analog_Inputs[2].event_state = EVENT_STATE_LOW_LIMIT;
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 9, true);
+    count = test_get_event_information(NULL, 128, objects, &more_events);
+    zassert_true(count > 0, NULL);
+    zassert_true(count < 6, NULL);
+    zassert_true(more_events, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_INPUT, 1);
+    while (more_events && (total < 6)) {
+        total += count;
+        last = objects[count - 1];
+        count = test_get_event_information(&last, 128, objects, &more_events);
+        zassert_true(count > 0, NULL);
+    }
+    total += count;
+    zassert_equal(total, 6, NULL);
+    zassert_false(more_events, NULL);
+    test_object_id_check(&objects[count - 1], OBJECT_BINARY_VALUE, 3);
+    handler_get_event_information_active_clear(MAX_BACNET_OBJECT_TYPE);
+}
+
+/**
+ * @brief Test GetAlarmSummary with indexed and non-indexed types
+ */
+static void testGetAlarmSummary(void)
+{
+    BACNET_OBJECT_ID objects[TEST_EVENTS] = { 0 };
+    unsigned count;
+
+    test_objects_setup();
+    /* AI-5 and AV-13 are NORMAL, and AI-9 notifies an event */
+    count = test_get_alarm_summary(objects);
+    zassert_equal(count, 3, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_INPUT, 1);
+    test_object_id_check(&objects[1], OBJECT_ANALOG_VALUE, 11);
+    test_object_id_check(&objects[2], OBJECT_BINARY_VALUE, 3);
+    /* an object that returns to normal leaves the summary */
+    Analog_Inputs[0].event_state = EVENT_STATE_NORMAL;
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 1, false);
+    count = test_get_alarm_summary(objects);
+    zassert_equal(count, 2, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_VALUE, 11);
+    /* an object that is not in the index is not visited */
+    Analog_Inputs[3].event_state = EVENT_STATE_HIGH_LIMIT;
+    count = test_get_alarm_summary(objects);
+    zassert_equal(count, 2, NULL);
+    handler_get_event_information_active_set(OBJECT_ANALOG_INPUT, 12, true);
+    count = test_get_alarm_summary(objects);
+    zassert_equal(count, 3, NULL);
+    test_object_id_check(&objects[0], OBJECT_ANALOG_INPUT, 12);
+    handler_get_event_information_active_clear(MAX_BACNET_OBJECT_TYPE);
+}
+
+/**
+ * @}
+ */
+
+void test_main(void)
+{
+    ztest_test_suite(h_getevent_tests,
+     ztest_unit_test(testActiveEventSet),
+     ztest_unit_test(testActiveEventFind),
+     ztest_unit_test(testGetEventInformation),
+     ztest_unit_test(testGetEventInformationResume),
+     ztest_unit_test(testGetAlarmSummary)
+     );
+
+    ztest_run_test_suite(h_getevent_tests);
+}
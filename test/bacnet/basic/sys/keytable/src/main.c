@@ -0,0 +1,138 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test the hashed table of keyed rows
+ */
+
+#include <ztest.h>
+#include <bacnet/basic/sys/keytable.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+/**
+ * @brief Test adding, finding, and deleting rows
+ */
+static void testKeytableAddDelete(void)
+{
+    KEYTABLE table;
+    float *value = NULL;
+    uint8_t *flag = NULL;
+    uint32_t index;
+
+    Keytable_Init(&table);
+    zassert_true(
+        Keytable_Column_Add(&table, (void **)&value, sizeof(float)), NULL);
+    zassert_true(
+        Keytable_Column_Add(&table, (void **)&flag, sizeof(uint8_t)), NULL);
+    zassert_equal(Keytable_Count(&table), 0, NULL);
+    zassert_equal(Keytable_Index(&table, 1), KEYTABLE_INDEX_NONE, NULL);
+
+    index = Keytable_Add(&table, 100);
+    zassert_equal(index, 0, NULL);
+    zassert_not_null(value, NULL);
+    zassert_true(value[index] == 0.0f, NULL);
+    value[index] = 1.0f;
+    flag[index] = 1;
+    index = Keytable_Add(&table, 200);
+    zassert_equal(index, 1, NULL);
+    value[index] = 2.0f;
+    index = Keytable_Add(&table, 300);
+    zassert_equal(index, 2, NULL);
+    value[index] = 3.0f;
+    flag[index] = 3;
+    /* duplicate keys are not added */
+    index = Keytable_Add(&table, 200);
+    zassert_equal(index, KEYTABLE_INDEX_NONE, NULL);
+    zassert_equal(Keytable_Count(&table), 3, NULL);
+    zassert_equal(Keytable_Key(&table, 1), 200, NULL);
+
+    /* the last row moves into the deleted row */
+    zassert_true(Keytable_Delete(&table, 100), NULL);
+    zassert_false(Keytable_Delete(&table, 100), NULL);
+    zassert_equal(Keytable_Count(&table), 2, NULL);
+    zassert_equal(Keytable_Index(&table, 100), KEYTABLE_INDEX_NONE, NULL);
+    index = Keytable_Index(&table, 300);
+    zassert_equal(index, 0, NULL);
+    zassert_true(value[index] == 3.0f, NULL);
+    zassert_equal(flag[index], 3, NULL);
+    index = Keytable_Index(&table, 200);
+    zassert_equal(index, 1, NULL);
+    zassert_true(value[index] == 2.0f, NULL);
+    /* a row that is added again starts from zero */
+    index = Keytable_Add(&table, 100);
+    zassert_equal(index, 2, NULL);
+    zassert_true(value[index] == 0.0f, NULL);
+    zassert_equal(flag[index], 0, NULL);
+
+    Keytable_Clear(&table);
+    zassert_equal(Keytable_Count(&table), 0, NULL);
+    zassert_is_null(value, NULL);
+    zassert_is_null(flag, NULL);
+    zassert_equal(Keytable_Index(&table, 200), KEYTABLE_INDEX_NONE, NULL);
+
+    return;
+}
+
+/**
+ * @brief Test growing the table to many sparse keys
+ */
+static void testKeytableLarge(void)
+{
+    KEYTABLE table;
+    KEY *data = NULL;
+    const uint32_t num_keys = 10000;
+    uint32_t i;
+    uint32_t index;
+
+    Keytable_Init(&table);
+    zassert_true(
+        Keytable_Column_Add(&table, (void **)&data, sizeof(KEY)), NULL);
+    for (i = 0; i < num_keys; i++) {
+        index = Keytable_Add(&table, i * 7919);
+        zassert_equal(index, i, NULL);
+        data[index] = i;
+    }
+    zassert_equal(Keytable_Count(&table), num_keys, NULL);
+    for (i = 0; i < num_keys; i++) {
+        index = Keytable_Index(&table, i * 7919);
+        zassert_not_equal(index, KEYTABLE_INDEX_NONE, NULL);
+        zassert_equal(data[index], i, NULL);
+    }
+    /* delete the even keys */
+    for (i = 0; i < num_keys; i += 2) {
+        zassert_true(Keytable_Delete(&table, i * 7919), NULL);
+    }
+    zassert_equal(Keytable_Count(&table), num_keys / 2, NULL);
+    for (i = 0; i < num_keys; i++) {
+        index = Keytable_Index(&table, i * 7919);
+        if (i & 1) {
+            zassert_not_equal(index, KEYTABLE_INDEX_NONE, NULL);
+            zassert_equal(data[index], i, NULL);
+            zassert_equal(Keytable_Key(&table, index), i * 7919, NULL);
+        } else {
+            zassert_equal(index, KEYTABLE_INDEX_NONE, NULL);
+        }
+    }
+    Keytable_Clear(&table);
+
+    return;
+}
+/**
+ * @}
+ */
+
+
+void test_main(void)
+{
+    ztest_test_suite(keytable_tests,
+     ztest_unit_test(testKeytableAddDelete),
+     ztest_unit_test(testKeytableLarge)
+     );
+
+    ztest_run_test_suite(keytable_tests);
+}
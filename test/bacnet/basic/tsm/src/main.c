@@ -0,0 +1,489 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* @file
+ * @brief test BACnet Transaction State Machine APIs
+ */
+
+#include <ztest.h>
+#include <bacnet/bacdef.h>
+#include <bacnet/npdu.h>
+#include <bacnet/basic/tsm/tsm.h>
+#include <bacnet/datalink/datalink.h>
+
+/**
+ * @addtogroup bacnet_tests
+ * @{
+ */
+
+static unsigned Send_Count;
+static unsigned Timeout_Count;
+static uint8_t Timeout_Invoke_ID;
+/* the APDUs that were sent, without the NPDU */
+#define SENT_APDU_MAX 16
+static uint8_t Sent_APDU[SENT_APDU_MAX][MAX_PDU];
+static unsigned Sent_APDU_Len[SENT_APDU_MAX];
+
+/* dummy function stubs */
+int datalink_send_pdu(BACNET_ADDRESS *dest,
+    BACNET_NPDU_DATA *npdu_data,
+    uint8_t *pdu,
+    unsigned pdu_len)
+{
+    BACNET_ADDRESS npdu_dest = { 0 };
+    BACNET_ADDRESS npdu_src = { 0 };
+    BACNET_NPDU_DATA decoded_npdu_data = { 0 };
+    int npdu_len = 0;
+
+    (void)dest;
+    (void)npdu_data;
+    if (Send_Count < SENT_APDU_MAX) {
+        npdu_len =
+            npdu_decode(pdu, &npdu_dest, &npdu_src, &decoded_npdu_data);
+        Sent_APDU_Len[Send_Count] = pdu_len - npdu_len;
+        memcpy(Sent_APDU[Send_Count], &pdu[npdu_len], pdu_len - npdu_len);
+    }
+    Send_Count++;
+
+    return (int)pdu_len;
+}
+
+void datalink_get_my_address(BACNET_ADDRESS *my_address)
+{
+    memset(my_address, 0, sizeof(BACNET_ADDRESS));
+}
+
+uint16_t apdu_timeout(void)
+{
+    return 3000;
+}
+
+uint8_t apdu_retries(void)
+{
+    return 3;
+}
+
+uint16_t apdu_segment_timeout(void)
+{
+    return 2000;
+}
+
+static void timeout_handler(uint8_t invoke_id)
+{
+    Timeout_Count++;
+    Timeout_Invoke_ID = invoke_id;
+}
+
+/**
+ * @brief Test the invoke ID allocation
+ */
+static void testTSMInvokeID(void)
+{
+    uint8_t invoke_id[MAX_TSM_TRANSACTIONS] = { 0 };
+    unsigned i;
+
+    zassert_equal(tsm_transaction_idle_count(), MAX_TSM_TRANSACTIONS, NULL);
+    tsm_invokeID_set(1);
+    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++) {
+        invoke_id[i] = tsm_next_free_invokeID();
+        zassert_not_equal(invoke_id[i], 0, NULL);
+        zassert_false(tsm_invoke_id_free(invoke_id[i]), NULL);
+    }
+    zassert_false(tsm_transaction_available(), NULL);
+    zassert_equal(tsm_transaction_idle_count(), 0, NULL);
+    zassert_equal(tsm_next_free_invokeID(), 0, NULL);
+    /* a freed invoke ID is not reused until the others are tried */
+    tsm_free_invoke_id(invoke_id[10]);
+    zassert_true(tsm_invoke_id_free(invoke_id[10]), NULL);
+    zassert_equal(tsm_transaction_idle_count(), 1, NULL);
+    zassert_equal(tsm_next_free_invokeID(), invoke_id[10], NULL);
+    for (i = 0; i < MAX_TSM_TRANSACTIONS; i++) {
+        tsm_free_invoke_id(invoke_id[i]);
+    }
+    zassert_true(tsm_transaction_available(), NULL);
+    zassert_equal(tsm_transaction_idle_count(), MAX_TSM_TRANSACTIONS, NULL);
+}
+
+/**
+ * @brief Test the request timer, retries and timeout
+ */
+static void testTSMTimer(void)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t apdu[4] = { 0, 1, 2, 3 };
+    uint8_t test_apdu[MAX_PDU] = { 0 };
+    uint16_t test_apdu_len = 0;
+    uint8_t invoke_id, other_id;
+    unsigned i;
+
+    tsm_set_timeout_handler(timeout_handler);
+    invoke_id = tsm_next_free_invokeID();
+    other_id = tsm_next_free_invokeID();
+    zassert_not_equal(invoke_id, 0, NULL);
+    tsm_set_confirmed_unsegmented_transaction(
+        invoke_id, &dest, &npdu_data, apdu, sizeof(apdu));
+    tsm_set_confirmed_unsegmented_transaction(
+        other_id, &dest, &npdu_data, apdu, sizeof(apdu));
+    zassert_true(tsm_get_transaction_pdu(
+                     invoke_id, &dest, &npdu_data, test_apdu, &test_apdu_len),
+        NULL);
+    zassert_equal(test_apdu_len, sizeof(apdu), NULL);
+    zassert_equal(memcmp(apdu, test_apdu, sizeof(apdu)), 0, NULL);
+    /* the other transaction completes */
+    tsm_free_invoke_id(other_id);
+    Send_Count = 0;
+    Timeout_Count = 0;
+    /* not yet expired */
+    tsm_timer_milliseconds(2999);
+    zassert_equal(Send_Count, 0, NULL);
+    /* each expiry resends, in small or large steps */
+    tsm_timer_milliseconds(1);
+    zassert_equal(Send_Count, 1, NULL);
+    for (i = 0; i < 3000; i++) {
+        tsm_timer_milliseconds(1);
+    }
+    zassert_equal(Send_Count, 2, NULL);
+    tsm_timer_milliseconds(60000);
+    zassert_equal(Send_Count, 3, NULL);
+    zassert_equal(Timeout_Count, 0, NULL);
+    zassert_false(tsm_invoke_id_failed(invoke_id), NULL);
+    /* retries used up */
+    tsm_timer_milliseconds(3000);
+    zassert_equal(Send_Count, 3, NULL);
+    zassert_equal(Timeout_Count, 1, NULL);
+    zassert_equal(Timeout_Invoke_ID, invoke_id, NULL);
+    zassert_true(tsm_invoke_id_failed(invoke_id), NULL);
+    zassert_false(tsm_invoke_id_free(invoke_id), NULL);
+    tsm_free_invoke_id(invoke_id);
+    zassert_true(tsm_invoke_id_free(invoke_id), NULL);
+    tsm_timer_milliseconds(60000);
+    zassert_equal(Timeout_Count, 1, NULL);
+    zassert_equal(tsm_transaction_idle_count(), MAX_TSM_TRANSACTIONS, NULL);
+}
+
+/**
+ * @brief Test sending a ComplexACK in segments, with a window
+ *  that grows as the client acknowledges the segments
+ */
+static void testTSMSegmentedComplexACK(void)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    BACNET_CONFIRMED_SERVICE_DATA service_data = { 0 };
+    static uint8_t apdu[1003];
+    static uint8_t test_data[1000];
+    unsigned test_data_len = 0;
+    unsigned i;
+
+    dest.mac_len = 1;
+    dest.mac[0] = 0x42;
+    service_data.invoke_id = 5;
+    service_data.max_resp = 128;
+    service_data.max_segs = 16;
+    service_data.segmented_response_accepted = true;
+    apdu[0] = PDU_TYPE_COMPLEX_ACK;
+    apdu[1] = service_data.invoke_id;
+    apdu[2] = SERVICE_CONFIRMED_READ_PROPERTY;
+    for (i = 3; i < sizeof(apdu); i++) {
+        apdu[i] = (uint8_t)i;
+    }
+    /* small enough to go unsegmented */
+    Send_Count = 0;
+    zassert_true(tsm_segmented_complex_ack_send(
+                     &dest, &npdu_data, &service_data, apdu, 100),
+        NULL);
+    zassert_equal(Send_Count, 1, NULL);
+    zassert_equal(Sent_APDU_Len[0], 100, NULL);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+    /* the first window is one segment */
+    Send_Count = 0;
+    zassert_true(tsm_segmented_complex_ack_send(
+                     &dest, &npdu_data, &service_data, apdu, sizeof(apdu)),
+        NULL);
+    zassert_equal(tsm_segmented_idle_count(), 1, NULL);
+    zassert_equal(Send_Count, 1, NULL);
+    zassert_equal(Sent_APDU_Len[0], 128, NULL);
+    zassert_equal(Sent_APDU[0][0], PDU_TYPE_COMPLEX_ACK | 0x0C, NULL);
+    zassert_equal(Sent_APDU[0][1], 5, NULL);
+    zassert_equal(Sent_APDU[0][2], 0, NULL);
+    zassert_equal(Sent_APDU[0][3], BACNET_SEGMENT_WINDOW_SIZE, NULL);
+    zassert_equal(Sent_APDU[0][4], SERVICE_CONFIRMED_READ_PROPERTY, NULL);
+    memcpy(&test_data[0], &Sent_APDU[0][5], 123);
+    test_data_len = 123;
+    /* a SegmentACK from someone else is ignored */
+    dest.mac[0] = 0x43;
+    tsm_segment_ack_received(&dest, 5, 0, 4, false, false);
+    zassert_equal(Send_Count, 1, NULL);
+    dest.mac[0] = 0x42;
+    /* then the window that the client asks for */
+    Send_Count = 0;
+    tsm_segment_ack_received(&dest, 5, 0, 4, false, false);
+    zassert_equal(Send_Count, 4, NULL);
+    for (i = 0; i < 4; i++) {
+        zassert_equal(Sent_APDU[i][2], i + 1, NULL);
+        memcpy(&test_data[test_data_len], &Sent_APDU[i][5], 123);
+        test_data_len += 123;
+    }
+    /* a duplicate SegmentACK sends nothing */
+    Send_Count = 0;
+    tsm_segment_ack_received(&dest, 5, 0, 4, false, false);
+    zassert_equal(Send_Count, 0, NULL);
+    /* a negative ACK resends from the missing segment */
+    tsm_segment_ack_received(&dest, 5, 2, 2, true, false);
+    zassert_equal(Send_Count, 2, NULL);
+    zassert_equal(Sent_APDU[0][2], 3, NULL);
+    zassert_equal(Sent_APDU[1][2], 4, NULL);
+    Send_Count = 0;
+    tsm_segment_ack_received(&dest, 5, 4, 8, false, false);
+    zassert_equal(Send_Count, 4, NULL);
+    for (i = 0; i < 4; i++) {
+        zassert_equal(Sent_APDU[i][2], i + 5, NULL);
+        memcpy(&test_data[test_data_len], &Sent_APDU[i][5],
+            Sent_APDU_Len[i] - 5);
+        test_data_len += Sent_APDU_Len[i] - 5;
+    }
+    /* the last segment has no more-follows */
+    zassert_equal(Sent_APDU[2][0], PDU_TYPE_COMPLEX_ACK | 0x0C, NULL);
+    zassert_equal(Sent_APDU[3][0], PDU_TYPE_COMPLEX_ACK | 0x08, NULL);
+    zassert_equal(test_data_len, sizeof(test_data), NULL);
+    zassert_equal(memcmp(test_data, &apdu[3], sizeof(test_data)), 0, NULL);
+    /* the final SegmentACK completes the transfer */
+    tsm_segment_ack_received(&dest, 5, 8, 8, false, false);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+    /* no answer: the window is resent, then given up */
+    Send_Count = 0;
+    zassert_true(tsm_segmented_complex_ack_send(
+                     &dest, &npdu_data, &service_data, apdu, sizeof(apdu)),
+        NULL);
+    for (i = 0; i < 4; i++) {
+        tsm_timer_milliseconds(2000);
+    }
+    zassert_equal(Send_Count, 4, NULL);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+    /* the client can not accept segments, or this many of them */
+    Send_Count = 0;
+    service_data.segmented_response_accepted = false;
+    zassert_false(tsm_segmented_complex_ack_send(
+                      &dest, &npdu_data, &service_data, apdu, sizeof(apdu)),
+        NULL);
+    zassert_equal(Send_Count, 1, NULL);
+    zassert_equal(Sent_APDU[0][0], PDU_TYPE_ABORT | 1, NULL);
+    zassert_equal(
+        Sent_APDU[0][2], ABORT_REASON_SEGMENTATION_NOT_SUPPORTED, NULL);
+    service_data.segmented_response_accepted = true;
+    service_data.max_segs = 4;
+    zassert_false(tsm_segmented_complex_ack_send(
+                      &dest, &npdu_data, &service_data, apdu, sizeof(apdu)),
+        NULL);
+    zassert_equal(Sent_APDU[1][2], ABORT_REASON_BUFFER_OVERFLOW, NULL);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+}
+
+/**
+ * @brief Build a segment of a ComplexACK
+ */
+static uint16_t complex_ack_segment(uint8_t *apdu,
+    uint8_t invoke_id,
+    uint8_t sequence_number,
+    bool more_follows,
+    uint8_t data_len)
+{
+    uint16_t i;
+
+    apdu[0] = PDU_TYPE_COMPLEX_ACK | 0x08;
+    if (more_follows) {
+        apdu[0] |= 0x04;
+    }
+    apdu[1] = invoke_id;
+    apdu[2] = sequence_number;
+    apdu[3] = 2;
+    apdu[4] = SERVICE_CONFIRMED_READ_PROP_MULTIPLE;
+    for (i = 0; i < data_len; i++) {
+        apdu[5 + i] = sequence_number;
+    }
+
+    return 5 + data_len;
+}
+
+/**
+ * @brief Test receiving a segmented ComplexACK as a client,
+ *  and a segmented request as a server
+ */
+static void testTSMSegmentedReceive(void)
+{
+    BACNET_ADDRESS src = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    uint8_t request[4] = { 0, 1, 2, 3 };
+    uint8_t apdu[MAX_APDU] = { 0 };
+    uint16_t apdu_len = 0;
+    uint8_t *service_request = NULL;
+    uint16_t service_request_len = 0;
+    uint8_t invoke_id = 0;
+    uint8_t i = 0;
+
+    src.mac_len = 1;
+    src.mac[0] = 0x42;
+    tsm_set_timeout_handler(timeout_handler);
+    invoke_id = tsm_next_free_invokeID();
+    /* a reply that nobody is waiting for is ignored */
+    Send_Count = 0;
+    apdu_len = complex_ack_segment(apdu, invoke_id, 0, true, 100);
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Send_Count, 0, NULL);
+    tsm_set_confirmed_unsegmented_transaction(
+        invoke_id, &src, &npdu_data, request, sizeof(request));
+    /* the first segment is acknowledged with the window size */
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Send_Count, 1, NULL);
+    zassert_equal(Sent_APDU[0][0], PDU_TYPE_SEGMENT_ACK, NULL);
+    zassert_equal(Sent_APDU[0][1], invoke_id, NULL);
+    zassert_equal(Sent_APDU[0][2], 0, NULL);
+    zassert_equal(Sent_APDU[0][3], 2, NULL);
+    /* the request timer no longer runs */
+    tsm_timer_milliseconds(5000);
+    zassert_equal(Send_Count, 1, NULL);
+    /* then the end of each window */
+    apdu_len = complex_ack_segment(apdu, invoke_id, 1, true, 100);
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Send_Count, 1, NULL);
+    apdu_len = complex_ack_segment(apdu, invoke_id, 2, true, 100);
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Send_Count, 2, NULL);
+    zassert_equal(Sent_APDU[1][2], 2, NULL);
+    /* a missing segment is negatively acknowledged */
+    apdu_len = complex_ack_segment(apdu, invoke_id, 4, false, 50);
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Send_Count, 3, NULL);
+    zassert_equal(Sent_APDU[2][0], PDU_TYPE_SEGMENT_ACK | 0x02, NULL);
+    zassert_equal(Sent_APDU[2][2], 2, NULL);
+    apdu_len = complex_ack_segment(apdu, invoke_id, 3, true, 100);
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    apdu_len = complex_ack_segment(apdu, invoke_id, 4, false, 50);
+    zassert_true(tsm_segmented_receive(&src, apdu, apdu_len,
+                     &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Send_Count, 4, NULL);
+    zassert_equal(Sent_APDU[3][2], 4, NULL);
+    zassert_equal(service_request_len, 450, NULL);
+    for (i = 0; i < 5; i++) {
+        zassert_equal(service_request[i * 100], i, NULL);
+    }
+    zassert_equal(tsm_segmented_idle_count(), 1, NULL);
+    tsm_free_invoke_id(invoke_id);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+    /* a reply that stops arriving fails the transaction */
+    Timeout_Count = 0;
+    invoke_id = tsm_next_free_invokeID();
+    tsm_set_confirmed_unsegmented_transaction(
+        invoke_id, &src, &npdu_data, request, sizeof(request));
+    apdu_len = complex_ack_segment(apdu, invoke_id, 0, true, 100);
+    zassert_false(tsm_segmented_receive(&src, apdu, apdu_len,
+                      &service_request, &service_request_len),
+        NULL);
+    tsm_timer_milliseconds(8000);
+    zassert_equal(Timeout_Count, 1, NULL);
+    zassert_true(tsm_invoke_id_failed(invoke_id), NULL);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+    tsm_free_invoke_id(invoke_id);
+    /* a segmented request is held until the handler is done */
+    apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST | 0x08 | 0x04 | 0x02;
+    apdu[1] = 0x75;
+    apdu[2] = 9;
+    apdu[3] = 0;
+    apdu[4] = 1;
+    apdu[5] = SERVICE_CONFIRMED_WRITE_PROP_MULTIPLE;
+    apdu[6] = 0xAA;
+    zassert_false(tsm_segmented_receive(&src, apdu, 7,
+                      &service_request, &service_request_len),
+        NULL);
+    zassert_equal(Sent_APDU[Send_Count - 1][0],
+        PDU_TYPE_SEGMENT_ACK | 0x01, NULL);
+    apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST | 0x08 | 0x02;
+    apdu[3] = 1;
+    apdu[6] = 0xBB;
+    zassert_true(tsm_segmented_receive(&src, apdu, 7,
+                     &service_request, &service_request_len),
+        NULL);
+    zassert_equal(service_request_len, 2, NULL);
+    zassert_equal(service_request[0], 0xAA, NULL);
+    zassert_equal(service_request[1], 0xBB, NULL);
+    zassert_equal(tsm_segmented_idle_count(), 1, NULL);
+    tsm_segmented_request_free(&src, 9);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+}
+
+/**
+ * @brief Test sending a confirmed request in segments
+ */
+static void testTSMSegmentedRequest(void)
+{
+    BACNET_ADDRESS dest = { 0 };
+    BACNET_NPDU_DATA npdu_data = { 0 };
+    static uint8_t apdu[304];
+    uint8_t invoke_id = 0;
+
+    apdu[0] = PDU_TYPE_CONFIRMED_SERVICE_REQUEST;
+    apdu[1] = 0x05;
+    apdu[3] = SERVICE_CONFIRMED_WRITE_PROP_MULTIPLE;
+    tsm_set_timeout_handler(timeout_handler);
+    invoke_id = tsm_next_free_invokeID();
+    apdu[2] = invoke_id;
+    Send_Count = 0;
+    zassert_true(tsm_set_confirmed_segmented_transaction(invoke_id, &dest,
+                     &npdu_data, apdu, sizeof(apdu), 128),
+        NULL);
+    zassert_equal(Send_Count, 1, NULL);
+    zassert_equal(Sent_APDU[0][0],
+        PDU_TYPE_CONFIRMED_SERVICE_REQUEST | 0x08 | 0x04 | 0x02, NULL);
+    zassert_equal(Sent_APDU[0][2], invoke_id, NULL);
+    zassert_equal(Sent_APDU[0][3], 0, NULL);
+    zassert_equal(Sent_APDU[0][5], SERVICE_CONFIRMED_WRITE_PROP_MULTIPLE,
+        NULL);
+    zassert_equal(Sent_APDU_Len[0], 128, NULL);
+    /* the server acknowledges, so the rest is sent */
+    tsm_segment_ack_received(&dest, invoke_id, 0, 2, false, true);
+    zassert_equal(Send_Count, 3, NULL);
+    zassert_equal(Sent_APDU[2][0],
+        PDU_TYPE_CONFIRMED_SERVICE_REQUEST | 0x08 | 0x02, NULL);
+    zassert_equal(Sent_APDU_Len[2], 6 + 300 - 244, NULL);
+    /* then the reply is awaited without resending the request */
+    tsm_segment_ack_received(&dest, invoke_id, 2, 2, false, true);
+    zassert_equal(tsm_segmented_idle_count(), 2, NULL);
+    Timeout_Count = 0;
+    tsm_timer_milliseconds(3000);
+    zassert_equal(Send_Count, 3, NULL);
+    zassert_equal(Timeout_Count, 1, NULL);
+    zassert_true(tsm_invoke_id_failed(invoke_id), NULL);
+    tsm_free_invoke_id(invoke_id);
+    zassert_equal(tsm_transaction_idle_count(), MAX_TSM_TRANSACTIONS, NULL);
+}
+/**
+ * @}
+ */
+
+void test_main(void)
+{
+    ztest_test_suite(tsm_tests,
+     ztest_unit_test(testTSMInvokeID),
+     ztest_unit_test(testTSMTimer),
+     ztest_unit_test(testTSMSegmentedComplexACK),
+     ztest_unit_test(testTSMSegmentedReceive),
+     ztest_unit_test(testTSMSegmentedRequest)
+     );
+
+    ztest_run_test_suite(tsm_tests);
+}
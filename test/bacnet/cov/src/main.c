@@ -359,6 +359,36 @@ static void testCOVSubscribeProperty(void)
     data.covIncrementPresent = false;
     testCOVSubscribePropertyEncoding(invoke_id, &data);
 }
+
+static BACNET_OBJECT_TYPE Changed_Object_Type;
+static uint32_t Changed_Object_Instance;
+static unsigned Changed_Count;
+
+static void testCOVChangeCallback(
+    BACNET_OBJECT_TYPE object_type, uint32_t object_instance)
+{
+    Changed_Object_Type = object_type;
+    Changed_Object_Instance = object_instance;
+    Changed_Count++;
+}
+
+static void testCOVChangeDetected(void)
+{
+    Changed_Count = 0;
+    /* no callback */
+    cov_change_detected_notify(OBJECT_ANALOG_INPUT, 1);
+    zassert_equal(Changed_Count, 0, NULL);
+
+    cov_change_detected_callback_set(testCOVChangeCallback);
+    cov_change_detected_notify(OBJECT_BINARY_VALUE, 321);
+    zassert_equal(Changed_Count, 1, NULL);
+    zassert_equal(Changed_Object_Type, OBJECT_BINARY_VALUE, NULL);
+    zassert_equal(Changed_Object_Instance, 321, NULL);
+
+    cov_change_detected_callback_set(NULL);
+    cov_change_detected_notify(OBJECT_ANALOG_INPUT, 1);
+    zassert_equal(Changed_Count, 1, NULL);
+}
 /**
  * @}
  */
@@ -369,7 +399,8 @@ void test_main(void)
     ztest_test_suite(cov_tests,
      ztest_unit_test(testCOVNotify),
      ztest_unit_test(testCOVSubscribe),
-     ztest_unit_test(testCOVSubscribeProperty)
+     ztest_unit_test(testCOVSubscribeProperty),
+     ztest_unit_test(testCOVChangeDetected)
      );
 
     ztest_run_test_suite(cov_tests);
@@ -10,7 +10,9 @@
 
 #include <ztest.h>
 #include <stdlib.h>
+#include <string.h>
 #include <bacnet/datalink/cobs.h>
+#include <bacnet/datalink/mstpdef.h>
 #include <bacnet/bytes.h>
 
 /**
@@ -47,6 +49,111 @@ static void test_COBS_Encode_Decode(void)
     zassert_true(test_buffer_length == sizeof(buffer),
         "COBS encode/decode length fail");
 }
+
+/**
+ * @brief Test that the CRC32K of a buffer is the same as octet by octet
+ */
+static void test_COBS_CRC32K_Buffer(void)
+{
+    uint8_t buffer[600];
+    uint32_t crc32K, test_crc32K;
+    unsigned i, offset, length;
+
+    for (i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)((i * 7) ^ (i >> 3));
+    }
+    for (offset = 0; offset < 8; offset++) {
+        for (length = 0; length < (sizeof(buffer) - offset); length += 37) {
+            crc32K = CRC32K_INITIAL_VALUE;
+            for (i = 0; i < length; i++) {
+                crc32K = cobs_crc32k(buffer[offset + i], crc32K);
+            }
+            test_crc32K = cobs_crc32k_buffer(
+                &buffer[offset], length, CRC32K_INITIAL_VALUE);
+            zassert_equal(crc32K, test_crc32K, NULL);
+        }
+    }
+    /* the CRC of a frame followed by its CRC is the residue */
+    crc32K = cobs_crc32k_buffer(buffer, 100, CRC32K_INITIAL_VALUE);
+    cobs_crc32k_encode(&buffer[100], 4, ~crc32K);
+    crc32K = cobs_crc32k_buffer(buffer, 104, CRC32K_INITIAL_VALUE);
+    zassert_equal(crc32K, CRC32K_RESIDUE, NULL);
+}
+
+/**
+ * @brief Test the COBS block lengths at the edges, and decoding in place
+ */
+static void test_COBS_Blocks(void)
+{
+    static const uint8_t data[] = { 0x11, 0x00, 0x22 };
+    static const uint8_t data_encoded[] = { 0x02, 0x11, 0x02, 0x22 };
+    uint8_t buffer[600];
+    uint8_t encoded_buffer[COBS_ENCODED_SIZE(600) + COBS_ENCODED_CRC_SIZE];
+    uint8_t test_buffer[600];
+    size_t lengths[] = { 0, 1, 253, 254, 255, 256, 508, 509, 600 };
+    size_t encoded_length, test_length;
+    unsigned i, j;
+
+    encoded_length = cobs_encode(encoded_buffer, sizeof(encoded_buffer),
+        data, 0, 0);
+    zassert_equal(encoded_length, 1, NULL);
+    zassert_equal(encoded_buffer[0], 0x01, NULL);
+    encoded_length = cobs_encode(encoded_buffer, sizeof(encoded_buffer),
+        data, sizeof(data), 0);
+    zassert_equal(encoded_length, sizeof(data_encoded), NULL);
+    zassert_mem_equal(encoded_buffer, data_encoded, encoded_length, NULL);
+    /* 254 non-zero octets need no phantom zero block */
+    memset(buffer, 0xAA, sizeof(buffer));
+    encoded_length = cobs_encode(encoded_buffer, sizeof(encoded_buffer),
+        buffer, 254, 0);
+    zassert_equal(encoded_length, 255, NULL);
+    zassert_equal(encoded_buffer[0], 0xFF, NULL);
+    buffer[254] = 0;
+    encoded_length = cobs_encode(encoded_buffer, sizeof(encoded_buffer),
+        buffer, 255, 0);
+    zassert_equal(encoded_length, 257, NULL);
+    zassert_equal(encoded_buffer[255], 0x01, NULL);
+    zassert_equal(encoded_buffer[256], 0x01, NULL);
+    /* too small for the encoding */
+    encoded_length = cobs_encode(encoded_buffer, 255, buffer, 255, 0);
+    zassert_equal(encoded_length, 0, NULL);
+    /* round trip, with and without zeros in the data */
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < sizeof(buffer); i++) {
+            buffer[i] = (uint8_t)(j ? (i % 7) : ((i % 255) + 1));
+        }
+        for (i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++) {
+            encoded_length = cobs_encode(encoded_buffer,
+                sizeof(encoded_buffer), buffer, lengths[i],
+                MSTP_PREAMBLE_X55);
+            zassert_true(encoded_length > lengths[i], NULL);
+            zassert_is_null(memchr(encoded_buffer, MSTP_PREAMBLE_X55,
+                                encoded_length), NULL);
+            test_length = cobs_decode(test_buffer, sizeof(test_buffer),
+                encoded_buffer, encoded_length, MSTP_PREAMBLE_X55);
+            zassert_equal(test_length, lengths[i], NULL);
+            zassert_mem_equal(test_buffer, buffer, lengths[i], NULL);
+            /* a frame decodes in its own buffer */
+            if (lengths[i] == 0) {
+                continue;
+            }
+            encoded_length = cobs_frame_encode(encoded_buffer,
+                sizeof(encoded_buffer), buffer, lengths[i]);
+            zassert_true(encoded_length > 0, NULL);
+            test_length = cobs_frame_decode(encoded_buffer,
+                sizeof(encoded_buffer), encoded_buffer, encoded_length);
+            zassert_equal(test_length, lengths[i], NULL);
+            zassert_mem_equal(encoded_buffer, buffer, lengths[i], NULL);
+        }
+    }
+    /* a damaged frame fails its CRC */
+    encoded_length = cobs_frame_encode(encoded_buffer,
+        sizeof(encoded_buffer), buffer, 100);
+    encoded_buffer[10] ^= 0x01;
+    test_length = cobs_frame_decode(test_buffer, sizeof(test_buffer),
+        encoded_buffer, encoded_length);
+    zassert_equal(test_length, 0, NULL);
+}
 /**
  * @}
  */
@@ -55,7 +162,9 @@ static void test_COBS_Encode_Decode(void)
 void test_main(void)
 {
     ztest_test_suite(cobs_tests,
-     ztest_unit_test(test_COBS_Encode_Decode)
+     ztest_unit_test(test_COBS_Encode_Decode),
+     ztest_unit_test(test_COBS_CRC32K_Buffer),
+     ztest_unit_test(test_COBS_Blocks)
      );
 
     ztest_run_test_suite(cobs_tests);
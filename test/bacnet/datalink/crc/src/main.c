@@ -119,12 +119,49 @@ static void testCRC16CreateTable(void)
  * @}
  */
 
+static void testCRCBuffer(void)
+{
+    uint8_t buffer[600];
+    uint8_t crc8, test_crc8;
+    uint16_t crc16, test_crc16;
+    unsigned i, offset, length;
+
+    for (i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)((i * 7) ^ (i >> 3));
+    }
+    /* every octet value in every place of the eight, from each alignment */
+    for (offset = 0; offset < 8; offset++) {
+        for (length = 0; length < (sizeof(buffer) - offset); length += 37) {
+            crc8 = 0xFF;
+            crc16 = 0xFFFF;
+            for (i = 0; i < length; i++) {
+                crc8 = CRC_Calc_Header(buffer[offset + i], crc8);
+                crc16 = CRC_Calc_Data(buffer[offset + i], crc16);
+            }
+            test_crc8 = CRC_Calc_Header_Buffer(&buffer[offset], length, 0xFF);
+            zassert_equal(crc8, test_crc8, NULL);
+            test_crc16 = CRC_Calc_Data_Buffer(&buffer[offset], length, 0xFFFF);
+            zassert_equal(crc16, test_crc16, NULL);
+        }
+    }
+    /* test from Annex G 2.0 of BACnet Standard */
+    buffer[0] = 0x01;
+    buffer[1] = 0x22;
+    buffer[2] = 0x30;
+    crc16 = CRC_Calc_Data_Buffer(&buffer[0], 3, 0xFFFF);
+    zassert_equal(crc16, 0x42EF, NULL);
+    buffer[3] = 0x10;
+    buffer[4] = 0xBD;
+    crc16 = CRC_Calc_Data_Buffer(&buffer[0], 5, 0xFFFF);
+    zassert_equal(crc16, 0xF0B8, NULL);
+}
 
 void test_main(void)
 {
     ztest_test_suite(crc_tests,
      ztest_unit_test(testCRC8),
      ztest_unit_test(testCRC16),
+     ztest_unit_test(testCRCBuffer),
      ztest_unit_test(testCRC8CreateTable),
      ztest_unit_test(testCRC16CreateTable)
      );
@@ -6,8 +6,7 @@ DEFINES = -DBIG_ENDIAN=0 -DBAC_TEST -DTEST_VMAC
 
 CFLAGS  = -Wall -Wmissing-prototypes $(INCLUDES) $(DEFINES) -g
 
-SRCS = $(SRC_DIR)/bacnet/basic/sys/keylist.c \
-	$(SRC_DIR)/bacnet/basic/bbmd6/vmac.c \
+SRCS = $(SRC_DIR)/bacnet/basic/bbmd6/vmac.c \
 	ctest.c
 
 TARGET_NAME = vmac